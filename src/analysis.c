@@ -37,6 +37,9 @@
 #include <sys/stat.h>
 #include <sys/un.h>
 #include <unistd.h>
+#ifdef HAVE_DLFCN_H
+#  include <dlfcn.h>
+#endif
 #include "analysis.h"
 #include "globals.h"
 #include "grid.h"
@@ -44,6 +47,8 @@
 #include "proj.h"
 #include "queue.h"
 #include "socketio.h"
+#include "sync.h"
+#include "userfunc.h"
 
 
 #define SOCK_NAME "/tmp/Vis5d_socket"
@@ -76,26 +81,45 @@ int find_analysis_functions( char *path, char FuncName[][1000] )
    numfuncs = 0;
 
    /* put a directory listing into a temporary file */
-   sprintf( command, "ls > %s %s/*.f", TEMP_FILE, path );
+   sprintf( command, "ls > %s %s/*.f %s/*.so 2>/dev/null",
+            TEMP_FILE, path, path );
    system( command );
 
    f = fopen( TEMP_FILE, "r" );
    if (f) {
       while (fgets(fname, 1000, f) && numfuncs<MAX_FUNCS) {
-         /* truncate .f\n from each name */
+         int i, found;
          len = strlen(fname);
-         if (len>3) {
+         if (len>4 && strcmp(fname+len-4,".so\n")==0) {
+            /* a plugin, truncate .so\n */
+            fname[len-4] = '\0';
+         }
+         else if (len>3) {
+            /* truncate .f\n from each name */
             fname[len-3] = '\0';
             /* now see if executable function exists */
             g = fopen( fname, "r" );
-            if (g) {
-               /* remove path prefix from name */
-               strcpy( fname2, fname+strlen(path)+1 );
-               strcpy( FuncName[numfuncs], fname2 );
-               numfuncs++;
-               fclose(g);
+            if (!g) {
+               continue;
+            }
+            fclose(g);
+         }
+         else {
+            continue;
+         }
+         /* remove path prefix from name */
+         strcpy( fname2, fname+strlen(path)+1 );
+         /* a function may come both as a program and as a plugin */
+         found = 0;
+         for (i=0;i<numfuncs;i++) {
+            if (strcmp(FuncName[i],fname2)==0) {
+               found = 1;
             }
          }
+         if (!found) {
+            strcpy( FuncName[numfuncs], fname2 );
+            numfuncs++;
+         }
       }
       fclose(f);
    }
@@ -210,9 +234,390 @@ static int stop_external_function( char *progname, int sock )
 
 
 
+/*
+ * Fill in the map projection and vertical coordinate system arguments
+ * given to analysis functions.
+ */
+static void get_proj_vert_args( Context ctx, float proj_args[100],
+                                float vert_args[MAXLEVELS] )
+{
+   int i;
+
+   memset( proj_args, 0, 100*sizeof(float) );
+   memset( vert_args, 0, MAXLEVELS*sizeof(float) );
+   switch (ctx->Projection) {
+      case PROJ_GENERIC:
+      case PROJ_LINEAR:
+         proj_args[0] = ctx->NorthBound;
+         proj_args[1] = ctx->WestBound;
+         proj_args[2] = ctx->RowInc;
+         proj_args[3] = ctx->ColInc;
+         break;
+      case PROJ_MERCATOR:
+         proj_args[0] = ctx->CentralLat;
+         proj_args[1] = ctx->CentralLon;
+         proj_args[2] = ctx->RowIncKm;
+         proj_args[3] = ctx->ColIncKm;
+         break;
+      case PROJ_ROTATED:
+         /* WLH 4-21-95 */
+         proj_args[0] = ctx->NorthBound;
+         proj_args[1] = ctx->WestBound;
+         proj_args[2] = ctx->RowInc;
+         proj_args[3] = ctx->ColInc;
+         proj_args[4] = ctx->CentralLat;
+         proj_args[5] = ctx->CentralLon;
+         proj_args[6] = ctx->Rotation;
+         break;
+      case PROJ_LAMBERT:
+         proj_args[0] = ctx->Lat1;
+         proj_args[1] = ctx->Lat2;
+         proj_args[2] = ctx->PoleRow;
+         proj_args[3] = ctx->PoleCol;
+         proj_args[4] = ctx->CentralLon;
+         proj_args[5] = ctx->ColInc;
+         break;
+      case PROJ_STEREO:
+         proj_args[0] = ctx->CentralLat;
+         proj_args[1] = ctx->CentralLon;
+         proj_args[2] = ctx->CentralRow;
+         proj_args[3] = ctx->CentralCol;
+         proj_args[4] = ctx->ColInc;
+         break;
+   }
+   switch (ctx->VerticalSystem) {
+      case VERT_GENERIC:
+      case VERT_EQUAL_KM:
+         vert_args[0] = ctx->BottomBound;
+         vert_args[1] = ctx->LevInc;
+         break;
+      case VERT_NONEQUAL_KM:
+      case VERT_NONEQUAL_MB:
+         for (i=0;i<ctx->MaxNl;i++) {
+            vert_args[i] = ctx->Height[i];
+         }
+         break;
+   }
+}
+
+
+
+/*
+ * Get the probe (cursor) position in grid and geographic coordinates
+ * and remember the grid position for the probe values sent later.
+ * Output:  probe - row, col, lev, lat, lon, hgt.
+ */
+static void get_probe_location( Context ctx, float probe[6] )
+{
+   xyz_to_grid( ctx, ctx->dpy_ctx->CurTime, 0, ctx->dpy_ctx->CursorX,
+                ctx->dpy_ctx->CursorY, ctx->dpy_ctx->CursorZ,
+                &probe[0], &probe[1], &probe[2] );
+   xyz_to_geo( ctx, ctx->dpy_ctx->CurTime, 0, ctx->dpy_ctx->CursorX,
+               ctx->dpy_ctx->CursorY, ctx->dpy_ctx->CursorZ,
+               &probe[3], &probe[4], &probe[5] );
+   ctx->ProbeRow = probe[0];
+   ctx->ProbeCol = probe[1];
+   ctx->ProbeLev = probe[2];
+}
+
+
+
+/*
+ * Return the largest number of levels among the first np variables,
+ * which is the grid stride the external function uses.
+ */
+static int ext_max_nl( Context ctx, int np )
+{
+   int iv, maxnl = 0;
+
+   for (iv=0;iv<np;iv++) {
+      if (ctx->Nl[iv]>maxnl) {
+         maxnl = ctx->Nl[iv];
+      }
+   }
+   return maxnl;
+}
+
+
+
+/*** setup_shared_grids ***********************************************
+   Offer shared memory segments to an external function which
+   understands them.  The input segment holds the np input grids, each
+   Nr*Nc*maxnl floats, and is attached read-only by the function; the
+   function writes its result into the output segment.  After this
+   only control messages go through the socket.
+   Input:  sock - socket of the external function instance.
+           np - number of input variables.
+   Output:  in, out - attached segments, both NULL if the function
+            will use the socket for data.
+**********************************************************************/
+static void setup_shared_grids( Context ctx, int sock, int np,
+                                float **in, float **out )
+{
+   int maxnl, inid = -1, outid = -1, ok = 0;
+   size_t inbytes, outbytes;
+
+   maxnl = ext_max_nl( ctx, np );
+   inbytes = (size_t) ctx->Nr * ctx->Nc * maxnl * np * sizeof(float);
+   outbytes = (size_t) ctx->Nr * ctx->Nc * maxnl * sizeof(float);
+   if (inbytes<sizeof(float)) {
+      inbytes = sizeof(float);
+   }
+
+   /* grids too big to address here go through the socket */
+   if ((double) ctx->Nr * ctx->Nc * maxnl * (np+1) * sizeof(float)
+       > (double) (size_t) -1) {
+      *in = *out = NULL;
+   }
+   else {
+      *in = (float *) create_shared_block( inbytes, &inid );
+      *out = *in ? (float *) create_shared_block( outbytes, &outid ) : NULL;
+   }
+   if (!*out) {
+      if (*in) {
+         detach_shared_block( *in );
+         remove_shared_block( inid );
+         *in = NULL;
+      }
+      inid = outid = -1;
+   }
+
+   send_int( sock, inid );
+   send_int( sock, outid );
+   if (inid>=0) {
+      receive_int( sock, &ok );
+      /* the segments go away when both processes detach them */
+      remove_shared_block( inid );
+      remove_shared_block( outid );
+      if (!ok) {
+         detach_shared_block( *in );
+         detach_shared_block( *out );
+         *in = *out = NULL;
+      }
+   }
+}
+
+
+
+#ifdef HAVE_DLFCN_H
+
+/* An in-process analysis function while it is computing */
+struct plugin_run {
+   void *handle;                       /* from dlopen() */
+   vis5d_userfunc_proc func;
+   vis5d_userfunc_finish_proc finish;
+   struct vis5d_userfunc_args args;    /* the per-run part */
+   int nl[MAXVARS], lowlev[MAXVARS];
+   const char *names[MAXVARS];
+   float proj_args[100], vert_args[MAXLEVELS];
+   int pending;                        /* timesteps not yet done */
+   LOCK lock;
+};
+
+
+
+/*** start_plugin_function ********************************************
+   Load progname.so, if there is one, as an in-process analysis
+   function and call its init function.
+   Input:  var - the variable being computed.
+           progname - path of the function, without suffix.
+           proj_args, vert_args, probe - as sent to external programs.
+   Return:  1 = plugin ready, 0 = no usable plugin, use the external
+            program instead, -1 = the plugin failed to initialize.
+**********************************************************************/
+static int start_plugin_function( Context ctx, int var, char *progname,
+                                  float proj_args[], float vert_args[],
+                                  float probe[] )
+{
+   char libname[1000];
+   void *handle;
+   int *abi, iv, np, error;
+   vis5d_userfunc_proc func, init;
+   struct plugin_run *run;
+
+   sprintf( libname, "%s.so", progname );
+   if (access( libname, R_OK )!=0) {
+      return 0;
+   }
+   handle = dlopen( libname, RTLD_NOW );
+   if (!handle) {
+      printf("External Function Error: couldn't load %s: %s\n",
+             libname, dlerror() );
+      return 0;
+   }
+   abi = (int *) dlsym( handle, "vis5d_userfunc_abi" );
+   func = (vis5d_userfunc_proc) dlsym( handle, "vis5d_userfunc" );
+   if (!abi || *abi!=VIS5D_USERFUNC_ABI || !func) {
+      printf("External Function Error: %s is not a version %d plugin\n",
+             libname, VIS5D_USERFUNC_ABI );
+      dlclose( handle );
+      return 0;
+   }
+
+   run = (struct plugin_run *) calloc( 1, sizeof(struct plugin_run) );
+   if (!run) {
+      dlclose( handle );
+      return -1;
+   }
+   run->handle = handle;
+   run->func = func;
+   run->finish = (vis5d_userfunc_finish_proc)
+                 dlsym( handle, "vis5d_userfunc_finish" );
+
+   /* Number of variables:  all up to the one we're making */
+   np = var;
+   for (iv=0;iv<np;iv++) {
+      run->nl[iv] = ctx->Nl[iv];
+      run->lowlev[iv] = ctx->Variable[iv]->LowLev;
+      run->names[iv] = ctx->Variable[iv]->VarName;
+   }
+   memcpy( run->proj_args, proj_args, 100*sizeof(float) );
+   memcpy( run->vert_args, vert_args, MAXLEVELS*sizeof(float) );
+
+   run->args.numtimes = ctx->NumTimes;
+   run->args.numvars = np;
+   run->args.nr = ctx->Nr;
+   run->args.nc = ctx->Nc;
+   run->args.maxnl = ext_max_nl( ctx, np );
+   run->args.nl = run->nl;
+   run->args.lowlev = run->lowlev;
+   run->args.names = run->names;
+   run->args.projection = ctx->Projection;
+   run->args.projargs = run->proj_args;
+   run->args.vertical = ctx->VerticalSystem;
+   run->args.vertargs = run->vert_args;
+   run->args.proberow = probe[0];
+   run->args.probecol = probe[1];
+   run->args.probelev = probe[2];
+   run->args.probelat = probe[3];
+   run->args.probelon = probe[4];
+   run->args.probehgt = probe[5];
+
+   init = (vis5d_userfunc_proc) dlsym( handle, "vis5d_userfunc_init" );
+   if (init) {
+      error = (*init)( &run->args );
+      if (error!=0) {
+         printf("Error in user function init, return code was: %d\n",
+                error );
+         dlclose( handle );
+         free( run );
+         return -1;
+      }
+   }
+
+   run->pending = ctx->NumTimes;
+   ALLOC_LOCK( run->lock );
+   ctx->ExtFuncPlugin = run;
+   printf("Running plugin %s\n", libname );
+   return 1;
+}
+
+
+
+/*** stop_plugin_function *********************************************
+   Let the plugin clean up, then unload it.
+**********************************************************************/
+static void stop_plugin_function( Context ctx )
+{
+   struct plugin_run *run = (struct plugin_run *) ctx->ExtFuncPlugin;
+
+   if (run->finish) {
+      (*run->finish)( &run->args );
+   }
+   FREE_LOCK( run->lock );
+   dlclose( run->handle );
+   free( run );
+   ctx->ExtFuncPlugin = NULL;
+}
+
+
+
+/*** calc_plugin_func *************************************************
+   Compute one timestep with the loaded plugin.  Called on any of the
+   worker threads, so several timesteps run at once.
+   Input:  time - which timestep
+           var - which variable we're computing
+   Return:  1 = ok, 0 = error.
+**********************************************************************/
+static int calc_plugin_func( Context ctx, int time, int var )
+{
+   struct plugin_run *run = (struct plugin_run *) ctx->ExtFuncPlugin;
+   struct vis5d_userfunc_args args;
+   const float *ingrid[MAXVARS];
+   float probevalue[MAXVARS];
+   float *outgrid;
+   int iv, np, error, nbytes, left;
+
+   args = run->args;
+   np = args.numvars;
+   args.time = time;
+   args.date = ctx->DayStamp[time];
+   args.timestamp = ctx->TimeStamp[time];
+   args.probevalue = probevalue;
+   args.ingrid = ingrid;
+   args.outnl = args.maxnl;
+   args.outlowlev = 0;
+
+   error = 0;
+   for (iv=0;iv<np;iv++) {
+      probevalue[iv] = interpolate_grid_value( ctx, time, iv,
+                         ctx->ProbeRow, ctx->ProbeCol, ctx->ProbeLev );
+      ingrid[iv] = get_grid( ctx, time, iv );
+      if (!ingrid[iv]) {
+         error = 1;
+      }
+   }
+   nbytes = ctx->Nr * ctx->Nc * ctx->MaxNl * sizeof(float);
+   outgrid = (float *) allocate( ctx, nbytes );
+   args.outgrid = outgrid;
+   if (!outgrid) {
+      error = 1;
+   }
+
+   if (!error) {
+      error = (*run->func)( &args );
+      if (error!=0) {
+         printf("Error in user function, return code was: %d\n", error );
+      }
+   }
+
+   if (error) {
+      ctx->ExtFuncErrorFlag = 1;
+   }
+   else {
+      if (args.outnl>ctx->MaxNl)  args.outnl = ctx->MaxNl;
+      install_new_grid( ctx, time, var, outgrid, args.outnl,
+                        args.outlowlev );
+   }
+
+   if (outgrid) {
+      deallocate( ctx, outgrid, nbytes );
+   }
+   for (iv=0;iv<np;iv++) {
+      if (ingrid[iv]) {
+         release_grid( ctx, time, iv, (float *) ingrid[iv] );
+      }
+   }
+
+   /* timesteps finish in any order, signal after the last one */
+   LOCK_ON( run->lock );
+   left = --run->pending;
+   LOCK_OFF( run->lock );
+   if (left==0) {
+      SIGNAL_SEM( ctx->ExtFuncDoneSem );
+   }
+
+   return !error;
+}
+
+#endif /* HAVE_DLFCN_H */
+
+
+
 /*** compute_analysis_variable ****************************************
    Make a new variable which is computed from an external analysis
-   function.
+   function.  If progname.so is a plugin it is run in-process, else
+   the program progname is started once per worker thread.
    Input: var - number of the variable we're computing.
           prognam - name of the executable program to call.
    Return:  1 if success.
@@ -221,11 +626,30 @@ static int stop_external_function( char *progname, int sock )
 int compute_analysis_variable( Context ctx, int var, char *progname )
 {
    int sock, ack, time, iv, np, t, i, instances;
-   float proj_args[100], vert_args[MAXLEVELS];
+   float proj_args[100], vert_args[MAXLEVELS], probe[6];
 
    /* Clear the error variable */
    ctx->ExtFuncErrorFlag = 0;
 
+   get_proj_vert_args( ctx, proj_args, vert_args );
+   get_probe_location( ctx, probe );
+
+#ifdef HAVE_DLFCN_H
+   /* Prefer an in-process plugin, computed on the worker threads */
+   switch (start_plugin_function( ctx, var, progname,
+                                  proj_args, vert_args, probe )) {
+      case 1:
+         for (time=0;time<ctx->NumTimes;time++) {
+            request_ext_func( ctx, time, var );
+         }
+         WAIT_SEM( ctx->ExtFuncDoneSem );
+         stop_plugin_function( ctx );
+         return ctx->ExtFuncErrorFlag ? 0 : 1;
+      case -1:
+         return 0;
+   }
+#endif
+
    if (NumThreads<=1)
       instances = 1;
    else
@@ -243,6 +667,7 @@ int compute_analysis_variable( Context ctx, int var, char *progname )
          return 0;
       }
       ctx->ExtFuncSocket[t] = sock;
+      ctx->ExtFuncInput[t] = ctx->ExtFuncOutput[t] = NULL;
 
       /* wait for an acknowledgment */
       receive_int( sock, &ack );
@@ -277,85 +702,17 @@ int compute_analysis_variable( Context ctx, int var, char *progname )
 
       /* Send map proj and vert coord sys info */
       send_int( sock, ctx->Projection );
-      switch (ctx->Projection) {
-         case PROJ_GENERIC:
-         case PROJ_LINEAR:
-            proj_args[0] = ctx->NorthBound;
-            proj_args[1] = ctx->WestBound;
-            proj_args[2] = ctx->RowInc;
-            proj_args[3] = ctx->ColInc;
-            break;
-         case PROJ_MERCATOR:
-            proj_args[0] = ctx->CentralLat;
-            proj_args[1] = ctx->CentralLon;        
-            proj_args[2] = ctx->RowIncKm;        
-            proj_args[3] = ctx->ColIncKm;        
-         case PROJ_ROTATED:
-            /* WLH 4-21-95 */
-            proj_args[0] = ctx->NorthBound;
-            proj_args[1] = ctx->WestBound;
-            proj_args[2] = ctx->RowInc;
-            proj_args[3] = ctx->ColInc;
-            proj_args[4] = ctx->CentralLat;
-            proj_args[5] = ctx->CentralLon;
-            proj_args[6] = ctx->Rotation;
-            break;
-         case PROJ_LAMBERT:
-            proj_args[0] = ctx->Lat1;
-            proj_args[1] = ctx->Lat2;
-            proj_args[2] = ctx->PoleRow;
-            proj_args[3] = ctx->PoleCol;
-            proj_args[4] = ctx->CentralLon;
-            proj_args[5] = ctx->ColInc;
-            break;
-         case PROJ_STEREO:
-            proj_args[0] = ctx->CentralLat;
-            proj_args[1] = ctx->CentralLon;
-            proj_args[2] = ctx->CentralRow;
-            proj_args[3] = ctx->CentralCol;
-            proj_args[4] = ctx->ColInc;
-            break;
-      }
       for (i=0;i<100;i++) {
          send_float( sock, proj_args[i] );
       }
       send_int( sock, ctx->VerticalSystem );
-      switch (ctx->VerticalSystem) {
-         case VERT_GENERIC:
-         case VERT_EQUAL_KM:
-            vert_args[0] = ctx->BottomBound;
-            vert_args[1] = ctx->LevInc;
-            break;
-         case VERT_NONEQUAL_KM:
-         case VERT_NONEQUAL_MB:
-            for (i=0;i<ctx->MaxNl;i++) {
-               vert_args[i] = ctx->Height[i];
-            }
-            break;
-      }
       for (i=0;i<MAXLEVELS;i++) {
          send_float( sock, vert_args[i] );
       }
 
       /* Send probe location */
-      {
-         float row, col, lev;
-         float lat, lon, hgt;
-
-         xyz_to_grid( ctx, ctx->dpy_ctx->CurTime, 0, ctx->dpy_ctx->CursorX, ctx->dpy_ctx->CursorY,
-                      ctx->dpy_ctx->CursorZ, &row, &col, &lev);
-         xyz_to_geo( ctx, ctx->dpy_ctx->CurTime, 0, ctx->dpy_ctx->CursorX, ctx->dpy_ctx->CursorY,
-                     ctx->dpy_ctx->CursorZ, &lat, &lon, &hgt );
-
-         send_float( sock, row );
-         send_float( sock, col );
-         send_float( sock, lev );
-         send_float( sock, lat );
-         send_float( sock, lon );
-         send_float( sock, hgt );
-         ctx->ProbeRow = row;
-         ctx->ProbeCol = col;
-         ctx->ProbeLev = lev;
+      for (i=0;i<6;i++) {
+         send_float( sock, probe[i] );
       }
 
       /* Send user arguments */
@@ -365,6 +722,11 @@ int compute_analysis_variable( Context ctx, int var, char *progname )
       }
 */
 
+      /* Newer external functions can take the grids in shared memory */
+      if (ack==EXT_ACK_SHM) {
+         setup_shared_grids( ctx, sock, np, &ctx->ExtFuncInput[t],
+                             &ctx->ExtFuncOutput[t] );
+      }
    }
 
    /*
@@ -384,6 +746,9 @@ int compute_analysis_variable( Context ctx, int var, char *progname )
    for (t=1;t<=instances;t++) {
       send_int( ctx->ExtFuncSocket[t], -1 );  /* send bad timestep number */
       stop_external_function( progname, ctx->ExtFuncSocket[t] );
+      detach_shared_block( ctx->ExtFuncInput[t] );
+      detach_shared_block( ctx->ExtFuncOutput[t] );
+      ctx->ExtFuncInput[t] = ctx->ExtFuncOutput[t] = NULL;
    }
 
    if (ctx->ExtFuncErrorFlag)
@@ -405,9 +770,20 @@ int compute_analysis_variable( Context ctx, int var, char *progname )
  */
 int calc_ext_func( Context ctx, int time, int var, int threadnum )
 {
-   int sock, iv, np, error;
+   int sock, iv, np, error, maxnl;
+   size_t nrnc;
+   float *in, *out;
+
+#ifdef HAVE_DLFCN_H
+   if (ctx->ExtFuncPlugin) {
+      return calc_plugin_func( ctx, time, var );
+   }
+#endif
 
    sock = ctx->ExtFuncSocket[threadnum];
+   in = ctx->ExtFuncInput[threadnum];
+   out = ctx->ExtFuncOutput[threadnum];
+   nrnc = (size_t) ctx->Nr * ctx->Nc;
 
    send_int( sock, time );
    /*printf("sending day: %d\n", ctx->DayStamp[time] );*/
@@ -427,12 +803,23 @@ int calc_ext_func( Context ctx, int time, int var, int threadnum )
 
    /*printf("np=%d\n", np );*/
 
+   maxnl = ext_max_nl( ctx, np );
    for (iv=0;iv<np;iv++) {
-      /*printf("sending file number: %d\n", ctx->McFile[time][iv] );*/
-      send_int( sock, ctx->McFile[time][iv] );
-      /*printf("sending grid number: %d\n", ctx->McGrid[time][iv] );*/
-      send_int( sock, ctx->McGrid[time][iv] );
-      if (ctx->McFile[time][iv]==0 && ctx->McGrid[time][iv]==0) {
+      /*printf("sending file number: %d\n", ctx->GridTable[iv][time].McFile );*/
+      send_int( sock, ctx->GridTable[iv][time].McFile );
+      /*printf("sending grid number: %d\n", ctx->GridTable[iv][time].McGrid );*/
+      send_int( sock, ctx->GridTable[iv][time].McGrid );
+      if (in && ctx->GridTable[iv][time].McFile==0 && ctx->GridTable[iv][time].McGrid==0) {
+         /* decompress straight into the function's input segment */
+         float *ingrid = in + iv * nrnc * maxnl;
+         if (!load_grid( ctx, time, iv, ingrid )) {
+            size_t i;
+            for (i=0;i<nrnc*ctx->Nl[iv];i++) {
+               ingrid[i] = MISSING;
+            }
+         }
+      }
+      else if (ctx->GridTable[iv][time].McFile==0 && ctx->GridTable[iv][time].McGrid==0) {
          /* Original McIDAS file data not available, so send */
          /* uncompressed data even though it's not too accurate */
          float *g;
@@ -469,19 +856,23 @@ int calc_ext_func( Context ctx, int time, int var, int threadnum )
 /*      printf("Received outNl=%d\n", outNl);*/
       if (outNl>ctx->MaxNl)  outNl = ctx->MaxNl;
 
-      ctx->Nl[var] = outNl;
-      ctx->Variable[var]->LowLev = outLowLev;
-
-      /* allocate space for resulting grid and receive the grid data */
-      nbytes = ctx->Nr * ctx->Nc * outNl * sizeof(float);
-      grid = (float *) allocate( ctx, nbytes );
-      receive_data( sock, grid, nbytes );
+      /* install_new_grid() sets Nl[var] and LowLev */
+      if (out) {
+         /* the function left its result in the output segment */
+         install_new_grid( ctx, time, var, out, outNl, outLowLev );
+      }
+      else {
+         /* allocate space for resulting grid and receive the grid data */
+         nbytes = ctx->Nr * ctx->Nc * outNl * sizeof(float);
+         grid = (float *) allocate( ctx, nbytes );
+         receive_data( sock, grid, nbytes );
 
-      /* install the new grid */
-      install_new_grid( ctx, time, var, grid, outNl, outLowLev );
+         /* install the new grid */
+         install_new_grid( ctx, time, var, grid, outNl, outLowLev );
 
-      /* may discard data now */
-      deallocate( ctx, grid, nbytes );
+         /* may discard data now */
+         deallocate( ctx, grid, nbytes );
+      }
    }
 
    if (time==ctx->NumTimes-1) {
@@ -34,11 +34,23 @@
 
 /*
  * Stored frame animation.
+ *
+ * Rendered frames are kept in a memory-bounded cache.  Each frame is
+ * keyed by a hash of the timestep, the window size, the viewing matrix
+ * and the set of graphics which are displayed, so toggling a graphic
+ * off and back on, or returning to an earlier view, finds the frames
+ * which were saved before.  Frames are run-length encoded and the
+ * least recently drawn frames are discarded when the byte budget
+ * (dtx->FrameCacheMB) would be exceeded.  Compression can be turned
+ * off with dtx->FrameCacheCompress.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include "anim.h"
 #include "globals.h"
 #include "graphics.h"
 
@@ -48,8 +60,286 @@
 #  include <gl/gl.h>
 #endif
 
-extern XImage *mesa_read_image( void );
-extern void mesa_draw_image( XImage *img );
+
+#define FRAME_HASH_SIZE  1024      /* number of hash buckets, power of 2 */
+
+#define RLE_REPEAT   0x80000000    /* run header flag: one pixel repeated */
+#define RLE_MAXRUN   0x7fffffff
+
+
+struct frame {
+   unsigned long long key;         /* hash of timestep, view and graphics */
+   int timestep;
+   int width, height;
+   int compressed;                 /* 1 = run-length encoded, 0 = raw */
+   int words;                      /* number of uint_4 words in data */
+   uint_4 *data;
+   struct frame *hnext;            /* next frame in hash bucket */
+   struct frame *prev, *next;      /* LRU list, most recent first */
+};
+
+
+struct frame_cache {
+   struct frame *bucket[FRAME_HASH_SIZE];
+   struct frame *head, *tail;      /* LRU list */
+   size_t bytes;                   /* bytes held by cached frames */
+   int count;                      /* number of cached frames */
+   uint_4 *pixels;                 /* scratch frame buffer */
+   int npixels;                    /* size of pixels[] */
+};
+
+
+
+/*
+ * 64-bit FNV-1a hash of a block of memory.
+ */
+static unsigned long long hash_bytes( unsigned long long h,
+                                      const void *p, size_t n )
+{
+   const unsigned char *b = (const unsigned char *) p;
+   size_t i;
+
+   for (i=0;i<n;i++) {
+      h ^= b[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+#define HASH(H,X)  H = hash_bytes( H, &(X), sizeof(X) )
+
+
+/*
+ * Compute the cache key for the given timestep:  everything which
+ * determines the image in the 3-D window other than the graphics
+ * themselves.  Changes to those are handled by invalidate_frames() and
+ * the FramesStale flag which do_one_task() sets.
+ */
+static unsigned long long frame_key( Display_Context dtx, int timestep )
+{
+   unsigned long long h = 14695981039346656037ULL;
+   int i;
+
+   HASH( h, timestep );
+   HASH( h, dtx->WinWidth );
+   HASH( h, dtx->WinHeight );
+   HASH( h, dtx->CTM );
+   HASH( h, dtx->Zoom );
+   HASH( h, dtx->FrntClip );
+   HASH( h, dtx->GfxProjection );
+   HASH( h, dtx->StereoOn );
+   HASH( h, dtx->FakeStereoEye );
+   HASH( h, dtx->BgColor );
+
+   /* everything vis5d_graphics_mode() can toggle */
+   HASH( h, dtx->DisplayBox );
+   HASH( h, dtx->DisplayClock );
+   HASH( h, dtx->DisplayMap );
+   HASH( h, dtx->DisplayLegends );
+   HASH( h, dtx->ContnumFlag );
+   HASH( h, dtx->CoordFlag );
+   HASH( h, dtx->PrettyFlag );
+   HASH( h, dtx->DisplayInfo );
+   HASH( h, dtx->DisplayProbe );
+   HASH( h, dtx->DisplayProbeOnTraj );
+   HASH( h, dtx->DisplaySound );
+   HASH( h, dtx->DisplayCursor );
+   HASH( h, dtx->DisplayClips );
+   HASH( h, dtx->DisplayTexture );
+   HASH( h, dtx->DepthCue );
+   HASH( h, dtx->JulianDate );
+   HASH( h, dtx->WindBarbs );
+   HASH( h, dtx->Reversed );
+   HASH( h, dtx->AlphaBlend );
+   HASH( h, dtx->Sound.thtastatus );
+   HASH( h, dtx->Sound.thtestatus );
+   HASH( h, dtx->Sound.wstatus );
+   HASH( h, dtx->Sound.tickstatus );
+   HASH( h, dtx->Sound.samestepflag );
+   HASH( h, dtx->Sound.tempstatus );
+   if (dtx->topo) {
+      HASH( h, dtx->topo->DisplayTopo );
+      HASH( h, dtx->topo->HiResTopo );
+   }
+
+   /* cursor and probe */
+   HASH( h, dtx->CursorX );
+   HASH( h, dtx->CursorY );
+   HASH( h, dtx->CursorZ );
+
+   /* wind, stream, trajectory and volume graphics */
+   HASH( h, dtx->DisplayHWind );
+   HASH( h, dtx->DisplayVWind );
+   HASH( h, dtx->DisplayHStream );
+   HASH( h, dtx->DisplayVStream );
+   HASH( h, dtx->DisplayTraj );
+   HASH( h, dtx->DisplaySfcHWind );
+   HASH( h, dtx->DisplaySfcHStream );
+   HASH( h, dtx->CurrentVolume );
+   HASH( h, dtx->CurrentVolumeOwner );
+
+   /* per-variable graphics of each data context */
+   for (i=0;i<dtx->numofctxs;i++) {
+      Context ctx = dtx->ctxpointerarray[i];
+      int n = ctx->NumVars;
+
+      h = hash_bytes( h, ctx->DisplaySurf, n * sizeof(int) );
+      h = hash_bytes( h, ctx->DisplayHSlice, n * sizeof(int) );
+      h = hash_bytes( h, ctx->DisplayVSlice, n * sizeof(int) );
+      h = hash_bytes( h, ctx->DisplayCHSlice, n * sizeof(int) );
+      h = hash_bytes( h, ctx->DisplayCVSlice, n * sizeof(int) );
+      h = hash_bytes( h, ctx->DisplaySfcHSlice, n * sizeof(char) );
+   }
+   for (i=0;i<dtx->numofitxs;i++) {
+      HASH( h, dtx->itxpointerarray[i]->DisplayTextPlot );
+   }
+
+   return h;
+}
+
+
+
+/*
+ * Run-length encode n pixels from src into dst.  A header word with
+ * RLE_REPEAT set is followed by one pixel to repeat, otherwise it gives
+ * the number of literal pixels which follow.  dst must have room for
+ * n+1 words; if the encoding would be larger than n words, give up.
+ * Return:  number of words written or 0 if the data didn't compress.
+ */
+static int rle_encode( const uint_4 *src, int n, uint_4 *dst )
+{
+   int i = 0, out = 0;
+
+   while (i<n) {
+      int run = 1;
+      while (i+run<n && src[i+run]==src[i] && run<RLE_MAXRUN) {
+         run++;
+      }
+      if (run>=3) {
+         if (out+2>n) {
+            return 0;
+         }
+         dst[out++] = RLE_REPEAT | run;
+         dst[out++] = src[i];
+         i += run;
+      }
+      else {
+         /* gather literals until the next run of 3 or more */
+         int start = i, len;
+         while (i<n && !(i+2<n && src[i]==src[i+1] && src[i]==src[i+2])) {
+            i++;
+         }
+         len = i - start;
+         if (out+1+len>n) {
+            return 0;
+         }
+         dst[out++] = len;
+         memcpy( dst+out, src+start, len * sizeof(uint_4) );
+         out += len;
+      }
+   }
+   return out;
+}
+
+
+static void rle_decode( const uint_4 *src, int words, uint_4 *dst )
+{
+   int i = 0;
+
+   while (i<words) {
+      uint_4 hdr = src[i++];
+      if (hdr & RLE_REPEAT) {
+         uint_4 len = hdr & RLE_MAXRUN;
+         uint_4 p = src[i++];
+         while (len--) {
+            *dst++ = p;
+         }
+      }
+      else {
+         memcpy( dst, src+i, hdr * sizeof(uint_4) );
+         dst += hdr;
+         i += hdr;
+      }
+   }
+}
+
+
+
+static void unlink_frame( struct frame_cache *fc, struct frame *f )
+{
+   struct frame **p = &fc->bucket[f->key & (FRAME_HASH_SIZE-1)];
+
+   while (*p!=f) {
+      p = &(*p)->hnext;
+   }
+   *p = f->hnext;
+
+   if (f->prev) f->prev->next = f->next;
+   else         fc->head = f->next;
+   if (f->next) f->next->prev = f->prev;
+   else         fc->tail = f->prev;
+
+   fc->bytes -= f->words * sizeof(uint_4) + sizeof(struct frame);
+   fc->count--;
+}
+
+
+static void free_frame( struct frame_cache *fc, struct frame *f )
+{
+   unlink_frame( fc, f );
+   free( f->data );
+   free( f );
+}
+
+
+/* Move a frame to the head of the LRU list. */
+static void touch_frame( struct frame_cache *fc, struct frame *f )
+{
+   if (fc->head==f) {
+      return;
+   }
+   f->prev->next = f->next;
+   if (f->next) f->next->prev = f->prev;
+   else         fc->tail = f->prev;
+   f->prev = NULL;
+   f->next = fc->head;
+   fc->head->prev = f;
+   fc->head = f;
+}
+
+
+static struct frame *find_frame( struct frame_cache *fc,
+                                 unsigned long long key, int timestep,
+                                 int width, int height )
+{
+   struct frame *f;
+
+   for (f=fc->bucket[key & (FRAME_HASH_SIZE-1)]; f; f=f->hnext) {
+      if (f->key==key && f->timestep==timestep
+          && f->width==width && f->height==height) {
+         return f;
+      }
+   }
+   return NULL;
+}
+
+
+static size_t frame_budget( Display_Context dtx )
+{
+   return (size_t) dtx->FrameCacheMB * 1024 * 1024;
+}
+
+
+/* Make sure the scratch buffer holds at least n pixels. */
+static uint_4 *scratch_pixels( struct frame_cache *fc, int n )
+{
+   if (fc->npixels<n) {
+      free( fc->pixels );
+      fc->pixels = (uint_4 *) malloc( (n+1) * sizeof(uint_4) );
+      fc->npixels = fc->pixels ? n : 0;
+   }
+   return fc->pixels;
+}
 
 
 
@@ -58,12 +348,26 @@ extern void mesa_draw_image( XImage *img );
  */
 void init_anim( Display_Context dtx )
 {
-   int i;
+   if (dtx->FrameCache) {
+      invalidate_frames( dtx );
+      return;
+   }
+   dtx->FrameCache = (struct frame_cache *)
+                     calloc( 1, sizeof(struct frame_cache) );
+}
 
-   for (i=0;i<MAXTIMES;i++) {
-      dtx->cache[i] = NULL;
+
+/*
+ * Release the frame cache.
+ */
+void free_anim( Display_Context dtx )
+{
+   if (dtx->FrameCache) {
+      invalidate_frames( dtx );
+      free( dtx->FrameCache->pixels );
+      free( dtx->FrameCache );
+      dtx->FrameCache = NULL;
    }
-   dtx->all_invalid = 1;
 }
 
 
@@ -71,22 +375,35 @@ void init_anim( Display_Context dtx )
 
 /*
  * Invalidate all the frames in the cache.  This should be called when
- * the viewpoint changes, the selected graphics changes, or the window
- * size changes.
+ * the graphics themselves change (recomputed slices, new colors, etc).
+ * Changes to the viewpoint, window size or which graphics are displayed
+ * are part of the frame key and don't require invalidation.
  */
 void invalidate_frames( Display_Context dtx )
 {
-   int i;
+   struct frame_cache *fc = dtx->FrameCache;
 
-   if (!dtx->all_invalid) {
+   if (fc) {
+      while (fc->head) {
+         free_frame( fc, fc->head );
+      }
+   }
+}
 
-      for (i=0;i<MAXTIMES;i++) {
-         if (dtx->cache[i]) {
-            XDestroyImage( dtx->cache[i] );
-            dtx->cache[i] = NULL;
-         }
+
+/*
+ * Discard least recently used frames until the cache fits in its
+ * budget.
+ */
+void trim_frames( Display_Context dtx )
+{
+   struct frame_cache *fc = dtx->FrameCache;
+
+   if (fc) {
+      size_t budget = frame_budget( dtx );
+      while (fc->tail && fc->bytes>budget) {
+         free_frame( fc, fc->tail );
       }
-      dtx->all_invalid = 1;
    }
 }
 
@@ -101,17 +418,77 @@ void invalidate_frames( Display_Context dtx )
  */
 int save_frame( Display_Context dtx, int timestep )
 {
-   if (!dtx->cache[timestep]) {
-      printf("saving frame %d\n", timestep );
-#ifdef HAVE_XMESAGETBACKBUFFER
-      dtx->cache[timestep] = mesa_read_image();
+   struct frame_cache *fc = dtx->FrameCache;
+   struct frame *f;
+   unsigned long long key;
+   int w = dtx->WinWidth, h = dtx->WinHeight;
+   int n = w * h;
+   size_t size;
+   uint_4 *pixels, *packed;
+   int words;
+
+#ifndef HAVE_OPENGL
+   return 0;
 #endif
-      dtx->all_invalid = 0;
-      return 1;
+   if (!fc || n<=0 || dtx->FramesStale) {
+      return 0;
+   }
+   key = frame_key( dtx, timestep );
+   if (find_frame( fc, key, timestep, w, h )) {
+      return 0;
+   }
+
+   size = n * sizeof(uint_4) + sizeof(struct frame);
+   if (size>frame_budget( dtx )) {
+      return 0;
+   }
+
+   pixels = scratch_pixels( fc, 2*n );
+   if (!pixels) {
+      return 0;
+   }
+   read_3d_window_pixels( w, h, pixels );
+
+   f = (struct frame *) malloc( sizeof(struct frame) );
+   if (!f) {
+      return 0;
+   }
+
+   /* encode into the second half of the scratch buffer */
+   packed = pixels + n;
+   words = dtx->FrameCacheCompress ? rle_encode( pixels, n, packed ) : 0;
+   if (words>0) {
+      f->compressed = 1;
    }
    else {
+      f->compressed = 0;
+      packed = pixels;
+      words = n;
+   }
+   f->data = (uint_4 *) malloc( words * sizeof(uint_4) );
+   if (!f->data) {
+      free( f );
       return 0;
    }
+   memcpy( f->data, packed, words * sizeof(uint_4) );
+   f->key = key;
+   f->timestep = timestep;
+   f->width = w;
+   f->height = h;
+   f->words = words;
+
+   f->hnext = fc->bucket[key & (FRAME_HASH_SIZE-1)];
+   fc->bucket[key & (FRAME_HASH_SIZE-1)] = f;
+   f->prev = NULL;
+   f->next = fc->head;
+   if (fc->head) fc->head->prev = f;
+   else          fc->tail = f;
+   fc->head = f;
+   fc->bytes += words * sizeof(uint_4) + sizeof(struct frame);
+   fc->count++;
+
+   trim_frames( dtx );
+   return 1;
 }
 
 
@@ -123,15 +500,50 @@ int save_frame( Display_Context dtx, int timestep )
  */
 int get_frame( Display_Context dtx, int timestep )
 {
-   if (dtx->cache[timestep]) {
-      printf("drawing cached frame %d...\n", timestep );
-#ifdef HAVE_XMESAGETBACKBUFFER
-      mesa_draw_image( dtx->cache[timestep] );
+   struct frame_cache *fc = dtx->FrameCache;
+   struct frame *f;
+   int w = dtx->WinWidth, h = dtx->WinHeight;
+
+#ifndef HAVE_OPENGL
+   return 0;
 #endif
-      return 1;
+   if (dtx->FramesStale) {
+      /* the worker threads have produced new graphics */
+      dtx->FramesStale = 0;
+      invalidate_frames( dtx );
+      return 0;
    }
-   else {
+   if (!fc || !fc->head) {
       return 0;
    }
+   f = find_frame( fc, frame_key( dtx, timestep ), timestep, w, h );
+   if (!f) {
+      return 0;
+   }
+   touch_frame( fc, f );
+
+   if (f->compressed) {
+      uint_4 *pixels = scratch_pixels( fc, w * h );
+      if (!pixels) {
+         return 0;
+      }
+      rle_decode( f->data, f->words, pixels );
+      draw_3d_window_pixels( w, h, pixels );
+   }
+   else {
+      draw_3d_window_pixels( w, h, f->data );
+   }
+   return 1;
 }
 
+
+/*
+ * Return the number of frames and bytes held by the frame cache.
+ */
+void get_frame_cache_usage( Display_Context dtx, int *frames, PTRINT *bytes )
+{
+   struct frame_cache *fc = dtx->FrameCache;
+
+   *frames = fc ? fc->count : 0;
+   *bytes = fc ? (PTRINT) fc->bytes : 0;
+}
@@ -42,12 +42,19 @@
 
 extern void init_anim( Display_Context dtx );
 
+extern void free_anim( Display_Context dtx );
+
 extern void invalidate_frames( Display_Context dtx );
 
+extern void trim_frames( Display_Context dtx );
+
 extern int get_frame( Display_Context dtx, int timestep );
 
 extern int save_frame( Display_Context dtx, int timestep );
 
+extern void get_frame_cache_usage( Display_Context dtx, int *frames,
+                                   PTRINT *bytes );
+
 
 #endif
 
@@ -88,6 +88,7 @@
 #include "memory.h"
 #include "map.h"
 #include "misc.h"
+#include "parallel.h"
 #include "proj.h"
 #include "queue.h"
 #include "render.h"
@@ -96,8 +97,10 @@
 #include "soundingGUI.h"
 #include "sync.h"
 #include "tclsave.h"
+#include "timeseries.h"
 #include "traj.h"
 #include "topo.h"
+#include "trajset.h"
 #include "volume.h"
 #include "work.h"
 
@@ -310,6 +313,14 @@ static void destroy_irregular_context( Irregular_Context itx )
   for(n=0;n<itx->NumVars;n++)
 	 free(itx->Variable[n]);
 
+  free( itx->RecGeoPosition );
+  free( itx->NumRecs );
+  free( itx->RecordTable );
+  free( itx->TimeStamp );
+  free( itx->DayStamp );
+  free( itx->Elapsed );
+  free( itx->TextPlotTable );
+
   if (itx->mempool){
 	 free( itx->mempool );
   }
@@ -388,6 +399,14 @@ static void init_context( Context ctx )
    }
    
    ALLOC_SEM( ctx->ExtFuncDoneSem, 0 );
+   ALLOC_LOCK( ctx->HSliceCacheLock );
+   for (i=0;i<HSLICE_CACHE_SIZE;i++) {
+      ctx->HSliceCache[i].Timestep = -1;
+   }
+   ALLOC_LOCK( ctx->ColumnCacheLock );
+   for (i=0;i<COLUMN_CACHE_SIZE;i++) {
+      ctx->ColumnCache[i].Timestep = -1;
+   }
 
 
    /* MJK 12.01.98 */
@@ -689,6 +708,9 @@ static int init_display_context( Display_Context dtx ,int initXwindow)
    dtx->CurrentVolume = -1; 
    dtx->CurrentVolumeOwner = -1;
 
+   dtx->FrameCacheMB = DEFAULT_FRAMECACHE;
+   dtx->FrameCacheCompress = 1;
+
    dtx->Ax = dtx->Ay = dtx->Az = 0.0;
    dtx->PointerX = dtx->PointerY = -1;
    dtx->FirstArea = -1;
@@ -733,31 +755,7 @@ static int init_display_context( Display_Context dtx ,int initXwindow)
    dtx->Sound.soundline = NULL;
    dtx->Sound.uwindline = NULL;
    dtx->Sound.vwindline = NULL;
-   dtx->Sound.tgrid = NULL;
-   dtx->Sound.dgrid = NULL;
-   dtx->Sound.ugrid = NULL;
-   dtx->Sound.var1grid = NULL;
-   dtx->Sound.var2grid = NULL;
-   dtx->Sound.var3grid = NULL;
    dtx->Sound.vertdata = NULL;
-
-/* MJK 3.30.99 */
-   if (dtx->numofctxs>0){   
-      dtx->Sound.PreviousSoundTemp = vis5d_find_var(dtx->ctxarray[0],"T");
-      dtx->Sound.PreviousSoundDewpt= vis5d_find_var(dtx->ctxarray[0],"TD");
-      dtx->Sound.PreviousSoundUWind= vis5d_find_var(dtx->ctxarray[0],"U");
-      dtx->Sound.PreviousSoundVWind= vis5d_find_var(dtx->ctxarray[0],"V");
-   }
-   else{
-      dtx->Sound.PreviousSoundTemp =  -1;
-      dtx->Sound.PreviousSoundDewpt=  -1;
-      dtx->Sound.PreviousSoundUWind= -1;
-      dtx->Sound.PreviousSoundVWind= -1;
-   }
-
-   dtx->Sound.PreviousSoundVar1 = -1;
-   dtx->Sound.PreviousSoundVar2 = -1;
-   dtx->Sound.PreviousSoundVar3 = -1;
    dtx->Sound.sndx = 15;
    dtx->Sound.sndy = 15;
    dtx->init_flag = 1;
@@ -798,6 +796,7 @@ static int init_display_context( Display_Context dtx ,int initXwindow)
 static void destroy_context( Context ctx )
 {
   int i, j;
+  cancel_requests( ctx );
   /*  crashs 
   free_all_graphics( ctx );
   */
@@ -810,13 +809,21 @@ static void destroy_context( Context ctx )
 					sizeof(vslice_request));
 	 deallocate(ctx, ctx->Variable[j]->CHSliceRequest,
 					sizeof(hslice_request));
-			 
-	 free(ctx->Variable[j]);
   }
   
 	 free_volume(ctx);
 
+  free_hslice_cache( ctx );
+  free_column_cache( ctx );
   free_grid_cache( ctx );
+  free_ctx_projection_tables( ctx );
+  for(j=0;j<MAXVARS;j++){
+	 free_variable( ctx, j );
+  }
+  free( ctx->TimeStamp );
+  free( ctx->DayStamp );
+  free( ctx->Elapsed );
+  v5dFreeMcIDAS( &ctx->G );
 
 #ifdef CAVE
    if (cave_shmem) {
@@ -863,8 +870,14 @@ static void destroy_display_context( Display_Context dtx )
   }
 
 
+  if(dtx->TrajTable)
+	 free(dtx->TrajTable);
+
   if(dtx->topo)
 	 free_topo(&dtx->topo);
+  free_anim( dtx );
+  free_display_time_steps( dtx );
+  free_dtx_projection_tables( dtx );
   free( dtx );
 }
 
@@ -883,7 +896,9 @@ int vis5d_initialize( int cave_mode )
    int i;
 
    init_sync();
+   init_projection_tables();
    init_queue();
+   init_parallel();
    init_work();
 
    ALLOC_LOCK( GfxLock );
@@ -968,8 +983,10 @@ int vis5d_terminate( int close_windows )
 	
 	  if(grp_table){
 		 for(i=0;i<VIS5D_MAX_DPY_CONTEXTS;i++)
-			if(grp_table[i])
+			if(grp_table[i]){
+			  free(grp_table[i]->TimeStep);
 			  free(grp_table[i]);
+			}
 		 free(grp_table);
 	  }
 	  if(itx_table){
@@ -984,6 +1001,7 @@ int vis5d_terminate( int close_windows )
 
    terminate_work();
    terminate_queue();
+   terminate_parallel();
    term_sync();
    terminate_graphics();
 
@@ -1040,7 +1058,7 @@ int vis5d_do_work( void )
    if (NumThreads==1) {
       int size, waiters;
       get_queue_info( &size, &waiters );
-      if (size>0) {
+      if (size>0 || get_queued_preloads()>0) {
          do_one_task( 0 );
       }
    }
@@ -1067,12 +1085,29 @@ int vis5d_check_work( int *pending_flag )
 
 
 /*
- * Block until the job queue is empty.
+ * Have the worker threads been started yet?  That's done by the first
+ * vis5d_init_data_end(), after the data set has been assigned to its
+ * display.
+ */
+static int workers_started( void )
+{
+#if defined(HAVE_SGI_SPROC) || defined(HAVE_SUNOS_THREADS) || defined(HAVE_PTHREADS)
+   return WorkerPID[0]!=0;
+#else
+   return 0;
+#endif
+}
+
+
+
+/*
+ * Block until the job queue is empty.  Until the worker threads are
+ * started the work is done here, as with a single thread.
  */
 int vis5d_finish_work( void )
 {
-   int size, waiters;
-   if (NumThreads==1) {
+   int size, waiters, i;
+   if (NumThreads==1 || !workers_started()) {
       while (1) {
          get_queue_info( &size, &waiters );
          if (size==0) {
@@ -1091,6 +1126,18 @@ int vis5d_finish_work( void )
          }
       }
    }
+
+   /* no worker is using a replaced lookup table now */
+   for (i=0;ctx_table && i<VIS5D_MAX_CONTEXTS;i++) {
+      if (ctx_table[i]) {
+         trim_ctx_projection_tables( ctx_table[i] );
+      }
+   }
+   for (i=0;dtx_table && i<VIS5D_MAX_DPY_CONTEXTS;i++) {
+      if (dtx_table[i]) {
+         trim_dtx_projection_tables( dtx_table[i] );
+      }
+   }
    return 0;
 }
 
@@ -1270,6 +1317,30 @@ int vis5d_set_grp_var_values( int index )
 
 
                
+/*
+ * Mark the graphics of a variable at every time step for recomputing.
+ */
+static void invalidate_variable( Context ctx, int var )
+{
+   vis5d_variable *v = ctx->Variable[var];
+   int time;
+
+   for (time=0;time<ctx->MaxTimeSteps;time++) {
+      if (v->SurfTable[time])
+         v->SurfTable[time]->valid = 0;
+      if (v->HSliceTable[time])
+         v->HSliceTable[time]->valid = 0;
+      if (v->VSliceTable[time])
+         v->VSliceTable[time]->valid = 0;
+      if (v->CHSliceTable[time])
+         v->CHSliceTable[time]->valid = 0;
+      if (v->CVSliceTable[time])
+         v->CVSliceTable[time]->valid = 0;
+   }
+   ctx->dpy_ctx->Redraw = 1;
+}
+
+
 /* This will set the given display to belong to the group */
 /* specified by 'index_of_grp'.  If the group context does */
 /* not exist it will be created.  Note:   to make a display */
@@ -1311,29 +1382,18 @@ int vis5d_set_display_group( int index, int index_of_grp )
    if (index_of_grp < 1 || index_of_grp > 9){
       /* set the varmax's and varmin's back to old values */
       for (yo = 0; yo < dtx->numofctxs; yo++){
-         int time, vars;
+         int vars;
          ctx = vis5d_get_ctx(dtx->ctxarray[yo]);
          for(vars=0; vars < ctx->NumVars; vars++){
             ctx->Variable[vars]->MinVal = ctx->Variable[vars]->RealMinVal;
             ctx->Variable[vars]->MaxVal = ctx->Variable[vars]->RealMaxVal;
-            for (time=0;time<MAXTIMES;time++) {
-				  if(ctx->Variable[vars]->SurfTable[time])
-					 ctx->Variable[vars]->SurfTable[time]->valid = 0;
-
-					if(ctx->Variable[vars]->HSliceTable[time])
-					  ctx->Variable[vars]->HSliceTable[time]->valid = 0;
-
-               ctx->Variable[vars]->VSliceTable[time]->valid = 0;
-               ctx->Variable[vars]->CHSliceTable[time]->valid = 0;
-               ctx->Variable[vars]->CVSliceTable[time]->valid = 0;
-               ctx->dpy_ctx->Redraw = 1;
-            }
+            invalidate_variable( ctx, vars );
          }
       }
       for (yo = 0; yo < dtx->numofitxs; yo++){
          int time;
          itx = vis5d_get_itx(dtx->itxarray[yo]);
-         for (time=0;time<MAXTIMES;time++) {
+         for (time=0;time<itx->NumTimes;time++) {
             itx->TextPlotTable[time].valid = 0;
          }
       }
@@ -2112,6 +2172,7 @@ int vis5d_reset_display_context( int index )
    swap_3d_window();
    XUnmapWindow( GfxDpy, dtx->GfxWindow);
    tempwin = dtx->GfxWindow;
+   free_display_time_steps( dtx );
    memset( dtx, 0, sizeof(struct display_context) );
    dtx->GfxWindow = tempwin;
    init_display_context( dtx, 1);
@@ -2218,7 +2279,8 @@ int vis5d_get_num_of_ctxs_in_display( int index, int *number, int numarray[])
    int yo;
    Display_Context dtx;
 
-   if (index<0 || index>=VIS5D_MAX_DPY_CONTEXTS || (dtx = dtx_table[index])==NULL){
+   if (index<0 || index>=VIS5D_MAX_DPY_CONTEXTS || !dtx_table ||
+       (dtx = dtx_table[index])==NULL){
       *number = 0;
       return -1;
    }     
@@ -2643,6 +2705,8 @@ int setup_dtx( Display_Context dtx, int index )
    Context ctx;
    int yo, w;
 
+   /* let the workers finish with the old box, and its tables be freed */
+   vis5d_finish_work();
    make_box( dtx, 0.0, 0.0, 0.0);
    vis5d_load_topo_and_map( index );
    vis5d_set_hclip( index, 0, dtx->MaxNl-1);
@@ -3054,16 +3118,22 @@ int vis5d_init_display_values ( int index, int iindex, int display )
    }
 
    if (itx){
-      memset( itx->TextPlotTable, 0, sizeof(itx->TextPlotTable) );
+      memset( itx->TextPlotTable, 0,
+              itx->NumTimes * sizeof(struct textplot) );
    }
 
    memset(  dtx->DisplayTraj, 0, sizeof(dtx->DisplayTraj) );
    memset(  dtx->DisplayHWind, 0, sizeof(dtx->DisplayHWind) );
    memset(  dtx->DisplayVWind, 0, sizeof(dtx->DisplayVWind) );
    memset(  dtx->DisplayHStream, 0, sizeof(dtx->DisplayHStream) );
-   memset( dtx->HWindTable, 0, sizeof(dtx->HWindTable) );
-   memset( dtx->VWindTable, 0, sizeof(dtx->VWindTable) );
-   memset( dtx->TrajTable, 0, sizeof(dtx->TrajTable) );
+   for (i=0;i<VIS5D_WIND_SLICES;i++) {
+      memset( dtx->HWindTable[i], 0, dtx->MaxTimeSteps * sizeof(struct hwind) );
+      memset( dtx->VWindTable[i], 0, dtx->MaxTimeSteps * sizeof(struct vwind) );
+   }
+   memset( dtx->TrajSet, 0, sizeof(dtx->TrajSet) );
+   for (i=0;i<VIS5D_TRAJ_SETS;i++) {
+      dtx->TrajSet[i].colorvar = -1;
+   }
    memset(  dtx->DisplayVStream, 0, sizeof(dtx->DisplayVStream) );
    dtx->CurrentVolume = -1;
    dtx->CurrentVolumeOwner = -1;
@@ -3224,7 +3294,7 @@ int vis5d_init_display_values ( int index, int iindex, int display )
    if (ctx){
       compute_wind_levels(dtx); 
       for (var=0;var<VIS5D_WIND_SLICES;var++) {
-         for (time=0;time<MAXTIMES;time++) {
+         for (time=0;time<dtx->MaxTimeSteps;time++) {
             dtx->HWindTable[var][time].valid = 0;
             dtx->VWindTable[var][time].valid = 0;
             dtx->HStreamTable[var][time].valid = 0;
@@ -3299,26 +3369,7 @@ int vis5d_init_display_values ( int index, int iindex, int display )
    dtx->Sound.soundline = NULL;
    dtx->Sound.uwindline = NULL;
    dtx->Sound.vwindline = NULL;
-   dtx->Sound.tgrid = NULL;
-   dtx->Sound.dgrid = NULL;
-   dtx->Sound.ugrid = NULL;
-   dtx->Sound.var1grid = NULL;
-   dtx->Sound.var2grid = NULL;
-   dtx->Sound.var3grid = NULL;
    dtx->Sound.vertdata = NULL;
-
-   if (ctx){
-      dtx->Sound.PreviousSoundTemp = vis5d_find_var(dtx->ctxarray[0],"T");
-      dtx->Sound.PreviousSoundDewpt= vis5d_find_var(dtx->ctxarray[0],"TD");
-      dtx->Sound.PreviousSoundUWind= vis5d_find_var(dtx->ctxarray[0],"U");
-      dtx->Sound.PreviousSoundVWind= vis5d_find_var(dtx->ctxarray[0],"V");
-   }
-   else{
-      dtx->Sound.PreviousSoundTemp = -1;
-      dtx->Sound.PreviousSoundDewpt= -1;
-      dtx->Sound.PreviousSoundUWind= -1;
-      dtx->Sound.PreviousSoundVWind= -1;
-   }
    /***********/
    /* /|\ /|\ */
    /*  |   |  */
@@ -3488,6 +3539,103 @@ int vis5d_init_memory( int index, int mbs )
 }
 
 
+/*
+ * Return the memory pool accounting for one type of block.
+ * Input:  index - the context number
+ *         type - block type (see memory.h) or -1 for the pool totals
+ * Output:  name - the name of the type (at least 20 chars), may be NULL
+ *          bytes - bytes currently allocated
+ *          peak - largest number of bytes ever allocated
+ *          blocks - number of blocks currently allocated
+ *          allocs - number of allocations since the pool was set up
+ * Return:  0 = ok, VIS5D_BAD_CONSTANT if type is out of range.  Callers
+ *          may loop over type=0,1,2... until VIS5D_BAD_CONSTANT.
+ */
+int vis5d_get_memory_stats( int index, int type, char *name,
+                            long int *bytes, long int *peak,
+                            int *blocks, int *allocs )
+{
+   struct mem_type_stats st;
+   CONTEXT("vis5d_get_memory_stats");
+
+   if (!get_mem_stats( ctx, type, &st )) {
+      return VIS5D_BAD_CONSTANT;
+   }
+   if (name) {
+      strcpy( name, type<0 ? "total" : mem_type_name(type) );
+   }
+   *bytes = st.bytes;
+   *peak = st.peak;
+   *blocks = st.blocks;
+   *allocs = st.allocs;
+   return 0;
+}
+
+
+
+static FILE *memlog_file = NULL;
+static int memlog_interval = 0;
+static time_t memlog_last = 0;
+
+
+/*
+ * Periodically append the per-type memory report of every context to
+ * a file.  The report is written by vis5d_check_memory_log().
+ * Input:  filename - file to append to, "-" for stdout, NULL to stop
+ *         seconds - minimum interval between reports
+ */
+int vis5d_set_memory_log( const char *filename, int seconds )
+{
+   if (memlog_file && memlog_file!=stdout) {
+      fclose( memlog_file );
+   }
+   memlog_file = NULL;
+   memlog_interval = seconds>0 ? seconds : 1;
+   memlog_last = 0;
+
+   if (filename==NULL || filename[0]==0) {
+      return 0;
+   }
+   if (strcmp(filename,"-")==0) {
+      memlog_file = stdout;
+   }
+   else if ((memlog_file = fopen( filename, "a" ))==NULL) {
+      printf("Error: unable to open memory log %s\n", filename );
+      return VIS5D_FAIL;
+   }
+   return 0;
+}
+
+
+/*
+ * Write the memory report if the log is enabled and the interval has
+ * elapsed.  Cheap enough to call from the main event loop.
+ */
+int vis5d_check_memory_log( void )
+{
+   time_t now;
+   int i;
+
+   if (!memlog_file) {
+      return 0;
+   }
+   now = time(NULL);
+   if (now - memlog_last < memlog_interval) {
+      return 0;
+   }
+   memlog_last = now;
+
+   fprintf( memlog_file, "--- vis5d memory %s", ctime(&now) );
+   for (i=0;i<VIS5D_MAX_CONTEXTS;i++) {
+      if (ctx_table[i]) {
+         print_mem_stats( ctx_table[i], memlog_file );
+      }
+   }
+   fflush( memlog_file );
+   return 0;
+}
+
+
 /* if this function is called then same scale is set */
 /* and the vertical plot variables will be ploted all on the same scale */
 /****************************************/
@@ -4004,7 +4152,7 @@ static void initialize_irregular_stuff( Irregular_Context itx )
 {
    int time;
 
-   for (time = 0; time < MAXTIMES;time++) {
+   for (time = 0; time < itx->NumTimes;time++) {
       itx->TextPlotTable[time].valid = 0;
    }
 }
@@ -4282,6 +4430,8 @@ int vis5d_open_gridfile( int index, const char *name, int read_flag )
       dindex = ctx->dpy_ctx->dpy_context_index;
       dtx = vis5d_get_dtx( dindex );
       /* already have a dataset loaded, replace it with the new one */
+      /* once no background preload is reading the old one */
+      cancel_requests( ctx );
       v5dCloseFile( &ctx->G );
       free_all_graphics( ctx );
       init_context( ctx );
@@ -4600,8 +4750,8 @@ int vis5d_signal_group_redraw( int index, int time)
 int vis5d_set_probe_on_traj( int index, int time)
 {
    int endpoint;
-   int i, first_set, first_traj_of_set;
-   struct traj *t;
+   int i, first_set;
+   struct traj_set *s;
    DPY_CONTEXT("vis5d_set_probe_on_traj")
 
 
@@ -4622,24 +4772,20 @@ int vis5d_set_probe_on_traj( int index, int time)
    }
 
    /*** get first traj in the first set ***/
-   first_traj_of_set = -1;
-   for (i = 0; i < dtx->NumTraj; i++){
-      t = dtx->TrajTable[i];
-      if ( t->group == first_set){
-         first_traj_of_set = i;
-         i = dtx->NumTraj;
-      }
-   }
-   if (first_traj_of_set == -1){
+   s = &dtx->TrajSet[first_set];
+   wait_read_lock( &s->lock );
+   if (s->numtraj == 0){
+      done_read_lock( &s->lock );
       return 0;
    }
 
-   if (t->len[time] >= 1 ){
-      endpoint = t->start[time]+ t->len[time]-1;
-      dtx->CursorX = (float)(t->verts[endpoint*3+0]) / VERTEX_SCALE;
-      dtx->CursorY = (float)(t->verts[endpoint*3+1]) / VERTEX_SCALE;
-      dtx->CursorZ = (float)(t->verts[endpoint*3+2]) / VERTEX_SCALE;
+   endpoint = traj_endpoint( s, 0, time );
+   if (endpoint >= 0){
+      dtx->CursorX = (float)(s->verts[endpoint*3+0]) / VERTEX_SCALE;
+      dtx->CursorY = (float)(s->verts[endpoint*3+1]) / VERTEX_SCALE;
+      dtx->CursorZ = (float)(s->verts[endpoint*3+2]) / VERTEX_SCALE;
    }
+   done_read_lock( &s->lock );
    return 1;
 }
 
@@ -4665,6 +4811,7 @@ int vis5d_set_dtx_timestep( int index, int time )
          spandex = dtx->TimeStep[time].owners[yo];
          ctx = vis5d_get_ctx( spandex);
          ctx->CurTime = dtx->TimeStep[time].ownerstimestep[yo];
+         resume_preload( ctx );
       }
       else if (dtx->TimeStep[time].ownertype[yo] == IRREGULAR_TYPE){
          spandex = dtx->TimeStep[time].owners[yo];
@@ -5024,7 +5171,6 @@ int vis5d_get_ctx_var_range( int index, int var, float *min, float *max )
 /****************************************/
 int vis5d_set_var_range( int index, int var, float min, float max )
 {
-   int time;
    CONTEXT("vis5d_set_var_range")
    if (var>=0 && var<ctx->NumVars) {
 
@@ -5032,34 +5178,14 @@ int vis5d_set_var_range( int index, int var, float min, float max )
       if (min != ctx->Variable[var]->MinVal){
 
          ctx->Variable[var]->MinVal = min;
-         for (time=0;time<MAXTIMES;time++) {
-            ctx->Variable[var]->SurfTable[time]->valid = 0;
-
-				if(ctx->Variable[var]->HSliceTable[time])
-				  ctx->Variable[var]->HSliceTable[time]->valid = 0;
-
-            ctx->Variable[var]->VSliceTable[time]->valid = 0;
-            ctx->Variable[var]->CHSliceTable[time]->valid = 0;
-            ctx->Variable[var]->CVSliceTable[time]->valid = 0;
-            ctx->dpy_ctx->Redraw = 1;
-         }
+         invalidate_variable( ctx, var );
       }
 
       /* MJK 12.10.98 */
       if (max != ctx->Variable[var]->MaxVal){
 
          ctx->Variable[var]->MaxVal = max;
-         for (time=0;time<MAXTIMES;time++) {
-            ctx->Variable[var]->SurfTable[time]->valid = 0;
-
-				if(ctx->Variable[var]->HSliceTable[time])
-				  ctx->Variable[var]->HSliceTable[time]->valid = 0;
-
-            ctx->Variable[var]->VSliceTable[time]->valid = 0;
-            ctx->Variable[var]->CHSliceTable[time]->valid = 0;
-            ctx->Variable[var]->CVSliceTable[time]->valid = 0;
-            ctx->dpy_ctx->Redraw = 1;
-         }
+         invalidate_variable( ctx, var );
       }
       return 0;
    }
@@ -5588,7 +5714,16 @@ int vis5d_get_grid( int index, int time, int var, float *data )
    float *grid;
    CONTEXT("vis5d_get_grid");
 
+   if (var<0 || var>=ctx->NumVars) {
+      return VIS5D_BAD_VAR_NUMBER;
+   }
+   if (time<0 || time>=ctx->NumTimes) {
+      return VIS5D_BAD_TIME_STEP;
+   }
    grid = get_grid( ctx, time, var );
+   if (!grid) {
+      return VIS5D_FAIL;
+   }
    memcpy( data, grid, (PTRINT)ctx->Nr*(PTRINT)ctx->Nc*(PTRINT)ctx->Nl[var]*sizeof(float) );
    release_grid( ctx, time, var, grid );
    return 0;
@@ -5637,6 +5772,72 @@ int vis5d_get_grid_value( int index, int var,
 }
 
 
+/*
+ * Return a variable's values at a list of positions over a range of
+ * timesteps.  Each grid is read once, only around the positions, and
+ * the timesteps are spread over the worker threads.
+ * Input:  index - the context index
+ *         var - the variable
+ *         time0, numtimes - the first timestep and number of timesteps
+ *         numpoints - number of positions
+ *         points - array [numpoints][3] of row, column, level positions
+ * Output:  series - array [numtimes][numpoints] of values, MISSING at
+ *                   positions outside of the grid
+ */
+int vis5d_get_time_series( int index, int var, int time0, int numtimes,
+                           int numpoints, const float points[],
+                           float series[] )
+{
+   CONTEXT("vis5d_get_time_series");
+   if (var<0 || var>=ctx->NumVars) {
+      return VIS5D_BAD_VAR_NUMBER;
+   }
+   if (time0<0 || numtimes<0 || numtimes>ctx->NumTimes-time0) {
+      return VIS5D_BAD_TIME_STEP;
+   }
+   if (numpoints<0) {
+      return VIS5D_BAD_VALUE;
+   }
+   if (!get_time_series( ctx, var, time0, numtimes, numpoints, points,
+                         series )) {
+      return VIS5D_OUT_OF_MEMORY;
+   }
+   return 0;
+}
+
+
+/*
+ * Return a box of a variable's grid values over a range of timesteps,
+ * decompressing only the box of each grid.
+ * Input:  index - the context index
+ *         var - the variable
+ *         time0, numtimes - the first timestep and number of timesteps
+ *         row0, col0, lev0 - first row, column and level of the box,
+ *                            levels counted from the variable's lowest
+ *         nr, nc, nl - size of the box
+ * Output:  series - array [numtimes][nl][nc][nr] of values
+ */
+int vis5d_get_time_series_box( int index, int var, int time0, int numtimes,
+                               int row0, int col0, int lev0,
+                               int nr, int nc, int nl, float series[] )
+{
+   CONTEXT("vis5d_get_time_series_box");
+   if (var<0 || var>=ctx->NumVars) {
+      return VIS5D_BAD_VAR_NUMBER;
+   }
+   if (time0<0 || numtimes<0 || numtimes>ctx->NumTimes-time0) {
+      return VIS5D_BAD_TIME_STEP;
+   }
+   if (row0<0 || col0<0 || lev0<0 || nr<1 || nc<1 || nl<1 ||
+       nr>ctx->Nr-row0 || nc>ctx->Nc-col0 || nl>ctx->Nl[var]-lev0) {
+      return VIS5D_BAD_VALUE;
+   }
+   get_time_series_box( ctx, var, time0, numtimes, row0, col0, lev0,
+                        nr, nc, nl, series );
+   return 0;
+}
+
+
 /*
  * Control the VeryLarge flag.
  * Input:  index - context index
@@ -6053,6 +6254,9 @@ int vis5d_texture_image( int index, int timestep, int width, int height,
                          int components, void *image )
 {
    DPY_CONTEXT("vis5d_texture");
+   if (timestep<0 || timestep>=dtx->MaxTimeSteps) {
+      return VIS5D_BAD_TIME_STEP;
+   }
    define_texture( dtx, timestep, width, height, components, image );
    return 0;
 }
@@ -6278,7 +6482,6 @@ int vis5d_make_expr_var( int index, const char *expression, char *newname,
       vis5d_reset_var_graphics(ctx->context_index, *newvar);
       init_var_clrtable( index, ctx->context_index, *newvar);
       if (dtx->DisplaySound){
-         reload_sounding_data( dtx );
          do_pixmap_art ( dtx );
          draw_sounding(dtx , dtx->CurTime);
       }
@@ -6427,6 +6630,25 @@ int vis5d_draw_sounding_only( int index, int pixmapflag)
    return 0;
 }
 
+/*
+ * Draw a display's 3-D window and read its image back.
+ * Input:  index - the display context index
+ *         pixels - array of WinWidth*WinHeight pixels to fill, as packed
+ *                  RGBA bytes, bottom row first
+ */
+int vis5d_read_frame( int index, unsigned int pixels[] )
+{
+   DPY_CONTEXT("vis5d_read_frame");
+#ifdef HAVE_OPENGL
+   vis5d_draw_frame( index, 0 );
+   set_current_window( dtx );
+   read_3d_window_pixels( dtx->WinWidth, dtx->WinHeight, pixels );
+   return 0;
+#else
+   return VIS5D_FAIL;
+#endif
+}
+
 int vis5d_swap_frame( int index )
 {
    DPY_CONTEXT("vis5d_swap_frame");
@@ -6604,18 +6826,17 @@ int vis5d_graphics_mode( int index, int what, int mode )
       printf("bad value (%d) in vis5d_graphics_mode(what)\n", what);
       return VIS5D_BAD_CONSTANT;
   }
+  /* all of these flags are part of the stored frame key (anim.c) */
   switch (mode) {
     case VIS5D_OFF:
       if (*val != 0) {
         dtx->Redraw = 1;
-        vis5d_invalidate_dtx_frames(index);
       }
       *val = 0;
       break;
     case VIS5D_ON:
 		if(*val == 0) {
         dtx->Redraw = 1;
-        vis5d_invalidate_dtx_frames(index);
 		  *val = 1;
       }
       break;
@@ -6808,7 +7029,6 @@ int vis5d_enable_graphics( int index, int type, int number, int mode )
             ctx->dpy_ctx->CurrentVolume = -1;
             ctx->dpy_ctx->CurrentVolumeOwner = -1;
             ctx->dpy_ctx->Redraw = 1;
-            vis5d_invalidate_dtx_frames(index);
 				}
 
           break;
@@ -6820,7 +7040,6 @@ int vis5d_enable_graphics( int index, int type, int number, int mode )
             ctx->dpy_ctx->CurrentVolume = number;
             ctx->dpy_ctx->CurrentVolumeOwner = ctx->context_index;
             ctx->dpy_ctx->Redraw = 1;
-            vis5d_invalidate_dtx_frames(index);
           }
           break;
         case VIS5D_TOGGLE:
@@ -6837,7 +7056,6 @@ int vis5d_enable_graphics( int index, int type, int number, int mode )
             ctx->dpy_ctx->CurrentVolumeOwner = ctx->context_index;
           }
           ctx->dpy_ctx->Redraw = 1;
-          vis5d_invalidate_dtx_frames(index);
           break;
         case VIS5D_GET:
           break;
@@ -6864,25 +7082,23 @@ int vis5d_enable_graphics( int index, int type, int number, int mode )
     default:
       return VIS5D_BAD_CONSTANT;
   }
+  /* displayed graphics are part of the stored frame key (anim.c) */
   switch (mode) {
     case VIS5D_OFF:
       if (*val != 0) {
         ctx->dpy_ctx->Redraw = 1;
-        vis5d_invalidate_dtx_frames(ctx->dpy_ctx->dpy_context_index);
       }
       *val = 0;
       break;
     case VIS5D_ON:
       if (*val != 1) {
         ctx->dpy_ctx->Redraw = 1;
-        vis5d_invalidate_dtx_frames(ctx->dpy_ctx->dpy_context_index);
       }
       *val = 1;
       break;
     case VIS5D_TOGGLE:
       *val = *val ? 0 : 1;
       ctx->dpy_ctx->Redraw = 1;
-      vis5d_invalidate_dtx_frames(ctx->dpy_ctx->dpy_context_index);
       break;
     case VIS5D_GET:
       break;
@@ -7799,7 +8015,6 @@ int vis5d_set_matrix( int index, float ctm[4][4] )
 
    mat_copy(dtx->CTM, ctm);
    dtx->Redraw = 1;
-   vis5d_invalidate_dtx_frames(index);
    return 0;
 }
 
@@ -7865,7 +8080,7 @@ int vis5d_set_ortho_view( int index, int view )
    
    dtx->FrntClip = 0.0;
    dtx->Zoom = 1.0;
-   vis5d_invalidate_dtx_frames(index);
+   dtx->Redraw = 1;
 
    return 0;
 }
@@ -7881,7 +8096,6 @@ int vis5d_set_view( int index, float xrot, float yrot, float zrot,
 
    make_matrix( xrot, yrot, zrot, scale, xtrans, ytrans, ztrans, ctm );
    vis5d_set_matrix(index, ctm);
-   vis5d_invalidate_dtx_frames(index);
    return 0;
 }
 
@@ -8004,32 +8218,97 @@ int vis5d_get_isosurface_color_var( int index, int iso_var, int *cvowner, int *c
 }
 
 
+/*
+ * Copy an isosurface's triangle strips out in graphics coordinates.
+ * Input:  index - the context index
+ *         time, var - timestep and variable number
+ *         numverts, numindex - sizes of the arrays, if they're given
+ *         verts, norms, strips - arrays to fill, or NULL to get the sizes
+ * Output:  numverts - number of vertices, 0 if there's no surface
+ *          numindex - number of strip indexes
+ *          verts - array [numverts][3] of vertices
+ *          norms - array [numverts][3] of unit normals
+ *          strips - array [numindex] of vertex numbers, -1 between strips
+ * Return:  0 = ok, VIS5D_BAD_VALUE if the arrays are too small
+ */
+int vis5d_get_isosurface_mesh( int index, int time, int var,
+                               int *numverts, int *numindex,
+                               float verts[], float norms[], int strips[] )
+{
+   struct isosurface *surf;
+   int maxverts, maxindex, nv, ni, c, i;
+   CONTEXT("vis5d_get_isosurface_mesh");
+
+   if (var<0 || var>=ctx->NumVars) {
+      return VIS5D_BAD_VAR_NUMBER;
+   }
+   if (time<0 || time>=ctx->NumTimes) {
+      return VIS5D_BAD_TIME_STEP;
+   }
+   maxverts = *numverts;
+   maxindex = *numindex;
+   *numverts = *numindex = 0;
+   surf = ctx->Variable[var]->SurfTable[time];
+   if (!surf || !surf->valid) {
+      return 0;
+   }
+
+   wait_read_lock( &surf->lock );
+   nv = surf->valid ? surf->numverts : 0;
+   ni = 0;
+   for (c=0;c<surf->numchunks && nv;c++) {
+      ni += surf->chunks[c].numindex + (c>0);
+   }
+   *numverts = nv;
+   *numindex = ni;
+   if (verts && (nv>maxverts || ni>maxindex)) {
+      done_read_lock( &surf->lock );
+      return VIS5D_BAD_VALUE;
+   }
+   if (verts && nv) {
+      for (i=0;i<3*nv;i++) {
+         verts[i] = surf->verts[i] / VERTEX_SCALE;
+         norms[i] = surf->norms[i] / NORMAL_SCALE;
+      }
+      /* make the chunk relative indexes absolute */
+      ni = 0;
+      for (c=0;c<surf->numchunks;c++) {
+         struct iso_chunk *chunk = &surf->chunks[c];
+         if (c>0) {
+            strips[ni++] = -1;
+         }
+         for (i=0;i<chunk->numindex;i++) {
+            int k = surf->index[chunk->ibase+i];
+            strips[ni++] = (k==ISO_RESTART) ? -1 : chunk->vbase + k;
+         }
+      }
+   }
+   done_read_lock( &surf->lock );
+   return 0;
+}
+
+
 /*
  * Set the variable used to color a particular isosurface.
  */
 int vis5d_set_isosurface_color_var( int index, int iso_var, int cvowner, int colorvar )
 {
-   int var, time;
+   int time;
    CONTEXT("vis5d_set_isosurface_color_var");
    ctx->IsoColorVar[iso_var] = colorvar;
    ctx->IsoColorVarOwner[iso_var] = cvowner;
+   /* a change between coloring by this context and by another one
+      changes the timesteps the surfaces are stored by; keep their
+      geometry and only recolor them */
    if (index == cvowner){
       if (ctx->SameIsoColorVarOwner[iso_var] == 0){
-         for (var=0;var<ctx->NumVars;var++) {
-            for (time=0;time<ctx->dpy_ctx->NumTimes;time++) {
-               free_isosurface(ctx, time, var);
-            }
-         }
+         reindex_isosurfaces( ctx, iso_var, 0 );
       }
       ctx->SameIsoColorVarOwner[iso_var] = 1;
    }
    else{
       if (ctx->SameIsoColorVarOwner[iso_var] == 1){
-         for (var=0;var<ctx->NumVars;var++) {
-            for (time=0;time<ctx->dpy_ctx->NumTimes;time++) {
-               free_isosurface(ctx, time, var);
-            }
-         }
+         reindex_isosurfaces( ctx, iso_var, 1 );
       }
       ctx->SameIsoColorVarOwner[iso_var] = 0;
       ctx->WasSameIsoColorVarOwner[iso_var] = 0;
@@ -9367,61 +9646,56 @@ int vis5d_get_vstreamslice( int index, int ws, float *density,
 int vis5d_print_traj( int index, int traj_num, float lat[],
                       float lon[], float hgt[], float traj_value[])
 {
-   struct traj *t;
+   struct traj_set *s;
    float valscale, min,lt, ln, ht;
-   int i, endpoint;
+   int i, k, endpoint, colorvar;
    DPY_CONTEXT("vis5d_print_traj")
 
-   t = dtx->TrajTable[traj_num];
-   if (t->colorvar != -1){
+   LOCK_ON( TrajLock );
+   if (traj_num<0 || traj_num>=dtx->NumTraj) {
+      LOCK_OFF( TrajLock );
+      return VIS5D_BAD_VALUE;
+   }
+   s = &dtx->TrajSet[dtx->TrajTable[traj_num].group];
+   k = dtx->TrajTable[traj_num].index;
+   wait_read_lock( &s->lock );
+   LOCK_OFF( TrajLock );
+
+   colorvar = s->colors ? s->colorvar : -1;
+   valscale = min = 0.0F;
+   if (colorvar != -1){
       Context otherctx;
 
-      otherctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, t->colorvarowner)];
-      valscale = 1.0F / (otherctx->Variable[t->colorvar]->MaxVal - otherctx->Variable[t->colorvar]->MinVal);
-      min = otherctx->Variable[t->colorvar]->MinVal;
-      for (i = 0; i < dtx->NumTimes; i ++){
-         if (t->len[i] < 1){
-            lat[i] = 0.00;
-            lon[i] = 0.00;
-            hgt[i] = 0.00;
-            traj_value[i] = 0.00;
-         }
-         else{
-            endpoint = t->start[i]+ t->len[i]-1;
-            vis5d_xyzPRIME_to_geo( dtx->dpy_context_index, 0, dtx->Uvar[0],
-                           (float)(t->verts[endpoint*3+0]) / VERTEX_SCALE,
-                           (float)(t->verts[endpoint*3+1]) / VERTEX_SCALE,
-                           (float)(t->verts[endpoint*3+2]) / VERTEX_SCALE,
-                            &lt, &ln, &ht);
-            lat[i] = lt;
-            lon[i] = ln;
-            hgt[i] = ht;
-            traj_value[i] = ((float)((t->colors[endpoint]))/(valscale * 254.0F)) + min;
-         }
-      }
+      otherctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, s->colorvarowner)];
+      valscale = 1.0F / (otherctx->Variable[colorvar]->MaxVal - otherctx->Variable[colorvar]->MinVal);
+      min = otherctx->Variable[colorvar]->MinVal;
    }
-   else{
-      for (i = 0; i < dtx->NumTimes; i ++){
-         if (t->len[i] < 1){
-            lat[i] = 0.00;
-            lon[i] = 0.00;
-            hgt[i] = 0.00;
-            traj_value[i] = 0.00;
+   for (i = 0; i < dtx->NumTimes; i ++){
+      endpoint = traj_endpoint( s, k, i );
+      if (endpoint < 0){
+         lat[i] = 0.00;
+         lon[i] = 0.00;
+         hgt[i] = 0.00;
+         traj_value[i] = 0.00;
+      }
+      else{
+         vis5d_xyzPRIME_to_geo( dtx->dpy_context_index, 0, dtx->Uvar[0],
+                        (float)(s->verts[endpoint*3+0]) / VERTEX_SCALE,
+                        (float)(s->verts[endpoint*3+1]) / VERTEX_SCALE,
+                        (float)(s->verts[endpoint*3+2]) / VERTEX_SCALE,
+                         &lt, &ln, &ht);
+         lat[i] = lt;
+         lon[i] = ln;
+         hgt[i] = ht;
+         if (colorvar != -1){
+            traj_value[i] = ((float)((s->colors[endpoint]))/(valscale * 254.0F)) + min;
          }
          else{
-            endpoint = t->start[i] + t->len[i]-1;
-            vis5d_xyzPRIME_to_geo( dtx->dpy_context_index, 0, dtx->Uvar[0],
-                              (float)(t->verts[endpoint*3+0]) / VERTEX_SCALE,
-                              (float)(t->verts[endpoint*3+1]) / VERTEX_SCALE,
-                              (float)(t->verts[endpoint*3+2]) / VERTEX_SCALE,
-                               &lt, &ln, &ht);
-            lat[i] = lt;
-            lon[i] = ln;
-            hgt[i] = ht;
             traj_value[i] = 0;
          }
       }
    }
+   done_read_lock( &s->lock );
    return 0;
 }
 
@@ -9546,21 +9820,24 @@ int vis5d_get_traj_info( int index, int trajnum,
                          int *timestep, float *step, float *length,
                          int *group, int *ribbon )
 {
-   struct traj *t;
+   struct traj t;
    DPY_CONTEXT("vis5d_get_traj_info");
+   LOCK_ON( TrajLock );
    if (trajnum>=dtx->NumTraj) {
+      LOCK_OFF( TrajLock );
       return VIS5D_BAD_VALUE;
    }
    t = dtx->TrajTable[trajnum];
+   LOCK_OFF( TrajLock );
 
-   *row      = t->row;
-   *column   = t->col;
-   *level    = t->lev;
-   *timestep = t->timestep;
-   *step     = t->stepmult;
-   *length   = t->lengthmult;
-   *group    = t->group;
-   *ribbon   = t->kind;
+   *row      = t.row;
+   *column   = t.col;
+   *level    = t.lev;
+   *timestep = t.timestep;
+   *step     = t.stepmult;
+   *length   = t.lengthmult;
+   *group    = t.group;
+   *ribbon   = t.kind;
    return 0;
 }
 
@@ -10986,24 +11263,12 @@ int vis5d_set_all_invalid (int index)
 
 
 
-   for (var=0;var<MAXVARS;var++) {
-      for (time=0;time<MAXTIMES;time++) {
-         ctx->Variable[var]->SurfTable[time]->valid = 0;
-
-			if(ctx->Variable[var]->HSliceTable[time])
-			  ctx->Variable[var]->HSliceTable[time]->valid = 0;
-			if(ctx->Variable[var]->VSliceTable[time])
-			  ctx->Variable[var]->VSliceTable[time]->valid = 0;
-	  
-			if(ctx->Variable[var]->CHSliceTable[time])
-			  ctx->Variable[var]->CHSliceTable[time]->valid = 0;
-			if(ctx->Variable[var]->CVSliceTable[time])
-			  ctx->Variable[var]->CVSliceTable[time]->valid = 0;
-      }
+   for (var=0;var<ctx->NumVars;var++) {
+      invalidate_variable( ctx, var );
    }
 
    for (var=0;var<VIS5D_WIND_SLICES;var++) {
-      for (time=0;time<MAXTIMES;time++) {
+      for (time=0;time<ctx->dpy_ctx->MaxTimeSteps;time++) {
          ctx->dpy_ctx->HWindTable[var][time].valid = 0;
          ctx->dpy_ctx->VWindTable[var][time].valid = 0;
          ctx->dpy_ctx->HStreamTable[var][time].valid = 0;
@@ -11024,7 +11289,7 @@ int vis5d_set_all_irregular_invalid( int index )
    int time;
    IRG_CONTEXT("vis5d_set_all_irregular_invalid");
 
-   for (time = 0; time < MAXTIMES; time++){
+   for (time = 0; time < itx->NumTimes; time++){
       itx->TextPlotTable[time].valid = 0;
    }
    return 0;
@@ -11104,7 +11369,8 @@ int vis5d_assign_display_to_irregular_data( int index, int display_index)
    }
 
    if (dtx->numofitxs > 1){
-      memset( itx->TextPlotTable, 0, sizeof(itx->TextPlotTable) );
+      memset( itx->TextPlotTable, 0,
+              itx->NumTimes * sizeof(struct textplot) );
    }
 
    return 1;
@@ -11475,7 +11741,7 @@ int vis5d_set_text_plot( int index, int var, float spacing,
    IRG_CONTEXT("vis5d_set_text_plot");
    
    if (var != itx->TextPlotVar){
-      for (i = 0; i < MAXTIMES; i++){
+      for (i = 0; i < itx->NumTimes; i++){
          free_textplot( itx, i);
          itx->TextPlotTable[i].valid = 0;
       }
@@ -11899,6 +12165,32 @@ int vis5d_get_vstride(int index, int *vstride)
   return 0;
 }
 
+/*
+ * Set the memory budget for stored animation frames.
+ * Input:  megabytes - frame cache size, 0 disables the cache
+ *         compress - 1 = run-length encode frames, 0 = store raw pixels
+ */
+int vis5d_set_frame_cache(int index, int megabytes, int compress)
+{
+  DPY_CONTEXT("vis5d_set_frame_cache")
+  if (megabytes < 0) megabytes = 0;
+
+  dtx->FrameCacheMB = megabytes;
+  dtx->FrameCacheCompress = compress;
+  trim_frames( dtx );
+  return 0;
+}
+int vis5d_get_frame_cache(int index, int *megabytes, int *compress,
+                          int *frames, PTRINT *bytes)
+{
+  DPY_CONTEXT("vis5d_get_frame_cache")
+
+  *megabytes = dtx->FrameCacheMB;
+  *compress = dtx->FrameCacheCompress;
+  get_frame_cache_usage( dtx, frames, bytes );
+  return 0;
+}
+
 
 
 // TODO:
@@ -443,6 +443,15 @@ extern int vis5d_init_vertical( int index, int vertical,
 
 extern int vis5d_init_memory( int index, int mbs );
 
+extern int vis5d_get_memory_stats( int index, int type, char *name,
+                                   long int *bytes, long int *peak,
+                                   int *blocks, int *allocs );
+
+extern int vis5d_set_memory_log( const char *filename, int seconds );
+
+extern int vis5d_check_memory_log( void );
+
+
 extern int vis5d_init_samescale( int index );
 
 /* MJK 4.27.99 */
@@ -597,6 +606,15 @@ extern int vis5d_get_grid_value( int index, int var,
                                  float row, float column, float level,
                                  float *value );
 
+extern int vis5d_get_time_series( int index, int var, int time0,
+                                  int numtimes, int numpoints,
+                                  const float points[], float series[] );
+
+extern int vis5d_get_time_series_box( int index, int var, int time0,
+                                      int numtimes, int row0, int col0,
+                                      int lev0, int nr, int nc, int nl,
+                                      float series[] );
+
 
 extern int vis5d_verylarge_mode( int index, int mode );
 
@@ -676,6 +694,8 @@ extern int vis5d_draw_2d_only( int index );
 
 extern int vis5d_draw_sounding_only( int index, int pixmapflag);
 
+extern int vis5d_read_frame( int index, unsigned int pixels[] );
+
 extern int vis5d_swap_frame( int index );
 
 extern int vis5d_invalidate_grp_frames( int index );
@@ -829,6 +849,11 @@ extern int vis5d_set_isosurface_color_var( int index, int iso_var,
 extern int vis5d_get_isosurface_color_var( int index, int iso_var,
                                            int *cvowner, int *colorvar );
 
+extern int vis5d_get_isosurface_mesh( int index, int time, int var,
+                                      int *numverts, int *numindex,
+                                      float verts[], float norms[],
+                                      int strips[] );
+
 
 extern int vis5d_make_hslice( int index, int time, int var,
                                      int urgent );
@@ -1291,6 +1316,9 @@ int vis5d_set_maxtmesh(int index, int maxtmesh);
 int vis5d_get_maxtmesh(int index, int *maxtmesh);
 int vis5d_set_vstride(int index, int vstride);
 int vis5d_get_vstride(int index, int *vstride);
+int vis5d_set_frame_cache(int index, int megabytes, int compress);
+int vis5d_get_frame_cache(int index, int *megabytes, int *compress,
+                          int *frames, long int *bytes);
 
 time_t vis5d_time2ctime(int daystamp, int timestamp);
 
@@ -59,6 +59,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #ifdef _CRAY
 #  include <string.h>
@@ -931,12 +932,13 @@ int IsLittleEndian(void) {
 
 /******************************************************************************
   FUNCTION: SwapEndian
-  PURPOSE: Swap the byte order of a structure
+  PURPOSE: Swap the byte order of a structure, in place so that several
+           threads may read v5d headers at once
   EXAMPLE: float F=123.456;; SWAP_FLOAT(F);
 ******************************************************************************/
 
 void *SwapEndian(void* Addr, const int Nb) {
-	static char Swapped[16];
+	char Swapped[16];
 	switch (Nb) {
 		case 2:	Swapped[0]=*((char*)Addr+1);
 				Swapped[1]=*((char*)Addr  );
@@ -977,6 +979,9 @@ void *SwapEndian(void* Addr, const int Nb) {
 				Swapped[14]=*((char*)Addr+1);
 				Swapped[15]=*((char*)Addr  );
 				break;
+		default:
+				return Addr;
 	}
-	return (void*)Swapped;
+	memcpy(Addr, Swapped, Nb);
+	return Addr;
 }
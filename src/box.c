@@ -454,7 +454,8 @@ static void make_sphere_box( Display_Context dtx )
 
 /*
  * Compute the graphics bounds Xmin, Xmax, Ymin then construct the box
- * graphics.
+ * graphics.  This is redone by setup_dtx() and after every change of the
+ * projection or vertical system, so it bumps dtx->GeometryGeneration.
  */
 void make_box( Display_Context dtx, float ax, float ay, float az )
 {
@@ -691,6 +692,9 @@ void make_box( Display_Context dtx, float ax, float ay, float az )
       default:
          printf("Error in setup_box\n");
    }
+
+   /* graphics made for the old bounds (stored wind arrows) are stale */
+   dtx->GeometryGeneration++;
 }
 
 
@@ -41,9 +41,113 @@
 #include "api.h"
 #include "globals.h"
 #include "chrono.h"
+#include "grid.h"
+#include "queue.h"
 #include "vis5d.h"
 
 
+/*
+ * Grow a table of oldn entries of the given size to newn entries,
+ * zeroing the new ones.
+ * Return:  the table, or NULL if out of memory and the old one is kept
+ */
+void *grow_time_table( void *table, int oldn, int newn, int size )
+{
+   char *t;
+
+   t = (char *) realloc( table, (size_t) newn * size );
+   if (t) {
+      memset( t + (size_t) oldn * size, 0, (size_t) (newn-oldn) * size );
+   }
+   return t;
+}
+
+
+
+/*
+ * Make room for numtimes steps in the display's timeline, texture and
+ * wind slice tables, keeping what is already there.  The tables may move,
+ * see grow_time_steps().
+ * Return:  1 = ok, 0 = out of memory
+ */
+int alloc_display_time_steps( Display_Context dtx, int numtimes )
+{
+   int n, w;
+   void *t;
+
+   n = dtx->MaxTimeSteps;
+   if (numtimes <= n) {
+      return 1;
+   }
+
+#define GROW( TABLE, TYPE )                                       \
+   t = grow_time_table( TABLE, n, numtimes, sizeof(TYPE) );       \
+   if (!t) {                                                      \
+      return 0;                                                   \
+   }                                                              \
+   TABLE = t;
+
+   /* all the tables keep n entries until the last one has grown */
+   GROW( dtx->TimeStep, struct dpy_timestep )
+   GROW( dtx->TimeStamp, int )
+   GROW( dtx->DayStamp, int )
+   GROW( dtx->Elapsed, int )
+   GROW( dtx->TexWidth, int )
+   GROW( dtx->TexHeight, int )
+   GROW( dtx->TexComponents, int )
+   GROW( dtx->TexImage, unsigned char * )
+   GROW( dtx->TexImageNew, int )
+   for (w=0; w<VIS5D_WIND_SLICES; w++) {
+      GROW( dtx->HWindTable[w], struct hwind )
+      GROW( dtx->VWindTable[w], struct vwind )
+      GROW( dtx->HStreamTable[w], struct hstream )
+      GROW( dtx->VStreamTable[w], struct vstream )
+   }
+#undef GROW
+
+   dtx->MaxTimeSteps = numtimes;
+   return 1;
+}
+
+
+
+/*
+ * Free the display's timeline, texture and wind slice tables, but not
+ * the graphics or images they point to.
+ */
+void free_display_time_steps( Display_Context dtx )
+{
+   int w;
+
+   free( dtx->TimeStep );
+   free( dtx->TimeStamp );
+   free( dtx->DayStamp );
+   free( dtx->Elapsed );
+   dtx->TimeStep = NULL;
+   dtx->TimeStamp = dtx->DayStamp = dtx->Elapsed = NULL;
+   free( dtx->TexWidth );
+   free( dtx->TexHeight );
+   free( dtx->TexComponents );
+   free( dtx->TexImage );
+   free( dtx->TexImageNew );
+   dtx->TexWidth = dtx->TexHeight = dtx->TexComponents = NULL;
+   dtx->TexImage = NULL;
+   dtx->TexImageNew = NULL;
+   for (w=0; w<VIS5D_WIND_SLICES; w++) {
+      free( dtx->HWindTable[w] );
+      free( dtx->VWindTable[w] );
+      free( dtx->HStreamTable[w] );
+      free( dtx->VStreamTable[w] );
+      dtx->HWindTable[w] = NULL;
+      dtx->VWindTable[w] = NULL;
+      dtx->HStreamTable[w] = NULL;
+      dtx->VStreamTable[w] = NULL;
+   }
+   dtx->MaxTimeSteps = 0;
+}
+
+
+
 int not_duplicate_timestep( Display_Context dtx, int tcount)
 {
    int icr, dex;
@@ -133,6 +237,44 @@ void create_elapsed_times( Display_Context dtx )
 }
 
 
+/*
+ * Make room for numtimes steps in the tables of a display and of its
+ * contexts.  The tables may move, and worker threads index them without
+ * locks, so any queued work is finished first, background preloads are
+ * held and the graphics are locked while they grow.
+ * Return:  1 = ok, 0 = out of memory
+ */
+static int grow_time_steps( Display_Context dtx, int numtimes )
+{
+   int yo, grow, ok;
+
+   grow = dtx->MaxTimeSteps < numtimes;
+   for (yo=0; yo < dtx->numofctxs; yo++){
+      if (dtx->ctxpointerarray[yo]->MaxTimeSteps < numtimes){
+         grow = 1;
+      }
+   }
+   if (!grow){
+      return 1;
+   }
+
+   vis5d_finish_work();
+   hold_preloads();
+   LOCK_ON( GfxLock );
+   ok = alloc_display_time_steps( dtx, numtimes );
+   for (yo=0; ok && yo < dtx->numofctxs; yo++){
+      /* isosurfaces colored by another context are kept by display time */
+      ok = alloc_variable_time_steps( dtx->ctxpointerarray[yo], numtimes );
+   }
+   LOCK_OFF( GfxLock );
+   release_preloads();
+   for (yo=0; yo < dtx->numofctxs; yo++){
+      resume_preload( dtx->ctxpointerarray[yo] );
+   }
+   return ok;
+}
+
+
 void calculate_display_time_steps( Display_Context dtx )
 {
    int erly_day, erly_sec;
@@ -147,6 +289,7 @@ void calculate_display_time_steps( Display_Context dtx )
    int itx_numtimes[VIS5D_MAX_CONTEXTS];
    int itx_time_position[VIS5D_MAX_DPY_CONTEXTS];
    int itxday, itxsec;
+   int numtimes, ok;
 
 
    /********************************************/
@@ -185,6 +328,21 @@ void calculate_display_time_steps( Display_Context dtx )
    }
 
 
+   /* the timeline has at most one step per context time step */
+   numtimes = 0;
+   for (yo=0; yo < dtx->numofctxs; yo++){
+      numtimes += ctx_numtimes[dtx->ctxarray[yo]];
+   }
+   for (yo=0; yo < dtx->numofitxs; yo++){
+      numtimes += itx_numtimes[dtx->itxarray[yo]];
+   }
+   ok = grow_time_steps( dtx, numtimes );
+   if (!ok){
+      printf("Error: out of memory.  Couldn't allocate %d display time steps.\n",
+             numtimes );
+      return;
+   }
+
    erly_day = erly_sec = 10000000;
    timecount = 0;
 
@@ -34,6 +34,12 @@
 
 #include "globals.h"
 
+extern void *grow_time_table( void *table, int oldn, int newn, int size );
+
+extern int alloc_display_time_steps( Display_Context dtx, int numtimes );
+
+extern void free_display_time_steps( Display_Context dtx );
+
 extern void calculate_display_time_steps( Display_Context dtx );
 
 
@@ -40,8 +40,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
 #include "memory.h"
 #include "globals.h"
+#include "parallel.h"
+#include "sync.h"
 
 
 
@@ -58,6 +63,7 @@
 
 #define G( R, C )           ( g[ (C) * nr + (R) ] )
 #define MARK( R, C )        ( mark[ (C) * nr + (R) ] )
+#define EMPTY( R, C )       ( empty[ (C) * nr + (R) ] )
 
 
 
@@ -630,195 +636,248 @@ static int plotdigits( float gg, float xk, float yk, float xm, float ym,
 
 #endif
 
+
+
+/* Codes put in the bin array by bin_column() besides level bins */
+#define BIN_NONE   INT_MIN       /* missing or too close to a level */
+#define BIN_BELOW  (INT_MIN+1)   /* below lowlimit */
+#define BIN_ABOVE  (INT_MIN+2)   /* above highlimit */
+
 /*
- * Compute contour lines for a 2-D array.  If the interval is negative,
- * then negative contour lines will be drawn as dashed lines.
- * The contour lines will be computed for all V such that:
- *           lowlimit <= V <= highlimit
- *     and   V = base + n*interval  for some integer n
- * Note that the input array, g, should be in column-major (FORTRAN) order.
- *
- * Input:  g - the 2-D array to contour.
- *         nr, nc - size of 2-D array in rows and columns.
- *         interval - the interval between contour lines.
- *         lowlimit - the lower limit on values to contour.
- *         highlimit - the upper limit on values to contour.
- *         base - base value to start contouring at.
- *         vx1, vy1 - arrays to put contour line vertices
- *         maxv1 - size of vx1, vy1 arrays
- *         numv1 - pointer to int to return number of vertices in vx1,vy1
- *         vx2, vy2 - arrays to put 'hidden' contour line vertices
- *         maxv2 - size of vx2, vy2 arrays
- *         numv2 - pointer to int to return number of vertices in vx2,vy2
- *         vx3, vy3 - arrays to put contour label vertices
- *         maxv3 - size of vx3, vy3 arrays
- *         numv3 - pointer to int to return number of vertices in vx3,vy3
- * Return:  1 = ok
- *          0 = error  (interval==0.0 or out of memory)
+ * Classify the points of one grid column by the pair of contour levels
+ * they lie between.  A point gets level bin n when it is strictly inside
+ * (base+n*interval, base+(n+1)*interval) by more than the float rounding
+ * contour() can accumulate in its level values; points nearer a level
+ * than that get BIN_NONE.
+ * Input:  g - one column of the 2-D array, nr values.
+ *         interval - positive contour interval.
+ *         lowlimit, highlimit, base - as for contour().
+ * Output:  bin - one code per point.
  */
-int contour( Context ctx, float g[], int nr, int nc,
-             float interval, float lowlimit, float highlimit,
-             float base,
-             float vx1[], float vy1[],  int maxv1, int *numv1,
-             float vx2[], float vy2[],  int maxv2, int *numv2,
-             float vx3[], float vy3[],  int maxv3, int *numv3
-#ifdef USE_SYSTEM_FONTS
-				 ,char *labels
-#endif
-				 )
+static void bin_column( const float g[], int nr, float interval,
+                        float lowlimit, float highlimit, float base,
+                        int bin[] )
 {
-   register int ir, ic;
-   int nrm, ncm, idash;
-   int numc, il;
-   int ffex, ffey, lr, lc, lc2, lrr, lr2, lcc;
-   float xd, yd ,xx, yy;
-   float clow, chi;
-   float gg;
-   float *vx, *vy;
-   int *ipnt;
-   int nump, ip;
-   register int numv;
-   char *mark;
-	int domark;
+   const double rinterval = 1.0 / interval;
+   const double slack = 1.0e-4 + 32.0 * FLT_EPSILON;
+   const double scale = 32.0 * FLT_EPSILON * rinterval;
+   const double absbase = fabs( base );
+   int i;
 
-   /* MJK 12.10.98 */
-   char         lbl_str[10], lbl_fmt[40];
-   int          lbl_len, lbl_dot;
-   int use_resize;
+   for (i=0;i<nr;i++) {
+      double t, f, margin;
+      int k;
+      float v = g[i];
 
-   /* Dynamically allocate temp. arrays, to avoid using excessive
-      stack space and crashing on some systems.  It's not going to be
-      appreciably slower, since the caller (calc_hslice or
-      calc_vslice) calls malloc at least 6 times anyway. calc_hslice
-      and calc_vslice determine maxv1 & maxv2 based on an upper bound
-      for the number of vertices derived from the code below. */
-   const int maxtemp = maxv1 > maxv2 ? maxv1 : maxv2;
-   vx = (float*) malloc(sizeof(float)*maxtemp);
-   vy = (float*) malloc(sizeof(float)*maxtemp);
-   ipnt = (int*) malloc(sizeof(int)*((nr-1)*(nc-1) + 1)); /* see below loop */
-   if (!vx || !vy || !ipnt) {
-      fprintf(stderr, "You do not have enough memory to create contours.\n");
-      free(vx); free(vy); free(ipnt);
-      return 0;
+      if (v > 1.e30) {
+         bin[i] = BIN_NONE;
+      }
+      else if (v < lowlimit) {
+         bin[i] = BIN_BELOW;
+      }
+      else if (v > highlimit) {
+         bin[i] = BIN_ABOVE;
+      }
+      else {
+         t = ((double) v - base) * rinterval;
+         margin = slack + scale * (fabs( (double) v ) + absbase);
+         if (t > -1.0e6 && t < 1.0e6 && margin < 0.25) {
+            /* k = floor(t) */
+            k = (int) t;
+            if (t < k) k--;
+            f = t - k;
+            if (f > margin && f < 1.0-margin) {
+               bin[i] = k;
+               continue;
+            }
+         }
+         bin[i] = BIN_NONE;
+      }
    }
+}
 
-   use_resize = 0;
-   ffex = ffey = 0;
-#ifndef USE_SYTEM_FONTS
-   if (ctx->dpy_ctx->ContFontFactorX != 0 ||
-       ctx->dpy_ctx->ContFontFactorY != 0){
-      use_resize = 1;
+
+/*
+ * Flag the grid boxes which no contour line can cross: those whose four
+ * corners are all between the same two levels or all beyond the same
+ * contouring limit.  This lets contour_band() skip them with one byte
+ * test instead of computing clow/chi for each box.
+ * Input:  g - the 2-D array to contour, column-major.
+ *         nr, nc - size of 2-D array in rows and columns.
+ *         row0, row1 - only flag the boxes in rows [row0,row1).
+ *         interval, lowlimit, highlimit, base - as for contour().
+ *         bin - workspace of 2*(row1-row0+1) ints.
+ * Output:  empty - nr*nc flags indexed like g, 1 = no line in box.
+ */
+static void find_empty_boxes( const float g[], int nr, int nc,
+                              int row0, int row1,
+                              float interval, float lowlimit,
+                              float highlimit, float base,
+                              int bin[], char empty[] )
+{
+   const int n = row1 - row0 + 1;
+   int *b0 = bin, *b1 = bin + n, *tmp;
+   int ir, ic, k;
+
+   bin_column( g+row0, n, interval, lowlimit, highlimit, base, b0 );
+   for (ic=0;ic<nc-1;ic++) {
+      bin_column( g+(ic+1)*nr+row0, n, interval, lowlimit, highlimit, base,
+                  b1 );
+      for (ir=0;ir<n-1;ir++) {
+         k = b0[ir];
+         empty[ic*nr+row0+ir] = (k!=BIN_NONE && k==b0[ir+1]
+                                 && k==b1[ir] && k==b1[ir+1]);
+      }
+      tmp = b0;  b0 = b1;  b1 = tmp;
    }
-#endif
+}
 
-   /* initialize vertex counts */
-   *numv1 = *numv2 = *numv3 = 0;
 
-   /* deduct 100 vertices from maxv3 now to save a later computation */
-   maxv3 -= 100;
 
-   if (interval==0.0) {
-      /* bad contour interval */
-      free(vx); free(vy); free(ipnt);
-      return 0;
-   }
-   if (interval<0.0) {
-      /* draw negative contour lines as dashed lines */
-      interval = -interval;
-      idash = 1;
-   }
-   else {
-      idash = 0;
-   }
+/*
+ * A slice is contoured in bands of rows which can be computed in parallel
+ * by the worker threads.  Each band collects its line vertices on its own;
+ * contour() then places labels and concatenates the bands in scan order,
+ * so the result does not depend on how many threads took part.
+ */
+#define MAX_CONTOUR_BANDS   32
+#define CONTOUR_BAND_BOXES  16384   /* min boxes per band */
 
-   nrm = nr-1;
-   ncm = nc-1;
 
-   xd = (XMAX-XMIN)/(nr-1);
-   yd = (YMAX-YMIN)/(nc-1);
+/* A box with contour lines in it */
+struct contour_box {
+   int row, col;            /* the box's lower left grid point */
+   int start;               /* index of its first vertex in the band */
+   int nlev;                /* number of vertices of its lowest line */
+   float level;             /* value of its lowest line */
+};
 
-   /*
-    * set up mark array
-    * mark= 0 if avail for label center,
-    *       2 if in label, and
-    *       1 if not available and not in label
-    *
-    * lr and lc give label size in grid boxes
-    * lrr and lcc give unavailable radius
-    */
-   lr = 1+(nr-2)/50;
-   lc = 1+(nc-2)/10;
 
-   if (use_resize){
-      ffex = ctx->dpy_ctx->ContFontFactorX;
-      ffey = ctx->dpy_ctx->ContFontFactorY;
+/* A band of rows of boxes */
+struct contour_band {
+   int row0, row1;                /* rows of boxes [row0,row1) */
+   float *vx, *vy;                /* line vertices */
+   int numv, maxv;
+   struct contour_box *boxes;     /* boxes with lines, in scan order */
+   int numboxes;
+   int error;                     /* out of memory */
+};
 
-      if (ffey+lr > 0 && ffey+lr < nr-3 &&
-          ffex+lc > 0 && ffex+lc < nc-3){
-         lr += ffey;
-         lc += ffex;
-      }
-   }
 
-   lc2 = lc/2;
-   lr2 = lr/2;
-   lrr = 1+(nr-2)/8;
-   lcc = 1+(nc-2)/8;
+/* What the bands of one contour() call share */
+struct contour_job {
+   const float *g;
+   int nr, nc;
+   float interval, lowlimit, highlimit, base;
+   int idash;
+   float xd, yd;
+   int maxtemp;                   /* max vertices per band */
+   char *empty;                   /* see find_empty_boxes() */
+   int numbands;
+   struct contour_band band[MAX_CONTOUR_BANDS];
+};
 
-   sprintf (lbl_str, "%4g", interval);
 
-   lbl_len = strlen (lbl_str);
-   while (lbl_str[--lbl_len] == '0') if (lbl_len == 0) break;
-   lbl_dot = 0;
-   if (lbl_len > 0)
-   {
-      while (lbl_str[lbl_len--] != '.')
-      {
-         if (lbl_len < 0) break;
-         lbl_dot++;
-      }
-   }
-   sprintf (lbl_fmt, "%%.%df", lbl_dot);
 
-   /* allocate mark array */
-   mark = (char *) allocate( ctx, nr * nc * sizeof(char) );
-   if (!mark) {
-      free(vx); free(vy); free(ipnt);
+/*
+ * Enlarge the vertex arrays of a band to hold at least need vertices.
+ * Return:  1 = ok, 0 = out of memory.
+ */
+static int grow_band_vertices( struct contour_band *band, int need,
+                               int limit )
+{
+   int maxv = band->maxv ? 2*band->maxv : 4096;
+   float *vx, *vy;
+
+   if (maxv < need)  maxv = need;
+   if (maxv > limit)  maxv = limit;
+   vx = (float *) realloc( band->vx, maxv*sizeof(float) );
+   if (vx)  band->vx = vx;
+   vy = (float *) realloc( band->vy, maxv*sizeof(float) );
+   if (vy)  band->vy = vy;
+   if (!vx || !vy) {
+      band->error = 1;
       return 0;
    }
+   band->maxv = maxv;
+   return 1;
+}
 
-   /* initialize mark array to zeros */
-   memset( mark, 0, nr*nc*sizeof(char) );
 
-   /* set top and bottom rows to 1 */
-   for (ic=0;ic<nc;ic++) {
-      for (ir=0;ir<lr;ir++) {
-         MARK(ir,ic) = 1;
-         MARK(nr-1-ir,ic) = 1;
-      }
-   }
 
-   /* set left and right columns to 1 */
-   for (ir=0;ir<nr;ir++) {
-      for (ic=0;ic<lc;ic++) {
-         MARK(ir,ic) = 1;
-         MARK(ir,nc-1-ic) = 1;
-      }
+/*
+ * Compute the contour line vertices in one band of rows of boxes, without
+ * labels.  Box by box and level by level this is the same computation as
+ * contour() has always done, so the vertices are bit-identical.
+ * Input:  job - the contour() call.
+ *         band - band to compute, with row0, row1 set.
+ * Output:  band - vertices and the list of boxes with lines.
+ */
+static void contour_band( struct contour_job *job, struct contour_band *band )
+{
+   const float *g = job->g;
+   const int nr = job->nr;
+   const int ncm = job->nc - 1;
+   const float interval = job->interval;
+   const float lowlimit = job->lowlimit;
+   const float highlimit = job->highlimit;
+   const float base = job->base;
+   const int idash = job->idash;
+   const float xd = job->xd;
+   const float yd = job->yd;
+   const int maxtemp = job->maxtemp;
+   const char *empty = job->empty;
+   register int ir, ic;
+   int numc, il, first, *bin;
+   struct contour_box *box;
+   float xx, yy;
+   float clow, chi;
+   float gg;
+   float *vx, *vy;
+   register int numv;
+   int maxv;
+
+   band->vx = band->vy = NULL;
+   band->boxes = NULL;
+   band->numv = band->maxv = 0;
+   band->numboxes = 0;
+   band->error = 0;
+
+   bin = (int *) malloc( 2*(band->row1-band->row0+1)*sizeof(int) );
+   if (!bin) {
+      band->error = 1;
+      return;
    }
+   find_empty_boxes( g, nr, job->nc, band->row0, band->row1, interval,
+                     lowlimit, highlimit, base, bin, job->empty );
+   free( bin );
+
+   /* start with this band's share of the vertices; the arrays are
+      enlarged if the lines are unevenly spread over the bands */
+   band->boxes = (struct contour_box *)
+      malloc( ((band->row1-band->row0)*ncm+1)*sizeof(struct contour_box) );
+   if (!band->boxes ||
+       !grow_band_vertices( band, (int) ((double) maxtemp *
+                            (band->row1-band->row0) / (nr-1)) + 1024,
+                            maxtemp )) {
+      band->error = 1;
+      return;
+   }
+   vx = band->vx;
+   vy = band->vy;
+   maxv = band->maxv;
+   numv = 0;
+   box = band->boxes;
 
-   numv = nump = 0;
-
-   /* compute contours */
-
-   for (ir=0; ir<nrm && numv<maxtemp-8 && nump<2*maxtemp; ir++) {
+   for (ir=band->row0; ir<band->row1 && numv<maxtemp-8; ir++) {
       xx = xd*ir+XMIN;
-      for (ic=0; ic<ncm && numv<maxtemp-8 && nump<2*maxtemp; ic++) {
+      for (ic=0; ic<ncm && numv<maxtemp-8; ic++) {
          float ga, gb, gc, gd;
          float gv, gn, gx;
          register float tmp1, tmp2;
 
-         /* save index of first vertex in this grid box */
-         ipnt[nump++] = numv;
+         /* skip box if no contour line can cross it */
+         if (EMPTY(ir,ic)) continue;
 
          yy = yd*ic+YMIN;
 
@@ -864,6 +923,7 @@ int contour( Context ctx, float g[], int nr, int nc,
 
          /* gg is current contour line value */
          gg = clow;
+         first = 1;
 
          for (il=0; il<numc && numv+8<maxtemp; il++, gg += interval) {
             float gba, gca, gdb, gdc;
@@ -884,78 +944,23 @@ int contour( Context ctx, float g[], int nr, int nc,
             if (ii > 7) ii = 15 - ii;
             if (ii <= 0) continue;
 
-            /* DO LABEL HERE*/
-            if (MARK(ir,ic)==0) {
-               int kc, kr, mc, mr, jc, jr;
-               float xk, yk, xm, ym, value;
-
-               /* Insert a label */
-
-               /* BOX TO AVOID */
-               kc = ic-lc2-lcc;
-               kr = ir-lr2-lrr;
-               mc = kc+2*lcc+lc-1;
-               mr = kr+2*lrr+lr-1;
-               /* OK here */
-					/*  JPE: This controls the density of plot labels */
-					for (jc=MAX2(kc,0);jc<MIN2(mc+1,nc);jc++){
-					  for(jr=MAX2(kr,0);jr<MIN2(mr+1,nr);jr++){
-						 if (MARK(jr,jc) != 2) {
-							MARK(jr,jc) = 1;
-						 }
-					  }
-					}
-					
-               /* BOX TO HOLD LABEL */
-               kc = ic-lc2;
-               kr = ir-lr2;
-               mc = kc+lc-1;
-               mr = kr+lr-1;
-               
-					/* JPE - we've already done this - why again? */
-               sprintf (lbl_str, lbl_fmt, gg);
-               lbl_len = strlen (lbl_str);
-
-               if (lbl_len+ffex >= 1){
-                  lbl_len += ffex;
+            if (numv+8 > maxv) {
+               if (!grow_band_vertices( band, numv+8, maxtemp )) {
+                  return;
                }
+               vx = band->vx;
+               vy = band->vy;
+               maxv = band->maxv;
+            }
+
+            /* remember the lowest line of the box, for its label */
+            if (first) {
+               box->row = ir;
+               box->col = ic;
+               box->start = numv;
+               box->level = gg;
+            }
 
-               if (((lbl_dot) || (gg < 0.0)) && (lbl_len > 2)) lbl_len--;
-               kc = ic - (lbl_len / 2);
-               mc = kc + lbl_len - 1;
-					for(jc=MAX2(0,kc);jc<MIN2(mc+1,nc);jc++){
-					  for(jr=MAX2(kr,0);jr<MIN2(mr+1,nr);jr++){
-						 MARK(jr,jc) = 2;
-					  }
-					}
-
-               xk = xd*kr+XMIN;
-               yk = yd*kc+YMIN;
-               xm = xd*(mr+1.0)+XMIN;
-               ym = yd*(mc+1.0)+YMIN;
-
-               value = gg;
-
-               if (*numv3 < maxv3) {
-                  /* if there's room in the array, plot the label */
-                  if (use_resize){
-                     *numv3 += plot_label_wierd( lbl_str, xk, yk, xm, ym,
-                                        vx3+(*numv3), vy3+(*numv3) );
-                  }
-                  else{
-#ifdef USE_SYSTEM_FONTS
-						  if(lbl_str){
-							 domark=1;
-						  }
-#else
-						  *numv3 += plot_label( lbl_str, xk, yk, xm, ym,
-												vx3+(*numv3), vy3+(*numv3) );
-#endif
-						  
-                  }
-               }
-            } /*MATCHES: if(MARK(ic,jc)==0) */
-				
             switch (ii) {
                case 1:
                   gba = gb-ga;
@@ -1121,63 +1126,377 @@ int contour( Context ctx, float g[], int nr, int nc,
                vx[numv-1] = (vxa+3.0*vxb) * 0.25;
                vy[numv-1] = (vya+3.0*vyb) * 0.25;
             }
-#ifdef USE_SYSTEM_FONTS
-				if(MARK(ir,ic)==2){
-				  if(domark){
-					 lbl_len=strlen(lbl_str);
-					 sprintf(labels,"%s",lbl_str);
-					 labels+=lbl_len+1;
-					 vx3[(*numv3)]= (vx[numv-2]<vx[numv-1]) ?
-						vx[numv-2] + 0.5 *(vx[numv-1]-vx[numv-2]) :
-						vx[numv-1] + 0.5 *(vx[numv-2]-vx[numv-1]) ;
-					 vy3[(*numv3)++]= (vy[numv-2]<vy[numv-1]) ?
-						vy[numv-2] + 0.2*(vy[numv-1]-vy[numv-2]) :
-						vy[numv-1] + 0.2*(vy[numv-2]-vy[numv-1]) ;
-					 domark=0;
-				  }
-				}
-#endif
+            if (first) {
+               box->nlev = numv - box->start;
+               box++;
+               first = 0;
+            }
          }  /* for il */    /* NOTE:  gg incremented in for statement */
 
       }  /* for ic */
 
    }  /* for ir */
 
-   ipnt[nump] = numv;
+   band->numv = numv;
+   band->numboxes = box - band->boxes;
+}
 
-   /* copy vertices from vx, vy arrays to either v1 or v2 arrays */
-   ip = 0;
-   for (ir=0;ir<nrm && ip<2*maxtemp;ir++) {
-      for (ic=0;ic<ncm && ip<2*maxtemp;ic++) {
-         int start, len;
-         start = ipnt[ip];
-         len = ipnt[ip+1] - start;
-         if (len>0) {
-            if (MARK(ir,ic)==2) {
-               if (*numv2+len<maxv2) {
-                  memcpy( vx2+(*numv2), vx+start, len*sizeof(float) );
-                  memcpy( vy2+(*numv2), vy+start, len*sizeof(float) );
-                  *numv2 += len;
+
+
+/* Contour one band of a contour job, see run_parallel_job() */
+static void contour_band_part( void *data, int part )
+{
+   struct contour_job *job = (struct contour_job *) data;
+
+   contour_band( job, &job->band[part] );
+}
+
+
+
+/*
+ * Compute contour lines for a 2-D array.  If the interval is negative,
+ * then negative contour lines will be drawn as dashed lines.
+ * The contour lines will be computed for all V such that:
+ *           lowlimit <= V <= highlimit
+ *     and   V = base + n*interval  for some integer n
+ * Note that the input array, g, should be in column-major (FORTRAN) order.
+ *
+ * Input:  g - the 2-D array to contour.
+ *         nr, nc - size of 2-D array in rows and columns.
+ *         interval - the interval between contour lines.
+ *         lowlimit - the lower limit on values to contour.
+ *         highlimit - the upper limit on values to contour.
+ *         base - base value to start contouring at.
+ *         vx1, vy1 - arrays to put contour line vertices
+ *         maxv1 - size of vx1, vy1 arrays
+ *         numv1 - pointer to int to return number of vertices in vx1,vy1
+ *         vx2, vy2 - arrays to put 'hidden' contour line vertices
+ *         maxv2 - size of vx2, vy2 arrays
+ *         numv2 - pointer to int to return number of vertices in vx2,vy2
+ *         vx3, vy3 - arrays to put contour label vertices
+ *         maxv3 - size of vx3, vy3 arrays
+ *         numv3 - pointer to int to return number of vertices in vx3,vy3
+ * Return:  1 = ok
+ *          0 = error  (interval==0.0 or out of memory)
+ */
+int contour( Context ctx, float g[], int nr, int nc,
+             float interval, float lowlimit, float highlimit,
+             float base,
+             float vx1[], float vy1[],  int maxv1, int *numv1,
+             float vx2[], float vy2[],  int maxv2, int *numv2,
+             float vx3[], float vy3[],  int maxv3, int *numv3
+#ifdef USE_SYSTEM_FONTS
+				 ,char *labels
+#endif
+				 )
+{
+   register int ir, ic;
+   int nrm, ncm, idash;
+   int ffex, ffey, lr, lc, lc2, lrr, lr2, lcc;
+   float xd, yd;
+   float gg;
+   int numv, ib, k;
+   char *mark;
+#ifdef USE_SYSTEM_FONTS
+   float *vx, *vy;
+   int domark = 0;
+#endif
+   struct contour_job job;
+   struct contour_band *band;
+
+   /* MJK 12.10.98 */
+   char         lbl_str[64], lbl_fmt[40];
+   int          lbl_len, lbl_dot;
+   int use_resize;
+
+   /* Each band allocates its vertex arrays as it needs them, up to
+      maxtemp vertices.  calc_hslice and calc_vslice determine maxv1 &
+      maxv2 based on an upper bound for the number of vertices derived
+      from the code in contour_band(). */
+   const int maxtemp = maxv1 > maxv2 ? maxv1 : maxv2;
+
+   use_resize = 0;
+   ffex = ffey = 0;
+#ifndef USE_SYTEM_FONTS
+   if (ctx->dpy_ctx->ContFontFactorX != 0 ||
+       ctx->dpy_ctx->ContFontFactorY != 0){
+      use_resize = 1;
+   }
+#endif
+
+   /* initialize vertex counts */
+   *numv1 = *numv2 = *numv3 = 0;
+
+   /* deduct 100 vertices from maxv3 now to save a later computation */
+   maxv3 -= 100;
+
+   if (interval==0.0) {
+      /* bad contour interval */
+      return 0;
+   }
+   if (interval<0.0) {
+      /* draw negative contour lines as dashed lines */
+      interval = -interval;
+      idash = 1;
+   }
+   else {
+      idash = 0;
+   }
+
+   nrm = nr-1;
+   ncm = nc-1;
+
+   xd = (XMAX-XMIN)/(nr-1);
+   yd = (YMAX-YMIN)/(nc-1);
+
+   /*
+    * set up mark array
+    * mark= 0 if avail for label center,
+    *       2 if in label, and
+    *       1 if not available and not in label
+    *
+    * lr and lc give label size in grid boxes
+    * lrr and lcc give unavailable radius
+    */
+   lr = 1+(nr-2)/50;
+   lc = 1+(nc-2)/10;
+
+   if (use_resize){
+      ffex = ctx->dpy_ctx->ContFontFactorX;
+      ffey = ctx->dpy_ctx->ContFontFactorY;
+
+      if (ffey+lr > 0 && ffey+lr < nr-3 &&
+          ffex+lc > 0 && ffex+lc < nc-3){
+         lr += ffey;
+         lc += ffex;
+      }
+   }
+
+   lc2 = lc/2;
+   lr2 = lr/2;
+   lrr = 1+(nr-2)/8;
+   lcc = 1+(nc-2)/8;
+
+   sprintf (lbl_str, "%4g", interval);
+
+   lbl_len = strlen (lbl_str);
+   while (lbl_str[--lbl_len] == '0') if (lbl_len == 0) break;
+   lbl_dot = 0;
+   if (lbl_len > 0)
+   {
+      while (lbl_str[lbl_len--] != '.')
+      {
+         if (lbl_len < 0) break;
+         lbl_dot++;
+      }
+   }
+   sprintf (lbl_fmt, "%%.%df", lbl_dot);
+
+   /* allocate mark array */
+   mark = (char *) allocate( ctx, nr * nc * sizeof(char) );
+   if (!mark) {
+      return 0;
+   }
+
+   /* initialize mark array to zeros */
+   memset( mark, 0, nr*nc*sizeof(char) );
+
+   /* set top and bottom rows to 1 */
+   for (ic=0;ic<nc;ic++) {
+      for (ir=0;ir<lr;ir++) {
+         MARK(ir,ic) = 1;
+         MARK(nr-1-ir,ic) = 1;
+      }
+   }
+
+   /* set left and right columns to 1 */
+   for (ir=0;ir<nr;ir++) {
+      for (ic=0;ic<lc;ic++) {
+         MARK(ir,ic) = 1;
+         MARK(ir,nc-1-ic) = 1;
+      }
+   }
+
+   /* divide the boxes into bands of rows */
+   job.numbands = 1;
+#ifdef SEMAPHORE
+   if (NumThreads > 2) {
+      job.numbands = (nrm*ncm) / CONTOUR_BAND_BOXES;
+      if (job.numbands > 2*(NumThreads-1))  job.numbands = 2*(NumThreads-1);
+      if (job.numbands > MAX_CONTOUR_BANDS)  job.numbands = MAX_CONTOUR_BANDS;
+      if (job.numbands > nrm)  job.numbands = nrm;
+      if (job.numbands < 1)  job.numbands = 1;
+   }
+#endif
+   for (ib=0;ib<job.numbands;ib++) {
+      job.band[ib].row0 = (int) ((long) nrm * ib / job.numbands);
+      job.band[ib].row1 = (int) ((long) nrm * (ib+1) / job.numbands);
+   }
+
+   job.g = g;
+   job.nr = nr;
+   job.nc = nc;
+   job.interval = interval;
+   job.lowlimit = lowlimit;
+   job.highlimit = highlimit;
+   job.base = base;
+   job.idash = idash;
+   job.xd = xd;
+   job.yd = yd;
+   job.maxtemp = maxtemp;
+   job.empty = (char *) malloc( nr*nc );
+   if (!job.empty) {
+      fprintf(stderr, "You do not have enough memory to create contours.\n");
+      deallocate( ctx, mark, nr * nc * sizeof(char) );
+      return 0;
+   }
+
+   /* compute contours */
+   run_parallel_job( ctx, contour_band_part, &job, job.numbands );
+
+   numv = 0;
+   for (ib=0;ib<job.numbands;ib++) {
+      if (job.band[ib].error) {
+         fprintf(stderr, "You do not have enough memory to create contours.\n");
+         numv = -1;
+         break;
+      }
+   }
+
+   /* place the labels in scan order */
+   for (ib=0;ib<job.numbands && numv>=0;ib++) {
+      band = &job.band[ib];
+#ifdef USE_SYSTEM_FONTS
+      vx = band->vx;
+      vy = band->vy;
+#endif
+      for (k=0;k<band->numboxes;k++) {
+         ir = band->boxes[k].row;
+         ic = band->boxes[k].col;
+         gg = band->boxes[k].level;
+
+         /* a box gets a label on its lowest line if it is still free */
+         if (MARK(ir,ic)==0) {
+            int kc, kr, mc, mr, jc, jr;
+            float xk, yk, xm, ym;
+
+            /* Insert a label */
+
+            /* BOX TO AVOID */
+            kc = ic-lc2-lcc;
+            kr = ir-lr2-lrr;
+            mc = kc+2*lcc+lc-1;
+            mr = kr+2*lrr+lr-1;
+            /*  JPE: This controls the density of plot labels */
+            for (jc=MAX2(kc,0);jc<MIN2(mc+1,nc);jc++){
+               for(jr=MAX2(kr,0);jr<MIN2(mr+1,nr);jr++){
+                  if (MARK(jr,jc) != 2) {
+                     MARK(jr,jc) = 1;
+                  }
+               }
+            }
+
+            /* BOX TO HOLD LABEL */
+            kc = ic-lc2;
+            kr = ir-lr2;
+            mc = kc+lc-1;
+            mr = kr+lr-1;
+
+            sprintf (lbl_str, lbl_fmt, gg);
+            lbl_len = strlen (lbl_str);
+
+            if (lbl_len+ffex >= 1){
+               lbl_len += ffex;
+            }
+
+            if (((lbl_dot) || (gg < 0.0)) && (lbl_len > 2)) lbl_len--;
+            kc = ic - (lbl_len / 2);
+            mc = kc + lbl_len - 1;
+            for(jc=MAX2(0,kc);jc<MIN2(mc+1,nc);jc++){
+               for(jr=MAX2(kr,0);jr<MIN2(mr+1,nr);jr++){
+                  MARK(jr,jc) = 2;
                }
             }
-            else {
-               if (*numv1+len<maxv1) {
-                  memcpy( vx1+(*numv1), vx+start, len*sizeof(float) );
-                  memcpy( vy1+(*numv1), vy+start, len*sizeof(float) );
-                  *numv1 += len;
+
+            xk = xd*kr+XMIN;
+            yk = yd*kc+YMIN;
+            xm = xd*(mr+1.0)+XMIN;
+            ym = yd*(mc+1.0)+YMIN;
+
+            if (*numv3 < maxv3) {
+               /* if there's room in the array, plot the label */
+               if (use_resize){
+                  *numv3 += plot_label_wierd( lbl_str, xk, yk, xm, ym,
+                                              vx3+(*numv3), vy3+(*numv3) );
+               }
+               else{
+#ifdef USE_SYSTEM_FONTS
+                  domark=1;
+#else
+                  *numv3 += plot_label( lbl_str, xk, yk, xm, ym,
+                                        vx3+(*numv3), vy3+(*numv3) );
+#endif
                }
             }
+         }
+
+#ifdef USE_SYSTEM_FONTS
+         /* the label goes at the last segment of the box's lowest line */
+         if (MARK(ir,ic)==2 && domark) {
+            numv = band->boxes[k].start + band->boxes[k].nlev;
+            lbl_len=strlen(lbl_str);
+            sprintf(labels,"%s",lbl_str);
+            labels+=lbl_len+1;
+            vx3[(*numv3)]= (vx[numv-2]<vx[numv-1]) ?
+               vx[numv-2] + 0.5 *(vx[numv-1]-vx[numv-2]) :
+               vx[numv-1] + 0.5 *(vx[numv-2]-vx[numv-1]) ;
+            vy3[(*numv3)++]= (vy[numv-2]<vy[numv-1]) ?
+               vy[numv-2] + 0.2*(vy[numv-1]-vy[numv-2]) :
+               vy[numv-1] + 0.2*(vy[numv-2]-vy[numv-1]) ;
+            domark=0;
+         }
+#endif
+      }
+   }
 
+   /* copy vertices from the bands to either v1 or v2 arrays */
+   for (ib=0;ib<job.numbands && numv>=0;ib++) {
+      band = &job.band[ib];
+      for (k=0;k<band->numboxes;k++) {
+         int start, len;
+         ir = band->boxes[k].row;
+         ic = band->boxes[k].col;
+         start = band->boxes[k].start;
+         if (k+1<band->numboxes)
+            len = band->boxes[k+1].start - start;
+         else
+            len = band->numv - start;
+         if (MARK(ir,ic)==2) {
+            if (*numv2+len<maxv2) {
+               memcpy( vx2+(*numv2), band->vx+start, len*sizeof(float) );
+               memcpy( vy2+(*numv2), band->vy+start, len*sizeof(float) );
+               *numv2 += len;
+            }
+         }
+         else {
+            if (*numv1+len<maxv1) {
+               memcpy( vx1+(*numv1), band->vx+start, len*sizeof(float) );
+               memcpy( vy1+(*numv1), band->vy+start, len*sizeof(float) );
+               *numv1 += len;
+            }
          }
-         ip++;
       }
    }
 
    /* deallocate mark array */
    deallocate( ctx, mark, nr * nc * sizeof(char) );
 
-   free(vx); free(vy); free(ipnt);
+   for (ib=0;ib<job.numbands;ib++) {
+      free( job.band[ib].vx );
+      free( job.band[ib].vy );
+      free( job.band[ib].boxes );
+   }
+   free( job.empty );
 
-   return 1;
+   return numv>=0;
 }
-
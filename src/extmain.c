@@ -126,6 +126,7 @@ static int call_user_function( int sock )
    char names[MAXVARS][8];
    int error_flag;
    int outnl, outlowlev;
+   int inid, outid, shared;
 
    /*** First we get the parameter which won't change for each timestep ***/
 
@@ -186,10 +187,36 @@ static int call_user_function( int sock )
    }
 */
 
+   /* Vis5D offers shared memory segments for the grids, since we
+    * acknowledged with EXT_ACK_SHM.  The input grids are then mapped
+    * read-only and the result is written straight into the output
+    * segment, so no grid data goes through the socket.
+    */
+   receive_int( sock, &inid );
+   receive_int( sock, &outid );
+   ingrid = outgrid = NULL;
+   if (inid>=0) {
+#ifdef LIB_MCIDAS
+      ingrid = (float *) attach_shared_block( inid, 0 );
+#else
+      ingrid = (float *) attach_shared_block( inid, 1 );
+#endif
+      outgrid = (float *) attach_shared_block( outid, 0 );
+      if (!ingrid || !outgrid) {
+         detach_shared_block( ingrid );
+         detach_shared_block( outgrid );
+         ingrid = outgrid = NULL;
+      }
+      send_int( sock, ingrid!=NULL );
+   }
+   shared = (ingrid!=NULL);
+
    /* allocate dynamic arrays */
    /*printf("EXTMAIN: Nr=%d Nc=%d Nl=%d NumVars=%d\n", Nr, Nc, Nl, NumVars );*/
-   ingrid = (float *) malloc( Nr*Nc*MaxNl*NumVars*sizeof(float) );
-   outgrid = (float *) malloc( Nr*Nc*MaxNl*sizeof(float) );
+   if (!shared) {
+      ingrid = (float *) malloc( (size_t) Nr*Nc*MaxNl*NumVars*sizeof(float) );
+      outgrid = (float *) malloc( (size_t) Nr*Nc*MaxNl*sizeof(float) );
+   }
    if (!ingrid || !outgrid) {
       printf("External Function Error: out of memory\n");
       send_int( sock, -1 );
@@ -236,9 +263,12 @@ static int call_user_function( int sock )
 /*         printf("EXTMAIN: file = %d\n", mcfile );*/
 /*         printf("EXTMAIN: grid = %d\n", mcgrid );*/
 
-         if (mcfile==0 && mcgrid==0) {
+         if (mcfile==0 && mcgrid==0 && shared) {
+            /* Vis5D already put the grid in the input segment */
+         }
+         else if (mcfile==0 && mcgrid==0) {
             /* Vis5D is sending us the grid data. */
-            receive_data( sock, ingrid+iv*Nr*Nc*MaxNl,
+            receive_data( sock, ingrid+(size_t) iv*Nr*Nc*MaxNl,
                           Nr*Nc*Nl[iv]*sizeof(float) );
          }
 #ifdef LIB_MCIDAS
@@ -284,13 +314,21 @@ static int call_user_function( int sock )
          send_int( sock, outnl );
          send_int( sock, outlowlev );
          /* we used to return compressed data...oh well */
-         send_data( sock, outgrid, Nr*Nc*outnl*sizeof(float) );
+         if (!shared) {
+            send_data( sock, outgrid, Nr*Nc*outnl*sizeof(float) );
+         }
       }
 
    }
 
-   free(ingrid);
-   free(outgrid);
+   if (shared) {
+      detach_shared_block( ingrid );
+      detach_shared_block( outgrid );
+   }
+   else {
+      free(ingrid);
+      free(outgrid);
+   }
    return 1;
 }
 
@@ -328,7 +366,7 @@ F77_FUNC(main0,MAIN0)()
    sock = create_socket( argv[1] );
    if (sock>=0) {
       /* send an acknowledgment signal */
-      send_int( sock, 0x1234 );
+      send_int( sock, EXT_ACK_SHM );
       /* call user function */
       call_user_function( sock );
       /* finish up */
@@ -55,6 +55,9 @@
 //#define PTRINT int
 #define PTRINT long int
 
+/* number of size classes in the memory pool allocator (memory.c) */
+#define MEM_BINS 192
+
 /*** Data types ***/
 #if SIZEOF_SIGNED_CHAR == 1
   typedef signed char  int_1;
@@ -123,17 +126,54 @@ typedef uint_2 uint_index ;
 
 /*** Graphics Data Structures ***/
 
+
+/*
+ * Isosurfaces are stored in chunks of at most ISO_CHUNK_VERTS vertices so
+ * that 2-byte indexes can be used.  A chunk's index list holds triangle
+ * strips separated by ISO_RESTART, see isomesh.c.
+ */
+#define ISO_CHUNK_VERTS 65535
+#define ISO_RESTART 0xffff
+
+struct iso_chunk {
+   int     vbase;       /* first vertex of the chunk in verts, norms, colors */
+   int     numverts;    /* number of vertices in the chunk */
+   int     ibase;       /* first index of the chunk in index */
+   int     numindex;    /* number of indexes in the chunk */
+};
+
+
+/* number of simplified levels of detail kept for an isosurface */
+#define MAX_ISO_LODS 3
+
+/* A simplified copy of an isosurface, see isolod.c */
+struct iso_lod {
+   float       cellsize;    /* size of the clustering cells in graphics units */
+   int         numverts;    /* number of vertices */
+   int_vert2   *verts;      /* array [numverts][3] of vertices */
+   int_1       *norms;      /* array [numverts][3] of normals */
+   uint_1      *colors;     /* array [numverts] of color table indexes */
+   uint_index  *vmap;       /* array [numverts] of full resolution vertices */
+   int         numindex;    /* number of indexes */
+   uint_2      *index;      /* chunk relative indexes */
+   int         numchunks;   /* number of chunks */
+   struct iso_chunk *chunks;
+};
+
+
 /* Info about isosurfaces */
 struct isosurface {
    int     lock;        /* mutual exclusion lock */
    int     valid;       /* valid/initialized surface flag */
+   int     generation;  /* incremented whenever the surface is freed */
    float   isolevel;    /* the isolevel of the surface */
 
    int_vert2   *verts;      /* array [numverts][3] of vertices */
    int_1   *norms;      /* array [numverts][3] of normals */
    int     numindex;    /* number of indexes */
-   uint_index  *index;      /* array of indices into verts, norms arrays */
-                        /* 4-bytes indices means LONG strips OK */
+   uint_2  *index;      /* array of chunk relative indexes into verts, norms */
+   int     numchunks;   /* number of chunks */
+   struct iso_chunk *chunks;  /* array [numchunks] of chunks */
    int     numverts;    /* number of vertices */
    uint_1  *colors;     /* array [numverts] of color table indexes */
    int     colorvar;    /* variable which is coloring the surface, or -1 */
@@ -149,6 +189,12 @@ struct isosurface {
   int_1	*deci_norms;      /* array [numverts][3] of normals */
   uint_1	*deci_colors;     /* array [numverts] of color table indexes */
 
+  /*
+  **   Built-in simplified versions, finest first
+  */
+  int		numlods;
+  struct iso_lod	lod[MAX_ISO_LODS];
+
 
 
 
@@ -179,13 +225,6 @@ struct sound {
    float SndMaxTemp;        /* maximum temp at 1012.5 mb plotted on skew-t */
    float currentX;          /* current X cursor grid position */
    float currentY;          /* current Y cursor grid position */
-   float *tgrid;            /* grid array to hold temperature data */
-   float *dgrid;            /* grid array to hold dew point tempreature data */
-   float *ugrid;            /* grid array to hold u wind data */
-   float *vgrid;            /* grid array to hold v wind data */
-   float *var1grid;         /* grid array to hold var1 data   */
-   float *var2grid;         /* grid array to hold var 2 data  */
-   float *var3grid;         /* grid array to hold var  3 data */
    int currentTime;         /* current time step for sounding */
    int soundwin_width;      /* width of soundwin */
    int soundwin_height;     /* height of soundiwn */
@@ -210,20 +249,6 @@ struct sound {
    struct vis5d_context *SoundVar1Owner;
    struct vis5d_context *SoundVar2Owner;
    struct vis5d_context *SoundVar3Owner;
-   int PreviousSoundTemp;   /* variable number for previous temperature */
-   int PreviousSoundDewpt;  /* variable number for previous dew point */
-   int PreviousSoundUWind;  /* variable number for previous the U component of the wind */
-   int PreviousSoundVWind;  /* variable number for previous the V componetn of the wind */
-   int PreviousSoundVar1;   /* variable number for previous var1 */
-   int PreviousSoundVar2;   /* variable number for previous var2 */
-   int PreviousSoundVar3;   /* variable number for previous var3 */
-   struct vis5d_context *PreviousSoundTempOwner;   
-   struct vis5d_context *PreviousSoundDewptOwner;  
-   struct vis5d_context *PreviousSoundUWindOwner;  
-   struct vis5d_context *PreviousSoundVWindOwner;  
-   struct vis5d_context *PreviousSoundVar1Owner;   
-   struct vis5d_context *PreviousSoundVar2Owner;  
-   struct vis5d_context *PreviousSoundVar3Owner;   
    int vertsys;             /* if 0 then kilometers not used for vertical system */
    int oceanonly;           /* if 1 then data is for ocean only */
    int get_vert_data;       /* if 0 then data for vertical system already retreived */
@@ -423,6 +448,11 @@ struct hwind {
    int_vert2  *verts;        /* array [nvectors*4][3] of int_vert2 vertices */
    float  *boxverts;     /* pointer to array of vertices for bounding box */
    int    numboxverts;   /* number of vertices in boxverts array */
+   int    sfc;           /* slice was fitted to the topography */
+   int    prime;         /* slice was made in display grid coords */
+   int    generation;    /* ctx->GridGeneration when the winds were read */
+   int    geometry;      /* dtx->GeometryGeneration when made */
+   struct wind_arrows *arrows;  /* unscaled arrows, see windvec.h */
 };
 
 
@@ -442,6 +472,10 @@ struct vwind {
    int_vert2  *verts;        /* array [nvectors*4][3] of int_vert2 vertices */
    float  *boxverts;     /* pointer to array of vertices for bounding box */
    int    numboxverts;   /* number of vertices in boxverts array */
+   int    prime;         /* slice was made in display grid coords */
+   int    generation;    /* ctx->GridGeneration when the winds were read */
+   int    geometry;      /* dtx->GeometryGeneration when made */
+   struct wind_arrows *arrows;  /* unscaled arrows, see windvec.h */
 };
 
 
@@ -481,25 +515,47 @@ struct vstream {
 #define BADSTART 0xffff
 #define VERTINTTYPE int // was int_2
 
-/* Info about a wind trajectory */
+/* Info about a wind trajectory, its vertices are in its set */
 // JCM: Allowed verts to be int and start,len to be uint_4
 struct traj {
-   int     lock;
    float   row, col, lev;  /* initial position of trajectory */
    int     timestep;       /* initial timestep of trajectory */
    float   stepmult;       /* user's integration step multiplier */
    float   lengthmult;     /* user's traj length multiplier */
-   int     length;         /* total number of vertices */
-   int_vert2   *verts;         /* array [length][3] of int_vert2 vertices */
-   int_1   *norms;         /* array [length][3] of int_vert2 normals */
-   uint_1  *colors;        /* array [length] of color table indexes */
-   int     colorvar;       /* which variable is coloring the traj, or -1 */
-   int     colorvarowner;  /* index of the vis5d_ctx the colorvar belongs too */
-   uint_vert2  *start;         /* array [NumTimes] 1st vertex for each timestep */
-   uint_vert2  *len;           /* array [NumTimes] of lengths for each time step */
    int     group;          /* trajectory group */
    int     kind;           /* type of trajectory:  0 = line, 1 = ribbon */
-   int     ctx_owner;      /* ctx->index of the owner of these traj's */
+   int     index;          /* position in its set's trajectory arrays */
+};
+
+
+/*
+ * The trajectories of a group, see trajset.c.  The vertices of all of
+ * them are in one set of arrays and the trajectories in another; both
+ * grow in chunks as trajectories are appended.
+ */
+struct traj_set {
+   int     lock;
+   int     owner;          /* ctx index whose memory holds the arrays */
+   int     numtimes;       /* entries per trajectory in start and len */
+   int     numverts;       /* vertices in use */
+   int     maxverts;       /* room in the vertex arrays */
+   int     numtraj;        /* trajectories in use */
+   int     maxtraj;        /* room in the trajectory arrays */
+   int     generation;     /* changed when trajectories are deleted */
+   /* per vertex */
+   int_vert2   *verts;     /* array [maxverts][3] of int_vert2 vertices */
+   int_1   *norms;         /* array [maxverts][3] of ribbon normals */
+   uint_vert2  *times;     /* array [maxverts] of timesteps for coloring */
+   uint_1  *colors;        /* array [maxverts] of color indexes or NULL */
+   int     colorvar;       /* which variable colors the set, or -1 */
+   int     colorvarowner;  /* index of the vis5d_ctx of colorvar */
+   /* per trajectory */
+   int     *first;         /* array [maxtraj] of 1st vertex */
+   int     *kind;          /* array [maxtraj] of 0 = line, 1 = ribbon */
+   int     *ctx_owner;     /* array [maxtraj] of ctx->index of the owner */
+   uint_vert2  *start;     /* array [maxtraj][numtimes] 1st vertex for each */
+                           /* timestep, counted from first */
+   uint_vert2  *len;       /* array [maxtraj][numtimes] of lengths */
 };
 
 
@@ -525,16 +581,57 @@ struct cache_rec {
 struct grid_rec {
    int CachePos;        /* Position of this grid in cache array or -1 */
    void *Data;          /* Pointer to grid data or NULL */
+   float *Ga, *Gb;      /* Per-level decompression values or NULL */
+   int McFile, McGrid;  /* Origin of the grid as a McIDAS file and */
+                        /* grid number, or 0 */
 };
 
 
-/* from box.c */
-#define MAX_BOX_VERTS 2000
+/*
+ * HORIZONTAL SLICE CACHE
+ *
+ * The 2-D planes extracted for horizontal contour and colored slices,
+ * and the contour lines computed from them, are kept in a small LRU
+ * cache so slices returning to a level (or linked slices at the same
+ * level) don't have to get the grid and contour it again.
+ */
+#define HSLICE_CACHE_SIZE 8
+
+struct hslice_cache_rec {
+   int Timestep, Var;   /* which grid, Timestep = -1 if unused */
+   float Level;         /* which level of it */
+   int Generation;      /* ctx->GridGeneration when made */
+   int Age;             /* for LRU replacement (large Age == Newer) */
+   float *Data;         /* Nr x Nc plane, column major */
+   /* contour lines of Data, if any (Verts==NULL if not) */
+   float Interval, Low, High, Base;
+   int FontX, FontY;    /* label size they were made with */
+   int Num1, Num2, Num3;
+   float *Verts;        /* vr1,vc1 [Num1], vr2,vc2 [Num2], vr3,vc3 [Num3] */
+};
+
+
+
+/*
+ * COLUMN CACHE
+ *
+ * Vertical columns of grid values at grid points, as decompressed by
+ * get_column() for the sounding window and the probe.  Moving the cursor
+ * around keeps coming back to the same few columns.
+ */
+#define COLUMN_CACHE_SIZE 64
+
+struct column_cache_rec {
+   int Timestep, Var;   /* which grid, Timestep = -1 if unused */
+   int Row, Col;        /* which column of it */
+   int Generation;      /* ctx->GridGeneration when read */
+   int Age;             /* for LRU replacement (large Age == Newer) */
+};
 
 
+/* from box.c */
+#define MAX_BOX_VERTS 2000
 
-/* texture mapping stuff from image.c */
-#define MAX_IMAGES MAXTIMES
 
 
 
@@ -604,6 +701,7 @@ struct Topo{
   float Topo_westlon, Topo_eastlon, Topo_northlat, Topo_southlat;
   int Topo_rows, Topo_cols;
   short *TopoData;
+  unsigned int *TopoSums;  /* summed-area table of TopoData, or NULL */
   int LatSample, LonSample;
   int TopoFlag;        /* is topography available? */
   
@@ -640,6 +738,39 @@ typedef struct {
 } Xgfx;
 #endif
 
+/*
+ * Lookup table of graphics z against height, used by the batch
+ * conversions in proj.c when that mapping involves exp().  It is replaced
+ * whenever the vertical coordinate parameters it was made from change,
+ * and the old one kept until the workers are idle, like level_table.
+ */
+#define VERT_TABLE_SIZE  1024
+typedef struct vert_table {
+   int vertical, nonlinear;     /* the parameters it was built from */
+   float logscale, logexp;
+   float bottom, top, pbot, ptop;
+   float frac[VERT_TABLE_SIZE+1];  /* fraction of [Zmin,Zmax] per step */
+   struct vert_table *older;    /* table this one replaced, or NULL */
+} vert_table;
+
+/*
+ * Lookup table of graphics z against grid level at sub-level steps,
+ * for the grid to graphics conversions of vertical systems which are
+ * not linear in the level.  When its parameters change a new table
+ * replaces it; the old one is kept until vis5d_finish_work() since
+ * other threads may still be reading it.
+ */
+#define LEVEL_TABLE_SIZE  4096
+typedef struct level_table {
+   int vertical, logflag, maxnl;   /* the parameters it was built from */
+   float logscale, logexp;
+   float bottom, top, pbot, ptop;
+   float height[MAXLEVELS];
+   int sub;                     /* table steps per grid level */
+   float frac[LEVEL_TABLE_SIZE+1];  /* fraction of [Zmin,Zmax] per step */
+   struct level_table *older;   /* table this one replaced, or NULL */
+} level_table;
+
 struct display_context {
    int dpy_context_index;           /*index if this display context*/
    int group_index;                   /* index of group it belongs to, or zero if not */
@@ -684,8 +815,10 @@ struct display_context {
    int probe_text_width;
 
    /*** Stored frame animation from anim.c ***/
-   XImage *cache[MAXTIMES];
-   int all_invalid;
+   struct frame_cache *FrameCache;
+   int FrameCacheMB;            /* frame cache budget in megabytes */
+   int FrameCacheCompress;      /* run-length encode cached frames? */
+   int FramesStale;             /* set by workers when graphics change */
 
 
 /*************************************************************************************/
@@ -736,6 +869,7 @@ struct display_context {
    float Xmin, Xmax;                     /* West, East */
    float Ymin, Ymax;                     /* South, North */
    float Zmin, Zmax;                     /* Bottom, Top */
+   int GeometryGeneration;               /* changed by every make_box() */
    float CursorX, CursorY, CursorZ;      /* in graphics coords */
    int CurvedBox;                        /* 0 = rectangular box, 1 = curved */
    float Ax, Ay, Az;                     /* Aspect ratios of box */
@@ -773,12 +907,14 @@ struct display_context {
    int tick_num[12];
    int tick_type[12];
 
-   struct hwind       HWindTable[VIS5D_WIND_SLICES][MAXTIMES];
-   struct vwind       VWindTable[VIS5D_WIND_SLICES][MAXTIMES];
-   struct hstream     HStreamTable[VIS5D_WIND_SLICES][MAXTIMES];
-   struct vstream     VStreamTable[VIS5D_WIND_SLICES][MAXTIMES];
-   struct traj        *TrajTable[MAXTRAJ];
-   int NumTraj;
+   /* [MaxTimeSteps] each, see alloc_display_time_steps() */
+   struct hwind       *HWindTable[VIS5D_WIND_SLICES];
+   struct vwind       *VWindTable[VIS5D_WIND_SLICES];
+   struct hstream     *HStreamTable[VIS5D_WIND_SLICES];
+   struct vstream     *VStreamTable[VIS5D_WIND_SLICES];
+   struct traj_set    TrajSet[VIS5D_TRAJ_SETS];
+   struct traj        *TrajTable;  /* [MaxTraj] in order of creation */
+   int NumTraj, MaxTraj;
 
 
    float HWindLevel[VIS5D_WIND_SLICES];        /* in [0..Nl-1] */
@@ -838,12 +974,12 @@ struct display_context {
 /*************************************************************************************/
 
 
-   /*** Texture data from images.c ****/
-   int TexWidth[MAX_IMAGES];             /* Width of each image */
-   int TexHeight[MAX_IMAGES];            /* Height of each image */
-   int TexComponents[MAX_IMAGES];        /* Color components in each image */
-   unsigned char *TexImage[MAX_IMAGES];  /* Array of images */
-   int TexImageNew[MAX_IMAGES];          /* 0= not new, 1=new this is so */
+   /*** Texture data from images.c, [MaxTimeSteps] each ****/
+   int *TexWidth;                        /* Width of each image */
+   int *TexHeight;                       /* Height of each image */
+   int *TexComponents;                   /* Color components in each image */
+   unsigned char **TexImage;             /* Array of images */
+   int *TexImageNew;                     /* 0= not new, 1=new this is so */
                                          /* vis5d dosn't think it's and old texture */
    int init_flag;
    int prev_time;
@@ -905,10 +1041,13 @@ struct display_context {
    int Wvarowner[VIS5D_WIND_SLICES];
    int TrajUowner, TrajVowner, TrajWowner;
  
-   struct dpy_timestep TimeStep[VIS5D_MAX_CONTEXTS*MAXTIMES];
-   int TimeStamp[MAXTIMES];   /* Time of each timestep in sec since midnight */
-   int DayStamp[MAXTIMES];    /* Day of each timestep in days since 1/1/1900 */
-   int Elapsed[VIS5D_MAX_CONTEXTS*MAXTIMES]; /* time in seconds relative to first step */
+   /* The timeline merged from all the contexts' time steps.  These and */
+   /* the wind tables above hold MaxTimeSteps >= NumTimes entries. */
+   int MaxTimeSteps;
+   struct dpy_timestep *TimeStep;
+   int *TimeStamp;   /* Time of each timestep in sec since midnight */
+   int *DayStamp;    /* Day of each timestep in days since 1/1/1900 */
+   int *Elapsed;     /* time in seconds relative to first step */
 
    char DisplaySfcHWind[VIS5D_WIND_SLICES];     /* display surface winds */
    char DisplaySfcHStream[VIS5D_WIND_SLICES];   /* display surface strmlines */
@@ -977,6 +1116,8 @@ struct display_context {
    float LogScale;              /* for VERT_LOG_KM: */
    float LogExp;                /* "" */
    float Ptop, Pbot;            /* "" */
+   vert_table *HgtTable;        /* height to z lookup, see proj.c */
+   level_table *LevTable;       /* grid level to z lookup, see proj.c */
 
 /*************************************************************************************/
 /*************************************************************************************/
@@ -1080,7 +1221,8 @@ struct display_group{
    int index;
    struct display_context *dpyarray[VIS5D_MAX_DPY_CONTEXTS];
    int numofdpys;
-   struct dpy_timestep TimeStep[VIS5D_MAX_CONTEXTS*MAXTIMES];
+   struct dpy_timestep *TimeStep;   /* [MaxTimeSteps] */
+   int MaxTimeSteps;
    int NumTimes;
    int CurTime;
    int Animateing;
@@ -1127,13 +1269,13 @@ typedef struct{
   float RealMaxVal;
   int LowLev;
 
-   /*** Tables of graphics data ***/
+   /*** Tables of graphics data, [ctx->MaxTimeSteps] each ***/
 
-  struct vslice     *VSliceTable[MAXTIMES];
-  struct chslice    *CHSliceTable[MAXTIMES];
-  struct cvslice    *CVSliceTable[MAXTIMES];
-  struct hslice     *HSliceTable[MAXTIMES];
-  struct isosurface *SurfTable[MAXTIMES];
+  struct vslice     **VSliceTable;
+  struct chslice    **CHSliceTable;
+  struct cvslice    **CVSliceTable;
+  struct hslice     **HSliceTable;
+  struct isosurface **SurfTable;
 
   hslice_request *HSliceRequest, *CHSliceRequest;
   vslice_request *VSliceRequest, *CVSliceRequest;
@@ -1173,15 +1315,14 @@ struct irregular_context {
    int CharArraySize;
    int CacheClock;
 
-   struct rec_geo_position    *RecGeoPosition[MAXTIMES];
+   /* [NumTimes] each, see open_recordfile() */
+   struct rec_geo_position    **RecGeoPosition;
 
    int Levels;
-   int NumRecs[MAXTIMES];
+   int *NumRecs;
    int MaxCachedRecs;
    int NumCachedRecs;
-   struct irreg_rec           *RecordTable[MAXTIMES];
-
-   int *RecId[MAXTIMES];
+   struct irreg_rec           **RecordTable;
 
    int PreloadCache;
 
@@ -1205,9 +1346,10 @@ struct irregular_context {
 
    int CharArrayLength;
 
-   int TimeStamp[MAXTIMES];   /* Time of each timestep in sec since midnight */
-   int DayStamp[MAXTIMES];    /* Day of each timestep in days since 1/1/1900 */
-   int Elapsed[MAXTIMES];     /* time in seconds relative to first step */
+   /* [NumTimes] each */
+   int *TimeStamp;   /* Time of each timestep in sec since midnight */
+   int *DayStamp;    /* Day of each timestep in days since 1/1/1900 */
+   int *Elapsed;     /* time in seconds relative to first step */
    int CurTime;
 
 
@@ -1225,7 +1367,7 @@ struct irregular_context {
    float TextPlotFontSpace;
 
 
-   struct textplot    TextPlotTable[MAXTIMES];
+   struct textplot    *TextPlotTable;   /* [NumTimes] */
 
    int DisplayTextPlot;
 
@@ -1248,6 +1390,9 @@ struct vis5d_context {
    int WindNl;            /* Min of Nl+LowLev for Uvar, Vvar, Wvar */
    int WindLow;           /* Max of LowLev[Uvar], LowLev[Vvar], LowLev[Wvar] */
    int NumTimes;                /* Number of time steps */
+   int MaxTimeSteps;            /* Entries in each variable's graphics */
+                                /* tables, >= NumTimes and the display's */
+                                /* NumTimes since some are indexed by it */
    int NumVars;                 /* Number of variables */
 
 
@@ -1263,9 +1408,10 @@ struct vis5d_context {
    int TrajU, TrajV, TrajW;     /* Trajectory variables */
    float TrajStep, TrajLength;            /* internal values */
 
-   int TimeStamp[MAXTIMES];   /* Time of each timestep in sec since midnight */
-   int DayStamp[MAXTIMES];    /* Day of each timestep in days since 1/1/1900 */
-   int Elapsed[MAXTIMES];     /* time in seconds relative to first step */
+   /* [NumTimes] each */
+   int *TimeStamp;   /* Time of each timestep in sec since midnight */
+   int *DayStamp;    /* Day of each timestep in days since 1/1/1900 */
+   int *Elapsed;     /* time in seconds relative to first step */
 
 
    /*** display_context pointer ***/
@@ -1343,13 +1489,20 @@ struct vis5d_context {
    float LogScale;              /* for VERT_LOG_KM: */
    float LogExp;                /* "" */
    float Ptop, Pbot;            /* "" */
+   vert_table *HgtTable;        /* height to z lookup, see proj.c */
+   level_table *LevTable;       /* grid level to z lookup, see proj.c */
 
    /*** Memory ***/
    void *mempool;
    struct mem *head, *tail;
-   struct mem *guess;
+   struct mem *freebin[MEM_BINS];       /* free blocks by size class */
+   unsigned int freebinmap[MEM_BINS/32]; /* which freebin[] are non-empty */
+   struct mem *huge;                    /* blocks allocated outside pool */
+   PTRINT huge_threshold;               /* bytes, 0 = never */
    PTRINT memory_limit;
    PTRINT memory_used;
+   PTRINT memory_peak;                  /* largest value of memory_used */
+   struct mem_type_stats *memstats;     /* usage by block type (memory.h) */
    LOCK memlock;
    LOCK lrulock;
    PTRINT meminited;
@@ -1385,15 +1538,15 @@ struct vis5d_context {
    SEMAPHORE ExtFuncDoneSem;
 #endif
    int ExtFuncSocket[MAX_THREADS];
+   float *ExtFuncInput[MAX_THREADS];    /* shared memory input grids */
+   float *ExtFuncOutput[MAX_THREADS];   /* shared memory result grid */
+   void *ExtFuncPlugin;                 /* in-process function or NULL */
    float ProbeRow, ProbeCol, ProbeLev;
 
 
    /*** Grid info from grid.c ***/
-   int McFile[MAXTIMES][MAXVARS];   /* Origin of each compressed grid */
-   int McGrid[MAXTIMES][MAXVARS];   /*  as a McIDAS file and grid number. */
-   float *Ga[MAXTIMES][MAXVARS];
-   float *Gb[MAXTIMES][MAXVARS];
    int CompressMode;  /* compression mode (1, 2 or 4 bytes per grid point */
+                      /* or V5D_LOSSLESS or V5D_BOUNDED) */
    v5dstruct G;       /* File header information */
    LOCK Mutex;        /* Mutual exclusion lock for grid/cache access */
    /* array of cache_rec structs is used to manage the contents of the cache */
@@ -1401,10 +1554,27 @@ struct vis5d_context {
    PTRINT MaxCachedGrids;              /* No. positionss in GridCache array */
    int NumCachedGrids;              /* Number of positions in use */
    int CacheClock;                  /* To implement LRU replacement */
-   /* An array of grid_rec structs is used to determine if (and where)
-      a grid is in the cache given a timestep and variable. */
-   struct grid_rec GridTable[MAXTIMES][MAXVARS];
+   /* stream compress modes (V5D_LOSSLESS, V5D_BOUNDED) hold each cached */
+   /* grid in a block of its own size, bounded by CacheLimit bytes */
+   PTRINT CacheBytes;               /* bytes of grids in the cache */
+   PTRINT CacheLimit;               /* most bytes of grids to cache */
+   void *CacheScratch;              /* worst case grid, for reading */
+   /* For each variable, an array of NumTimes grid_rec structs is used
+      to determine if (and where) a grid is in the cache given a
+      timestep and variable.  Allocated along with the variable. */
+   struct grid_rec *GridTable[MAXVARS];
+   int GridGeneration;      /* changed whenever grid data changes */
+   struct hslice_cache_rec HSliceCache[HSLICE_CACHE_SIZE];
+   int HSliceCacheClock;            /* for HSliceCache LRU replacement */
+   LOCK HSliceCacheLock;
+   struct column_cache_rec ColumnCache[COLUMN_CACHE_SIZE];
+   float *ColumnCacheData;          /* MAXLEVELS values per ColumnCache entry */
+   int ColumnCacheClock;            /* for ColumnCache LRU replacement */
+   LOCK ColumnCacheLock;
    int PreloadCache;        /* Preload cache with data? */
+   int PreloadsRunning;     /* TASK_PRELOADs taken by workers, see queue.c */
+   int PreloadNext;         /* timestep of a dropped TASK_PRELOAD, or 0 */
+   int Closing;             /* being destroyed, takes no more requests */
    int VeryLarge;           /* must sync graphics generation with rendering */
 
 
@@ -373,6 +373,16 @@ extern void resize_BIG_window( int width, int height );
 extern void swap_3d_window( void );
 
 
+/*
+ * Read/write the back buffer of the current 3-D window as RGBA pixels.
+ */
+extern void read_3d_window_pixels( int width, int height,
+                                   unsigned int *pixels );
+
+extern void draw_3d_window_pixels( int width, int height,
+                                   const unsigned int *pixels );
+
+
 
 /*
  * Begin 2-D rendering.  All coordinates given to the 2-D drawing routines
@@ -482,8 +492,9 @@ extern void end_aa_pass( int n );
 
 /*
  * Render a compressed isosurface.
- * Input:  n - number of indexes
- *         index - array of [n] indexes into verts[] and norms[]
+ * Input:  n - number of chunks, or of vertices if draw_triangles
+ *         chunks - array [n] of chunks
+ *         index - chunk relative indexes into verts[] and norms[]
  *         verts - array of scaled integer vertices
  *         norms - array of scaled integer normals
  *	   draw_triangles - draw triangles, not tristrips 
@@ -491,15 +502,16 @@ extern void end_aa_pass( int n );
  *         *list - a pointer to the gllist to save to or NULL
  *         listtype - one of GL_COMPILE or GL_COMPILE_AND_EXECUTE
  */
-extern void draw_isosurface( int n, uint_index *index,
+extern void draw_isosurface( int n, struct iso_chunk *chunks, uint_2 *index,
                              int_vert2 verts[][3], int_1 norms[][3], int	draw_triangles,
                              unsigned int color, GLuint *list, int listtype );
 
 
 /*
  * Render a compressed, COLORED, isosurface.
- * Input:  n - number of indexes
- *         index - array of [n] indexes into verts[] and norms[]
+ * Input:  n - number of chunks, or of vertices if draw_triangles
+ *         chunks - array [n] of chunks
+ *         index - chunk relative indexes into verts[] and norms[]
  *         verts - array of scaled integer vertices
  *         norms - array of scaled integer normals
  *	   draw_triangles - draw triangles, not tristrips 
@@ -508,7 +520,8 @@ extern void draw_isosurface( int n, uint_index *index,
  *         alphavalue - -1=variable, 0..255=constant
  */
 extern void draw_colored_isosurface( int n,
-                                     uint_index *index,
+                                     struct iso_chunk *chunks,
+                                     uint_2 *index,
                                      int_vert2 verts[][3],
                                      int_1 norms[][3],
 												 int draw_triangles,
@@ -627,6 +640,24 @@ extern void draw_colored_polylines( int n, int_vert2 verts[][3],
                                     unsigned int color_table[] );
 
 
+/*
+ * Draw a set of trajectory strips in one call.
+ * Input:  n - number of strips
+ *         first, count - first vertex and vertex count of each strip
+ *         ribbon - 0 = draw as polylines, 1 = draw as lit triangle strips
+ *         verts, norms - the vertices and normals (norms only for ribbons)
+ *         color_indexes, color_table - per vertex colors or NULL
+ *         color - color used when color_indexes is NULL
+ *         alpha - constant alpha of colored ribbons, or -1
+ */
+extern void draw_traj_strips( int n, const int first[], const int count[],
+                              int ribbon,
+                              int_vert2 verts[][3], int_1 norms[][3],
+                              uint_1 color_indexes[],
+                              unsigned int color_table[],
+                              unsigned int color, int alpha );
+
+
 /*
  * Render a number of polylines.  When the X component of a vertex is -999.0
  * we start a new line.
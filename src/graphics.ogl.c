@@ -63,10 +63,12 @@
 // use int vertex
 #define myglRrasterPosv glRasterPos3iv
 #define myglVertex3v glVertex3iv
+#define MYGL_VERTEX_TYPE GL_INT
 #else
 // use byte vertex
 #define myglRrasterPosv glRasterPos3sv
 #define myglVertex3v glVertex3sv
+#define MYGL_VERTEX_TYPE GL_SHORT
 #endif
 
 
@@ -1751,8 +1753,63 @@ void generate_isosurface( int n,
 
 
 
+/*
+ * Draw the triangle strips of a chunked isosurface with vertex arrays.
+ * Input:  n - number of chunks
+ *         chunks, index - the chunks and their indexes
+ *         verts, norms - the vertices
+ *         color_indexes, color_table - per vertex colors or NULL
+ */
+static void draw_iso_chunks( int n, struct iso_chunk *chunks, uint_2 *index,
+                             int_vert2 verts[][3], int_1 norms[][3],
+                             uint_1 color_indexes[],
+                             unsigned int color_table[] )
+{
+   static unsigned int colors[ISO_CHUNK_VERTS];
+   int c, i, start;
+
+   glEnableClientState( GL_VERTEX_ARRAY );
+   glEnableClientState( GL_NORMAL_ARRAY );
+   if (color_indexes) {
+      glEnableClientState( GL_COLOR_ARRAY );
+   }
+   else {
+      glDisableClientState( GL_COLOR_ARRAY );
+   }
+
+   for (c=0;c<n;c++) {
+      uint_2 *ci = index + chunks[c].ibase;
+      glVertexPointer( 3, MYGL_VERTEX_TYPE, 0, verts[chunks[c].vbase] );
+      glNormalPointer( GL_BYTE, 0, norms[chunks[c].vbase] );
+      if (color_indexes) {
+         for (i=0;i<chunks[c].numverts;i++) {
+            colors[i] = color_table[color_indexes[chunks[c].vbase+i]];
+         }
+         glColorPointer( 4, GL_UNSIGNED_BYTE, 0, colors );
+      }
+      /* one call per strip, ISO_RESTART separates them */
+      start = 0;
+      for (i=0;i<=chunks[c].numindex;i++) {
+         if (i==chunks[c].numindex || ci[i]==ISO_RESTART) {
+            if (i-start>=3) {
+               glDrawElements( GL_TRIANGLE_STRIP, i-start, GL_UNSIGNED_SHORT,
+                               ci+start );
+            }
+            start = i+1;
+         }
+      }
+   }
+
+   glDisableClientState( GL_VERTEX_ARRAY );
+   glDisableClientState( GL_NORMAL_ARRAY );
+   glDisableClientState( GL_COLOR_ARRAY );
+}
+
+
+
 void draw_isosurface( int n,
-                      uint_index *index,
+                      struct iso_chunk *chunks,
+                      uint_2 *index,
                       int_vert2 verts[][3],
                       int_1 norms[][3],
 							 int	draw_triangles,
@@ -1794,14 +1851,8 @@ void draw_isosurface( int n,
   }
   else 
 	  {
-		 /* Render the triangle strip */
-		 GLBEGINNOTE glBegin( GL_TRIANGLE_STRIP );
-		 for (i=0;i<n;i++) {
-			int j = index[i];
-			glNormal3bv( (GLbyte *) norms[j] );
-			myglVertex3v( verts[j] );
-		 }
-		 glEnd();
+		 /* Render the triangle strips */
+		 draw_iso_chunks( n, chunks, index, verts, norms, NULL, NULL );
 	  }
    glPopMatrix();
 
@@ -1817,7 +1868,8 @@ void draw_isosurface( int n,
 
 
 void draw_colored_isosurface( int n,
-                              uint_index *index,
+                              struct iso_chunk *chunks,
+                              uint_2 *index,
                               int_vert2 verts[][3],
                               int_1 norms[][3],
 										int	draw_triangles,
@@ -1853,16 +1905,9 @@ void draw_colored_isosurface( int n,
 	  glEnd();
 	}else 
 	  {
-		 /* Render the triangle strip */
-		 GLBEGINNOTE glBegin( GL_TRIANGLE_STRIP );
-		 for (i=0;i<n;i++) {
-			int j = index[i];
-			unsigned int k = color_indexes[j];
-			glColor4ubv( (GLubyte *) &color_table[k] );
-			glNormal3bv( (GLbyte *) norms[j] );
-			myglVertex3v( verts[j] );
-		 }
-		 glEnd();
+		 /* Render the triangle strips */
+		 draw_iso_chunks( n, chunks, index, verts, norms,
+		                  color_indexes, color_table );
 	  }
    glPopMatrix();
 
@@ -2382,6 +2427,185 @@ void draw_colored_polylines( int n, int_vert2 verts[][3],
 
 
 
+/*
+ * Grow one of the scratch buffers of draw_traj_strips.
+ */
+static void *grow_traj_buffer( void *buf, int *size, int need, int elsize )
+{
+   void *p;
+
+   if (need <= *size) {
+      return buf;
+   }
+   p = realloc( buf, (size_t) need * elsize );
+   if (!p) {
+      return NULL;
+   }
+   *size = need;
+   return p;
+}
+
+
+// used for traj
+void draw_traj_strips( int n, const int first[], const int count[],
+                       int ribbon,
+                       int_vert2 verts[][3], int_1 norms[][3],
+                       uint_1 color_indexes[],
+                       unsigned int color_table[],
+                       unsigned int color, int alpha )
+{
+   static GLuint *index = NULL;
+   static unsigned int *colors = NULL;
+   static int indexsize = 0, colorsize = 0;
+   int i, j, m, lo, hi, numindex;
+   GLuint v;
+
+   if (n<=0) {
+      return;
+   }
+
+   /* strips are sorted by first vertex, draw relative to the lowest one */
+   lo = first[0];
+   hi = first[n-1] + count[n-1];
+   numindex = 0;
+   for (i=0;i<n;i++) {
+      if (count[i]>=2) {
+         numindex += ribbon ? 3*(count[i]-2) : 2*(count[i]-1);
+      }
+   }
+   if (numindex==0) {
+      return;
+   }
+
+   index = (GLuint *) grow_traj_buffer( index, &indexsize, numindex,
+                                        sizeof(GLuint) );
+   if (!index) {
+      indexsize = 0;
+      return;
+   }
+   if (color_indexes) {
+      colors = (unsigned int *) grow_traj_buffer( colors, &colorsize, hi-lo,
+                                                  sizeof(unsigned int) );
+      if (!colors) {
+         colorsize = 0;
+         return;
+      }
+   }
+
+   /* GL_LINES pairs for polylines, GL_TRIANGLES for ribbons */
+   m = 0;
+   for (i=0;i<n;i++) {
+      v = (GLuint) (first[i] - lo);
+      if (color_indexes) {
+         for (j=0;j<count[i];j++) {
+            colors[v+j] = color_table[color_indexes[first[i]+j]];
+         }
+      }
+      if (ribbon) {
+         for (j=0;j<count[i]-2;j++) {
+            /* keep the winding of GL_TRIANGLE_STRIP */
+            if (j & 1) {
+               index[m++] = v+j+1;
+               index[m++] = v+j;
+            }
+            else {
+               index[m++] = v+j;
+               index[m++] = v+j+1;
+            }
+            index[m++] = v+j+2;
+         }
+      }
+      else {
+         for (j=0;j<count[i]-1;j++) {
+            index[m++] = v+j;
+            index[m++] = v+j+1;
+         }
+      }
+   }
+
+   if (ribbon) {
+      if (color_indexes) {
+         glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+         glEnable( GL_BLEND );
+         glAlphaFunc( GL_GREATER, 0.05 );
+         glEnable( GL_ALPHA_TEST );
+         glShadeModel(GL_SMOOTH);
+         glColorMaterial( GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE );
+         glEnable( GL_COLOR_MATERIAL );
+         if (alpha!=-1) {
+            /* constant alpha */
+            set_transparency( alpha );
+         }
+      }
+      else {
+         GLfloat material_color[4];
+
+         material_color[0] = UNPACK_RED( color )   / 255.0;
+         material_color[1] = UNPACK_GREEN( color ) / 255.0;
+         material_color[2] = UNPACK_BLUE( color )  / 255.0;
+         material_color[3] = UNPACK_ALPHA( color ) / 255.0;
+         glMaterialfv( GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE,
+                       material_color );
+         set_transparency( UNPACK_ALPHA(color) );
+      }
+      glEnable( GL_LIGHTING );
+   }
+   else {
+      if (!color_indexes) {
+         glColor4ubv( (GLubyte *) &color );
+         glShadeModel( GL_FLAT );
+         glDisable( GL_DITHER );
+      }
+      glDisable( GL_BLEND ); // JCM
+      glLineWidth(3); // JCM
+   }
+
+   glPushMatrix();
+   glScalef( 1.0/VERTEX_SCALE, 1.0/VERTEX_SCALE, 1.0/VERTEX_SCALE );
+
+   glEnableClientState( GL_VERTEX_ARRAY );
+   glVertexPointer( 3, MYGL_VERTEX_TYPE, 0, verts[lo] );
+   if (ribbon) {
+      glEnableClientState( GL_NORMAL_ARRAY );
+      glNormalPointer( GL_BYTE, 0, norms[lo] );
+   }
+   if (color_indexes) {
+      glEnableClientState( GL_COLOR_ARRAY );
+      glColorPointer( 4, GL_UNSIGNED_BYTE, 0, colors );
+   }
+   glDrawElements( ribbon ? GL_TRIANGLES : GL_LINES, numindex,
+                   GL_UNSIGNED_INT, index );
+   glDisableClientState( GL_VERTEX_ARRAY );
+   glDisableClientState( GL_NORMAL_ARRAY );
+   glDisableClientState( GL_COLOR_ARRAY );
+
+   glPopMatrix();
+
+   if (ribbon) {
+      glDisable( GL_LIGHTING );
+      if (color_indexes) {
+         glDisable( GL_BLEND );
+         glDisable( GL_POLYGON_STIPPLE );
+         glDisable( GL_ALPHA_TEST );
+         glDisable( GL_COLOR_MATERIAL );
+      }
+      else {
+         set_transparency(255);
+      }
+   }
+   else {
+      if (!color_indexes) {
+         glShadeModel( GL_SMOOTH );
+         glEnable( GL_DITHER );
+      }
+      glEnable( GL_BLEND ); // JCM
+      glLineWidth(1); // JCM
+   }
+   check_gl_error("draw_traj_strips");
+}
+
+
+
 
 // used for box
 void draw_multi_lines( int n, float verts[][3], unsigned int color )
@@ -2679,36 +2903,36 @@ int text_width(  XFontStruct *font, char *str)
 
 
 /*
- * Return a copy of Mesa's back buffer image.
+ * Read the back buffer of the current 3-D window as packed RGBA pixels.
+ * Input:  width, height - size of the window
+ *         pixels - array of width*height pixels to fill
  */
-XImage *mesa_read_image( void )
+void read_3d_window_pixels( int width, int height, unsigned int *pixels )
 {
-#ifdef HAVE_XMESAGETBACKBUFFER
-   unsigned int w = current_dtx->WinWidth;
-   unsigned int h = current_dtx->WinHeight;
-   XImage *backimage;
-
-   XMesaGetBackBuffer( XMesaGetCurrentBuffer(), NULL, &backimage );
-   return XSubImage( backimage, 0, 0, w, h );
-#else
-   return NULL;
-#endif
+   glReadBuffer( GL_BACK );
+   glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+   glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+   check_gl_error( "read_3d_window_pixels" );
 }
 
 
 /*
- * Write an XImage into the Mesa window.
+ * Copy packed RGBA pixels, as returned by read_3d_window_pixels(), into
+ * the back buffer of the current 3-D window.
  */
-void mesa_draw_image( XImage *image )
+void draw_3d_window_pixels( int width, int height, const unsigned int *pixels )
 {
-#ifdef HAVE_XMESAGETBACKBUFFER
-   XImage *backimage;
-   unsigned int n;
-
-   XMesaGetBackBuffer( XMesaGetCurrentBuffer(), NULL, &backimage );
-   n = backimage->bytes_per_line * backimage->height;
-   memcpy( backimage->data, image->data, n );
-#endif
+   glPushAttrib( GL_ENABLE_BIT );
+   glDisable( GL_DEPTH_TEST );
+   glDisable( GL_BLEND );
+   glDisable( GL_LIGHTING );
+   glDisable( GL_FOG );
+   set_2d();
+   glRasterPos2i( 0, 0 );
+   glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+   glDrawPixels( width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+   glPopAttrib();
+   check_gl_error( "draw_3d_window_pixels" );
 }
 
 #endif /* HAVE_OPENGL */
@@ -75,6 +75,8 @@ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "render.h"
 #include "graphics.vrml.h"
 #include "graphics.h"
+#include "isomesh.h"
+#include "trajset.h"
 
 static FILE	*fp = (FILE *) NULL;
 
@@ -1168,7 +1170,7 @@ static void vrml_colored_topomesh(
 	bl();fprintf(fp, "} # End of topo Shape.\n");
 }
 
-static void vrml_isosurface(int n, uint_vert2 *index, int_vert2 verts[][3],
+static void vrml_isosurface(int n, const int *index, int_vert2 verts[][3],
 			int_1 norms[][3], unsigned int color)
 {
 	int		i, count, maxvert;
@@ -1367,7 +1369,7 @@ static void vrml_isosurface(int n, uint_vert2 *index, int_vert2 verts[][3],
 }
 
 static void vrml_colored_isosurface( int n,
-		uint_vert2 *index,
+		const int *index,
 		int_vert2 verts[][3],
 		int_1 norms[][3],
 		uint_1 color_indexes[],
@@ -2113,44 +2115,44 @@ vrml_trajectories(
 	int	it)
 {
 	Display_Context	dtx;
-	int i, len, start;
+	int g, i, n;
+	int *first, *count;
 
 	dtx = ctx->dpy_ctx;
 
-	for (i=0;i<dtx->NumTraj;i++) {
-		struct traj *t = dtx->TrajTable[i];
+	for (g=0;g<VIS5D_TRAJ_SETS;g++) {
+		struct traj_set *s = &dtx->TrajSet[g];
 
-		if(t->ctx_owner == ctx->context_index &&
-			dtx->DisplayTraj[t->group] && cond_read_lock(&t->lock)){
+		if(s->numtraj>0 && dtx->DisplayTraj[g] && cond_read_lock(&s->lock)){
 
-			assert( t->lock==1 );
+			recent( ctx, TRAJ, g );
 
-			recent( ctx, TRAJ, t->group );
-
-			start = t->start[it];
-			len = t->len[it];
-			if (start!=0xffff && len>0) {
-				if (t->kind==0) {
-					/* draw as line segments */
-					int colorvar = t->colorvar;
-					if (colorvar>=0) {
+			first = (int *) malloc( 2 * s->numtraj * sizeof(int) );
+			if (first) {
+				count = first + s->numtraj;
+				/* draw line segment trajectories */
+				n = traj_set_strips( s, ctx->context_index, 0, it,
+				                     first, count );
+				for (i=0;i<n;i++) {
+					if (s->colorvar>=0 && s->colors) {
 						/* draw colored trajectory */
-						vrml_colored_polylines( len,
-						(void *) (t->verts + start*3),
-						(void *)(t->colors + start),
+						vrml_colored_polylines( count[i],
+						(void *) (s->verts + first[i]*3),
+						(void *)(s->colors + first[i]),
 						dtx->ColorTable[VIS5D_TRAJ_CT]->Colors[
-							t->colorvarowner*
-							MAXVARS+colorvar]);
+							s->colorvarowner*
+							MAXVARS+s->colorvar]);
 					}
 					else {
 					/* monocolored */
-						vrml_polylines( len,
-						(void *) (t->verts + start*3),
-						dtx->TrajColor[t->group]);
+						vrml_polylines( count[i],
+						(void *) (s->verts + first[i]*3),
+						dtx->TrajColor[g]);
 					}
 				}
+				free( first );
 			}
-			done_read_lock( &t->lock );
+			done_read_lock( &s->lock );
 		}
 	}
 }
@@ -2382,6 +2384,7 @@ vrml_isosurfaces(
 	int		var, alpha;
 	Display_Context	dtx;
 	int		time, colorvar, cvowner;
+	int		n, *strip;
 	const char	*myname = "vrml_isosurfaces";
 
 	dtx = ctx->dpy_ctx;
@@ -2405,10 +2408,14 @@ vrml_isosurfaces(
 			alpha = UNPACK_ALPHA(dtx->Color[ctx->context_index *
 						MAXVARS + var][ISOSURF]); 
 
-			if(ctx->Variable[var]->SurfTable[time]->colors){
+			/* VRML gets the surface as one strip */
+			strip = iso_strip_indexes(
+					ctx->Variable[var]->SurfTable[time]->numchunks,
+					ctx->Variable[var]->SurfTable[time]->chunks,
+					ctx->Variable[var]->SurfTable[time]->index, &n);
+			if(strip && ctx->Variable[var]->SurfTable[time]->colors){
 				vrml_colored_isosurface(
-					ctx->Variable[var]->SurfTable[time]->numindex,
-					ctx->Variable[var]->SurfTable[time]->index,
+					n, strip,
 					(void*)ctx->Variable[var]->SurfTable[time]->verts,
 					(void*)ctx->Variable[var]->SurfTable[time]->norms,
 					(void*)ctx->Variable[var]->SurfTable[time]->colors,
@@ -2416,15 +2423,15 @@ vrml_isosurfaces(
 						cvowner * MAXVARS + colorvar],
 					alpha);
 			}
-			else {
+			else if(strip){
 				vrml_isosurface(
-					ctx->Variable[var]->SurfTable[time]->numindex,
-					ctx->Variable[var]->SurfTable[time]->index,
+					n, strip,
 					(void *)ctx->Variable[var]->SurfTable[time]->verts,
 					(void *)ctx->Variable[var]->SurfTable[time]->norms,
 					dtx->Color[ctx->context_index *
 							MAXVARS + var][0]);
 			}
+			free(strip);
 			done_read_lock(&ctx->Variable[var]->SurfTable[time]->lock);
 		}
 	}
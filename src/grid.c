@@ -40,11 +40,13 @@
 #include <string.h>
 #include "api.h"
 #include "binio.h"
+#include "chrono.h"
 #include "grid.h"
 #include "graphics.h"
 #include "globals.h"
 #include "memory.h"
 #include "proj.h"
+#include "queue.h"
 #include "sync.h"
 
 /* MJK 12.02.98 */
@@ -184,6 +186,7 @@ int write_gridfile( Context ctx, const char filename[] )
       v->DateStamp[time] = v5dDaysToYYDDD( ctx->DayStamp[time] );
    }
    v->CompressMode = ctx->CompressMode;
+   v->Tolerance = ctx->G.Tolerance;
 
    /* do the projection and vert coord sys */
    v->Projection = ctx->Projection;
@@ -303,16 +306,32 @@ int open_gridfile( Context ctx, const char filename[] )
 
 int set_ctx_from_internalv5d(Context ctx)
 {
-  int i, time, var, first;
+  int i, n, time, var, first;
 
-   /* Initalize parameter type table */
-   for (i=0;i < ctx->G.NumVars;i++) {
-	  ctx->Variable[i] = (vis5d_variable *) calloc(1,sizeof(vis5d_variable));  
+   /* Check that grid isn't too big */
+   if (ctx->G.NumTimes>MAXTIMES) {
+      printf("Error: Too many time steps (%d) limit is %d\n", ctx->G.NumTimes,
+             MAXTIMES );
+      return 0;
+   }
+   if (ctx->G.NumVars>MAXVARS) {
+      printf("Error: Too many variables (%d) limit is %d\n", ctx->G.NumVars,
+             MAXVARS );
+      return 0;
    }
 
    /* Copy header info from G to global variables */
    ctx->NumTimes = ctx->G.NumTimes;
    ctx->NumVars = ctx->G.NumVars;
+
+   /* Initalize parameter type table */
+   for (i=0;i < ctx->NumVars;i++) {
+      if (!new_variable( ctx, i )) {
+         printf("Error: out of memory.  Couldn't allocate variable tables.\n");
+         return 0;
+      }
+   }
+
    ctx->Nr = ctx->G.Nr;
    ctx->Nc = ctx->G.Nc;
    ctx->MaxNl = 0;
@@ -340,17 +359,6 @@ int set_ctx_from_internalv5d(Context ctx)
    }
    end MJK*/
 
-   /* Check that grid isn't too big */
-   if (ctx->NumTimes>MAXTIMES) {
-      printf("Error: Too many time steps (%d) limit is %d\n", ctx->NumTimes,
-             MAXTIMES );
-      return 0;
-   }
-   if (ctx->NumVars>MAXVARS) {
-      printf("Error: Too many variables (%d) limit is %d\n", ctx->NumVars,
-             MAXVARS );
-      return 0;
-   }
    if (ctx->Nr>MAXROWS) {
       printf("Error: Number of grid rows (%d) too large, %d is limit.\n",
              ctx->Nr,MAXROWS);
@@ -370,6 +378,19 @@ int set_ctx_from_internalv5d(Context ctx)
       return 0;
    }
 
+   /* per-timestep stamps, freed by destroy_context() */
+   free( ctx->TimeStamp );
+   free( ctx->DayStamp );
+   free( ctx->Elapsed );
+   n = ctx->NumTimes>0 ? ctx->NumTimes : 1;
+   ctx->TimeStamp = (int *) calloc( n, sizeof(int) );
+   ctx->DayStamp = (int *) calloc( n, sizeof(int) );
+   ctx->Elapsed = (int *) calloc( n, sizeof(int) );
+   if (!ctx->TimeStamp || !ctx->DayStamp || !ctx->Elapsed) {
+      printf("Error: out of memory.  Couldn't allocate time step tables.\n");
+      return 0;
+   }
+
    /* convert time from HHMMSS to seconds since midnight */
    /* convert date from YYDDD to days since Jan, 1900 */
    for (time=0;time<ctx->NumTimes;time++) {
@@ -388,28 +409,175 @@ int set_ctx_from_internalv5d(Context ctx)
 	return 1;
 }
 
+/*
+ * Allocate variable var of a context along with its per-timestep
+ * tables: NumTimes grid_recs and MaxTimeSteps graphics pointers.
+ * Return:  the new variable or NULL if out of memory.
+ */
+vis5d_variable *new_variable( Context ctx, int var )
+{
+   vis5d_variable *v;
+   int n, it;
+
+   if (ctx->MaxTimeSteps < ctx->NumTimes) {
+      ctx->MaxTimeSteps = ctx->NumTimes;
+   }
+   if (ctx->MaxTimeSteps < 1) {
+      ctx->MaxTimeSteps = 1;
+   }
+   n = ctx->MaxTimeSteps;
+   v = (vis5d_variable *) calloc( 1, sizeof(vis5d_variable) );
+   if (v) {
+      v->VSliceTable = (struct vslice **) calloc( n, sizeof(struct vslice *) );
+      v->CHSliceTable = (struct chslice **) calloc( n, sizeof(struct chslice *) );
+      v->CVSliceTable = (struct cvslice **) calloc( n, sizeof(struct cvslice *) );
+      v->HSliceTable = (struct hslice **) calloc( n, sizeof(struct hslice *) );
+      v->SurfTable = (struct isosurface **) calloc( n, sizeof(struct isosurface *) );
+   }
+   ctx->Variable[var] = v;
+   n = ctx->NumTimes>0 ? ctx->NumTimes : 1;
+   ctx->GridTable[var] = (struct grid_rec *) calloc( n, sizeof(struct grid_rec) );
+   if (!v || !v->VSliceTable || !v->CHSliceTable || !v->CVSliceTable
+       || !v->HSliceTable || !v->SurfTable || !ctx->GridTable[var]) {
+      free_variable( ctx, var );
+      return NULL;
+   }
+   for (it=0; it<n; it++) {
+      ctx->GridTable[var][it].CachePos = -1;
+   }
+   return v;
+}
+
+
+
+/*
+ * Make room for numtimes entries in the graphics tables of all the
+ * context's variables, keeping what is already there.  The tables may
+ * move, so no work may be running on the context, see chrono.c.
+ * Return:  1 = ok, 0 = out of memory
+ */
+int alloc_variable_time_steps( Context ctx, int numtimes )
+{
+   vis5d_variable *v;
+   int n, var;
+   void *t;
+
+   n = ctx->MaxTimeSteps;
+   if (numtimes <= n) {
+      return 1;
+   }
+
+#define GROW( TABLE, TYPE )                                       \
+   t = grow_time_table( TABLE, n, numtimes, sizeof(TYPE) );       \
+   if (!t) {                                                      \
+      return 0;                                                   \
+   }                                                              \
+   TABLE = t;
+
+   /* all the tables keep n entries until the last one has grown */
+   for (var=0; var<MAXVARS; var++) {
+      v = ctx->Variable[var];
+      if (v) {
+         GROW( v->VSliceTable, struct vslice * )
+         GROW( v->CHSliceTable, struct chslice * )
+         GROW( v->CVSliceTable, struct cvslice * )
+         GROW( v->HSliceTable, struct hslice * )
+         GROW( v->SurfTable, struct isosurface * )
+      }
+   }
+#undef GROW
+
+   ctx->MaxTimeSteps = numtimes;
+   return 1;
+}
+
+
+
+/*
+ * Free variable var of a context and its per-timestep tables, but not
+ * the graphics or grids they point to.
+ */
+void free_variable( Context ctx, int var )
+{
+   vis5d_variable *v = ctx->Variable[var];
+
+   if (v) {
+      free( v->VSliceTable );
+      free( v->CHSliceTable );
+      free( v->CVSliceTable );
+      free( v->HSliceTable );
+      free( v->SurfTable );
+      free( v );
+      ctx->Variable[var] = NULL;
+   }
+   if (ctx->GridTable[var]) {
+      free( ctx->GridTable[var] );
+      ctx->GridTable[var] = NULL;
+   }
+}
+
+
+
+/*
+ * Allocate the nl (de)compression values ga[] and gb[] of a grid, as one
+ * block, if the grid doesn't have them yet.  They're allocated when the
+ * grid is first read rather than for every grid up front.
+ * Return:  1 = ok, 0 = out of memory
+ */
+static int alloc_grid_scale( Context ctx, int var, int time, int nl )
+{
+   struct grid_rec *g = &ctx->GridTable[var][time];
+
+   if (!g->Ga) {
+      g->Ga = (float *) allocate_type( ctx, 2 * nl * sizeof(float),
+                                       GRIDSCALE_TYPE );
+      if (!g->Ga) {
+         printf("Error: out of memory, couldn't read grid (time=%d, var=%d)\n",
+                time, var );
+         return 0;
+      }
+      g->Gb = g->Ga + nl;
+   }
+   return 1;
+}
+
+
+static void free_grid_scale( Context ctx, int var, int time )
+{
+   struct grid_rec *g = &ctx->GridTable[var][time];
+
+   if (g->Ga) {
+      deallocate( ctx, g->Ga, -1 );
+      g->Ga = g->Gb = NULL;
+   }
+}
+
+
+
 void free_grid_cache( Context ctx )
 {
    int it, iv;
 
-   for (it=0; it<MAXTIMES; it++){
-      for (iv=0; iv<MAXVARS; iv++){
-         if (ctx->Ga[it][iv]){
-            deallocate(ctx, ctx->Ga[it][iv], -1);
-            ctx->Ga[it][iv] = NULL;
-         }
-         if (ctx->Gb[it][iv]){
-            deallocate( ctx, ctx->Gb[it][iv], -1);
-            ctx->Gb[it][iv] = NULL;
-         }
+   for (iv=0; iv<MAXVARS; iv++){
+      if (!ctx->GridTable[iv]) {
+         continue;
+      }
+      for (it=0; it<ctx->NumTimes; it++){
+         free_grid_scale( ctx, iv, it );
       }
    }
 	for(it=0;it<ctx->MaxCachedGrids;it++)
-	  deallocate(ctx,ctx->GridCache[it].Data,0);
+	  if (ctx->GridCache[it].Data)
+	    deallocate(ctx,ctx->GridCache[it].Data,-1);
 
 	deallocate(ctx,ctx->GridCache,ctx->MaxCachedGrids
 				  * sizeof(struct cache_rec));
 	ctx->GridCache=NULL;
+	if (ctx->CacheScratch) {
+	  deallocate(ctx,ctx->CacheScratch,-1);
+	  ctx->CacheScratch=NULL;
+	}
+	ctx->CacheBytes=0;
 }
 
 
@@ -426,14 +594,10 @@ int init_grid_cache( Context ctx, PTRINT maxbytes, float *ratio )
    PTRINT gridsize;
 
    free_grid_cache( ctx );
+   ctx->GridGeneration++;
 
-   /* First allocate space for ga/gb compression values */
-   for (it=0;it<ctx->NumTimes;it++) {
-      for (iv=0;iv<ctx->NumVars;iv++) {
-         ctx->Ga[it][iv] = (float *) allocate( ctx, ctx->Nl[iv] * sizeof(float) );
-         ctx->Gb[it][iv] = (float *) allocate( ctx, ctx->Nl[iv] * sizeof(float) );
-      }
-   }
+   /* the ga/gb compression values of each grid are allocated when */
+   /* it's first read, see alloc_grid_scale() */
 
    ALLOC_LOCK( ctx->Mutex );   /* Allocate the mutex lock */
 
@@ -446,9 +610,36 @@ int init_grid_cache( Context ctx, PTRINT maxbytes, float *ratio )
       }
    }
    gridsize = (PTRINT)ctx->Nr * (PTRINT)ctx->Nc * (PTRINT)maxnl * (PTRINT)ctx->CompressMode;
+   if (V5D_STREAM_MODE(ctx->CompressMode)) {
+      /* grids are cached in blocks of their compressed size, so there */
+      /* may be a table position for every grid; estimate the fraction */
+      /* cached as if they took 2 bytes per point */
+      ctx->CacheLimit = maxbytes;
+      ctx->CacheBytes = 0;
+      ctx->CacheScratch = allocate_type( ctx, v5dCompressedBound( ctx->Nr,
+                             ctx->Nc, maxnl, ctx->CompressMode ), GRIDCACHE_TYPE );
+      if (!ctx->CacheScratch) {
+         printf("Error: out of memory.  Couldn't allocate cache space.\n");
+         return 0;
+      }
+      gridsize = (PTRINT)ctx->Nr * (PTRINT)ctx->Nc * (PTRINT)maxnl * 2L;
+   }
    ctx->MaxCachedGrids = ((PTRINT)maxbytes / (PTRINT)gridsize);
+   if (V5D_STREAM_MODE(ctx->CompressMode)) {
+      if (ctx->MaxCachedGrids < ctx->NumTimes*ctx->NumVars) {
+         *ratio = ((float) ctx->MaxCachedGrids)
+                / ((float) (ctx->NumTimes*ctx->NumVars));
+      }
+      else {
+         *ratio = 1.0;
+      }
+      ctx->MaxCachedGrids = ctx->NumTimes*ctx->NumVars;
+   }
 
-   if (ctx->MaxCachedGrids >= ctx->NumTimes*ctx->NumVars) {
+   if (V5D_STREAM_MODE(ctx->CompressMode)) {
+      /* ratio set above */
+   }
+   else if (ctx->MaxCachedGrids >= ctx->NumTimes*ctx->NumVars) {
       /* the whole file can be cached */
       ctx->MaxCachedGrids = ctx->NumTimes*ctx->NumVars;
       *ratio = 1.0;
@@ -462,7 +653,7 @@ int init_grid_cache( Context ctx, PTRINT maxbytes, float *ratio )
 
    printf("Cache size: %d grids %d %d\n", ctx->MaxCachedGrids, ctx->NumTimes,ctx->NumVars);
   
-   if (ctx->MaxCachedGrids != ctx->NumTimes*ctx->NumVars){
+   if (*ratio < 1.0){
       int needed;
       needed = (((gridsize * ctx->NumTimes * ctx->NumVars)
                * 5 / 2) / (1024*1024));
@@ -474,7 +665,7 @@ int init_grid_cache( Context ctx, PTRINT maxbytes, float *ratio )
    /* Allocate the ctx->GridCache array */
    fprintf(stderr,"Allocate the ctx->GridCache array: %ld\n",(PTRINT)ctx->MaxCachedGrids
            *(PTRINT)sizeof(struct cache_rec));
-   ctx->GridCache = (struct cache_rec *) allocate( ctx, (PTRINT)ctx->MaxCachedGrids * (PTRINT)sizeof(struct cache_rec) );
+   ctx->GridCache = (struct cache_rec *) allocate_type( ctx, (PTRINT)ctx->MaxCachedGrids * (PTRINT)sizeof(struct cache_rec), GRIDCACHE_TYPE );
    if (!ctx->GridCache) {
       printf("Error: out of memory.  Couldn't allocate cache table.\n");
       return 0;
@@ -483,8 +674,15 @@ int init_grid_cache( Context ctx, PTRINT maxbytes, float *ratio )
 
    /* Initialize tables */
    for (i=0;i<ctx->MaxCachedGrids;i++) {
+      if (V5D_STREAM_MODE(ctx->CompressMode)) {
+         /* allocated as grids are read */
+         ctx->GridCache[i].Data = NULL;
+         ctx->GridCache[i].Locked = 0;
+         ctx->GridCache[i].Age = 0;
+         continue;
+      }
       fprintf(stderr,"init tables: i=%d gridsize=%ld\n",i,gridsize);
-      ctx->GridCache[i].Data = (void *) allocate( ctx, gridsize );
+      ctx->GridCache[i].Data = (void *) allocate_type( ctx, gridsize, GRIDCACHE_TYPE );
       if (!ctx->GridCache[i].Data) {
          printf("Error: out of memory.  Couldn't allocate cache space.\n");
          return 0;
@@ -493,10 +691,13 @@ int init_grid_cache( Context ctx, PTRINT maxbytes, float *ratio )
       ctx->GridCache[i].Timestep = 0;
       ctx->GridCache[i].Var = 0;
    }
-   for (it=0;it<ctx->NumTimes;it++) {
-      for (iv=0;iv<MAXVARS;iv++) {
-         ctx->GridTable[it][iv].CachePos = -1;
-         ctx->GridTable[it][iv].Data = NULL;
+   for (iv=0;iv<MAXVARS;iv++) {
+      if (!ctx->GridTable[iv]) {
+         continue;
+      }
+      for (it=0;it<ctx->NumTimes;it++) {
+         ctx->GridTable[iv][it].CachePos = -1;
+         ctx->GridTable[iv][it].Data = NULL;
       }
    }
    return 1;
@@ -601,8 +802,8 @@ int get_empty_cache_pos( Context ctx )
       /* remove references to data being discarded */
       time = ctx->GridCache[g].Timestep;
       var = ctx->GridCache[g].Var;
-      ctx->GridTable[time][var].Data = NULL;
-      ctx->GridTable[time][var].CachePos = -1;
+      ctx->GridTable[var][time].Data = NULL;
+      ctx->GridTable[var][time].CachePos = -1;
 #endif
    }
 
@@ -612,6 +813,72 @@ int get_empty_cache_pos( Context ctx )
 
 
 
+/*
+ * Free the block of a cached grid in a stream compress mode and forget
+ * the grid.
+ */
+static void discard_stream_grid( Context ctx, int g )
+{
+   int time = ctx->GridCache[g].Timestep;
+   int var = ctx->GridCache[g].Var;
+
+   ctx->GridTable[var][time].Data = NULL;
+   ctx->GridTable[var][time].CachePos = -1;
+   ctx->CacheBytes -= v5dCompressedSize( ctx->Nr, ctx->Nc, ctx->Nl[var],
+                                         ctx->CompressMode,
+                                         ctx->GridCache[g].Data );
+   deallocate( ctx, ctx->GridCache[g].Data, -1 );
+   ctx->GridCache[g].Data = NULL;
+   ctx->GridCache[g].Locked = 0;
+}
+
+
+
+/*
+ * Return an index into the ctx->GridCache array with a new block of
+ * 'bytes' for a grid in a stream compress mode.  Least recently used
+ * grids are discarded until the block fits under ctx->CacheLimit.
+ * Return:  cache position or -1 if there's no room.
+ */
+static int get_stream_cache_pos( Context ctx, PTRINT bytes )
+{
+   int g, i, mini, minage, free_pos;
+
+   while (1) {
+      free_pos = -1;
+      mini = -1;
+      minage = ctx->CacheClock;
+      for (i=0;i<ctx->MaxCachedGrids;i++) {
+         if (!ctx->GridCache[i].Data) {
+            if (free_pos<0)  free_pos = i;
+         }
+         else if (ctx->GridCache[i].Age<minage && ctx->GridCache[i].Locked==0) {
+            minage = ctx->GridCache[i].Age;
+            mini = i;
+         }
+      }
+
+      if (free_pos>=0 && ctx->CacheBytes+bytes <= ctx->CacheLimit) {
+         g = free_pos;
+         ctx->GridCache[g].Data = allocate_type( ctx, bytes, GRIDCACHE_TYPE );
+         if (ctx->GridCache[g].Data) {
+            ctx->CacheBytes += bytes;
+            ctx->GridCache[g].Locked = 1;
+            return g;
+         }
+      }
+      if (mini<0) {
+         /* everything cached is in use */
+         return -1;
+      }
+
+      /* discard the least recently used grid */
+      discard_stream_grid( ctx, mini );
+   }
+}
+
+
+
 
 /*** get_compressed_grid **********************************************
    Return a pointer to the compressed data for a 3-D grid.
@@ -629,21 +896,56 @@ static void *get_compressed_grid( Context ctx, int time, int var,
 
   LOCK_ON( ctx->Mutex );
 
-  if (ctx->GridTable[time][var].Data) {
+  if (ctx->GridTable[var][time].Data) {
     /* already in the cache */
-    p = ctx->GridTable[time][var].CachePos;
+    p = ctx->GridTable[var][time].CachePos;
     if (p>=0) {
       ctx->GridCache[p].Locked = 1;
       ctx->GridCache[p].Age = ctx->CacheClock++;
     }
     LOCK_OFF( ctx->Mutex );
-    *ga = ctx->Ga[time][var];
-    *gb = ctx->Gb[time][var];
-    return ctx->GridTable[time][var].Data;
+    *ga = ctx->GridTable[var][time].Ga;
+    *gb = ctx->GridTable[var][time].Gb;
+    return ctx->GridTable[var][time].Data;
   }
   else {
     /* not in the cache */
     int g;
+
+    if (V5D_STREAM_MODE(ctx->CompressMode)) {
+       /* read into the scratch grid, then keep just the bytes used */
+       PTRINT bytes;
+       ok = alloc_grid_scale( ctx, var, time, ctx->Nl[var] )
+            && v5dReadCompressedGrid( &ctx->G, time, var,
+                                   ctx->GridTable[var][time].Ga, ctx->GridTable[var][time].Gb,
+                                   ctx->CacheScratch );
+       g = -1;
+       if (ok) {
+          bytes = v5dCompressedSize( ctx->Nr, ctx->Nc, ctx->Nl[var],
+                                     ctx->CompressMode, ctx->CacheScratch );
+          g = get_stream_cache_pos( ctx, bytes );
+          if (g>=0) {
+             memcpy( ctx->GridCache[g].Data, ctx->CacheScratch, bytes );
+          }
+       }
+       if (g<0) {
+          printf("Error: unable to read grid (time=%d, var=%d)\n",
+                 time, var );
+          LOCK_OFF( ctx->Mutex );
+          return NULL;
+       }
+       ctx->GridTable[var][time].Data = ctx->GridCache[g].Data;
+       ctx->GridTable[var][time].CachePos = g;
+       ctx->GridCache[g].Timestep = time;
+       ctx->GridCache[g].Var = var;
+       ctx->GridCache[g].Age = ctx->CacheClock++;
+
+       LOCK_OFF( ctx->Mutex );
+       *ga = ctx->GridTable[var][time].Ga;
+       *gb = ctx->GridTable[var][time].Gb;
+       return ctx->GridTable[var][time].Data;
+    }
+
     g = get_empty_cache_pos(ctx);
 
     /*printf("Reading grid into pos %d\n", g );*/
@@ -655,8 +957,9 @@ static void *get_compressed_grid( Context ctx, int time, int var,
       ok = read_userfile (&ctx->G, time, var, ctx->GridCache[g].Data);
    }
    if (ok == -1) {
-      ok = v5dReadCompressedGrid( &ctx->G, time, var,
-                                   ctx->Ga[time][var], ctx->Gb[time][var],
+      ok = alloc_grid_scale( ctx, var, time, ctx->Nl[var] )
+           && v5dReadCompressedGrid( &ctx->G, time, var,
+                                   ctx->GridTable[var][time].Ga, ctx->GridTable[var][time].Gb,
                                    ctx->GridCache[g].Data );
    }
    /* MJK 12.02.98 end */
@@ -671,17 +974,17 @@ static void *get_compressed_grid( Context ctx, int time, int var,
       return NULL;
     }
 
-    ctx->GridTable[time][var].Data = ctx->GridCache[g].Data;
-    ctx->GridTable[time][var].CachePos = g;
+    ctx->GridTable[var][time].Data = ctx->GridCache[g].Data;
+    ctx->GridTable[var][time].CachePos = g;
     ctx->GridCache[g].Locked = 1;
     ctx->GridCache[g].Timestep = time;
     ctx->GridCache[g].Var = var;
     ctx->GridCache[g].Age = ctx->CacheClock++;
 
     LOCK_OFF( ctx->Mutex );
-    *ga = ctx->Ga[time][var];
-    *gb = ctx->Gb[time][var];
-    return ctx->GridTable[time][var].Data;
+    *ga = ctx->GridTable[var][time].Ga;
+    *gb = ctx->GridTable[var][time].Gb;
+    return ctx->GridTable[var][time].Data;
   }
 }
 
@@ -698,7 +1001,7 @@ void release_compressed_grid( Context ctx, int time, int var )
 
    /* just unlock */
    LOCK_ON( ctx->Mutex );
-   p = ctx->GridTable[time][var].CachePos;
+   p = ctx->GridTable[var][time].CachePos;
    if (p>=0) {
       ctx->GridCache[ p ].Locked = 0;
    }
@@ -708,21 +1011,35 @@ void release_compressed_grid( Context ctx, int time, int var )
 
 
 /*
- * Load some or all of the grid data into main memory.
+ * Read the grids of one timestep into the cache.
+ */
+void preload_timestep( Context ctx, int time )
+{
+   int var;
+
+   for (var=0;var<ctx->NumVars;var++) {
+      float *ga, *gb;
+      void *d;
+      d = get_compressed_grid( ctx, time, var, &ga, &gb );
+      if (d) release_compressed_grid( ctx, time, var );
+   }
+}
+
+
+
+/*
+ * Load some or all of the grid data into main memory.  If all of it fits
+ * the first timestep is read now, so it can be shown right away, and the
+ * work queue reads the others in the background (see TASK_PRELOAD).
  */
 void preload_cache( Context ctx )
 {
    if (ctx->NumTimes*ctx->NumVars <= ctx->MaxCachedGrids) {
-      /* All grids will fit in the cache.  Read whole file now. */
-      int time, var;
+      /* All grids will fit in the cache. */
       printf("Reading all grids.\n");
-      for (time=0;time<ctx->NumTimes;time++) {
-         for (var=0;var<ctx->NumVars;var++) {
-            float *ga, *gb;
-            void *d;
-            d = get_compressed_grid( ctx, time, var, &ga, &gb );
-            if (d) release_compressed_grid( ctx, time, var );
-         }
+      preload_timestep( ctx, 0 );
+      if (ctx->NumTimes>1) {
+         request_preload( ctx, 1 );
       }
    }
 }
@@ -736,8 +1053,7 @@ void preload_cache( Context ctx )
 **********************************************************************/
 float *get_grid( Context ctx, int time, int var )
 {
-   float *data, *ga, *gb;
-   void *compdata;
+   float *data;
    int nrncnl;
 
    var = ctx->Variable[var]->CloneTable;
@@ -747,14 +1063,33 @@ float *get_grid( Context ctx, int time, int var )
       return NULL;
    }
 
+   load_grid( ctx, time, var, data );
+   return data;
+}
+
+
+
+/*** load_grid ********************************************************
+   Decompress a 3-D grid into a buffer supplied by the caller, such as
+   a shared memory segment.
+   Input:  time, var - time and variable of grid wanted.
+           data - buffer of at least Nr*Nc*Nl[var] floats.
+   Return:  1 = ok, 0 = grid not available.
+**********************************************************************/
+int load_grid( Context ctx, int time, int var, float *data )
+{
+   float *ga, *gb;
+   void *compdata;
+
+   var = ctx->Variable[var]->CloneTable;
    compdata = get_compressed_grid( ctx, time, var, &ga, &gb );
-   if (compdata) {
-     v5dDecompressGrid( ctx->Nr, ctx->Nc, ctx->Nl[var], ctx->CompressMode,
-                        compdata, ga, gb, data );
-     release_compressed_grid( ctx, time, var );
+   if (!compdata) {
+      return 0;
    }
-
-   return data;
+   v5dDecompressGrid( ctx->Nr, ctx->Nc, ctx->Nl[var], ctx->CompressMode,
+                      compdata, ga, gb, data );
+   release_compressed_grid( ctx, time, var );
+   return 1;
 }
 
 /* time = fromctx time */
@@ -847,19 +1182,53 @@ float get_grid_value( Context ctx, int time, int var,
 {
    void *data;
    float *gavec, *gbvec;
-   float value;
+   float value, point;
+   int i, cached;
 
    /* WLH 6-30-95 */
    lev -= ctx->Variable[var]->LowLev;
    if (lev < 0 || lev >= ctx->Nl[var]) return MISSING;
 
    var = ctx->Variable[var]->CloneTable;
-   data = get_compressed_grid( ctx, time, var, &gavec, &gbvec );
-   if (!data) return MISSING;
-
-   if (ctx->CompressMode == 1) {
+   cached = 1;
+   if (ctx->G.BrickSize[0]>0 && !ctx->UserDataFlag && var<ctx->G.NumVars
+       && !ctx->GridTable[var][time].Data) {
+      /* bricked file: read just the brick holding this point instead */
+      /* of pulling the whole grid into the cache */
+      LOCK_ON( ctx->Mutex );
+      cached = !alloc_grid_scale( ctx, var, time, ctx->Nl[var] )
+               || !v5dReadCompressedRegion( &ctx->G, time, var, row, col, lev,
+                                         1, 1, 1, ctx->GridTable[var][time].Ga,
+                                         ctx->GridTable[var][time].Gb, &point );
+      LOCK_OFF( ctx->Mutex );
+      data = &point;
+      gavec = ctx->GridTable[var][time].Ga;
+      gbvec = ctx->GridTable[var][time].Gb;
+      i = 0;
+   }
+   if (cached) {
+      data = get_compressed_grid( ctx, time, var, &gavec, &gbvec );
+      if (!data) return MISSING;
+      i = (lev * ctx->Nc + col) * ctx->Nr + row;
+   }
+
+   if (V5D_STREAM_MODE(ctx->CompressMode)) {
+      /* decode just the level block holding the point */
+      float *level = (float *) allocate_type( ctx, ctx->Nr * ctx->Nc
+                                              * sizeof(float), GRID_TYPE );
+      value = MISSING;
+      if (level) {
+         if (v5dDecompressLevels( ctx->Nr, ctx->Nc, ctx->Nl[var],
+                                  ctx->CompressMode, data, gavec, gbvec,
+                                  lev, 1, level )) {
+            value = level[ col * ctx->Nr + row ];
+         }
+         deallocate( ctx, level, ctx->Nr * ctx->Nc * sizeof(float) );
+      }
+   }
+   else if (ctx->CompressMode == 1) {
       V5Dubyte *data1 = (V5Dubyte *) data;
-      V5Dubyte c1 = data1[ (lev * ctx->Nc + col) * ctx->Nr + row ];
+      V5Dubyte c1 = data1[i];
       if (c1==255) {
          value = MISSING;
       }
@@ -869,7 +1238,7 @@ float get_grid_value( Context ctx, int time, int var,
    }
    else if (ctx->CompressMode == 2) {
       V5Dushort *data2 = (V5Dushort *) data;
-      V5Dushort c2 = data2[ (lev * ctx->Nc + col) * ctx->Nr + row ];
+      V5Dushort c2 = data2[i];
       if (c2==65535) {
          value = MISSING;
       }
@@ -879,10 +1248,12 @@ float get_grid_value( Context ctx, int time, int var,
    }
    else {
       float *data4 = (float *) data;
-      value = data4[ (lev * ctx->Nc + col) * ctx->Nr + row ];
+      value = data4[i];
    }
 
-   release_compressed_grid( ctx, time, var );
+   if (cached) {
+      release_compressed_grid( ctx, time, var );
+   }
 
    return value;
 }
@@ -890,34 +1261,24 @@ float get_grid_value( Context ctx, int time, int var,
 
 
 /*
- * Return a grid value at an arbitrary grid position.  Values will be
- * interpolated between neighboring values.
- * Input:  time - timestep in [0..NumTimes-1]
- *         var - variable in [0..NumVars-1]
- *         row, col, lev - location in [0..Nr-1],[0..Nc-1],[0..Nl[var]-1]
+ * Interpolate a value from the eight grid points around a position
+ * which is known to be inside the grid.
+ * Input:  mode - compression of data: 1, 2 or 4 for floats
+ *         data - the grid, or some of its levels
+ *         gavec, gbvec - decompression factors of a compressed grid
+ *         nl - number of levels of the variable
+ *         lev0 - first level held in data
+ *         row, col, lev - location in [0..Nr-1],[0..Nc-1],[0..nl-1]
  * Return:  data value or MISSING if missing.
  */
-float interpolate_grid_value( Context ctx, int time, int var,
+static float trilinear_value( Context ctx, int mode, void *data,
+                              float *gavec, float *gbvec, int nl, int lev0,
                               float row, float col, float lev )
 {
-   void *data;
-   int i0, j0, k0, i1, j1, k1;
+   int i0, j0, k0, i1, j1, k1, m0, m1;
    float d0,d1,d2,d3,d4,d5,d6,d7, d;
    float ei, ej, ek;
-   float *gavec, *gbvec, ga, gb;
-
-   /* WLH 6-30-95 */
-   lev -= ctx->Variable[var]->LowLev;
-   if (lev < 0 || lev >= ctx->Nl[var] ||
-       col < 0 || col >= ctx->Nc ||
-       row < 0 || row >= ctx->Nr){
-      return MISSING;
-   }
-
-   var = ctx->Variable[var]->CloneTable;
-
-   data = get_compressed_grid( ctx, time, var, &gavec, &gbvec );
-   if (!data) return MISSING;
+   float ga, gb;
 
    i0 = (int) row;  i1 = i0 + 1;
    j0 = (int) col;  j1 = j0 + 1;
@@ -930,7 +1291,7 @@ float interpolate_grid_value( Context ctx, int time, int var,
    if (j0==ctx->Nc-1) {
       j1 = j0;
    }
-   if (k0==ctx->Nl[var]-1) {
+   if (k0==nl-1) {
       k1 = k0;
    }
 
@@ -944,21 +1305,23 @@ float interpolate_grid_value( Context ctx, int time, int var,
    if (ej==0.0)  j1 = j0;
    if (ek==0.0)  k1 = k0;
 
-   if (ctx->CompressMode == 1) {
+   /* levels within data */
+   m0 = k0 - lev0;
+   m1 = k1 - lev0;
+
+   if (mode == 1) {
       /* get eight values at corners of a cube around (r,c,l) */
       V5Dubyte c0,c1,c2,c3,c4,c5,c6,c7;
       V5Dubyte *data1 = (V5Dubyte *) data;
 
-      c0 = data1[ (k0 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d0 @ (i0,j0,k0) */
-      c1 = data1[ (k0 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d1 @ (i1,j0,k0) */
-      c2 = data1[ (k0 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d2 @ (i0,j1,k0) */
-      c3 = data1[ (k0 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d3 @ (i1,j1,k0) */
-      c4 = data1[ (k1 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d4 @ (i0,j0,k1) */
-      c5 = data1[ (k1 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d5 @ (i1,j0,k1) */
-      c6 = data1[ (k1 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d6 @ (i0,j1,k1) */
-      c7 = data1[ (k1 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d7 @ (i1,j1,k1) */
-
-      release_compressed_grid( ctx, time, var );
+      c0 = data1[ (m0 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d0 @ (i0,j0,k0) */
+      c1 = data1[ (m0 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d1 @ (i1,j0,k0) */
+      c2 = data1[ (m0 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d2 @ (i0,j1,k0) */
+      c3 = data1[ (m0 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d3 @ (i1,j1,k0) */
+      c4 = data1[ (m1 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d4 @ (i0,j0,k1) */
+      c5 = data1[ (m1 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d5 @ (i1,j0,k1) */
+      c6 = data1[ (m1 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d6 @ (i0,j1,k1) */
+      c7 = data1[ (m1 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d7 @ (i1,j1,k1) */
 
       /* check for missing data */
       if (c0==255 || c1==255 || c2==255 || c3==255 ||
@@ -981,21 +1344,19 @@ float interpolate_grid_value( Context ctx, int time, int var,
       d6 = (float) (int) c6 * ga + gb;
       d7 = (float) (int) c7 * ga + gb;
    }
-   else if (ctx->CompressMode == 2) {
+   else if (mode == 2) {
       V5Dushort c0,c1,c2,c3,c4,c5,c6,c7;
       V5Dushort *data2 = (V5Dushort *) data;
 
       /* get eight values at corners of a cube around (r,c,l) */
-      c0 = data2[ (k0 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d0 @ (i0,j0,k0) */
-      c1 = data2[ (k0 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d1 @ (i1,j0,k0) */
-      c2 = data2[ (k0 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d2 @ (i0,j1,k0) */
-      c3 = data2[ (k0 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d3 @ (i1,j1,k0) */
-      c4 = data2[ (k1 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d4 @ (i0,j0,k1) */
-      c5 = data2[ (k1 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d5 @ (i1,j0,k1) */
-      c6 = data2[ (k1 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d6 @ (i0,j1,k1) */
-      c7 = data2[ (k1 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d7 @ (i1,j1,k1) */
-
-      release_compressed_grid( ctx, time, var );
+      c0 = data2[ (m0 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d0 @ (i0,j0,k0) */
+      c1 = data2[ (m0 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d1 @ (i1,j0,k0) */
+      c2 = data2[ (m0 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d2 @ (i0,j1,k0) */
+      c3 = data2[ (m0 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d3 @ (i1,j1,k0) */
+      c4 = data2[ (m1 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d4 @ (i0,j0,k1) */
+      c5 = data2[ (m1 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d5 @ (i1,j0,k1) */
+      c6 = data2[ (m1 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d6 @ (i0,j1,k1) */
+      c7 = data2[ (m1 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d7 @ (i1,j1,k1) */
 
       /* check for missing data */
       if (c0==65535 || c1==65535 || c2==65535 || c3==65535 ||
@@ -1022,16 +1383,14 @@ float interpolate_grid_value( Context ctx, int time, int var,
       float *data4 = (float *) data;
 
       /* get eight values at corners of a cube around (r,c,l) */
-      d0 = data4[ (k0 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d0 @ (i0,j0,k0) */
-      d1 = data4[ (k0 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d1 @ (i1,j0,k0) */
-      d2 = data4[ (k0 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d2 @ (i0,j1,k0) */
-      d3 = data4[ (k0 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d3 @ (i1,j1,k0) */
-      d4 = data4[ (k1 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d4 @ (i0,j0,k1) */
-      d5 = data4[ (k1 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d5 @ (i1,j0,k1) */
-      d6 = data4[ (k1 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d6 @ (i0,j1,k1) */
-      d7 = data4[ (k1 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d7 @ (i1,j1,k1) */
-
-      release_compressed_grid( ctx, time, var );
+      d0 = data4[ (m0 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d0 @ (i0,j0,k0) */
+      d1 = data4[ (m0 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d1 @ (i1,j0,k0) */
+      d2 = data4[ (m0 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d2 @ (i0,j1,k0) */
+      d3 = data4[ (m0 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d3 @ (i1,j1,k0) */
+      d4 = data4[ (m1 * ctx->Nc + j0) * ctx->Nr + i0 ];   /* d4 @ (i0,j0,k1) */
+      d5 = data4[ (m1 * ctx->Nc + j0) * ctx->Nr + i1 ];   /* d5 @ (i1,j0,k1) */
+      d6 = data4[ (m1 * ctx->Nc + j1) * ctx->Nr + i0 ];   /* d6 @ (i0,j1,k1) */
+      d7 = data4[ (m1 * ctx->Nc + j1) * ctx->Nr + i1 ];   /* d7 @ (i1,j1,k1) */
 
       /* check for missing data */
       if (IS_MISSING(d0) || IS_MISSING(d1) ||
@@ -1058,6 +1417,718 @@ float interpolate_grid_value( Context ctx, int time, int var,
 
 
 
+/*
+ * Return a grid value at an arbitrary grid position.  Values will be
+ * interpolated between neighboring values.
+ * Input:  time - timestep in [0..NumTimes-1]
+ *         var - variable in [0..NumVars-1]
+ *         row, col, lev - location in [0..Nr-1],[0..Nc-1],[0..Nl[var]-1]
+ * Return:  data value or MISSING if missing.
+ */
+float interpolate_grid_value( Context ctx, int time, int var,
+                              float row, float col, float lev )
+{
+   void *data;
+   int k0, k1;
+   float d;
+   float *gavec, *gbvec;
+   float *levels;
+   PTRINT levbytes;
+
+   /* WLH 6-30-95 */
+   lev -= ctx->Variable[var]->LowLev;
+   if (lev < 0 || lev >= ctx->Nl[var] ||
+       col < 0 || col >= ctx->Nc ||
+       row < 0 || row >= ctx->Nr){
+      return MISSING;
+   }
+
+   var = ctx->Variable[var]->CloneTable;
+
+   data = get_compressed_grid( ctx, time, var, &gavec, &gbvec );
+   if (!data) return MISSING;
+
+   if (!V5D_STREAM_MODE(ctx->CompressMode)) {
+      d = trilinear_value( ctx, ctx->CompressMode, data, gavec, gbvec,
+                           ctx->Nl[var], 0, row, col, lev );
+      release_compressed_grid( ctx, time, var );
+      return d;
+   }
+
+   /* decode levels k0..k1 and use them as a 4-byte grid */
+   k0 = (int) lev;
+   k1 = (k0==ctx->Nl[var]-1 || lev==(float) k0) ? k0 : k0+1;
+   levbytes = (PTRINT) ctx->Nr * ctx->Nc * (k1-k0+1) * sizeof(float);
+   levels = (float *) allocate_type( ctx, levbytes, GRID_TYPE );
+   if (!levels || !v5dDecompressLevels( ctx->Nr, ctx->Nc, ctx->Nl[var],
+                                        ctx->CompressMode, data, gavec,
+                                        gbvec, k0, k1-k0+1, levels )) {
+      if (levels)  deallocate( ctx, levels, levbytes );
+      release_compressed_grid( ctx, time, var );
+      return MISSING;
+   }
+   release_compressed_grid( ctx, time, var );
+
+   d = trilinear_value( ctx, 4, levels, NULL, NULL, ctx->Nl[var], k0,
+                        row, col, lev );
+   deallocate( ctx, levels, levbytes );
+   return d;
+}
+
+
+
+/*
+ * Interpolate a grid at many positions, like interpolate_grid_value()
+ * does one at a time, but looking the grid up in the cache only once.
+ * Nothing is taken from the context's memory pool, so this may be used
+ * while trajectories are locked.
+ * Input:  time - timestep in [0..NumTimes-1]
+ *         var - variable in [0..NumVars-1]
+ *         n - number of positions
+ *         row, col, lev - the [n] positions in grid coordinates
+ * Output:  values - the [n] values, MISSING where missing
+ */
+void interpolate_grid_values( Context ctx, int time, int var, int n,
+                              const float row[], const float col[],
+                              const float lev[], float values[] )
+{
+   void *data;
+   float *gavec, *gbvec;
+   float *levels = NULL;
+   float lowlev, l;
+   int i, k, kmin, kmax, nl, gvar, inside;
+
+   lowlev = (float) ctx->Variable[var]->LowLev;
+   gvar = ctx->Variable[var]->CloneTable;
+   nl = ctx->Nl[gvar];
+
+#define INSIDE( I, L )  ( (L) >= 0 && (L) < ctx->Nl[var] &&          \
+                          col[I] >= 0 && col[I] < ctx->Nc &&         \
+                          row[I] >= 0 && row[I] < ctx->Nr )
+
+   data = get_compressed_grid( ctx, time, gvar, &gavec, &gbvec );
+   if (!data) {
+      for (i=0;i<n;i++) {
+         values[i] = MISSING;
+      }
+      return;
+   }
+
+   if (!V5D_STREAM_MODE(ctx->CompressMode)) {
+      for (i=0;i<n;i++) {
+         l = lev[i] - lowlev;
+         values[i] = INSIDE( i, l )
+                   ? trilinear_value( ctx, ctx->CompressMode, data,
+                                      gavec, gbvec, nl, 0, row[i], col[i], l )
+                   : MISSING;
+      }
+      release_compressed_grid( ctx, time, gvar );
+      return;
+   }
+
+   /* decode only the levels which the positions are between */
+   kmin = nl;
+   kmax = -1;
+   inside = 0;
+   for (i=0;i<n;i++) {
+      l = lev[i] - lowlev;
+      if (INSIDE( i, l )) {
+         k = (int) l;
+         if (k < kmin)  kmin = k;
+         if (k+1 > kmax)  kmax = k+1;
+         inside++;
+      }
+   }
+   if (kmax > nl-1)  kmax = nl-1;
+   if (inside) {
+      levels = (float *) malloc( (PTRINT) ctx->Nr * ctx->Nc * (kmax-kmin+1)
+                                 * sizeof(float) );
+      if (levels && !v5dDecompressLevels( ctx->Nr, ctx->Nc, nl,
+                                          ctx->CompressMode, data, gavec,
+                                          gbvec, kmin, kmax-kmin+1, levels )) {
+         free( levels );
+         levels = NULL;
+      }
+   }
+   release_compressed_grid( ctx, time, gvar );
+
+   for (i=0;i<n;i++) {
+      l = lev[i] - lowlev;
+      values[i] = (levels && INSIDE( i, l ))
+                ? trilinear_value( ctx, 4, levels, NULL, NULL, nl, kmin,
+                                   row[i], col[i], l )
+                : MISSING;
+   }
+   free( levels );
+#undef INSIDE
+}
+
+
+
+/*** column cache *****************************************************
+   Vertical columns of grid values read by get_column() are cached per
+   (time, var, row, col), see struct column_cache_rec.  An entry is
+   valid while ctx->GridGeneration is unchanged, and is stamped with the
+   generation read before its grid was.  The grid cache is never
+   touched with ColumnCacheLock held.
+**********************************************************************/
+
+/* Number of levels decoded at a time when extracting columns from */
+/* a grid in one of the stream compression modes. */
+#define COLUMN_STREAM_LEVELS 16
+
+/* Size of the square of columns read and cached together from a grid */
+/* in one of the stream compression modes. */
+#define COLUMN_STREAM_PATCH 6
+
+
+/* Find the entry for a column, or -1.  Call with ColumnCacheLock held. */
+static int find_column_cache( Context ctx, int time, int var,
+                              int row, int col )
+{
+   int i;
+
+   for (i=0;i<COLUMN_CACHE_SIZE;i++) {
+      struct column_cache_rec *e = &ctx->ColumnCache[i];
+      if (e->Timestep==time && e->Var==var && e->Row==row && e->Col==col
+          && e->Generation==ctx->GridGeneration) {
+         e->Age = ctx->ColumnCacheClock++;
+         return i;
+      }
+   }
+   return -1;
+}
+
+
+/*
+ * Put copies of some columns in the cache, replacing the least
+ * recently used entries.  Nothing is cached if the grid has changed
+ * since generation was read, before the columns were.
+ */
+static void cache_columns( Context ctx, int time, int var, int generation,
+                           int n, const int rows[], const int cols[],
+                           float *columns[] )
+{
+   int i, j, e;
+
+   LOCK_ON( ctx->ColumnCacheLock );
+   for (j=0; j<n && generation==ctx->GridGeneration; j++) {
+      if (find_column_cache( ctx, time, var, rows[j], cols[j] ) >= 0) {
+         /* another thread got here first */
+         continue;
+      }
+      e = 0;
+      for (i=0;i<COLUMN_CACHE_SIZE;i++) {
+         if (ctx->ColumnCache[i].Timestep<0) {
+            e = i;
+            break;
+         }
+         if (ctx->ColumnCache[i].Age < ctx->ColumnCache[e].Age) {
+            e = i;
+         }
+      }
+      ctx->ColumnCache[e].Timestep = time;
+      ctx->ColumnCache[e].Var = var;
+      ctx->ColumnCache[e].Row = rows[j];
+      ctx->ColumnCache[e].Col = cols[j];
+      ctx->ColumnCache[e].Generation = generation;
+      ctx->ColumnCache[e].Age = ctx->ColumnCacheClock++;
+      memcpy( ctx->ColumnCacheData + e * MAXLEVELS, columns[j],
+              ctx->Nl[var] * sizeof(float) );
+   }
+   LOCK_OFF( ctx->ColumnCacheLock );
+}
+
+
+void free_column_cache( Context ctx )
+{
+   int i;
+
+   if (ctx->ColumnCacheData) {
+      deallocate( ctx, ctx->ColumnCacheData,
+                  COLUMN_CACHE_SIZE * MAXLEVELS * sizeof(float) );
+      ctx->ColumnCacheData = NULL;
+   }
+   for (i=0;i<COLUMN_CACHE_SIZE;i++) {
+      ctx->ColumnCache[i].Timestep = -1;
+      ctx->ColumnCache[i].Age = 0;
+   }
+}
+
+
+/*
+ * Decompress a box of a 1, 2 or 4-byte compressed grid.
+ * Input:  compressmode - 1, 2 or 4
+ *         data - the compressed values, column major
+ *         gnr, gnc - rows and columns of data
+ *         row0, col0, lev0 - first row, column and level of the box
+ *         nr, nc, nl - size of the box
+ *         ga, gb - the decompression values of data's levels
+ * Output:  box - the nr*nc*nl values, column major
+ */
+static void decode_box( int compressmode, const void *data, int gnr, int gnc,
+                        int row0, int col0, int lev0, int nr, int nc, int nl,
+                        const float ga[], const float gb[], float box[] )
+{
+   int r, c, l;
+
+   for (l=0; l<nl; l++) {
+      float a = ga[lev0+l], b = gb[lev0+l];
+      for (c=0; c<nc; c++) {
+         PTRINT i = ((PTRINT) (lev0+l) * gnc + col0+c) * gnr + row0;
+         float *out = box + ((PTRINT) l * nc + c) * nr;
+
+         if (compressmode == 1) {
+            const V5Dubyte *data1 = (const V5Dubyte *) data + i;
+            for (r=0; r<nr; r++) {
+               out[r] = (data1[r]==255) ? MISSING
+                                        : (float) (int) data1[r] * a + b;
+            }
+         }
+         else if (compressmode == 2) {
+            const V5Dushort *data2 = (const V5Dushort *) data + i;
+            for (r=0; r<nr; r++) {
+               out[r] = (data2[r]==65535) ? MISSING
+                                          : (float) (int) data2[r] * a + b;
+            }
+         }
+         else {
+            memcpy( out, (const float *) data + i, nr * sizeof(float) );
+         }
+      }
+   }
+}
+
+
+/*
+ * Decompress the columns at some grid points of a grid.  Only the
+ * bricks holding them are read from a bricked file, otherwise the
+ * compressed grid is taken from the grid cache.
+ * Input:  time - which timestep
+ *         var - which variable, after CloneTable
+ *         n - number of columns
+ *         rows, cols - where the columns are
+ * Output:  columns - where to put the Nl[var] values of each column
+ * Return:  1 = ok, 0 = error
+ */
+static int read_columns( Context ctx, int time, int var, int n,
+                         const int rows[], const int cols[],
+                         float *columns[] )
+{
+   int nr = ctx->Nr, nc = ctx->Nc, nl = ctx->Nl[var];
+   float *gavec, *gbvec;
+   void *data;
+   int i, ok;
+
+   if (ctx->G.BrickSize[0]>0 && !ctx->UserDataFlag && var<ctx->G.NumVars
+       && !ctx->GridTable[var][time].Data
+       && !V5D_STREAM_MODE(ctx->CompressMode)) {
+      /* bricked file: read the box around the columns */
+      int r0 = rows[0], r1 = rows[0], c0 = cols[0], c1 = cols[0];
+      PTRINT boxbytes;
+      void *box;
+
+      for (i=1;i<n;i++) {
+         if (rows[i]<r0)  r0 = rows[i];
+         if (rows[i]>r1)  r1 = rows[i];
+         if (cols[i]<c0)  c0 = cols[i];
+         if (cols[i]>c1)  c1 = cols[i];
+      }
+      boxbytes = (PTRINT) (r1-r0+1) * (c1-c0+1) * nl * ctx->CompressMode;
+      box = allocate( ctx, boxbytes );
+      if (box) {
+         LOCK_ON( ctx->Mutex );
+         ok = alloc_grid_scale( ctx, var, time, ctx->Nl[var] )
+              && v5dReadCompressedRegion( &ctx->G, time, var, r0, c0, 0,
+                                       r1-r0+1, c1-c0+1, nl,
+                                       ctx->GridTable[var][time].Ga,
+                                       ctx->GridTable[var][time].Gb, box );
+         LOCK_OFF( ctx->Mutex );
+         if (ok) {
+            for (i=0;i<n;i++) {
+               decode_box( ctx->CompressMode, box, r1-r0+1, c1-c0+1,
+                           rows[i]-r0, cols[i]-c0, 0, 1, 1, nl,
+                           ctx->GridTable[var][time].Ga, ctx->GridTable[var][time].Gb,
+                           columns[i] );
+            }
+         }
+         deallocate( ctx, box, boxbytes );
+         if (ok) {
+            return 1;
+         }
+      }
+      /* otherwise fall back on the grid cache */
+   }
+
+   data = get_compressed_grid( ctx, time, var, &gavec, &gbvec );
+   if (!data) {
+      return 0;
+   }
+
+   ok = 1;
+   if (V5D_STREAM_MODE(ctx->CompressMode)) {
+      /* decode a few levels at a time and pick the columns out of them */
+      int lev0, nlev, lev;
+      PTRINT levbytes = (PTRINT) nr * nc * COLUMN_STREAM_LEVELS
+                        * sizeof(float);
+      float *levels = (float *) allocate_type( ctx, levbytes, GRID_TYPE );
+
+      ok = levels != NULL;
+      for (lev0=0; ok && lev0<nl; lev0+=COLUMN_STREAM_LEVELS) {
+         nlev = nl-lev0 < COLUMN_STREAM_LEVELS ? nl-lev0 : COLUMN_STREAM_LEVELS;
+         ok = v5dDecompressLevels( nr, nc, nl, ctx->CompressMode, data,
+                                   gavec, gbvec, lev0, nlev, levels );
+         for (lev=0; ok && lev<nlev; lev++) {
+            for (i=0;i<n;i++) {
+               columns[i][lev0+lev] = levels[((PTRINT) lev * nc + cols[i])
+                                             * nr + rows[i]];
+            }
+         }
+      }
+      if (levels) {
+         deallocate( ctx, levels, levbytes );
+      }
+   }
+   else {
+      for (i=0;i<n;i++) {
+         decode_box( ctx->CompressMode, data, nr, nc, rows[i], cols[i], 0,
+                     1, 1, nl, gavec, gbvec, columns[i] );
+      }
+   }
+
+   release_compressed_grid( ctx, time, var );
+   return ok;
+}
+
+
+/*
+ * A grid in one of the stream modes has to be decoded a block of levels
+ * at a time whatever is taken from it, so when some of its columns are
+ * wanted the columns around them are read and cached too.
+ * Input:  time - which timestep
+ *         var - which variable, after CloneTable
+ *         row, col - upper left corner of the box around the cursor
+ *         generation - ctx->GridGeneration from before the grid is read
+ *         n - number of columns wanted, all in the box
+ *         rows, cols - where the columns are
+ * Output:  columns - where to put the Nl[var] values of each column
+ * Return:  1 = ok, 0 = error
+ */
+static int read_stream_columns( Context ctx, int time, int var,
+                                int generation, int row, int col, int n,
+                                const int rows[], const int cols[],
+                                float *columns[] )
+{
+   int prow[COLUMN_STREAM_PATCH*COLUMN_STREAM_PATCH];
+   int pcol[COLUMN_STREAM_PATCH*COLUMN_STREAM_PATCH];
+   float *pcolumns[COLUMN_STREAM_PATCH*COLUMN_STREAM_PATCH];
+   int nl = ctx->Nl[var];
+   PTRINT bytes = (PTRINT) COLUMN_STREAM_PATCH * COLUMN_STREAM_PATCH
+                  * nl * sizeof(float);
+   float *buf;
+   int r0, c0, pr, pc, r, c, np, i, ok;
+
+   buf = (float *) allocate( ctx, bytes );
+   if (!buf) {
+      return read_columns( ctx, time, var, n, rows, cols, columns );
+   }
+
+   r0 = row - COLUMN_STREAM_PATCH/2 + 1;
+   if (r0 > ctx->Nr - COLUMN_STREAM_PATCH)  r0 = ctx->Nr - COLUMN_STREAM_PATCH;
+   if (r0 < 0)  r0 = 0;
+   c0 = col - COLUMN_STREAM_PATCH/2 + 1;
+   if (c0 > ctx->Nc - COLUMN_STREAM_PATCH)  c0 = ctx->Nc - COLUMN_STREAM_PATCH;
+   if (c0 < 0)  c0 = 0;
+   pr = ctx->Nr-r0 < COLUMN_STREAM_PATCH ? ctx->Nr-r0 : COLUMN_STREAM_PATCH;
+   pc = ctx->Nc-c0 < COLUMN_STREAM_PATCH ? ctx->Nc-c0 : COLUMN_STREAM_PATCH;
+
+   np = 0;
+   for (c=c0; c<c0+pc; c++) {
+      for (r=r0; r<r0+pr; r++) {
+         prow[np] = r;
+         pcol[np] = c;
+         pcolumns[np] = buf + np * nl;
+         np++;
+      }
+   }
+
+   ok = read_columns( ctx, time, var, np, prow, pcol, pcolumns );
+   if (ok) {
+      cache_columns( ctx, time, var, generation, np, prow, pcol, pcolumns );
+      for (i=0;i<n;i++) {
+         memcpy( columns[i], pcolumns[(cols[i]-c0) * pr + rows[i]-r0],
+                 nl * sizeof(float) );
+      }
+   }
+   deallocate( ctx, buf, bytes );
+   return ok;
+}
+
+
+/*
+ * Return the vertical column of a variable at an arbitrary horizontal
+ * grid position.  Values are bilinearly interpolated between the four
+ * grid columns around it, which are decompressed on their own and kept
+ * in a small cache so that moving the sounding cursor or probe around
+ * doesn't decompress whole grids.
+ * Input:  time - timestep in [0..NumTimes-1]
+ *         var - variable in [0..NumVars-1]
+ *         row, col - location in [0..Nr-1],[0..Nc-1]
+ * Output:  column - the Nl[var] values of the variable's levels,
+ *                   MISSING where any of the four is missing.
+ * Return:  1 = ok, 0 = bad location or no data.
+ */
+int get_column( Context ctx, int time, int var, float row, float col,
+                float column[] )
+{
+   float corner[4][MAXLEVELS], *I, *J, *K, *L;
+   float *readcol[4];
+   int rows[4], cols[4], src[4], readrow[4], readcolumn[4];
+   int nl, nread, i, j, lev, generation;
+   float a, b, c, d;
+
+   if (time < 0 || time >= ctx->NumTimes ||
+       row < 0 || row >= ctx->Nr ||
+       col < 0 || col >= ctx->Nc) {
+      return 0;
+   }
+   nl = ctx->Nl[var];
+   var = ctx->Variable[var]->CloneTable;
+
+   /*
+    * The corners of the box around (row, col) are numbered
+    *   0 = (lowrow, leftcol)   1 = (lowrow, rightcol)
+    *   2 = (highrow, leftcol)  3 = (highrow, rightcol)
+    * A box on a grid line or the grid edge collapses, src[] tells which
+    * corner repeats which.
+    */
+   rows[0] = rows[1] = (int) row;
+   cols[0] = cols[2] = (int) col;
+   rows[2] = rows[3] = (row==rows[0] || rows[0]==ctx->Nr-1) ? rows[0]
+                                                           : rows[0]+1;
+   cols[1] = cols[3] = (col==cols[0] || cols[0]==ctx->Nc-1) ? cols[0]
+                                                           : cols[0]+1;
+   for (i=0;i<4;i++) {
+      src[i] = i;
+      for (j=0;j<i;j++) {
+         if (rows[j]==rows[i] && cols[j]==cols[i]) {
+            src[i] = j;
+            break;
+         }
+      }
+   }
+
+   if (!ctx->ColumnCacheData) {
+      float *data = (float *) allocate( ctx, COLUMN_CACHE_SIZE * MAXLEVELS
+                                             * sizeof(float) );
+      LOCK_ON( ctx->ColumnCacheLock );
+      if (!ctx->ColumnCacheData) {
+         ctx->ColumnCacheData = data;
+         data = NULL;
+      }
+      LOCK_OFF( ctx->ColumnCacheLock );
+      deallocate( ctx, data, COLUMN_CACHE_SIZE * MAXLEVELS * sizeof(float) );
+   }
+
+   /* take what we can from the cache */
+   generation = ctx->GridGeneration;
+   nread = 0;
+   LOCK_ON( ctx->ColumnCacheLock );
+   for (i=0;i<4;i++) {
+      int e = -1;
+      if (src[i]!=i) {
+         continue;
+      }
+      if (ctx->ColumnCacheData) {
+         e = find_column_cache( ctx, time, var, rows[i], cols[i] );
+      }
+      if (e>=0) {
+         memcpy( corner[i], ctx->ColumnCacheData + e * MAXLEVELS,
+                 nl * sizeof(float) );
+      }
+      else {
+         readrow[nread] = rows[i];
+         readcolumn[nread] = cols[i];
+         readcol[nread++] = corner[i];
+      }
+   }
+   LOCK_OFF( ctx->ColumnCacheLock );
+
+   /* and decompress the rest */
+   if (nread>0) {
+      if (V5D_STREAM_MODE(ctx->CompressMode) && ctx->ColumnCacheData) {
+         if (!read_stream_columns( ctx, time, var, generation,
+                                   rows[0], cols[0], nread,
+                                   readrow, readcolumn, readcol )) {
+            return 0;
+         }
+      }
+      else {
+         if (!read_columns( ctx, time, var, nread, readrow, readcolumn,
+                            readcol )) {
+            return 0;
+         }
+         if (ctx->ColumnCacheData) {
+            cache_columns( ctx, time, var, generation, nread,
+                           readrow, readcolumn, readcol );
+         }
+      }
+   }
+
+   I = corner[src[0]];
+   J = corner[src[1]];
+   K = corner[src[2]];
+   L = corner[src[3]];
+   a = col - cols[0];
+   b = 1.0 - a;
+   c = row - rows[0];
+   d = 1.0 - c;
+   for (lev=0; lev<nl; lev++) {
+      if (IS_MISSING(I[lev]) || IS_MISSING(J[lev]) ||
+          IS_MISSING(K[lev]) || IS_MISSING(L[lev])) {
+         column[lev] = MISSING;
+      }
+      else if (src[3]==0) {
+         column[lev] = I[lev];
+      }
+      else {
+         column[lev] = c * (a * L[lev] + b * K[lev])
+                     + d * (a * J[lev] + b * I[lev]);
+      }
+   }
+   return 1;
+}
+
+
+/*
+ * Return a grid value at an arbitrary grid position, interpolated like
+ * interpolate_grid_value() does but taken from the column at the
+ * position with get_column().  Meant for the probe, which samples
+ * positions near each other over and over.
+ * Input:  time - timestep in [0..NumTimes-1]
+ *         var - variable in [0..NumVars-1]
+ *         row, col, lev - location in [0..Nr-1],[0..Nc-1],[0..Nl[var]-1]
+ * Return:  data value or MISSING if missing.
+ */
+float probe_grid_value( Context ctx, int time, int var,
+                        float row, float col, float lev )
+{
+   float column[MAXLEVELS], ek;
+   int k0, k1;
+
+   lev -= ctx->Variable[var]->LowLev;
+   if (lev < 0 || lev >= ctx->Nl[var]) {
+      return MISSING;
+   }
+   if (!get_column( ctx, time, var, row, col, column )) {
+      return MISSING;
+   }
+
+   k0 = (int) lev;
+   ek = lev - (float) k0;
+   k1 = (ek==0.0 || k0==ctx->Nl[var]-1) ? k0 : k0+1;
+   if (IS_MISSING(column[k0]) || IS_MISSING(column[k1])) {
+      return MISSING;
+   }
+   return column[k0] * (1.0-ek) + column[k1] * ek;
+}
+
+
+/* read_grid_box() reads a box from a file which isn't bricked on its */
+/* own only if the box is at most 1/PARTIAL_READ_FRACTION of the grid. */
+#define PARTIAL_READ_FRACTION 8
+
+
+/*
+ * Decompress a box-shaped part of a grid.  If the grid isn't in the
+ * cache and is in a file which can be read in parts, only the part of
+ * the file holding the box is read (just the bricks around it with a
+ * bricked file) and the grid cache is left alone.
+ * Input:  time - timestep in [0..NumTimes-1]
+ *         var - variable in [0..NumVars-1]
+ *         row0, col0, lev0 - first row, column and level of the box,
+ *                            levels counted from the variable's lowest
+ *         nr, nc, nl - size of the box
+ * Output:  box - the nr*nc*nl values, column major like a whole grid
+ * Return:  1 = ok, 0 = bad box or no data.
+ */
+int read_grid_box( Context ctx, int time, int var,
+                   int row0, int col0, int lev0, int nr, int nc, int nl,
+                   float box[] )
+{
+   PTRINT size = (PTRINT) nr * nc * nl;
+   float *gavec, *gbvec;
+   void *data;
+   int ok;
+
+   if (time<0 || time>=ctx->NumTimes ||
+       row0<0 || col0<0 || lev0<0 || nr<1 || nc<1 || nl<1 ||
+       row0+nr>ctx->Nr || col0+nc>ctx->Nc || lev0+nl>ctx->Nl[var]) {
+      return 0;
+   }
+   var = ctx->Variable[var]->CloneTable;
+
+   if (!ctx->UserDataFlag && var<ctx->G.NumVars
+       && !ctx->GridTable[var][time].Data
+       && !V5D_STREAM_MODE(ctx->CompressMode)
+       && (ctx->G.BrickSize[0]>0 ||
+           size * PARTIAL_READ_FRACTION
+           <= (PTRINT) ctx->Nr * ctx->Nc * ctx->Nl[var])) {
+      PTRINT bytes = size * ctx->CompressMode;
+      void *comp = allocate( ctx, bytes );
+
+      if (comp) {
+         float ga[MAXLEVELS], gb[MAXLEVELS];
+
+         LOCK_ON( ctx->Mutex );
+         ok = v5dReadCompressedRegion( &ctx->G, time, var, row0, col0, lev0,
+                                       nr, nc, nl, ga, gb, comp );
+         LOCK_OFF( ctx->Mutex );
+         if (ok) {
+            decode_box( ctx->CompressMode, comp, nr, nc, 0, 0, 0, nr, nc, nl,
+                        ga+lev0, gb+lev0, box );
+         }
+         deallocate( ctx, comp, bytes );
+         if (ok) {
+            return 1;
+         }
+      }
+      /* otherwise fall back on the grid cache */
+   }
+
+   data = get_compressed_grid( ctx, time, var, &gavec, &gbvec );
+   if (!data) {
+      return 0;
+   }
+
+   if (V5D_STREAM_MODE(ctx->CompressMode)) {
+      /* decode the box's levels and copy the box out of them */
+      PTRINT levbytes = (PTRINT) ctx->Nr * ctx->Nc * nl * sizeof(float);
+      float *levels = (float *) allocate_type( ctx, levbytes, GRID_TYPE );
+
+      ok = levels && v5dDecompressLevels( ctx->Nr, ctx->Nc, ctx->Nl[var],
+                                          ctx->CompressMode, data, gavec,
+                                          gbvec, lev0, nl, levels );
+      if (ok) {
+         decode_box( 4, levels, ctx->Nr, ctx->Nc, row0, col0, 0, nr, nc, nl,
+                     gavec, gbvec, box );
+      }
+      if (levels) {
+         deallocate( ctx, levels, levbytes );
+      }
+   }
+   else {
+      decode_box( ctx->CompressMode, data, ctx->Nr, ctx->Nc, row0, col0, lev0,
+                  nr, nc, nl, gavec, gbvec, box );
+      ok = 1;
+   }
+
+   release_compressed_grid( ctx, time, var );
+   return ok;
+}
+
+
+
 
 /*** allocate_clone_variable *****************************************
    Allocate a new variable which is to be a clone of an existing one.
@@ -1079,8 +2150,9 @@ int allocate_clone_variable( Context ctx, const char name[], int var_to_clone )
    }
 	newvar = ctx->NumVars;
 
-	ctx->Variable[newvar] = (vis5d_variable *) calloc(1,sizeof(vis5d_variable));
-
+   if (!new_variable( ctx, newvar )) {
+      return -1;
+   }
 
    ctx->Variable[newvar]->VarType = VIS5D_CLONE;
    ctx->Variable[newvar]->CloneTable = var_to_clone;
@@ -1136,7 +2208,9 @@ int allocate_extfunc_variable( Context ctx, char name[] )
       /* no space for a new variable */
       return -1;
    }
-	ctx->Variable[newvar] = (vis5d_variable *) calloc(1,sizeof(vis5d_variable));
+   if (!new_variable( ctx, newvar )) {
+      return -1;
+   }
 
    ctx->Variable[newvar]->VarType = VIS5D_EXT_FUNC;
    ctx->Variable[newvar]->CloneTable = newvar;
@@ -1173,7 +2247,9 @@ int allocate_computed_variable( Context ctx, const char *name )
       /* no space for a new variable */
       return -1;
    }
-	ctx->Variable[newvar] = (vis5d_variable *) calloc(1,sizeof(vis5d_variable));
+   if (!new_variable( ctx, newvar )) {
+      return -1;
+   }
 
 
    ctx->Variable[newvar]->VarType = VIS5D_EXPRESSION;
@@ -1202,13 +2278,16 @@ int allocate_new_variable( Context ctx, const char *name, int nl, int lowlev )
    float *griddata;
 
    for (newvar=0;newvar<MAXVARS;newvar++) {
-      if (ctx->Variable[newvar]->VarType==0)
+      if (ctx->Variable[newvar]==NULL)
          break;
    }
    if (newvar==MAXVARS) {
       /* no space for a new variable */
       return -1;
    }
+   if (!new_variable( ctx, newvar )) {
+      return -1;
+   }
 
    ctx->Variable[newvar]->VarType = VIS5D_PUT;
    ctx->Variable[newvar]->CloneTable = newvar;
@@ -1261,44 +2340,50 @@ int deallocate_variable( Context ctx, int var )
            nl - number of levels in new grid (we know Nr and Nc)
            lowlev - lowest level in new grid
    Return:  1=ok, 0=error
+   Timesteps may be installed by several threads at once; the shared
+   variable fields are only changed with ctx->Mutex held.
 **********************************************************************/
 int install_new_grid( Context ctx, int time, int var,
                       float *griddata, int nl, int lowlev)
 {
    float min, max;
 
+   LOCK_ON( ctx->Mutex );
    ctx->Nl[var] = nl;
    ctx->Variable[var]->LowLev = lowlev;
+   LOCK_OFF( ctx->Mutex );
+
+   if (V5D_STREAM_MODE(ctx->CompressMode) && ctx->GridTable[var][time].Data
+       && ctx->GridTable[var][time].CachePos>=0) {
+      /* a grid read from the file only has room for its own stream */
+      LOCK_ON( ctx->Mutex );
+      discard_stream_grid( ctx, ctx->GridTable[var][time].CachePos );
+      LOCK_OFF( ctx->Mutex );
+   }
 
-   if (!ctx->GridTable[time][var].Data) {
-      PTRINT bytes = (PTRINT)ctx->Nr * (PTRINT)ctx->Nc * (PTRINT)nl * (PTRINT)ctx->CompressMode;
+   if (!ctx->GridTable[var][time].Data) {
+      PTRINT bytes = v5dCompressedBound( ctx->Nr, ctx->Nc, nl, ctx->CompressMode );
       fprintf(stderr,"install new grid: bytes=%ld\n",bytes);
-      ctx->GridTable[time][var].Data = (void *) allocate( ctx, bytes );
-      if (ctx->Ga[time][var]){
-         deallocate( ctx, ctx->Ga[time][var], -1);
-         ctx->Ga[time][var] = NULL;
-      }
-      if (ctx->Gb[time][var]){
-         deallocate( ctx, ctx->Gb[time][var], -1);
-         ctx->Gb[time][var] = NULL;
-      }
-      ctx->Ga[time][var] = (float *) allocate( ctx, nl * sizeof(float) );
-      ctx->Gb[time][var] = (float *) allocate( ctx, nl * sizeof(float) );
-      if (!ctx->GridTable[time][var].Data
-          || !ctx->Ga[time][var] || !ctx->Gb[time][var]) {
+      ctx->GridTable[var][time].Data = (void *) allocate_type( ctx, bytes, GRIDCACHE_TYPE );
+      free_grid_scale( ctx, var, time );
+      if (!ctx->GridTable[var][time].Data
+          || !alloc_grid_scale( ctx, var, time, nl )) {
          printf("Out of memory, couldn't save results of external ");
          printf("function computation.\n");
          return 0;
       }
    }
    /* compress the data */
-   v5dCompressGrid( ctx->Nr, ctx->Nc, nl, ctx->CompressMode, griddata,
-                    ctx->GridTable[time][var].Data,
-                    ctx->Ga[time][var], ctx->Gb[time][var], &min, &max );
+   v5dCompressGridTol( ctx->Nr, ctx->Nc, nl, ctx->CompressMode,
+                       ctx->G.Tolerance, griddata,
+                       ctx->GridTable[var][time].Data,
+                       ctx->GridTable[var][time].Ga, ctx->GridTable[var][time].Gb, &min, &max );
 
-   ctx->GridTable[time][var].CachePos = -1;
+   ctx->GridTable[var][time].CachePos = -1;
 
    /* update min and max values */
+   LOCK_ON( ctx->Mutex );
+   ctx->GridGeneration++;
    if (min<ctx->Variable[var]->MinVal) {
       ctx->Variable[var]->MinVal = min;
       ctx->Variable[var]->RealMinVal = min;
@@ -1307,6 +2392,7 @@ int install_new_grid( Context ctx, int time, int var,
       ctx->Variable[var]->MaxVal = max;
       ctx->Variable[var]->RealMaxVal = max;
    }
+   LOCK_OFF( ctx->Mutex );
 
    return 1;
 }
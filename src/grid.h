@@ -36,11 +36,13 @@
 #include "globals.h"
 
 
-extern int McFile[MAXTIMES][MAXVARS];
-extern int McGrid[MAXTIMES][MAXVARS];
+extern int initially_open_gridfile( const char filename[], v5dstruct *v );
 
+extern vis5d_variable *new_variable( Context ctx, int var );
 
-extern int initially_open_gridfile( const char filename[], v5dstruct *v );
+extern void free_variable( Context ctx, int var );
+
+extern int alloc_variable_time_steps( Context ctx, int numtimes );
 
 extern void free_grid_cache( Context ctx );
 
@@ -48,10 +50,14 @@ extern int open_gridfile( Context ctx, const char filename[] );
 
 extern int init_grid_cache( Context ctx, PTRINT maxbytes, float *ratio );
 
+extern void preload_timestep( Context ctx, int time );
+
 extern void preload_cache( Context ctx );
 
 extern float *get_grid( Context ctx, int time, int var );
 
+extern int load_grid( Context ctx, int time, int var, float *data );
+
 extern float *get_grid2( Context toctx, Context fromctx, int time, int var, int numlevs );
 
 extern int put_grid( Context ctx, int time, int var, float *griddata );
@@ -72,6 +78,22 @@ extern int get_empty_cache_pos( Context ctx );
 extern float interpolate_grid_value( Context ctx, int time, int var,
                                      float row, float col, float lev );
 
+extern void interpolate_grid_values( Context ctx, int time, int var, int n,
+                                     const float row[], const float col[],
+                                     const float lev[], float values[] );
+
+extern int get_column( Context ctx, int time, int var, float row, float col,
+                       float column[] );
+
+extern float probe_grid_value( Context ctx, int time, int var,
+                               float row, float col, float lev );
+
+extern void free_column_cache( Context ctx );
+
+extern int read_grid_box( Context ctx, int time, int var,
+                          int row0, int col0, int lev0, int nr, int nc, int nl,
+                          float box[] );
+
 extern int allocate_clone_variable( Context ctx, const char name[],
                                     int var_to_clone );
 
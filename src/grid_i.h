@@ -47,7 +47,7 @@
  * smaller and found in v5d.h
  */
 #define IMAXVARS     70
-#define IMAXTIMES  1000
+#define IMAXTIMES 10000
 #define IMAXPROJ    100
 
 
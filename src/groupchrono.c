@@ -76,6 +76,7 @@ void calculate_group_time_steps( Display_Group grp )
    int tempday, tempsec, closest_tyme, timecount;
    int netcolumn, dpy_numtimes[VIS5D_MAX_CONTEXTS];
    int grp_time_position[VIS5D_MAX_DPY_CONTEXTS];
+   int numtimes;
 
    if (grp->numofdpys < 1){
       return;
@@ -104,6 +105,24 @@ void calculate_group_time_steps( Display_Group grp )
       }
    }
 
+   /* the timeline has at most one step per display time step, and */
+   /* always at least one */
+   numtimes = 1;
+   for (yo=0; yo < grp->numofdpys; yo++){
+      numtimes += dpy_numtimes[grp->dpyarray[yo]->dpy_context_index];
+   }
+   if (numtimes > grp->MaxTimeSteps){
+      void *t = grow_time_table( grp->TimeStep, grp->MaxTimeSteps, numtimes,
+                                 sizeof(struct dpy_timestep) );
+      if (!t){
+         printf("Error: out of memory.  Couldn't allocate %d group time steps.\n",
+                numtimes );
+         return;
+      }
+      grp->TimeStep = t;
+      grp->MaxTimeSteps = numtimes;
+   }
+
    erly_day = erly_sec = 100000000;
    timecount = 0;
 
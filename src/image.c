@@ -322,7 +322,7 @@ void init_image( Display_Context dtx )
 void define_texture( Display_Context dtx, int time, int width, int height,
                      int components, void *image )
 {
-   assert( time>=0 && time<=dtx->NumTimes );
+   assert( time>=0 && time<dtx->MaxTimeSteps );
 
    dtx->TexWidth[time] = width;
    dtx->TexHeight[time] = height;
@@ -0,0 +1,526 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+
+/*
+ * Simplified levels of detail (LODs) for isosurfaces.
+ *
+ * A LOD is made by vertex clustering: space is cut into cells a few grid
+ * boxes on a side, all the vertices in a cell are merged into one at their
+ * mean position and the triangles which don't collapse are kept.  The
+ * remaining triangles are then put back together into triangle strips and
+ * stored in chunks like the full surface (see isomesh.c), so a LOD is
+ * drawn by the same code.
+ * Each LOD is made from the previous, finer one with twice the cell size.
+ */
+
+
+#include "../config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "isolod.h"
+#include "isomesh.h"
+#include "memory.h"
+
+
+/* surfaces with fewer triangles than this are not simplified */
+#define LOD_MIN_TRIS     20000
+
+/* a level must have at most this fraction of the finer level's triangles */
+#define LOD_MIN_GAIN     0.6
+
+/* largest vertex displacement, in pixels, allowed when drawing a LOD */
+#define LOD_ERROR        1.0
+#define LOD_FAST_ERROR   4.0
+
+/* triangle budget for one surface while rotating or animating */
+#define LOD_FAST_TRIS    250000
+
+
+
+/*
+ * Deallocate the arrays of one LOD.
+ * Return:  number of bytes freed
+ */
+static int free_lod( Context ctx, struct iso_lod *lod )
+{
+   int bytes = 0;
+
+   if (lod->verts) {
+      deallocate( ctx, lod->verts, 3*lod->numverts*sizeof(int_vert2) );
+      bytes += 3*lod->numverts*sizeof(int_vert2);
+   }
+   if (lod->norms) {
+      deallocate( ctx, lod->norms, 3*lod->numverts*sizeof(int_1) );
+      bytes += 3*lod->numverts*sizeof(int_1);
+   }
+   if (lod->colors) {
+      deallocate( ctx, lod->colors, lod->numverts*sizeof(uint_1) );
+      bytes += lod->numverts*sizeof(uint_1);
+   }
+   if (lod->vmap) {
+      deallocate( ctx, lod->vmap, lod->numverts*sizeof(uint_index) );
+      bytes += lod->numverts*sizeof(uint_index);
+   }
+   bytes += free_iso_chunks( ctx, lod->numindex, lod->index,
+                             lod->numchunks, lod->chunks );
+   memset( lod, 0, sizeof(struct iso_lod) );
+   return bytes;
+}
+
+
+
+/*
+ * Setup the clustering cells along one axis of the box.
+ * Input:  n - number of grid points along the axis
+ *         min, max - extent of the box in graphics coordinates
+ *         factor - cell size in grid boxes
+ * Output:  origin - start of the first cell in compressed coordinates
+ *          scale - converts compressed coordinates to cells
+ *          size - cell size in graphics units
+ * Return:  number of cells
+ */
+static int setup_cells( int n, float min, float max, int factor,
+                        float *origin, float *scale, float *size )
+{
+   *origin = min * VERTEX_SCALE;
+   if (n<2 || max<=min) {
+      *scale = 0.0;
+      *size = 0.0;
+      return 1;
+   }
+   *size = factor * (max-min) / (n-1);
+   *scale = 1.0 / (*size * VERTEX_SCALE);
+   return (n-2) / factor + 2;
+}
+
+
+static int cell_of( float v, float origin, float scale, int n )
+{
+   int i = (int) ((v-origin) * scale);
+   return i<0 ? 0 : (i>=n ? n-1 : i);
+}
+
+
+
+/*
+ * Find an unused triangle which has the edge u-v.
+ * Output:  w - the third vertex of the triangle
+ * Return:  the triangle or -1 if none
+ */
+static int next_triangle( int u, int v, const int *tris, const int *start,
+                          const int *inc, const char *used, int *w )
+{
+   int k, t;
+   const int *p;
+
+   for (k=start[u];k<start[u+1];k++) {
+      t = inc[k];
+      p = tris + 3*t;
+      if (!used[t] && (p[0]==v || p[1]==v || p[2]==v)) {
+         *w = p[0] + p[1] + p[2] - u - v;
+         return t;
+      }
+   }
+   return -1;
+}
+
+
+static void sort3( const int *p, int *s )
+{
+   int t;
+
+   s[0] = p[0];  s[1] = p[1];  s[2] = p[2];
+   if (s[0]>s[1]) { t = s[0];  s[0] = s[1];  s[1] = t; }
+   if (s[1]>s[2]) { t = s[1];  s[1] = s[2];  s[2] = t; }
+   if (s[0]>s[1]) { t = s[0];  s[0] = s[1];  s[1] = t; }
+}
+
+
+
+/*
+ * Make one level of detail by merging the vertices of a finer mesh which
+ * fall into the same cell and restripping the triangles which are left.
+ * Input:  ctx - the context
+ *         in - the finer mesh, in->vmap is NULL for the full surface
+ *         factor - cell size in grid boxes
+ * Output:  out - the simplified mesh
+ * Return:  1 = ok, 0 = out of memory or not enough simplification
+ */
+static int cluster_mesh( Context ctx, struct iso_lod *in, int factor,
+                         struct iso_lod *out )
+{
+   Display_Context dtx = ctx->dpy_ctx;
+   int nx, ny, nz, size, shift, i, j, k, nc, ntris, ntris_in, n, nv, t;
+   int a, b, c, w, len;
+   float x0, y0, z0, sx, sy, sz, cx, cy, cz;
+   unsigned int *keys = NULL;
+   int *ids = NULL, *map = NULL, *count = NULL, *rep = NULL;
+   int *nsum = NULL, *tris = NULL, *start = NULL, *inc = NULL;
+   int *strip = NULL, *vorder = NULL;
+   float *sum = NULL;
+   char *used = NULL;
+   int ok = 0;
+
+   memset( out, 0, sizeof(struct iso_lod) );
+   if (in->numverts<=0 || in->numindex<3) {
+      return 0;
+   }
+
+   nx = setup_cells( dtx->Nc, dtx->Xmin, dtx->Xmax, factor, &x0, &sx, &cx );
+   ny = setup_cells( dtx->Nr, dtx->Ymin, dtx->Ymax, factor, &y0, &sy, &cy );
+   nz = setup_cells( dtx->MaxNl, dtx->Zmin, dtx->Zmax, factor, &z0, &sz, &cz);
+   out->cellsize = cx>cy ? (cx>cz ? cx : cz) : (cy>cz ? cy : cz);
+
+   /* hash table of the cells which have vertices */
+   for (size=1,shift=32; size<2*in->numverts; size*=2,shift--);
+   keys = (unsigned int *) malloc( size * sizeof(unsigned int) );
+   ids = (int *) malloc( size * sizeof(int) );
+   map = (int *) malloc( in->numverts * sizeof(int) );
+   count = (int *) malloc( in->numverts * sizeof(int) );
+   rep = (int *) malloc( in->numverts * sizeof(int) );
+   sum = (float *) malloc( 3 * in->numverts * sizeof(float) );
+   nsum = (int *) malloc( 3 * in->numverts * sizeof(int) );
+   tris = (int *) malloc( 3 * in->numindex * sizeof(int) );
+   if (!keys || !ids || !map || !count || !rep || !sum || !nsum || !tris) {
+      goto cleanup;
+   }
+   for (i=0;i<size;i++) {
+      ids[i] = -1;
+   }
+
+   /* merge the vertices of each cell */
+   nc = 0;
+   for (i=0;i<in->numverts;i++) {
+      unsigned int key, h;
+      key = ((unsigned int) cell_of( in->verts[3*i+2], z0, sz, nz ) * ny
+             + cell_of( in->verts[3*i+1], y0, sy, ny )) * nx
+             + cell_of( in->verts[3*i], x0, sx, nx );
+      h = (key * 2654435761u) >> shift;
+      if (shift==32) {
+         h = 0;
+      }
+      while (ids[h]>=0 && keys[h]!=key) {
+         h = (h+1) & (size-1);
+      }
+      if (ids[h]<0) {
+         keys[h] = key;
+         ids[h] = nc;
+         count[nc] = 0;
+         rep[nc] = i;
+         sum[3*nc] = sum[3*nc+1] = sum[3*nc+2] = 0.0;
+         nsum[3*nc] = nsum[3*nc+1] = nsum[3*nc+2] = 0;
+         nc++;
+      }
+      c = ids[h];
+      map[i] = c;
+      count[c]++;
+      for (j=0;j<3;j++) {
+         sum[3*c+j] += in->verts[3*i+j];
+         nsum[3*c+j] += in->norms[3*i+j];
+      }
+   }
+   free( keys );
+   keys = NULL;
+   free( ids );
+   ids = NULL;
+   for (c=0;c<nc;c++) {
+      for (j=0;j<3;j++) {
+         sum[3*c+j] /= count[c];
+      }
+   }
+
+   /* keep the triangles of the strips which didn't collapse */
+   ntris = ntris_in = 0;
+   a = b = c = 0;
+   for (j=0;j<in->numchunks;j++) {
+      const struct iso_chunk *ch = &in->chunks[j];
+      const uint_2 *ci = in->index + ch->ibase;
+      len = 0;
+      for (i=0;i<ch->numindex;i++) {
+         if (ci[i]==ISO_RESTART) {
+            len = 0;
+            continue;
+         }
+         a = b;
+         b = c;
+         c = map[ch->vbase + ci[i]];
+         if (++len >= 3) {
+            ntris_in++;
+            if (a!=b && b!=c && a!=c) {
+               tris[3*ntris] = a;
+               tris[3*ntris+1] = b;
+               tris[3*ntris+2] = c;
+               ntris++;
+            }
+         }
+      }
+   }
+   if (ntris==0 || ntris > LOD_MIN_GAIN * ntris_in) {
+      goto cleanup;
+   }
+
+   /* triangles around each vertex */
+   start = (int *) calloc( nc+1, sizeof(int) );
+   inc = (int *) malloc( 3 * ntris * sizeof(int) );
+   used = (char *) calloc( ntris, 1 );
+   strip = (int *) malloc( 4 * ntris * sizeof(int) );
+   if (!start || !inc || !used || !strip) {
+      goto cleanup;
+   }
+   for (i=0;i<3*ntris;i++) {
+      start[tris[i]+1]++;
+   }
+   for (i=0;i<nc;i++) {
+      start[i+1] += start[i];
+      count[i] = start[i];
+   }
+   for (i=0;i<3*ntris;i++) {
+      inc[count[tris[i]]++] = i/3;
+   }
+
+   /* drop triangles which collapsed onto another one */
+   for (t=0;t<ntris;t++) {
+      int s[3], s2[3];
+      sort3( tris+3*t, s );
+      for (k=start[s[0]];k<start[s[0]+1] && inc[k]<t;k++) {
+         if (!used[inc[k]]) {
+            sort3( tris+3*inc[k], s2 );
+            if (s[1]==s2[1] && s[2]==s2[2]) {
+               used[t] = 1;
+               break;
+            }
+         }
+      }
+   }
+
+   /* greedy restripping */
+   n = 0;
+   for (t=0;t<ntris;t++) {
+      const int *p;
+      if (used[t]) {
+         continue;
+      }
+      used[t] = 1;
+      p = tris + 3*t;
+      /* start so that the strip can go on from the last edge */
+      for (k=0;k<3;k++) {
+         a = p[k];
+         b = p[(k+1)%3];
+         c = p[(k+2)%3];
+         if (next_triangle( b, c, tris, start, inc, used, &w )>=0) {
+            break;
+         }
+      }
+      if (n>0) {
+         strip[n++] = -1;
+      }
+      strip[n++] = a;
+      strip[n++] = b;
+      strip[n++] = c;
+      while ((k = next_triangle( strip[n-2], strip[n-1], tris, start, inc,
+                                 used, &w ))>=0) {
+         used[k] = 1;
+         strip[n++] = w;
+      }
+   }
+
+   /* chunks of the new strips, numbered by cluster */
+   if (!make_iso_chunks( ctx, nc, n, strip, &vorder, &nv, &out->index,
+                         &out->numindex, &out->chunks, &out->numchunks )) {
+      goto cleanup;
+   }
+   out->verts = (int_vert2 *) allocate_type( ctx, 3*nv*sizeof(int_vert2),
+                                             CVX_TYPE );
+   out->norms = (int_1 *) allocate_type( ctx, 3*nv*sizeof(int_1), CNX_TYPE );
+   out->vmap = (uint_index *) allocate_type( ctx, nv*sizeof(uint_index),
+                                             PTS_TYPE );
+   out->numverts = nv;
+   if (!out->verts || !out->norms || !out->vmap) {
+      free_lod( ctx, out );
+      goto cleanup;
+   }
+
+   for (i=0;i<nv;i++) {
+      float nlen;
+      c = vorder[i];
+      for (j=0;j<3;j++) {
+         out->verts[3*i+j] = (int_vert2) floor( sum[3*c+j] + 0.5 );
+      }
+      nlen = sqrt( (float) nsum[3*c]*nsum[3*c] + (float) nsum[3*c+1]*nsum[3*c+1]
+                   + (float) nsum[3*c+2]*nsum[3*c+2] );
+      for (j=0;j<3;j++) {
+         if (nlen>0.0) {
+            out->norms[3*i+j] = (int_1) (nsum[3*c+j] * NORMAL_SCALE / nlen);
+         }
+         else {
+            /* the normals cancelled out */
+            out->norms[3*i+j] = in->norms[3*rep[c]+j];
+         }
+      }
+      out->vmap[i] = in->vmap ? in->vmap[rep[c]] : rep[c];
+   }
+   ok = 1;
+
+cleanup:
+   free( keys );
+   free( ids );
+   free( map );
+   free( count );
+   free( rep );
+   free( sum );
+   free( nsum );
+   free( tris );
+   free( start );
+   free( inc );
+   free( used );
+   free( strip );
+   free( vorder );
+   return ok;
+}
+
+
+
+/*
+ * Make the simplified levels of detail of an isosurface.
+ * Input:  ctx - the context
+ *         surf - the full resolution surface
+ * Output:  lod - the levels of detail, finest first
+ * Return:  number of levels made, 0 if the surface is small or too
+ *          irregular to simplify
+ */
+int make_iso_lods( Context ctx, struct isosurface *surf, struct iso_lod lod[] )
+{
+   struct iso_lod full;
+   struct iso_lod *in;
+   int n;
+
+   if (surf->numindex < LOD_MIN_TRIS) {
+      return 0;
+   }
+   memset( &full, 0, sizeof(full) );
+   full.numverts = surf->numverts;
+   full.verts = surf->verts;
+   full.norms = surf->norms;
+   full.numindex = surf->numindex;
+   full.index = surf->index;
+   full.numchunks = surf->numchunks;
+   full.chunks = surf->chunks;
+
+   in = &full;
+   for (n=0;n<MAX_ISO_LODS && in->numindex >= LOD_MIN_TRIS/4;n++) {
+      if (!cluster_mesh( ctx, in, 2<<n, &lod[n] )) {
+         break;
+      }
+      in = &lod[n];
+   }
+   return n;
+}
+
+
+
+/*
+ * Deallocate the levels of detail of an isosurface.
+ * Input:  ctx - the context
+ *         numlods - number of levels
+ *         lod - the levels
+ * Return:  number of bytes freed
+ */
+int free_iso_lods( Context ctx, int numlods, struct iso_lod lod[] )
+{
+   int i, bytes = 0;
+
+   for (i=0;i<numlods;i++) {
+      bytes += free_lod( ctx, &lod[i] );
+   }
+   return bytes;
+}
+
+
+
+/*
+ * Update the color indexes of the levels of detail from the colors of
+ * the full resolution surface.  The caller holds the surface's write lock.
+ * Input:  ctx - the context
+ *         surf - the isosurface
+ */
+void color_iso_lods( Context ctx, struct isosurface *surf )
+{
+   int i, j;
+   struct iso_lod *lod;
+
+   for (i=0;i<surf->numlods;i++) {
+      lod = &surf->lod[i];
+      if (lod->colors) {
+         deallocate( ctx, lod->colors, lod->numverts*sizeof(uint_1) );
+         lod->colors = NULL;
+      }
+      if (surf->colors) {
+         lod->colors = (uint_1 *) allocate_type( ctx, lod->numverts*sizeof(uint_1),
+                                                 COLORINDEX_TYPE );
+         if (lod->colors) {
+            for (j=0;j<lod->numverts;j++) {
+               lod->colors[j] = surf->colors[lod->vmap[j]];
+            }
+         }
+      }
+   }
+}
+
+
+
+/*
+ * Choose which version of an isosurface to draw: the coarsest one whose
+ * vertices are moved by at most LOD_ERROR pixels, or LOD_FAST_ERROR pixels
+ * and no more than LOD_FAST_TRIS triangles while the view is changing.
+ * Input:  surf - the isosurface
+ *         pixels - size of one graphics unit on the screen in pixels
+ *         fast - 1 while rotating or animating
+ * Return:  index into surf->lod[], or -1 for the full resolution surface
+ */
+int choose_iso_lod( struct isosurface *surf, float pixels, int fast )
+{
+   float maxerr = fast ? LOD_FAST_ERROR : LOD_ERROR;
+   int k = -1;
+
+   while (k+1 < surf->numlods &&
+          0.5 * surf->lod[k+1].cellsize * pixels <= maxerr) {
+      k++;
+   }
+   if (fast) {
+      while (k+1 < surf->numlods &&
+             (k<0 ? surf->numindex : surf->lod[k].numindex) > LOD_FAST_TRIS) {
+         k++;
+      }
+   }
+   return k;
+}
@@ -0,0 +1,417 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+
+/*
+ * Chunked isosurface meshes.
+ *
+ * The marching cubes code makes one long triangle strip whose pieces are
+ * joined by degenerate triangles, with 4-byte indexes into one vertex
+ * array.  For storage and drawing this is cut into chunks of at most
+ * ISO_CHUNK_VERTS vertices.  Each chunk has its own vertices, stored in
+ * order of first use, and a list of 2-byte chunk relative indexes in
+ * which ISO_RESTART separates the triangle strips instead of degenerate
+ * triangles.  A strip which doesn't fit in a chunk is continued in the
+ * next chunk from its last two vertices, so the few vertices on chunk
+ * borders are stored twice.  Every non-degenerate triangle of the
+ * original strip is kept.
+ */
+
+
+#include "../config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "isomesh.h"
+#include "memory.h"
+
+
+/* state while cutting a strip into chunks */
+struct chunker {
+   int *local;          /* [numverts] index of each vertex in its chunk */
+   int *stamp;          /* [numverts] chunk which local[] refers to */
+   int *seen;           /* [numverts] last strip which counted the vertex */
+   int serial;
+
+   int *vorder;         /* original vertex of each chunk vertex */
+   int nv, maxnv;
+   int *index;          /* chunk relative indexes */
+   int ni, maxni;
+   struct iso_chunk *chunks;
+   int nc, maxnc;
+};
+
+
+
+static int grow( void **p, int *max, int need, int size )
+{
+   void *q;
+   int n;
+
+   if (need <= *max) {
+      return 1;
+   }
+   n = *max ? 2 * *max : 1024;
+   while (n < need) {
+      n *= 2;
+   }
+   q = realloc( *p, (size_t) n * size );
+   if (!q) {
+      return 0;
+   }
+   *p = q;
+   *max = n;
+   return 1;
+}
+
+
+static int new_chunk( struct chunker *k )
+{
+   if (!grow( (void **) &k->chunks, &k->maxnc, k->nc+1,
+              sizeof(struct iso_chunk) )) {
+      return 0;
+   }
+   k->chunks[k->nc].vbase = k->nv;
+   k->chunks[k->nc].numverts = 0;
+   k->chunks[k->nc].ibase = k->ni;
+   k->chunks[k->nc].numindex = 0;
+   k->nc++;
+   return 1;
+}
+
+
+/* append vertex v of the original strip to the current chunk */
+static int put_vertex( struct chunker *k, int v )
+{
+   struct iso_chunk *c = &k->chunks[k->nc-1];
+
+   if (k->stamp[v] != k->nc) {
+      if (!grow( (void **) &k->vorder, &k->maxnv, k->nv+1, sizeof(int) )) {
+         return 0;
+      }
+      k->stamp[v] = k->nc;
+      k->local[v] = c->numverts++;
+      k->vorder[k->nv++] = v;
+   }
+   if (!grow( (void **) &k->index, &k->maxni, k->ni+1, sizeof(int) )) {
+      return 0;
+   }
+   k->index[k->ni++] = k->local[v];
+   c->numindex++;
+   return 1;
+}
+
+
+static int put_restart( struct chunker *k )
+{
+   if (!grow( (void **) &k->index, &k->maxni, k->ni+1, sizeof(int) )) {
+      return 0;
+   }
+   k->index[k->ni++] = ISO_RESTART;
+   k->chunks[k->nc-1].numindex++;
+   return 1;
+}
+
+
+/*
+ * Add one triangle strip without degenerate triangles to the chunks.
+ * Input:  k - the chunker
+ *         s - array [len] of original vertex numbers
+ * Return:  1 = ok, 0 = out of memory
+ */
+static int put_strip( struct chunker *k, const int *s, int len )
+{
+   int i, fresh;
+
+   /* start a new chunk if the strip doesn't fit in the current one */
+   k->serial++;
+   fresh = 0;
+   for (i=0;i<len;i++) {
+      if (k->stamp[s[i]] != k->nc && k->seen[s[i]] != k->serial) {
+         k->seen[s[i]] = k->serial;
+         fresh++;
+      }
+   }
+   if (k->nc==0 || (k->chunks[k->nc-1].numverts > 0 &&
+                    k->chunks[k->nc-1].numverts + fresh > ISO_CHUNK_VERTS)) {
+      if (!new_chunk( k )) {
+         return 0;
+      }
+   }
+   else if (k->chunks[k->nc-1].numindex > 0) {
+      if (!put_restart( k )) {
+         return 0;
+      }
+   }
+
+   for (i=0;i<len;i++) {
+      if (k->stamp[s[i]] != k->nc &&
+          k->chunks[k->nc-1].numverts == ISO_CHUNK_VERTS && i>=2) {
+         /* chunk is full: go on in a new one from the last two vertices */
+         if (!new_chunk( k ) || !put_vertex( k, s[i-2] ) ||
+             !put_vertex( k, s[i-1] )) {
+            return 0;
+         }
+      }
+      if (!put_vertex( k, s[i] )) {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+
+/* is triangle i of the strip drawn? */
+static int good_triangle( const int *strip, int i )
+{
+   return strip[i]>=0 && strip[i+1]>=0 && strip[i+2]>=0 &&
+          strip[i]!=strip[i+1] && strip[i+1]!=strip[i+2] &&
+          strip[i]!=strip[i+2];
+}
+
+
+
+/*
+ * Cut a triangle strip into chunks with 2-byte indexes.
+ * Input:  ctx - the context
+ *         numverts - number of vertices the strip refers to
+ *         numindex, strip - the strip; pieces may be joined by degenerate
+ *                           triangles or separated by -1
+ * Output:  vorder - array [newnumverts] giving the original vertex of
+ *                   each chunk vertex, to be free()'d by the caller
+ *          newnumverts - number of chunk vertices
+ *          index, newnumindex - chunk relative indexes
+ *          chunks, numchunks - the chunks
+ * Return:  1 = ok, 0 = out of memory
+ */
+int make_iso_chunks( Context ctx, int numverts,
+                     int numindex, const int *strip,
+                     int **vorder, int *newnumverts,
+                     uint_2 **index, int *newnumindex,
+                     struct iso_chunk **chunks, int *numchunks )
+{
+   struct chunker k;
+   int i, j, ok = 0;
+
+   *vorder = NULL;
+   *newnumverts = *newnumindex = *numchunks = 0;
+   *index = NULL;
+   *chunks = NULL;
+
+   memset( &k, 0, sizeof(k) );
+   k.local = (int *) malloc( numverts * sizeof(int) );
+   k.stamp = (int *) calloc( numverts, sizeof(int) );
+   k.seen = (int *) calloc( numverts, sizeof(int) );
+   if (!k.local || !k.stamp || !k.seen) {
+      goto cleanup;
+   }
+
+   /* each run of drawn triangles becomes a strip */
+   i = 0;
+   while (i+2 < numindex) {
+      if (!good_triangle( strip, i )) {
+         i++;
+         continue;
+      }
+      for (j=i+1; j+2 < numindex && good_triangle( strip, j ); j++);
+      if (!put_strip( &k, strip+i, j+2-i )) {
+         goto cleanup;
+      }
+      i = j;
+   }
+
+   if (k.nc > 0) {
+      *index = (uint_2 *) allocate_type( ctx, k.ni * sizeof(uint_2), PTS_TYPE );
+      *chunks = (struct iso_chunk *) allocate_type( ctx,
+                                  k.nc * sizeof(struct iso_chunk), PTS_TYPE );
+      if (!*index || !*chunks) {
+         free_iso_chunks( ctx, k.ni, *index, k.nc, *chunks );
+         *index = NULL;
+         *chunks = NULL;
+         goto cleanup;
+      }
+      for (i=0;i<k.ni;i++) {
+         (*index)[i] = (uint_2) k.index[i];
+      }
+      memcpy( *chunks, k.chunks, k.nc * sizeof(struct iso_chunk) );
+      *vorder = k.vorder;
+      k.vorder = NULL;
+      *newnumverts = k.nv;
+      *newnumindex = k.ni;
+      *numchunks = k.nc;
+   }
+   ok = 1;
+
+cleanup:
+   free( k.local );
+   free( k.stamp );
+   free( k.seen );
+   free( k.vorder );
+   free( k.index );
+   free( k.chunks );
+   return ok;
+}
+
+
+
+/*
+ * Put the vertex arrays of a surface into chunk order.
+ * Input:  ctx - the context
+ *         numverts - current number of vertices
+ *         newnumverts, vorder - from make_iso_chunks()
+ *         verts, norms, colors - the arrays to reorder, any may be NULL
+ *                                or point to NULL
+ * Output:  verts, norms, colors - replaced by the new arrays
+ * Return:  1 = ok, 0 = out of memory, the arrays are unchanged
+ */
+int reorder_iso_verts( Context ctx, int numverts, int newnumverts,
+                       const int *vorder, int_vert2 **verts,
+                       int_1 **norms, uint_1 **colors )
+{
+   int_vert2 *v = NULL;
+   int_1 *n = NULL;
+   uint_1 *c = NULL;
+   int i;
+
+   if (verts && *verts) {
+      v = (int_vert2 *) allocate_type( ctx, 3*newnumverts*sizeof(int_vert2),
+                                       CVX_TYPE );
+   }
+   if (norms && *norms) {
+      n = (int_1 *) allocate_type( ctx, 3*newnumverts*sizeof(int_1),
+                                   CNX_TYPE );
+   }
+   if (colors && *colors) {
+      c = (uint_1 *) allocate_type( ctx, newnumverts*sizeof(uint_1),
+                                    COLORINDEX_TYPE );
+   }
+   if ((verts && *verts && !v) || (norms && *norms && !n) ||
+       (colors && *colors && !c)) {
+      if (v) deallocate( ctx, v, 3*newnumverts*sizeof(int_vert2) );
+      if (n) deallocate( ctx, n, 3*newnumverts*sizeof(int_1) );
+      if (c) deallocate( ctx, c, newnumverts*sizeof(uint_1) );
+      return 0;
+   }
+
+   if (v) {
+      for (i=0;i<newnumverts;i++) {
+         v[3*i] = (*verts)[3*vorder[i]];
+         v[3*i+1] = (*verts)[3*vorder[i]+1];
+         v[3*i+2] = (*verts)[3*vorder[i]+2];
+      }
+      deallocate( ctx, *verts, 3*numverts*sizeof(int_vert2) );
+      *verts = v;
+   }
+   if (n) {
+      for (i=0;i<newnumverts;i++) {
+         n[3*i] = (*norms)[3*vorder[i]];
+         n[3*i+1] = (*norms)[3*vorder[i]+1];
+         n[3*i+2] = (*norms)[3*vorder[i]+2];
+      }
+      deallocate( ctx, *norms, 3*numverts*sizeof(int_1) );
+      *norms = n;
+   }
+   if (c) {
+      for (i=0;i<newnumverts;i++) {
+         c[i] = (*colors)[vorder[i]];
+      }
+      deallocate( ctx, *colors, numverts*sizeof(uint_1) );
+      *colors = c;
+   }
+   return 1;
+}
+
+
+
+/*
+ * Deallocate the indexes and chunks of a surface.
+ * Return:  number of bytes freed
+ */
+int free_iso_chunks( Context ctx, int numindex, uint_2 *index,
+                     int numchunks, struct iso_chunk *chunks )
+{
+   int bytes = 0;
+
+   if (index) {
+      deallocate( ctx, index, numindex*sizeof(uint_2) );
+      bytes += numindex*sizeof(uint_2);
+   }
+   if (chunks) {
+      deallocate( ctx, chunks, numchunks*sizeof(struct iso_chunk) );
+      bytes += numchunks*sizeof(struct iso_chunk);
+   }
+   return bytes;
+}
+
+
+
+/*
+ * Join the strips of all chunks into one strip of vertex numbers, with
+ * degenerate triangles between the pieces, for code which wants the
+ * surface in the marching cubes form.
+ * Input:  numchunks, chunks, index - the chunked surface
+ * Output:  n - number of indexes returned
+ * Return:  array [n] of indexes to be free()'d by the caller, or NULL
+ */
+int *iso_strip_indexes( int numchunks, const struct iso_chunk *chunks,
+                        const uint_2 *index, int *n )
+{
+   int c, i, total, join, *strip;
+
+   total = 0;
+   for (c=0;c<numchunks;c++) {
+      total += chunks[c].numindex;
+   }
+   /* a join adds two indexes and replaces a restart or a chunk border */
+   strip = (int *) malloc( (3*total + 1) * sizeof(int) );
+   *n = 0;
+   if (!strip) {
+      return NULL;
+   }
+   join = 0;
+   for (c=0;c<numchunks;c++) {
+      const uint_2 *ci = index + chunks[c].ibase;
+      for (i=0;i<chunks[c].numindex;i++) {
+         if (ci[i]==ISO_RESTART) {
+            join = 1;
+            continue;
+         }
+         if (join && *n>0) {
+            strip[*n] = strip[*n-1];
+            strip[*n+1] = chunks[c].vbase + ci[i];
+            *n += 2;
+         }
+         join = 0;
+         strip[(*n)++] = chunks[c].vbase + ci[i];
+      }
+      join = 1;
+   }
+   return strip;
+}
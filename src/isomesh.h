@@ -0,0 +1,60 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+
+/*
+ * Chunked isosurface meshes with 2-byte indexes.
+ */
+
+
+#ifndef ISOMESH_H
+#define ISOMESH_H
+
+
+#include "globals.h"
+
+
+extern int make_iso_chunks( Context ctx, int numverts,
+                            int numindex, const int *strip,
+                            int **vorder, int *newnumverts,
+                            uint_2 **index, int *newnumindex,
+                            struct iso_chunk **chunks, int *numchunks );
+
+extern int reorder_iso_verts( Context ctx, int numverts, int newnumverts,
+                              const int *vorder, int_vert2 **verts,
+                              int_1 **norms, uint_1 **colors );
+
+extern int free_iso_chunks( Context ctx, int numindex, uint_2 *index,
+                            int numchunks, struct iso_chunk *chunks );
+
+extern int *iso_strip_indexes( int numchunks, const struct iso_chunk *chunks,
+                               const uint_2 *index, int *n );
+
+
+#endif
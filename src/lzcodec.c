@@ -0,0 +1,197 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * A small LZ77 block codec used for the lossless and error-bounded v5d
+ * compress modes.  The encoded block is a sequence of
+ *    token         high 4 bits = literal count, low 4 bits = match len-4
+ *    [count]       if the literal count is 15, more count bytes (255 = more)
+ *    literals
+ *    offset        2 bytes, little endian, back from the current position
+ *    [length]      if the match length is 15, more length bytes
+ * The last sequence has only literals.  Matches are found with a single
+ * hash table probe, so encoding is fast rather than maximally tight.
+ */
+
+
+#include <string.h>
+#include "lzcodec.h"
+
+
+#define HASH_BITS 13
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+
+
+static unsigned int hash4( const unsigned char *p )
+{
+   unsigned int x;
+   memcpy( &x, p, 4 );
+   return (x * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+static unsigned char *put_length( unsigned char *op, int len )
+{
+   while (len>=255) {
+      *op++ = 255;
+      len -= 255;
+   }
+   *op++ = (unsigned char) len;
+   return op;
+}
+
+
+static unsigned char *put_sequence( unsigned char *op,
+                                    const unsigned char *lit, int nlit,
+                                    int offset, int mlen )
+{
+   unsigned char *token = op++;
+
+   *token = (unsigned char) ((nlit<15 ? nlit : 15) << 4);
+   if (nlit>=15) {
+      op = put_length( op, nlit-15 );
+   }
+   memcpy( op, lit, nlit );
+   op += nlit;
+
+   if (mlen>0) {
+      mlen -= MIN_MATCH;
+      *token |= (unsigned char) (mlen<15 ? mlen : 15);
+      *op++ = (unsigned char) (offset & 0xff);
+      *op++ = (unsigned char) (offset >> 8);
+      if (mlen>=15) {
+         op = put_length( op, mlen-15 );
+      }
+   }
+   return op;
+}
+
+
+
+/*
+ * Compress a block of bytes.
+ * Input:  src - the bytes to compress
+ *         n - number of bytes
+ *         dst - where to put the result, at least LZ_BOUND(n) bytes
+ * Return:  number of bytes put in dst
+ */
+int lz_compress( const unsigned char *src, int n, unsigned char *dst )
+{
+   int table[1<<HASH_BITS];
+   unsigned char *op = dst;
+   int ip, anchor, ref, len;
+   unsigned int h;
+
+   memset( table, 0xff, sizeof(table) );   /* all -1 */
+   ip = anchor = 0;
+   while (ip+MIN_MATCH<=n) {
+      h = hash4( src+ip );
+      ref = table[h];
+      table[h] = ip;
+      if (ref>=0 && ip-ref<=MAX_OFFSET
+          && memcmp( src+ref, src+ip, MIN_MATCH )==0) {
+         len = MIN_MATCH;
+         while (ip+len<n && src[ref+len]==src[ip+len]) {
+            len++;
+         }
+         op = put_sequence( op, src+anchor, ip-anchor, ip-ref, len );
+         ip += len;
+         anchor = ip;
+      }
+      else {
+         ip++;
+      }
+   }
+   op = put_sequence( op, src+anchor, n-anchor, 0, 0 );
+   return (int) (op - dst);
+}
+
+
+
+/*
+ * Decompress a block made by lz_compress().
+ * Input:  src, srclen - the compressed block
+ *         dst - where to put the result
+ *         n - expected number of bytes
+ * Return:  n = ok, -1 = corrupt block
+ */
+int lz_decompress( const unsigned char *src, int srclen,
+                   unsigned char *dst, int n )
+{
+   const unsigned char *ip = src, *end = src + srclen;
+   int op = 0;
+   int token, nlit, mlen, offset, c;
+
+   while (ip<end) {
+      token = *ip++;
+
+      nlit = token >> 4;
+      if (nlit==15) {
+         do {
+            if (ip>=end) return -1;
+            c = *ip++;
+            nlit += c;
+         } while (c==255);
+      }
+      if (nlit > end-ip || nlit > n-op) return -1;
+      memcpy( dst+op, ip, nlit );
+      ip += nlit;
+      op += nlit;
+      if (ip>=end) {
+         break;   /* last sequence */
+      }
+
+      if (end-ip<2) return -1;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      mlen = token & 15;
+      if (mlen==15) {
+         do {
+            if (ip>=end) return -1;
+            c = *ip++;
+            mlen += c;
+         } while (c==255);
+      }
+      mlen += MIN_MATCH;
+      if (offset==0 || offset>op || mlen > n-op) return -1;
+
+      if (offset>=mlen) {
+         memcpy( dst+op, dst+op-offset, mlen );
+         op += mlen;
+      }
+      else {
+         /* overlapping copy, a run */
+         for (c=0;c<mlen;c++,op++) {
+            dst[op] = dst[op-offset];
+         }
+      }
+   }
+   return op==n ? n : -1;
+}
@@ -53,6 +53,7 @@
 #include "vis5d.h"
 #include "script.h"
 #include "pipe.h"
+#include "server.h"
 #include "queue.h"
 
 #ifndef MBS
@@ -83,6 +84,9 @@ static void usage( void )
    P("Vis5D version " VERSION "  (MBS=%d)\n", MBS);
    P("Usage:\n");
    P("   vis5d file.v5d [options]\n");
+   P("   vis5d directory [options]\n");
+   P("      Read all the .v5d files in the directory, or all the files\n");
+   P("      matching a quoted wildcard pattern, as one data set.\n");
    P("Options:\n");
 #if defined(HAVE_SGI_GL) || defined(DENALI) || defined(HAVE_OPENGL)
    P("   -alpha\n");
@@ -149,10 +153,15 @@ static void usage( void )
    P("      Example:  vis5d LAMPS.v5d -font helvb24 20\n");
 #endif
 
+   P("   -framecache MB [compress]\n");
+   P("      Limit the memory used for frames stored while animation\n");
+   P("      recording is on to MB megabytes (default %d, 0 disables).\n", DEFAULT_FRAMECACHE);
+   P("      compress=0 stores frames without run-length encoding.\n");
    P("   -full\n");
    P("      Full-screen window; make the 3-D window as large as possible.\n");
    P("   -funcpath pathname\n");
-   P("      Specify directory to search for user Fortran functions.\n");
+   P("      Specify directory to search for user Fortran functions\n");
+   P("      and function plugins (foo.so, see userfunc.h).\n");
    P("      Example:  vis5d LAMPS.v5d -funcpath /usr/local/vis5d/userfuncs\n");
    P("   -geometry WIDTHxHEIGHT+X+Y  (or WIDTHxHEIGHT or +X+Y)\n");
    P("      Specify the geometry of the 3-D window\n");
@@ -183,9 +192,14 @@ static void usage( void )
    P("      Limit the memory used by vis5d to 'n' megabytes.  When\n");
    P("      the limit is exceeded, the least-recently-viewed graphics\n");
    P("      are deallocated.\n");
+   P("   -memlog file [seconds]\n");
+   P("      Append a report of the memory pool usage by block type to\n");
+   P("      'file' (\"-\" for stdout) every 'seconds' (default 60).\n");
+   P("      Only contexts with a memory pool (-mbs) are itemized.\n");
 #ifdef HAVE_OPENGL
    P("   -offscreen\n");
-   P("       Do off screen rendering, used in conjunction with -script command\n");
+   P("       Do off screen rendering, used in conjunction with -script or\n");
+   P("       -server\n");
 #endif
    // JCM
    P("   -framebuffer name\n");
@@ -223,6 +237,9 @@ static void usage( void )
    P("      for all three variables\n");
    P("   -script filename\n");
    P("      Execute a Tcl script for controlling Vis5D.\n");
+   P("   -server name\n");
+   P("      Accept requests from other programs on the UNIX socket named\n");
+   P("      name.  See server.h.\n");
 #if defined(HAVE_SGI_GL) || defined(DENALI) || defined(HAVE_OPENGL)
    P("   -sequence filename\n");
    P("      Specify a sequence of images to texture map over the topography.\n");
@@ -343,6 +360,27 @@ static int timer( int index, int flag )
 
 
 
+/*
+ * Answer request server clients until the program is killed.  Used
+ * instead of main_loop() when rendering off screen without a GUI.
+ */
+static void server_loop( char *server_name )
+{
+   int work;
+
+   if (!init_server( server_name )) {
+      return;
+   }
+   while (1) {
+      check_server();
+      vis5d_do_work();
+      vis5d_check_work( &work );
+      wait_server( NULL, NULL, work ? 10 : -1 );
+   }
+}
+
+
+
 /*
  * This is called by main.  It reads user input and updates the 3-D
  * display until the program terminates.
@@ -351,7 +389,7 @@ static int timer( int index, int flag )
 /* WLH 29 Sept 98
 static int main_loop( void )
 */
-static int main_loop(char *pipe_name)
+static int main_loop(char *pipe_name, char *server_name)
 {
    int block;
    int numtimes, verylarge;
@@ -373,6 +411,10 @@ static int main_loop(char *pipe_name)
       if (pipe_name != NULL) {
         check_pipe(pipe_name);
       }
+      if (server_name != NULL) {
+         check_server();
+      }
+      vis5d_check_memory_log();
       get_display_matrix( &DR, &DC);
       /* once around this while loop for each animation step or redraw */
       /* MJK 11.17.98 */
@@ -405,6 +447,14 @@ static int main_loop(char *pipe_name)
          }
       } 
 
+      if (server_name != NULL) {
+         /* wait for X input or server clients, then just poll for input */
+         if (block) {
+            wait_server( GuiDpy, GfxDpy, -1 );
+         }
+         block = 0;
+      }
+
       main_redraw = 0;
       while (1) {
          int input_status;
@@ -943,6 +993,8 @@ main( int argc, char *argv[] )
 #ifdef	HAVE_MIXKIT
 	int vstride[VIS5D_MAX_DPY_CONTEXTS];         /* -vstride */
 #endif
+   int framecache[VIS5D_MAX_DPY_CONTEXTS];      /* -framecache */
+   int framecompress[VIS5D_MAX_DPY_CONTEXTS];
    char *wdpy_name = NULL;                      /* -wdpy */
    float linewidth[VIS5D_MAX_DPY_CONTEXTS];     /* -wide */
    char u2[VIS5D_MAX_DPY_CONTEXTS][20],
@@ -968,6 +1020,9 @@ main( int argc, char *argv[] )
    int legendy[VIS5D_MAX_DPY_CONTEXTS];
 /* WLH 29 Sept 98 */
    char *pipe_name;
+   char *server_name = NULL;                    /* -server */
+   char *memlog_name = NULL;                    /* -memlog */
+   int memlog_secs = 60;
 
    int dindex = 0;
 
@@ -1074,6 +1129,8 @@ main( int argc, char *argv[] )
 #ifdef	HAVE_MIXKIT
       vstride[yo] = DEFAULT_VSTRIDE;
 #endif
+      framecache[yo] = DEFAULT_FRAMECACHE;
+      framecompress[yo] = 1;
       linewidth[yo] = 1.0;
       samescale[yo] = 0;
       legend_position[yo] = VIS5D_BOTTOM;
@@ -1158,6 +1215,14 @@ main( int argc, char *argv[] )
          */
          StaticWin = 1;
       }
+      else if (strcmp(argv[i],"-framecache")==0 && i+1<argc) {
+         framecache[filepointer] = atoi( argv[i+1] );
+         i++;
+         if (i+1<argc && (strcmp(argv[i+1],"0")==0 || strcmp(argv[i+1],"1")==0)) {
+            framecompress[filepointer] = atoi( argv[i+1] );
+            i++;
+         }
+      }
       else if (strcmp(argv[i],"-funcpath")==0 && i+1<argc) {
          /* MJK 4.27.99
          funcpath[filepointer] = argv[i+1];
@@ -1232,6 +1297,14 @@ main( int argc, char *argv[] )
          mbs[filepointer] = atoi( argv[i+1] );
          i++;
       }
+      else if (strcmp(argv[i],"-memlog")==0 && i+1<argc) {
+         memlog_name = argv[i+1];
+         i++;
+         if (i+1<argc && atoi(argv[i+1])>0) {
+            memlog_secs = atoi( argv[i+1] );
+            i++;
+         }
+      }
       else if (strcmp(argv[i],"-reverse_poles")==0){
          REVERSE_POLES = -1.0;
       }
@@ -1266,6 +1339,10 @@ main( int argc, char *argv[] )
          pipe_name = argv[i+1];
          i++;
       }
+      else if (strcmp(argv[i],"-server")==0 && i+1<argc) {
+         server_name = argv[i+1];
+         i++;
+      }
       else if (strcmp(argv[i],"-projection")==0 && i+1<argc) {
          /* User-specified map projection */
          if (strncmp(argv[i+1],"gen",3)==0) {
@@ -1468,7 +1545,7 @@ main( int argc, char *argv[] )
 
    /* MJK 11.19.98 */         
 #ifdef HAVE_OPENGL
-   if (off_screen_rendering && script == NULL){
+   if (off_screen_rendering && script == NULL && server_name == NULL){
       off_screen_rendering = 0;
       printf(" can not do offscreen rendering with out a script to run\n");
    }
@@ -1691,6 +1768,7 @@ main( int argc, char *argv[] )
 			vis5d_set_maxtmesh(dindex,  maxtmesh[dindex]);
 			vis5d_set_vstride(dindex, vstride[dindex]);
 #endif
+         vis5d_set_frame_cache(dindex, framecache[dindex], framecompress[dindex]);
          in_the_init_stage = 0;
 
       }
@@ -1760,7 +1838,12 @@ main( int argc, char *argv[] )
    gtx = create_gui_context(0);
    /* MJK 11.19.98 */      
    if (off_screen_rendering){
-      run_script( 0, script );
+      if (script) {
+         run_script( 0, script );
+      }
+      if (server_name) {
+         server_loop( server_name );
+      }
       exit(0);
    }
 
@@ -1842,7 +1925,13 @@ main( int argc, char *argv[] )
       run_script( 0, script );
    }
 
-   main_loop(pipe_name);
+   if (memlog_name) {
+      vis5d_set_memory_log( memlog_name, memlog_secs );
+   }
+   if (server_name != NULL && !init_server( server_name )) {
+      server_name = NULL;
+   }
+   main_loop(pipe_name, server_name);
 
    vis5d_terminate(1);
    return 0;
@@ -0,0 +1,225 @@
+
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "../config.h"
+
+
+/*
+ * Stress test and benchmark for the memory pool allocator in memory.c.
+ *
+ * A random mix of small (contour and slice temporaries), medium and
+ * large (grid sized) blocks is allocated and freed in the pool of a
+ * dummy context, then the same sequence is run through malloc/free.
+ * Every block is filled with a pattern which is checked when it is
+ * freed, and the pool accounting must return to empty at the end.
+ *
+ * Build with "make membench" in the src directory.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "globals.h"
+#include "memory.h"
+
+
+#define SLOTS 4096
+
+
+struct op {
+   int slot;           /* which live block to replace */
+   PTRINT bytes;       /* size of the new block, 0 = just free */
+};
+
+
+static double now( void )
+{
+   struct timeval tv;
+
+   gettimeofday( &tv, NULL );
+   return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+
+/* Choose a block size like those vis5d asks for. */
+static PTRINT random_size( PTRINT largest )
+{
+   int r = rand() % 1000;
+
+   if (r < 700) {
+      return 16 + rand() % 4096;                  /* small temporaries */
+   }
+   else if (r < 995) {
+      return 4096 + rand() % (1024*1024);         /* slices, contours */
+   }
+   else {
+      return 1024*1024 + rand() % largest;        /* grids */
+   }
+}
+
+
+static void fill( void *p, PTRINT bytes, int slot )
+{
+   unsigned char *b = (unsigned char *) p;
+
+   b[0] = b[bytes-1] = (unsigned char) slot;
+   if (bytes > 2) {
+      b[bytes/2] = (unsigned char) ~slot;
+   }
+}
+
+
+static int check( void *p, PTRINT bytes, int slot )
+{
+   unsigned char *b = (unsigned char *) p;
+
+   if (b[0] != (unsigned char) slot || b[bytes-1] != (unsigned char) slot) {
+      return 0;
+   }
+   if (bytes > 2 && b[bytes/2] != (unsigned char) ~slot) {
+      return 0;
+   }
+   return 1;
+}
+
+
+int main( int argc, char *argv[] )
+{
+   struct vis5d_context *ctx;
+   struct display_context *dtx;
+   struct op *ops;
+   void *block[SLOTS];
+   PTRINT size[SLOTS];
+   PTRINT live, largest, empty;
+   int mbs, nops, i, failed, errors;
+   double t0, tpool, tmalloc;
+
+   mbs = (argc > 1) ? atoi( argv[1] ) : 512;
+   nops = (argc > 2) ? atoi( argv[2] ) : 2000000;
+   if (mbs < 64) {
+      printf("Usage:\n");
+      printf("   membench [mbs [operations]]   (mbs >= 64)\n");
+      exit(0);
+   }
+   largest = (PTRINT) mbs * 1024 * 1024 / 32;
+
+   ctx = (struct vis5d_context *) calloc( 1, sizeof(struct vis5d_context) );
+   dtx = (struct display_context *) calloc( 1, sizeof(struct display_context) );
+   ctx->dpy_ctx = dtx;
+   if (!init_memory( ctx, (PTRINT) mbs * 1024 * 1024 )) {
+      exit(1);
+   }
+   empty = ctx->memory_used;
+
+   /* make the operation sequence, keeping the live set under 3/4 of mbs */
+   srand( 1 );
+   ops = (struct op *) malloc( nops * sizeof(struct op) );
+   memset( size, 0, sizeof(size) );
+   live = 0;
+   for (i=0;i<nops;i++) {
+      int s = rand() % SLOTS;
+      PTRINT b = random_size( largest );
+      live -= size[s];
+      if (live + b > (PTRINT) mbs * 1024 * 1024 / 4 * 3) {
+         b = 0;
+      }
+      size[s] = b;
+      live += b;
+      ops[i].slot = s;
+      ops[i].bytes = b;
+   }
+
+   /* vis5d pool */
+   memset( block, 0, sizeof(block) );
+   memset( size, 0, sizeof(size) );
+   failed = errors = 0;
+   t0 = now();
+   for (i=0;i<nops;i++) {
+      int s = ops[i].slot;
+      if (block[s]) {
+         if (!check( block[s], size[s], s )) {
+            errors++;
+         }
+         deallocate( ctx, block[s], size[s] );
+         block[s] = NULL;
+      }
+      if (ops[i].bytes) {
+         block[s] = allocate_type( ctx, ops[i].bytes, NULL_TYPE );
+         if (block[s]) {
+            size[s] = ops[i].bytes;
+            fill( block[s], size[s], s );
+         }
+         else {
+            failed++;
+         }
+      }
+   }
+   for (i=0;i<SLOTS;i++) {
+      if (block[i]) {
+         deallocate( ctx, block[i], size[i] );
+      }
+   }
+   tpool = now() - t0;
+
+   printf("pool:   %8.0f ops/sec  (%d failed allocations, %d corrupted)\n",
+          nops / tpool, failed, errors );
+   if (ctx->memory_used != empty) {
+      printf("        %ld bytes accounted as used after freeing all (expected %ld)\n",
+             (long) ctx->memory_used, (long) empty );
+      errors++;
+   }
+
+   /* C library */
+   memset( block, 0, sizeof(block) );
+   t0 = now();
+   for (i=0;i<nops;i++) {
+      int s = ops[i].slot;
+      if (block[s]) {
+         free( block[s] );
+         block[s] = NULL;
+      }
+      if (ops[i].bytes) {
+         block[s] = malloc( ops[i].bytes );
+         if (block[s]) {
+            size[s] = ops[i].bytes;
+            fill( block[s], size[s], s );
+         }
+      }
+   }
+   for (i=0;i<SLOTS;i++) {
+      free( block[i] );
+   }
+   tmalloc = now() - t0;
+
+   printf("malloc: %8.0f ops/sec\n", nops / tmalloc );
+
+   return (errors || failed) ? 1 : 0;
+}
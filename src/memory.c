@@ -46,20 +46,57 @@
 #include "misc.h"
 #include "sync.h"
 
+/*
+ * Every block in the pool starts with this header.  prev/next link the
+ * blocks in address order so neighbours can be merged; free blocks are
+ * also kept on the free list of their size class (fprev/fnext) so that
+ * an allocation never has to walk the whole pool.
+ */
 struct mem {
    PTRINT        size;
    struct mem *prev;
    struct mem *next;
+   struct mem *fprev;
+   struct mem *fnext;
    short int  free, magic;
-#ifdef DEBUG_MEM
-   PTRINT type;
-#endif
+   short int  type;
 };
 
 
 #define MEMSIZ sizeof(struct mem)
 #define MAGIC 0x1234
 
+/* value of mem.free for a block allocated outside of the pool */
+#define HUGE_BLOCK 2
+
+/*
+ * Allocations of at least this many bytes are malloc'd directly (the C
+ * library maps them from the system) instead of being carved out of the
+ * pool, so big grids never fragment it.  They still count against the
+ * -mbs limit.
+ */
+#define HUGE_BYTES (32*1024*1024)
+
+/*
+ * Size classes:  blocks of less than MEM_EXACT_BINS*MEMSIZ bytes get one
+ * class per size, larger blocks four classes per power of two.
+ */
+#define MEM_EXACT_BINS 32
+
+/* names of the block types in memory.h, for reports */
+static const char *type_names[MEM_TYPES] = {
+   "null", "grid", "ixplane", "ptflag", "ptaux", "pcube", "polfvert", "nxa",
+   "pnx", "tristripe", "vetpol", "cvx", "cvy", "cvz", "cnx", "cny", "cnz",
+   "pts", "hslice", "vslice", "mhrect", "mvrect", "cvx1h", "cvy1h", "cvz1h",
+   "cvx2h", "cvy2h", "cvz2h", "cvx3h", "cvy3h", "cvz3h", "cvx1v", "cvy1v",
+   "cvz1v", "cvx2v", "cvy2v", "cvz2v", "cvx3v", "cvy3v", "cvz3v", "vxh",
+   "vyh", "vzh", "indexesh", "vxv", "vyv", "vzv", "indexesv", "windxh",
+   "windyh", "windzh", "windxv", "windyv", "windzv", "trajx", "trajy",
+   "trajz", "trajxr", "trajyr", "trajzr", "start", "len", "stream1",
+   "stream2", "stream3", "sound", "uwind", "vwind", "vertdata", "gridcache",
+   "gridscale", "colorindex", "traj"
+};
+
 static void check_memory( Context ctx );
 
 
@@ -71,6 +108,164 @@ static void check_memory( Context ctx );
 /********************************************/
 
 
+/*
+ * Return the size class of a block of the given size.
+ */
+static int size_bin( PTRINT bytes )
+{
+   PTRINT units = bytes / MEMSIZ;
+   int log2, bin;
+
+   if (units < MEM_EXACT_BINS) {
+      return (int) units;
+   }
+   for (log2=5; (units >> (log2+1)) != 0; log2++)
+     ;
+   bin = MEM_EXACT_BINS + (log2-5)*4 + (int) ((units >> (log2-2)) & 3);
+   return bin < MEM_BINS ? bin : MEM_BINS-1;
+}
+
+
+
+/*
+ * Put a block on the free list of its size class.
+ */
+static void link_free( Context ctx, struct mem *m )
+{
+   int b = size_bin( m->size );
+
+   m->free = 1;
+   m->fprev = NULL;
+   m->fnext = ctx->freebin[b];
+   if (m->fnext) {
+      m->fnext->fprev = m;
+   }
+   ctx->freebin[b] = m;
+   ctx->freebinmap[b>>5] |= 1U << (b&31);
+}
+
+
+
+/*
+ * Take a block off its free list.  Must be called before m->size changes.
+ */
+static void unlink_free( Context ctx, struct mem *m )
+{
+   int b = size_bin( m->size );
+
+   if (m->fprev) {
+      m->fprev->fnext = m->fnext;
+   }
+   else {
+      ctx->freebin[b] = m->fnext;
+      if (!m->fnext) {
+         ctx->freebinmap[b>>5] &= ~(1U << (b&31));
+      }
+   }
+   if (m->fnext) {
+      m->fnext->fprev = m->fprev;
+   }
+}
+
+
+
+/*
+ * Find a free block which can hold 'bytes' bytes, either exactly or with
+ * room to split off a new block.
+ * Return:  the block or NULL if there's none.
+ */
+static struct mem *find_free( Context ctx, PTRINT bytes )
+{
+   struct mem *pos;
+   int b = size_bin( bytes );
+
+   /* blocks in the request's own class may be too small */
+   for (pos=ctx->freebin[b]; pos; pos=pos->fnext) {
+      if (pos->size == bytes || pos->size >= bytes + MEMSIZ) {
+         return pos;
+      }
+   }
+
+   /* any block in a larger class fits, take the smallest class */
+   b++;
+   while (b < MEM_BINS) {
+      unsigned int word = ctx->freebinmap[b>>5] >> (b&31);
+      if (word) {
+         while (!(word & 1)) {
+            word >>= 1;
+            b++;
+         }
+         return ctx->freebin[b];
+      }
+      b = (b|31) + 1;
+   }
+   return NULL;
+}
+
+
+
+/*
+ * Update the per-type statistics for an allocation or deallocation.
+ * Called with the memory lock held, after memory_used has been updated.
+ */
+static void account( Context ctx, int type, PTRINT bytes )
+{
+   struct mem_type_stats *st = &ctx->memstats[type];
+
+   st->bytes += bytes;
+   st->blocks++;
+   st->allocs++;
+   if (st->bytes > st->peak) {
+      st->peak = st->bytes;
+   }
+   if (ctx->memory_used > ctx->memory_peak) {
+      ctx->memory_peak = ctx->memory_used;
+   }
+}
+
+
+static void unaccount( Context ctx, int type, PTRINT bytes )
+{
+   struct mem_type_stats *st = &ctx->memstats[type];
+
+   st->bytes -= bytes;
+   st->blocks--;
+}
+
+
+
+/*
+ * Allocate a block outside of the pool.
+ */
+static void *alloc_huge( Context ctx, PTRINT bytes, int type )
+{
+   struct mem *pos;
+
+   if (ctx->memory_used + bytes + MEMSIZ > ctx->memory_limit) {
+      return NULL;
+   }
+   pos = (struct mem *) malloc( bytes + MEMSIZ );
+   if (!pos) {
+      return NULL;
+   }
+   pos->size = bytes;
+   pos->free = HUGE_BLOCK;
+   pos->magic = MAGIC;
+   pos->fprev = pos->fnext = NULL;
+   pos->prev = NULL;
+   pos->next = ctx->huge;
+   if (ctx->huge) {
+      ctx->huge->prev = pos;
+   }
+   ctx->huge = pos;
+   ctx->memory_used += bytes + MEMSIZ;
+   pos->type = type;
+   account( ctx, type, bytes );
+   return (void *) (pos+1);
+}
+
+
+
 /*
  * Allocate a block of memory.
  * Input:  b - number of bytes to allocate
@@ -98,18 +293,35 @@ static void *alloc( Context ctx, PTRINT b, int permanent, int type )
    else {
       bytes = ( (b+MEMSIZ-1) / MEMSIZ ) * MEMSIZ;
    }
+
+   if (type<0 || type>=MEM_TYPES) {
+      type = NULL_TYPE;
+   }
+
+   if (!permanent && ctx->huge_threshold && bytes >= ctx->huge_threshold) {
+      return alloc_huge( ctx, bytes, type );
+   }
+
+   /* huge blocks share the -mbs limit with the pool */
+   if (ctx->memory_used + bytes > ctx->memory_limit) {
+      return NULL;
+   }
+
    /*
     * If we want to make a permanent allocation, try to do it at tail
     * of memory list.
     */
    if (permanent) {
-      if (ctx->tail->size >= bytes) {
+      if (ctx->tail->free==1 && ctx->tail->size >= bytes) {
 #ifdef DEBUG_MEM
          printf("permanent allocation of %d bytes.  old tail->size=%d",
                  bytes, ctx->tail->size );
 #endif
+         unlink_free( ctx, ctx->tail );
          ctx->tail->size -= bytes;
+         link_free( ctx, ctx->tail );
          ctx->memory_used += bytes;
+         account( ctx, type, bytes );
 #ifdef DEBUG_MEM
          printf(".  new tail->size=%d\n", ctx->tail->size );
 #endif
@@ -122,62 +334,20 @@ static void *alloc( Context ctx, PTRINT b, int permanent, int type )
    /*
     * Find a block of memory large enough to make the allocation from.
     */
-
-   pos = NULL;
-   if (ctx->guess) {
-      /* Try a guess */
-#ifdef DEBUG_MEM
-      assert( ctx->guess->magic==MAGIC );
-      assert( ctx->guess->free==1);
-#endif
-      if (ctx->guess->free && ctx->guess->size >= bytes + MEMSIZ) {
-         /* a good guess! */
-#ifdef DEBUG_MEM
-         printf("Good guess!\n");
-#endif
-         pos = ctx->guess;
-         ctx->guess = NULL;
-      }
-   }
-
-   if (pos==NULL) {
-      /* Find first fit */
-#ifdef DEBUG_MEM
-      int tries = 0;
-#endif
-      for (pos=ctx->head; pos; pos=pos->next) {
-         if (pos->free && pos->size == bytes) {
-            /* found exact fit! */
-            break;
-         }
-         else if (pos->free && pos->size >= bytes + MEMSIZ) {
-            /* found a block to split */
-            break;
-         }
-#ifdef DEBUG_MEM
-         tries++;
-#endif
-      }
-#ifdef DEBUG_MEM
-      printf("%d tries\n", tries);
-#endif
-   }
-
-
+   pos = find_free( ctx, bytes );
    if (!pos) {
       /* couldn't find block large enough, return NULL */
-      ctx->guess = NULL;
       return NULL;
    }
+   unlink_free( ctx, pos );
 
    if (pos->size == bytes) {
       /* found a block of exact size! */
       pos->free = 0;
+      pos->type = type;
       ctx->memory_used += bytes;
-      if (ctx->guess==pos)
-        ctx->guess = NULL;
+      account( ctx, type, bytes );
 #ifdef DEBUG_MEM
-      pos->type = type;
       printf("exact fit 0x%x 0x%x\n", (int)pos, (int)(pos+1));
       check_memory( ctx );
 #endif
@@ -193,8 +363,8 @@ static void *alloc( Context ctx, PTRINT b, int permanent, int type )
       new->size = pos->size - bytes - MEMSIZ;
       new->prev = pos;
       new->next = pos->next;
-      new->free = 1;
       new->magic = MAGIC;
+      link_free( ctx, new );
       /* tail pointer */
       if (pos->next)
         pos->next->prev = new;
@@ -204,13 +374,10 @@ static void *alloc( Context ctx, PTRINT b, int permanent, int type )
       pos->next = new;
       pos->size = bytes;
       pos->free = 0;
+      pos->type = type;
       ctx->memory_used += bytes + MEMSIZ;
-      /* reset guess */
-      if (!ctx->guess) {
-         ctx->guess = new;
-      }
+      account( ctx, type, bytes );
 #ifdef DEBUG_MEM
-      pos->type = type;
       printf("big fit 0x%x 0x%x\n", (int)pos, (int)(pos+1));
       check_memory( ctx );
 #endif
@@ -244,16 +411,23 @@ static void dealloc( Context ctx, void *addr, PTRINT b )
 #ifdef DEBUG_MEM
    /* Sanity Checks: */
    assert( pos->magic==MAGIC );
-   assert( pos->free==0 );
+   assert( pos->free==0 || pos->free==HUGE_BLOCK );
 #endif
 
-   if (b<0) {
-      bytes = pos->size;
-   }
-   else if (b<MEMSIZ) {
-      bytes = MEMSIZ;
+   if (pos->free==HUGE_BLOCK) {
+      if (pos->prev)
+         pos->prev->next = pos->next;
+      else
+         ctx->huge = pos->next;
+      if (pos->next)
+         pos->next->prev = pos->prev;
+      ctx->memory_used -= pos->size + MEMSIZ;
+      unaccount( ctx, pos->type, pos->size );
+      free( pos );
+      return;
    }
-   else {
+
+   if (b>=MEMSIZ) {
       /* round up bytes to multiple of sizeof(struct mem) */
       bytes = ( (b+MEMSIZ-1) / MEMSIZ ) * MEMSIZ;
       if (pos->size!=bytes) {
@@ -264,7 +438,8 @@ static void dealloc( Context ctx, void *addr, PTRINT b )
 
    /* mark as free */
    pos->free = 1;
-   ctx->memory_used -= bytes;
+   ctx->memory_used -= pos->size;
+   unaccount( ctx, pos->type, pos->size );
 
    /* try to merge this block with successor */
    if (pos->next && pos->next->free==1) {
@@ -272,17 +447,13 @@ static void dealloc( Context ctx, void *addr, PTRINT b )
       printf("Merge with successor\n");
 #endif
       succ = pos->next;
+      unlink_free( ctx, succ );
       pos->size += MEMSIZ + succ->size;
       pos->next = succ->next;
-      pos->free = 1;
       if (succ->next)
          succ->next->prev = pos;
       else
          ctx->tail = pos;
-      /* update guess if necessary */
-      if (succ==ctx->guess) {
-         ctx->guess = pos;
-      }
       ctx->memory_used -= MEMSIZ;
    }
 
@@ -292,23 +463,19 @@ static void dealloc( Context ctx, void *addr, PTRINT b )
       printf("Merge with predecessor\n");
 #endif
       pred = pos->prev;
+      unlink_free( ctx, pred );
       pred->size += MEMSIZ + pos->size;
       pred->next = pos->next;
       if (pos->next)
          pos->next->prev = pred;
       else
          ctx->tail = pred;
-      /* update guess if necessary */
-      if (pos==ctx->guess) {
-         ctx->guess = pred;
-      }
       /* update pos */
       pos = pred;
       ctx->memory_used -= MEMSIZ;
    }
 
-   /* reset guess */
-   ctx->guess = pos;
+   link_free( ctx, pos );
 #ifdef DEBUG_MEM
    check_memory(ctx);
 #endif
@@ -316,6 +483,37 @@ static void dealloc( Context ctx, void *addr, PTRINT b )
 
 
 
+/*
+ * Make the whole pool one free block and release the huge blocks.
+ */
+static void reset_pool( Context ctx, struct mem *m )
+{
+   int i;
+
+   while (ctx->huge) {
+      struct mem *h = ctx->huge;
+      ctx->huge = h->next;
+      free( h );
+   }
+   memset( ctx->freebin, 0, sizeof(ctx->freebin) );
+   memset( ctx->freebinmap, 0, sizeof(ctx->freebinmap) );
+   for (i=0;i<MEM_TYPES;i++) {
+      ctx->memstats[i].bytes = 0;
+      ctx->memstats[i].blocks = 0;
+   }
+
+   m->size = ctx->memory_limit - sizeof(struct mem);
+   m->prev = NULL;
+   m->next = NULL;
+   m->magic = MAGIC;
+   link_free( ctx, m );
+
+   ctx->head = ctx->tail = m;
+   ctx->memory_used = MEMSIZ;
+}
+
+
+
 
 /********************************************/
 /***         DEBUGGING FUNCTIONS          ***/
@@ -326,6 +524,7 @@ static void dealloc( Context ctx, void *addr, PTRINT b )
 static void check_memory( Context ctx )
 {
    struct mem *pos, *pred;
+   int i;
 
    pred = NULL;
    pos = ctx->head;
@@ -356,11 +555,13 @@ static void check_memory( Context ctx )
       pos = pos->next;
    }
 
-   assert( ctx->tail->free==1 );
-
-   if (ctx->guess)
-     assert( ctx->guess->free == 1 );
-
+   for (i=0;i<MEM_BINS;i++) {
+      for (pos=ctx->freebin[i]; pos; pos=pos->fnext) {
+         if (pos->free!=1 || size_bin(pos->size)!=i) {
+            die("bad free list");
+         }
+      }
+   }
 }
 
 
@@ -375,9 +576,7 @@ static void dump_memory( Context ctx )
       printf("  size: %d", pos->size );
       printf("  prev: 0x%x", (int)pos->prev );
       printf("  next: 0x%x", (int)pos->next );
-#ifdef DEBUG_MEM
       printf("  type: %d", pos->type );
-#endif
       printf("  free: %d\n", pos->free );
       pos = pos->next;
    }
@@ -393,6 +592,24 @@ static void dump_memory( Context ctx )
 
 
 
+/*
+ * Allocate the per-type statistics of a context.
+ */
+static int alloc_stats( Context ctx )
+{
+   if (!ctx->memstats) {
+      ctx->memstats = (struct mem_type_stats *)
+                      calloc( MEM_TYPES, sizeof(struct mem_type_stats) );
+   }
+   else {
+      memset( ctx->memstats, 0, MEM_TYPES * sizeof(struct mem_type_stats) );
+   }
+   ctx->memory_peak = 0;
+   return ctx->memstats != NULL;
+}
+
+
+
 /*
  * Initialize the memory management for a context.
  * Input:  ctx - the vis5d context
@@ -417,19 +634,13 @@ int init_memory( Context ctx, PTRINT bytes )
          return 0;
       }
 
-      m->size = bytes - sizeof(struct mem);
-      m->prev = NULL;
-      m->next = NULL;
-      m->free = 1;
-      m->magic = MAGIC;
-
       ctx->mempool = m;
-      /* MJK 12.15.98 */
-      ctx->head = ctx->tail = ctx->guess = m;
-/*
-      ctx->head = ctx->tail = m;
-*/
-      ctx->memory_used = MEMSIZ;
+      ctx->huge = NULL;
+      ctx->huge_threshold = HUGE_BYTES;
+      if (!alloc_stats( ctx )) {
+         return 0;
+      }
+      reset_pool( ctx, m );
    }
    else {
       ctx->mempool = 0;
@@ -460,19 +671,15 @@ int init_shared_memory( Context ctx, void *start, PTRINT bytes )
    ctx->memory_limit = bytes;
 
    m = start;
-   m->size = bytes - sizeof(struct mem);
-   m->prev = NULL;
-   m->next = NULL;
-   m->free = 1;
-   m->magic = MAGIC;
 
    ctx->mempool = start;
-   /* MJK 12.15.98 */
-   ctx->head = ctx->tail = ctx->guess = m;
-/*
-   ctx->head = ctx->tail = m;
-*/
-   ctx->memory_used = MEMSIZ;
+   ctx->huge = NULL;
+   /* everything must come from the shared area */
+   ctx->huge_threshold = 0;
+   if (!alloc_stats( ctx )) {
+      return 0;
+   }
+   reset_pool( ctx, m );
 
    ALLOC_LOCK( ctx->memlock );
    ALLOC_LOCK( ctx->lrulock );
@@ -493,15 +700,7 @@ int reinit_memory( Context ctx )
 
    if (ctx->memory_limit) {
       m = ctx->head;
-
-      m->size = ctx->memory_limit - sizeof(struct mem);
-      m->prev = NULL;
-      m->next = NULL;
-      m->free = 1;
-      m->magic = MAGIC;
-
-      ctx->head = ctx->tail = m;
-      ctx->memory_used = MEMSIZ;
+      reset_pool( ctx, m );
    }
    else {
       /* How do we free() all the malloc()s ?? - in case
@@ -723,6 +922,86 @@ PTRINT mem_used( Display_Context dtx )
 }
 
 
+/*
+ * Return the name of a block type (see memory.h).
+ */
+const char *mem_type_name( int type )
+{
+   if (type<0 || type>=MEM_TYPES) {
+      return NULL;
+   }
+   return type_names[type];
+}
+
+
+
+/*
+ * Get the memory usage of one type of block in a context's pool.
+ * Input:  ctx - the vis5d context
+ *         type - block type or -1 for the whole pool
+ * Output:  stats - the statistics, all zero if the context has no pool
+ * Return:  1 = ok, 0 = bad type
+ */
+int get_mem_stats( Context ctx, int type, struct mem_type_stats *stats )
+{
+   int i;
+
+   if (type<-1 || type>=MEM_TYPES) {
+      return 0;
+   }
+   memset( stats, 0, sizeof(struct mem_type_stats) );
+   if (ctx->memory_limit==0 || !ctx->memstats) {
+      return 1;
+   }
+
+   LOCK_ON( ctx->memlock );
+   if (type>=0) {
+      *stats = ctx->memstats[type];
+   }
+   else {
+      for (i=0;i<MEM_TYPES;i++) {
+         stats->blocks += ctx->memstats[i].blocks;
+         stats->allocs += ctx->memstats[i].allocs;
+      }
+      stats->bytes = ctx->memory_used;
+      stats->peak = ctx->memory_peak;
+   }
+   LOCK_OFF( ctx->memlock );
+   return 1;
+}
+
+
+
+/*
+ * Print a table of the memory used by each type of block in a
+ * context's pool.  Types which were never allocated are omitted.
+ */
+void print_mem_stats( Context ctx, FILE *f )
+{
+   struct mem_type_stats st;
+   int i;
+
+   if (ctx->memory_limit==0) {
+      fprintf( f, "context %d: no memory pool (-mbs 0)\n", ctx->context_index );
+      return;
+   }
+   get_mem_stats( ctx, -1, &st );
+   fprintf( f, "context %d: %ld of %ld bytes used, peak %ld\n",
+            ctx->context_index, (long) st.bytes, (long) ctx->memory_limit,
+            (long) st.peak );
+   fprintf( f, "  %-12s %14s %14s %9s %10s\n",
+            "type", "bytes", "peak", "blocks", "allocs" );
+   for (i=0;i<MEM_TYPES;i++) {
+      get_mem_stats( ctx, i, &st );
+      if (st.allocs) {
+         fprintf( f, "  %-12s %14ld %14ld %9d %10d\n", type_names[i],
+                  (long) st.bytes, (long) st.peak, st.blocks, st.allocs );
+      }
+   }
+}
+
+
+
 void *MALLOC( size_t size )
 {
    void *p;
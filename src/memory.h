@@ -30,6 +30,7 @@
 #define MEMORY_H
 
 
+#include <stdio.h>
 #include "globals.h"
 
 
@@ -103,6 +104,25 @@
 #define UWIND_TYPE 66
 #define VWIND_TYPE 67
 #define VERTDATA_TYPE 68
+#define GRIDCACHE_TYPE 69
+#define GRIDSCALE_TYPE 70
+#define COLORINDEX_TYPE 71
+#define TRAJ_TYPE 72
+
+/* number of block types above */
+#define MEM_TYPES 73
+
+
+/*
+ * Per-type accounting of the blocks in a context's memory pool.  This is
+ * always kept when the context has a pool (-mbs), not just with DEBUG_MEM.
+ */
+struct mem_type_stats {
+   PTRINT bytes;        /* bytes currently allocated */
+   PTRINT peak;         /* largest value of bytes */
+   int blocks;          /* blocks currently allocated */
+   int allocs;          /* number of allocations since init_memory */
+};
 
 extern int init_memory( Context ctx, PTRINT bytes );
 
@@ -124,6 +144,12 @@ extern PTRINT mem_available( Context ctx );
 
 extern PTRINT mem_used( Display_Context dtx );
 
+extern const char *mem_type_name( int type );
+
+extern int get_mem_stats( Context ctx, int type, struct mem_type_stats *stats );
+
+extern void print_mem_stats( Context ctx, FILE *f );
+
 extern void *MALLOC( size_t  size );
 
 extern void FREE( void *ptr, int id );
@@ -43,10 +43,14 @@
 #include "globals.h"
 #include "memory.h"
 #include "imemory.h"
+#include "isolod.h"
+#include "isomesh.h"
 #include "misc.h"
 #include "proj.h"
 #include "sync.h"
+#include "trajset.h"
 #include "vis5d.h"
+#include "windvec.h"
 
 
 /*
@@ -347,53 +351,18 @@ void init_graphics_pos( Context ctx, int var )
 
 
 
-/*
- * Free a traj struct and any memory it points to.
- */
-static void free_traj( Display_Context dtx, struct traj *t )
-{
-   int bytes;
-   Context trajuctx;
-
-   trajuctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, dtx->TrajUowner)];
-
-   /* WLH 4 Nov 98 */
-   if (trajuctx == NULL) return;
-
-   /* vertices */
-   bytes = 3 * t->length * sizeof(int_vert2);
-   deallocate( trajuctx, t->verts, bytes );
-
-   if (t->kind==1) {
-      /* ribbon normals */
-      bytes = 3 * t->length * sizeof(int_1);
-      deallocate( trajuctx, t->norms, bytes );
-   }
-
-   if (t->colors) {
-      /* colors */
-      bytes = t->length * sizeof(uint_1);
-      deallocate( trajuctx, t->colors, bytes );
-   }
-
-   bytes = trajuctx->NumTimes * sizeof(uint_vert2);
-   deallocate( trajuctx, t->start, bytes );
-   deallocate( trajuctx, t->len, bytes );
-   deallocate( trajuctx, t, sizeof(struct traj) );
-}
-
-
-
 /*** del_last_traj ****************************************************
    Delete the most recent trajectory.
 **********************************************************************/
 void del_last_traj( Display_Context dtx )
 {
+   struct traj *t;
+
    LOCK_ON( TrajLock );
 
    if (dtx->NumTraj) {
-      free_traj( dtx, dtx->TrajTable[dtx->NumTraj-1] );
-      dtx->TrajTable[dtx->NumTraj-1] = NULL;
+      t = &dtx->TrajTable[dtx->NumTraj-1];
+      truncate_traj_set( dtx, t->group, t->index );
       dtx->NumTraj--;
    }
 
@@ -413,22 +382,16 @@ void del_traj_group( Display_Context dtx, int g )
 
    LOCK_ON( TrajLock );
 
-   i = 0;
-   while (i<dtx->NumTraj) {
-      if (dtx->TrajTable[i]->group==g) {
-         if (i<MAXTRAJ-1) {
-            free_traj( dtx, dtx->TrajTable[i] );
-            /* delete this one by shifting remaining trajectories backward */
-            for (j=i+1;j<dtx->NumTraj;j++) {
-               dtx->TrajTable[j-1] = dtx->TrajTable[j];
-            }
-         }
-         dtx->NumTraj--;
-      }
-      else {
-         i++;
+   free_traj_set( dtx, g );
+
+   /* drop them from the table, keeping the others in order */
+   j = 0;
+   for (i=0;i<dtx->NumTraj;i++) {
+      if (dtx->TrajTable[i].group!=g) {
+         dtx->TrajTable[j++] = dtx->TrajTable[i];
       }
    }
+   dtx->NumTraj = j;
 
    LOCK_OFF( TrajLock );
 }
@@ -436,6 +399,52 @@ void del_traj_group( Display_Context dtx, int g )
 
 
 
+/*
+ * Deallocate the vertices, indexes, colors and levels of detail of an
+ * isosurface and mark it invalid.
+ * Return:  number of bytes freed
+ */
+static int free_isosurface_data( Context ctx, struct isosurface *surf )
+{
+   int b1, b2, b3, b4;
+
+   if (!surf || !surf->valid) {
+      return 0;
+   }
+   /* vertices */
+   b1 = surf->numverts * sizeof(int_vert2) * 3;
+   if (b1) {
+      deallocate( ctx, surf->verts, b1 );
+   }
+   /* normals */
+   b2 = surf->numverts * sizeof(int_1) * 3;
+   if (b2) {
+      deallocate( ctx, surf->norms, b2 );
+   }
+   /* indices */
+   b3 = free_iso_chunks( ctx, surf->numindex, surf->index,
+                         surf->numchunks, surf->chunks );
+   surf->index = NULL;
+   surf->chunks = NULL;
+   /* colors */
+   if (surf->colors) {
+      b4 = surf->numverts * sizeof(uint_1);
+      deallocate( ctx, surf->colors, b4 );
+      surf->colors = NULL;
+   }
+   else {
+      b4 = 0;
+   }
+   /* simplified versions */
+   b4 += free_iso_lods( ctx, surf->numlods, surf->lod );
+   surf->numlods = 0;
+   surf->valid = 0;
+   surf->generation++;
+   return b1 + b2 + b3 + b4;
+}
+
+
+
 /*
  * Deallocate an isosurface's memory.
  */
@@ -453,79 +462,196 @@ int free_isosurface( Context ctx, int time, int var )
          ctime = dtx->TimeStep[t].ownerstimestep[return_ctx_index_pos(dtx,
                                                  ctx->context_index)];
          if ( ctime==ftime){
-            if (ctx->Variable[var]->SurfTable[time]->valid) {
-               int b1, b2, b3, b4;
-               /* vertices */
-               b1 = ctx->Variable[var]->SurfTable[time]->numverts * sizeof(int_vert2) * 3;
-               if (b1) {
-                  deallocate( ctx, ctx->Variable[var]->SurfTable[time]->verts, b1 );
-               }
-               /* normals */
-               b2 = ctx->Variable[var]->SurfTable[time]->numverts * sizeof(int_1) * 3;
-               if (b2) {
-                  deallocate( ctx, ctx->Variable[var]->SurfTable[time]->norms, b2 );
-               }
-               /* indices */
-               b3 = ctx->Variable[var]->SurfTable[time]->numindex * sizeof(uint_index);
-               if (b3) {
-                  deallocate( ctx, ctx->Variable[var]->SurfTable[time]->index, b3 );
-               }
-               /* colors */
-               if (ctx->Variable[var]->SurfTable[time]->colors) {
-                  b4 = ctx->Variable[var]->SurfTable[time]->numverts * sizeof(uint_1);
-                  deallocate( ctx, ctx->Variable[var]->SurfTable[time]->colors, b4 );
-                  ctx->Variable[var]->SurfTable[time]->colors = NULL;
-               }
-               else {
-                  b4 = 0;
-               }
-               ctx->Variable[var]->SurfTable[time]->valid = 0;
-               total += b1 + b2 + b3 + b4;
-            }
+            total += free_isosurface_data( ctx, ctx->Variable[var]->SurfTable[time] );
          }
       }
       return total;
    }
-   
-   else{
+   else if (ctx->Variable[var]) {
+      return free_isosurface_data( ctx, ctx->Variable[var]->SurfTable[time] );
+   }
+	return 0;
+}
 
-      if (ctx->Variable[var] && 
-			 ctx->Variable[var]->SurfTable[time] && 
-			 ctx->Variable[var]->SurfTable[time]->valid) {
-         int b1, b2, b3, b4;
-         /* vertices */
-         b1 = ctx->Variable[var]->SurfTable[time]->numverts * sizeof(int_vert2) * 3;
-         if (b1) {
-            deallocate( ctx, ctx->Variable[var]->SurfTable[time]->verts, b1 );
-         }
-         /* normals */
-         b2 = ctx->Variable[var]->SurfTable[time]->numverts * sizeof(int_1) * 3;
-         if (b2) {
-            deallocate( ctx, ctx->Variable[var]->SurfTable[time]->norms, b2 );
-         }
-         /* indices */
-         b3 = ctx->Variable[var]->SurfTable[time]->numindex * sizeof(uint_index);
-         if (b3) {
-            deallocate( ctx, ctx->Variable[var]->SurfTable[time]->index, b3 );
-         }
-         /* colors */
-         if (ctx->Variable[var]->SurfTable[time]->colors) {
-            b4 = ctx->Variable[var]->SurfTable[time]->numverts * sizeof(uint_1);
-            deallocate( ctx, ctx->Variable[var]->SurfTable[time]->colors, b4 );
-            ctx->Variable[var]->SurfTable[time]->colors = NULL;
+
+
+/*
+ * Allocate a copy of a block of memory.
+ */
+static void *copy_memory( Context ctx, const void *src, PTRINT bytes,
+                          int type )
+{
+   void *dst;
+
+   if (!src || bytes<=0) {
+      return NULL;
+   }
+   dst = allocate_type( ctx, bytes, type );
+   if (dst) {
+      memcpy( dst, src, bytes );
+   }
+   return dst;
+}
+
+
+
+/*
+ * Copy the geometry, colors and levels of detail of an isosurface into
+ * an empty one.  The MixKit decimated version isn't copied.
+ * Input:  ctx - the context
+ *         dst - the empty surface
+ *         src - the surface to copy
+ * Return:  1 = ok, 0 = out of memory, dst is left empty
+ */
+static int copy_isosurface( Context ctx, struct isosurface *dst,
+                            const struct isosurface *src )
+{
+   int nv = src->numverts, i, ok;
+
+   dst->isolevel = src->isolevel;
+   dst->numverts = nv;
+   dst->verts = copy_memory( ctx, src->verts, 3*nv*sizeof(int_vert2), CVX_TYPE );
+   dst->norms = copy_memory( ctx, src->norms, 3*nv*sizeof(int_1), CNX_TYPE );
+   dst->colors = copy_memory( ctx, src->colors, nv*sizeof(uint_1), COLORINDEX_TYPE );
+   dst->numindex = src->numindex;
+   dst->index = copy_memory( ctx, src->index, src->numindex*sizeof(uint_2), PTS_TYPE );
+   dst->numchunks = src->numchunks;
+   dst->chunks = copy_memory( ctx, src->chunks,
+                              src->numchunks*sizeof(struct iso_chunk), PTS_TYPE );
+   dst->colorvar = src->colorvar;
+   dst->cvowner = src->cvowner;
+   dst->cvtime = src->cvtime;
+   dst->deci_numverts = 0;
+   dst->deci_verts = NULL;
+   dst->deci_norms = NULL;
+   dst->deci_colors = NULL;
+   ok = (nv==0 || (dst->verts && dst->norms && dst->index && dst->chunks)) &&
+        (!src->colors || dst->colors);
+
+   dst->numlods = 0;
+   for (i=0; ok && i<src->numlods; i++) {
+      const struct iso_lod *s = &src->lod[i];
+      struct iso_lod *d = &dst->lod[i];
+
+      *d = *s;
+      d->verts = copy_memory( ctx, s->verts, 3*s->numverts*sizeof(int_vert2), CVX_TYPE );
+      d->norms = copy_memory( ctx, s->norms, 3*s->numverts*sizeof(int_1), CNX_TYPE );
+      d->colors = copy_memory( ctx, s->colors, s->numverts*sizeof(uint_1), COLORINDEX_TYPE );
+      d->vmap = copy_memory( ctx, s->vmap, s->numverts*sizeof(uint_index), PTS_TYPE );
+      d->index = copy_memory( ctx, s->index, s->numindex*sizeof(uint_2), PTS_TYPE );
+      d->chunks = copy_memory( ctx, s->chunks,
+                               s->numchunks*sizeof(struct iso_chunk), PTS_TYPE );
+      dst->numlods = i+1;
+      ok = d->verts && d->norms && d->vmap && d->index && d->chunks &&
+           (!s->colors || d->colors);
+   }
+
+   /* free_isosurface_data() copes with any missing parts */
+   dst->valid = 1;
+   if (!ok) {
+      free_isosurface_data( ctx, dst );
+   }
+   return ok;
+}
+
+
+
+/*
+ * SurfTable is indexed by the context's own timesteps when an isosurface
+ * is colored by a variable of the same context, and by display timesteps
+ * otherwise.  Move the surfaces of a variable from one indexing to the
+ * other so that changing the coloring context only recolors them.  A
+ * surface needed at several display timesteps is copied.
+ * Input:  ctx - the context
+ *         var - the isosurface variable
+ *         bydtx - 1 to index by display timesteps, 0 by context timesteps
+ */
+void reindex_isosurfaces( Context ctx, int var, int bydtx )
+{
+   Display_Context dtx = ctx->dpy_ctx;
+   struct isosurface *old, *surf;
+   char *used;
+   int pos, oldn, newn, t, d, src, lock, generation;
+
+   pos = return_ctx_index_pos( dtx, ctx->context_index );
+   oldn = bydtx ? ctx->NumTimes : dtx->NumTimes;
+   newn = bydtx ? dtx->NumTimes : ctx->NumTimes;
+   old = (struct isosurface *) calloc( oldn, sizeof(struct isosurface) );
+   used = (char *) calloc( oldn, 1 );
+   if (!old || !used) {
+      /* fall back to dropping the surfaces */
+      for (t=0;t<oldn;t++) {
+         free_isosurface_data( ctx, ctx->Variable[var]->SurfTable[t] );
+      }
+      free( old );
+      free( used );
+      return;
+   }
+
+   /* take the surfaces out of the table */
+   for (t=0;t<oldn;t++) {
+      surf = ctx->Variable[var]->SurfTable[t];
+      if (surf) {
+         wait_write_lock( &surf->lock );
+         lock = surf->lock;
+         generation = surf->generation;
+         old[t] = *surf;
+         memset( surf, 0, sizeof(struct isosurface) );
+         surf->lock = lock;
+         surf->generation = generation + 1;
+         done_write_lock( &surf->lock );
+      }
+   }
+
+   /* put them back under their new timesteps */
+   for (t=0;t<newn;t++) {
+      if (bydtx) {
+         src = dtx->TimeStep[t].ownerstimestep[pos];
+      }
+      else {
+         for (d=0;d<oldn;d++) {
+            if (dtx->TimeStep[d].ownerstimestep[pos]==t && old[d].valid) {
+               break;
+            }
          }
-         else {
-            b4 = 0;
+         src = d;
+      }
+      if (src<0 || src>=oldn || !old[src].valid) {
+         continue;
+      }
+
+      surf = ctx->Variable[var]->SurfTable[t];
+      if (!surf) {
+         surf = (struct isosurface *) allocate( ctx, sizeof(struct isosurface) );
+         if (!surf) {
+            continue;
          }
-         ctx->Variable[var]->SurfTable[time]->valid = 0;
-         return b1 + b2 + b3 + b4;
+         memset( surf, 0, sizeof(struct isosurface) );
+         ctx->Variable[var]->SurfTable[t] = surf;
       }
-      else 
-		  {
-         return 0;
+      wait_write_lock( &surf->lock );
+      if (!used[src]) {
+         lock = surf->lock;
+         generation = surf->generation;
+         *surf = old[src];
+         surf->lock = lock;
+         surf->generation = generation + 1;
+         used[src] = 1;
       }
+      else {
+         copy_isosurface( ctx, surf, &old[src] );
+      }
+      done_write_lock( &surf->lock );
    }
-	return 0;
+
+   /* free the surfaces no timestep uses any more */
+   for (t=0;t<oldn;t++) {
+      if (!used[t]) {
+         free_isosurface_data( ctx, &old[t] );
+      }
+   }
+   free( old );
+   free( used );
 }
 
 
@@ -719,7 +845,7 @@ int free_hwind( Display_Context dtx, int time, int ws )
 
    uctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, dtx->Uvarowner[ws])];
    if (dtx->HWindTable[ws][time].valid) {
-      int b1, b2;
+      int b1, b2, b3;
 /* MJK 10.14.98 
       dtx->DisplayHWind[ws] = 0;
 */
@@ -739,8 +865,13 @@ int free_hwind( Display_Context dtx, int time, int ws )
       if (b2 && uctx) {
          deallocate( uctx, dtx->HWindTable[ws][time].boxverts, b2 );
       }
+      b3 = 0;
+      if (uctx) {
+         b3 = free_wind_arrows( uctx, dtx->HWindTable[ws][time].arrows );
+         dtx->HWindTable[ws][time].arrows = NULL;
+      }
       dtx->HWindTable[ws][time].valid = 0;
-      return b1 + b2;
+      return b1 + b2 + b3;
    }
    else {
       return 0;
@@ -755,7 +886,7 @@ int free_vwind( Display_Context dtx, int time, int ws )
 
    uctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, dtx->Uvarowner[ws])];
    if (dtx->VWindTable[ws][time].valid) {
-      int b1, b2;
+      int b1, b2, b3;
 /* MJK 10.14.98       
       dtx->DisplayVWind[ws] = 0;
 */
@@ -775,8 +906,13 @@ int free_vwind( Display_Context dtx, int time, int ws )
       if (b2 && uctx) {
          deallocate( uctx, dtx->VWindTable[ws][time].boxverts, b2 );
       }
+      b3 = 0;
+      if (uctx) {
+         b3 = free_wind_arrows( uctx, dtx->VWindTable[ws][time].arrows );
+         dtx->VWindTable[ws][time].arrows = NULL;
+      }
       dtx->VWindTable[ws][time].valid = 0;
-      return b1 + b2;
+      return b1 + b2 + b3;
    }
    else {
       return 0;
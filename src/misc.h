@@ -68,6 +68,8 @@ extern void del_traj_group( Display_Context dtx, int g );
 
 extern int free_isosurface( Context ctx, int time, int var );
 
+extern void reindex_isosurfaces( Context ctx, int var, int bydtx );
+
 extern int free_textplot( Irregular_Context itx, int time);
 
 extern int free_hslice( Context ctx, int time, int var );
@@ -0,0 +1,201 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "../config.h"
+
+/* Jobs split into parts which the worker threads help with */
+
+
+#include <stdio.h>
+#include "globals.h"
+#include "parallel.h"
+#include "queue.h"
+#include "sync.h"
+
+
+
+#define MIN2( X, Y )        ( (X) < (Y) ? (X) : (Y) )
+
+
+/*
+ * A parallel job is split into parts which can be done in any order and
+ * on any thread.  Its owner asks idle worker threads for help through the
+ * work queue while it claims parts itself, so the job finishes even if no
+ * worker is free.
+ */
+#define MAX_PARALLEL_JOBS   16      /* > max worker threads */
+
+struct parallel_job {
+   parallel_part_func do_part;
+   void *data;
+   int numparts;
+   int nextpart;                  /* next part to be claimed */
+   int partsdone;
+   int waiting;                   /* owner is blocked on done */
+#ifdef SEMAPHORE
+   SEMAPHORE done;
+#endif
+};
+
+
+#ifdef SEMAPHORE
+
+/* Jobs which the worker threads may help with */
+static LOCK JobLock;
+static struct parallel_job *Job[MAX_PARALLEL_JOBS];
+static int JobId[MAX_PARALLEL_JOBS];
+
+
+/*
+ * Do the unclaimed parts of a job.  Called and returns with JobLock
+ * held.
+ */
+static void work_on_parts( struct parallel_job *job )
+{
+   int part;
+
+   while (job->nextpart < job->numparts) {
+      part = job->nextpart++;
+      LOCK_OFF( JobLock );
+      job->do_part( job->data, part );
+      LOCK_ON( JobLock );
+      job->partsdone++;
+   }
+}
+
+#endif
+
+
+
+void init_parallel( void )
+{
+#ifdef SEMAPHORE
+   ALLOC_LOCK( JobLock );
+#endif
+}
+
+
+
+void terminate_parallel( void )
+{
+#ifdef SEMAPHORE
+   FREE_LOCK( JobLock );
+#endif
+}
+
+
+
+/*
+ * Help a run_parallel_job() call running on another thread with its
+ * parts.  This is called by the work queue for TASK_PARALLEL entries and
+ * returns at once if the job has already been finished.
+ * Input:  slot, id - the job, as passed to request_parallel_help().
+ */
+void parallel_job_task( int slot, int id )
+{
+#ifdef SEMAPHORE
+   struct parallel_job *job;
+
+   if (slot<0 || slot>=MAX_PARALLEL_JOBS)
+      return;
+
+   LOCK_ON( JobLock );
+   job = Job[slot];
+   if (job && JobId[slot]==id) {
+      work_on_parts( job );
+      if (job->partsdone==job->numparts && job->waiting) {
+         job->waiting = 0;
+         SIGNAL_SEM( job->done );
+      }
+   }
+   LOCK_OFF( JobLock );
+#endif
+}
+
+
+
+/*
+ * Call do_part( data, part ) for each part in [0,numparts), with help
+ * from idle worker threads when there are several parts, and return
+ * when all of them are done.
+ * Input:  ctx - the context the work is for, may be NULL
+ *         do_part - does one part of the job
+ *         data - passed on to do_part
+ *         numparts - number of parts
+ */
+void run_parallel_job( Context ctx, parallel_part_func do_part, void *data,
+                       int numparts )
+{
+   int i;
+#ifdef SEMAPHORE
+   struct parallel_job job;
+   int slot, id, helpers;
+
+   if (numparts > 1) {
+      LOCK_ON( JobLock );
+      for (slot=0; slot<MAX_PARALLEL_JOBS && Job[slot]; slot++)
+         ;
+      if (slot<MAX_PARALLEL_JOBS) {
+         job.do_part = do_part;
+         job.data = data;
+         job.numparts = numparts;
+         job.nextpart = job.partsdone = job.waiting = 0;
+         ALLOC_SEM( job.done, 0 );
+         Job[slot] = &job;
+         id = ++JobId[slot];
+         LOCK_OFF( JobLock );
+
+         helpers = MIN2( numparts-1, NumThreads-1 );
+         for (i=0;i<helpers;i++) {
+            if (!request_parallel_help( ctx, slot, i, id )) {
+               /* queue is full, do the rest ourselves */
+               break;
+            }
+         }
+
+         LOCK_ON( JobLock );
+         work_on_parts( &job );
+         if (job.partsdone < job.numparts) {
+            job.waiting = 1;
+            LOCK_OFF( JobLock );
+            WAIT_SEM( job.done );
+            LOCK_ON( JobLock );
+         }
+         Job[slot] = NULL;
+         LOCK_OFF( JobLock );
+         FREE_SEM( job.done );
+         return;
+      }
+      LOCK_OFF( JobLock );
+   }
+#endif
+
+   for (i=0;i<numparts;i++) {
+      do_part( data, i );
+   }
+}
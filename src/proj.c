@@ -74,6 +74,22 @@
 #define SPHERE_SCALE   0.125
 
 
+/* Single precision math for the batch transformations, if available */
+#ifdef HAVE_SINF
+#  define FSIN( X )      sinf( X )
+#  define FCOS( X )      cosf( X )
+#  define FTAN( X )      tanf( X )
+#  define FLOG( X )      logf( X )
+#  define FPOW( X, Y )   powf( X, Y )
+#else
+#  define FSIN( X )      ((float) sin( X ))
+#  define FCOS( X )      ((float) cos( X ))
+#  define FTAN( X )      ((float) tan( X ))
+#  define FLOG( X )      ((float) log( X ))
+#  define FPOW( X, Y )   ((float) pow( X, Y ))
+#endif
+
+
 /* Convert Height to Pressure: */
 #define HGT_TO_P( H )   ( ctx->LogScale * exp( H / ctx->LogExp ) )
 #define HGT_TO_PPRIME( H ) ( dtx->LogScale * exp( H / dtx->LogExp ) )
@@ -1578,6 +1594,440 @@ float height_to_zTOPO(Display_Context dtx, float hgt )
 /* MJK 2.17.98 end */
 
 
+
+/*
+ * Fraction of the way from Zmin to Zmax of a height, for the vertical
+ * systems where that isn't linear in the height.
+ */
+static float height_fraction( const vert_table *t, float hgt )
+{
+   float p;
+
+   if (t->vertical==VERT_NONEQUAL_MB) {
+      p = height_to_pressure( hgt );
+   }
+   else {
+      p = t->logscale * exp( hgt / t->logexp );
+   }
+   return (p - t->pbot) / (t->ptop - t->pbot);
+}
+
+
+/* guards the switch to a rebuilt lookup table */
+static LOCK TableLock;
+
+
+/*
+ * Make sure the height to z table *tp matches the current vertical
+ * coordinate parameters, replacing it if not.  Only the nonlinear
+ * systems need the table itself.  A new table is filled in before it's
+ * published, and the old one stays valid for threads still using it.
+ * Input:  local - filled in and returned instead if out of memory.
+ * Return:  the table.
+ */
+static const vert_table *update_vert_table( vert_table **tp,
+                                            vert_table *local,
+                                            int vertical, int nonlinear,
+                                            float logscale, float logexp,
+                                            float bottom, float top,
+                                            float pbot, float ptop )
+{
+   vert_table *t;
+   int i;
+
+   LOCK_ON( TableLock );
+   t = *tp;
+   LOCK_OFF( TableLock );
+   if (t && t->vertical==vertical && t->nonlinear==nonlinear &&
+       t->logscale==logscale && t->logexp==logexp &&
+       t->bottom==bottom && t->top==top &&
+       t->pbot==pbot && t->ptop==ptop) {
+      return t;
+   }
+
+   t = (vert_table *) malloc( sizeof(vert_table) );
+   if (!t) {
+      t = local;
+   }
+   t->vertical = vertical;
+   t->nonlinear = nonlinear;
+   t->logscale = logscale;
+   t->logexp = logexp;
+   t->bottom = bottom;
+   t->top = top;
+   t->pbot = pbot;
+   t->ptop = ptop;
+   if (nonlinear) {
+      for (i=0;i<=VERT_TABLE_SIZE;i++) {
+         t->frac[i] = height_fraction( t, bottom + (top-bottom)
+                                          * (float) i / VERT_TABLE_SIZE );
+      }
+   }
+
+   if (t!=local) {
+      LOCK_ON( TableLock );
+      t->older = *tp;
+      *tp = t;
+      LOCK_OFF( TableLock );
+   }
+   return t;
+}
+
+
+static void free_vert_tables( vert_table **tp )
+{
+   vert_table *t, *older;
+
+   for (t = *tp; t; t = older) {
+      older = t->older;
+      free( t );
+   }
+   *tp = NULL;
+}
+
+
+/*
+ * Convert an array of heights to z graphics coordinates in [zmin,zmax].
+ * The exp() of the log and pressure systems is replaced by the lookup
+ * table so every case is a tight loop without function calls.
+ * Input:  t - the table, already updated for the vertical system.
+ *         table - use the table, else the mapping is linear.
+ *         clamp - heights outside [bottom,top] give zmin/zmax, else
+ *                 they are extrapolated like height_to_zPRIME().
+ */
+static void batch_height_to_z( const vert_table *t, int table, int clamp,
+                               float zmin, float zmax,
+                               int n, const float hgt[], float z[] )
+{
+   float bottom = t->bottom, top = t->top;
+   float zscale = zmax - zmin;
+   int i;
+
+   if (!table) {
+      float hscale;
+      if (top==bottom) {
+         /* what the scalar functions do */
+         for (i=0;i<n;i++) {
+            z[i] = clamp ? (hgt[i]>=top ? zmax : zmin) : 0.0;
+         }
+         return;
+      }
+      hscale = zscale / (top-bottom);
+      for (i=0;i<n;i++) {
+         float h = hgt[i];
+         float zz = zmin + (h-bottom) * hscale;
+         if (clamp) {
+            zz = h>=top ? zmax : (h<=bottom ? zmin : zz);
+         }
+         z[i] = zz;
+      }
+   }
+   else {
+      const float *frac = t->frac;
+      float step = VERT_TABLE_SIZE / (top-bottom);
+      for (i=0;i<n;i++) {
+         float h = hgt[i];
+         if (h>=top || h<=bottom || h!=h) {
+            if (clamp) {
+               z[i] = h>=top ? zmax : zmin;
+            }
+            else {
+               z[i] = zmin + zscale * height_fraction( t, h );
+            }
+         }
+         else {
+            float s = (h-bottom) * step;
+            int k = (int) s;
+            if (k>=VERT_TABLE_SIZE) {
+               k = VERT_TABLE_SIZE-1;
+            }
+            s -= k;
+            z[i] = zmin + zscale * (frac[k] + s * (frac[k+1]-frac[k]));
+         }
+      }
+   }
+}
+
+
+/*
+ * Batch versions of height_to_z(), height_to_zPRIME() and
+ * height_to_zTOPO():  convert n heights to z graphics coordinates.
+ * z may be the same array as hgt.
+ */
+static void heights_to_z( Context ctx, int n, const float hgt[], float z[] )
+{
+   const vert_table *t;
+   vert_table local;
+   int table;
+
+   switch (ctx->VerticalSystem) {
+      case VERT_GENERIC:
+      case VERT_EQUAL_KM:
+      case VERT_NONEQUAL_KM:
+         table = ctx->LogFlag;
+         break;
+      case VERT_NONEQUAL_MB:
+         table = 1;
+         break;
+      default:
+         printf("Error in height_to_z\n");
+         return;
+   }
+   t = update_vert_table( &ctx->HgtTable, &local, ctx->VerticalSystem,
+                          table, ctx->LogScale, ctx->LogExp,
+                          ctx->BottomBound, ctx->TopBound,
+                          ctx->Pbot, ctx->Ptop );
+   batch_height_to_z( t, table, 1, ctx->dpy_ctx->Zmin,
+                      ctx->dpy_ctx->Zmax, n, hgt, z );
+}
+
+
+static void heights_to_zPRIME( Display_Context dtx, int clamp, int n,
+                               const float hgt[], float z[] )
+{
+   const vert_table *t;
+   vert_table local;
+   int table;
+
+   switch (dtx->VerticalSystem) {
+      case VERT_GENERIC:
+      case VERT_EQUAL_KM:
+      case VERT_NONEQUAL_KM:
+         table = dtx->LogFlag;
+         break;
+      case VERT_NONEQUAL_MB:
+         table = 1;
+         break;
+      default:
+         printf("Error in height_to_zPRIME\n");
+         return;
+   }
+   t = update_vert_table( &dtx->HgtTable, &local, dtx->VerticalSystem,
+                          table, dtx->LogScale, dtx->LogExp,
+                          dtx->BottomBound, dtx->TopBound,
+                          dtx->Pbot, dtx->Ptop );
+   batch_height_to_z( t, table, clamp, dtx->Zmin, dtx->Zmax,
+                      n, hgt, z );
+}
+
+
+/*
+ * Make sure the grid level to z table *tp matches the current vertical
+ * coordinate system, replacing it if not.  Level heights are
+ * interpolated as in gridlevel_to_z() and the table holds the exact
+ * value at each grid level and at LEVEL_TABLE_SIZE/(maxnl-1) steps
+ * in between.  Height[] may be changed without going through the
+ * setup functions, so it is part of the key.  A new table is filled
+ * in before it's published, and the old one stays valid for threads
+ * still using it.
+ * Return:  the table, or NULL if the mapping needs no exp() and the
+ *          plain functions are as fast, or out of memory.
+ */
+static const level_table *update_level_table( level_table **tp,
+                                              int vertical,
+                                              int logflag, float logscale,
+                                              float logexp, int maxnl,
+                                              const float height[],
+                                              float bottom, float top,
+                                              float pbot, float ptop )
+{
+   level_table *t;
+   int i, k, size;
+
+   if (maxnl<2 || vertical<VERT_GENERIC || vertical>VERT_NONEQUAL_MB ||
+       (vertical!=VERT_NONEQUAL_MB && !logflag)) {
+      return NULL;
+   }
+   LOCK_ON( TableLock );
+   t = *tp;
+   LOCK_OFF( TableLock );
+   if (t && t->vertical==vertical && t->logflag==logflag &&
+       t->maxnl==maxnl && t->logscale==logscale && t->logexp==logexp &&
+       t->bottom==bottom && t->top==top &&
+       t->pbot==pbot && t->ptop==ptop &&
+       memcmp( t->height, height, maxnl*sizeof(float) )==0) {
+      return t;
+   }
+
+   t = (level_table *) malloc( sizeof(level_table) );
+   if (!t) {
+      return NULL;
+   }
+   t->vertical = vertical;
+   t->logflag = logflag;
+   t->maxnl = maxnl;
+   t->logscale = logscale;
+   t->logexp = logexp;
+   t->bottom = bottom;
+   t->top = top;
+   t->pbot = pbot;
+   t->ptop = ptop;
+   memcpy( t->height, height, maxnl*sizeof(float) );
+   t->sub = LEVEL_TABLE_SIZE / (maxnl-1);
+   size = t->sub * (maxnl-1);
+
+   for (k=0;k<=size;k++) {
+      float level, rlevel, hgt, p;
+      level = (float) k / (float) t->sub;
+      i = k / t->sub;
+      if (i>=maxnl-1) {
+         i = maxnl-2;
+      }
+      rlevel = level - i;
+      if (vertical<=VERT_EQUAL_KM) {
+         hgt = bottom + (top-bottom) * level / (float) (maxnl-1);
+      }
+      else {
+         hgt = height[i] * (1.0-rlevel) + height[i+1] * rlevel;
+      }
+      if (vertical==VERT_NONEQUAL_MB) {
+         p = height_to_pressure( hgt );
+         t->frac[k] = (p - pbot) / (ptop - pbot);
+      }
+      else {
+         p = logscale * exp( hgt / logexp );
+         t->frac[k] = (p - pbot) / (ptop - pbot);
+      }
+   }
+
+   LOCK_ON( TableLock );
+   t->older = *tp;
+   *tp = t;
+   LOCK_OFF( TableLock );
+   return t;
+}
+
+
+static void free_level_tables( level_table **tp )
+{
+   level_table *t, *older;
+
+   for (t = *tp; t; t = older) {
+      older = t->older;
+      free( t );
+   }
+   *tp = NULL;
+}
+
+
+static const level_table *ctx_level_table( Context ctx )
+{
+   return update_level_table( &ctx->LevTable, ctx->VerticalSystem,
+                              ctx->LogFlag, ctx->LogScale, ctx->LogExp,
+                              ctx->MaxNl, ctx->Height,
+                              ctx->BottomBound, ctx->TopBound,
+                              ctx->Pbot, ctx->Ptop );
+}
+
+
+static const level_table *dtx_level_table( Display_Context dtx )
+{
+   return update_level_table( &dtx->LevTable, dtx->VerticalSystem,
+                              dtx->LogFlag, dtx->LogScale, dtx->LogExp,
+                              dtx->MaxNl, dtx->Height,
+                              dtx->BottomBound, dtx->TopBound,
+                              dtx->Pbot, dtx->Ptop );
+}
+
+
+/*
+ * Allocate the lock for replacing lookup tables.  Called once at startup.
+ */
+void init_projection_tables( void )
+{
+   ALLOC_LOCK( TableLock );
+}
+
+
+/*
+ * Free the lookup tables of a context or display context, once no other
+ * thread can be using it.
+ */
+void free_ctx_projection_tables( Context ctx )
+{
+   free_vert_tables( &ctx->HgtTable );
+   free_level_tables( &ctx->LevTable );
+}
+
+
+void free_dtx_projection_tables( Display_Context dtx )
+{
+   free_vert_tables( &dtx->HgtTable );
+   free_level_tables( &dtx->LevTable );
+}
+
+
+
+/*
+ * Free the tables replaced since the last call, keeping the current
+ * ones.  Only call this while the worker threads are idle, i.e. after
+ * vis5d_finish_work(), since they may still be reading an older table.
+ */
+void trim_ctx_projection_tables( Context ctx )
+{
+   LOCK_ON( TableLock );
+   if (ctx->HgtTable) {
+      free_vert_tables( &ctx->HgtTable->older );
+   }
+   if (ctx->LevTable) {
+      free_level_tables( &ctx->LevTable->older );
+   }
+   LOCK_OFF( TableLock );
+}
+
+
+void trim_dtx_projection_tables( Display_Context dtx )
+{
+   LOCK_ON( TableLock );
+   if (dtx->HgtTable) {
+      free_vert_tables( &dtx->HgtTable->older );
+   }
+   if (dtx->LevTable) {
+      free_level_tables( &dtx->LevTable->older );
+   }
+   LOCK_OFF( TableLock );
+}
+
+
+/*
+ * Table driven gridlevel_to_z():  t is from ctx_level_table() or
+ * dtx_level_table() and must not be NULL.
+ */
+static float level_to_z( const level_table *t, float zmin, float zmax,
+                         float level )
+{
+   float s;
+   int k;
+
+   if (!(level>0.0)) {
+      return zmin;
+   }
+   else if (level>=t->maxnl-1) {
+      return zmax;
+   }
+   s = level * t->sub;
+   k = (int) s;
+   if (k>=t->sub*(t->maxnl-1)) {
+      k--;
+   }
+   s -= k;
+   return zmin + (zmax-zmin) * (t->frac[k] + s * (t->frac[k+1]-t->frac[k]));
+}
+
+
+/*
+ * gridlevel_to_z() and gridlevelPRIME_to_zPRIME() using the level table
+ * T when there is one.
+ */
+#define GRIDLEVEL_TO_Z( T, CTX, TIME, VAR, L )                            \
+   ((T) ? level_to_z( T, (CTX)->dpy_ctx->Zmin, (CTX)->dpy_ctx->Zmax, L )  \
+        : gridlevel_to_z( CTX, TIME, VAR, L ))
+
+#define GRIDLEVELPRIME_TO_ZPRIME( T, DTX, TIME, VAR, L )                  \
+   ((T) ? level_to_z( T, (DTX)->Zmin, (DTX)->Zmax, L )                    \
+        : gridlevelPRIME_to_zPRIME( DTX, TIME, VAR, L ))
+
+
 /*
  * Convert a z value to a height coordinate.
  */
@@ -1716,6 +2166,7 @@ void gridPRIME_to_xyzPRIME( Display_Context dtx, int time, int var, int n,
                   float x[], float y[], float z[] )
 {
    int i;
+   const level_table *lt = dtx_level_table( dtx );
 
    switch (dtx->Projection) {
       case PROJ_GENERIC:
@@ -1762,7 +2213,7 @@ void gridPRIME_to_xyzPRIME( Display_Context dtx, int time, int var, int n,
 		     else{
                      y[i] = dtx->Ymax - r[i] * ys;
 		     }
-                     z[i] = gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] );
+                     z[i] = GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] );
                   }
                }
                break;
@@ -1778,7 +2229,7 @@ void gridPRIME_to_xyzPRIME( Display_Context dtx, int time, int var, int n,
                lon = REVERSE_POLES*lon * DEG2RAD;
                x[i] = REVERSE_POLES*radius * cos(lon);
                y[i] = REVERSE_POLES* -radius * sin(lon);
-               z[i] = gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] );
+               z[i] = GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] );
             }
          }
          break;
@@ -1809,7 +2260,7 @@ void gridPRIME_to_xyzPRIME( Display_Context dtx, int time, int var, int n,
          for (i=0;i<n;i++) {
             x[i] = gridcolumnPRIME_to_xPRIME( dtx, time, var, c[i] );
             y[i] = gridrowPRIME_to_yPRIME( dtx, time, var, r[i] );
-            z[i] = gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] );
+            z[i] = GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] );
          }
          break;
       default:
@@ -1834,6 +2285,7 @@ void grid_to_xyz( Context ctx, int time, int var, int n,
                   float x[], float y[], float z[] )
 {
    int i;
+   const level_table *lt = ctx_level_table( ctx );
 
    switch (ctx->Projection) {
       case PROJ_GENERIC:
@@ -1887,7 +2339,7 @@ void grid_to_xyz( Context ctx, int time, int var, int n,
 		     else{
                      y[i] = ctx->dpy_ctx->Ymax - r[i] * ys;
 		     }
-                     z[i] = gridlevel_to_z( ctx, time, var, l[i] );
+                     z[i] = GRIDLEVEL_TO_Z( lt, ctx, time, var, l[i] );
                   }
                }
                break;
@@ -1903,7 +2355,7 @@ void grid_to_xyz( Context ctx, int time, int var, int n,
                lon = REVERSE_POLES*lon * DEG2RAD;
                x[i] = REVERSE_POLES*radius * cos(lon);
                y[i] = REVERSE_POLES*-radius * sin(lon);
-               z[i] = gridlevel_to_z( ctx, time, var, l[i] );
+               z[i] = GRIDLEVEL_TO_Z( lt, ctx, time, var, l[i] );
             }
          }
          break;
@@ -1956,6 +2408,7 @@ void grid_to_compXYZ( Context ctx, int time, int var, int n,
                       int_vert2 xyz[][3] )
 {
    int i;
+   const level_table *lt = ctx_level_table( ctx );
    float xx, yy, zz;
 
    switch (ctx->Projection) {
@@ -2029,7 +2482,7 @@ void grid_to_compXYZ( Context ctx, int time, int var, int n,
 		       yt = ctx->dpy_ctx->Ymax * VERTEX_SCALE;
                      yy = (yt - r[i] * ys);
 		     }
-                     zz = (gridlevel_to_z( ctx, time, var, l[i] ) * zs);
+                     zz = (GRIDLEVEL_TO_Z( lt, ctx, time, var, l[i] ) * zs);
                      if (xx > 32760.0) xx = 32760.0;
                      if (xx < -32760.0) xx = -32760.0;
                      if (yy > 32760.0) yy = 32760.0;
@@ -2057,7 +2510,7 @@ void grid_to_compXYZ( Context ctx, int time, int var, int n,
                lon = REVERSE_POLES* lon * DEG2RAD;
                cylx = REVERSE_POLES*radius * cos(lon);
                cyly = REVERSE_POLES*-radius * sin(lon);
-               cylz = gridlevel_to_z( ctx, time, var, l[i] );
+               cylz = GRIDLEVEL_TO_Z( lt, ctx, time, var, l[i] );
                xx = cylx * VERTEX_SCALE;
                yy = cyly * VERTEX_SCALE;
                zz = cylz * VERTEX_SCALE;
@@ -2140,6 +2593,7 @@ void gridPRIME_to_compXYZPRIMEcheck(Display_Context dtx, int time, int var, int
                       int_vert2 xyz[][3] )
 {
    int i;
+   const level_table *lt = dtx_level_table( dtx );
    int v;
    int n;
    float xx, yy, zz;
@@ -2223,7 +2677,7 @@ void gridPRIME_to_compXYZPRIMEcheck(Display_Context dtx, int time, int var, int
 		       yt = dtx->Ymax * VERTEX_SCALE;
                      yy = yt - r[i] * ys;
 		     }
-                     zz = gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] ) * zs;
+                     zz = GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] ) * zs;
                      if (xx > 32760.0) xx = 32760.0;                     
                      if (xx < -32760.0) xx = -32760.0;                     
                      if (yy > 32760.0) yy = 32760.0;                     
@@ -2249,7 +2703,7 @@ void gridPRIME_to_compXYZPRIMEcheck(Display_Context dtx, int time, int var, int
             }
             xx = gridcolumnPRIME_to_xPRIME( dtx, time, var, c[i] ) * VERTEX_SCALE;
             yy = gridrowPRIME_to_yPRIME( dtx, time, var, r[i] ) * VERTEX_SCALE;
-            zz = gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] ) * VERTEX_SCALE;
+            zz = GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] ) * VERTEX_SCALE;
             if (xx > 32760.0) xx = 32760.0;
             if (xx < -32760.0) xx = -32760.0;
             if (yy > 32760.0) yy = 32760.0;
@@ -2275,7 +2729,7 @@ void gridPRIME_to_compXYZPRIMEcheck(Display_Context dtx, int time, int var, int
                lon = REVERSE_POLES*lon * DEG2RAD;
                cylx = REVERSE_POLES*radius * cos(lon);
                cyly = REVERSE_POLES*-radius * sin(lon);
-               cylz = gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] );
+               cylz = GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] );
                if(c[i] < 0 || c[i] > dtx->Nc-1 ||
                   r[i] < 0 || r[i] > dtx->Nr-1 ||
                   l[i] < 0 || l[i] > dtx->Nl-1){
@@ -2349,6 +2803,7 @@ void gridPRIME_to_compXYZPRIME( Display_Context dtx, int time, int var, int n,
                       int_vert2 xyz[][3] )
 {
    int i;
+   const level_table *lt = dtx_level_table( dtx );
    /* WLH 6 Oct 98 */
    float xx, yy, zz;
 
@@ -2426,7 +2881,7 @@ void gridPRIME_to_compXYZPRIME( Display_Context dtx, int time, int var, int n,
 		       yt = dtx->Ymax * VERTEX_SCALE;
                      yy = (yt - r[i] * ys);
 		     }
-                     zz = (gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] ) * zs);
+                     zz = (GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] ) * zs);
                      if (xx > 32760.0) xx = 32760.0;
                      if (xx < -32760.0) xx = -32760.0;
                      if (yy > 32760.0) yy = 32760.0;
@@ -2441,7 +2896,7 @@ void gridPRIME_to_compXYZPRIME( Display_Context dtx, int time, int var, int n,
                      xyz[i][0] = (int_vert2) (xt + c[i] * xs);
                      xyz[i][1] = (int_vert2) (yt - r[i] * ys);
                      xyz[i][2] = (int_vert2)
-                                (gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] ) * zs);
+                                (GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] ) * zs);
 */
                   }
                }
@@ -2453,7 +2908,7 @@ void gridPRIME_to_compXYZPRIME( Display_Context dtx, int time, int var, int n,
          for (i=0;i<n;i++) {
             xx = gridcolumnPRIME_to_xPRIME( dtx, time, var, c[i] ) * VERTEX_SCALE;
             yy = gridrowPRIME_to_yPRIME( dtx, time, var, r[i] ) * VERTEX_SCALE;
-            zz = gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] ) * VERTEX_SCALE;
+            zz = GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] ) * VERTEX_SCALE;
             if (xx > 32760.0) xx = 32760.0;
             if (xx < -32760.0) xx = -32760.0;
             if (yy > 32760.0) yy = 32760.0;
@@ -2478,7 +2933,7 @@ void gridPRIME_to_compXYZPRIME( Display_Context dtx, int time, int var, int n,
                lon = REVERSE_POLES*lon * DEG2RAD;
                cylx = REVERSE_POLES*radius * cos(lon);
                cyly = REVERSE_POLES*-radius * sin(lon);
-               cylz = gridlevelPRIME_to_zPRIME( dtx, time, var, l[i] );
+               cylz = GRIDLEVELPRIME_TO_ZPRIME( lt, dtx, time, var, l[i] );
                xx = cylx * VERTEX_SCALE;
                yy = cyly * VERTEX_SCALE;
                zz = cylz * VERTEX_SCALE;
@@ -2545,326 +3000,258 @@ void gridPRIME_to_compXYZPRIME( Display_Context dtx, int time, int var, int n,
 
 
 /*
- * Transform an array of (lat,lon,hgt) coordinates to (x,y,z) graphics
- * coodinates.
- * Input:  ctx - the vis5d context
- *         time - which timestep
- *         var - which variable
- *         n - number of coordinates
- *         lat - latitude in degrees
- *         lon - longitude in degrees
- *         hgt - height in current vertical units
- * Output:  x, y, z - graphics coordinates.
+ * Constants of the (lat,lon) to (x,y) transformation, gathered once per
+ * call from a vis5d or display context so the loops in geo_to_xy()
+ * are plain float arithmetic.
  */
-void geo_to_xyz( Context ctx, int time, int var, int n,
-                 float lat[], float lon[], float hgt[],
-                 float x[], float y[], float z[] )
+typedef struct {
+   int projection;
+   float xmin, xscale;          /* x = xmin + col * xscale */
+   float ymin, ybase, yscale;   /* y = ybase + row * yscale */
+   float west, south;           /* LINEAR, ROTATED */
+   float lonc, latc, rotation;  /* central longitude etc */
+   float row0, col0;            /* row/column offsets */
+   float kx, ky;                /* MERCATOR:  km scaling, LAMBERT: cone */
+   float conefactor, hemisphere;
+   float sinclat, cosclat, stereoscale;
+   float cylscale;
+   float bottom, top;           /* SPHERICAL */
+} geo_consts;
+
+
+/*
+ * Fill in a geo_consts.  P holds the projection parameters (a vis5d or
+ * display context) and D the display context with the graphics bounds.
+ */
+#define GET_GEO_CONSTS( G, P, D )                                        \
+{                                                                        \
+   (G).projection = (P)->Projection;                                     \
+   (G).xmin = (D)->Xmin;                                                 \
+   (G).ymin = (D)->Ymin;                                                 \
+   (G).xscale = ((D)->Xmax-(D)->Xmin) / (float) ((P)->Nc-1);             \
+   (G).yscale = ((D)->Ymax-(D)->Ymin) / (float) ((P)->Nr-1);             \
+   if (COORDHAND==COORDRIGHTHAND) {                                      \
+      (G).ybase = (D)->Ymin;                                             \
+   }                                                                     \
+   else {                                                                \
+      (G).ybase = (D)->Ymax;                                             \
+      (G).yscale = -(G).yscale;                                          \
+   }                                                                     \
+   switch ((P)->Projection) {                                            \
+      case PROJ_GENERIC:                                                 \
+      case PROJ_LINEAR:                                                  \
+      case PROJ_ROTATED:                                                 \
+         (G).xscale = ((D)->Xmax-(D)->Xmin)                              \
+                      / ((P)->EastBound-(P)->WestBound);                 \
+         (G).yscale = ((D)->Ymax-(D)->Ymin)                              \
+                      / ((P)->NorthBound-(P)->SouthBound);               \
+         (G).west = (P)->WestBound;                                      \
+         (G).south = (P)->SouthBound;                                    \
+         (G).latc = (P)->CentralLat;                                     \
+         (G).lonc = (P)->CentralLon;                                     \
+         (G).rotation = (P)->Rotation;                                   \
+         break;                                                          \
+      case PROJ_MERCATOR:                                                \
+         (G).kx = RADIUS * DEG2RAD / (P)->ColIncKm;                      \
+         (G).ky = RADIUS / (P)->RowIncKm;                                \
+         (G).lonc = (P)->CentralLon;                                     \
+         (G).col0 = ((P)->Nc-1) / 2.0;                                   \
+         (G).row0 = ((P)->Nr-1) / 2.0 + (G).ky *                         \
+             log((1.0 + sin(DEG2RAD*(P)->CentralLat))                    \
+                 / cos(DEG2RAD*(P)->CentralLat));                        \
+         break;                                                          \
+      case PROJ_LAMBERT:                                                 \
+         (G).lonc = (P)->CentralLon;                                     \
+         (G).kx = (P)->Cone * DEG2RAD;                                   \
+         (G).ky = (P)->Cone;                                             \
+         (G).conefactor = (P)->ConeFactor;                               \
+         (G).hemisphere = (P)->Hemisphere;                               \
+         (G).row0 = (P)->PoleRow;                                        \
+         (G).col0 = (P)->PoleCol;                                        \
+         break;                                                          \
+      case PROJ_STEREO:                                                  \
+         (G).lonc = (P)->CentralLon;                                     \
+         (G).sinclat = (P)->SinCentralLat;                               \
+         (G).cosclat = (P)->CosCentralLat;                               \
+         (G).stereoscale = (P)->StereoScale;                             \
+         (G).row0 = (P)->CentralRow-1;                                   \
+         (G).col0 = (P)->CentralCol-1;                                   \
+         break;                                                          \
+      case PROJ_CYLINDRICAL:                                             \
+         (G).cylscale = (P)->CylinderScale;                              \
+         break;                                                          \
+      case PROJ_SPHERICAL:                                               \
+         (G).bottom = (P)->BottomBound;                                  \
+         (G).top = (P)->TopBound;                                        \
+         break;                                                          \
+   }                                                                     \
+}
+
+
+/*
+ * Transform arrays of (lat,lon) to (x,y) graphics coordinates.  For
+ * PROJ_SPHERICAL z is computed from hgt too.  Every point only reads
+ * its own inputs before writing its outputs, so the output arrays may
+ * be the input arrays.
+ * Return:  1 = z was set too, 0 = z still to be done, -1 = bad projection
+ */
+static int geo_to_xy( const geo_consts *g, int n,
+                      const float lat[], const float lon[], const float hgt[],
+                      float x[], float y[], float z[] )
 {
-   float xscale, yscale;
+   float xmin = g->xmin, xscale = g->xscale;
+   float ybase = g->ybase, yscale = g->yscale;
    int i;
 
-   switch (ctx->Projection) {
+   switch (g->projection) {
       case PROJ_GENERIC:
       case PROJ_LINEAR:
-         xscale = (ctx->dpy_ctx->Xmax-ctx->dpy_ctx->Xmin) / (ctx->EastBound-ctx->WestBound);
-         yscale = (ctx->dpy_ctx->Ymax-ctx->dpy_ctx->Ymin) / (ctx->NorthBound-ctx->SouthBound);
          for (i=0;i<n;i++) {
-            x[i] = ctx->dpy_ctx->Xmin + (lon[i]-ctx->WestBound) * xscale;
-            y[i] = ctx->dpy_ctx->Ymin + (lat[i]-ctx->SouthBound) * yscale;
-            z[i] = height_to_z( ctx, hgt[i] );
+            float xx = xmin + (lon[i]-g->west) * xscale;
+            float yy = g->ymin + (lat[i]-g->south) * yscale;
+            x[i] = xx;
+            y[i] = yy;
          }
-         break;
+         return 0;
       case PROJ_MERCATOR:
          {
-            float row, col, X, Y, ic, jc, YC;
-            ic = (ctx->Nr-1)/2.0;
-            jc = (ctx->Nc-1) / 2.0;
-            YC = RADIUS * log((1.0 + sin(DEG2RAD*ctx->CentralLat))/cos(DEG2RAD*ctx->CentralLat));
-            xscale = (ctx->dpy_ctx->Xmax-ctx->dpy_ctx->Xmin) / (float) (ctx->Nc-1);
-            yscale = (ctx->dpy_ctx->Ymax-ctx->dpy_ctx->Ymin) / (float) (ctx->Nr-1);
+            float kx = g->kx, ky = g->ky, lonc = g->lonc;
+            float row0 = g->row0, col0 = g->col0;
             for (i=0;i<n;i++) {
-               X = RADIUS * (lon[i]-ctx->CentralLon) / RAD2DEG;
-               Y = RADIUS * log( (1+sin(DEG2RAD*lat[i]))/cos(DEG2RAD*lat[i]) );
-               row = ic - (Y - YC)/ctx->RowIncKm;
-               col = jc -  X/ctx->ColIncKm;
-               x[i] = ctx->dpy_ctx->Xmin + col * xscale;
-	       // JCM:
-	       if(COORDHAND==COORDRIGHTHAND){
-		 y[i] = ctx->dpy_ctx->Ymin + row * yscale;
-	       }
-	       else{
-               y[i] = ctx->dpy_ctx->Ymax - row * yscale;
-	       }
-               z[i] = height_to_z( ctx, hgt[i] );
+               float rlat = (float) DEG2RAD * lat[i];
+               float row = row0 - ky * FLOG( (1.0f+FSIN(rlat)) / FCOS(rlat) );
+               float col = col0 - (lon[i]-lonc) * kx;
+               x[i] = xmin + col * xscale;
+               y[i] = ybase + row * yscale;
             }
          }
-         break;
+         return 0;
       case PROJ_LAMBERT:
-         xscale = (ctx->dpy_ctx->Xmax-ctx->dpy_ctx->Xmin) / (float) (ctx->Nc-1);
-         yscale = (ctx->dpy_ctx->Ymax-ctx->dpy_ctx->Ymin) / (float) (ctx->Nr-1);
-         for (i=0;i<n;i++) {
-            float rlon, rlat, r, row, col;
-            rlon = lon[i] - ctx->CentralLon;
-/*            if (rlon > 180.0)  rlon -= 360.0;*/
-            rlon = rlon * ctx->Cone * DEG2RAD;
-
-            if (lat[i]<-85.0) {
-               /* infinity */
-               r = 10000.0;
-            }
-            else {
-               rlat = (90.0 - ctx->Hemisphere * lat[i]) * DEG2RAD * 0.5;
-               r = ctx->ConeFactor * pow( tan(rlat), ctx->Cone );
+         {
+            float kx = g->kx, cone = g->ky, lonc = g->lonc;
+            float conefactor = g->conefactor, hemi = g->hemisphere;
+            float row0 = g->row0, col0 = g->col0;
+            for (i=0;i<n;i++) {
+               float rlon, rlat, r, row, col;
+               rlon = (lon[i] - lonc) * kx;
+               if (lat[i]<-85.0f) {
+                  /* infinity */
+                  r = 10000.0f;
+               }
+               else {
+                  rlat = (90.0f - hemi * lat[i]) * (float) (DEG2RAD * 0.5);
+                  r = conefactor * FPOW( FTAN(rlat), cone );
+               }
+               row = row0 + r * FCOS(rlon);
+               col = col0 - r * FSIN(rlon);
+               x[i] = xmin + col * xscale;
+               y[i] = ybase + row * yscale;
             }
-            row = ctx->PoleRow + r * cos(rlon);
-            col = ctx->PoleCol - r * sin(rlon);
-            x[i] = ctx->dpy_ctx->Xmin + col * xscale;
-	    // JCM:
-	    if(COORDHAND==COORDRIGHTHAND){
-	      y[i] = ctx->dpy_ctx->Ymin + row * yscale;
-	    }
-	    else{
-            y[i] = ctx->dpy_ctx->Ymax - row * yscale;
-	    }
-            z[i] = height_to_z( ctx, hgt[i] );
          }
-         break;
+         return 0;
       case PROJ_STEREO:
-         xscale = (ctx->dpy_ctx->Xmax-ctx->dpy_ctx->Xmin) / (float) (ctx->Nc-1);
-         yscale = (ctx->dpy_ctx->Ymax-ctx->dpy_ctx->Ymin) / (float) (ctx->Nr-1);
-         for (i=0;i<n;i++) {
-            float rlat, rlon, clon, clat, k, col, row;
-            rlat = DEG2RAD * lat[i];
-            rlon = DEG2RAD * (ctx->CentralLon - lon[i]);
-            clon = cos(rlon);
-            clat = cos(rlat);
-            k = ctx->StereoScale
-                / (1.0 + ctx->SinCentralLat*sin(rlat)
-                       + ctx->CosCentralLat*clat*clon);
-            col = (ctx->CentralCol-1) + k * clat * sin(rlon);
-/* pre-friday:
-            row = ctx->Nr - ctx->CentralRow
-               - k * (ctx->CosCentralLat * sin(rlat)
-                      - ctx->SinCentralLat * clat * clon);
-*/
-            row = (ctx->CentralRow-1)
-               - k * (ctx->CosCentralLat * sin(rlat)
-                      - ctx->SinCentralLat * clat * clon);
-
-
-/*
-            if (col<0.0)  col = 0.0;
-            if (col>(ctx->Nc-1))  col = ctx->Nc-1;
-            if (row<0.0)  row = 0.0;
-            if (row>(ctx->Nr-1))  row = ctx->Nr-1;
-*/
-            x[i] = ctx->dpy_ctx->Xmin + col * xscale;
-	    // JCM:
-	    if(COORDHAND==COORDRIGHTHAND){
-	      y[i] = ctx->dpy_ctx->Ymin + row * yscale;
-	    }
-	    else{
-            y[i] = ctx->dpy_ctx->Ymax - row * yscale;
-	    }
-            z[i] = height_to_z( ctx, hgt[i] );
+         {
+            float lonc = g->lonc, scale = g->stereoscale;
+            float sinclat = g->sinclat, cosclat = g->cosclat;
+            float row0 = g->row0, col0 = g->col0;
+            for (i=0;i<n;i++) {
+               float rlat, rlon, slat, clat, clon, k, row, col;
+               rlat = (float) DEG2RAD * lat[i];
+               rlon = (float) DEG2RAD * (lonc - lon[i]);
+               slat = FSIN(rlat);
+               clat = FCOS(rlat);
+               clon = FCOS(rlon);
+               k = scale / (1.0f + sinclat*slat + cosclat*clat*clon);
+               col = col0 + k * clat * FSIN(rlon);
+               row = row0 - k * (cosclat*slat - sinclat*clat*clon);
+               x[i] = xmin + col * xscale;
+               y[i] = ybase + row * yscale;
+            }
          }
-         break;
+         return 0;
       case PROJ_ROTATED:
-         xscale = (ctx->dpy_ctx->Xmax-ctx->dpy_ctx->Xmin) / (ctx->EastBound-ctx->WestBound);
-         yscale = (ctx->dpy_ctx->Ymax-ctx->dpy_ctx->Ymin) / (ctx->NorthBound-ctx->SouthBound);
          for (i=0;i<n;i++) {
             float lat0, lon0;
             lat0 = lat[i];
             lon0 = lon[i];
-            pandg_for(&lat0, &lon0, ctx->CentralLat, ctx->CentralLon,
-                      ctx->Rotation);
-            x[i] = ctx->dpy_ctx->Xmin + (lon0-ctx->WestBound) * xscale;
-            y[i] = ctx->dpy_ctx->Ymin + (lat0-ctx->SouthBound) * yscale;
-            z[i] = height_to_z( ctx, hgt[i] );
+            pandg_for( &lat0, &lon0, g->latc, g->lonc, g->rotation );
+            x[i] = xmin + (lon0-g->west) * xscale;
+            y[i] = g->ymin + (lat0-g->south) * yscale;
          }
-         break;
+         return 0;
       case PROJ_CYLINDRICAL:
          for (i=0;i<n;i++) {
             float longitude, radius;
-            radius = (REVERSE_POLES*90.0 - lat[i]) * ctx->CylinderScale;
-            longitude = REVERSE_POLES*lon[i] * DEG2RAD;
-            x[i] = REVERSE_POLES*radius * cos(longitude);
-            y[i] = REVERSE_POLES*-radius * sin(longitude);
-            z[i] = height_to_z( ctx, hgt[i] );
+            radius = (REVERSE_POLES*90.0f - lat[i]) * g->cylscale;
+            longitude = REVERSE_POLES*lon[i] * (float) DEG2RAD;
+            x[i] = REVERSE_POLES*radius * FCOS(longitude);
+            y[i] = REVERSE_POLES*-radius * FSIN(longitude);
          }
-         break;
+         return 0;
       case PROJ_SPHERICAL:
-         for (i=0;i<n;i++) {
-            float clat, clon, slat, slon, d;
-            clat = cos(lat[i] * DEG2RAD);
-            clon = cos(lon[i] * DEG2RAD);
-            slat = sin(lat[i] * DEG2RAD);
-            slon = sin(lon[i] * DEG2RAD);
-            d = (hgt[i]-ctx->BottomBound)
-               / (ctx->TopBound-ctx->BottomBound) * SPHERE_SCALE + SPHERE_SIZE;
-            x[i] = d * clat * clon;
-            y[i] = -d * clat * slon;
-            z[i] = d * slat;
+         {
+            float dscale = SPHERE_SCALE / (g->top-g->bottom);
+            for (i=0;i<n;i++) {
+               float rlat, rlon, clat, d;
+               rlat = lat[i] * (float) DEG2RAD;
+               rlon = lon[i] * (float) DEG2RAD;
+               d = (hgt[i]-g->bottom) * dscale + SPHERE_SIZE;
+               clat = FCOS(rlat);
+               z[i] = d * FSIN(rlat);
+               x[i] = d * clat * FCOS(rlon);
+               y[i] = -d * clat * FSIN(rlon);
+            }
          }
-         break;
+         return 1;
       default:
-         printf("Error in geo_to_xyz\n");
+         return -1;
    }
 }
 
-void geo_to_xyzPRIME( Display_Context dtx, int time, int var, int n,
+
+/*
+ * Transform an array of (lat,lon,hgt) coordinates to (x,y,z) graphics
+ * coodinates.
+ * Input:  ctx - the vis5d context
+ *         time - which timestep
+ *         var - which variable
+ *         n - number of coordinates
+ *         lat - latitude in degrees
+ *         lon - longitude in degrees
+ *         hgt - height in current vertical units
+ * Output:  x, y, z - graphics coordinates.
+ */
+void geo_to_xyz( Context ctx, int time, int var, int n,
                  float lat[], float lon[], float hgt[],
                  float x[], float y[], float z[] )
 {
-   float xscale, yscale;
-   int i;
-
-   switch (dtx->Projection) {
-      case PROJ_GENERIC:
-      case PROJ_LINEAR:
-         xscale = (dtx->Xmax-dtx->Xmin) / (dtx->EastBound-dtx->WestBound);
-         yscale = (dtx->Ymax-dtx->Ymin) / (dtx->NorthBound-dtx->SouthBound);
-         for (i=0;i<n;i++) {
-            x[i] = dtx->Xmin + (lon[i]-dtx->WestBound) * xscale;
-            y[i] = dtx->Ymin + (lat[i]-dtx->SouthBound) * yscale;
-            z[i] = height_to_zPRIME( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_MERCATOR:
-         {
-            float row, col, X, Y, ic, jc, YC;
-            ic = (dtx->Nr-1)/2.0;
-            jc = (dtx->Nc-1) / 2.0;
-            YC = RADIUS * log((1.0 + sin(DEG2RAD*dtx->CentralLat))/cos(DEG2RAD*dtx->CentralLat));
-            xscale = (dtx->Xmax-dtx->Xmin) / (float) (dtx->Nc-1);
-            yscale = (dtx->Ymax-dtx->Ymin) / (float) (dtx->Nr-1);
-            for (i=0;i<n;i++) {
-               X = RADIUS * (lon[i]-dtx->CentralLon) / RAD2DEG;
-               Y = RADIUS * log( (1+sin(DEG2RAD*lat[i]))/cos(DEG2RAD*lat[i]) );
-               row = ic - (Y - YC)/dtx->RowIncKm;
-               col = jc -  X/dtx->ColIncKm;
-               x[i] = dtx->Xmin + col * xscale;
-	       // JCM:
-	       if(COORDHAND==COORDRIGHTHAND){
-		 y[i] = dtx->Ymin + row * yscale;
-	       }
-	       else{
-               y[i] = dtx->Ymax - row * yscale;
-	       }
-               z[i] = height_to_zPRIME( dtx, hgt[i] );
-            }
-         }
-         break;
-      case PROJ_LAMBERT:
-         xscale = (dtx->Xmax-dtx->Xmin) / (float) (dtx->Nc-1);
-         yscale = (dtx->Ymax-dtx->Ymin) / (float) (dtx->Nr-1);
-         for (i=0;i<n;i++) {
-            float rlon, rlat, r, row, col;
-            rlon = lon[i] - dtx->CentralLon;
-/*            if (rlon > 180.0)  rlon -= 360.0;*/
-            rlon = rlon * dtx->Cone * DEG2RAD;
+   geo_consts g;
+   int done;
 
-            if (lat[i]<-85.0) {
-               /* infinity */
-               r = 10000.0;
-            }
-            else {
-               rlat = (90.0 - dtx->Hemisphere * lat[i]) * DEG2RAD * 0.5;
-               r = dtx->ConeFactor * pow( tan(rlat), dtx->Cone );
-            }
-            row = dtx->PoleRow + r * cos(rlon);
-            col = dtx->PoleCol - r * sin(rlon);
-            x[i] = dtx->Xmin + col * xscale;
-	    // JCM:
-	    if(COORDHAND==COORDRIGHTHAND){
-	      y[i] = dtx->Ymin + row * yscale;
-	    }
-	    else{
-            y[i] = dtx->Ymax - row * yscale;
-	    }
-            z[i] = height_to_zPRIME( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_STEREO:
-         xscale = (dtx->Xmax-dtx->Xmin) / (float) (dtx->Nc-1);
-         yscale = (dtx->Ymax-dtx->Ymin) / (float) (dtx->Nr-1);
-         for (i=0;i<n;i++) {
-            float rlat, rlon, clon, clat, k, col, row;
-            rlat = DEG2RAD * lat[i];
-            rlon = DEG2RAD * (dtx->CentralLon - lon[i]);
-            clon = cos(rlon);
-            clat = cos(rlat);
-            k = dtx->StereoScale
-                / (1.0 + dtx->SinCentralLat*sin(rlat)
-                       + dtx->CosCentralLat*clat*clon);
-            col = (dtx->CentralCol-1) + k * clat * sin(rlon);
-/* pre-friday:
-            row = dtx->Nr - dtx->CentralRow
-               - k * (dtx->CosCentralLat * sin(rlat)
-                      - dtx->SinCentralLat * clat * clon);
-*/
-            row = (dtx->CentralRow-1)
-               - k * (dtx->CosCentralLat * sin(rlat)
-                      - dtx->SinCentralLat * clat * clon);
+   GET_GEO_CONSTS( g, ctx, ctx->dpy_ctx );
+   done = geo_to_xy( &g, n, lat, lon, hgt, x, y, z );
+   if (done<0) {
+      printf("Error in geo_to_xyz\n");
+   }
+   else if (!done) {
+      heights_to_z( ctx, n, hgt, z );
+   }
+}
 
+void geo_to_xyzPRIME( Display_Context dtx, int time, int var, int n,
+                 float lat[], float lon[], float hgt[],
+                 float x[], float y[], float z[] )
+{
+   geo_consts g;
+   int done;
 
-/*
-            if (col<0.0)  col = 0.0;
-            if (col>(dtx->Nc-1))  col = dtx->Nc-1;
-            if (row<0.0)  row = 0.0;
-            if (row>(dtx->Nr-1))  row = dtx->Nr-1;
-*/
-            x[i] = dtx->Xmin + col * xscale;
-	    // JCM:
-	    if(COORDHAND==COORDRIGHTHAND){
-	      y[i] = dtx->Ymin + row * yscale;
-	    }
-	    else{
-            y[i] = dtx->Ymax - row * yscale;
-	    }
-            z[i] = height_to_zPRIME( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_ROTATED:
-         xscale = (dtx->Xmax-dtx->Xmin) / (dtx->EastBound-dtx->WestBound);
-         yscale = (dtx->Ymax-dtx->Ymin) / (dtx->NorthBound-dtx->SouthBound);
-         for (i=0;i<n;i++) {
-            float lat0, lon0;
-            lat0 = lat[i];
-            lon0 = lon[i];
-            pandg_for(&lat0, &lon0, dtx->CentralLat, dtx->CentralLon,
-                      dtx->Rotation);
-            x[i] = dtx->Xmin + (lon0-dtx->WestBound) * xscale;
-            y[i] = dtx->Ymin + (lat0-dtx->SouthBound) * yscale;
-            z[i] = height_to_zPRIME( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_CYLINDRICAL:
-         for (i=0;i<n;i++) {
-            float longitude, radius;
-            radius = (REVERSE_POLES*90.0 - lat[i]) * dtx->CylinderScale;
-            longitude = REVERSE_POLES*lon[i] * DEG2RAD;
-            x[i] = REVERSE_POLES*radius * cos(longitude);
-            y[i] = REVERSE_POLES*-radius * sin(longitude);
-            z[i] = height_to_zPRIME( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_SPHERICAL:
-         for (i=0;i<n;i++) {
-            float clat, clon, slat, slon, d;
-            clat = cos(lat[i] * DEG2RAD);
-            clon = cos(lon[i] * DEG2RAD);
-            slat = sin(lat[i] * DEG2RAD);
-            slon = sin(lon[i] * DEG2RAD);
-            d = (hgt[i]-dtx->BottomBound)
-               / (dtx->TopBound-dtx->BottomBound) * SPHERE_SCALE + SPHERE_SIZE;
-            x[i] = d * clat * clon;
-            y[i] = -d * clat * slon;
-            z[i] = d * slat;
-         }
-         break;
-      default:
-         printf("Error in geo_to_xyzPRIME\n");
+   GET_GEO_CONSTS( g, dtx, dtx );
+   done = geo_to_xy( &g, n, lat, lon, hgt, x, y, z );
+   if (done<0) {
+      printf("Error in geo_to_xyzPRIME\n");
+   }
+   else if (!done) {
+      heights_to_zPRIME( dtx, 0, n, hgt, z );
    }
 }
 
@@ -2873,160 +3260,19 @@ void geo_to_xyzTOPO( Display_Context dtx, int time, int var, int n,
                  float lat[], float lon[], float hgt[],
                  float x[], float y[], float z[] )
 {
-   float xscale, yscale;
-   int i;
-
-   switch (dtx->Projection) {
-      case PROJ_GENERIC:
-      case PROJ_LINEAR:
-         xscale = (dtx->Xmax-dtx->Xmin) / (dtx->EastBound-dtx->WestBound);
-         yscale = (dtx->Ymax-dtx->Ymin) / (dtx->NorthBound-dtx->SouthBound);
-         for (i=0;i<n;i++) {
-            x[i] = dtx->Xmin + (lon[i]-dtx->WestBound) * xscale;
-            y[i] = dtx->Ymin + (lat[i]-dtx->SouthBound) * yscale;
-            z[i] = height_to_zTOPO( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_MERCATOR:
-         {
-            float row, col, X, Y, ic, jc, YC;
-            ic = (dtx->Nr-1) / 2.0;
-            jc = (dtx->Nc-1) / 2.0;
-            YC = RADIUS * log((1.0 + sin(DEG2RAD*dtx->CentralLat))/cos(DEG2RAD*dtx->CentralLat));
-            xscale = (dtx->Xmax-dtx->Xmin) / (float) (dtx->Nc-1);
-            yscale = (dtx->Ymax-dtx->Ymin) / (float) (dtx->Nr-1);
-            for (i=0;i<n;i++) {
-               X = RADIUS * (lon[i]-dtx->CentralLon) / RAD2DEG;
-               Y = RADIUS * log( (1+sin(lat[i]*DEG2RAD))/cos(lat[i]*DEG2RAD) );
-               row = ic - (Y - YC)/dtx->RowIncKm;
-               col = jc - X/dtx->ColIncKm;
-               x[i] = dtx->Xmin + col * xscale;
-	       // JCM:
-	       if(COORDHAND==COORDRIGHTHAND){
-		 y[i] = dtx->Ymin + row * yscale;
-	       }
-	       else{
-               y[i] = dtx->Ymax - row * yscale;
-	       }
-               z[i] = height_to_zTOPO( dtx, hgt[i] );
-            }
-         }
-         break;
-      case PROJ_LAMBERT:
-         xscale = (dtx->Xmax-dtx->Xmin) / (float) (dtx->Nc-1);
-         yscale = (dtx->Ymax-dtx->Ymin) / (float) (dtx->Nr-1);
-         for (i=0;i<n;i++) {
-            float rlon, rlat, r, row, col;
-            rlon = lon[i] - dtx->CentralLon;
-/*            if (rlon > 180.0)  rlon -= 360.0;*/
-            rlon = rlon * dtx->Cone * DEG2RAD;
-
-            if (lat[i]<-85.0) {
-               /* infinity */
-               r = 10000.0;
-            }
-            else {
-               rlat = (90.0 - dtx->Hemisphere * lat[i]) * DEG2RAD * 0.5;
-               r = dtx->ConeFactor * pow( tan(rlat), dtx->Cone );
-            }
-            row = dtx->PoleRow + r * cos(rlon);
-            col = dtx->PoleCol - r * sin(rlon);
-            x[i] = dtx->Xmin + col * xscale;
-	    // JCM:
-	    if(COORDHAND==COORDRIGHTHAND){
-	      y[i] = dtx->Ymin + row * yscale;
-	    }
-	    else{
-            y[i] = dtx->Ymax - row * yscale;
-	    }
-            z[i] = height_to_zTOPO( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_STEREO:
-         xscale = (dtx->Xmax-dtx->Xmin) / (float) (dtx->Nc-1);
-         yscale = (dtx->Ymax-dtx->Ymin) / (float) (dtx->Nr-1);
-         for (i=0;i<n;i++) {
-            float rlat, rlon, clon, clat, k, col, row;
-            rlat = DEG2RAD * lat[i];
-            rlon = DEG2RAD * (dtx->CentralLon - lon[i]);
-            clon = cos(rlon);
-            clat = cos(rlat);
-            k = dtx->StereoScale
-                / (1.0 + dtx->SinCentralLat*sin(rlat)
-                       + dtx->CosCentralLat*clat*clon);
-            col = (dtx->CentralCol-1) + k * clat * sin(rlon);
-/* pre-friday:
-            row = dtx->Nr - dtx->CentralRow
-               - k * (dtx->CosCentralLat * sin(rlat)
-                      - dtx->SinCentralLat * clat * clon);
-*/
-            row = (dtx->CentralRow-1)
-               - k * (dtx->CosCentralLat * sin(rlat)
-                      - dtx->SinCentralLat * clat * clon);
-
-
-/*
-            if (col<0.0)  col = 0.0;
-            if (col>(dtx->Nc-1))  col = dtx->Nc-1;
-            if (row<0.0)  row = 0.0;
-            if (row>(dtx->Nr-1))  row = dtx->Nr-1;
-*/
-            x[i] = dtx->Xmin + col * xscale;
-	    // JCM:
-	    if(COORDHAND==COORDRIGHTHAND){
-	      y[i] = dtx->Ymin + row * yscale;
-	    }
-	    else{
-            y[i] = dtx->Ymax - row * yscale;
-	    }
-            z[i] = height_to_zTOPO( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_ROTATED:
-         xscale = (dtx->Xmax-dtx->Xmin) / (dtx->EastBound-dtx->WestBound);
-         yscale = (dtx->Ymax-dtx->Ymin) / (dtx->NorthBound-dtx->SouthBound);
-         for (i=0;i<n;i++) {
-            float lat0, lon0;
-            lat0 = lat[i];
-            lon0 = lon[i];
-            pandg_for(&lat0, &lon0, dtx->CentralLat, dtx->CentralLon,
-                      dtx->Rotation);
-            x[i] = dtx->Xmin + (lon0-dtx->WestBound) * xscale;
-            y[i] = dtx->Ymin + (lat0-dtx->SouthBound) * yscale;
-            z[i] = height_to_zTOPO( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_CYLINDRICAL:
-         for (i=0;i<n;i++) {
-            float longitude, radius;
-            radius = (REVERSE_POLES*90.0 - lat[i]) * dtx->CylinderScale;
-            longitude = REVERSE_POLES*lon[i] * DEG2RAD;
-            x[i] = REVERSE_POLES*radius * cos(longitude);
-            y[i] = REVERSE_POLES*-radius * sin(longitude);
-            z[i] = height_to_zTOPO( dtx, hgt[i] );
-         }
-         break;
-      case PROJ_SPHERICAL:
-         for (i=0;i<n;i++) {
-            float clat, clon, slat, slon, d;
-            clat = cos(lat[i] * DEG2RAD);
-            clon = cos(lon[i] * DEG2RAD);
-            slat = sin(lat[i] * DEG2RAD);
-            slon = sin(lon[i] * DEG2RAD);
-            d = (hgt[i]-dtx->BottomBound)
-               / (dtx->TopBound-dtx->BottomBound) * SPHERE_SCALE + SPHERE_SIZE;
-            x[i] = d * clat * clon;
-            y[i] = -d * clat * slon;
-            z[i] = d * slat;
-         }
-         break;
-      default:
-	 	{
-			static int msg_issued = 0;
-			if ( !msg_issued )
+   geo_consts g;
+   int done;
+
+   GET_GEO_CONSTS( g, dtx, dtx );
+   done = geo_to_xy( &g, n, lat, lon, hgt, x, y, z );
+   if (done<0) {
+      static int msg_issued = 0;
+      if ( !msg_issued )
          printf("Error in geo_to_xyzTOPO\n");
-			msg_issued = 1;
-		}
+      msg_issued = 1;
+   }
+   else if (!done) {
+      heights_to_zPRIME( dtx, 1, n, hgt, z );
    }
 }
 /*MJK 2.17.99 end */
@@ -3320,6 +3566,75 @@ void xyzPRIME_to_gridPRIME( Display_Context dtx, int time, int var,
 }
 
 
+
+/*
+ * Convert an array of (x,y,z) display graphics coordinates to (r,c,l)
+ * display grid coordinates, like xyzPRIME_to_gridPRIME() on each point.
+ * The common projections are done in loops without calls per point.
+ * Input:  dtx - the display context
+ *         time, var - which timestep, variable
+ *         n - number of points
+ *         x, y, z - the graphics coordinates
+ * Output:  row, col, lev - the corresponding grid coordinates.
+ */
+void xyzPRIME_to_gridPRIME_n( Display_Context dtx, int time, int var, int n,
+                              const float x[], const float y[],
+                              const float z[],
+                              float row[], float col[], float lev[] )
+{
+   int i;
+
+   switch (dtx->Projection) {
+      case PROJ_GENERIC:
+      case PROJ_LINEAR:
+      case PROJ_LAMBERT:
+      case PROJ_STEREO:
+      case PROJ_ROTATED:
+      case PROJ_MERCATOR:
+         {
+            float xmin = dtx->Xmin, xw = dtx->Xmax-dtx->Xmin;
+            float ymin = dtx->Ymin, ymax = dtx->Ymax, yw = dtx->Ymax-dtx->Ymin;
+            float zmin = dtx->Zmin, zmax = dtx->Zmax, zw = dtx->Zmax-dtx->Zmin;
+            float ncm = (float) (dtx->Nc-1), nrm = (float) (dtx->Nr-1);
+            float top = (float) (dtx->MaxNl-1);
+
+            for (i=0;i<n;i++) {
+               col[i] = (x[i]-xmin) / xw * ncm;
+            }
+            if (COORDHAND==COORDRIGHTHAND) {
+               for (i=0;i<n;i++) {
+                  row[i] = (y[i]-ymin) / yw * nrm;
+               }
+            }
+            else {
+               for (i=0;i<n;i++) {
+                  row[i] = (ymax-y[i]) / yw * nrm;
+               }
+            }
+            if ((dtx->VerticalSystem==VERT_GENERIC ||
+                 dtx->VerticalSystem==VERT_EQUAL_KM) && !dtx->LogFlag) {
+               for (i=0;i<n;i++) {
+                  float l = top * (z[i]-zmin) / zw;
+                  l = (z[i]<=zmin) ? 0.0f : l;
+                  lev[i] = (z[i]>=zmax) ? top : l;
+               }
+            }
+            else {
+               for (i=0;i<n;i++) {
+                  lev[i] = zPRIME_to_gridlevPRIME( dtx, z[i] );
+               }
+            }
+         }
+         break;
+      default:
+         for (i=0;i<n;i++) {
+            xyzPRIME_to_gridPRIME( dtx, time, var, x[i], y[i], z[i],
+                                   &row[i], &col[i], &lev[i] );
+         }
+   }
+}
+
+
 void xyzPRIME_to_grid( Context ctx, int time, int var,
                   float x, float y, float z,
                   float *row, float *col, float *lev )
@@ -4074,6 +4389,7 @@ void xyz_to_geo( Context ctx, int time, int var,
             alpha = ( (ic-row) * ctx->RowIncKm + YC) / RADIUS;
             *lat = 2 * RAD2DEG * atan( exp(alpha) ) - 90.0;
             *lon = ctx->CentralLon - RAD2DEG * (col-jc) * ctx->ColIncKm / RADIUS;
+            *hgt = z_to_height( ctx, z );
          }
          break;  
       case PROJ_LAMBERT:
@@ -51,6 +51,16 @@ extern void get_vertical_system_d( Display_Context dtx, int *vertical, float *ve
 
 extern void get_vertical_system( Context ctx, int *vertical, float *vertargs );
 
+extern void init_projection_tables( void );
+
+extern void free_ctx_projection_tables( Context ctx );
+
+extern void free_dtx_projection_tables( Display_Context dtx );
+
+extern void trim_ctx_projection_tables( Context ctx );
+
+extern void trim_dtx_projection_tables( Display_Context dtx );
+
 
 extern float gridlevelPRIME_to_zPRIME( Display_Context dtx, int time, int var, float level );
 
@@ -142,6 +152,11 @@ extern void xyzPRIME_to_gridPRIME( Display_Context dtx, int time, int var,
                          float x, float y, float z,
                          float *row, float *col, float *lev );
 
+extern void xyzPRIME_to_gridPRIME_n( Display_Context dtx, int time, int var,
+                                     int n, const float x[], const float y[],
+                                     const float z[],
+                                     float row[], float col[], float lev[] );
+
 extern void xyzPRIME_to_grid( Context ctx, int time, int var,
                   float x, float y, float z,
                   float *row, float *col, float *lev );
@@ -0,0 +1,221 @@
+
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "../config.h"
+
+
+/*
+ * Benchmark and check of the batch (lat,lon,hgt) to (x,y,z)
+ * transformation in proj.c.
+ *
+ * Random points inside the grid of each map projection are converted
+ * with geo_to_xyz() many times and the rate is reported, next to the
+ * rate of the scalar height_to_z().  The results are checked against
+ * height_to_z() and by converting back with xyz_to_geo().
+ *
+ * Build with "make projbench" in the src directory.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+#include "globals.h"
+#include "proj.h"
+
+
+#define NR  60
+#define NC  80
+#define NL  20
+
+
+struct projtest {
+   char *name;
+   int projection;
+   float args[7];
+};
+
+static struct projtest tests[] = {
+   { "linear",      PROJ_LINEAR,      { 60.0, 120.0, 0.5, 0.75 } },
+   { "mercator",    PROJ_MERCATOR,    { 40.0, 100.0, 50.0, 50.0 } },
+   { "lambert",     PROJ_LAMBERT,     { 60.0, 30.0, -100.0, 40.0, 100.0, 60.0 } },
+   { "stereo",      PROJ_STEREO,      { 50.0, 100.0, 30.0, 40.0, 60.0 } },
+   { "rotated",     PROJ_ROTATED,     { 20.0, 20.0, 0.5, 0.5, 40.0, 100.0, 10.0 } },
+   { "cylindrical", PROJ_CYLINDRICAL, { 80.0, 180.0, 2.5, 4.5 } },
+   { "spherical",   PROJ_SPHERICAL,   { 80.0, 180.0, 2.5, 4.5 } }
+};
+
+
+/* keeps the scalar timing loop from being optimized away */
+static volatile float sink;
+
+
+static double now( void )
+{
+   struct timeval tv;
+
+   gettimeofday( &tv, NULL );
+   return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+
+static float frand( void )
+{
+   return (float) rand() / (float) RAND_MAX;
+}
+
+
+/*
+ * Run one projection/vertical system combination.
+ * Return:  number of points outside the tolerances.
+ */
+static int run( Context ctx, struct projtest *t, int vertical, int logflag,
+                int n, int reps )
+{
+   float *row, *col, *lev, *lat, *lon, *hgt, *x, *y, *z;
+   float zerr, llerr, herr, dz;
+   double t0, tbatch, tscalar;
+   int i, r, bad;
+
+   ctx->G.Projection = t->projection;
+   for (i=0;i<7;i++) {
+      ctx->G.ProjArgs[i] = t->args[i];
+   }
+   ctx->G.VerticalSystem = vertical;
+   for (i=0;i<NL;i++) {
+      /* heights in km, spaced more widely going up */
+      ctx->G.VertArgs[i] = 0.1 + 0.04 * i * i;
+   }
+   ctx->LogFlag = logflag;
+   if (!setup_ctx_projection( ctx ) || !setup_ctx_vertical_system( ctx )) {
+      printf("%-12s setup failed\n", t->name );
+      return 1;
+   }
+
+   row = (float *) malloc( 9 * n * sizeof(float) );
+   col = row + n;     lev = col + n;
+   lat = lev + n;     lon = lat + n;     hgt = lon + n;
+   x = hgt + n;       y = x + n;         z = y + n;
+
+   for (i=0;i<n;i++) {
+      row[i] = 1.0 + frand() * (NR-3);
+      col[i] = 1.0 + frand() * (NC-3);
+      lev[i] = 0.0;
+   }
+   grid_to_geo( ctx, 0, 0, n, row, col, lev, lat, lon, hgt );
+   for (i=0;i<n;i++) {
+      hgt[i] = ctx->BottomBound + frand() * (ctx->TopBound-ctx->BottomBound);
+   }
+
+   t0 = now();
+   for (r=0;r<reps;r++) {
+      geo_to_xyz( ctx, 0, 0, n, lat, lon, hgt, x, y, z );
+   }
+   tbatch = now() - t0;
+
+   t0 = now();
+   for (r=0;r<reps;r++) {
+      for (i=0;i<n;i++) {
+         sink = height_to_z( ctx, hgt[i] );
+      }
+   }
+   tscalar = now() - t0;
+
+   /* check z against the scalar function and invert x,y,z */
+   dz = ctx->dpy_ctx->Zmax - ctx->dpy_ctx->Zmin;
+   zerr = llerr = herr = 0.0;
+   bad = 0;
+   for (i=0;i<n;i++) {
+      float la, lo, h, e;
+      if (t->projection!=PROJ_SPHERICAL) {
+         e = fabs( z[i] - height_to_z( ctx, hgt[i] ) ) / dz;
+         if (e>zerr)  zerr = e;
+         if (e>1.0e-4)  bad++;
+      }
+      xyz_to_geo( ctx, 0, 0, x[i], y[i], z[i], &la, &lo, &h );
+      lo = fmod( fabs( lo-lon[i] ), 360.0 );
+      if (lo > 180.0)  lo = 360.0 - lo;
+      e = fabs( la-lat[i] );
+      if (lo > e)  e = lo;
+      if (e>llerr)  llerr = e;
+      if (e>1.0e-2)  bad++;
+      e = fabs( h-hgt[i] );
+      if (e>herr)  herr = e;
+      if (e>1.0e-2)  bad++;
+   }
+
+   printf("%-12s %-4s %10.0f pts/sec  (height_to_z %10.0f)"
+          "  dz %.1e  dlatlon %.1e  dhgt %.1e%s\n",
+          t->name, vertical==VERT_NONEQUAL_MB ? "mb" : (logflag ? "log" : "km"),
+          (double) n * reps / tbatch, (double) n * reps / tscalar,
+          zerr, llerr, herr, bad ? "  FAILED" : "" );
+
+   free( row );
+   return bad;
+}
+
+
+int main( int argc, char *argv[] )
+{
+   struct vis5d_context *ctx;
+   struct display_context *dtx;
+   int n, reps, i, bad;
+
+   n = (argc > 1) ? atoi( argv[1] ) : 100000;
+   reps = (argc > 2) ? atoi( argv[2] ) : 20;
+   if (n < 1 || reps < 1) {
+      printf("Usage:\n");
+      printf("   projbench [points [repetitions]]\n");
+      exit(0);
+   }
+
+   init_projection_tables();
+   ctx = (struct vis5d_context *) calloc( 1, sizeof(struct vis5d_context) );
+   dtx = (struct display_context *) calloc( 1, sizeof(struct display_context) );
+   ctx->dpy_ctx = dtx;
+   dtx->UserProjection = PROJ_MIN_VALUE-1;
+   dtx->UserVerticalSystem = PROJ_MIN_VALUE-1;
+   dtx->Xmin = -1.0;   dtx->Xmax = 1.0;
+   dtx->Ymin = -0.75;  dtx->Ymax = 0.75;
+   dtx->Zmin = -0.25;  dtx->Zmax = 0.25;
+   ctx->Nr = NR;
+   ctx->Nc = NC;
+   ctx->MaxNl = NL;
+   ctx->LogScale = 1012.5;
+   ctx->LogExp = -7.2;
+
+   srand( 1 );
+   bad = 0;
+   for (i=0;i<sizeof(tests)/sizeof(tests[0]);i++) {
+      bad += run( ctx, &tests[i], VERT_EQUAL_KM, 0, n, reps );
+      bad += run( ctx, &tests[i], VERT_NONEQUAL_KM, 1, n, reps );
+      bad += run( ctx, &tests[i], VERT_NONEQUAL_MB, 0, n, reps );
+   }
+   return bad ? 1 : 0;
+}
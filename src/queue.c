@@ -61,10 +61,15 @@ static struct entry queue[QSIZE];
 static int qsize;
 static int qhead, qtail;      /* remove from head, add to tail */
 static int qwaiters;
+static int qpreloads;         /* TASK_PRELOADs in the queue */
+static int preloading;        /* TASK_PRELOADs being done by workers */
+static int preloads_held;     /* see hold_preloads() */
+static int preload_waiters;   /* threads waiting for preloading to drop */
 
 #ifdef SEMAPHORE
 static LOCK qlock;
 static SEMAPHORE qnotempty;
+static SEMAPHORE preload_done;
 #endif
 
 
@@ -73,9 +78,11 @@ void init_queue( void )
 {
    ALLOC_LOCK( qlock );
    ALLOC_SEM( qnotempty, 0 );
+   ALLOC_SEM( preload_done, 0 );
    qsize = 0;
    qhead = qtail = 0;
    qwaiters = 0;
+   qpreloads = preloading = preloads_held = preload_waiters = 0;
 }
 
 
@@ -84,6 +91,7 @@ void terminate_queue( void )
 {
    FREE_LOCK( qlock );
    FREE_SEM( qnotempty );
+   FREE_SEM( preload_done );
 }
 
 
@@ -92,29 +100,64 @@ void terminate_queue( void )
  * Return number of entries still in the queue and the number of threads
  * waiting for work to do.
  * If size==0 and waiters==NumWorkThreads then we're idle.
+ * Background preloads are left out, a thread doing one counts as
+ * waiting, so vis5d_finish_work() doesn't wait for the whole data set
+ * to be read.
  */
 void get_queue_info( int *size, int *waiters )
 {
    LOCK_ON( qlock );
-   *size = qsize;
-   *waiters = qwaiters;
+   *size = qsize - qpreloads;
+   *waiters = qwaiters + preloading;
    LOCK_OFF( qlock );
 }
 
 
 
+/*
+ * Return the number of background preloads in the queue.
+ */
+int get_queued_preloads( void )
+{
+   int n;
 
-static void add_qentry( Context ctx, Irregular_Context itx, 
-                        int urgent, int type,
-                        int i1, int i2, int i3,
-                        float f1, float f2, float f3, float f4, float f5 )
+   LOCK_ON( qlock );
+   n = qpreloads;
+   LOCK_OFF( qlock );
+   return n;
+}
+
+
+
+
+/*
+ * Put an entry into the queue.
+ * Input:  urgent - nonzero puts it at the front of the queue
+ *         wait - nonzero waits for room if the queue is full, else the
+ *                entry is dropped.  Worker threads must not wait since
+ *                they are the ones who empty the queue.
+ * Return:  1 = queued (or already in the queue), 0 = dropped
+ */
+static int put_qentry( Context ctx, Irregular_Context itx,
+                       int urgent, int wait, int type,
+                       int i1, int i2, int i3,
+                       float f1, float f2, float f3, float f4, float f5 )
 {
    int pos, i, found=0;
 
    LOCK_ON( qlock );
+   if (ctx && ctx->Closing && type!=TASK_QUIT) {
+      /* the context is being destroyed */
+      LOCK_OFF( qlock );
+      return 0;
+   }
    while (qsize==QSIZE-2) {
       if (Debug)
          printf("QUEUE FULL!!!\n");
+      if (!wait) {
+         LOCK_OFF( qlock );
+         return 0;
+      }
       LOCK_OFF( qlock );
 /* WLH 6 Nov 98
       sleep(1);
@@ -143,8 +186,11 @@ static void add_qentry( Context ctx, Irregular_Context itx,
           queue[pos].i2==i2) {
          /* already in queue, cancel it if urgent */
          found = 1;
-         if (urgent)
+         if (urgent) {
            queue[pos].type = TASK_NULL;
+           if (type==TASK_PRELOAD)
+             qpreloads--;
+         }
          break;
       }
       else if (itx && queue[pos].ctx==ctx &&
@@ -195,6 +241,9 @@ static void add_qentry( Context ctx, Irregular_Context itx,
    queue[pos].f3 = f3;
    queue[pos].f4 = f4;
    queue[pos].f5 = f5;
+   if (type==TASK_PRELOAD && (urgent || !found)) {
+      qpreloads++;
+   }
 
    if (Debug) { 
       if (urgent)
@@ -203,6 +252,33 @@ static void add_qentry( Context ctx, Irregular_Context itx,
    } 
 
    LOCK_OFF( qlock );
+   return 1;
+}
+
+
+
+static void add_qentry( Context ctx, Irregular_Context itx, 
+                        int urgent, int type,
+                        int i1, int i2, int i3,
+                        float f1, float f2, float f3, float f4, float f5 )
+{
+   put_qentry( ctx, itx, urgent, 1, type, i1, i2, i3, f1, f2, f3, f4, f5 );
+}
+
+
+
+/*
+ * Like add_qentry() but for entries posted by worker threads: if the
+ * queue is full the entry is dropped instead of waiting for room.
+ * Return:  1 = queued, 0 = dropped
+ */
+static int try_add_qentry( Context ctx, Irregular_Context itx,
+                           int urgent, int type,
+                           int i1, int i2, int i3,
+                           float f1, float f2, float f3, float f4, float f5 )
+{
+   return put_qentry( ctx, itx, urgent, 0, type,
+                      i1, i2, i3, f1, f2, f3, f4, f5 );
 }
 
 
@@ -252,6 +328,19 @@ void get_qentry( Context *ctx, Irregular_Context *itx,
 
          qsize--;
       }
+      if (*type==TASK_PRELOAD) {
+         qpreloads--;
+         if (preloads_held) {
+            /* resume_preload() asks for it again */
+            (*ctx)->PreloadNext = *i1;
+            *type = TASK_NULL;
+         }
+         else {
+            /* counted until done_preload(), see cancel_requests() */
+            (*ctx)->PreloadsRunning++;
+            preloading++;
+         }
+      }
 
    }
    else {
@@ -625,3 +714,167 @@ void request_topo_recoloring( Context ctx )
 }
 
 
+
+/*
+ * Ask an idle worker thread to help a run_parallel_job() call, such as
+ * contour() with the bands of a big slice.  These go to the front of
+ * the queue since the thread which posted them is already working on
+ * its job.  Help is optional, the job's owner does whatever parts no
+ * helper takes, so nothing is posted if the queue is full.
+ * Input:  ctx - the context, may be NULL for work owned by the display
+ *         slot, id - identify the job
+ *         helper - which of the job's helper requests this is
+ * Return:  1 = posted, 0 = the queue is full
+ */
+int request_parallel_help( Context ctx, int slot, int helper, int id )
+{
+   return try_add_qentry( ctx, NULL, 1, TASK_PARALLEL, slot, helper, id,
+                          0.0, 0.0, 0.0, 0.0, 0.0 );
+}
+
+
+
+/*
+ * Ask a worker thread to read the grids of a timestep into the cache.
+ * These go to the back of the queue so graphics requests come first; the
+ * task asks for the next timestep when it's done.  That is done on the
+ * worker, so if the queue is full the request is dropped and remembered
+ * for resume_preload() instead of waiting for room.
+ * Input:  ctx - the context
+ *         time - which timestep
+ */
+void request_preload( Context ctx, int time )
+{
+   if (!try_add_qentry( ctx, NULL, 0, TASK_PRELOAD, time, 0, 0,
+                        0.0, 0.0, 0.0, 0.0, 0.0 )) {
+      LOCK_ON( qlock );
+      if (!ctx->Closing) {
+         ctx->PreloadNext = time;
+      }
+      LOCK_OFF( qlock );
+   }
+}
+
+
+
+/*
+ * Restart the background preloading of a context if its last request
+ * was dropped.  Called when the timestep changes and after
+ * hold_preloads().
+ */
+void resume_preload( Context ctx )
+{
+   int time;
+
+   LOCK_ON( qlock );
+   time = ctx->PreloadNext;
+   ctx->PreloadNext = 0;
+   LOCK_OFF( qlock );
+
+   if (time>0 && time<ctx->NumTimes) {
+      request_preload( ctx, time );
+   }
+}
+
+
+
+/*
+ * Wake the threads waiting in hold_preloads() or cancel_requests().
+ * Called with qlock held.
+ */
+static void signal_preload_done( void )
+{
+   while (preload_waiters>0) {
+      preload_waiters--;
+      SIGNAL_SEM( preload_done );
+   }
+}
+
+
+
+/*
+ * Wait for preloading to drop, see signal_preload_done().  Called and
+ * returns with qlock held.
+ */
+static void wait_preload_done( void )
+{
+   preload_waiters++;
+   LOCK_OFF( qlock );
+   WAIT_SEM( preload_done );
+   LOCK_ON( qlock );
+}
+
+
+
+/*
+ * Called by a worker when it has finished a TASK_PRELOAD, including
+ * asking for the next timestep.
+ */
+void done_preload( Context ctx )
+{
+   LOCK_ON( qlock );
+   ctx->PreloadsRunning--;
+   preloading--;
+   signal_preload_done();
+   LOCK_OFF( qlock );
+}
+
+
+
+/*
+ * Wait for the background preloads being done to finish and keep the
+ * workers from starting new ones until release_preloads().  Preloads
+ * taken from the queue meanwhile are dropped and remembered for
+ * resume_preload().  Used with vis5d_finish_work() before the tables a
+ * preload reads are reallocated.
+ */
+void hold_preloads( void )
+{
+   LOCK_ON( qlock );
+   preloads_held++;
+   while (preloading>0) {
+      wait_preload_done();
+   }
+   LOCK_OFF( qlock );
+}
+
+
+
+void release_preloads( void )
+{
+   LOCK_ON( qlock );
+   preloads_held--;
+   LOCK_OFF( qlock );
+}
+
+
+
+/*
+ * Cancel the queued requests of a context which is being destroyed.
+ * No more requests are accepted for it, and this waits for a background
+ * preload running on a worker, which would otherwise keep reading the
+ * context and queue the next timestep.
+ */
+void cancel_requests( Context ctx )
+{
+   int pos, i;
+
+   LOCK_ON( qlock );
+   ctx->Closing = 1;
+   ctx->PreloadNext = 0;
+   pos = qhead;
+   for (i=0;i<qsize;i++) {
+      if (queue[pos].ctx==ctx && queue[pos].type!=TASK_QUIT) {
+         if (queue[pos].type==TASK_PRELOAD)
+           qpreloads--;
+         queue[pos].type = TASK_NULL;
+      }
+      pos++;
+      if (pos==QSIZE)
+        pos = 0;
+   }
+   while (ctx->PreloadsRunning>0) {
+      wait_preload_done();
+   }
+   LOCK_OFF( qlock );
+}
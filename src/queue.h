@@ -52,6 +52,8 @@
 #define TASK_HCLIP         14
 #define TASK_VCLIP         15
 #define TASK_TEXT_PLOT     16
+#define TASK_PARALLEL      17
+#define TASK_PRELOAD       18
 #define TASK_QUIT         100
 
 
@@ -61,6 +63,8 @@ extern void terminate_queue( void );
 
 extern void get_queue_info( int *size, int *waiters );
 
+extern int get_queued_preloads( void );
+
 extern void get_qentry( Context *ctx, Irregular_Context *itx,
                         int *type,
                         int *i1, int *i2, int *i3,
@@ -106,5 +110,19 @@ extern void request_ext_func( Context ctx, int time, int var );
 
 extern void request_topo_recoloring( Context ctx );
 
+extern int request_parallel_help( Context ctx, int slot, int helper, int id );
+
+extern void request_preload( Context ctx, int time );
+
+extern void resume_preload( Context ctx );
+
+extern void done_preload( Context ctx );
+
+extern void hold_preloads( void );
+
+extern void release_preloads( void );
+
+extern void cancel_requests( Context ctx );
+
 extern void request_text_plot( Irregular_Context itx, int time, int var, int urgent);
 #endif
@@ -513,7 +513,7 @@ int initially_open_recordfile( char filename[], irregular_v5dstruct *iv )
 
 int open_recordfile(Irregular_Context itx, char filename[])
 {
-   int i, time, first;
+   int i, n, time, first;
  
    if (!initially_open_recordfile( filename, &itx->G)){
       return 0;
@@ -568,6 +568,31 @@ int open_recordfile(Irregular_Context itx, char filename[])
       return 0;
    }
 
+   /* per-timestep tables, freed by destroy_irregular_context() */
+   free( itx->RecGeoPosition );
+   free( itx->NumRecs );
+   free( itx->RecordTable );
+   free( itx->TimeStamp );
+   free( itx->DayStamp );
+   free( itx->Elapsed );
+   free( itx->TextPlotTable );
+   n = itx->NumTimes>0 ? itx->NumTimes : 1;
+   itx->RecGeoPosition = (struct rec_geo_position **)
+                         calloc( n, sizeof(struct rec_geo_position *) );
+   itx->NumRecs = (int *) calloc( n, sizeof(int) );
+   itx->RecordTable = (struct irreg_rec **)
+                      calloc( n, sizeof(struct irreg_rec *) );
+   itx->TimeStamp = (int *) calloc( n, sizeof(int) );
+   itx->DayStamp = (int *) calloc( n, sizeof(int) );
+   itx->Elapsed = (int *) calloc( n, sizeof(int) );
+   itx->TextPlotTable = (struct textplot *) calloc( n, sizeof(struct textplot) );
+   if (!itx->RecGeoPosition || !itx->NumRecs || !itx->RecordTable ||
+       !itx->TimeStamp || !itx->DayStamp || !itx->Elapsed ||
+       !itx->TextPlotTable) {
+      printf("Error: out of memory.  Couldn't allocate time step tables.\n");
+      return 0;
+   }
+
    for (time = 0; time < itx->NumTimes; time++){
       itx->TimeStamp[time] = v5dHHMMSStoSeconds( itx->G.TimeStamp[time] );
       itx->DayStamp[time] = v5dYYDDDtoDays( itx->G.DateStamp[time] );
@@ -46,6 +46,7 @@
 #include "globals.h"
 #include "graphics.h"
 #include "grid.h"
+#include "isolod.h"
 #include "labels.h"
 #include "map.h"
 #include "memory.h"
@@ -55,6 +56,7 @@
 #include "sounding.h"
 #include "sync.h"
 #include "topo.h"
+#include "trajset.h"
 #include "vis5d.h"
 #include "volume.h"
 #include "v5d.h"
@@ -876,6 +878,38 @@ int get_alpha( unsigned int color_table[], int size )
 
 
 
+/*
+ * Size of one graphics unit on the screen, from the projections of the
+ * diagonals of the 3-D box.
+ * Return:  pixels per graphics unit
+ */
+static float box_pixel_scale( Display_Context dtx )
+{
+   float p[3], q[3], x0, y0, x1, y1, d, pixels;
+   int i;
+
+   d = sqrt( (dtx->Xmax-dtx->Xmin) * (dtx->Xmax-dtx->Xmin)
+             + (dtx->Ymax-dtx->Ymin) * (dtx->Ymax-dtx->Ymin)
+             + (dtx->Zmax-dtx->Zmin) * (dtx->Zmax-dtx->Zmin) );
+   pixels = 0.0;
+   for (i=0;i<4;i++) {
+      p[0] = (i&1) ? dtx->Xmax : dtx->Xmin;
+      p[1] = (i&2) ? dtx->Ymax : dtx->Ymin;
+      p[2] = dtx->Zmin;
+      q[0] = (i&1) ? dtx->Xmin : dtx->Xmax;
+      q[1] = (i&2) ? dtx->Ymin : dtx->Ymax;
+      q[2] = dtx->Zmax;
+      project( p, &x0, &y0 );
+      project( q, &x1, &y1 );
+      if (d>0.0 && sqrt((x1-x0)*(x1-x0) + (y1-y0)*(y1-y0)) / d > pixels) {
+         pixels = sqrt( (x1-x0)*(x1-x0) + (y1-y0)*(y1-y0) ) / d;
+      }
+   }
+   return pixels;
+}
+
+
+
 /*
  * Render all isosurfaces selected for display.
  * Input:  ctx - the context
@@ -888,6 +922,7 @@ static void render_isosurfaces( Context ctx, int dtxtime, int ctxtime, int tf, i
   int var, alpha, lock;
   Display_Context dtx;
   int time, colorvar, cvowner;
+  float pixels = -1.0;
 
   dtx = ctx->dpy_ctx;
 
@@ -928,14 +963,27 @@ static void render_isosurfaces( Context ctx, int dtxtime, int ctxtime, int tf, i
 														 var][ISOSURF] );
 		  }
 		  if ( (tf && alpha==255) || (tf==0 && alpha<255) ) {
+			 struct isosurface *surf = ctx->Variable[var]->SurfTable[time];
+			 struct iso_lod *lod = NULL;
+			 int	fastdraw;
+			 vis5d_check_fastdraw(dtx->dpy_context_index, &fastdraw);
+			 if (surf->numlods > 0) {
+				/* draw a simplified version if it looks the same */
+				int k;
+				if (pixels < 0.0) {
+				  pixels = box_pixel_scale( dtx );
+				}
+				k = choose_iso_lod( surf, pixels, fastdraw || animflag );
+				if (k >= 0 && (surf->lod[k].colors || !surf->colors)) {
+				  lod = &surf->lod[k];
+				}
+			 }
 			 if (ctx->Variable[var]->SurfTable[time]->colors) {
-				int	fastdraw;
-				vis5d_check_fastdraw(dtx->dpy_context_index, &fastdraw);
 				if ((fastdraw || animflag) && ctx->Variable[var]->SurfTable[time]->deci_verts) {
 				  if (ctx->Variable[var]->SurfTable[time]->deci_colors) {
 					 draw_colored_isosurface(
 													 ctx->Variable[var]->SurfTable[time]->deci_numverts,
-													 ctx->Variable[var]->SurfTable[time]->index,
+													 NULL, NULL,
 													 (void *) ctx->Variable[var]->SurfTable[time]->deci_verts,
 													 (void *) ctx->Variable[var]->SurfTable[time]->deci_norms,
 													 1,
@@ -947,7 +995,7 @@ static void render_isosurfaces( Context ctx, int dtxtime, int ctxtime, int tf, i
 				  else {
 					 draw_isosurface(
 										  ctx->Variable[var]->SurfTable[time]->deci_numverts,
-										  ctx->Variable[var]->SurfTable[time]->index,
+										  NULL, NULL,
 										  (void *) ctx->Variable[var]->SurfTable[time]->deci_verts,
 										  (void *) ctx->Variable[var]->SurfTable[time]->deci_norms,
 										  1,
@@ -956,9 +1004,16 @@ static void render_isosurfaces( Context ctx, int dtxtime, int ctxtime, int tf, i
 										  );
 				  }
 				}
+				else if (lod)
+				  draw_colored_isosurface( lod->numchunks, lod->chunks, lod->index,
+												  (void *) lod->verts, (void *) lod->norms,
+												  0, (void *) lod->colors,
+												  dtx->ColorTable[VIS5D_ISOSURF_CT]->Colors[cvowner*MAXVARS+colorvar],
+												  alpha );
 				else 
 				  draw_colored_isosurface(
-												  ctx->Variable[var]->SurfTable[time]->numindex,
+												  ctx->Variable[var]->SurfTable[time]->numchunks,
+												  ctx->Variable[var]->SurfTable[time]->chunks,
 												  ctx->Variable[var]->SurfTable[time]->index,
 												  (void *) ctx->Variable[var]->SurfTable[time]->verts,
 												  (void *) ctx->Variable[var]->SurfTable[time]->norms,
@@ -967,9 +1022,15 @@ static void render_isosurfaces( Context ctx, int dtxtime, int ctxtime, int tf, i
 												  dtx->ColorTable[VIS5D_ISOSURF_CT]->Colors[cvowner*MAXVARS+colorvar],
 												  alpha );
 			 }
+			 else if (lod) {
+				draw_isosurface( lod->numchunks, lod->chunks, lod->index,
+									  (void *) lod->verts, (void *) lod->norms, 0,
+									  dtx->Color[ctx->context_index*MAXVARS+var][0], NULL, 0 );
+			 }
 			 else 
 			 {
-				draw_isosurface( ctx->Variable[var]->SurfTable[time]->numindex,
+				draw_isosurface( ctx->Variable[var]->SurfTable[time]->numchunks,
+									  ctx->Variable[var]->SurfTable[time]->chunks,
 									  ctx->Variable[var]->SurfTable[time]->index,
 									  (void *) ctx->Variable[var]->SurfTable[time]->verts,
 									  (void *) ctx->Variable[var]->SurfTable[time]->norms,
@@ -1782,67 +1843,49 @@ static void render_vstream_slices( Context ctx, int time, int animflag )
 
 static void render_trajectories( Context ctx, int it, int tf )
 {
-   int alpha, i, len, start;
+   int alpha, g, kind, n;
+   int *first, *count;
+   unsigned int *color_table;
    Display_Context dtx;
 
    dtx = ctx->dpy_ctx;
-   for (i=0;i<dtx->NumTraj;i++) {
-      struct traj *t = dtx->TrajTable[i];
-
-      if (t->ctx_owner==ctx->context_index
-          && dtx->DisplayTraj[t->group]
-           && cond_read_lock(&t->lock)){
-
-         assert( t->lock==1 );
-
-         recent( ctx, TRAJ, t->group );
-         alpha = UNPACK_ALPHA( dtx->TrajColor[t->group]);
-         if ( (tf && alpha==255) || (tf==0 && alpha<255) ) {
-            start = t->start[it];
-            len = t->len[it];
-            if (start!=BADSTART && len>0) {
-               if (t->kind==0) {
-                  /* draw as line segments */
-                  int colorvar = t->colorvar;
-                  if (colorvar>=0) {
-                     /* draw colored trajectory */
-                     draw_colored_polylines( len,
-                                     (void *) (t->verts + start*3),
-                                     (void*)(t->colors + start),
-                                     dtx->ColorTable[VIS5D_TRAJ_CT]->Colors[t->colorvarowner*MAXVARS+
-                                     colorvar]);
-                  }
-                  else {
-                     /* monocolored */
-                     draw_polylines( len,
-                                     (void *) (t->verts + start*3),
-                                     dtx->TrajColor[t->group] );
-                  }
-               }
-               else {
-                  /* draw as triangle strip */
-                  int colorvar = t->colorvar;
-                  if (colorvar>=0) {
-                     /* draw colored triangles */
-                     draw_colored_triangle_strip( len,
-                                       (void*)(t->verts + start*3),
-                                       (void*)(t->norms + start*3),
-                                       (void*)(t->colors + start),
-                                       dtx->ColorTable[VIS5D_TRAJ_CT]->Colors[t->colorvarowner*MAXVARS+
-                                       colorvar], alpha );
-                  }
-                  else {
-                     /* monocolor */
-                     draw_triangle_strip( len,
-                                       (void*)(t->verts + start*3),
-                                       (void*)(t->norms + start*3),
-                                       dtx->TrajColor[t->group] );
-                  }
-               }
+   for (g=0;g<VIS5D_TRAJ_SETS;g++) {
+      struct traj_set *s = &dtx->TrajSet[g];
+
+      if (!dtx->DisplayTraj[g] || s->numtraj==0) {
+         continue;
+      }
+      alpha = UNPACK_ALPHA( dtx->TrajColor[g] );
+      if ( !((tf && alpha==255) || (tf==0 && alpha<255)) ) {
+         continue;
+      }
+      if (!cond_read_lock(&s->lock)) {
+         continue;
+      }
+      recent( ctx, TRAJ, g );
+
+      first = (int *) malloc( 2 * s->numtraj * sizeof(int) );
+      if (first) {
+         count = first + s->numtraj;
+         color_table = NULL;
+         if (s->colorvar>=0 && s->colors) {
+            color_table = dtx->ColorTable[VIS5D_TRAJ_CT]->Colors[s->colorvarowner*MAXVARS+
+                                                                  s->colorvar];
+         }
+         /* kind 0 = line segments, kind 1 = triangle strips */
+         for (kind=0;kind<2;kind++) {
+            n = traj_set_strips( s, ctx->context_index, kind, it,
+                                 first, count );
+            if (n>0) {
+               draw_traj_strips( n, first, count, kind,
+                                 (void *) s->verts, (void *) s->norms,
+                                 color_table ? s->colors : NULL,
+                                 color_table, dtx->TrajColor[g], alpha );
             }
          }
-         done_read_lock( &t->lock );
+         free( first );
       }
+      done_read_lock( &s->lock );
    }
 }
 
@@ -2176,7 +2219,8 @@ static void draw_probe( Display_Context dtx )
                int col = (int) (c+0.01);
                int lev = (int) (l+0.01);
                if (ctx->GridSameAsGridPRIME){
-                  val = get_grid_value( ctx, ctx->CurTime, var, row, col, lev );
+                  val = probe_grid_value( ctx, ctx->CurTime, var,
+                                          (float) row, (float) col, (float) lev );
                }
                else{
                   vis5d_gridPRIME_to_grid(ctx->context_index, ctx->CurTime, var,
@@ -2193,10 +2237,10 @@ static void draw_probe( Display_Context dtx )
             }
             else {
                if (ctx->GridSameAsGridPRIME){
-                  val = interpolate_grid_value( ctx, ctx->CurTime, var, r, c, l );
+                  val = probe_grid_value( ctx, ctx->CurTime, var, r, c, l );
                }
                else{
-                  val = interpolate_grid_value( ctx, ctx->CurTime, var, rr, cc, ll );
+                  val = probe_grid_value( ctx, ctx->CurTime, var, rr, cc, ll );
                }
             }
             sprintf( str, "%-4s", ctx->Variable[var]->VarName );
@@ -2843,9 +2887,6 @@ void render_sounding_only( Display_Context dtx, int pixmapflag )
            dtx->CursorY != dtx->Sound.currentY) ||
            (dtx->CurTime != dtx->Sound.currentTime) ||
            /* MJK 12.02.98 */ (pixmapflag)){
-         if (dtx->CurTime != dtx->Sound.currentTime){
-            reload_sounding_data( dtx );
-         }
          draw_sounding(dtx, dtx->CurTime); 
          dtx->Sound.currentX = dtx->CursorX;
          dtx->Sound.currentY = dtx->CursorY;
@@ -52,10 +52,12 @@
 #include "api.h"
 #include "globals.h"
 #include "grid.h"
+#include "isomesh.h"
 #include "memory.h"
 #include "misc.h"
 #include "sync.h"
 #include "topo.h"
+#include "trajset.h"
 #include "labels.h"
 
 
@@ -128,6 +130,7 @@
 #define TAG_HSTREAM          68
 #define TAG_COLORED_ISOSURF  69
 #define TAG_VSTREAM          70
+#define TAG_CHUNKED_ISOSURF  71
 
 
 
@@ -214,18 +217,21 @@ static int end_block( FILE *f )
 static int save_isosurfaces( Context ctx, FILE *f )
 {
 
-   int iv, it;
+   int iv, it, c;
    int neg_one = -1;
 
    for (iv=0;iv<ctx->NumVars;iv++) {
       for (it=0;it<ctx->NumTimes;it++) {
          if (ctx->Variable[iv]->SurfTable[it]->valid) {
-            int numverts, numindex;
+            int numverts, numindex, numchunks;
+            struct iso_chunk *chunks;
 
-            begin_block( f, TAG_COLORED_ISOSURF );
+            begin_block( f, TAG_CHUNKED_ISOSURF );
 
             numverts = ctx->Variable[iv]->SurfTable[it]->numverts;
             numindex = ctx->Variable[iv]->SurfTable[it]->numindex;
+            numchunks = ctx->Variable[iv]->SurfTable[it]->numchunks;
+            chunks = ctx->Variable[iv]->SurfTable[it]->chunks;
 
             /* isosurface data */
             FWRITE( &iv, INT_SIZE, 1, f );  /* parm */
@@ -233,13 +239,16 @@ static int save_isosurfaces( Context ctx, FILE *f )
             FWRITE( &ctx->Variable[iv]->SurfTable[it]->isolevel, FLOAT_SIZE, 1, f );
             FWRITE( &numverts, INT_SIZE, 1, f );  /* number of vertices */
             FWRITE( &numindex, INT_SIZE, 1, f );
+            FWRITE( &numchunks, INT_SIZE, 1, f );
             FWRITE( ctx->Variable[iv]->SurfTable[it]->verts, INT_VERT2_SIZE, 3*numverts, f );
             FWRITE( ctx->Variable[iv]->SurfTable[it]->norms, INT_1_SIZE, 3*numverts, f );
-#ifdef BIG_GFX
-            FWRITE( ctx->Variable[iv]->SurfTable[it]->index, UINT_4_SIZE, numindex, f );
-#else
-            FWRITE( ctx->Variable[iv]->SurfTable[it]->index, UINT_VERT2_SIZE, numindex, f );
-#endif
+            FWRITE( ctx->Variable[iv]->SurfTable[it]->index, UINT_2_SIZE, numindex, f );
+            for (c=0;c<numchunks;c++) {
+               FWRITE( &chunks[c].vbase, INT_SIZE, 1, f );
+               FWRITE( &chunks[c].numverts, INT_SIZE, 1, f );
+               FWRITE( &chunks[c].ibase, INT_SIZE, 1, f );
+               FWRITE( &chunks[c].numindex, INT_SIZE, 1, f );
+            }
             if (ctx->Variable[iv]->SurfTable[it]->colors) {
                FWRITE( &ctx->Variable[iv]->SurfTable[it]->colorvar, INT_SIZE, 1, f );
                FWRITE( ctx->Variable[iv]->SurfTable[it]->colors, UINT_1_SIZE,
@@ -1027,10 +1036,84 @@ static void *alloc_and_read( Context ctx, FILE *f, int bytes )
 
 
 
+/*
+ * Read the single triangle strip of an isosurface saved before surfaces
+ * were stored in chunks.
+ * Return:  array [numindex] of vertex numbers to be free()'d, or NULL
+ */
+static int *read_isosurf_strip( FILE *f, int numindex )
+{
+   int *strip, i;
+#ifdef BIG_GFX
+   uint_4 *index;
+   int size = UINT_4_SIZE;
+#else
+   uint_vert2 *index;
+   int size = UINT_VERT2_SIZE;
+#endif
+
+   strip = (int *) malloc( numindex * sizeof(int) );
+   index = malloc( numindex * size );
+   if (!strip || !index || fread( index, size, numindex, f ) != numindex) {
+      free( strip );
+      free( index );
+      return NULL;
+   }
+   for (i=0;i<numindex;i++) {
+      strip[i] = index[i];
+   }
+   free( index );
+   return strip;
+}
+
+
+
+/*
+ * Cut the strip of a restored old style isosurface into chunks and put
+ * its vertices in chunk order.  If that fails the surface is left empty.
+ * Input:  ctx - the context
+ *         surf - the surface with verts, norms and colors read in
+ *         numverts - number of vertices read
+ *         numindex, strip - the strip from read_isosurf_strip()
+ */
+static void chunk_isosurf( Context ctx, struct isosurface *surf,
+                           int numverts, int numindex, int *strip )
+{
+   int *vorder = NULL;
+   int nv = 0, ni = 0, nc = 0;
+
+   surf->index = NULL;
+   surf->chunks = NULL;
+   if (!surf->verts || !surf->norms || !strip ||
+       !make_iso_chunks( ctx, numverts, numindex, strip, &vorder, &nv,
+                         &surf->index, &ni, &surf->chunks, &nc ) ||
+       !reorder_iso_verts( ctx, numverts, nv, vorder, &surf->verts,
+                           &surf->norms, &surf->colors )) {
+      if (surf->verts) deallocate( ctx, surf->verts, 3*numverts*INT_VERT2_SIZE );
+      if (surf->norms) deallocate( ctx, surf->norms, 3*numverts*INT_1_SIZE );
+      if (surf->colors) deallocate( ctx, surf->colors, numverts*UINT_1_SIZE );
+      free_iso_chunks( ctx, ni, surf->index, nc, surf->chunks );
+      surf->verts = NULL;
+      surf->norms = NULL;
+      surf->colors = NULL;
+      surf->index = NULL;
+      surf->chunks = NULL;
+      nv = ni = nc = 0;
+   }
+   free( vorder );
+   free( strip );
+   surf->numverts = nv;
+   surf->numindex = ni;
+   surf->numchunks = nc;
+}
+
+
+
 static void restore_isosurf( Context ctx, FILE *f, int maxparm,
                              int blocklength )
 {
    int iv, it, numverts, numindex;
+   int *strip;
    float level;
 
    fread( &iv, INT_SIZE, 1, f );
@@ -1060,17 +1143,12 @@ static void restore_isosurf( Context ctx, FILE *f, int maxparm,
    /* read isosurface */
    ctx->Variable[iv]->SurfTable[it]->verts = alloc_and_read(ctx,f,3*numverts*INT_VERT2_SIZE);
    ctx->Variable[iv]->SurfTable[it]->norms = alloc_and_read(ctx,f,3*numverts*INT_1_SIZE);
-
-#ifdef BIG_GFX
-   ctx->Variable[iv]->SurfTable[it]->index = alloc_and_read(ctx,f,numindex*UINT_4_SIZE);
-#else
-   ctx->Variable[iv]->SurfTable[it]->index = alloc_and_read(ctx,f,numindex*UINT_VERT2_SIZE);
-#endif
+   strip = read_isosurf_strip( f, numindex );
    ctx->Variable[iv]->SurfTable[it]->isolevel = level;
-   ctx->Variable[iv]->SurfTable[it]->numverts = numverts;
-   ctx->Variable[iv]->SurfTable[it]->numindex = numindex;
    ctx->Variable[iv]->SurfTable[it]->colorvar = -1;
    ctx->Variable[iv]->SurfTable[it]->colors = NULL;
+   chunk_isosurf( ctx, ctx->Variable[iv]->SurfTable[it], numverts, numindex,
+                  strip );
    ctx->Variable[iv]->SurfTable[it]->valid = 1;
    ctx->IsoLevel[iv] = level;
      
@@ -1085,6 +1163,7 @@ static void restore_colored_isosurf( Context ctx, FILE *f, int maxparm,
                                      int blocklength )
 {
    int iv, it, numverts, numindex;
+   int *strip;
    float level;
 
    fread( &iv, INT_SIZE, 1, f );
@@ -1114,12 +1193,7 @@ static void restore_colored_isosurf( Context ctx, FILE *f, int maxparm,
    /* read isosurface */
    ctx->Variable[iv]->SurfTable[it]->verts = alloc_and_read(ctx,f,3*numverts*INT_VERT2_SIZE);
    ctx->Variable[iv]->SurfTable[it]->norms = alloc_and_read(ctx,f,3*numverts*INT_1_SIZE);
-
-#ifdef BIG_GFX
-   ctx->Variable[iv]->SurfTable[it]->index = alloc_and_read(ctx,f,numindex*UINT_4_SIZE);
-#else
-   ctx->Variable[iv]->SurfTable[it]->index = alloc_and_read(ctx,f,numindex*UINT_VERT2_SIZE);
-#endif
+   strip = read_isosurf_strip( f, numindex );
    fread( &ctx->Variable[iv]->SurfTable[it]->colorvar, INT_SIZE, 1, f );
    if (ctx->Variable[iv]->SurfTable[it]->colorvar>-1) {
       ctx->Variable[iv]->SurfTable[it]->colors = alloc_and_read(ctx,f,numverts*UINT_1_SIZE);
@@ -1129,8 +1203,8 @@ static void restore_colored_isosurf( Context ctx, FILE *f, int maxparm,
    }
 
    ctx->Variable[iv]->SurfTable[it]->isolevel = level;
-   ctx->Variable[iv]->SurfTable[it]->numverts = numverts;
-   ctx->Variable[iv]->SurfTable[it]->numindex = numindex;
+   chunk_isosurf( ctx, ctx->Variable[iv]->SurfTable[it], numverts, numindex,
+                  strip );
    ctx->Variable[iv]->SurfTable[it]->valid = 1;
    ctx->IsoLevel[iv] = level;
      
@@ -1140,6 +1214,84 @@ static void restore_colored_isosurf( Context ctx, FILE *f, int maxparm,
 
 
 
+static void restore_chunked_isosurf( Context ctx, FILE *f, int maxparm,
+                                     int blocklength )
+{
+   int iv, it, c, numverts, numindex, numchunks, colorvar;
+   struct isosurface *surf;
+   float level;
+
+   fread( &iv, INT_SIZE, 1, f );
+   if (iv>=maxparm) {
+      skip( f, blocklength-INT_SIZE );
+      return;
+   }
+   fread( &it, INT_SIZE, 1, f );
+   fread( &level, FLOAT_SIZE, 1, f );
+   fread( &numverts, INT_SIZE, 1, f );
+   fread( &numindex, INT_SIZE, 1, f );
+   fread( &numchunks, INT_SIZE, 1, f );
+   if (iv>=ctx->NumVars || it>=ctx->NumTimes) {
+      skip( f, blocklength - 6*INT_SIZE );
+      return;
+   }
+   recent( ctx, ISOSURF, iv );
+   surf = ctx->Variable[iv]->SurfTable[it];
+
+   wait_write_lock( &surf->lock );
+
+   /* deallocate old surface, if any */
+   free_isosurface( ctx, it, iv );
+
+   /* read isosurface */
+   surf->verts = alloc_and_read( ctx, f, 3*numverts*INT_VERT2_SIZE );
+   surf->norms = alloc_and_read( ctx, f, 3*numverts*INT_1_SIZE );
+   surf->index = alloc_and_read( ctx, f, numindex*UINT_2_SIZE );
+   surf->chunks = (struct iso_chunk *) allocate( ctx,
+                                    numchunks*sizeof(struct iso_chunk) );
+   if (surf->chunks) {
+      for (c=0;c<numchunks;c++) {
+         fread( &surf->chunks[c].vbase, INT_SIZE, 1, f );
+         fread( &surf->chunks[c].numverts, INT_SIZE, 1, f );
+         fread( &surf->chunks[c].ibase, INT_SIZE, 1, f );
+         fread( &surf->chunks[c].numindex, INT_SIZE, 1, f );
+      }
+   }
+   else {
+      skip( f, 4*numchunks*INT_SIZE );
+   }
+   fread( &colorvar, INT_SIZE, 1, f );
+   surf->colors = NULL;
+   if (colorvar>-1) {
+      surf->colors = alloc_and_read( ctx, f, numverts*UINT_1_SIZE );
+   }
+   surf->colorvar = colorvar;
+   surf->isolevel = level;
+   surf->numverts = numverts;
+   surf->numindex = numindex;
+   surf->numchunks = numchunks;
+   if (numverts>0 && (!surf->verts || !surf->norms || !surf->index ||
+                      !surf->chunks || (colorvar>-1 && !surf->colors))) {
+      /* out of memory, keep an empty surface */
+      if (surf->verts) deallocate( ctx, surf->verts, 3*numverts*INT_VERT2_SIZE );
+      if (surf->norms) deallocate( ctx, surf->norms, 3*numverts*INT_1_SIZE );
+      if (surf->colors) deallocate( ctx, surf->colors, numverts*UINT_1_SIZE );
+      free_iso_chunks( ctx, numindex, surf->index, numchunks, surf->chunks );
+      surf->verts = NULL;
+      surf->norms = NULL;
+      surf->colors = NULL;
+      surf->index = NULL;
+      surf->chunks = NULL;
+      surf->numverts = surf->numindex = surf->numchunks = 0;
+   }
+   surf->valid = 1;
+   ctx->IsoLevel[iv] = level;
+
+   done_write_lock( &surf->lock );
+}
+
+
+
 
 static void restore_hslice( Context ctx, FILE *f, int maxparm,
                             int blocklength )
@@ -1370,31 +1522,90 @@ static void restore_cvslice( Context ctx, FILE *f, int maxparm,
 
 
 
+/*
+ * Undo the scaling of a compressed coordinate so that compressing it
+ * again gives back the same integer.
+ */
+static float uncompress_coord( int v, float scale )
+{
+   return (v >= 0 ? v + 0.5F : v - 0.5F) / scale;
+}
+
+
+
 static void restore_traj( Context ctx, FILE *f, int blocklength )
 {
-   int length, kind, group, bytes;
-   struct traj *t;
+   int length, kind, group, numtimes, i, ok;
+   struct traj info;
+   int_vert2 *verts = NULL;
+   int_1 *norms = NULL;
+   uint_vert2 *start = NULL, *len = NULL;
+   float *buf = NULL;
 
    if (ctx->dpy_ctx->NumTraj<MAXTRAJ) {
       fread( &length, INT_SIZE, 1, f );
       fread( &group, INT_SIZE, 1, f );
       recent( ctx, TRAJ, group );
       fread( &kind, INT_SIZE, 1, f );
-      fread( &ctx->NumTimes, INT_SIZE, 1, f );
-/*YO*/
-      t = ctx->dpy_ctx->TrajTable[ctx->dpy_ctx->NumTraj];
-      t->length = length;
-      t->group = group;
-      t->kind = kind;
-      t->verts = alloc_and_read(ctx,f,3*length*INT_VERT2_SIZE);
-      if (kind==1) {
-         /* read ribbon normals */
-         t->norms = alloc_and_read(ctx,f,3*length*UINT_1_SIZE);
+      fread( &numtimes, INT_SIZE, 1, f );
+
+      ok = (length>0 && numtimes>0 && group>=0 && group<VIS5D_TRAJ_SETS);
+      if (ok) {
+         verts = (int_vert2 *) malloc( 3 * length * INT_VERT2_SIZE );
+         norms = (int_1 *) malloc( 3 * length * INT_1_SIZE );
+         start = (uint_vert2 *) malloc( numtimes * UINT_VERT2_SIZE );
+         len = (uint_vert2 *) malloc( numtimes * UINT_VERT2_SIZE );
+         buf = (float *) malloc( 6 * length * sizeof(float) );
+         ok = (verts && norms && start && len && buf);
       }
-      bytes = ctx->NumTimes * UINT_VERT2_SIZE;
-      t->start = alloc_and_read(ctx,f,bytes);
-      t->len = alloc_and_read(ctx,f,bytes);
-      ctx->dpy_ctx->NumTraj++;
+      if (ok) {
+         ok = fread( verts, INT_VERT2_SIZE, 3*length, f ) == 3*length;
+         if (ok && kind==1) {
+            /* read ribbon normals */
+            ok = fread( norms, INT_1_SIZE, 3*length, f ) == 3*length;
+         }
+         ok = ok && fread( start, UINT_VERT2_SIZE, numtimes, f ) == numtimes
+                 && fread( len, UINT_VERT2_SIZE, numtimes, f ) == numtimes;
+      }
+      if (ok && numtimes<ctx->NumTimes) {
+         uint_vert2 *s2, *l2;
+         s2 = (uint_vert2 *) realloc( start, ctx->NumTimes * UINT_VERT2_SIZE );
+         if (s2) {
+            start = s2;
+         }
+         l2 = (uint_vert2 *) realloc( len, ctx->NumTimes * UINT_VERT2_SIZE );
+         if (l2) {
+            len = l2;
+         }
+         ok = (s2 && l2);
+         for (i=numtimes;ok && i<ctx->NumTimes;i++) {
+            start[i] = BADSTART;
+            len[i] = 0;
+         }
+      }
+      if (ok) {
+         /* the set stores vertices and normals compressed again */
+         for (i=0;i<length;i++) {
+            buf[i] = uncompress_coord( verts[i*3+0], VERTEX_SCALE );
+            buf[length+i] = uncompress_coord( verts[i*3+1], VERTEX_SCALE );
+            buf[2*length+i] = uncompress_coord( verts[i*3+2], VERTEX_SCALE );
+            buf[3*length+i] = -uncompress_coord( norms[i*3+0], NORMAL_SCALE );
+            buf[4*length+i] = uncompress_coord( norms[i*3+1], NORMAL_SCALE );
+            buf[5*length+i] = uncompress_coord( norms[i*3+2], NORMAL_SCALE );
+         }
+         memset( &info, 0, sizeof(info) );
+         info.group = group;
+         info.kind = kind;
+         append_traj( ctx->dpy_ctx, ctx, &info, length,
+                      buf, buf+length, buf+2*length,
+                      kind==1 ? buf+3*length : NULL, buf+4*length, buf+5*length,
+                      start, len, ctx->context_index, -1 );
+      }
+      free( verts );
+      free( norms );
+      free( start );
+      free( len );
+      free( buf );
    }
    else {
       skip( f, blocklength );
@@ -1720,6 +1931,10 @@ int restore( Context ctx, const char *savefile )
             restore_colored_isosurf( ctx, f, maxparm, blocklength );
             break;
 
+         case TAG_CHUNKED_ISOSURF:
+            restore_chunked_isosurf( ctx, f, maxparm, blocklength );
+            break;
+
          case TAG_ISO_COLOR: {
             int var;
             fread( &var, INT_SIZE, 1, f );
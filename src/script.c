@@ -72,8 +72,8 @@
 
 #define MAX_COMMANDS 400
 #define MAX_ARGS     100
-#define MAX_ARG_LEN  100
 #define MAX_VARS     100
+#define MAX_VAR_LEN  100
 
 #define TCL_RESULT_SIZE 200
 
@@ -83,6 +83,17 @@
 #define TCL_BREAK     3
 #define TCL_CONTINUE  4
 
+/* sizes of the name hash tables, powers of 2 at least twice the maximum */
+/* number of names */
+#define CMD_HASH_SIZE  1024
+#define VAR_HASH_SIZE  256
+
+/* number of compiled commands kept for Tcl_Eval(), a power of 2 */
+#define CODE_CACHE_SIZE  1024
+
+/* number of compiled script files kept for Tcl_EvalFile() */
+#define MAX_SCRIPTS  8
+
 
 typedef void *ClientData;
 
@@ -107,39 +118,161 @@ struct private {
    char        cmd_name[MAX_COMMANDS][100];    /* command names */
    Tcl_CmdProc *cmd_func[MAX_COMMANDS];        /* command C func pointers */
    ClientData  client_data[MAX_COMMANDS];      /* client's data */
+   short       cmd_hash[CMD_HASH_SIZE];        /* command number + 1 by name */
 
    int         num_vars;                       /* number of variables */
    char        var_name[MAX_VARS][100];        /* names of variables */
-   char        var_value[MAX_VARS][100];       /* values of variables */
+   char        var_value[MAX_VARS][MAX_VAR_LEN];  /* values of variables */
+   short       var_hash[VAR_HASH_SIZE];        /* variable number + 1 by name */
+};
+
+
+/*
+ * A command broken into its words once by compile_command() so it can be
+ * run any number of times by run_code().  Words starting with $ are
+ * replaced by the variable's value when the command is run.
+ */
+struct code {
+   char          *text;       /* the command, NULL if it's from a file */
+   unsigned int  texthash;    /* hash_name() of text */
+   int           argc;        /* number of words, -1 if too many */
+   char          *words;      /* the words, each 0 terminated */
+   const char    **word;      /* [argc] pointers into words */
+   unsigned int  *hash;       /* [argc] hash_name() of command/variable names */
+   int           busy;        /* number of runs in progress */
+   int           cached;      /* still in CodeCache? */
+};
+
+
+/* A script file compiled by Tcl_EvalFile() */
+struct script {
+   char          *filename;
+   char          *source;     /* contents of the file when it was compiled */
+   long          size;
+   int           numcmds;
+   struct code   **cmds;
+   int           busy;        /* number of runs in progress */
+   int           cached;      /* still in Scripts? */
+   unsigned int  lastuse;
 };
 
 
 static char TmpResult[TCL_RESULT_SIZE];
 
+static struct code *CodeCache[CODE_CACHE_SIZE];
+static struct script *Scripts[MAX_SCRIPTS];
+static unsigned int ScriptClock = 0;
+
 static int Tcl_EvalFile( Tcl_Interp *interp, const char *filename );
 
 static int pack_withscale(int index, int graphic, int varowner, int var, unsigned int *ctable,int entry,int r,int g,int b,int a);
 
 
+static unsigned int hash_name( const char *name )
+{
+   unsigned int h = 5381;
+   while (*name) {
+      h = h * 33 + (unsigned char) *name++;
+   }
+   return h;
+}
+
+
 /*
- * Assign a value to a variable.
+ * Return the number of the named command, or -1.
  */
-static void assign_var( Tcl_Interp *interp, const char *varname, const char *value )
+static int find_command( struct private *p, const char *name,
+                         unsigned int hash )
 {
-   int i;
+   int i = hash & (CMD_HASH_SIZE-1);
 
-   for (i=0;i<interp->p->num_vars;i++) {
-      if (strcmp(interp->p->var_name[i], varname)==0) {
-         /* var already defined, replace its value */
-         strcpy( interp->p->var_value[i], value );
-         return;
+   while (p->cmd_hash[i]) {
+      int k = p->cmd_hash[i] - 1;
+      if (strcmp(p->cmd_name[k], name)==0) {
+         return k;
       }
+      i = (i+1) & (CMD_HASH_SIZE-1);
+   }
+   return -1;
+}
+
+
+/*
+ * Return the number of the named variable, or -1.
+ */
+static int find_var( struct private *p, const char *name, unsigned int hash )
+{
+   int i = hash & (VAR_HASH_SIZE-1);
+
+   while (p->var_hash[i]) {
+      int k = p->var_hash[i] - 1;
+      if (strcmp(p->var_name[k], name)==0) {
+         return k;
+      }
+      i = (i+1) & (VAR_HASH_SIZE-1);
+   }
+   return -1;
+}
+
+
+/*
+ * Add a command, unless there's already one with that name.
+ */
+static int add_command( struct private *p, const char *name,
+                        Tcl_CmdProc *proc, ClientData client_data )
+{
+   unsigned int hash = hash_name( name );
+   int i;
+
+   if (find_command( p, name, hash )>=0) {
+      return 1;
+   }
+   if (p->num_cmd>=MAX_COMMANDS) {
+      return 0;
    }
-   /* new variable */
-   i = interp->p->num_vars;
-   strcpy( interp->p->var_name[i], varname );
-   strcpy( interp->p->var_value[i], value );
-   interp->p->num_vars++;
+   strcpy( p->cmd_name[p->num_cmd], name );
+   p->cmd_func[p->num_cmd] = proc;
+   p->client_data[p->num_cmd] = client_data;
+   for (i=hash & (CMD_HASH_SIZE-1); p->cmd_hash[i];
+        i=(i+1) & (CMD_HASH_SIZE-1))
+      ;
+   p->num_cmd++;
+   p->cmd_hash[i] = p->num_cmd;
+   return 1;
+}
+
+
+/*
+ * Assign a value to a variable.  Note that value may be the variable's
+ * current value.
+ * Return:  1 = ok, 0 = too many variables
+ */
+static int assign_var( Tcl_Interp *interp, const char *varname, const char *value )
+{
+   struct private *p = interp->p;
+   unsigned int hash = hash_name( varname );
+   int i, len;
+
+   i = find_var( p, varname, hash );
+   if (i<0) {
+      /* new variable */
+      if (p->num_vars>=MAX_VARS) {
+         return 0;
+      }
+      i = p->num_vars++;
+      strcpy( p->var_name[i], varname );
+      for (len=hash & (VAR_HASH_SIZE-1); p->var_hash[len];
+           len=(len+1) & (VAR_HASH_SIZE-1))
+         ;
+      p->var_hash[len] = i + 1;
+   }
+   len = strlen( value );
+   if (len>=MAX_VAR_LEN) {
+      len = MAX_VAR_LEN - 1;
+   }
+   memmove( p->var_value[i], value, len );
+   p->var_value[i][len] = 0;
+   return 1;
 }
 
 
@@ -150,13 +283,11 @@ static void assign_var( Tcl_Interp *interp, const char *varname, const char *val
  */
 static int eval_var( Tcl_Interp *interp, const char *varname, char *result )
 {
-   int i;
+   int i = find_var( interp->p, varname, hash_name(varname) );
 
-   for (i=0;i<interp->p->num_vars;i++) {
-      if (strcmp(interp->p->var_name[i],varname)==0) {
-         strcpy( result, interp->p->var_value[i] );
-         return 1;
-      }
+   if (i>=0) {
+      strcpy( result, interp->p->var_value[i] );
+      return 1;
    }
    /* var not found */
    return 0;
@@ -182,8 +313,12 @@ static int cmd_set( ClientData client_data, Tcl_Interp *interp,
       }
    }
    else if (argc==3) {
-      assign_var( interp, argv[1], argv[2] );
-      strcpy( interp->result, argv[2] );
+      if (!assign_var( interp, argv[1], argv[2] )) {
+         sprintf( interp->result, "too many variables" );
+         return TCL_ERROR;
+      }
+      strcpy( interp->result, interp->p->var_value[
+                 find_var( interp->p, argv[1], hash_name(argv[1]) )] );
       return TCL_OK;
    }
    else {
@@ -219,13 +354,8 @@ static Tcl_Interp *Tcl_CreateInterp( void )
    interp = (Tcl_Interp *) calloc( 1, sizeof(Tcl_Interp) );
    if (interp) {
       interp->p = (struct private *) calloc( 1, sizeof(struct private) );
-      /* register the set command */
-      strcpy( interp->p->cmd_name[0], "set" );
-      interp->p->cmd_func[0] = cmd_set;
-      /* register the sourc command */
-      strcpy( interp->p->cmd_name[1], "source" );
-      interp->p->cmd_func[1] = cmd_source;
-      interp->p->num_cmd = 2;
+      add_command( interp->p, "set", cmd_set, NULL );
+      add_command( interp->p, "source", cmd_source, NULL );
    }
    return interp;
 }
@@ -241,37 +371,51 @@ static void Tcl_DeleteInterp( Tcl_Interp *interp )
 }
 
 
+
+static void free_code( struct code *code )
+{
+   if (code->text) {
+      free( code->text );
+   }
+   free( code );
+}
+
+
 /*
- * Evaluate a Tcl/Vis5D command.
+ * Break a command into words.  Text in "..." or {...} is one word.
+ * Return:  the compiled command, or NULL if out of memory
  */
-static int Tcl_Eval( Tcl_Interp *interp, char *cmd )
+static struct code *compile_command( const char *cmd )
 {
-   int argc;
-   const char *argv[MAX_ARGS];
-   char arg[MAX_ARGS][MAX_ARG_LEN];
-   char error[1000];
-   int i;
-   char *cp;
+   struct code *code;
+   char buffer[1000], *words, *w, *start;
+   int first[MAX_ARGS];
+   const char *cp;
    int inquote;  /* inside a quoted string? */
    int inlist;   /* inside a {...} list? */
+   int argc, toomany, len, i;
 
-   /* Init results string */
-   interp->result = TmpResult;
-   interp->result[0] = 0;
-
-   if (cmd[0]=='#') {
-      /* comment */
-      return TCL_OK;
+   len = strlen(cmd) + 2;
+   words = len <= sizeof(buffer) ? buffer : (char *) malloc( len );
+   if (!words) {
+      return NULL;
    }
 
-   /* break cmd string into an argv list */
+#define END_WORD                                 \
+   if (w>start) {                                \
+      *w++ = 0;                                  \
+      if (argc<MAX_ARGS) {                       \
+         first[argc] = start - words;            \
+      }                                          \
+      argc++;                                    \
+   }                                             \
+   start = w;
 
-   cp = cmd;
+   w = start = words;
    argc = 0;
-   i = 0;
    inquote = 0;
    inlist = 0;
-   while (*cp) {
+   for (cp=cmd; *cp && cmd[0]!='#'; cp++) {
       if (*cp=='\"') {
          if (!inquote) {
             /* just skip the opening quote */
@@ -279,126 +423,323 @@ static int Tcl_Eval( Tcl_Interp *interp, char *cmd )
          }
          else {
             /* end of quoted string */
-            if (i>0) {
-               /* finish token */
-               arg[argc][i] = 0;
-               argc++;
-               i = 0;
-            }
+            END_WORD
             inquote = 0;
          }
       }
       else if (*cp=='{' && !inquote) {
-         /* begining of a list */
+         /* begining of a list, ignore '{' char */
          inlist = 1;
-         /* ignore '{' char */
       }
       else if (*cp=='}' && !inquote) {
          /* end of list */
-         if (i>0) {
-            /* finish token */
-            arg[argc][i] = 0;
-            argc++;
-            i = 0;
-         }
+         END_WORD
          inlist = 0;
       }
       else if ((*cp==' ' || *cp=='\t' || *cp=='\n') && !inquote && !inlist) {
-         if (i>0) {
-            /* end of a token */
-            arg[argc][i] = 0;
-            argc++;
-            i = 0;
-         }
+         END_WORD
       }
       else {
-         /* add char to current token */
-         arg[argc][i++] = *cp;
+         /* add char to current word */
+         *w++ = *cp;
       }
-      cp++;
    }
-   /* finish last token */
-   if (i>0) {
-      arg[argc][i] = 0;
-      argc++;
+   END_WORD
+#undef END_WORD
+
+   /* the code, word pointers, hashes and words in one block */
+   len = w - words;
+   toomany = argc>MAX_ARGS;
+   if (toomany) {
+      argc = 0;
+      len = 0;
+   }
+   code = (struct code *) malloc( sizeof(struct code)
+                                  + argc * (sizeof(char *) + sizeof(int))
+                                  + len );
+   if (code) {
+      memset( code, 0, sizeof(struct code) );
+      code->word = (const char **) (code + 1);
+      code->hash = (unsigned int *) (code->word + argc);
+      code->words = (char *) (code->hash + argc);
+      memcpy( code->words, words, len );
+      code->argc = toomany ? -1 : argc;
+      for (i=0;i<argc;i++) {
+         const char *name = code->words + first[i];
+         code->word[i] = name;
+         code->hash[i] = hash_name( name[0]=='$' ? name+1 : name );
+      }
    }
+   if (words!=buffer) {
+      free( words );
+   }
+   return code;
+}
 
-   if (argc==0) {
+
+/*
+ * Run a compiled command.
+ */
+static int run_code( Tcl_Interp *interp, const struct code *code )
+{
+   struct private *p = interp->p;
+   const char *argv[MAX_ARGS];
+   int i, k;
+
+   /* Init results string */
+   interp->result = TmpResult;
+   interp->result[0] = 0;
+
+   if (code->argc<0) {
+      sprintf( interp->result, "too many arguments" );
+      return TCL_ERROR;
+   }
+   if (code->argc==0) {
       /* no arguments is OK */
       return TCL_OK;
    }
 
-   /* setup pointers */
-   for (i=0;i<argc;i++) {
-      argv[i] = arg[i];
-   }
-
    /* Perform variable substitution for args with $ prefix */
-   for (i=0;i<argc;i++) {
-      if (arg[i][0]=='$') {
-         if (!eval_var( interp, arg[i]+1, arg[i] )) {
+   for (i=0;i<code->argc;i++) {
+      argv[i] = code->word[i];
+      if (argv[i][0]=='$') {
+         k = find_var( p, argv[i]+1, code->hash[i] );
+         if (k<0) {
             sprintf( interp->result,
-                     "can't read \"%s\": no such variable", arg[i]+1 );
+                     "can't read \"%s\": no such variable", argv[i]+1 );
             return TCL_ERROR;
          }
+         argv[i] = p->var_value[k];
       }
    }
 
-   /* Now search for function which matches arg[0] */
-   for (i=0;i<interp->p->num_cmd;i++) {
-      if (strcmp(interp->p->cmd_name[i],arg[0])==0) {
-         /* call the user-function */
-         int code;
-         code = (*interp->p->cmd_func[i])
-                           ( interp->p->client_data[i], interp, argc, argv );
-         return code;
-      }
+   /* Now find the function named by arg[0] */
+   k = find_command( p, argv[0], code->word[0][0]=='$' ? hash_name(argv[0])
+                                                       : code->hash[0] );
+   if (k>=0) {
+      /* call the user-function */
+      return (*p->cmd_func[k])( p->client_data[k], interp, code->argc, argv );
    }
 
    /* command not found! */
-   sprintf( interp->result, "invalid command name \"%s\"", arg[0] );
+   sprintf( interp->result, "invalid command name \"%s\"", argv[0] );
    return TCL_ERROR;
 }
 
 
+/*
+ * Evaluate a Tcl/Vis5D command.  Commands are compiled the first time
+ * they're seen and kept in CodeCache by their text.
+ */
+static int Tcl_Eval( Tcl_Interp *interp, char *cmd )
+{
+   unsigned int hash = hash_name( cmd );
+   int slot = hash & (CODE_CACHE_SIZE-1);
+   struct code *code = CodeCache[slot];
+   int result;
+
+   if (!code || code->texthash!=hash || strcmp(code->text, cmd)!=0) {
+      code = compile_command( cmd );
+      if (code) {
+         code->text = strdup( cmd );
+      }
+      if (!code || !code->text) {
+         if (code) {
+            free_code( code );
+         }
+         interp->result = TmpResult;
+         sprintf( interp->result, "out of memory" );
+         return TCL_ERROR;
+      }
+      code->texthash = hash;
+      if (CodeCache[slot]) {
+         /* a command being run may evict itself by running others */
+         CodeCache[slot]->cached = 0;
+         if (!CodeCache[slot]->busy) {
+            free_code( CodeCache[slot] );
+         }
+      }
+      code->cached = 1;
+      CodeCache[slot] = code;
+   }
+
+   code->busy++;
+   result = run_code( interp, code );
+   code->busy--;
+   if (!code->cached && !code->busy) {
+      free_code( code );
+   }
+   return result;
+}
+
+
+
+static void free_script( struct script *s )
+{
+   int i;
+
+   for (i=0;i<s->numcmds;i++) {
+      free_code( s->cmds[i] );
+   }
+   if (s->cmds) {
+      free( s->cmds );
+   }
+   free( s->filename );
+   free( s->source );
+   free( s );
+}
+
 
 /*
- * Evaluate Tcl/Vis5D commands from a text file.
+ * Compile a script, one command per line.
+ * Return:  the compiled script, or NULL if out of memory
  */
-static int Tcl_EvalFile( Tcl_Interp *interp, const char *filename )
+static struct script *compile_script( const char *filename, char *source,
+                                      long size )
+{
+   struct script *s;
+   char *line, *end;
+   int n;
+
+   s = (struct script *) calloc( 1, sizeof(struct script) );
+   if (!s) {
+      return NULL;
+   }
+   s->filename = strdup( filename );
+   s->source = source;
+   s->size = size;
+
+   n = 1;
+   for (line=source; line<source+size; line++) {
+      n += (*line=='\n');
+   }
+   s->cmds = (struct code **) malloc( n * sizeof(struct code *) );
+   if (!s->filename || !s->cmds) {
+      free_script( s );
+      return NULL;
+   }
+
+   /* work on a copy, which compile_command() doesn't keep */
+   line = (char *) malloc( size + 1 );
+   if (!line) {
+      free_script( s );
+      return NULL;
+   }
+   memcpy( line, source, size );
+   line[size] = 0;
+   for (end=line; end<line+size; end++) {
+      if (*end=='\n') {
+         *end = 0;
+      }
+   }
+   for (end=line; end<line+size; end+=strlen(end)+1) {
+      if (*end) {
+         struct code *code = compile_command( end );
+         if (!code) {
+            free( line );
+            free_script( s );
+            return NULL;
+         }
+         s->cmds[s->numcmds++] = code;
+      }
+   }
+   free( line );
+   return s;
+}
+
+
+/*
+ * Read a whole file.
+ * Return:  malloc'd contents, or NULL
+ */
+static char *read_script( const char *filename, long *size )
 {
-#define MAXLINE 1000
    FILE *f;
-   char line[MAXLINE];
-   int len, code;
+   char *source;
 
    f = fopen( filename, "r" );
    if (!f) {
-      interp->result = TmpResult;
-      interp->result[0] = 0;
+      return NULL;
+   }
+   fseek( f, 0, SEEK_END );
+   *size = ftell( f );
+   fseek( f, 0, SEEK_SET );
+   source = (char *) malloc( *size + 1 );
+   if (source) {
+      *size = fread( source, 1, *size, f );
+   }
+   fclose(f);
+   return source;
+}
+
+
+/*
+ * Evaluate Tcl/Vis5D commands from a text file.  The compiled script is
+ * kept in Scripts and used again if the file hasn't changed.
+ */
+static int Tcl_EvalFile( Tcl_Interp *interp, const char *filename )
+{
+   struct script *s;
+   char *source;
+   long size;
+   int i, code;
+
+   interp->result = TmpResult;
+   interp->result[0] = 0;
+
+   source = read_script( filename, &size );
+   if (!source) {
       return TCL_ERROR;
    }
 
-   while (!feof(f)) {
-      fgets( line, MAXLINE, f );
-      if (!feof(f)) {
-         len = strlen(line);
-         if (len>0) {
-            /* if length > 0 then remove trailing newline and eval it */
-            if (line[len-1]=='\n') {
-               line[len-1] = 0;
-            }
-            code = Tcl_Eval( interp, line );
-            if (code!=TCL_OK) {
-               fclose(f);
-               return code;
-            }
+   s = NULL;
+   for (i=0;i<MAX_SCRIPTS;i++) {
+      if (Scripts[i] && strcmp(Scripts[i]->filename, filename)==0
+          && Scripts[i]->size==size
+          && memcmp(Scripts[i]->source, source, size)==0) {
+         s = Scripts[i];
+         free( source );
+         break;
+      }
+   }
+   if (!s) {
+      int oldest = 0;
+      s = compile_script( filename, source, size );
+      if (!s) {
+         free( source );
+         sprintf( interp->result, "out of memory" );
+         return TCL_ERROR;
+      }
+      for (i=0;i<MAX_SCRIPTS;i++) {
+         if (!Scripts[i]) {
+            oldest = i;
+            break;
+         }
+         if (Scripts[i]->lastuse < Scripts[oldest]->lastuse) {
+            oldest = i;
          }
       }
+      if (Scripts[oldest]) {
+         Scripts[oldest]->cached = 0;
+         if (!Scripts[oldest]->busy) {
+            free_script( Scripts[oldest] );
+         }
+      }
+      s->cached = 1;
+      Scripts[oldest] = s;
    }
+   s->lastuse = ++ScriptClock;
 
-   fclose(f);
-   return TCL_OK;
+   s->busy++;
+   code = TCL_OK;
+   for (i=0;i<s->numcmds && code==TCL_OK;i++) {
+      code = run_code( interp, s->cmds[i] );
+   }
+   s->busy--;
+   if (!s->cached && !s->busy) {
+      free_script( s );
+   }
+   return code;
 }
 
 
@@ -411,12 +752,7 @@ static Tcl_Command Tcl_CreateCommand( Tcl_Interp *interp,
                                       ClientData clientData,
                                       Tcl_CmdDeleteProc *deleteProc )
 {
-   if (interp->p->num_cmd<MAX_COMMANDS) {
-      strcpy( interp->p->cmd_name[interp->p->num_cmd], cmdName );
-      interp->p->cmd_func[interp->p->num_cmd] = proc;
-      interp->p->num_cmd++;
-   }
-   else {
+   if (!add_command( interp->p, cmdName, proc, clientData )) {
       printf("Fatal error in Tcl_CreateCommand!\n");
       abort();
    }
@@ -474,29 +810,21 @@ static NameValue *NameValueHead = NULL;
  */
 static int string_to_float_array( const char *str, int max, float x[] )
 {
-   char buffer[100];
-   int i, j, n;
+   int n;
 
-   j = 0;
    n = 0;
-   for (i=0;str[i];i++) {
-      if (!isspace(str[i])) {
-         buffer[j++] = str[i];
+   while (n<max) {
+      while (isspace(*str)) {
+         str++;
       }
-      else {
-         /* found white space */
-         if (j>0) {
-            buffer[j] = 0;
-            x[n] = atof(buffer);
-            n++;
-            j = 0;
-         }
+      if (!*str) {
+         break;
+      }
+      /* like atof() of the whole word */
+      x[n++] = (float) strtod( str, NULL );
+      while (*str && !isspace(*str)) {
+         str++;
       }
-   }
-   if (j>0) {
-      buffer[j] = 0;
-      x[n] = atof(buffer);
-      n++;
    }
    return n;
 }
@@ -1380,6 +1708,37 @@ static int cmd_init_memory( ClientData client_data, Tcl_Interp *interp,
    return error_check( interp, "vis5d_init_memory", result );
 }
 
+
+static int cmd_get_memory_stats( ClientData client_data, Tcl_Interp *interp,
+                                 int argc, const char *argv[] )
+{
+   char name[100];
+   long int bytes, peak;
+   int blocks, allocs, result;
+   if (!arg_check( interp, "vis5d_get_memory_stats", argc, 2, 2 )) {
+      return TCL_ERROR;
+   }
+   result = vis5d_get_memory_stats( atoi(argv[1]), atoi(argv[2]), name,
+                                    &bytes, &peak, &blocks, &allocs );
+   if (result==0) {
+      sprintf( interp->result, "%s %ld %ld %d %d", name, bytes, peak,
+               blocks, allocs );
+   }
+   return error_check( interp, "vis5d_get_memory_stats", result );
+}
+
+
+static int cmd_set_memory_log( ClientData client_data, Tcl_Interp *interp,
+                               int argc, const char *argv[] )
+{
+   int result;
+   if (!arg_check( interp, "vis5d_set_memory_log", argc, 1, 2 )) {
+      return TCL_ERROR;
+   }
+   result = vis5d_set_memory_log( argv[1], argc>2 ? atoi(argv[2]) : 60 );
+   return error_check( interp, "vis5d_set_memory_log", result );
+}
+
 #ifdef HAVE_LIBNETCDF
 static int cmd_init_irregular_memory( ClientData client_data, Tcl_Interp *interp,
                             int argc, const char *argv[] )
@@ -2275,6 +2634,136 @@ static int cmd_get_grid_value( ClientData client_data, Tcl_Interp *interp,
    return error_check( interp, "vis5d_get_grid_value", result );
 }
 
+
+/* Most values the time series commands return */
+#define MAX_SERIES_VALUES  (16*1024*1024)
+
+
+/*
+ * Compute the number of values in a time series result.
+ * Input:  numdims - number of dimensions
+ *         dims - size of each dimension
+ * Output:  size - the product of the sizes
+ * Return:  1 = ok, 0 = a size is negative or the product is more than
+ *          MAX_SERIES_VALUES
+ */
+static int series_size( int numdims, const int dims[], size_t *size )
+{
+   int i;
+
+   *size = 1;
+   for (i=0;i<numdims;i++) {
+      if (dims[i]<0 ||
+          (dims[i]>0 && *size > MAX_SERIES_VALUES / (size_t) dims[i])) {
+         return 0;
+      }
+      *size *= (size_t) dims[i];
+   }
+   return 1;
+}
+
+
+/*
+ * vis5d_get_time_series ctx var time0 numtimes {row col lev ...}
+ * returns the values at the positions, one timestep after another.
+ */
+static int cmd_get_time_series( ClientData client_data, Tcl_Interp *interp,
+                                int argc, const char *argv[] )
+{
+   int result, numtimes, numpoints, dims[2];
+   size_t i, n;
+   float *points, *series;
+   char val[100];
+
+   if (!arg_check( interp, "vis5d_get_time_series", argc, 5, 5 )) {
+      return TCL_ERROR;
+   }
+   numtimes = atoi(argv[4]);
+   /* at most one number per two characters of the list */
+   points = (float *) malloc( (strlen(argv[5])/2 + 1) * sizeof(float) );
+   if (!points) {
+      return error_check( interp, "vis5d_get_time_series",
+                          VIS5D_OUT_OF_MEMORY );
+   }
+   numpoints = string_to_float_array( argv[5], strlen(argv[5])/2 + 1,
+                                      points ) / 3;
+   dims[0] = numtimes;
+   dims[1] = numpoints;
+   if (!series_size( 2, dims, &n )) {
+      free( points );
+      return error_check( interp, "vis5d_get_time_series",
+                          VIS5D_BAD_VALUE );
+   }
+   series = (float *) malloc( (n>0 ? n : 1) * sizeof(float) );
+   if (!series) {
+      free( points );
+      return error_check( interp, "vis5d_get_time_series",
+                          VIS5D_OUT_OF_MEMORY );
+   }
+
+   result = vis5d_get_time_series( atoi(argv[1]), atoi(argv[2]),
+                                   atoi(argv[3]), numtimes, numpoints,
+                                   points, series );
+   if (result==0) {
+      for (i=0;i<n;i++) {
+         sprintf( val, "%g", series[i] );
+         Tcl_AppendElement( interp, val );
+      }
+   }
+   free( points );
+   free( series );
+   return error_check( interp, "vis5d_get_time_series", result );
+}
+
+
+/*
+ * vis5d_get_time_series_box ctx var time0 numtimes row0 col0 lev0 nr nc nl
+ * returns the grid values of the box, one timestep after another.
+ */
+static int cmd_get_time_series_box( ClientData client_data,
+                                    Tcl_Interp *interp,
+                                    int argc, const char *argv[] )
+{
+   int result, numtimes, nr, nc, nl, dims[4];
+   size_t i, n;
+   float *series;
+   char val[100];
+
+   if (!arg_check( interp, "vis5d_get_time_series_box", argc, 10, 10 )) {
+      return TCL_ERROR;
+   }
+   numtimes = atoi(argv[4]);
+   nr = atoi(argv[8]);
+   nc = atoi(argv[9]);
+   nl = atoi(argv[10]);
+   dims[0] = numtimes;
+   dims[1] = nr;
+   dims[2] = nc;
+   dims[3] = nl;
+   if (!series_size( 4, dims, &n )) {
+      return error_check( interp, "vis5d_get_time_series_box",
+                          VIS5D_BAD_VALUE );
+   }
+   series = (float *) malloc( (n>0 ? n : 1) * sizeof(float) );
+   if (!series) {
+      return error_check( interp, "vis5d_get_time_series_box",
+                          VIS5D_OUT_OF_MEMORY );
+   }
+
+   result = vis5d_get_time_series_box( atoi(argv[1]), atoi(argv[2]),
+                                       atoi(argv[3]), numtimes,
+                                       atoi(argv[5]), atoi(argv[6]),
+                                       atoi(argv[7]), nr, nc, nl, series );
+   if (result==0) {
+      for (i=0;i<n;i++) {
+         sprintf( val, "%g", series[i] );
+         Tcl_AppendElement( interp, val );
+      }
+   }
+   free( series );
+   return error_check( interp, "vis5d_get_time_series_box", result );
+}
+
 static int cmd_get_grid_rows( ClientData client_data, Tcl_Interp *interp,
                               int argc, const char *argv[] )
 {
@@ -5753,21 +6242,30 @@ static int cmd_print_traj( ClientData client_data, Tcl_Interp *interp,
                           int argc, const char *argv[] )
 {
    int i, result, numtimes;
-   char val[200];
-   float lat[MAXTIMES],
-         lon[MAXTIMES],
-         hgt[MAXTIMES],
-         value[MAXTIMES];
+   float *lat, *lon, *hgt, *value;
 
    if (!arg_check( interp, "vis5d_print_traj", argc, 2, 2)){
       return TCL_ERROR;
    }
+   result = vis5d_get_dtx_numtimes( atoi(argv[1]), &numtimes);
+   if (result) {
+      return error_check( interp, "vis5d_print_traj", result );
+   }
+   lat = (float *) malloc( 4 * (numtimes>0 ? numtimes : 1) * sizeof(float) );
+   if (!lat) {
+      return error_check( interp, "vis5d_print_traj", VIS5D_OUT_OF_MEMORY );
+   }
+   lon = lat + numtimes;
+   hgt = lon + numtimes;
+   value = hgt + numtimes;
    result = vis5d_print_traj( atoi(argv[1]), atoi(argv[2]),
                               lat, lon, hgt, value);
-   vis5d_get_dtx_numtimes( atoi(argv[1]), &numtimes);
-   for (i=0; i < numtimes; i++){
-      printf("%d %f %f %f %f\n", i, lat[i], lon[i], hgt[i], value[i]);
+   if (result==0) {
+      for (i=0; i < numtimes; i++){
+         printf("%d %f %f %f %f\n", i, lat[i], lon[i], hgt[i], value[i]);
+      }
    }
+   free( lat );
    return TCL_OK;
 }
 
@@ -6877,6 +7375,8 @@ static void register_api_commands( Tcl_Interp *interp )
    REGISTER( "vis5d_init_log", cmd_init_log );
    REGISTER( "vis5d_init_box", cmd_init_box );
    REGISTER( "vis5d_init_memory", cmd_init_memory );
+   REGISTER( "vis5d_get_memory_stats", cmd_get_memory_stats );
+   REGISTER( "vis5d_set_memory_log", cmd_set_memory_log );
 #ifdef HAVE_LIBNETCDF
    REGISTER( "vis5d_init_irregular_memory", cmd_init_irregular_memory );
 #endif
@@ -6954,6 +7454,8 @@ static void register_api_commands( Tcl_Interp *interp )
    /* Grid functions */
 /* MJK 6.9.99 */
    REGISTER( "vis5d_get_grid_value", cmd_get_grid_value );
+   REGISTER( "vis5d_get_time_series", cmd_get_time_series );
+   REGISTER( "vis5d_get_time_series_box", cmd_get_time_series_box );
    REGISTER( "vis5d_get_grid_rows", cmd_get_grid_rows );
    REGISTER( "vis5d_get_grid_columns", cmd_get_grid_columns );
    REGISTER( "vis5d_get_grid_levels", cmd_get_grid_levels );
@@ -7252,6 +7754,46 @@ int execute_script( int index, char *filename )
 
 
 
+/*
+ * Evaluate one Tcl command for the request server.  Each display gets an
+ * interpreter which lives as long as the program so variables and procs
+ * defined by one request can be used by the next.
+ * Input:  index - the display context index
+ *         command - the Tcl command
+ * Output:  result - the interpreter's result, valid until the next call
+ * Return:  1 = success, 0 = error
+ */
+int eval_script_command( int index, char *command, const char **result )
+{
+   static Tcl_Interp *interps[VIS5D_MAX_DPY_CONTEXTS];
+   Tcl_Interp *interp;
+   char setup_cmd[100];
+   int chowmany, cwhichones[VIS5D_MAX_CONTEXTS];
+   int code;
+
+   if (index<0 || index>=VIS5D_MAX_DPY_CONTEXTS) {
+      *result = "bad display context";
+      return 0;
+   }
+   interp = interps[index];
+   if (!interp) {
+      interp = interps[index] = Tcl_CreateInterp();
+      register_api_commands( interp );
+      register_vis5d_gui_commands( interp );
+      sprintf( setup_cmd, "set dtx %d", index );
+      code = Tcl_Eval( interp, setup_cmd );
+      vis5d_get_num_of_ctxs_in_display( index, &chowmany, cwhichones);
+      sprintf( setup_cmd, "set ctx %d", chowmany > 0 ? cwhichones[0] : 0 );
+      code = Tcl_Eval( interp, setup_cmd );
+   }
+
+   code = Tcl_Eval( interp, command );
+   *result = interp->result ? interp->result : "";
+   return code==TCL_OK;
+}
+
+
+
 int interpret( int index )
 {
    Tcl_Interp *interp = NULL;
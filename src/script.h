@@ -36,6 +36,10 @@
 extern int execute_script( int index, char *filename );
 
 
+extern int eval_script_command( int index, char *command,
+                                const char **result );
+
+
 extern int interpret( int index );
 
 
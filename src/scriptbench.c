@@ -0,0 +1,146 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "../config.h"
+
+
+/*
+ * Benchmark of the script interpreter.
+ *
+ * A script like the ones which animate through the timesteps, with a
+ * few commands per frame, is run several times with execute_script().
+ * The first run has to read and parse it; later runs can use what the
+ * interpreter kept from the first.  Then commands are sent one at a
+ * time with eval_script_command(), as the request server does.  The
+ * commands used don't need any data to be loaded, so the times are
+ * mostly interpreter overhead.
+ *
+ * Build with "make scriptbench" in the src directory.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "script.h"
+
+
+/* commands per frame in the generated script */
+#define FRAME_CMDS  6
+
+
+static double now( void )
+{
+   struct timeval tv;
+   gettimeofday( &tv, NULL );
+   return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+
+/*
+ * Write a script which steps through frames timesteps.
+ * Return:  1 = ok, 0 = error
+ */
+static int write_script( const char *filename, int frames )
+{
+   FILE *f;
+   int i;
+
+   f = fopen( filename, "w" );
+   if (!f) {
+      perror( filename );
+      return 0;
+   }
+   for (i=0;i<frames;i++) {
+      fprintf( f, "# frame %d\n", i );
+      fprintf( f, "set t %d\n", i );
+      fprintf( f, "vis5d_set_name_value timestep $t\n" );
+      fprintf( f, "vis5d_get_name_value timestep\n" );
+      fprintf( f, "set view {%d.5 1.25 -0.75}\n", i % 360 );
+      fprintf( f, "vis5d_set_name_value view $view\n" );
+      fprintf( f, "vis5d_get_name_value view\n" );
+   }
+   fprintf( f, "vis5d_set_name_value done 1\n" );
+   fclose( f );
+   return 1;
+}
+
+
+int main( int argc, char *argv[] )
+{
+   char filename[100], cmd[100];
+   const char *result;
+   double t0, t;
+   int frames, reps, ncmds, i, r, bad;
+
+   frames = (argc > 1) ? atoi( argv[1] ) : 20000;
+   reps = (argc > 2) ? atoi( argv[2] ) : 5;
+   if (frames < 1 || reps < 1) {
+      printf("Usage:\n");
+      printf("   scriptbench [frames [repetitions]]\n");
+      exit(0);
+   }
+
+   sprintf( filename, "/tmp/scriptbench%d.tcl", (int) getpid() );
+   if (!write_script( filename, frames )) {
+      exit(1);
+   }
+   ncmds = frames * FRAME_CMDS + 1;
+
+   bad = 0;
+   for (r=0;r<reps;r++) {
+      t0 = now();
+      bad += execute_script( 0, filename ) != 1;
+      t = now() - t0;
+      printf("script run %d: %d commands  %.3f sec  %6.2f usec/command\n",
+             r+1, ncmds, t, t * 1.0e6 / ncmds );
+   }
+   unlink( filename );
+
+   /* the same commands one at a time; the second time around they have */
+   /* all been seen before */
+   for (r=0;r<2;r++) {
+      t0 = now();
+      for (i=0;i<frames;i++) {
+         sprintf( cmd, "vis5d_set_name_value timestep %d", i );
+         bad += !eval_script_command( 0, cmd, &result );
+         sprintf( cmd, "vis5d_get_name_value timestep" );
+         bad += !eval_script_command( 0, cmd, &result );
+         bad += atoi( result ) != i;
+      }
+      t = now() - t0;
+      printf("single commands %d: %d commands  %.3f sec  %6.2f usec/command\n",
+             r+1, 2 * frames, t, t * 1.0e6 / (2 * frames) );
+   }
+
+   if (bad) {
+      printf("%d errors\n", bad );
+   }
+   return bad ? 1 : 0;
+}
@@ -0,0 +1,751 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+#include "../config.h"
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE   /* for struct ucred */
+#endif
+
+/* Request server for control by other programs, see server.h */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "api.h"
+#include "script.h"
+#include "server.h"
+
+
+
+#define MAX_CLIENTS  16
+
+/* a client sending a bigger request is disconnected */
+#define MAX_REQUEST  (64*1024*1024)
+
+/* a client's requests aren't run while this much of its output is unsent */
+#define MAX_PENDING  (64*1024*1024)
+
+/* biggest response */
+#define MAX_REPLY    (1024*1024*1024)
+
+/* time spent running requests per call to check_server(), microseconds */
+#define TURN_USEC    50000
+
+#define ROUND4( N )  ( ((N) + 3) & ~3 )
+
+
+struct client {
+   int fd;                  /* socket, -1 if the slot is free */
+   int eof;                 /* the client won't send more requests */
+   unsigned char *in;       /* received bytes */
+   int inpos, inlen;        /* first unhandled byte, end of received bytes */
+   int insize;              /* allocated size of in */
+   unsigned char *out;      /* responses */
+   size_t outpos, outlen;   /* first unsent byte, end of responses */
+   size_t outsize;          /* allocated size of out */
+   size_t reply;            /* offset of the response being built in out */
+};
+
+
+static int ListenFd = -1;
+static struct client Clients[MAX_CLIENTS];
+
+
+
+static unsigned int get_uint( const unsigned char *p )
+{
+   unsigned int v;
+   memcpy( &v, p, 4 );
+   return v;
+}
+
+
+static void put_uint( unsigned char *p, unsigned int v )
+{
+   memcpy( p, &v, 4 );
+}
+
+
+static void set_nonblocking( int fd )
+{
+   fcntl( fd, F_SETFL, fcntl( fd, F_GETFL, 0 ) | O_NONBLOCK );
+}
+
+
+
+/*
+ * Return 1 if a server is already answering on the UNIX socket name.
+ */
+static int socket_in_use( const struct sockaddr_un *addr )
+{
+   int fd, used;
+
+   fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+   if (fd<0) {
+      return 0;
+   }
+   used = connect( fd, (const struct sockaddr *) addr, sizeof(*addr) )==0
+          || (errno!=ECONNREFUSED && errno!=ENOENT);
+   close( fd );
+   return used;
+}
+
+
+/*
+ * Start listening for clients.  The socket is only accessible to the
+ * user running vis5d since clients can run any Tcl command.
+ * Input:  name - file name of the UNIX socket
+ * Return:  1 = ok, 0 = error
+ */
+int init_server( const char *name )
+{
+   struct sockaddr_un addr;
+   struct stat s;
+   mode_t mask;
+   int fd, i, status;
+
+   if (strlen(name) >= sizeof(addr.sun_path)) {
+      printf("Server socket name is too long: %s\n", name );
+      return 0;
+   }
+   memset( &addr, 0, sizeof(addr) );
+   addr.sun_family = AF_UNIX;
+   strcpy( addr.sun_path, name );
+
+   /* remove a socket left by an earlier run, but not a live one */
+   if (stat( name, &s )==0 && S_ISSOCK(s.st_mode)) {
+      if (socket_in_use( &addr )) {
+         printf("Another server is using %s\n", name );
+         return 0;
+      }
+      unlink( name );
+   }
+
+   fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+   if (fd<0) {
+      perror( name );
+      return 0;
+   }
+   /* create the socket file with mode 0600 */
+   mask = umask( 077 );
+   status = bind( fd, (struct sockaddr *) &addr, sizeof(addr) );
+   umask( mask );
+   if (status<0 || chmod( name, 0600 )<0) {
+      perror( name );
+      close( fd );
+      return 0;
+   }
+
+   if (listen( fd, MAX_CLIENTS )<0) {
+      perror( name );
+      close( fd );
+      return 0;
+   }
+   set_nonblocking( fd );
+   /* a client closing its socket early mustn't kill us */
+   signal( SIGPIPE, SIG_IGN );
+
+   for (i=0;i<MAX_CLIENTS;i++) {
+      Clients[i].fd = -1;
+   }
+   ListenFd = fd;
+   return 1;
+}
+
+
+
+/*
+ * Return 1 if the client on socket fd runs as our own user.
+ */
+static int client_allowed( int fd )
+{
+#ifdef SO_PEERCRED
+   struct ucred cred;
+   socklen_t len = sizeof(cred);
+
+   if (getsockopt( fd, SOL_SOCKET, SO_PEERCRED, &cred, &len )<0
+       || cred.uid != geteuid()) {
+      return 0;
+   }
+#endif
+   return 1;
+}
+
+
+static void accept_client( void )
+{
+   int fd, i;
+
+   fd = accept( ListenFd, NULL, NULL );
+   if (fd<0) {
+      return;
+   }
+   if (!client_allowed( fd )) {
+      printf("Refused server connection from another user\n");
+      close( fd );
+      return;
+   }
+   for (i=0;i<MAX_CLIENTS;i++) {
+      if (Clients[i].fd<0) {
+         memset( &Clients[i], 0, sizeof(struct client) );
+         Clients[i].fd = fd;
+         set_nonblocking( fd );
+         return;
+      }
+   }
+   printf("Too many server connections\n");
+   close( fd );
+}
+
+
+static void close_client( struct client *c )
+{
+   close( c->fd );
+   if (c->in) {
+      free( c->in );
+   }
+   if (c->out) {
+      free( c->out );
+   }
+   memset( c, 0, sizeof(struct client) );
+   c->fd = -1;
+}
+
+
+/*
+ * Return 1 if a whole request has been received from a client and its
+ * output isn't backed up.
+ */
+static int request_ready( struct client *c )
+{
+   unsigned int length;
+
+   if (c->fd<0 || c->inlen - c->inpos < 4
+       || c->outlen - c->outpos >= MAX_PENDING) {
+      return 0;
+   }
+   length = get_uint( c->in + c->inpos );
+   if (length<8 || length>MAX_REQUEST) {
+      printf("Bad server request, closing connection\n");
+      close_client( c );
+      return 0;
+   }
+   return c->inlen - c->inpos - 4 >= length;
+}
+
+
+static void read_client( struct client *c )
+{
+   int n;
+
+   if (c->inpos>0) {
+      memmove( c->in, c->in + c->inpos, c->inlen - c->inpos );
+      c->inlen -= c->inpos;
+      c->inpos = 0;
+   }
+   if (c->insize - c->inlen < 65536) {
+      int size = c->insize ? 2 * c->insize : 65536;
+      unsigned char *in = (unsigned char *) realloc( c->in, size );
+      if (!in) {
+         close_client( c );
+         return;
+      }
+      c->in = in;
+      c->insize = size;
+   }
+
+   n = read( c->fd, c->in + c->inlen, c->insize - c->inlen );
+   if (n>0) {
+      c->inlen += n;
+   }
+   else if (n==0) {
+      c->eof = 1;
+   }
+   else if (errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR) {
+      close_client( c );
+   }
+}
+
+
+static void write_client( struct client *c )
+{
+   int n;
+
+   if (c->outlen > c->outpos) {
+      n = write( c->fd, c->out + c->outpos, c->outlen - c->outpos );
+      if (n>0) {
+         c->outpos += n;
+      }
+      else if (n<0 && errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR) {
+         close_client( c );
+         return;
+      }
+   }
+   if (c->outpos==c->outlen) {
+      c->outpos = c->outlen = 0;
+      if (c->eof && !request_ready( c )) {
+         close_client( c );
+      }
+   }
+}
+
+
+
+/*
+ * Make room for a response with size bytes of results.
+ * Return:  where to put the results, or NULL if out of memory
+ */
+static unsigned char *begin_reply( struct client *c, unsigned int id,
+                                   int size )
+{
+   size_t need;
+
+   if (c->outpos>0) {
+      memmove( c->out, c->out + c->outpos, c->outlen - c->outpos );
+      c->outlen -= c->outpos;
+      c->outpos = 0;
+   }
+   if (size<0 || size>MAX_REPLY) {
+      return NULL;
+   }
+   need = c->outlen + 12 + ROUND4( (size_t) size );
+   if (need > (size_t) MAX_REPLY + MAX_PENDING + 12) {
+      return NULL;
+   }
+   if (need > c->outsize) {
+      size_t newsize = c->outsize ? c->outsize : 65536;
+      unsigned char *out;
+      while (newsize < need) {
+         newsize *= 2;
+      }
+      out = (unsigned char *) realloc( c->out, newsize );
+      if (!out) {
+         return NULL;
+      }
+      c->out = out;
+      c->outsize = newsize;
+   }
+   c->reply = c->outlen;
+   put_uint( c->out + c->reply + 4, id );
+   return c->out + c->reply + 12;
+}
+
+
+/*
+ * Finish the response started by begin_reply().
+ * Input:  status - 0 or a VIS5D_* error code
+ *         size - number of bytes of results
+ */
+static void end_reply( struct client *c, int status, int size )
+{
+   memset( c->out + c->reply + 12 + size, 0, ROUND4(size) - size );
+   put_uint( c->out + c->reply, 8 + ROUND4(size) );
+   put_uint( c->out + c->reply + 8, (unsigned int) status );
+   c->outlen = c->reply + 12 + ROUND4(size);
+}
+
+
+static void error_reply( struct client *c, unsigned int id, int status )
+{
+   if (begin_reply( c, id, 0 )) {
+      end_reply( c, status, 0 );
+   }
+   else {
+      close_client( c );
+   }
+}
+
+
+
+static void do_script( struct client *c, unsigned int id,
+                       const unsigned char *args, int nargs )
+{
+   const char *result;
+   unsigned char *p;
+   char *command;
+   int ok, len;
+
+   if (nargs<4) {
+      error_reply( c, id, VIS5D_BAD_VALUE );
+      return;
+   }
+   command = (char *) malloc( nargs - 4 + 1 );
+   if (!command) {
+      error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+      return;
+   }
+   memcpy( command, args + 4, nargs - 4 );
+   command[nargs-4] = 0;
+   ok = eval_script_command( (int) get_uint(args), command, &result );
+   free( command );
+
+   len = strlen( result );
+   p = begin_reply( c, id, len );
+   if (!p) {
+      error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+      return;
+   }
+   memcpy( p, result, len );
+   /* an error still returns the message */
+   end_reply( c, ok ? 0 : VIS5D_FAIL, len );
+}
+
+
+static void do_frame( struct client *c, unsigned int id,
+                      const unsigned char *args, int nargs )
+{
+   Window window;
+   unsigned char *p;
+   int dtx, width, height, status, size;
+
+   if (nargs!=8) {
+      error_reply( c, id, VIS5D_BAD_VALUE );
+      return;
+   }
+   dtx = (int) get_uint( args );
+   status = vis5d_get_window( dtx, &window, &width, &height );
+   if (status) {
+      error_reply( c, id, status );
+      return;
+   }
+   if (get_uint( args + 4 )) {
+      vis5d_finish_work();
+   }
+   if ((double) width * height * 4 > MAX_REPLY) {
+      error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+      return;
+   }
+   size = 8 + 4 * width * height;
+   p = begin_reply( c, id, size );
+   if (!p) {
+      error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+      return;
+   }
+   put_uint( p, width );
+   put_uint( p + 4, height );
+   status = vis5d_read_frame( dtx, (unsigned int *) (p + 8) );
+   end_reply( c, status, status ? 0 : size );
+}
+
+
+static void do_grid( struct client *c, unsigned int id,
+                     const unsigned char *args, int nargs )
+{
+   unsigned char *p;
+   int ctx, time, var, numvars, nr, nc, nl[MAXVARS], status, size;
+
+   if (nargs!=12) {
+      error_reply( c, id, VIS5D_BAD_VALUE );
+      return;
+   }
+   ctx = (int) get_uint( args );
+   time = (int) get_uint( args + 4 );
+   var = (int) get_uint( args + 8 );
+   status = vis5d_get_ctx_numvars( ctx, &numvars );
+   if (status==0 && (var<0 || var>=numvars)) {
+      status = VIS5D_BAD_VAR_NUMBER;
+   }
+   if (status) {
+      error_reply( c, id, status );
+      return;
+   }
+   vis5d_get_size( ctx, &nr, &nc, nl, NULL, NULL, NULL, NULL, NULL );
+   if ((double) nr * nc * nl[var] * 4 > MAX_REPLY) {
+      error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+      return;
+   }
+   size = 12 + 4 * nr * nc * nl[var];
+   p = begin_reply( c, id, size );
+   if (!p) {
+      error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+      return;
+   }
+   put_uint( p, nr );
+   put_uint( p + 4, nc );
+   put_uint( p + 8, nl[var] );
+   status = vis5d_get_grid( ctx, time, var, (float *) (p + 12) );
+   end_reply( c, status, status ? 0 : size );
+}
+
+
+static void do_time_series( struct client *c, unsigned int id,
+                            const unsigned char *args, int nargs )
+{
+   unsigned char *p;
+   float *points;
+   int ctx, var, time0, numtimes, numpoints, status, size;
+
+   if (nargs<20) {
+      error_reply( c, id, VIS5D_BAD_VALUE );
+      return;
+   }
+   ctx = (int) get_uint( args );
+   var = (int) get_uint( args + 4 );
+   time0 = (int) get_uint( args + 8 );
+   numtimes = (int) get_uint( args + 12 );
+   numpoints = (int) get_uint( args + 16 );
+   if (numpoints<0 || numtimes<0 || nargs != 20 + 12 * numpoints
+       || (double) numtimes * numpoints * 4 > MAX_REPLY) {
+      error_reply( c, id, VIS5D_BAD_VALUE );
+      return;
+   }
+   points = (float *) malloc( 12 * numpoints + 1 );
+   size = 4 * numtimes * numpoints;
+   p = points ? begin_reply( c, id, size ) : NULL;
+   if (!p) {
+      if (points) {
+         free( points );
+      }
+      error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+      return;
+   }
+   memcpy( points, args + 20, 12 * numpoints );
+   status = vis5d_get_time_series( ctx, var, time0, numtimes, numpoints,
+                                   points, (float *) p );
+   free( points );
+   end_reply( c, status, status ? 0 : size );
+}
+
+
+static void do_isosurface( struct client *c, unsigned int id,
+                           const unsigned char *args, int nargs )
+{
+   unsigned char *p;
+   int ctx, time, var, numverts, numindex, status, size;
+
+   if (nargs!=12) {
+      error_reply( c, id, VIS5D_BAD_VALUE );
+      return;
+   }
+   ctx = (int) get_uint( args );
+   time = (int) get_uint( args + 4 );
+   var = (int) get_uint( args + 8 );
+   do {
+      numverts = numindex = 0;
+      status = vis5d_get_isosurface_mesh( ctx, time, var, &numverts,
+                                          &numindex, NULL, NULL, NULL );
+      if (status) {
+         error_reply( c, id, status );
+         return;
+      }
+      if ((double) numverts * 24 + numindex * 4.0 > MAX_REPLY) {
+         error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+         return;
+      }
+      size = 8 + 24 * numverts + 4 * numindex;
+      p = begin_reply( c, id, size );
+      if (!p) {
+         error_reply( c, id, VIS5D_OUT_OF_MEMORY );
+         return;
+      }
+      put_uint( p, numverts );
+      put_uint( p + 4, numindex );
+      /* BAD_VALUE if the surface was remade bigger in the meantime */
+      status = vis5d_get_isosurface_mesh( ctx, time, var,
+                                          &numverts, &numindex,
+                                          (float *) (p + 8),
+                                          (float *) (p + 8 + 12 * numverts),
+                                          (int *) (p + 8 + 24 * numverts) );
+   } while (status==VIS5D_BAD_VALUE);
+   put_uint( p, numverts );
+   put_uint( p + 4, numindex );
+   end_reply( c, status, status ? 0 : 8 + 24 * numverts + 4 * numindex );
+}
+
+
+/*
+ * Run the next request from a client and queue its response.
+ */
+static void do_request( struct client *c )
+{
+   unsigned char *req = c->in + c->inpos;
+   unsigned int length = get_uint( req );
+   unsigned int id = get_uint( req + 4 );
+   unsigned int op = get_uint( req + 8 );
+   const unsigned char *args = req + 12;
+   int nargs = length - 8;
+
+   switch (op) {
+      case SERVER_SCRIPT:
+         do_script( c, id, args, nargs );
+         break;
+      case SERVER_FRAME:
+         do_frame( c, id, args, nargs );
+         break;
+      case SERVER_GRID:
+         do_grid( c, id, args, nargs );
+         break;
+      case SERVER_TIME_SERIES:
+         do_time_series( c, id, args, nargs );
+         break;
+      case SERVER_ISOSURFACE:
+         do_isosurface( c, id, args, nargs );
+         break;
+      default:
+         error_reply( c, id, VIS5D_BAD_CONSTANT );
+   }
+   if (c->fd>=0) {
+      c->inpos += 4 + length;
+   }
+}
+
+
+
+/*
+ * Put the sockets which need attention in the select() sets.
+ * Return:  the largest file descriptor
+ */
+static int set_fds( fd_set *readfds, fd_set *writefds )
+{
+   int maxfd = ListenFd, i;
+
+   FD_ZERO( readfds );
+   FD_ZERO( writefds );
+   FD_SET( ListenFd, readfds );
+   for (i=0;i<MAX_CLIENTS;i++) {
+      struct client *c = &Clients[i];
+      if (c->fd<0) {
+         continue;
+      }
+      if (!c->eof && c->outlen - c->outpos < MAX_PENDING) {
+         FD_SET( c->fd, readfds );
+      }
+      if (c->outlen > c->outpos) {
+         FD_SET( c->fd, writefds );
+      }
+      if (c->fd > maxfd) {
+         maxfd = c->fd;
+      }
+   }
+   return maxfd;
+}
+
+
+/*
+ * Accept connections, receive requests, run them and send responses,
+ * without waiting for anything.  Called from the main loop.
+ */
+void check_server( void )
+{
+   fd_set readfds, writefds;
+   struct timeval timeout, start, now;
+   int maxfd, busy, i;
+
+   if (ListenFd<0) {
+      return;
+   }
+
+   maxfd = set_fds( &readfds, &writefds );
+   timeout.tv_sec = timeout.tv_usec = 0;
+   if (select( maxfd+1, &readfds, NULL, NULL, &timeout ) > 0) {
+      if (FD_ISSET( ListenFd, &readfds )) {
+         accept_client();
+      }
+      for (i=0;i<MAX_CLIENTS;i++) {
+         if (Clients[i].fd>=0 && FD_ISSET( Clients[i].fd, &readfds )) {
+            read_client( &Clients[i] );
+         }
+      }
+   }
+
+   /* one request from each client in turn so none is starved, until */
+   /* it's time to go back to the main loop to redraw and check input */
+   gettimeofday( &start, NULL );
+   do {
+      busy = 0;
+      for (i=0;i<MAX_CLIENTS;i++) {
+         if (request_ready( &Clients[i] )) {
+            do_request( &Clients[i] );
+            busy = 1;
+         }
+      }
+      gettimeofday( &now, NULL );
+   } while (busy && (now.tv_sec - start.tv_sec) * 1000000
+                    + now.tv_usec - start.tv_usec < TURN_USEC);
+
+   for (i=0;i<MAX_CLIENTS;i++) {
+      if (Clients[i].fd>=0) {
+         write_client( &Clients[i] );
+      }
+   }
+}
+
+
+/*
+ * Sleep until there's X input, a client to talk to, or msec milliseconds
+ * have passed.
+ * Input:  dpy1, dpy2 - X displays to watch, or NULL
+ *         msec - longest time to wait, or -1 for no limit
+ */
+void wait_server( Display *dpy1, Display *dpy2, int msec )
+{
+   fd_set readfds, writefds;
+   struct timeval timeout;
+   int maxfd, i;
+
+   if (ListenFd<0) {
+      return;
+   }
+   for (i=0;i<MAX_CLIENTS;i++) {
+      if (request_ready( &Clients[i] )) {
+         return;
+      }
+   }
+   if ((dpy1 && XPending( dpy1 )) || (dpy2 && XPending( dpy2 ))) {
+      return;
+   }
+
+   maxfd = set_fds( &readfds, &writefds );
+   if (dpy1) {
+      FD_SET( ConnectionNumber( dpy1 ), &readfds );
+      if (ConnectionNumber( dpy1 ) > maxfd) {
+         maxfd = ConnectionNumber( dpy1 );
+      }
+   }
+   if (dpy2) {
+      FD_SET( ConnectionNumber( dpy2 ), &readfds );
+      if (ConnectionNumber( dpy2 ) > maxfd) {
+         maxfd = ConnectionNumber( dpy2 );
+      }
+   }
+   timeout.tv_sec = msec / 1000;
+   timeout.tv_usec = (msec % 1000) * 1000;
+   select( maxfd+1, &readfds, &writefds, NULL, msec<0 ? NULL : &timeout );
+}
@@ -0,0 +1,97 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Request server: other programs on the same machine connect to a UNIX
+ * socket (vis5d -server name) and send requests
+ * which are run against the displays and contexts.  Results come back as
+ * binary data.  Any number of requests can be sent at once; they're
+ * answered in order, between redraws, and a client which is slow to read
+ * its responses only holds up itself.
+ *
+ * All integers and floats are 4 bytes in the server's byte order.
+ *
+ * Request:   length   - number of bytes after this field
+ *            id       - copied into the response
+ *            op       - one of the SERVER_* values below
+ *            args     - depend on op
+ *
+ * Response:  length   - number of bytes after this field
+ *            id       - from the request
+ *            status   - 0 or a VIS5D_* error code from api.h
+ *            results  - depend on op, padded with zeros to a multiple
+ *                       of 4 bytes; none if status isn't 0, except for
+ *                       the error message of SERVER_SCRIPT
+ *
+ * op                   args                      results
+ * SERVER_SCRIPT        dtx, Tcl command chars    result chars
+ * SERVER_FRAME         dtx, finish               width, height, RGBA
+ *                                                bytes bottom row first
+ * SERVER_GRID          ctx, time, var            nr, nc, nl, floats
+ * SERVER_TIME_SERIES   ctx, var, time0,          numtimes*numpoints
+ *                      numtimes, numpoints,      floats
+ *                      numpoints*(row,col,lev)
+ * SERVER_ISOSURFACE    ctx, time, var            numverts, numindex,
+ *                                                numverts*(x,y,z),
+ *                                                numverts*(nx,ny,nz),
+ *                                                numindex vertex numbers,
+ *                                                -1 between strips
+ *
+ * The socket is created with mode 0600, and where the system can tell,
+ * connections from other users are refused, since SERVER_SCRIPT runs
+ * any Tcl command.
+ *
+ * SERVER_SCRIPT keeps one Tcl interpreter per display between requests.
+ * SERVER_FRAME redraws the display's 3-D window first, and waits for
+ * queued graphics work to finish if finish is non-zero.
+ */
+
+
+#ifndef SERVER_H
+#define SERVER_H
+
+
+#include <X11/Xlib.h>
+
+
+#define SERVER_SCRIPT       1
+#define SERVER_FRAME        2
+#define SERVER_GRID         3
+#define SERVER_TIME_SERIES  4
+#define SERVER_ISOSURFACE   5
+
+
+extern int init_server( const char *name );
+
+extern void check_server( void );
+
+extern void wait_server( Display *dpy1, Display *dpy2, int msec );
+
+
+#endif
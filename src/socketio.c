@@ -35,6 +35,13 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <stdio.h>
+#ifdef HAVE_SYS_SHM_H
+#  include <sys/types.h>
+#  include <sys/ipc.h>
+#  include <sys/shm.h>
+#endif
+#include "socketio.h"
 
 
 
@@ -201,3 +208,92 @@ void send_str( int socket, char str[] )
    send_int( socket, len );
    send_data( socket, str, len );
 }
+
+
+
+/*** create_shared_block **********************************************
+   Create and attach a shared memory segment which can be handed to
+   another process on this host by sending it the returned id.
+   Input:  bytes - size of segment.
+   Output:  id - the segment id to pass to attach_shared_block().
+   Return:  address of the segment or NULL if shared memory is not
+            available.
+**********************************************************************/
+void *create_shared_block( size_t bytes, int *id )
+{
+#ifdef HAVE_SYS_SHM_H
+   void *addr;
+
+   *id = shmget( IPC_PRIVATE, bytes, IPC_CREAT | 0600 );
+   if (*id<0) {
+      perror("create_shared_block: shmget failed");
+      return NULL;
+   }
+   addr = shmat( *id, NULL, 0 );
+   if (addr==(void *) -1) {
+      perror("create_shared_block: shmat failed");
+      shmctl( *id, IPC_RMID, NULL );
+      *id = -1;
+      return NULL;
+   }
+   return addr;
+#else
+   *id = -1;
+   return NULL;
+#endif
+}
+
+
+
+/*** attach_shared_block **********************************************
+   Attach a shared memory segment created by another process.
+   Input:  id - the segment id.
+           readonly - non-zero to map the segment read-only.
+   Return:  address of the segment or NULL if error.
+**********************************************************************/
+void *attach_shared_block( int id, int readonly )
+{
+#ifdef HAVE_SYS_SHM_H
+   void *addr;
+
+   addr = shmat( id, NULL, readonly ? SHM_RDONLY : 0 );
+   if (addr==(void *) -1) {
+      perror("attach_shared_block: shmat failed");
+      return NULL;
+   }
+   return addr;
+#else
+   return NULL;
+#endif
+}
+
+
+
+/*** remove_shared_block **********************************************
+   Mark a segment made by create_shared_block() for removal.  It goes
+   away once every process has detached it.
+   Input:  id - the segment id.
+**********************************************************************/
+void remove_shared_block( int id )
+{
+#ifdef HAVE_SYS_SHM_H
+   if (id>=0) {
+      shmctl( id, IPC_RMID, NULL );
+   }
+#endif
+}
+
+
+
+/*** detach_shared_block **********************************************
+   Detach a shared memory segment from this process.
+   Input:  addr - address returned by create/attach_shared_block().
+**********************************************************************/
+void detach_shared_block( void *addr )
+{
+#ifdef HAVE_SYS_SHM_H
+   if (addr) {
+      shmdt( addr );
+   }
+#endif
+}
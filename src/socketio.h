@@ -129,4 +129,42 @@ extern int receive_str( int socket, char str[] );
 extern void send_str( int socket, char str[] );
 
 
+
+
+/*** Shared memory segments for bulk data between local processes ***/
+
+/* acknowledgment codes sent by an external function when it starts */
+#define EXT_ACK        0x1234   /* socket transport only */
+#define EXT_ACK_SHM    0x1235   /* also understands shared memory */
+
+/*** create_shared_block **********************************************
+   Create and attach a shared memory segment of the given size.
+   Output:  id - the segment id to send to the other process.
+   Return:  address of the segment or NULL if not available.
+**********************************************************************/
+extern void *create_shared_block( size_t bytes, int *id );
+
+
+
+/*** attach_shared_block **********************************************
+   Attach a segment made by another process, read-only if requested.
+   Return:  address of the segment or NULL if error.
+**********************************************************************/
+extern void *attach_shared_block( int id, int readonly );
+
+
+
+/*** remove_shared_block **********************************************
+   Mark a segment for removal once every process has detached it.
+**********************************************************************/
+extern void remove_shared_block( int id );
+
+
+
+/*** detach_shared_block **********************************************
+   Detach a shared memory segment from this process.
+**********************************************************************/
+extern void detach_shared_block( void *addr );
+
+
 #endif
@@ -150,17 +150,15 @@ void data_to_y (Display_Context dtx, float alt, int *y);
 
 float grid_level_to_height( Display_Context dtx, float level );
 
-static int extract_sound( Display_Context dtx, float *grid, int var,
-                             int nr, int nc, int nl, int lowlev,
+static int extract_sound( Display_Context dtx, Context ctx, int var,
                              float row, float col);
 
 static int extract_soundPRIME( Context ctx, int var,
                              int nr, int nc, int nl, int lowlev,
                              float row, float col);
 
-static int extract_wind( Display_Context dtx, float *gridu, float *gridv,
+static int extract_wind( Display_Context dtx, Context uctx, Context vctx,
                              int varu, int varv,
-                             int nr, int nc, int nl, int lowlev,
                              float row, float col);
 
 static int extract_windPRIME( Context ctx, 
@@ -538,21 +536,8 @@ int make_soundGFX_window( Display_Context dtx, const char *title, int xpos, int
    dtx->Sound.soundline = NULL;
    dtx->Sound.uwindline = NULL;
    dtx->Sound.vwindline = NULL;
-   dtx->Sound.tgrid = NULL;
-   dtx->Sound.dgrid = NULL;
-   dtx->Sound.ugrid = NULL;
-   dtx->Sound.var1grid = NULL;
-   dtx->Sound.var2grid = NULL;
-   dtx->Sound.var3grid = NULL;
    dtx->Sound.vertdata = NULL;
 
-   dtx->Sound.PreviousSoundTemp = vis5d_find_var(dtx->ctxarray[0],"T");
-   dtx->Sound.PreviousSoundDewpt= vis5d_find_var(dtx->ctxarray[0],"TD");
-   dtx->Sound.PreviousSoundUWind= vis5d_find_var(dtx->ctxarray[0],"U");
-   dtx->Sound.PreviousSoundVWind= vis5d_find_var(dtx->ctxarray[0],"V");
-   dtx->Sound.PreviousSoundVar1 = -1;
-   dtx->Sound.PreviousSoundVar2 = -1;
-   dtx->Sound.PreviousSoundVar3 = -1;
    dtx->Sound.sndx = 15;
    dtx->Sound.sndy = 15;
    vis5d_set_sound_vars( dtx->dpy_context_index, yo, vis5d_find_var(dtx->ctxarray[0],"T"),
@@ -1811,112 +1796,6 @@ static void convert_xy_to_barb(Display_Context dtx, int inx, int iny, float dir,
    *outy = (int) (sin(angle) * r);
 }    
 
-    /**********************************************************************/
-    /* This reload the grids for the sounding variables in case the       */
-    /* variables change or the time changes this can be used to change them*/
-    /**********************************************************************/
-    /* Input: dtx - context                                               */
-    /**********************************************************************/
-
-
-int reload_sounding_data( Display_Context dtx )
-{
-   if ( dtx->Sound.SoundTemp >= 0 ) {
-      if (dtx->Sound.tgrid == NULL ) {
-         dtx->Sound.tgrid = get_grid( dtx->Sound.SoundTempOwner,
-                                      dtx->Sound.SoundTempOwner->CurTime, dtx->Sound.SoundTemp);
-      }
-      else {
-         release_grid( dtx->Sound.SoundTempOwner, dtx->Sound.SoundTempOwner->CurTime,
-                       dtx->Sound.SoundTemp, dtx->Sound.tgrid );
-         dtx->Sound.tgrid = get_grid( dtx->Sound.SoundTempOwner, dtx->Sound.SoundTempOwner->CurTime,
-                                      dtx->Sound.SoundTemp);
-      }
-   }
-
-   if ( dtx->Sound.SoundDewpt >= 0){
-      if (dtx->Sound.dgrid == NULL ) {
-         dtx->Sound.dgrid = get_grid( dtx->Sound.SoundDewptOwner, dtx->Sound.SoundDewptOwner->CurTime,
-                                      dtx->Sound.SoundDewpt);
-      }
-      else {
-         release_grid( dtx->Sound.SoundDewptOwner, dtx->Sound.SoundDewptOwner->CurTime,
-                       dtx->Sound.SoundDewpt, dtx->Sound.dgrid );
-         dtx->Sound.dgrid = get_grid( dtx->Sound.SoundDewptOwner, dtx->Sound.SoundDewptOwner->CurTime,
-                                      dtx->Sound.SoundDewpt);
-      }
-   }
-
-
-   if ( dtx->Sound.SoundUWind >= 0 && dtx->Sound.SoundVWind >=0 ){
-      if (dtx->Sound.ugrid == NULL ) {
-         dtx->Sound.ugrid = get_grid( dtx->Sound.SoundUWindOwner, dtx->Sound.SoundUWindOwner->CurTime,
-                                      dtx->Sound.SoundUWind);
-      }
-      else {
-         release_grid( dtx->Sound.SoundUWindOwner, dtx->Sound.SoundUWindOwner->CurTime,
-                       dtx->Sound.SoundUWind, dtx->Sound.ugrid );
-         dtx->Sound.ugrid = get_grid( dtx->Sound.SoundUWindOwner, dtx->Sound.SoundUWindOwner->CurTime,
-                                      dtx->Sound.SoundUWind);
-      }
-      if (dtx->Sound.vgrid == NULL ) {
-         dtx->Sound.vgrid = get_grid( dtx->Sound.SoundVWindOwner, dtx->Sound.SoundVWindOwner->CurTime,
-                                      dtx->Sound.SoundVWind);
-      }
-      else {
-         release_grid( dtx->Sound.SoundVWindOwner, dtx->Sound.SoundVWindOwner->CurTime,
-                       dtx->Sound.SoundVWind, dtx->Sound.vgrid );
-         dtx->Sound.vgrid = get_grid( dtx->Sound.SoundVWindOwner, dtx->Sound.SoundVWindOwner->CurTime,
-                                      dtx->Sound.SoundVWind);
-      }
-   }
-
-
-   if ( dtx->Sound.SoundVar1 >= 0){
-      if (dtx->Sound.var1grid == NULL ) {
-         dtx->Sound.var1grid = get_grid( dtx->Sound.SoundVar1Owner, dtx->Sound.SoundVar1Owner->CurTime,
-                                         dtx->Sound.SoundVar1);
-      }
-      else {
-         release_grid( dtx->Sound.SoundVar1Owner, dtx->Sound.SoundVar1Owner->CurTime,
-                       dtx->Sound.SoundVar1, dtx->Sound.var1grid );
-         dtx->Sound.var1grid = get_grid( dtx->Sound.SoundVar1Owner, dtx->Sound.SoundVar1Owner->CurTime,
-                                         dtx->Sound.SoundVar1);
-      }
-   }
-
-
-   if ( dtx->Sound.SoundVar2 >= 0){
-      if (dtx->Sound.var2grid == NULL ) {
-         dtx->Sound.var2grid = get_grid( dtx->Sound.SoundVar2Owner, dtx->Sound.SoundVar2Owner->CurTime,
-                                         dtx->Sound.SoundVar2);
-      }
-      else {
-         release_grid( dtx->Sound.SoundVar2Owner, dtx->Sound.SoundVar2Owner->CurTime,
-                       dtx->Sound.SoundVar2, dtx->Sound.var2grid );
-         dtx->Sound.var2grid = get_grid( dtx->Sound.SoundVar2Owner, dtx->Sound.SoundVar2Owner->CurTime,
-                                         dtx->Sound.SoundVar2);
-      }
-   }
-
-
-   if ( dtx->Sound.SoundVar3 >= 0){
-      if (dtx->Sound.var3grid == NULL ) {
-         dtx->Sound.var3grid = get_grid( dtx->Sound.SoundVar3Owner, dtx->Sound.SoundVar3Owner->CurTime,
-                                         dtx->Sound.SoundVar3);
-      }
-      else {
-         release_grid( dtx->Sound.SoundVar3Owner, dtx->Sound.SoundVar3Owner->CurTime,
-                       dtx->Sound.SoundVar3, dtx->Sound.var3grid );
-         dtx->Sound.var3grid = get_grid( dtx->Sound.SoundVar3Owner, dtx->Sound.SoundVar3Owner->CurTime,
-                                         dtx->Sound.SoundVar3);
-      }
-   }
-   return 1;
-}   
-
-
-
 /* MJK 12.15.98 begin */
 #define RESET_ELEV              -99999.0
 
@@ -1983,7 +1862,7 @@ int draw_sounding( Display_Context dtx, int time )
    float        elev, lat, lon, hgt, *temp_save = NULL;
    int          barb_size;
    unsigned int line_width;
-   Context      varownerctx, prvownerctx, var2ownerctx, prv2ownerctx;
+   Context      varownerctx, var2ownerctx;
 
    XFontStruct *font_info;
    font_info = XLoadQueryFont(SndDpy, dtx->gfx[SOUND_FONT]->FontName);
@@ -2035,56 +1914,13 @@ int draw_sounding( Display_Context dtx, int time )
       elev = elevation (dtx, dtx->topo, lat, lon, NULL) / 1000.0;
    }
 
-/* 13May98  Phil McDonald */
-   if ((dtx->Sound.PreviousSoundTemp < 0) && (dtx->Sound.SoundTemp >= 0) &&
-       (dtx->Sound.tgrid != NULL))
-       dtx->Sound.PreviousSoundTemp = dtx->Sound.SoundTemp;
-   if ((dtx->Sound.PreviousSoundDewpt < 0) && (dtx->Sound.SoundDewpt >= 0) &&
-       (dtx->Sound.dgrid != NULL))
-       dtx->Sound.PreviousSoundDewpt = dtx->Sound.SoundDewpt;
-   if ((dtx->Sound.PreviousSoundUWind < 0) && (dtx->Sound.SoundUWind >= 0) &&
-       (dtx->Sound.ugrid != NULL))
-       dtx->Sound.PreviousSoundUWind = dtx->Sound.SoundUWind;
-   if ((dtx->Sound.PreviousSoundVWind < 0) && (dtx->Sound.SoundVWind >= 0) &&
-       (dtx->Sound.vgrid != NULL))
-       dtx->Sound.PreviousSoundVWind = dtx->Sound.SoundVWind;
-   if ((dtx->Sound.PreviousSoundVar1 < 0) && (dtx->Sound.SoundVar1 >= 0) &&
-       (dtx->Sound.var1grid != NULL))
-       dtx->Sound.PreviousSoundVar1 = dtx->Sound.SoundVar1;
-   if ((dtx->Sound.PreviousSoundVar2 < 0) && (dtx->Sound.SoundVar2 >= 0) &&
-       (dtx->Sound.var2grid != NULL))
-       dtx->Sound.PreviousSoundVar2 = dtx->Sound.SoundVar2;
-   if ((dtx->Sound.PreviousSoundVar3 < 0) && (dtx->Sound.SoundVar3 >= 0) &&
-       (dtx->Sound.var3grid != NULL))
-       dtx->Sound.PreviousSoundVar3 = dtx->Sound.SoundVar3;
-
-
-
    /* draw the temperature first if it is given*/
 
    if (dtx->Sound.SoundTemp >= 0){
       varownerctx = dtx->Sound.SoundTempOwner;
-      prvownerctx = dtx->Sound.PreviousSoundTempOwner;
-
-      if ( (dtx->Sound.SoundTemp != dtx->Sound.PreviousSoundTemp) &&
-           (varownerctx != prvownerctx) && (dtx->Sound.tgrid != NULL) ){
-         release_grid( prvownerctx, time,
-                       dtx->Sound.PreviousSoundTemp, dtx->Sound.tgrid );
-         dtx->Sound.tgrid = NULL;
-      }
-      dtx->Sound.PreviousSoundTemp      = dtx->Sound.SoundTemp;
-      dtx->Sound.PreviousSoundTempOwner = varownerctx;
-
-      if (dtx->Sound.tgrid == NULL ) {
-         dtx->Sound.tgrid = get_grid( varownerctx, time, dtx->Sound.SoundTemp);
-         if (dtx->Sound.tgrid == NULL) return 0;
-      }
 
       if (varownerctx->GridSameAsGridPRIME){
-         yo =  extract_sound( dtx, dtx->Sound.tgrid, dtx->Sound.SoundTemp,
-                              varownerctx->Nr, varownerctx->Nc,
-                              varownerctx->Nl[dtx->Sound.SoundTemp],
-                              varownerctx->Variable[dtx->Sound.SoundTemp]->LowLev,
+         yo =  extract_sound( dtx, varownerctx, dtx->Sound.SoundTemp,
                               row, col );
       }
       else{
@@ -2094,6 +1930,7 @@ int draw_sounding( Display_Context dtx, int time )
                                   varownerctx->Variable[dtx->Sound.SoundTemp]->LowLev,
                                   row, col );
       }
+      if (!yo) return 0;
 
       draw_sounding_line (dtx, dtx->Sound.Tempgc, -1, -1, RESET_ELEV, elev);
 
@@ -2110,13 +1947,6 @@ int draw_sounding( Display_Context dtx, int time )
       dtx->Sound.soundline = NULL;
 
    }
-   else {
-      if (dtx->Sound.tgrid != NULL ){
-         release_grid( dtx->Sound.PreviousSoundTempOwner, time,
-                       dtx->Sound.PreviousSoundTemp, dtx->Sound.tgrid );
-         dtx->Sound.tgrid = NULL;
-      }
-   }
 
 
 
@@ -2124,27 +1954,9 @@ int draw_sounding( Display_Context dtx, int time )
 
    if (dtx->Sound.SoundDewpt >= 0){
       varownerctx = dtx->Sound.SoundDewptOwner;
-      prvownerctx = dtx->Sound.PreviousSoundDewptOwner;
-
-      if ( (dtx->Sound.SoundDewpt != dtx->Sound.PreviousSoundDewpt) &&
-           (varownerctx != prvownerctx) && (dtx->Sound.dgrid != NULL) ){
-         release_grid( prvownerctx, time,
-                       dtx->Sound.PreviousSoundDewpt, dtx->Sound.dgrid );
-         dtx->Sound.dgrid = NULL;
-      }
-      dtx->Sound.PreviousSoundDewpt      = dtx->Sound.SoundDewpt;
-      dtx->Sound.PreviousSoundDewptOwner = varownerctx;
-
-      if (dtx->Sound.dgrid == NULL ) {
-         dtx->Sound.dgrid = get_grid( varownerctx, time, dtx->Sound.SoundDewpt);
-         if (dtx->Sound.dgrid == NULL) return 0;
-      }
 
       if (varownerctx->GridSameAsGridPRIME){
-         yo =  extract_sound( dtx, dtx->Sound.dgrid, dtx->Sound.SoundDewpt,
-                              varownerctx->Nr, varownerctx->Nc,
-                              varownerctx->Nl[dtx->Sound.SoundDewpt],
-                              varownerctx->Variable[dtx->Sound.SoundDewpt]->LowLev,
+         yo =  extract_sound( dtx, varownerctx, dtx->Sound.SoundDewpt,
                               row, col );
       }
       else{
@@ -2154,6 +1966,10 @@ int draw_sounding( Display_Context dtx, int time )
                                   varownerctx->Variable[dtx->Sound.SoundDewpt]->LowLev,
                                   row, col );
       }
+      if (!yo) {
+         if (temp_save != NULL) free (temp_save);
+         return 0;
+      }
 
       draw_sounding_line (dtx, dtx->Sound.Dewptgc, -1, -1, RESET_ELEV, elev);
 
@@ -2176,13 +1992,6 @@ int draw_sounding( Display_Context dtx, int time )
       }
 
    }
-   else {
-      if (dtx->Sound.dgrid != NULL ){
-         release_grid( dtx->Sound.PreviousSoundDewptOwner, time,
-                       dtx->Sound.PreviousSoundDewpt, dtx->Sound.dgrid );
-         dtx->Sound.dgrid = NULL;
-      }
-   }
 
 /* 13Oct97  Phil McDonald */
    if (temp_save != NULL) free (temp_save), temp_save = NULL;
@@ -2193,48 +2002,12 @@ int draw_sounding( Display_Context dtx, int time )
 
    if ((dtx->Sound.SoundUWind >= 0) && (dtx->Sound.SoundVWind >= 0 )){
       varownerctx  = dtx->Sound.SoundUWindOwner;
-      prvownerctx  = dtx->Sound.PreviousSoundUWindOwner;
       var2ownerctx = dtx->Sound.SoundVWindOwner;
-      prv2ownerctx = dtx->Sound.PreviousSoundVWindOwner;
-
-      if ( (dtx->Sound.SoundUWind != dtx->Sound.PreviousSoundUWind) &&
-           (varownerctx != prvownerctx) && (dtx->Sound.ugrid != NULL) ){
-         release_grid( prvownerctx, time,
-                       dtx->Sound.PreviousSoundUWind, dtx->Sound.ugrid );
-         dtx->Sound.ugrid = NULL;
-      }
-      dtx->Sound.PreviousSoundUWind      = dtx->Sound.SoundUWind;
-      dtx->Sound.PreviousSoundUWindOwner = varownerctx;
-
-      if ( (dtx->Sound.SoundVWind != dtx->Sound.PreviousSoundVWind) &&
-           (var2ownerctx != prv2ownerctx) && (dtx->Sound.vgrid != NULL) ){
-         release_grid( prv2ownerctx, time,
-                       dtx->Sound.PreviousSoundVWind, dtx->Sound.vgrid );
-         dtx->Sound.vgrid = NULL;
-      }
-      dtx->Sound.PreviousSoundVWind      = dtx->Sound.SoundVWind;
-      dtx->Sound.PreviousSoundVWindOwner = var2ownerctx;
-
-      if( dtx->Sound.ugrid == NULL ) {
-         dtx->Sound.ugrid = get_grid( varownerctx, time,
-                                      dtx->Sound.SoundUWind);
-         if (dtx->Sound.ugrid == NULL) return 0;
-      }
-      if( dtx->Sound.vgrid == NULL ) {
-         dtx->Sound.vgrid = get_grid( var2ownerctx, time,
-                                      dtx->Sound.SoundVWind);
-         if (dtx->Sound.vgrid == NULL) {
-            release_grid( varownerctx, time,
-                          dtx->Sound.SoundUWind, dtx->Sound.ugrid );
-            return 0;
-         }
-      }
 
       if (varownerctx->GridSameAsGridPRIME){
-         yo = extract_wind( dtx, dtx->Sound.ugrid, dtx->Sound.vgrid,
+         yo = extract_wind( dtx, varownerctx, var2ownerctx,
                             dtx->Sound.SoundUWind, dtx->Sound.SoundVWind,
-                            dtx->Nr, dtx->Nc, dtx->Nl,
-                            dtx->LowLev, row, col );
+                            row, col );
       }
       else{
          yo = extract_windPRIME( varownerctx,
@@ -2244,6 +2017,7 @@ int draw_sounding( Display_Context dtx, int time )
                                  varownerctx->Variable[dtx->Sound.SoundUWind]->LowLev,
                                  row, col);
       }
+      if (!yo) return 0;
 
 /* 20Oct97  Phil McDonald       calc a suitable barb size and line width */
       barb_size = 0;
@@ -2282,18 +2056,6 @@ int draw_sounding( Display_Context dtx, int time )
          }
       }
    }
-   else {
-      if (dtx->Sound.ugrid != NULL ) {
-         release_grid( dtx->Sound.PreviousSoundUWindOwner,
-                       time, dtx->Sound.PreviousSoundUWind, dtx->Sound.ugrid);
-         dtx->Sound.ugrid = NULL;
-      }
-      if (dtx->Sound.vgrid != NULL ) {
-         release_grid( dtx->Sound.PreviousSoundVWindOwner,
-                       time, dtx->Sound.PreviousSoundVWind, dtx->Sound.vgrid);
-         dtx->Sound.vgrid = NULL;
-      }
-   }
 
 
 
@@ -2301,27 +2063,10 @@ int draw_sounding( Display_Context dtx, int time )
 
    if( dtx->Sound.SoundVar1 >= 0){
       varownerctx  = dtx->Sound.SoundVar1Owner;
-      prvownerctx  = dtx->Sound.PreviousSoundVar1Owner;
-
-      if ( (dtx->Sound.SoundVar1 != dtx->Sound.PreviousSoundVar1) &&
-           (varownerctx != prvownerctx) && (dtx->Sound.var1grid != NULL) ){
-         release_grid( prvownerctx, time,
-                       dtx->Sound.PreviousSoundVar1, dtx->Sound.var1grid );
-         dtx->Sound.var1grid = NULL;
-      }
-      dtx->Sound.PreviousSoundVar1      = dtx->Sound.SoundVar1;
-      dtx->Sound.PreviousSoundVar1Owner = varownerctx;
-
-      if (dtx->Sound.var1grid == NULL ){
-         dtx->Sound.var1grid = get_grid( varownerctx, time,
-                                         dtx->Sound.SoundVar1);
-         if (dtx->Sound.var1grid == NULL) return 0;
-      }
 
       if (varownerctx->GridSameAsGridPRIME){
-         yo= extract_sound( dtx, dtx->Sound.var1grid, dtx->Sound.SoundVar1,
-                            dtx->Nr, dtx->Nc, dtx->Nl,
-                            dtx->LowLev, row, col );
+         yo= extract_sound( dtx, varownerctx, dtx->Sound.SoundVar1,
+                            row, col );
       }
       else{
          yo= extract_soundPRIME(varownerctx, dtx->Sound.SoundVar1,
@@ -2330,6 +2075,7 @@ int draw_sounding( Display_Context dtx, int time )
                                 varownerctx->Variable[dtx->Sound.SoundVar1]->LowLev,
                                 row, col );
       }
+      if (!yo) return 0;
 
       if (font_info)
 	   XSetFont(SndDpy, dtx->Sound.var1_gc, font_info->fid);
@@ -2346,39 +2092,15 @@ int draw_sounding( Display_Context dtx, int time )
       }
 
    }
-   else {
-      if (dtx->Sound.var1grid != NULL ){
-         release_grid(dtx->Sound.PreviousSoundVar1Owner, time,
-                      dtx->Sound.PreviousSoundVar1, dtx->Sound.var1grid);
-         dtx->Sound.var1grid = NULL;
-      }
-   }
 
 
 
    if( dtx->Sound.SoundVar2 >= 0){
       varownerctx  = dtx->Sound.SoundVar2Owner;
-      prvownerctx  = dtx->Sound.PreviousSoundVar2Owner;
-
-      if ( (dtx->Sound.SoundVar2 != dtx->Sound.PreviousSoundVar2) &&
-           (varownerctx != prvownerctx) && (dtx->Sound.var2grid != NULL) ){
-         release_grid( prvownerctx, time,
-                       dtx->Sound.PreviousSoundVar2, dtx->Sound.var2grid );
-         dtx->Sound.var2grid = NULL;
-      }
-      dtx->Sound.PreviousSoundVar2      = dtx->Sound.SoundVar2;
-      dtx->Sound.PreviousSoundVar2Owner = varownerctx;
-
-      if (dtx->Sound.var2grid == NULL ){
-         dtx->Sound.var2grid = get_grid( varownerctx, time,
-                                         dtx->Sound.SoundVar2);
-         if (dtx->Sound.var2grid == NULL) return 0;
-      }
 
       if (varownerctx->GridSameAsGridPRIME){
-         yo= extract_sound( dtx, dtx->Sound.var2grid, dtx->Sound.SoundVar2,
-                            dtx->Nr, dtx->Nc, dtx->Nl,
-                            dtx->LowLev, row, col );
+         yo= extract_sound( dtx, varownerctx, dtx->Sound.SoundVar2,
+                            row, col );
       }
       else{
          yo= extract_soundPRIME(varownerctx, dtx->Sound.SoundVar2,
@@ -2387,6 +2109,7 @@ int draw_sounding( Display_Context dtx, int time )
                                 varownerctx->Variable[dtx->Sound.SoundVar2]->LowLev,
                                 row, col );
       }
+      if (!yo) return 0;
       
       if (font_info)
 	   XSetFont(SndDpy, dtx->Sound.var2_gc, font_info->fid);
@@ -2403,39 +2126,15 @@ int draw_sounding( Display_Context dtx, int time )
       }
 
    }
-   else {
-      if (dtx->Sound.var2grid != NULL ){
-         release_grid(dtx->Sound.PreviousSoundVar2Owner, time,
-                      dtx->Sound.PreviousSoundVar2, dtx->Sound.var2grid);
-         dtx->Sound.var2grid = NULL;
-      }
-   }
 
 
 
    if( dtx->Sound.SoundVar3 >= 0){
       varownerctx  = dtx->Sound.SoundVar3Owner;
-      prvownerctx  = dtx->Sound.PreviousSoundVar3Owner;
-
-      if ( (dtx->Sound.SoundVar3 != dtx->Sound.PreviousSoundVar3) &&
-           (varownerctx != prvownerctx) && (dtx->Sound.var3grid != NULL) ){
-         release_grid( prvownerctx, time,
-                       dtx->Sound.PreviousSoundVar3, dtx->Sound.var3grid );
-         dtx->Sound.var3grid = NULL;
-      }
-      dtx->Sound.PreviousSoundVar3      = dtx->Sound.SoundVar3;
-      dtx->Sound.PreviousSoundVar3Owner = varownerctx;
-
-      if (dtx->Sound.var3grid == NULL ){
-         dtx->Sound.var3grid = get_grid( varownerctx, time,
-                                         dtx->Sound.SoundVar3);
-         if (dtx->Sound.var3grid == NULL) return 0;
-      }
 
       if (varownerctx->GridSameAsGridPRIME){
-         yo= extract_sound( dtx, dtx->Sound.var3grid, dtx->Sound.SoundVar3,
-                            dtx->Nr, dtx->Nc, dtx->Nl,
-                            dtx->LowLev, row, col );
+         yo= extract_sound( dtx, varownerctx, dtx->Sound.SoundVar3,
+                            row, col );
       }
       else{
          yo= extract_soundPRIME(varownerctx, dtx->Sound.SoundVar3,
@@ -2444,6 +2143,7 @@ int draw_sounding( Display_Context dtx, int time )
                                 varownerctx->Variable[dtx->Sound.SoundVar3]->LowLev,
                                 row, col );
       }
+      if (!yo) return 0;
 
       if (font_info)
 	   XSetFont(SndDpy, dtx->Sound.var3_gc, font_info->fid);
@@ -2460,13 +2160,6 @@ int draw_sounding( Display_Context dtx, int time )
       }
 
    }
-   else {
-      if (dtx->Sound.var3grid != NULL ){
-         release_grid(dtx->Sound.PreviousSoundVar3Owner, time,
-                      dtx->Sound.PreviousSoundVar3, dtx->Sound.var3grid);
-         dtx->Sound.var3grid = NULL;
-      }
-   }
 
    if (font_info)
 	XFreeFontInfo(NULL, font_info, 0);
@@ -2654,96 +2347,26 @@ float grid_level_to_height( Display_Context dtx, float level )
     /* This interpolates values in between grid points                    */
     /**********************************************************************/
     /* Input: dtx - context                                               */
-    /*        grid - grid array                                           */
-    /*        var - variable to extract form grid                         */
-    /*        nr, nc, nl - number or rows, columns, and levels for varible*/
-    /*        lowlev - the lowest level for the variable                  */
+    /*        ctx - data context owning the variable                      */
+    /*        var - variable to extract                                   */
     /*        row, col - row and column where cursor is                   */
     /* Output: return 1 if all goes well                                  */
     /**********************************************************************/
 
-static int extract_sound( Display_Context dtx, float *grid, int var,
-                             int nr, int nc, int nl, int lowlev,
+static int extract_sound( Display_Context dtx, Context ctx, int var,
                              float row, float col)
 {
-   float a, b, c, d;
-   float I, J, K, L, E, F, Z;
-   int  level, lowrow, highrow, leftcol, rightcol;
-
-
    /* allocate buffer to put soundline data into */
    if (dtx->Sound.soundline != NULL){
       free(dtx->Sound.soundline);
    }
-   dtx->Sound.soundline = (float *) malloc(nl * sizeof(float) );
+   dtx->Sound.soundline = (float *) malloc(ctx->Nl[var] * sizeof(float) );
    if (!dtx->Sound.soundline) {
      return 0;
    }
 
-   /*
-    *  The best way to see the interpolation here is to draw a box
-    *  each of the four coners represents a discrete grid point with a certain
-    *  given value and the cursor lies someplace in side this box or on the BORDER
-    *  of it.  The box has sides: TOP, BOTTOM, LEFT, and RIGHT.   Rows increase
-    *  going down, and Cols increase going right.  So
-    *  the upper left  corner is (leftcol, lowrow)  with a data value I
-    *  the upper right corner is (rightcol,lowrow)  with a data value J
-    *  the lower left  corner is (leftcol, highrow) with a data value K
-    *  the lower right corner is (rightcol,highrow) with a data value L
-    *  q is the point where the cursor col intersects the BOTTOM line
-    *  r is the point where the cursor col intersects the TOP line
-    *  s is the point on the line between q and r where the cursor lies
-    *  E is the interpolated value for the point q
-    *  F is the interpolated value for the point r
-    *  Then one simply interpolates for what the value of the point s is
-    *
-    */
-
-   level = lowlev;
-   lowrow = (int) row;
-   leftcol = (int) col;
-   highrow = lowrow + 1;
-   rightcol = leftcol + 1;
-
-   if (highrow > nr-1)
-      highrow = nr-1;
-   if (rightcol > nc-1)
-      rightcol = nc-1;
-
-   a = col - leftcol;
-   b = 1 - a;
-   c = row - lowrow;
-   d = 1 - c;
-
-   if ( (row == ((float)lowrow)) && (col == ((float)leftcol)) ){
-      for (level = lowlev; level < nl; level++){
-         Z = grid[ lowrow + nr * (leftcol + nc * level)];
-         if (IS_MISSING(Z)){
-            dtx->Sound.soundline[level] = MISSING;
-         }
-         else{
-            dtx->Sound.soundline[level] = Z;
-         }
-      }
-   }
-   else {
-      for (level = lowlev; level < nl; level++){
-         /* get values for the four coners of the (col, row) box */
-         I = grid[ lowrow + nr * (leftcol + nc * level)];
-         J = grid[ lowrow + nr * (rightcol+ nc * level)];
-         K = grid[ highrow+ nr * (leftcol + nc * level)];
-         L = grid[ highrow+ nr * (rightcol+ nc * level)];
-         if (IS_MISSING(I) || IS_MISSING(J) || IS_MISSING(K) || IS_MISSING(L)) {
-            dtx->Sound.soundline[level] = MISSING;
-         }
-         else {
-            E = a * L +  b * K ;
-            F = a * J +  b * I ;
-            dtx->Sound.soundline[level] = c * E + d * F;
-         }
-      }
-   }
-   return 1;
+   /* only the column under the cursor is decompressed, see get_column */
+   return get_column( ctx, ctx->CurTime, var, row, col, dtx->Sound.soundline );
 }
 
 static int extract_soundPRIME( Context ctx, int var,
@@ -2783,23 +2406,19 @@ static int extract_soundPRIME( Context ctx, int var,
     /* This interpolates values in between grid points, for wind variables*/
     /**********************************************************************/
     /* Input: dtx - context                                               */
-    /*        ugrid, vgrid  - grid arrays                                 */
-    /*        varu, varv - variable to extract form grid                  */
-    /*        nr, nc, nl - number or rows, columns, and levels for varible*/
-    /*        lowlev - the lowest level for the variables                 */
+    /*        uctx, vctx - data contexts owning the wind variables        */
+    /*        varu, varv - variables to extract                           */
     /*        row, col - row and column where cursor is                   */
     /* Output: return 1 if all goes well                                  */
     /**********************************************************************/
 
-static int extract_wind( Display_Context dtx, float *gridu, float *gridv,
+static int extract_wind( Display_Context dtx, Context uctx, Context vctx,
                              int varu, int varv,
-                             int nr, int nc, int nl, int lowlev,
                              float row, float col)
 {
-   float a, b, c, d;
-   float I, J, K, L, E, F, Z;
-   int  level, lowrow, highrow, leftcol, rightcol;
+   int nl, level;
 
+   nl = uctx->Nl[varu] > vctx->Nl[varv] ? uctx->Nl[varu] : vctx->Nl[varv];
 
    /* allocate buffer to put windline data into */
 
@@ -2827,77 +2446,17 @@ static int extract_wind( Display_Context dtx, float *gridu, float *gridv,
       return 0;
    }
 
-   level = lowlev;
-   lowrow = (int) row;
-   leftcol = (int) col;
-   highrow = lowrow + 1;
-   rightcol = leftcol + 1;
-
-   if (highrow > nr-1)
-      highrow = nr-1;
-   if (rightcol > nc-1)
-      rightcol = nc-1;
-
-   a = col - leftcol;
-   b = 1 - a;
-   c = row - lowrow;
-   d = 1 - c;
-
-   if ( (row == ((float)lowrow)) && (col == ((float)leftcol)) ){
-      for (level = lowlev; level < nl; level++){
-         Z = gridu[ lowrow + nr * (leftcol + nc * level)];
-         if (IS_MISSING(Z)){
-            dtx->Sound.uwindline[level] = MISSING;
-         }
-         else{
-            dtx->Sound.uwindline[level] = Z;
-         }
-      }
-      for (level = lowlev; level < nl; level++){
-         Z = gridv[ lowrow + nr * (leftcol + nc * level)];
-         if (IS_MISSING(Z)){
-            dtx->Sound.vwindline[level] = MISSING;
-         }
-         else{
-            dtx->Sound.vwindline[level] = Z;
-         }
-      }
-   return 1;
+   if (!get_column( uctx, uctx->CurTime, varu, row, col, dtx->Sound.uwindline ) ||
+       !get_column( vctx, vctx->CurTime, varv, row, col, dtx->Sound.vwindline )) {
+      return 0;
    }
-   else {
-      for (level = lowlev; level < nl; level++){
-         /* get values for the four coners of the (col, row) box */
-         I = gridu[ lowrow + nr * (leftcol + nc * level)];
-         J = gridu[ lowrow + nr * (rightcol+ nc * level)];
-         K = gridu[ highrow+ nr * (leftcol + nc * level)];
-         L = gridu[ highrow+ nr * (rightcol+ nc * level)];
-         if (IS_MISSING(I) || IS_MISSING(J) || IS_MISSING(K) || IS_MISSING(L)) {
-            dtx->Sound.uwindline[level] = MISSING;
-         }
-         else {
-            E = a * L +  b * K ;
-            F = a * J +  b * I ;
-            dtx->Sound.uwindline[level] = c * E + d * F;
-         }
-      }
-
-      for (level = lowlev; level < nl; level++){
-         /* get values for the four coners of the (col, row) box */
-         I = gridv[ lowrow + nr * (leftcol + nc * level)];
-         J = gridv[ lowrow + nr * (rightcol+ nc * level)];
-         K = gridv[ highrow+ nr * (leftcol + nc * level)];
-         L = gridv[ highrow+ nr * (rightcol+ nc * level)];
-         if (IS_MISSING(I) || IS_MISSING(J) || IS_MISSING(K) || IS_MISSING(L)) {
-            dtx->Sound.vwindline[level] = MISSING;
-         }
-         else {
-            E = a * L +  b * K ;
-            F = a * J +  b * I ;
-            dtx->Sound.vwindline[level] = c * E + d * F;
-         }
-      }
-      return 1;
+   for (level = uctx->Nl[varu]; level < nl; level++){
+      dtx->Sound.uwindline[level] = MISSING;
    }
+   for (level = vctx->Nl[varv]; level < nl; level++){
+      dtx->Sound.vwindline[level] = MISSING;
+   }
+   return 1;
 }
 
 static int extract_windPRIME( Context ctx, 
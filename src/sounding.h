@@ -32,7 +32,6 @@
 
 #include "globals.h"
 
-extern int reload_sounding_data( Display_Context dtx );
 
 extern int draw_sounding( Display_Context dtx, int time);
 
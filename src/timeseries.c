@@ -0,0 +1,349 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+#include "../config.h"
+
+/* Values of a variable over a range of timesteps */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "grid.h"
+#include "memory.h"
+#include "parallel.h"
+#include "timeseries.h"
+
+
+
+#define MIN2( X, Y )        ( (X) < (Y) ? (X) : (Y) )
+#define MAX2( X, Y )        ( (X) > (Y) ? (X) : (Y) )
+
+
+/*
+ * A time series is computed one timestep at a time, and idle worker
+ * threads may help with the timesteps through run_parallel_job().  For
+ * each timestep only the box of grid points around the wanted positions
+ * is decompressed, with read_grid_box(), or just the cell around each
+ * position if they are scattered across the grid, so grids which aren't
+ * already in the cache don't push others out of it.
+ */
+/* Positions are read as one box only if it has at most this many */
+/* grid points per position, else the cell around each is read. */
+#define TIMESERIES_BOX_POINTS 64
+
+
+/* What the timesteps of one time series share */
+struct timeseries_job {
+   Context ctx;
+   int var, time0, numtimes;
+   int row0, col0, lev0;          /* box of grid points to read */
+   int nr, nc, nl;
+   int numpoints;                 /* 0 = return the box itself */
+   int cells;                     /* read the cell around each position */
+   const float *row, *col, *lev;  /* positions relative to the box, or */
+                                  /* to the grid if cells; row < 0 if */
+                                  /* outside the grid */
+   float *series;
+};
+
+
+
+/*
+ * Trilinear interpolation in a box of grid values, giving the same
+ * values as interpolate_grid_value().
+ */
+static float sample_box( const float *box, int nr, int nc, int nl,
+                         float row, float col, float lev )
+{
+   int i0, j0, k0, di, dj, dk;
+   float ei, ej, ek, d;
+   const float *p;
+   float d0, d1, d2, d3, d4, d5, d6, d7;
+
+   i0 = (int) row;
+   j0 = (int) col;
+   k0 = (int) lev;
+   ei = row - (float) i0;
+   ej = col - (float) j0;
+   ek = lev - (float) k0;
+   /* stay on the row, column or level at the box's edge or when
+      exactly on it */
+   di = (i0<nr-1 && ei!=0.0f) ? 1 : 0;
+   dj = (j0<nc-1 && ej!=0.0f) ? nr : 0;
+   dk = (k0<nl-1 && ek!=0.0f) ? nr*nc : 0;
+
+   p = box + (k0 * nc + j0) * nr + i0;
+   d0 = p[0];        d1 = p[di];
+   d2 = p[dj];       d3 = p[dj+di];
+   d4 = p[dk];       d5 = p[dk+di];
+   d6 = p[dk+dj];    d7 = p[dk+dj+di];
+   if (IS_MISSING(d0) || IS_MISSING(d1) || IS_MISSING(d2) ||
+       IS_MISSING(d3) || IS_MISSING(d4) || IS_MISSING(d5) ||
+       IS_MISSING(d6) || IS_MISSING(d7)) {
+      return MISSING;
+   }
+
+   d = ( d0 * (1.0-ei) * (1.0-ej)
+       + d1 * ei       * (1.0-ej)
+       + d2 * (1.0-ei) * ej
+       + d3 * ei       * ej       ) * (1.0-ek)
+     + ( d4 * (1.0-ei) * (1.0-ej)
+       + d5 * ei       * (1.0-ej)
+       + d6 * (1.0-ei) * ej
+       + d7 * ei       * ej       ) * ek;
+   return d;
+}
+
+
+
+/*
+ * Compute the values of one timestep of a time series from the grid
+ * cells around its positions.
+ */
+static void cells_step( struct timeseries_job *job, int step )
+{
+   Context ctx = job->ctx;
+   float *out = job->series + (PTRINT) step * job->numpoints;
+   float cell[8];
+   int i;
+
+   for (i=0;i<job->numpoints;i++) {
+      float row = job->row[i], col = job->col[i], lev = job->lev[i];
+      int i0, j0, k0, ni, nj, nk;
+
+      if (row < 0.0) {
+         out[i] = MISSING;
+         continue;
+      }
+      i0 = (int) row;
+      j0 = (int) col;
+      k0 = (int) lev;
+      ni = (i0<ctx->Nr-1 && row!=(float) i0) ? 2 : 1;
+      nj = (j0<ctx->Nc-1 && col!=(float) j0) ? 2 : 1;
+      nk = (k0<ctx->Nl[job->var]-1 && lev!=(float) k0) ? 2 : 1;
+      if (read_grid_box( ctx, job->time0+step, job->var, i0, j0, k0,
+                         ni, nj, nk, cell )) {
+         out[i] = sample_box( cell, ni, nj, nk, row - i0, col - j0,
+                              lev - k0 );
+      }
+      else {
+         out[i] = MISSING;
+      }
+   }
+}
+
+
+
+/*
+ * Compute the values of one timestep of a time series, see
+ * run_parallel_job().
+ */
+static void series_step( void *data, int step )
+{
+   struct timeseries_job *job = (struct timeseries_job *) data;
+   Context ctx = job->ctx;
+   PTRINT size = (PTRINT) job->nr * job->nc * job->nl;
+   float *box, *out;
+   int n, i;
+
+   if (job->cells) {
+      cells_step( job, step );
+      return;
+   }
+
+   n = job->numpoints ? job->numpoints : size;
+   out = job->series + (PTRINT) step * n;
+
+   box = job->numpoints ? (float *) allocate( ctx, size * sizeof(float) )
+                        : out;
+   if (!box || !read_grid_box( ctx, job->time0+step, job->var,
+                               job->row0, job->col0, job->lev0,
+                               job->nr, job->nc, job->nl, box )) {
+      for (i=0;i<n;i++) {
+         out[i] = MISSING;
+      }
+   }
+   else if (job->numpoints) {
+      for (i=0;i<n;i++) {
+         out[i] = (job->row[i] < 0.0) ? MISSING
+                  : sample_box( box, job->nr, job->nc, job->nl,
+                                job->row[i], job->col[i], job->lev[i] );
+      }
+   }
+
+   if (job->numpoints && box) {
+      deallocate( ctx, box, size * sizeof(float) );
+   }
+}
+
+
+
+/*
+ * Get the values of a variable at some positions over a range of
+ * timesteps.  Each grid is read at most once and only around the
+ * positions.
+ * Input:  ctx - the context
+ *         var - the variable
+ *         time0, numtimes - the timesteps, checked by the caller
+ *         numpoints - number of positions
+ *         points - array [numpoints][3] of row, column, level positions
+ *                  as taken by interpolate_grid_value()
+ * Output:  series - array [numtimes][numpoints] of values, MISSING at
+ *                   positions outside of the grid
+ * Return:  1 = ok, 0 = out of memory.
+ */
+int get_time_series( Context ctx, int var, int time0, int numtimes,
+                     int numpoints, const float points[], float series[] )
+{
+   struct timeseries_job job;
+   float *pos;
+   int r0, r1, c0, c1, l0, l1, inside, i;
+   PTRINT j, n;
+
+   if (numpoints<=0 || numtimes<=0) {
+      return 1;
+   }
+   pos = (float *) allocate( ctx, 3 * numpoints * sizeof(float) );
+   if (!pos) {
+      return 0;
+   }
+
+   /* box of grid points around the positions inside the grid */
+   r0 = ctx->Nr;  c0 = ctx->Nc;  l0 = ctx->Nl[var];
+   r1 = c1 = l1 = -1;
+   inside = 0;
+   for (i=0;i<numpoints;i++) {
+      float row = points[3*i+0];
+      float col = points[3*i+1];
+      float lev = points[3*i+2] - ctx->Variable[var]->LowLev;
+      if (lev < 0 || lev >= ctx->Nl[var] ||
+          col < 0 || col >= ctx->Nc ||
+          row < 0 || row >= ctx->Nr) {
+         continue;
+      }
+      inside++;
+      r0 = MIN2( r0, (int) row );
+      r1 = MAX2( r1, MIN2( (int) row + 1, ctx->Nr - 1 ) );
+      c0 = MIN2( c0, (int) col );
+      c1 = MAX2( c1, MIN2( (int) col + 1, ctx->Nc - 1 ) );
+      l0 = MIN2( l0, (int) lev );
+      l1 = MAX2( l1, MIN2( (int) lev + 1, ctx->Nl[var] - 1 ) );
+   }
+
+   if (!inside) {
+      n = (PTRINT) numtimes * numpoints;
+      for (j=0;j<n;j++) {
+         series[j] = MISSING;
+      }
+      deallocate( ctx, pos, 3 * numpoints * sizeof(float) );
+      return 1;
+   }
+
+   job.ctx = ctx;
+   job.var = var;
+   job.time0 = time0;
+   job.numtimes = numtimes;
+   job.row0 = r0;
+   job.col0 = c0;
+   job.lev0 = l0;
+   job.nr = r1 - r0 + 1;
+   job.nc = c1 - c0 + 1;
+   job.nl = l1 - l0 + 1;
+   job.numpoints = numpoints;
+   job.cells = (PTRINT) job.nr * job.nc * job.nl
+               > (PTRINT) TIMESERIES_BOX_POINTS * inside;
+   if (job.cells) {
+      job.row0 = job.col0 = job.lev0 = 0;
+   }
+   job.row = pos;
+   job.col = pos + numpoints;
+   job.lev = pos + 2 * numpoints;
+   for (i=0;i<numpoints;i++) {
+      float row = points[3*i+0];
+      float col = points[3*i+1];
+      float lev = points[3*i+2] - ctx->Variable[var]->LowLev;
+      if (lev < 0 || lev >= ctx->Nl[var] ||
+          col < 0 || col >= ctx->Nc ||
+          row < 0 || row >= ctx->Nr) {
+         pos[i] = -1.0;
+      }
+      else {
+         pos[i] = row - job.row0;
+         pos[numpoints+i] = col - job.col0;
+         pos[2*numpoints+i] = lev - job.lev0;
+      }
+   }
+   job.series = series;
+
+   run_parallel_job( ctx, series_step, &job, numtimes );
+
+   deallocate( ctx, pos, 3 * numpoints * sizeof(float) );
+   return 1;
+}
+
+
+
+/*
+ * Get a box of grid values of a variable over a range of timesteps.
+ * Input:  ctx - the context
+ *         var - the variable
+ *         time0, numtimes - the timesteps, checked by the caller
+ *         row0, col0, lev0 - first row, column and level of the box,
+ *                            levels counted from the variable's lowest
+ *         nr, nc, nl - size of the box, checked by the caller
+ * Output:  series - array [numtimes][nl][nc][nr] of values
+ */
+int get_time_series_box( Context ctx, int var, int time0, int numtimes,
+                         int row0, int col0, int lev0,
+                         int nr, int nc, int nl, float series[] )
+{
+   struct timeseries_job job;
+
+   job.ctx = ctx;
+   job.var = var;
+   job.time0 = time0;
+   job.numtimes = numtimes;
+   job.row0 = row0;
+   job.col0 = col0;
+   job.lev0 = lev0;
+   job.nr = nr;
+   job.nc = nc;
+   job.nl = nl;
+   job.numpoints = 0;
+   job.cells = 0;
+   job.row = job.col = job.lev = NULL;
+   job.series = series;
+
+   if (numtimes>0) {
+      run_parallel_job( ctx, series_step, &job, numtimes );
+   }
+   return 1;
+}
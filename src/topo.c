@@ -42,6 +42,7 @@
 #include "graphics.h"
 #include "image.h"
 #include "memory.h"
+#include "parallel.h"
 #include "proj.h"
 #include "topo.h"
 #include "user_data.h"
@@ -53,6 +54,51 @@
 #define HI_RES_VERTS 50000
 
 
+#define MIN2( X, Y )        ( (X) < (Y) ? (X) : (Y) )
+#define MAX2( X, Y )        ( (X) > (Y) ? (X) : (Y) )
+
+/* Summed-area tables are kept in unsigned ints and differenced modulo */
+/* 2^32, which is exact while a sample box holds fewer than 2^31/2^14 */
+/* heights.  Bigger boxes are summed directly, as are files too big */
+/* for a table. */
+#define TOPO_SUMS_MAXBOX    131072
+#define TOPO_SUMS_MAXCELLS  (32*1024*1024)
+
+#define TOPO_BATCH          256     /* vertices per projection call */
+#define TOPO_BAND_VERTS     4096    /* min vertices per band */
+#define MAX_TOPO_BANDS      32
+
+/* Passes of the quadmesh construction, done in bands of rows */
+#define TOPO_VERTICES       0
+#define TOPO_FACETS         1
+#define TOPO_NORMALS        2
+#define TOPO_STRIPS         3
+
+
+/* What the bands of one pass share */
+struct topo_job {
+   Display_Context dtx;
+   struct Topo *topo;
+   int pass;                      /* TOPO_VERTICES, etc. */
+   int first, last;               /* rows first..last-1 */
+   int qr, qc;
+   double dx, delta_s;            /* column steps of a rectangular box */
+   double dlon;                   /* column step of a curved box */
+   const double *rowpos;          /* [qr] y or latitude of each row */
+   const double *rowtex;          /* [qr] texture t of each row */
+   float *topoheight;             /* [qr*qc] heights in km */
+   uint_1 *indexes;               /* [qr*qc] 255 = water */
+   float *qnorm;                  /* [qr+1][qc+1][3] facet normals */
+   int_vert2 *verts;              /* strip vertices and normals */
+   int_1 *norms;
+   int bandrows;
+   int numbands;
+};
+
+
+static void run_topo_job( struct topo_job *job );
+
+
 
 
 
@@ -132,27 +178,25 @@ int make_topo_strips (Display_Context dtx )
   norms = topo->TopoStripsNorms;
 
 
-  j = 0;
-  i = nc;
-  for (ir = 1; ir < nr; ir++)
+  /* one strip per pair of rows, made in bands of rows */
+  if (nr > 1)
     {
-		for (ic = 0; ic < nc; ic++, i++, j++)
-        {
-			 verts[0] = topo->TopoVertex[i*3+0] * VERTEX_SCALE;
-			 verts[1] = topo->TopoVertex[i*3+1] * VERTEX_SCALE;
-			 verts[2] = topo->TopoVertex[i*3+2] * VERTEX_SCALE;
-			 norms[0] = topo->TopoNormal[i*3+0] * NORMAL_SCALE;
-			 norms[1] = topo->TopoNormal[i*3+1] * NORMAL_SCALE;
-			 norms[2] = topo->TopoNormal[i*3+2] * NORMAL_SCALE;
-			 verts += 3, norms += 3;
-			 verts[0] = topo->TopoVertex[j*3+0] * VERTEX_SCALE;
-			 verts[1] = topo->TopoVertex[j*3+1] * VERTEX_SCALE;
-			 verts[2] = topo->TopoVertex[j*3+2] * VERTEX_SCALE;
-			 norms[0] = topo->TopoNormal[j*3+0] * NORMAL_SCALE;
-			 norms[1] = topo->TopoNormal[j*3+1] * NORMAL_SCALE;
-			 norms[2] = topo->TopoNormal[j*3+2] * NORMAL_SCALE;
-			 verts += 3, norms += 3;
-        }
+		struct topo_job job;
+
+		memset (&job, 0, sizeof (job));
+		job.dtx = dtx;
+		job.topo = topo;
+		job.pass = TOPO_STRIPS;
+		job.first = 1;
+		job.last = nr;
+		job.qr = nr;
+		job.qc = nc;
+		job.verts = verts;
+		job.norms = norms;
+		run_topo_job (&job);
+
+		verts += (nr - 1) * nc * 2 * 3;
+		norms += (nr - 1) * nc * 2 * 3;
     }
 
 
@@ -325,6 +369,64 @@ static int read_user_topo( Display_Context dtx, char *toponame )
 /* MJK 12.02.98 end */
 
 
+/*
+ * Free the summed-area table of the topography data.
+ */
+static void free_topo_sums( struct Topo *topo )
+{
+   if (topo->TopoSums) {
+      free( topo->TopoSums );
+      topo->TopoSums = NULL;
+   }
+}
+
+
+
+/*
+ * Make the summed-area table of the topography data, so elevation() can
+ * average a sample box with four lookups.  Entry [r][c] holds the sums
+ * of the heights and of the water flags of rows 0..r-1, columns 0..c-1.
+ * Nothing is made if the data is too big, elevation() then sums directly.
+ */
+static void make_topo_sums( struct Topo *topo )
+{
+   int rows, cols, r, c, val;
+   unsigned int *sums, *prev, rowhgt, rowwat;
+
+   free_topo_sums( topo );
+   rows = topo->Topo_rows;
+   cols = topo->Topo_cols;
+   if (!topo->TopoData || rows<=0 || cols<=0
+       || (double) (rows+1) * (cols+1) > TOPO_SUMS_MAXCELLS) {
+      return;
+   }
+   sums = (unsigned int *) malloc( (size_t) (rows+1) * (cols+1) * 2
+                                   * sizeof(unsigned int) );
+   if (!sums) {
+      return;
+   }
+
+   memset( sums, 0, (cols+1) * 2 * sizeof(unsigned int) );
+   for (r=1;r<=rows;r++) {
+      const short *data = topo->TopoData + (r-1) * cols;
+      unsigned int *s = sums + r * (cols+1) * 2;
+
+      prev = s - (cols+1) * 2;
+      s[0] = s[1] = 0;
+      rowhgt = rowwat = 0;
+      for (c=1;c<=cols;c++) {
+         val = data[c-1];
+         rowhgt += (unsigned int) (val / 2);
+         rowwat += val & 1;
+         s[c*2+0] = prev[c*2+0] + rowhgt;
+         s[c*2+1] = prev[c*2+1] + rowwat;
+      }
+   }
+   topo->TopoSums = sums;
+}
+
+
+
 /*
  * Read a topography file and initialize Topo and TopoData.
  * Input:  filename - name of topo file.
@@ -369,6 +471,7 @@ int read_topo( struct Topo *topo, char *filename )
    }
 	if(topo->TopoData)
 	  free(topo->TopoData);
+   free_topo_sums( topo );
 
    topo->TopoData = (short *) malloc(topo->Topo_rows * topo->Topo_cols * sizeof(short));
 
@@ -391,6 +494,7 @@ int read_topo( struct Topo *topo, char *filename )
    }
 
 	close(f);
+   make_topo_sums( topo );
    return 1;
 }
 
@@ -412,6 +516,7 @@ void free_topo( struct Topo **topoloc )
 
    if (topo->TopoData) 
 	  free( topo->TopoData);
+   free_topo_sums( topo );
 	if(topo->TopoVertex)
       free(topo->TopoVertex);
 	if(topo->TopoNormal)
@@ -535,15 +640,31 @@ float elevation( Display_Context dtx, struct Topo *topo, float lat, float lon, i
 
 
    /* find average height in sample area */
-   hgt = 0.0;
-   count = watcount = 0;
-   for (r=rowa;r<=rowb;r++) {
-      for (c=cola;c<=colb;c++) {
-         val = topo->TopoData[r*topo->Topo_cols+c];
-         if (val&1)
-            watcount++;
-         hgt += (float) (val / 2);
-         count++;
+   count = (rowb-rowa+1) * (colb-cola+1);
+   if (topo->TopoSums && rowa<=rowb && cola<=colb
+       && count<TOPO_SUMS_MAXBOX) {
+      /* four lookups in the summed-area table */
+      const unsigned int *sa, *sb;
+      int w2 = (topo->Topo_cols+1) * 2;
+
+      sa = topo->TopoSums + rowa * w2;
+      sb = topo->TopoSums + (rowb+1) * w2;
+      hgt = (float) (int) (sb[(colb+1)*2] - sb[cola*2]
+                           - sa[(colb+1)*2] + sa[cola*2]);
+      watcount = (int) (sb[(colb+1)*2+1] - sb[cola*2+1]
+                        - sa[(colb+1)*2+1] + sa[cola*2+1]);
+   }
+   else {
+      hgt = 0.0;
+      count = watcount = 0;
+      for (r=rowa;r<=rowb;r++) {
+         for (c=cola;c<=colb;c++) {
+            val = topo->TopoData[r*topo->Topo_cols+c];
+            if (val&1)
+               watcount++;
+            hgt += (float) (val / 2);
+            count++;
+         }
       }
    }
    hgt = hgt / (float) count;
@@ -648,6 +769,271 @@ void init_topo_color_table( unsigned int ct[], int size,
 
 
 
+/**********************************************************************/
+/***                 Parallel quadmesh construction                 ***/
+/**********************************************************************/
+
+
+/*
+ * Compute the vertices of quadmesh row i.
+ */
+static void vertex_row( struct topo_job *job, int i )
+{
+   Display_Context dtx = job->dtx;
+   struct Topo *topo = job->topo;
+   int qc = job->qc;
+   int j, k;
+
+   k = i * qc;
+   if (dtx->CurvedBox==0) {
+      /* Rectangular box:  generate vertices in graphics coords */
+      float x, y, z, lat, lon;
+      double xx, texture_s;
+
+      xx = dtx->Xmin;
+      texture_s = 0.0;
+      y = job->rowpos[i];
+      for (j=0; j<qc; j++) {
+         int water;
+         float hgt;
+
+         x = xx;
+         xyzPRIME_to_geo( dtx, -1, -1, x, y, 0.0, &lat, &lon, &hgt );
+         hgt = elevation( dtx, topo, lat, lon, &water ) / 1000.0;  /* hgt in km */
+/* MJK 2.17.99
+         z = height_to_zPRIME( dtx, hgt );
+*/
+         z = height_to_zTOPO( dtx, hgt );
+
+         /* WLH 3 Nov 98 - kludge topo for inverted VERT_GENERIC */
+         if (dtx->VerticalSystem == VERT_GENERIC &&
+             dtx->TopBound < dtx->BottomBound) {
+           z = dtx->Zmin + hgt / (dtx->BottomBound-dtx->TopBound)
+                    * (dtx->Zmax-dtx->Zmin);
+         }
+
+         z = ABS(dtx->Zmin - z) < 0.01 ? dtx->Zmin+0.01 : z;
+         topo->TopoVertex[k*3+0] = x;
+         topo->TopoVertex[k*3+1] = y;
+         topo->TopoVertex[k*3+2] = z;
+
+         job->topoheight[k] = hgt;  /* save topo height at this vertex */
+         /* if water flag is set, index will be 255 */
+         job->indexes[k] = (water) ? 255 : 0;
+
+         topo->TopoFlatVertex[k*3+0] = x;
+         topo->TopoFlatVertex[k*3+1] = y;
+         topo->TopoFlatVertex[k*3+2] = dtx->Zmin;
+
+         topo->TopoTexcoord[k*2+0] = texture_s;
+         topo->TopoTexcoord[k*2+1] = job->rowtex[i];
+
+         k++;
+         xx += job->dx;
+         texture_s += job->delta_s;
+      }
+   }
+   else {
+      /* Curved box:  generate vertices in geographic coordinates, */
+      /* projected TOPO_BATCH at a time */
+      float lat[TOPO_BATCH], lon[TOPO_BATCH], hgt[TOPO_BATCH];
+      float x[TOPO_BATCH], y[TOPO_BATCH], z[TOPO_BATCH];
+      double lonlon;
+      float texture_s, delta_s;
+      int j0, m;
+
+      delta_s = job->delta_s;
+      lonlon = dtx->WestBound;
+      texture_s = 0.0;
+      for (j0=0; j0<qc; j0+=TOPO_BATCH) {
+         m = MIN2( qc-j0, TOPO_BATCH );
+         for (j=0; j<m; j++) {
+            int water;
+
+            lat[j] = job->rowpos[i];
+            lon[j] = lonlon;
+            hgt[j] = elevation( dtx, topo, lat[j], lon[j], &water ) / 1000.0;  /* hgt in km */
+            job->topoheight[k+j] = hgt[j];
+            /* if water flag is set, index will be 255 */
+            job->indexes[k+j] = (water) ? 255 : 0;
+            lonlon -= job->dlon;
+         }
+/* MJK 2.17.99
+         geo_to_xyzPRIME( dtx, -1, -1, m, lat, lon, hgt, x, y, z );
+*/
+         geo_to_xyzTOPO( dtx, -1, -1, m, lat, lon, hgt, x, y, z );
+         for (j=0; j<m; j++) {
+            topo->TopoVertex[(k+j)*3+0] = x[j];
+            topo->TopoVertex[(k+j)*3+1] = y[j];
+            topo->TopoVertex[(k+j)*3+2] = z[j];
+            hgt[j] = dtx->BottomBound;
+         }
+         geo_to_xyzTOPO( dtx, -1, -1, m, lat, lon, hgt, x, y, z );
+         for (j=0; j<m; j++) {
+            topo->TopoFlatVertex[(k+j)*3+0] = x[j];
+            topo->TopoFlatVertex[(k+j)*3+1] = y[j];
+            topo->TopoFlatVertex[(k+j)*3+2] = z[j];
+
+            topo->TopoTexcoord[(k+j)*2+0] = texture_s;
+            topo->TopoTexcoord[(k+j)*2+1] = job->rowtex[i];
+            texture_s += delta_s;
+         }
+         k += m;
+      }
+   }
+}
+
+
+
+/*
+ * Compute the facet normals of the quads below quadmesh row i.  The
+ * normal of quad [i][j] goes to qnorm[i+1][j+1], leaving a border of
+ * zeros around them.
+ */
+static void facet_row( struct topo_job *job, int i )
+{
+   int qc = job->qc;
+   const float *v0 = job->topo->TopoVertex + i * qc * 3;
+   const float *v1 = v0 + qc * 3;
+   float *q = job->qnorm + ((i+1) * (qc+1) + 1) * 3;
+   float a0, a1, a2, b0, b1, b2;
+   int j;
+
+   for (j=0; j<qc-1; j++) {
+      /* a is the down vector, b is the right vector */
+      a0 = v1[j*3+0] - v0[j*3+0];
+      a1 = v1[j*3+1] - v0[j*3+1];
+      a2 = v1[j*3+2] - v0[j*3+2];
+      b0 = v0[j*3+3] - v0[j*3+0];
+      b1 = v0[j*3+4] - v0[j*3+1];
+      b2 = v0[j*3+5] - v0[j*3+2];
+      /* a cross b is the quad's facet normal */
+      q[j*3+0] =  a1*b2-a2*b1;
+      q[j*3+1] = -a0*b2+a2*b0;
+      q[j*3+2] =  a0*b1-a1*b0;
+   }
+}
+
+
+
+/*
+ * Compute the vertex normals of quadmesh row i by averaging the normals
+ * of the upper-left, upper-right, lower-left and lower-right quads.
+ * Thanks to the zero border there are always four, so the loop has no
+ * branches and can be vectorized.
+ */
+static void normal_row( struct topo_job *job, int i )
+{
+   int qc = job->qc;
+   const float *up = job->qnorm + i * (qc+1) * 3;
+   const float *lo = up + (qc+1) * 3;
+   float *n = job->topo->TopoNormal + i * qc * 3;
+   float n0, n1, n2, mag;
+   int j;
+
+   for (j=0; j<qc; j++) {
+      n0 = up[j*3+0] + up[j*3+3] + lo[j*3+0] + lo[j*3+3];
+      n1 = up[j*3+1] + up[j*3+4] + lo[j*3+1] + lo[j*3+4];
+      n2 = up[j*3+2] + up[j*3+5] + lo[j*3+2] + lo[j*3+5];
+      mag = sqrt( n0*n0 + n1*n1 + n2*n2 );
+      mag = (mag > 0.0) ? 1.0 / mag : 0.0;
+      n[j*3+0] = n0 * mag;
+      n[j*3+1] = n1 * mag;
+      n[j*3+2] = n2 * mag;
+   }
+}
+
+
+
+/*
+ * Make the triangle strip between quadmesh rows ir-1 and ir.
+ */
+static void strip_row( struct topo_job *job, int ir )
+{
+   struct Topo *topo = job->topo;
+   int nc = job->qc;
+   const float *v = topo->TopoVertex;
+   const float *nv = topo->TopoNormal;
+   int_vert2 *verts = job->verts + (ir-1) * nc * 2 * 3;
+   int_1 *norms = job->norms + (ir-1) * nc * 2 * 3;
+   int ic, i, j;
+
+   i = ir * nc;
+   j = i - nc;
+   for (ic = 0; ic < nc; ic++, i++, j++) {
+      verts[0] = v[i*3+0] * VERTEX_SCALE;
+      verts[1] = v[i*3+1] * VERTEX_SCALE;
+      verts[2] = v[i*3+2] * VERTEX_SCALE;
+      norms[0] = nv[i*3+0] * NORMAL_SCALE;
+      norms[1] = nv[i*3+1] * NORMAL_SCALE;
+      norms[2] = nv[i*3+2] * NORMAL_SCALE;
+      verts += 3, norms += 3;
+      verts[0] = v[j*3+0] * VERTEX_SCALE;
+      verts[1] = v[j*3+1] * VERTEX_SCALE;
+      verts[2] = v[j*3+2] * VERTEX_SCALE;
+      norms[0] = nv[j*3+0] * NORMAL_SCALE;
+      norms[1] = nv[j*3+1] * NORMAL_SCALE;
+      norms[2] = nv[j*3+2] * NORMAL_SCALE;
+      verts += 3, norms += 3;
+   }
+}
+
+
+
+/*
+ * Do one band of rows of a pass, see run_parallel_job().
+ */
+static void topo_band( void *data, int band )
+{
+   struct topo_job *job = (struct topo_job *) data;
+   int i, i0, i1;
+
+   i0 = job->first + band * job->bandrows;
+   i1 = MIN2( i0 + job->bandrows, job->last );
+   for (i=i0; i<i1; i++) {
+      switch (job->pass) {
+         case TOPO_VERTICES:
+            vertex_row( job, i );
+            break;
+         case TOPO_FACETS:
+            facet_row( job, i );
+            break;
+         case TOPO_NORMALS:
+            normal_row( job, i );
+            break;
+         case TOPO_STRIPS:
+            strip_row( job, i );
+            break;
+      }
+   }
+}
+
+
+
+/*
+ * Do rows first..last-1 of a pass, in bands which idle worker threads
+ * can help with when there are several.
+ */
+static void run_topo_job( struct topo_job *job )
+{
+   int rows;
+
+   rows = job->last - job->first;
+   if (rows<=0) {
+      return;
+   }
+   job->numbands = MAX2( 1, MIN2( rows * job->qc / TOPO_BAND_VERTS,
+                                  MAX_TOPO_BANDS ) );
+   job->numbands = MIN2( job->numbands, rows );
+   job->bandrows = (rows + job->numbands - 1) / job->numbands;
+   job->numbands = (rows + job->bandrows - 1) / job->bandrows;
+
+   run_parallel_job( NULL, topo_band, job, job->numbands );
+}
+
+
+
+
 /*
  * Generate the topography quadmesh.  This must be called after the
  * grid data set has been loaded.
@@ -659,14 +1045,15 @@ void init_topo_color_table( unsigned int ct[], int size,
 int init_topo( Display_Context dtx, char *toponame, int textureflag, int hi_res )
 {
    double dx, dy;
-   float lat, lon;
    float topo_dlat, topo_dlon;
-   float *topoheight;
-   int i, j;
+   float *topoheight, *qnorm;
+   double *rowpos, *rowtex;
+   int i;
    int topoflag = -1;
    int qr, qc;
    uint_1 *indexes;
    struct Topo *topo;
+   struct topo_job job;
 
 
    /* MJK 12.02.98 begin */
@@ -737,16 +1124,43 @@ int init_topo( Display_Context dtx, char *toponame, int textureflag, int hi_res
    indexes = malloc( qr*qc*1*sizeof(uint_1) );
    topo->TopoIndexes[MAXTIMES] = indexes;
 
+   /* heights are box averages, made fast by a summed-area table */
+   if (topo->TopoData && !topo->TopoSums) {
+      make_topo_sums( topo );
+   }
+
+   rowpos = (double *) malloc( qr*2*sizeof(double) );
+   qnorm = (float *) calloc( (qr+1) * (qc+1) * 3, sizeof(float) );
+   /* qnorm = (float *) allocate( dtx, qc * qr * 3 * sizeof(float) ); */
+   if (!rowpos || !qnorm || !topoheight || !indexes || !topo->TopoVertex
+       || !topo->TopoNormal || !topo->TopoTexcoord || !topo->TopoFlatVertex) {
+      printf("ERROR: Failed to allocate space for topography\n");
+      if (rowpos)  free( rowpos );
+      if (qnorm)  free( qnorm );
+      if (topoheight)  free( topoheight );
+      return 0;
+   }
+   rowtex = rowpos + qr;
+
+   memset( &job, 0, sizeof(job) );
+   job.dtx = dtx;
+   job.topo = topo;
+   job.qr = qr;
+   job.qc = qc;
+   job.rowpos = rowpos;
+   job.rowtex = rowtex;
+   job.topoheight = topoheight;
+   job.indexes = indexes;
+   job.qnorm = qnorm;
+
    /*
     * Compute topography vertices.
     */
    if (dtx->CurvedBox==0) {
       /* Rectangular box:  generate vertices in graphics coords */
-      int k;
-      float x, y, z;
 
       /* MJK 12.15.98 */
-      double xx, yy, texture_s, texture_t, delta_s, delta_t;
+      double yy, texture_t, delta_s, delta_t;
 
       dx = (dtx->Xmax-dtx->Xmin) / (float) (qc-1);
       dy = (dtx->Ymax-dtx->Ymin) / (float) (qr-1);
@@ -764,120 +1178,52 @@ int init_topo( Display_Context dtx, char *toponame, int textureflag, int hi_res
          topo_dlon = (topo->Topo_westlon-topo->Topo_eastlon) / topo->Topo_cols;
          topo->LonSample = CLAMP( (int) (2.0*dx/topo_dlon), 2, 20 );
       }
-      k = 0;
+
+      /* y and texture t of each row */
       yy = dtx->Ymax;
       texture_t = 0.0;
       for (i=0; i<qr; i++) {
-         xx = dtx->Xmin;
-         texture_s = 0.0;
-         y = yy;
-         for (j=0; j<qc; j++) {
-            int water;
-            float hgt;
-
-            x = xx;
-            xyzPRIME_to_geo( dtx, -1, -1, x, y, 0.0, &lat, &lon, &hgt );
-            hgt = elevation( dtx, dtx->topo, lat, lon, &water ) / 1000.0;  /* hgt in km */
-/* MJK 2.17.99
-            z = height_to_zPRIME( dtx, hgt );
-*/
-            z = height_to_zTOPO( dtx, hgt );
-
-            /* WLH 3 Nov 98 - kludge topo for inverted VERT_GENERIC */
-            if (dtx->VerticalSystem == VERT_GENERIC &&
-                dtx->TopBound < dtx->BottomBound) {
-              z = dtx->Zmin + hgt / (dtx->BottomBound-dtx->TopBound)
-                       * (dtx->Zmax-dtx->Zmin);
-            }
-
-            z = ABS(dtx->Zmin - z) < 0.01 ? dtx->Zmin+0.01 : z;
-            topo->TopoVertex[k*3+0] = x;
-            topo->TopoVertex[k*3+1] = y;
-            topo->TopoVertex[k*3+2] = z;
-
-            topoheight[k] = hgt;  /* save topo height at this vertex */
-            /* if water flag is set, index will be 255 */
-            indexes[k] = (water) ? 255 : 0;
-
-            topo->TopoFlatVertex[k*3+0] = x;
-            topo->TopoFlatVertex[k*3+1] = y;
-            topo->TopoFlatVertex[k*3+2] = dtx->Zmin;
-
-            topo->TopoTexcoord[k*2+0] = texture_s;
-            topo->TopoTexcoord[k*2+1] = texture_t;
-
-            k++;
-            xx += dx;
-            texture_s += delta_s;
-         }
+         rowpos[i] = (float) yy;
+         rowtex[i] = texture_t;
          yy -= dy;
          texture_t += delta_t;
       }
-	
-
+      job.dx = dx;
+      job.delta_s = delta_s;
    }
    else {
       /* Curved box:  generate vertices in geographic coordinates */
 
-      float lat, lon;
-      double latlat, lonlon;
-      double dlat, dlon;
-      int k;
-      float texture_s, texture_t, delta_s, delta_t;
+      double latlat;
+      double dlat;
+      float texture_t, delta_s, delta_t;
 
       dlat = (dtx->NorthBound - dtx->SouthBound) / (float) (qr-1);
-      dlon = (dtx->WestBound - dtx->EastBound) / (float) (qc-1);
+      job.dlon = (dtx->WestBound - dtx->EastBound) / (float) (qc-1);
 
       delta_s = 1.0 / (float) (qc-1);
       delta_t = 1.0 / (float) (qr-1);
 
-      k = 0;
+      /* latitude and texture t of each row */
       latlat = dtx->NorthBound;
       texture_t = 0.0;
       for (i=0; i<qr; i++) {
-         lonlon = dtx->WestBound;
-         lat = latlat;
-         texture_s = 0.0;
-         for (j=0; j<qc; j++) {
-            int water;
-            float hgt, x, y, z;
-
-            lon = lonlon;
-            hgt = elevation( dtx, dtx->topo, lat, lon, &water ) / 1000.0;  /* hgt in km */
-/* MJK 2.17.99
-            geo_to_xyzPRIME( dtx, -1, -1, 1, &lat, &lon, &hgt, &x, &y, &z );
-*/
-            geo_to_xyzTOPO( dtx, -1, -1, 1, &lat, &lon, &hgt, &x, &y, &z );
-            topo->TopoVertex[k*3+0] = x;
-            topo->TopoVertex[k*3+1] = y;
-            topo->TopoVertex[k*3+2] = z;
-
-            topoheight[k] = hgt;
-            /* if water flag is set, index will be 255 */
-            indexes[k] = (water) ? 255 : 0;
-
-            hgt = dtx->BottomBound;
-/* MJK 2.17.99            
-            geo_to_xyzPRIME( dtx, -1, -1, 1, &lat, &lon, &hgt, &x, &y, &z );
-*/
-            geo_to_xyzTOPO( dtx, -1, -1, 1, &lat, &lon, &hgt, &x, &y, &z );
-            topo->TopoFlatVertex[k*3+0] = x;
-            topo->TopoFlatVertex[k*3+1] = y;
-            topo->TopoFlatVertex[k*3+2] = z;
-
-            topo->TopoTexcoord[k*2+0] = texture_s;
-            topo->TopoTexcoord[k*2+1] = texture_t;
-
-            k++;
-            lonlon -= dlon;
-            texture_s += delta_s;
-         }
+         rowpos[i] = (float) latlat;
+         rowtex[i] = texture_t;
          latlat -= dlat;
          texture_t += delta_t;
       }
-
+      job.delta_s = delta_s;
    }
 
+   /* The first row is done here, which sets up any tables the */
+   /* projection functions build on first use before threads share them. */
+   vertex_row( &job, 0 );
+   job.pass = TOPO_VERTICES;
+   job.first = 1;
+   job.last = qr;
+   run_topo_job( &job );
+
    /* Find MinTopoHgt and MaxTopoHgt */
    topo->MinTopoHgt = 10000.0;
    topo->MaxTopoHgt = -10000.0;
@@ -908,83 +1254,25 @@ int init_topo( Display_Context dtx, char *toponame, int textureflag, int hi_res
 
    /* done with topoheight array */
    free( topoheight );
+   free( rowpos );
 
    /* compute quadmesh normal vectors */
-   {
-      float *qnorm;
-
-      qnorm = (float *) malloc( qc * qr * 3 * sizeof(float) );
-      /* qnorm = (float *) allocate( dtx, qc * qr * 3 * sizeof(float) ); */
-
-      /* step 1: compute surface normal for each quadrilateral. */
-      for (i=0;i<qr-1;i++) {
-         for (j=0;j<qc-1;j++) {
-            float a[3], b[3];
-            int index;
-
-            index = (i*qc+j)*3;
-            /* a is the down vector, b is the right vector */
-            a[0] = topo->TopoVertex[index+qc*3+0] - topo->TopoVertex[index+0];
-            a[1] = topo->TopoVertex[index+qc*3+1] - topo->TopoVertex[index+1];
-            a[2] = topo->TopoVertex[index+qc*3+2] - topo->TopoVertex[index+2];
-            b[0] = topo->TopoVertex[index+3+0] - topo->TopoVertex[index+0];
-            b[1] = topo->TopoVertex[index+3+1] - topo->TopoVertex[index+1];
-            b[2] = topo->TopoVertex[index+3+2] - topo->TopoVertex[index+2];
-            /* a cross b is the quad's facet normal */
-            qnorm[index+0] =  a[1]*b[2]-a[2]*b[1];
-            qnorm[index+1] = -a[0]*b[2]+a[2]*b[0];
-            qnorm[index+2] =  a[0]*b[1]-a[1]*b[0];
-         }
-      }
 
-      /* step 2: compute vertex normals by averaging adjacent */
-      /* quadrilateral normals. */
-      for (i=0;i<qr;i++) {
-         for (j=0;j<qc;j++) {
-            float n[3], mag;
-            int index;
-
-            index = (i*qc+j)*3;
-
-            n[0] = n[1] = n[2] = 0.0;
-            /* upper-left quad */
-            if (i>0 && j>0) {
-               n[0] += qnorm[ index-qc*3-3+0 ];
-               n[1] += qnorm[ index-qc*3-3+1 ];
-               n[2] += qnorm[ index-qc*3-3+2 ];
-            }
-            /* upper-right quad */
-            if (i>0 && j<qc-1) {
-               n[0] += qnorm[ index-qc*3+0 ];
-               n[1] += qnorm[ index-qc*3+1 ];
-               n[2] += qnorm[ index-qc*3+2 ];
-            }
-            /* lower-left quad */
-            if (i<qr-1 && j>0) {
-               n[0] += qnorm[ index-3+0 ];
-               n[1] += qnorm[ index-3+1 ];
-               n[2] += qnorm[ index-3+2 ];
-            }
-            /* lower-right quad */
-            if (i<qr-1 && j<qc-1) {
-               n[0] += qnorm[ index+0 ];
-               n[1] += qnorm[ index+1 ];
-               n[2] += qnorm[ index+2 ];
-            }
-
-            mag = sqrt( n[0]*n[0] + n[1]*n[1] + n[2]*n[2] );
-            if (mag>0.0) {
-               mag = 1.0 / mag;
-               topo->TopoNormal[index+0] = n[0] * mag;
-               topo->TopoNormal[index+1] = n[1] * mag;
-               topo->TopoNormal[index+2] = n[2] * mag;
-            }
-         }
-      }
-
-      free (qnorm);
-      /* deallocate( dtx, qnorm, qc * qr * 3 * sizeof(float) ); */
-   }
+   /* step 1: compute surface normal for each quadrilateral. */
+   job.pass = TOPO_FACETS;
+   job.first = 0;
+   job.last = qr-1;
+   run_topo_job( &job );
+
+   /* step 2: compute vertex normals by averaging adjacent */
+   /* quadrilateral normals. */
+   job.pass = TOPO_NORMALS;
+   job.first = 0;
+   job.last = qr;
+   run_topo_job( &job );
+
+   free (qnorm);
+   /* deallocate( dtx, qnorm, qc * qr * 3 * sizeof(float) ); */
 
    topo->qcols = qc;
    topo->qrows = qr;
@@ -0,0 +1,788 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "../config.h"
+
+/* Storage, coloring and drawing order of the trajectory sets */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "grid.h"
+#include "memory.h"
+#include "misc.h"
+#include "parallel.h"
+#include "proj.h"
+#include "sync.h"
+#include "trajset.h"
+
+
+
+#define MIN2( X, Y )        ( (X) < (Y) ? (X) : (Y) )
+#define MAX2( X, Y )        ( (X) > (Y) ? (X) : (Y) )
+
+
+/*
+ * The vertices of all trajectories of a set are kept in one block and
+ * the per trajectory arrays in another, which grow by at least half and
+ * by whole chunks.  A new trajectory is copied to the end of them, so
+ * a set of 100000 trajectories is a few blocks rather than 100000 of
+ * each kind, and all of a set can be drawn with one call.
+ */
+#define TRAJ_VERT_CHUNK     65536   /* vertices */
+#define TRAJ_CHUNK          1024    /* trajectories */
+#define TRAJ_TABLE_CHUNK    4096    /* entries of dtx->TrajTable */
+
+/*
+ * A set is recolored in blocks of its vertices, ordered by timestep,
+ * which idle worker threads may help with through run_parallel_job().
+ * Within a block the vertices
+ * of a timestep go through batches: one xyzPRIME_to_gridPRIME_n() call
+ * and one interpolate_grid_values() call, which finds the grid in the
+ * cache once, per batch.
+ */
+#define TRAJCOLOR_BATCH     1024    /* vertices per batch */
+#define TRAJCOLOR_BLOCK     16384   /* min vertices per block */
+#define MAX_TRAJCOLOR_BLOCKS 32
+
+
+/* What the blocks of one recolor_traj_set() call share */
+struct trajcolor_job {
+   Display_Context dtx;
+   Context cvctx;
+   int colorvar;
+   const int_vert2 *verts;        /* [][3] vertices of the set */
+   const uint_vert2 *times;       /* their timesteps */
+   const int *order;              /* [n] vertex numbers by timestep */
+   int n;
+   uint_1 *colors;                /* the new color indexes */
+   int blocksize;
+   int numblocks;
+};
+
+
+
+/* Bytes in the blocks of a set with room for maxverts and maxtraj */
+static PTRINT vert_block_bytes( int maxverts )
+{
+   return (PTRINT) maxverts * (3*sizeof(int_vert2) + sizeof(uint_vert2)
+                               + 3*sizeof(int_1));
+}
+
+static PTRINT traj_block_bytes( int maxtraj, int numtimes )
+{
+   return (PTRINT) maxtraj * (3*sizeof(int) + 2*numtimes*sizeof(uint_vert2));
+}
+
+
+
+/* Point the vertex arrays of a set into a vertex block */
+static void set_vert_arrays( struct traj_set *s, void *block, int maxverts )
+{
+   s->verts = (int_vert2 *) block;
+   s->times = (uint_vert2 *) (s->verts + 3*(PTRINT) maxverts);
+   s->norms = (int_1 *) (s->times + maxverts);
+   s->maxverts = maxverts;
+}
+
+/* Point the trajectory arrays of a set into a trajectory block */
+static void set_traj_arrays( struct traj_set *s, void *block, int maxtraj )
+{
+   s->first = (int *) block;
+   s->kind = s->first + maxtraj;
+   s->ctx_owner = s->kind + maxtraj;
+   s->start = (uint_vert2 *) (s->ctx_owner + maxtraj);
+   s->len = s->start + (PTRINT) maxtraj * s->numtimes;
+   s->maxtraj = maxtraj;
+}
+
+
+
+/* Room for at least need entries when there is room for max now */
+static int grow_size( int max, int need, int chunk )
+{
+   int n = MAX2( need, max + max/2 );
+   return (n + chunk - 1) / chunk * chunk;
+}
+
+
+
+/*
+ * Return the context whose memory holds a set's arrays, or the one
+ * which will if the set has none yet.
+ */
+static Context set_memory_ctx( Display_Context dtx, struct traj_set *s,
+                               Context ctx )
+{
+   if (s->maxverts==0 && s->maxtraj==0) {
+      return ctx;
+   }
+   return dtx->ctxpointerarray[return_ctx_index_pos(dtx, s->owner)];
+}
+
+
+
+/*
+ * Color a run of vertices of one timestep.
+ * Input:  dtx - the display
+ *         cvctx, colorvar - the coloring variable
+ *         time - timestep of the vertices, as in the sets' start arrays
+ *         n - number of vertices
+ *         idx - [n] vertex numbers, or NULL for vertices 0..n-1
+ *         verts - the vertex array they are in
+ * Output:  colors - color indexes, at the vertex numbers
+ */
+static void color_run( Display_Context dtx, Context cvctx, int colorvar,
+                       int time, int n, const int idx[],
+                       const int_vert2 *verts, uint_1 *colors )
+{
+   float x[TRAJCOLOR_BATCH], y[TRAJCOLOR_BATCH], z[TRAJCOLOR_BATCH];
+   float row[TRAJCOLOR_BATCH], col[TRAJCOLOR_BATCH], lev[TRAJCOLOR_BATCH];
+   float val[TRAJCOLOR_BATCH];
+   float vscale = 1.0 / VERTEX_SCALE;
+   float min, max, valscale;
+   int cvtime, i0, i, m, v;
+
+   min = cvctx->Variable[colorvar]->MinVal;
+   max = cvctx->Variable[colorvar]->MaxVal;
+   valscale = 1.0F / (max - min);
+   cvtime = return_ctx_time( dtx, cvctx->context_index, time );
+
+   for (i0=0; i0<n; i0+=TRAJCOLOR_BATCH) {
+      m = MIN2( n-i0, TRAJCOLOR_BATCH );
+      for (i=0;i<m;i++) {
+         v = idx ? idx[i0+i] : i0+i;
+         x[i] = verts[v*3+0] * vscale;
+         y[i] = verts[v*3+1] * vscale;
+         z[i] = verts[v*3+2] * vscale;
+      }
+      if (cvctx->GridSameAsGridPRIME) {
+         xyzPRIME_to_gridPRIME_n( dtx, 0, dtx->TrajU, m, x, y, z,
+                                  row, col, lev );
+      }
+      else {
+         for (i=0;i<m;i++) {
+            xyzPRIME_to_grid( cvctx, cvtime, dtx->TrajU, x[i], y[i], z[i],
+                              &row[i], &col[i], &lev[i] );
+         }
+      }
+      interpolate_grid_values( cvctx, cvtime, colorvar, m, row, col, lev,
+                               val );
+      for (i=0;i<m;i++) {
+         v = idx ? idx[i0+i] : i0+i;
+         if (IS_MISSING(val[i]) || val[i] < min || val[i] > max) {
+            colors[v] = 255;
+         }
+         else {
+            colors[v] = (uint_1) (int) ((val[i] - min) * valscale * 254.0F);
+         }
+      }
+   }
+}
+
+
+
+/*
+ * Color vertices first..first+n-1 of a set, which are in order of
+ * timestep like the vertices of a trajectory are.
+ */
+static void color_range( Display_Context dtx, Context cvctx, int colorvar,
+                         int first, int n, const int_vert2 *verts,
+                         const uint_vert2 *times, uint_1 *colors )
+{
+   int i, j;
+
+   for (i=0; i<n; i=j) {
+      for (j=i+1; j<n && times[first+j]==times[first+i]; j++)
+         ;
+      color_run( dtx, cvctx, colorvar, times[first+i], j-i, NULL,
+                 verts + (PTRINT) (first+i)*3, colors + first+i );
+   }
+}
+
+
+
+/* Color one block of a recolor job, see run_parallel_job() */
+static void trajcolor_block( void *data, int block )
+{
+   struct trajcolor_job *job = (struct trajcolor_job *) data;
+   int i0 = block * job->blocksize;
+   int i1 = MIN2( i0 + job->blocksize, job->n );
+   int i, j;
+
+   for (i=i0; i<i1; i=j) {
+      uint_vert2 time = job->times[job->order[i]];
+      for (j=i+1; j<i1 && job->times[job->order[j]]==time; j++)
+         ;
+      color_run( job->dtx, job->cvctx, job->colorvar, time, j-i,
+                 job->order+i, job->verts, job->colors );
+   }
+}
+
+
+
+/*
+ * Give a set room for more vertices and trajectories, and colors if
+ * it is colored.  The new blocks are allocated without TrajLock held,
+ * since running out of memory may delete the oldest trajectory group,
+ * then copied in with it held.  Called and returns with TrajLock held;
+ * the set may have changed in between, so the caller looks again.
+ * Return:  1 = ok, 0 = out of memory
+ */
+static int grow_traj_set( Display_Context dtx, struct traj_set *s,
+                          Context ctx, int numverts, int numtraj,
+                          int numtimes, int colored )
+{
+   Context mctx;
+   int maxverts, maxtraj, oldmaxverts, oldmaxtraj, generation, needcolors;
+   void *vblock = NULL, *tblock = NULL;
+   uint_1 *colors = NULL;
+   void *oldv = NULL, *oldt = NULL, *oldc = NULL;
+   int ok = 1;
+
+   mctx = set_memory_ctx( dtx, s, ctx );
+   if (s->maxtraj>0) {
+      numtimes = s->numtimes;
+   }
+   oldmaxverts = s->maxverts;
+   oldmaxtraj = s->maxtraj;
+   generation = s->generation;
+   maxverts = oldmaxverts;
+   maxtraj = oldmaxtraj;
+   if (numverts > maxverts) {
+      maxverts = grow_size( maxverts, numverts, TRAJ_VERT_CHUNK );
+   }
+   if (numtraj > maxtraj) {
+      maxtraj = grow_size( maxtraj, numtraj, TRAJ_CHUNK );
+   }
+   needcolors = (colored || s->colors)
+                && (maxverts != oldmaxverts || !s->colors);
+   LOCK_OFF( TrajLock );
+
+   if (maxverts != oldmaxverts) {
+      vblock = allocate_type( mctx, vert_block_bytes( maxverts ), TRAJX_TYPE );
+      ok = ok && vblock;
+   }
+   if (maxtraj != oldmaxtraj) {
+      tblock = allocate_type( mctx, traj_block_bytes( maxtraj, numtimes ),
+                              TRAJ_TYPE );
+      ok = ok && tblock;
+   }
+   if (needcolors) {
+      colors = (uint_1 *) allocate_type( mctx, (PTRINT) maxverts,
+                                         COLORINDEX_TYPE );
+      ok = ok && colors;
+   }
+
+   LOCK_ON( TrajLock );
+   /* the colors must grow with the vertices, and may have been added */
+   if (ok && s->maxverts==oldmaxverts && s->maxtraj==oldmaxtraj
+       && s->generation==generation && (!vblock || !s->colors || colors)) {
+      wait_write_lock( &s->lock );
+      if (vblock) {
+         oldv = s->verts;
+         if (s->numverts>0) {
+            memcpy( vblock, s->verts, 3L*s->numverts*sizeof(int_vert2) );
+            memcpy( (int_vert2 *) vblock + 3L*maxverts, s->times,
+                    s->numverts*sizeof(uint_vert2) );
+            memcpy( (char *) vblock + (PTRINT) maxverts
+                    * (3*sizeof(int_vert2) + sizeof(uint_vert2)),
+                    s->norms, 3L*s->numverts*sizeof(int_1) );
+         }
+         set_vert_arrays( s, vblock, maxverts );
+         vblock = NULL;
+      }
+      if (tblock) {
+         struct traj_set old = *s;
+         oldt = s->first;
+         s->numtimes = numtimes;
+         set_traj_arrays( s, tblock, maxtraj );
+         if (old.numtraj>0) {
+            memcpy( s->first, old.first, old.numtraj*sizeof(int) );
+            memcpy( s->kind, old.kind, old.numtraj*sizeof(int) );
+            memcpy( s->ctx_owner, old.ctx_owner, old.numtraj*sizeof(int) );
+            memcpy( s->start, old.start,
+                    (PTRINT) old.numtraj*numtimes*sizeof(uint_vert2) );
+            memcpy( s->len, old.len,
+                    (PTRINT) old.numtraj*numtimes*sizeof(uint_vert2) );
+         }
+         tblock = NULL;
+      }
+      if (colors && (maxverts!=oldmaxverts || !s->colors)) {
+         oldc = s->colors;
+         if (oldc && s->numverts>0) {
+            memcpy( colors, oldc, s->numverts );
+         }
+         s->colors = colors;
+         colors = NULL;
+      }
+      if (oldmaxverts==0 && oldmaxtraj==0) {
+         s->owner = ctx->context_index;
+      }
+      done_write_lock( &s->lock );
+   }
+   LOCK_OFF( TrajLock );
+
+   /* free what was replaced, or wasn't needed after all */
+   if (oldv)  deallocate( mctx, oldv, vert_block_bytes( oldmaxverts ) );
+   if (oldt)  deallocate( mctx, oldt, traj_block_bytes( oldmaxtraj, numtimes ) );
+   if (oldc)  deallocate( mctx, oldc, (PTRINT) oldmaxverts );
+   if (vblock)  deallocate( mctx, vblock, vert_block_bytes( maxverts ) );
+   if (tblock)  deallocate( mctx, tblock, traj_block_bytes( maxtraj, numtimes ) );
+   if (colors)  deallocate( mctx, colors, (PTRINT) maxverts );
+
+   LOCK_ON( TrajLock );
+   return ok;
+}
+
+
+
+/*
+ * Append a trajectory to its set, dtx->TrajSet[info->group], and to
+ * dtx->TrajTable.  It is colored like the rest of the set, or by the
+ * given variable if it's the first one.
+ * Input:  dtx - the display
+ *         ctx - the context which owns the trajectory
+ *         info - the trajectory's parameters: row, col, lev, timestep,
+ *                stepmult, lengthmult, group and kind
+ *         n - number of vertices
+ *         vx, vy, vz - the [n] vertices in graphics coordinates
+ *         nx, ny, nz - the [n] ribbon normals, or NULL for a line
+ *         start, len - [ctx->NumTimes] 1st vertex and number of vertices
+ *                      to draw at each timestep
+ *         cvowner, colorvar - the coloring variable or -1
+ * Return:  1 = ok, 0 = out of memory or trajectory space
+ */
+int append_traj( Display_Context dtx, Context ctx, const struct traj *info,
+                 int n, const float vx[], const float vy[], const float vz[],
+                 const float nx[], const float ny[], const float nz[],
+                 const uint_vert2 start[], const uint_vert2 len[],
+                 int cvowner, int colorvar )
+{
+   struct traj_set *s = &dtx->TrajSet[info->group];
+   int_vert2 *verts;
+   int_1 *norms = NULL;
+   uint_vert2 *times;
+   uint_1 *colors = NULL;
+   int cv, cvo, i, k, it, time, numtimes, done, colored;
+
+   /* compress the vertices and normals */
+   verts = (int_vert2 *) malloc( 3L * n * sizeof(int_vert2) );
+   times = (uint_vert2 *) malloc( n * sizeof(uint_vert2) );
+   if (nx) {
+      norms = (int_1 *) malloc( 3L * n * sizeof(int_1) );
+   }
+   if (!verts || !times || (nx && !norms)) {
+      free( verts );
+      free( times );
+      free( norms );
+      return 0;
+   }
+   for (i=0;i<n;i++) {
+      verts[i*3+0] = (int_vert2) (vx[i] * VERTEX_SCALE);
+      verts[i*3+1] = (int_vert2) (vy[i] * VERTEX_SCALE);
+      verts[i*3+2] = (int_vert2) (vz[i] * VERTEX_SCALE);
+   }
+   if (nx) {
+      /* compress normals to 1-byte ints */
+      for (i=0;i<n;i++) {
+         norms[i*3+0] = (int_1) (int) (-nx[i] * NORMAL_SCALE);
+         norms[i*3+1] = (int_1) (int) ( ny[i] * NORMAL_SCALE);
+         norms[i*3+2] = (int_1) (int) ( nz[i] * NORMAL_SCALE);
+      }
+   }
+
+   /* the timestep which colors each vertex */
+   numtimes = ctx->NumTimes;
+   time = 0;
+   for (i=0;i<n;i++) {
+      while (start[time]<i && time<numtimes-1) {
+         time++;
+      }
+      times[i] = time;
+   }
+
+   done = 0;
+   cv = cvo = -2;
+   LOCK_ON( TrajLock );
+   while (!done) {
+      if (dtx->NumTraj>=MAXTRAJ) {
+         printf("OUT OF TRAJECTORY SPACE, MAXTRAJ=%d \n",MAXTRAJ);
+         break;
+      }
+
+      /* color by the set's variable, computed without TrajLock */
+      if (s->numtraj==0) {
+         s->colorvar = colorvar;
+         s->colorvarowner = cvowner;
+      }
+      if (s->colorvar!=cv || s->colorvarowner!=cvo) {
+         Context cvctx = NULL;
+         cv = s->colorvar;
+         cvo = s->colorvarowner;
+         if (cv>=0) {
+            cvctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, cvo)];
+         }
+         LOCK_OFF( TrajLock );
+         if (cv>=0 && !colors) {
+            colors = (uint_1 *) malloc( n );
+         }
+         if (cv>=0 && colors) {
+            if (cvctx) {
+               color_range( dtx, cvctx, cv, 0, n, verts, times, colors );
+            }
+            else {
+               memset( colors, 255, n );
+            }
+         }
+         LOCK_ON( TrajLock );
+         if (cv>=0 && !colors) {
+            break;
+         }
+         continue;
+      }
+
+      if (dtx->NumTraj>=dtx->MaxTraj) {
+         struct traj *t = (struct traj *)
+            realloc( dtx->TrajTable, (dtx->MaxTraj + TRAJ_TABLE_CHUNK)
+                                     * sizeof(struct traj) );
+         if (!t) {
+            break;
+         }
+         dtx->TrajTable = t;
+         dtx->MaxTraj += TRAJ_TABLE_CHUNK;
+      }
+
+      colored = cv>=0;
+      if (s->numverts+n > s->maxverts || s->numtraj+1 > s->maxtraj
+          || (colored && !s->colors)) {
+         if (!grow_traj_set( dtx, s, ctx, s->numverts+n, s->numtraj+1,
+                             numtimes, colored )) {
+            break;
+         }
+         continue;
+      }
+
+      /* copy the trajectory to the end of the set */
+      wait_write_lock( &s->lock );
+      k = s->numtraj;
+      memcpy( s->verts + 3L*s->numverts, verts, 3L*n*sizeof(int_vert2) );
+      memcpy( s->times + s->numverts, times, n*sizeof(uint_vert2) );
+      if (numtimes > s->numtimes) {
+         /* a set started by a context with fewer timesteps */
+         for (i=0;i<n;i++) {
+            s->times[s->numverts+i] = MIN2( times[i], s->numtimes-1 );
+         }
+      }
+      if (norms) {
+         memcpy( s->norms + 3L*s->numverts, norms, 3L*n*sizeof(int_1) );
+      }
+      else {
+         memset( s->norms + 3L*s->numverts, 0, 3L*n*sizeof(int_1) );
+      }
+      if (colored) {
+         memcpy( s->colors + s->numverts, colors, n );
+      }
+      s->first[k] = s->numverts;
+      s->kind[k] = info->kind;
+      s->ctx_owner[k] = ctx->context_index;
+      for (it=0; it<s->numtimes; it++) {
+         s->start[k*s->numtimes+it] = it<numtimes ? start[it] : 0;
+         s->len[k*s->numtimes+it] = it<numtimes ? len[it] : 0;
+      }
+      s->numverts += n;
+      s->numtraj++;
+      done_write_lock( &s->lock );
+
+      dtx->TrajTable[dtx->NumTraj] = *info;
+      dtx->TrajTable[dtx->NumTraj].index = k;
+      dtx->NumTraj++;
+      done = 1;
+   }
+   LOCK_OFF( TrajLock );
+
+   free( verts );
+   free( times );
+   free( norms );
+   free( colors );
+   return done;
+}
+
+
+
+/*
+ * Recolor a set of trajectories by a variable.
+ * Input:  dtx - the display
+ *         set - which set
+ *         cvowner, colorvar - the coloring variable, or -1 for none
+ */
+void recolor_traj_set( Display_Context dtx, int set, int cvowner,
+                       int colorvar )
+{
+   struct traj_set *s = &dtx->TrajSet[set];
+   struct trajcolor_job job;
+   Context mctx, cvctx;
+   uint_1 *colors, *old;
+   int *order, *count;
+   int maxverts, generation, n, i, t;
+
+   for (;;) {
+      LOCK_ON( TrajLock );
+      if (s->colorvar==colorvar
+          && (colorvar<0 || s->colorvarowner==cvowner)) {
+         LOCK_OFF( TrajLock );
+         return;
+      }
+      if (colorvar<0 || s->numverts==0) {
+         /* nothing to compute */
+         mctx = set_memory_ctx( dtx, s, NULL );
+         wait_write_lock( &s->lock );
+         old = s->colors;
+         maxverts = s->maxverts;
+         s->colors = NULL;
+         s->colorvar = colorvar;
+         s->colorvarowner = cvowner;
+         done_write_lock( &s->lock );
+         LOCK_OFF( TrajLock );
+         if (old) {
+            deallocate( mctx, old, (PTRINT) maxverts );
+         }
+         return;
+      }
+      mctx = set_memory_ctx( dtx, s, NULL );
+      maxverts = s->maxverts;
+      generation = s->generation;
+      LOCK_OFF( TrajLock );
+
+      cvctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, cvowner)];
+      colors = (uint_1 *) allocate_type( mctx, (PTRINT) maxverts,
+                                         COLORINDEX_TYPE );
+      if (!colors || !cvctx) {
+         if (colors)  deallocate( mctx, colors, (PTRINT) maxverts );
+         return;
+      }
+
+      /* appending waits while the vertices are read */
+      wait_read_lock( &s->lock );
+      if (s->maxverts!=maxverts || s->generation!=generation) {
+         done_read_lock( &s->lock );
+         deallocate( mctx, colors, (PTRINT) maxverts );
+         continue;
+      }
+      n = s->numverts;
+
+      /* the vertices in order of timestep */
+      order = (int *) malloc( n * sizeof(int) );
+      count = (int *) calloc( s->numtimes+1, sizeof(int) );
+      if (!order || !count) {
+         done_read_lock( &s->lock );
+         free( order );
+         free( count );
+         deallocate( mctx, colors, (PTRINT) maxverts );
+         return;
+      }
+      for (i=0;i<n;i++) {
+         count[s->times[i]+1]++;
+      }
+      for (t=0;t<s->numtimes;t++) {
+         count[t+1] += count[t];
+      }
+      for (i=0;i<n;i++) {
+         order[count[s->times[i]]++] = i;
+      }
+      free( count );
+
+      job.dtx = dtx;
+      job.cvctx = cvctx;
+      job.colorvar = colorvar;
+      job.verts = s->verts;
+      job.times = s->times;
+      job.order = order;
+      job.n = n;
+      job.colors = colors;
+      job.numblocks = MAX2( 1, MIN2( n / TRAJCOLOR_BLOCK,
+                                     MAX_TRAJCOLOR_BLOCKS ) );
+      job.blocksize = (n + job.numblocks - 1) / job.numblocks;
+      run_parallel_job( cvctx, trajcolor_block, &job, job.numblocks );
+      done_read_lock( &s->lock );
+      free( order );
+
+      LOCK_ON( TrajLock );
+      if (s->maxverts!=maxverts || s->generation!=generation) {
+         LOCK_OFF( TrajLock );
+         deallocate( mctx, colors, (PTRINT) maxverts );
+         continue;
+      }
+      wait_write_lock( &s->lock );
+      if (s->numverts > n) {
+         /* trajectories appended meanwhile */
+         for (i=0;i<s->numtraj;i++) {
+            int first = s->first[i];
+            int last = i+1<s->numtraj ? s->first[i+1] : s->numverts;
+            if (last > n) {
+               first = MAX2( first, n );
+               color_range( dtx, cvctx, colorvar, first, last-first,
+                            s->verts, s->times, colors );
+            }
+         }
+      }
+      old = s->colors;
+      s->colors = colors;
+      s->colorvar = colorvar;
+      s->colorvarowner = cvowner;
+      done_write_lock( &s->lock );
+      LOCK_OFF( TrajLock );
+      if (old) {
+         deallocate( mctx, old, (PTRINT) maxverts );
+      }
+      dtx->Redraw = 1;
+      return;
+   }
+}
+
+
+
+/*
+ * Delete the most recent trajectories of a set, keeping its first
+ * numtraj.  Called with TrajLock held.
+ */
+void truncate_traj_set( Display_Context dtx, int set, int numtraj )
+{
+   struct traj_set *s = &dtx->TrajSet[set];
+
+   if (numtraj<=0) {
+      free_traj_set( dtx, set );
+   }
+   else if (numtraj < s->numtraj) {
+      wait_write_lock( &s->lock );
+      s->numverts = s->first[numtraj];
+      s->numtraj = numtraj;
+      s->generation++;
+      done_write_lock( &s->lock );
+   }
+}
+
+
+
+/*
+ * Delete all trajectories of a set and free its arrays.  Called with
+ * TrajLock held.
+ */
+void free_traj_set( Display_Context dtx, int set )
+{
+   struct traj_set *s = &dtx->TrajSet[set];
+   Context mctx;
+
+   if (s->maxverts==0 && s->maxtraj==0) {
+      s->numverts = s->numtraj = 0;
+      return;
+   }
+   mctx = set_memory_ctx( dtx, s, NULL );
+
+   wait_write_lock( &s->lock );
+   /* WLH 4 Nov 98 */
+   if (mctx) {
+      if (s->verts) {
+         deallocate( mctx, s->verts, vert_block_bytes( s->maxverts ) );
+      }
+      if (s->colors) {
+         deallocate( mctx, s->colors, (PTRINT) s->maxverts );
+      }
+      if (s->first) {
+         deallocate( mctx, s->first,
+                     traj_block_bytes( s->maxtraj, s->numtimes ) );
+      }
+   }
+   s->verts = NULL;
+   s->times = NULL;
+   s->norms = NULL;
+   s->colors = NULL;
+   s->first = s->kind = s->ctx_owner = NULL;
+   s->start = s->len = NULL;
+   s->numverts = s->maxverts = 0;
+   s->numtraj = s->maxtraj = 0;
+   s->generation++;
+   done_write_lock( &s->lock );
+}
+
+
+
+/*
+ * Find the parts of a set's trajectories to draw at a timestep.  Called
+ * with a read lock on the set.
+ * Input:  s - the set
+ *         owner - only trajectories of this ctx index
+ *         kind - only lines (0) or ribbons (1)
+ *         time - the owner's timestep
+ * Output:  first, count - [s->numtraj] first vertex and number of
+ *                         vertices of each part
+ * Return:  number of parts
+ */
+int traj_set_strips( struct traj_set *s, int owner, int kind, int time,
+                     int first[], int count[] )
+{
+   int k, n, start, len;
+
+   if (time<0 || time>=s->numtimes) {
+      return 0;
+   }
+   n = 0;
+   for (k=0;k<s->numtraj;k++) {
+      start = s->start[k*s->numtimes+time];
+      len = s->len[k*s->numtimes+time];
+      if (s->ctx_owner[k]==owner && s->kind[k]==kind
+          && start!=BADSTART && len>0) {
+         first[n] = s->first[k] + start;
+         count[n] = len;
+         n++;
+      }
+   }
+   return n;
+}
+
+
+
+/*
+ * Return the last vertex of trajectory k of a set drawn at a timestep,
+ * or -1 if none is.  Called with a read lock on the set.
+ */
+int traj_endpoint( struct traj_set *s, int k, int time )
+{
+   int len;
+
+   if (k<0 || k>=s->numtraj || time<0 || time>=s->numtimes) {
+      return -1;
+   }
+   len = s->len[k*s->numtimes+time];
+   if (len < 1) {
+      return -1;
+   }
+   return s->first[k] + s->start[k*s->numtimes+time] + len - 1;
+}
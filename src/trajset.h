@@ -0,0 +1,59 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+
+#ifndef TRAJSET_H
+#define TRAJSET_H
+
+
+#include "globals.h"
+
+
+extern int append_traj( Display_Context dtx, Context ctx,
+                        const struct traj *info, int n,
+                        const float vx[], const float vy[], const float vz[],
+                        const float nx[], const float ny[], const float nz[],
+                        const uint_vert2 start[], const uint_vert2 len[],
+                        int cvowner, int colorvar );
+
+extern void recolor_traj_set( Display_Context dtx, int set,
+                              int cvowner, int colorvar );
+
+extern void truncate_traj_set( Display_Context dtx, int set, int numtraj );
+
+extern void free_traj_set( Display_Context dtx, int set );
+
+
+extern int traj_set_strips( struct traj_set *s, int owner, int kind,
+                            int time, int first[], int count[] );
+
+extern int traj_endpoint( struct traj_set *s, int k, int time );
+
+
+#endif
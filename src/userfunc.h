@@ -0,0 +1,101 @@
+/* userfunc.h */
+
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/* socket communications module */
+
+/*
+ * In-process analysis function plugins.
+ *
+ * Besides the external function programs built with externf, the
+ * directory given by -funcpath may hold shared objects named foo.so.
+ * Such a plugin is loaded into vis5d with dlopen() and called once per
+ * timestep on the vis5d worker threads, so it must be reentrant.
+ *
+ * A plugin defines
+ *
+ *    VIS5D_USERFUNC_ABI_VERSION;
+ *    int vis5d_userfunc( struct vis5d_userfunc_args *args );
+ *
+ * and may also define
+ *
+ *    int vis5d_userfunc_init( struct vis5d_userfunc_args *args );
+ *    void vis5d_userfunc_finish( struct vis5d_userfunc_args *args );
+ *
+ * which are called once before and after the timesteps are computed.
+ * vis5d_userfunc() and vis5d_userfunc_init() return 0 for success or
+ * an error code.  Grids are stored like the FORTRAN functions see
+ * them:  element [row + nr * (col + nc * lev)].  Missing values are
+ * >= 1.0e30; write 1.0e35 for missing output.
+ */
+
+
+#ifndef USERFUNC_H
+#define USERFUNC_H
+
+
+#define VIS5D_USERFUNC_ABI  1
+
+#define VIS5D_USERFUNC_ABI_VERSION  int vis5d_userfunc_abi = VIS5D_USERFUNC_ABI
+
+
+struct vis5d_userfunc_args {
+   /*** the same for every timestep ***/
+   int numtimes;                  /* number of timesteps */
+   int numvars;                   /* number of input variables */
+   int nr, nc;                    /* rows and columns of every grid */
+   int maxnl;                     /* max of nl[] */
+   const int *nl;                 /* levels of each input variable */
+   const int *lowlev;             /* lowest level of each variable */
+   const char * const *names;     /* name of each input variable */
+   int projection;                /* map projection, as in v5d.h */
+   const float *projargs;         /* projection arguments */
+   int vertical;                  /* vertical coordinate system */
+   const float *vertargs;         /* vertical coordinate arguments */
+   float proberow, probecol, probelev;   /* probe position, grid coords */
+   float probelat, probelon, probehgt;   /* probe position, geographic */
+   void *userdata;                /* free for use by the plugin */
+
+   /*** set for each call to vis5d_userfunc() ***/
+   int time;                      /* timestep, starting at 0 */
+   int date, timestamp;           /* YYDDD and HHMMSS of the timestep */
+   const float *probevalue;       /* input variables at the probe */
+   const float * const *ingrid;   /* input grids, nr*nc*nl[var] each */
+   float *outgrid;                /* result grid, nr*nc*maxnl floats */
+   int outnl, outlowlev;          /* result levels, default maxnl, 0 */
+};
+
+
+typedef int (*vis5d_userfunc_proc)( struct vis5d_userfunc_args *args );
+
+typedef void (*vis5d_userfunc_finish_proc)( struct vis5d_userfunc_args *args );
+
+
+#endif
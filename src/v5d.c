@@ -35,6 +35,10 @@
 /* this should be updated when the file version changes */
 #define FILE_VERSION "4.3"
 
+/* oldest version able to read bricked grids (TAG_BRICK) or grids in */
+/* the V5D_LOSSLESS and V5D_BOUNDED compress modes */
+#define EXT_FILE_VERSION "4.4"
+
 
 
 /*
@@ -59,6 +63,23 @@
  *
  * All numeric values are stored in big endian order.  All floating point
  * values are in IEEE format.
+ *
+ * Each grid is stored as Nl (de)compression values ga[], Nl values gb[]
+ * and then the compressed grid points.  Normally the points are in
+ * column-major order (row varies fastest, then column, then level).  If
+ * the header has a TAG_BRICK item the points are instead stored as 3-D
+ * bricks of BrickSize[0] rows by BrickSize[1] columns by BrickSize[2]
+ * levels, with the bricks along the last row/column/level clipped to the
+ * grid.  Bricks are ordered row-brick fastest, then column, then level,
+ * and each brick is column-major internally.  A grid occupies the same
+ * number of bytes in either layout and the brick offsets follow from the
+ * grid dimensions (see brick_offset()), so no index is stored and grids
+ * may be re-laid out in place.
+ *
+ * With CompressMode V5D_LOSSLESS or V5D_BOUNDED the grid points are a
+ * variable-length byte stream (see stream_compress()) in a slot sized for
+ * the worst case, so grid positions stay fixed; only the stream's bytes
+ * are read and written, and the unused tail of a slot is never written.
  */
 
 
@@ -78,7 +99,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include "binio.h"
+#include "lzcodec.h"
 #include "v5d.h"
 #include "vis5d.h"
 
@@ -91,6 +114,12 @@
 #ifdef HAVE_FCNTL_H
 #  include <fcntl.h>
 #endif
+#ifdef HAVE_GLOB_H
+#  include <glob.h>
+#endif
+#ifdef HAVE_PTHREADS
+#  include <pthread.h>
+#endif
 
 #ifndef SEEK_SET
 #  define SEEK_SET 0
@@ -141,6 +170,9 @@
 
 #define TAG_UNITS       1015        /* int *4 var; char*20 Units[var]   */
 
+#define TAG_BRICK       1016        /* int*4 BrickSize[0..2] (rows, cols, levs) */
+#define TAG_TOLERANCE   1017        /* real*4 Tolerance (CompressMode 6) */
+
 /* vertical coordinate system 2000+ */
 #define TAG_VERTICAL_SYSTEM 2000    /* int*4 VerticalSystem             */
 #define TAG_VERT_ARGS    2100       /* int*4 n;  real*4 VertArgs[0..n-1]*/
@@ -371,9 +403,24 @@ void v5dPrintStruct( const v5dstruct *v )
    if (v->CompressMode==1) {
       printf("Compression:  1 byte per gridpoint.\n");
    }
+   else if (v->CompressMode==V5D_LOSSLESS) {
+      printf("Compression:  lossless (byte shuffle + LZ).\n");
+   }
+   else if (v->CompressMode==V5D_BOUNDED) {
+      if (v->Tolerance>0.0) {
+         printf("Compression:  error bounded to +/- %g.\n", v->Tolerance);
+      }
+      else {
+         printf("Compression:  error bounded to 1/65534 of level range.\n");
+      }
+   }
    else {
       printf("Compression:  %d bytes per gridpoint.\n", v->CompressMode);
    }
+   if (v->BrickSize[0]>0) {
+      printf("Layout:  %d x %d x %d bricks (rows x columns x levels).\n",
+             v->BrickSize[0], v->BrickSize[1], v->BrickSize[2] );
+   }
    printf("header size=%d\n", v->FirstGridPos);
    printf("sizeof(v5dstruct)=%d\n", (int) sizeof(v5dstruct) );
    printf("\n");
@@ -525,6 +572,78 @@ static int grid_position( const v5dstruct *v, int time, int var )
 
 
 
+/*
+ * Compute the offset of a brick within the grid data of a bricked file.
+ * Input:  v - pointer to v5dstruct describing the file header.
+ *         var - which variable
+ *         r0, c0, l0 - first row, column and level of the brick, each a
+ *                      multiple of the corresponding BrickSize.
+ * Return:  offset in grid points from the first point of the grid
+ */
+static long brick_offset( const v5dstruct *v, int var, int r0, int c0, int l0 )
+{
+   int cn, ln;
+
+   cn = v->Nc - c0;
+   if (cn > v->BrickSize[1])  cn = v->BrickSize[1];
+   ln = v->Nl[var] - l0;
+   if (ln > v->BrickSize[2])  ln = v->BrickSize[2];
+
+   /* whole levels of bricks below, whole columns of bricks to the left, */
+   /* then whole bricks above in this column of bricks */
+   return (long) v->Nr * v->Nc * l0
+        + (long) v->Nr * c0 * ln
+        + (long) r0 * cn * ln;
+}
+
+
+
+/*
+ * Convert compressed grid points between column-major and bricked order.
+ * Input:  v - pointer to v5dstruct, BrickSize gives the brick dimensions
+ *         var - which variable
+ *         src - the points to reorder
+ *         tobricks - 1 = column-major to bricks, 0 = bricks to column-major
+ * Output:  dst - the reordered points, must not overlap src
+ */
+static void copy_bricks( const v5dstruct *v, int var, const void *src,
+                         void *dst, int tobricks )
+{
+   const char *s = (const char *) src;
+   char *d = (char *) dst;
+   int es = v->CompressMode;
+   int r0, c0, l0, rn, cn, ln, c, l;
+   long brick, canon, bpos;
+
+   for (l0=0; l0<v->Nl[var]; l0+=v->BrickSize[2]) {
+      ln = v->Nl[var] - l0;
+      if (ln > v->BrickSize[2])  ln = v->BrickSize[2];
+      for (c0=0; c0<v->Nc; c0+=v->BrickSize[1]) {
+         cn = v->Nc - c0;
+         if (cn > v->BrickSize[1])  cn = v->BrickSize[1];
+         for (r0=0; r0<v->Nr; r0+=v->BrickSize[0]) {
+            rn = v->Nr - r0;
+            if (rn > v->BrickSize[0])  rn = v->BrickSize[0];
+            brick = brick_offset( v, var, r0, c0, l0 );
+            for (l=0;l<ln;l++) {
+               for (c=0;c<cn;c++) {
+                  canon = ((long) (l0+l) * v->Nc + c0+c) * v->Nr + r0;
+                  bpos = brick + ((long) l * cn + c) * rn;
+                  if (tobricks) {
+                     memcpy( d + bpos*es, s + canon*es, rn*es );
+                  }
+                  else {
+                     memcpy( d + canon*es, s + bpos*es, rn*es );
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+
+
 /*
  * Compute the ga and gb (de)compression values for a grid.
  * Input:  nr, nc, nl - size of grid
@@ -741,6 +860,308 @@ static void compute_ga_gb( int nr, int nc, int nl,
 
 
 
+/*
+ * The V5D_LOSSLESS and V5D_BOUNDED compress modes store a grid as a
+ * byte stream:
+ *    int*4 length of the whole stream in bytes
+ *    int*4 levels per block
+ *    int*4 end[nb]  offset from the stream start of the end of each block
+ *    nb blocks, each lz_compress()ed independently
+ * All ints are big endian.  A block holds whole levels so that blocks can
+ * be decompressed separately (and in parallel) and a single level can be
+ * decoded without the rest of the grid.  Before LZ compression the 4
+ * bytes of each value are split into 4 planes (all the high bytes, then
+ * the next bytes...), which groups the slowly varying sign/exponent bytes.
+ * V5D_LOSSLESS values are the big endian IEEE floats.  V5D_BOUNDED values
+ * are 0 for missing or 1+round((x-gb)/ga) with ga = 2*tolerance, delta
+ * coded along the block and zigzag mapped so small steps become small
+ * unsigned numbers.
+ */
+
+/* aim for about this many points per block */
+#define STREAM_BLOCK_POINTS 65536
+
+
+static void put_be32( unsigned char *p, unsigned int x )
+{
+   p[0] = (unsigned char) (x >> 24);
+   p[1] = (unsigned char) (x >> 16);
+   p[2] = (unsigned char) (x >> 8);
+   p[3] = (unsigned char) x;
+}
+
+
+static unsigned int get_be32( const unsigned char *p )
+{
+   return ((unsigned int) p[0] << 24) | ((unsigned int) p[1] << 16)
+        | ((unsigned int) p[2] << 8) | (unsigned int) p[3];
+}
+
+
+static int stream_levels_per_block( int nrnc )
+{
+   int lpb = STREAM_BLOCK_POINTS / nrnc;
+   return lpb<1 ? 1 : lpb;
+}
+
+
+
+/*
+ * Return the most bytes a compressed grid can take.
+ * Input:  nr, nc, nl - size of grid
+ *         compressmode - 1, 2, 4, V5D_LOSSLESS or V5D_BOUNDED
+ */
+int v5dCompressedBound( int nr, int nc, int nl, int compressmode )
+{
+   int nrnc = nr * nc;
+   int lpb, nb, bytes, l;
+
+   if (!V5D_STREAM_MODE(compressmode)) {
+      return nrnc * nl * compressmode;
+   }
+   lpb = stream_levels_per_block( nrnc );
+   nb = (nl + lpb - 1) / lpb;
+   bytes = 8 + 4 * nb;
+   for (l=0; l<nl; l+=lpb) {
+      int ln = nl-l < lpb ? nl-l : lpb;
+      bytes += LZ_BOUND( 4 * nrnc * ln );
+   }
+   return bytes;
+}
+
+
+
+/*
+ * Return the number of bytes a compressed grid actually takes.
+ * Input:  nr, nc, nl - size of grid
+ *         compressmode - 1, 2, 4, V5D_LOSSLESS or V5D_BOUNDED
+ *         compdata - the compressed grid
+ */
+int v5dCompressedSize( int nr, int nc, int nl, int compressmode,
+                       const void *compdata )
+{
+   if (V5D_STREAM_MODE(compressmode)) {
+      return (int) get_be32( (const unsigned char *) compdata );
+   }
+   return nr * nc * nl * compressmode;
+}
+
+
+
+/*
+ * Compress a grid in one of the stream modes.  See v5dCompressGridTol().
+ */
+static int stream_compress( int nr, int nc, int nl, int compressmode,
+                            float tolerance, const float data[],
+                            unsigned char *out, float ga[], float gb[],
+                            float *minval, float *maxval )
+{
+   int nrnc = nr * nc;
+   int lpb = stream_levels_per_block( nrnc );
+   int nb = (nl + lpb - 1) / lpb;
+   int pos, b, lev, i, p, npts;
+   unsigned char *raw;
+
+   assert( sizeof(float)==4 );
+
+   /* min, max and the quantization of each level */
+   *minval = MISSING;
+   *maxval = -MISSING;
+   for (lev=0;lev<nl;lev++) {
+      float lo = MISSING, hi = -MISSING;
+      const float *d = data + lev * nrnc;
+      for (i=0;i<nrnc;i++) {
+         if (!IS_MISSING(d[i])) {
+            if (d[i]<lo)  lo = d[i];
+            if (d[i]>hi)  hi = d[i];
+         }
+      }
+      if (lo<*minval)  *minval = lo;
+      if (hi>*maxval)  *maxval = hi;
+
+      if (compressmode==V5D_LOSSLESS || lo>hi) {
+         ga[lev] = 1.0;
+         gb[lev] = 0.0;
+      }
+      else {
+         double step = tolerance>0.0 ? 2.0*tolerance : (hi-lo) / 65534.0;
+         /* leave room for float rounding when decoding gb + ga*code */
+         step -= 4.0 * FLT_EPSILON * (fabs(lo) + fabs(hi));
+         if (step<=0.0) {
+            step = hi>lo ? (hi-lo) / 4.0e9 : 1.0;
+         }
+         if ((hi-lo)/step > 4.0e9) {
+            /* keep codes in 32 bits, the bound can't be met */
+            step = (hi-lo) / 4.0e9;
+         }
+         ga[lev] = (float) step;
+         gb[lev] = lo;
+      }
+   }
+
+   raw = (unsigned char *) malloc( 4 * nrnc * lpb );
+   if (!raw) {
+      printf("Error in v5dCompressGrid: out of memory\n");
+      return 0;
+   }
+
+   pos = 8 + 4 * nb;
+   for (b=0;b<nb;b++) {
+      int l0 = b * lpb;
+      int ln = nl-l0 < lpb ? nl-l0 : lpb;
+      const float *d = data + l0 * nrnc;
+      unsigned int x, prev = 0;
+
+      npts = nrnc * ln;
+      for (p=0;p<npts;p++) {
+         if (compressmode==V5D_LOSSLESS) {
+            memcpy( &x, &d[p], 4 );
+         }
+         else {
+            int l = l0 + p / nrnc;
+            unsigned int code;
+            int delta;
+            if (IS_MISSING(d[p])) {
+               code = 0;
+            }
+            else {
+               code = 1 + (unsigned int) floor( (d[p]-gb[l]) / (double) ga[l]
+                                                + 0.5 );
+            }
+            delta = (int) (code - prev);
+            prev = code;
+            x = ((unsigned int) delta << 1) ^ (unsigned int) (delta >> 31);
+         }
+         raw[p] = (unsigned char) (x >> 24);
+         raw[npts+p] = (unsigned char) (x >> 16);
+         raw[2*npts+p] = (unsigned char) (x >> 8);
+         raw[3*npts+p] = (unsigned char) x;
+      }
+      pos += lz_compress( raw, 4*npts, out+pos );
+      put_be32( out + 8 + 4*b, pos );
+   }
+   put_be32( out, pos );
+   put_be32( out + 4, lpb );
+
+   free( raw );
+   return pos;
+}
+
+
+
+/*
+ * Decompress one block of a stream mode grid.
+ * Input:  in - the compressed grid
+ *         b - which block
+ *         raw - scratch space of 4*npts bytes
+ * Output:  data - the npts values of the block
+ * Return:  1 = ok, 0 = corrupt data
+ */
+static int stream_decode_block( const unsigned char *in, int nrnc, int nl,
+                                int compressmode, const float ga[],
+                                const float gb[], int b, unsigned char *raw,
+                                float data[] )
+{
+   int lpb = (int) get_be32( in+4 );
+   int nb = (nl + lpb - 1) / lpb;
+   int l0 = b * lpb;
+   int ln = nl-l0 < lpb ? nl-l0 : lpb;
+   int npts = nrnc * ln;
+   int start, end, p;
+   unsigned int x, code = 0;
+
+   start = b==0 ? 8 + 4*nb : (int) get_be32( in + 8 + 4*(b-1) );
+   end = (int) get_be32( in + 8 + 4*b );
+   if (lz_decompress( in+start, end-start, raw, 4*npts )!=4*npts) {
+      return 0;
+   }
+
+   for (p=0;p<npts;p++) {
+      x = ((unsigned int) raw[p] << 24) | ((unsigned int) raw[npts+p] << 16)
+        | ((unsigned int) raw[2*npts+p] << 8) | (unsigned int) raw[3*npts+p];
+      if (compressmode==V5D_LOSSLESS) {
+         memcpy( &data[p], &x, 4 );
+      }
+      else {
+         int l = l0 + p / nrnc;
+         code += (x >> 1) ^ (0u - (x & 1));
+         if (code==0) {
+            data[p] = MISSING;
+         }
+         else {
+            data[p] = (float) ((double) (code-1) * ga[l] + gb[l]);
+         }
+      }
+   }
+   return 1;
+}
+
+
+
+/*
+ * Decompress some consecutive levels of a grid.  In the stream modes
+ * only the blocks holding those levels are decoded.
+ * Input:  nr, nc, nl, compressmode, compdata, ga, gb - as for
+ *                                                     v5dDecompressGrid()
+ *         lev0, nlev - first level and number of levels wanted
+ * Output:  data - the nr*nc*nlev values
+ * Return:  1 = ok, 0 = error
+ */
+int v5dDecompressLevels( int nr, int nc, int nl, int compressmode,
+                         const void *compdata, const float ga[],
+                         const float gb[], int lev0, int nlev,
+                         float data[] )
+{
+   const unsigned char *in = (const unsigned char *) compdata;
+   int nrnc = nr * nc;
+   int lpb, b, ok;
+   unsigned char *raw;
+   float *block;
+
+   if (!V5D_STREAM_MODE(compressmode)) {
+      v5dDecompressGrid( nr, nc, nlev, compressmode,
+                         (void *) (in + (long) lev0 * nrnc * compressmode),
+                         (float *) ga + lev0, (float *) gb + lev0, data );
+      return 1;
+   }
+
+   lpb = (int) get_be32( in+4 );
+   if (lpb<1) {
+      return 0;
+   }
+   raw = (unsigned char *) malloc( 4 * nrnc * lpb );
+   block = (float *) malloc( sizeof(float) * nrnc * lpb );
+   if (!raw || !block) {
+      printf("Error in v5dDecompressLevels: out of memory\n");
+      free( raw );
+      free( block );
+      return 0;
+   }
+
+   ok = 1;
+   for (b = lev0 / lpb; ok && b*lpb < lev0+nlev; b++) {
+      int l0 = b * lpb;
+      int ln = nl-l0 < lpb ? nl-l0 : lpb;
+      int lo = l0 > lev0 ? l0 : lev0;
+      int hi = l0+ln < lev0+nlev ? l0+ln : lev0+nlev;
+      ok = stream_decode_block( in, nrnc, nl, compressmode, ga, gb, b,
+                                raw, block );
+      if (ok) {
+         memcpy( data + (long) (lo-lev0) * nrnc, block + (long) (lo-l0) * nrnc,
+                 sizeof(float) * nrnc * (hi-lo) );
+      }
+   }
+   if (!ok) {
+      printf("Error in v5dDecompressLevels: corrupt grid data\n");
+   }
+
+   free( raw );
+   free( block );
+   return ok;
+}
+
+
+
 /*
  * Compress a 3-D grid from floats to 1-byte unsigned integers.
  * Input: nr, nc, nl - size of grid
@@ -758,12 +1179,37 @@ void v5dCompressGrid( int nr, int nc, int nl, int compressmode,
                       const float data[],
                       void *compdata, float ga[], float gb[],
                       float *minval, float *maxval )
+{
+   v5dCompressGridTol( nr, nc, nl, compressmode, 0.0, data, compdata,
+                       ga, gb, minval, maxval );
+}
+
+
+
+/*
+ * Compress a 3-D grid, as v5dCompressGrid() with an error bound.
+ * Input:  as for v5dCompressGrid(), compdata must hold
+ *         v5dCompressedBound() bytes, plus
+ *         tolerance - absolute error bound for CompressMode V5D_BOUNDED,
+ *                     0 = 1/65534 of each level's range (as 2-byte mode)
+ * Return:  number of bytes put in compdata
+ */
+int v5dCompressGridTol( int nr, int nc, int nl, int compressmode,
+                        float tolerance, const float data[],
+                        void *compdata, float ga[], float gb[],
+                        float *minval, float *maxval )
 {
    int nrnc = nr * nc;
    int nrncnl = nr * nc * nl;
    V5Dubyte *compdata1 = (V5Dubyte *) compdata;
    V5Dushort *compdata2 = (V5Dushort *) compdata;
 
+   if (V5D_STREAM_MODE(compressmode)) {
+      return stream_compress( nr, nc, nl, compressmode, tolerance, data,
+                              (unsigned char *) compdata, ga, gb,
+                              minval, maxval );
+   }
+
    /* compute ga, gb values */
    compute_ga_gb( nr, nc, nl, data, compressmode, ga, gb, minval, maxval );
 
@@ -871,6 +1317,7 @@ void v5dCompressGrid( int nr, int nc, int nl, int compressmode,
       /* TODO: byte-swapping on little endian??? */
 #endif
    }
+   return nrncnl * compressmode;
 }
 
 
@@ -893,7 +1340,11 @@ void v5dDecompressGrid( int nr, int nc, int nl, int compressmode,
    V5Dubyte *compdata1 = (V5Dubyte *) compdata;
    V5Dushort *compdata2 = (V5Dushort *) compdata;
 
-   if (compressmode == 1) {
+   if (V5D_STREAM_MODE(compressmode)) {
+      v5dDecompressLevels( nr, nc, nl, compressmode, compdata, ga, gb,
+                           0, nl, data );
+   }
+   else if (compressmode == 1) {
       int p, i, lev;
       p = 0;
       for (lev=0;lev<nl;lev++) {
@@ -992,7 +1443,7 @@ void v5dDecompressGrid( int nr, int nc, int nl, int compressmode,
  */
 int v5dSizeofGrid( const v5dstruct *v, int time, int var )
 {
-   return v->Nr * v->Nc * v->Nl[var] * v->CompressMode;
+   return v5dCompressedBound( v->Nr, v->Nc, v->Nl[var], v->CompressMode );
 }
 
 
@@ -1055,12 +1506,50 @@ v5dstruct *v5dNewStruct( void )
 
 
 
+/*
+ * Free the McIDAS file and grid numbers of a v5dstruct, if any.
+ */
+void v5dFreeMcIDAS( v5dstruct *v )
+{
+   if (v->McFile) {
+      free( v->McFile );
+      v->McFile = NULL;
+   }
+   if (v->McGrid) {
+      free( v->McGrid );
+      v->McGrid = NULL;
+   }
+}
+
+
+
+/*
+ * Allocate the McIDAS file and grid number tables, all zero, for
+ * NumTimes x NumVars grids if they don't exist yet.
+ * Return:  1 = ok, 0 = out of memory
+ */
+static int alloc_mcidas( v5dstruct *v )
+{
+   if (!v->McFile) {
+      v->McFile = (short *) calloc( v->NumTimes * v->NumVars, sizeof(short) );
+      v->McGrid = (short *) calloc( v->NumTimes * v->NumVars, sizeof(short) );
+      if (!v->McFile || !v->McGrid) {
+         v5dFreeMcIDAS( v );
+         return 0;
+      }
+   }
+   return 1;
+}
+
+
+
 /*
  * Free an initialized v5dstruct. (Todd Plessel)
  */
 void v5dFreeStruct( v5dstruct* v )
 {
    /*assert( v5dVerifyStruct( v ) );*/
+   v5dFreeMcIDAS( v );
    free( v );
    v = 0;
 }
@@ -1166,8 +1655,14 @@ int v5dVerifyStruct( const v5dstruct *v )
       }
    }
 
-   if (v->CompressMode != 1 && v->CompressMode != 2 && v->CompressMode != 4) {
-      printf("Bad CompressMode: %d (must be 1, 2 or 4)\n", v->CompressMode );
+   if (v->CompressMode != 1 && v->CompressMode != 2 && v->CompressMode != 4
+       && !V5D_STREAM_MODE(v->CompressMode)) {
+      printf("Bad CompressMode: %d (must be 1, 2, 4, 5 or 6)\n",
+             v->CompressMode );
+      invalid = 1;
+   }
+   if (V5D_STREAM_MODE(v->CompressMode) && v->BrickSize[0]!=0) {
+      printf("CompressMode %d grids can't be bricked\n", v->CompressMode );
       invalid = 1;
    }
 
@@ -1306,6 +1801,15 @@ int v5dVerifyStruct( const v5dstruct *v )
          invalid = 1;
    }
 
+   /* Grid layout */
+   if (v->BrickSize[0]!=0 || v->BrickSize[1]!=0 || v->BrickSize[2]!=0) {
+      if (v->BrickSize[0]<=0 || v->BrickSize[1]<=0 || v->BrickSize[2]<=0) {
+         printf("Invalid brick size: %d x %d x %d\n", v->BrickSize[0],
+                v->BrickSize[1], v->BrickSize[2] );
+         invalid = 1;
+      }
+   }
+
    return !invalid;
 }
 
@@ -1330,8 +1834,13 @@ int v5dGetMcIDASgrid( v5dstruct *v, int time, int var,
       return 0;
    }
 
-   *mcfile = (int) v->McFile[time][var];
-   *mcgrid = (int) v->McGrid[time][var];
+   if (v->McFile) {
+      *mcfile = (int) v->McFile[time*v->NumVars+var];
+      *mcgrid = (int) v->McGrid[time*v->NumVars+var];
+   }
+   else {
+      *mcfile = *mcgrid = 0;
+   }
    return 1;
 }
 
@@ -1357,8 +1866,12 @@ int v5dSetMcIDASgrid( v5dstruct *v, int time, int var,
       return 0;
    }
 
-   v->McFile[time][var] = (short) mcfile;
-   v->McGrid[time][var] = (short) mcgrid;
+   if (!alloc_mcidas( v )) {
+      printf("Error: out of memory in v5dSetMcIDASgrid\n");
+      return 0;
+   }
+   v->McFile[time*v->NumVars+var] = (short) mcfile;
+   v->McGrid[time*v->NumVars+var] = (short) mcgrid;
    return 1;
 }
 
@@ -1627,8 +2140,10 @@ static int read_comp_grid( v5dstruct *v, int time, int var,
       int mcfile, mcgrid;
       read_int4( f, &mcfile );
       read_int4( f, &mcgrid );
-      v->McFile[time][var] = (short) mcfile;
-      v->McGrid[time][var] = (short) mcgrid;
+      if ((mcfile || mcgrid) && alloc_mcidas( v )) {
+         v->McFile[time*v->NumVars+var] = (short) mcfile;
+         v->McGrid[time*v->NumVars+var] = (short) mcgrid;
+      }
    }
 
    nl = v->Nl[var];
@@ -1685,25 +2200,142 @@ static int read_comp_grid( v5dstruct *v, int time, int var,
 
 
 
+/*
+ * A v5d header is a long list of small tagged items, so it's parsed from
+ * a buffer which is filled with a few large reads rather than with a
+ * read() per value, which is slow on network file systems.
+ */
+#define HEADER_CHUNK 65536
+
+struct header_buf {
+   int f;                   /* the file */
+   off_t start;             /* file position of data[0] */
+   off_t pos;               /* file position of the next item */
+   int len;                 /* bytes in data[] */
+   int size;                /* bytes allocated for data[] */
+   int chunk;               /* how much to read next time */
+   unsigned char *data;
+};
+
+
+
+/*
+ * Make sure the n bytes at hb->pos are in the buffer.
+ * Return:  1 = ok, 0 = premature EOF or out of memory
+ */
+static int hb_need( struct header_buf *hb, int n )
+{
+   int want, k;
+
+   if (hb->pos >= hb->start && hb->pos + n <= hb->start + hb->len) {
+      return 1;
+   }
+   want = n > hb->chunk ? n : hb->chunk;
+   if (want > hb->size) {
+      unsigned char *data = (unsigned char *) realloc( hb->data, want );
+      if (!data) {
+         return 0;
+      }
+      hb->data = data;
+      hb->size = want;
+   }
+   /* each refill reads twice as much, headers with many timesteps */
+   /* are long */
+   hb->chunk *= 2;
+   hb->start = hb->pos;
+   hb->len = 0;
+   if (lseek( hb->f, hb->pos, SEEK_SET )<0) {
+      return 0;
+   }
+   while (hb->len < want) {
+      k = read( hb->f, hb->data + hb->len, want - hb->len );
+      if (k<=0) {
+         break;
+      }
+      hb->len += k;
+   }
+   return hb->len >= n;
+}
+
+
+static int hb_int4( struct header_buf *hb, int *i )
+{
+   const unsigned char *p;
+
+   if (!hb_need( hb, 4 )) {
+      return 0;
+   }
+   p = hb->data + (hb->pos - hb->start);
+   *i = (int) (((unsigned int) p[0] << 24) | ((unsigned int) p[1] << 16)
+               | ((unsigned int) p[2] << 8) | (unsigned int) p[3]);
+   hb->pos += 4;
+   return 1;
+}
+
+
+static int hb_float4( struct header_buf *hb, float *x )
+{
+   int i;
+
+   if (!hb_int4( hb, &i )) {
+      return 0;
+   }
+   memcpy( x, &i, 4 );
+   return 1;
+}
+
+
+static int hb_float4_array( struct header_buf *hb, float *x, int n )
+{
+   int i;
+
+   for (i=0;i<n;i++) {
+      if (!hb_float4( hb, &x[i] )) {
+         return i;
+      }
+   }
+   return n;
+}
+
+
+static int hb_bytes( struct header_buf *hb, void *buf, int n )
+{
+   if (!hb_need( hb, n )) {
+      return 0;
+   }
+   memcpy( buf, hb->data + (hb->pos - hb->start), n );
+   hb->pos += n;
+   return n;
+}
+
+
+
 /*
  * Read a v5d file header.
- * Input:  f - file opened for reading.
- *         v - pointer to v5dstruct to store header info into.
+ * Input:  v - pointer to v5dstruct to store header info into, with
+ *             FileDesc opened for reading.
  * Return:  1 = ok, 0 = error.
  */
 static int read_v5d_header( v5dstruct *v )
 {
-#define SKIP(N)   lseek( f, N, SEEK_CUR )
+#define SKIP(N)   hb.pos += (N)
    int end_of_header = 0;
    unsigned int id;
    int idlen, var, numargs;
-   int f;
+   struct header_buf hb;
 
-   f = v->FileDesc;
+   hb.f = v->FileDesc;
+   hb.start = hb.pos = ltell( hb.f );
+   hb.len = hb.size = 0;
+   hb.chunk = HEADER_CHUNK;
+   hb.data = NULL;
+
+   /* column-major grids unless a TAG_BRICK item says otherwise */
+   v->BrickSize[0] = v->BrickSize[1] = v->BrickSize[2] = 0;
 
    /* first try to read the header id */
-   read_int4( f, (int*) &id );
-   read_int4( f, &idlen );
+   hb_int4( &hb, (int*) &id );
+   hb_int4( &hb, &idlen );
    if (id==TAG_ID && idlen==0) {
       /* this is a v5d file */
       v->FileFormat = 0;
@@ -1711,11 +2343,14 @@ static int read_v5d_header( v5dstruct *v )
    else if (id>=0x80808080 && id<=0x80808083) {
       /* this is an old COMP* file */
       v->FileFormat = id;
-      return read_comp_header( f, v );
+      free( hb.data );
+      lseek( hb.f, hb.pos, SEEK_SET );
+      return read_comp_header( hb.f, v );
    }
    else {
       /* unknown file type */
       printf("Error: not a v5d file\n");
+      free( hb.data );
       return 0;
    }
 
@@ -1725,17 +2360,18 @@ static int read_v5d_header( v5dstruct *v )
       int tag, length;
       int i, var, time, nl, lev;
 
-      if (read_int4(f,&tag)<1 || read_int4(f,&length)<1) {
+      if (!hb_int4(&hb,&tag) || !hb_int4(&hb,&length)) {
          printf("Error while reading header, premature EOF\n");
+         free( hb.data );
          return 0;
       }
 
       switch (tag) {
          case TAG_VERSION:
             assert( length==10 );
-            read_bytes( f, v->FileVersion, 10 );
+            hb_bytes( &hb, v->FileVersion, 10 );
             /* Check if reading a file made by a future version of Vis5D */
-            if (strcmp(v->FileVersion, FILE_VERSION)>0) {
+            if (strcmp(v->FileVersion, EXT_FILE_VERSION)>0) {
                /* WLH 6 Oct 98 */
                printf("Warning: Trying to read a version %s file,", v->FileVersion);
                printf(" you should upgrade Vis5D.\n");
@@ -1743,31 +2379,31 @@ static int read_v5d_header( v5dstruct *v )
             break;
          case TAG_NUMTIMES:
             assert( length==4 );
-            read_int4( f, &v->NumTimes );
+            hb_int4( &hb, &v->NumTimes );
             break;
          case TAG_NUMVARS:
             assert( length==4 );
-            read_int4( f, &v->NumVars );
+            hb_int4( &hb, &v->NumVars );
             break;
          case TAG_VARNAME:
             assert( length==4+MAXVARNAME );   /* 1 int + MAXVARNAME char */
-            read_int4( f, &var );
-            read_bytes( f, v->VarName[var], MAXVARNAME );
+            hb_int4( &hb, &var );
+            hb_bytes( &hb, v->VarName[var], MAXVARNAME );
             break;
          case TAG_NR:
             /* Number of rows for all variables */
             assert( length==4 );
-            read_int4( f, &v->Nr );
+            hb_int4( &hb, &v->Nr );
             break;
          case TAG_NC:
             /* Number of columns for all variables */
             assert( length==4 );
-            read_int4( f, &v->Nc );
+            hb_int4( &hb, &v->Nc );
             break;
          case TAG_NL:
             /* Number of levels for all variables */
             assert( length==4 );
-            read_int4( f, &nl );
+            hb_int4( &hb, &nl );
             for (i=0;i<v->NumVars;i++) {
                v->Nl[i] = nl;
             }
@@ -1775,51 +2411,62 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_NL_VAR:
             /* Number of levels for one variable */
             assert( length==8 );
-            read_int4( f, &var );
-            read_int4( f, &v->Nl[var] );
+            hb_int4( &hb, &var );
+            hb_int4( &hb, &v->Nl[var] );
             break;
          case TAG_LOWLEV_VAR:
             /* Lowest level for one variable */
             assert( length==8 );
-            read_int4( f, &var );
-            read_int4( f, &v->LowLev[var] );
+            hb_int4( &hb, &var );
+            hb_int4( &hb, &v->LowLev[var] );
             break;
 
          case TAG_TIME:
             /* Time stamp for 1 timestep */
             assert( length==8 );
-            read_int4( f, &time );
-            read_int4( f, &v->TimeStamp[time] );
+            hb_int4( &hb, &time );
+            hb_int4( &hb, &v->TimeStamp[time] );
             break;
          case TAG_DATE:
             /* Date stamp for 1 timestep */
             assert( length==8 );
-            read_int4( f, &time );
-            read_int4( f, &v->DateStamp[time] );
+            hb_int4( &hb, &time );
+            hb_int4( &hb, &v->DateStamp[time] );
             break;
 
          case TAG_MINVAL:
             /* Minimum value for a variable */
             assert( length==8 );
-            read_int4( f, &var );
-            read_float4( f, &v->MinVal[var] );
+            hb_int4( &hb, &var );
+            hb_float4( &hb, &v->MinVal[var] );
             break;
          case TAG_MAXVAL:
             /* Maximum value for a variable */
             assert( length==8 );
-            read_int4( f, &var );
-            read_float4( f, &v->MaxVal[var] );
+            hb_int4( &hb, &var );
+            hb_float4( &hb, &v->MaxVal[var] );
             break;
          case TAG_COMPRESS:
             /* Compress mode */
             assert( length==4 );
-            read_int4( f, &v->CompressMode );
+            hb_int4( &hb, &v->CompressMode );
             break;
          case TAG_UNITS:
             /* physical units */
             assert( length==24 );
-            read_int4( f, &var );
-            read_bytes( f, v->Units[var], 20 );
+            hb_int4( &hb, &var );
+            hb_bytes( &hb, v->Units[var], 20 );
+            break;
+         case TAG_TOLERANCE:
+            assert( length==4 );
+            hb_float4( &hb, &v->Tolerance );
+            break;
+         case TAG_BRICK:
+            /* bricked grid layout */
+            assert( length==12 );
+            hb_int4( &hb, &v->BrickSize[0] );
+            hb_int4( &hb, &v->BrickSize[1] );
+            hb_int4( &hb, &v->BrickSize[2] );
             break;
 
          /*
@@ -1827,32 +2474,31 @@ static int read_v5d_header( v5dstruct *v )
           */
          case TAG_VERTICAL_SYSTEM:
             assert( length==4 );
-            read_int4( f, &v->VerticalSystem );
+            hb_int4( &hb, &v->VerticalSystem );
             if (v->VerticalSystem<0 || v->VerticalSystem>3) {
                printf("Error: bad vertical coordinate system: %d\n",
                       v->VerticalSystem );
             }
             break;
          case TAG_VERT_ARGS:
-            read_int4( f, &numargs );
-	    printf("maxvertargs %d %d \n", MAXVERTARGS, numargs); 
+            hb_int4( &hb, &numargs );
             assert( numargs <= MAXVERTARGS );
-            read_float4_array( f, v->VertArgs, numargs );
+            hb_float4_array( &hb, v->VertArgs, numargs );
             assert( length==numargs*4+4 );
             break;
          case TAG_HEIGHT:
             /* height of a grid level */
             assert( length==8 );
-            read_int4( f, &lev );
-            read_float4( f, &v->VertArgs[lev] );
+            hb_int4( &hb, &lev );
+            hb_float4( &hb, &v->VertArgs[lev] );
             break;
          case TAG_BOTTOMBOUND:
             assert( length==4 );
-            read_float4( f, &v->VertArgs[0] );
+            hb_float4( &hb, &v->VertArgs[0] );
             break;
          case TAG_LEVINC:
             assert( length==4 );
-            read_float4( f, &v->VertArgs[1] );
+            hb_float4( &hb, &v->VertArgs[1] );
             break;
 
          /*
@@ -1860,24 +2506,25 @@ static int read_v5d_header( v5dstruct *v )
           */
          case TAG_PROJECTION:
             assert( length==4 );
-            read_int4( f, &v->Projection );
+            hb_int4( &hb, &v->Projection );
             if (v->Projection<0 || v->Projection>5) { /* WLH 4-21-95 */
                printf("Error while reading header, bad projection (%d)\n",
                        v->Projection );
+               free( hb.data );
                return 0;
             }
             break;
          case TAG_PROJ_ARGS:
-            read_int4( f, &numargs );
+            hb_int4( &hb, &numargs );
             assert( numargs <= MAXPROJARGS );
 	    //	    fprintf(stderr,"numargs=%d %d\n",numargs,MAXPROJARGS);
-            read_float4_array( f, v->ProjArgs, numargs );
+            hb_float4_array( &hb, v->ProjArgs, numargs );
             assert( length==4*numargs+4 );
             break;
          case TAG_NORTHBOUND:
             assert( length==4 );
             if (v->Projection==0 || v->Projection==1 || v->Projection==4) {
-               read_float4( f, &v->ProjArgs[0] );
+               hb_float4( &hb, &v->ProjArgs[0] );
             }
             else {
                SKIP( 4 );
@@ -1886,7 +2533,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_WESTBOUND:
             assert( length==4 );
             if (v->Projection==0 || v->Projection==1 || v->Projection==4) {
-               read_float4( f, &v->ProjArgs[1] );
+               hb_float4( &hb, &v->ProjArgs[1] );
             }
             else {
                SKIP( 4 );
@@ -1895,7 +2542,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_ROWINC:
             assert( length==4 );
             if (v->Projection==0 || v->Projection==1 || v->Projection==4) {
-               read_float4( f, &v->ProjArgs[2] );
+               hb_float4( &hb, &v->ProjArgs[2] );
             }
             else {
                SKIP( 4 );
@@ -1904,13 +2551,13 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_COLINC:
             assert( length==4 );
             if (v->Projection==0 || v->Projection==1 || v->Projection==4) {
-               read_float4( f, &v->ProjArgs[3] );
+               hb_float4( &hb, &v->ProjArgs[3] );
             }
             else if (v->Projection==2) {
-               read_float4( f, &v->ProjArgs[5] );
+               hb_float4( &hb, &v->ProjArgs[5] );
             }
             else if (v->Projection==3) {
-               read_float4( f, &v->ProjArgs[4] );
+               hb_float4( &hb, &v->ProjArgs[4] );
             }
             else {
                SKIP( 4 );
@@ -1919,7 +2566,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_ROWINCKM:
             assert( length==4 );
             if (v->Projection==5){
-               read_float4( f, &v->ProjArgs[2] );
+               hb_float4( &hb, &v->ProjArgs[2] );
             }
             else {
                SKIP( 4 );
@@ -1928,7 +2575,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_COLINCKM:
             assert( length==4 );
             if (v->Projection==5){
-               read_float4( f, &v->ProjArgs[3] );
+               hb_float4( &hb, &v->ProjArgs[3] );
             }
             else {
                SKIP( 4 );
@@ -1937,7 +2584,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_LAT1:
             assert( length==4 );
             if (v->Projection==2) {
-               read_float4( f, &v->ProjArgs[0] );
+               hb_float4( &hb, &v->ProjArgs[0] );
             }
             else {
                SKIP( 4 );
@@ -1946,7 +2593,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_LAT2:
             assert( length==4 );
             if (v->Projection==2) {
-               read_float4( f, &v->ProjArgs[1] );
+               hb_float4( &hb, &v->ProjArgs[1] );
             }
             else {
                SKIP( 4 );
@@ -1955,7 +2602,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_POLE_ROW:
             assert( length==4 );
             if (v->Projection==2) {
-               read_float4( f, &v->ProjArgs[2] );
+               hb_float4( &hb, &v->ProjArgs[2] );
             }
             else {
                SKIP( 4 );
@@ -1964,7 +2611,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_POLE_COL:
             assert( length==4 );
             if (v->Projection==2) {
-               read_float4( f, &v->ProjArgs[3] );
+               hb_float4( &hb, &v->ProjArgs[3] );
             }
             else {
                SKIP( 4 );
@@ -1973,13 +2620,13 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_CENTLON:
             assert( length==4 );
             if (v->Projection==2) {
-               read_float4( f, &v->ProjArgs[4] );
+               hb_float4( &hb, &v->ProjArgs[4] );
             }
             else if (v->Projection==3 || v->Projection==5) {
-               read_float4( f, &v->ProjArgs[1] );
+               hb_float4( &hb, &v->ProjArgs[1] );
             }
             else if (v->Projection==4) { /* WLH 4-21-95 */
-               read_float4( f, &v->ProjArgs[5] );
+               hb_float4( &hb, &v->ProjArgs[5] );
             }
             else {
                SKIP( 4 );
@@ -1988,10 +2635,10 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_CENTLAT:
             assert( length==4 );
             if (v->Projection==3 || v->Projection==5) {
-               read_float4( f, &v->ProjArgs[0] );
+               hb_float4( &hb, &v->ProjArgs[0] );
             }
             else if (v->Projection==4) { /* WLH 4-21-95 */
-               read_float4( f, &v->ProjArgs[4] );
+               hb_float4( &hb, &v->ProjArgs[4] );
             }
             else {
                SKIP( 4 );
@@ -2000,7 +2647,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_CENTROW:
             assert( length==4 );
             if (v->Projection==3) {
-               read_float4( f, &v->ProjArgs[2] );
+               hb_float4( &hb, &v->ProjArgs[2] );
             }
             else {
                SKIP( 4 );
@@ -2009,7 +2656,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_CENTCOL:
             assert( length==4 );
             if (v->Projection==3) {
-               read_float4( f, &v->ProjArgs[3] );
+               hb_float4( &hb, &v->ProjArgs[3] );
             }
             else {
                SKIP( 4 );
@@ -2018,7 +2665,7 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_ROTATION:
             assert( length==4 );
             if (v->Projection==4) { /* WLH 4-21-95 */
-               read_float4( f, &v->ProjArgs[6] );
+               hb_float4( &hb, &v->ProjArgs[6] );
             }
             else {
                SKIP( 4 );
@@ -2028,24 +2675,26 @@ static int read_v5d_header( v5dstruct *v )
          case TAG_END:
             /* end of header */
             end_of_header = 1;
-            lseek( f, length, SEEK_CUR );
+            hb.pos += length;
             break;
 
          default:
             /* unknown tag, skip to next tag */
             printf("Unknown tag: %d  length=%d\n", tag, length );
-            lseek( f, length, SEEK_CUR );
+            hb.pos += length;
             break;
       }
 
    }
 
+   free( hb.data );
    v5dVerifyStruct( v );
 
    /* Now we're ready to read the grid data */
 
-   /* Save current file pointer */
-   v->FirstGridPos = ltell(f);
+   /* Save position of the first grid, and leave the file there */
+   v->FirstGridPos = hb.pos;
+   lseek( hb.f, hb.pos, SEEK_SET );
 
    /* compute grid sizes */
    v->SumGridSizes = 0;
@@ -2060,17 +2709,527 @@ static int read_v5d_header( v5dstruct *v )
 
 
 
-
 /*
- * Open a v5d file for reading.
- * Input:  filename - name of v5d file to open
- *         v - pointer to a v5dstruct in which to put header info or NULL
- *             if a struct should be dynamically allocated.
- * Return:  NULL if error, else v or a pointer to a new v5dstruct if v was NULL
+ * Multi-file data sets:  a list of .v5d files with the same grid layout,
+ * such as one file per forecast hour, read as one v5dstruct whose
+ * timesteps are those of all the files in time order.  Only the headers
+ * are read when the set is opened; at most V5D_MAX_OPEN_FILES of the files
+ * are kept open at once and the others are (re)opened when a grid in them
+ * is read.
+ */
+
+#define V5D_MAX_OPEN_FILES 32   /* file descriptors kept by a data set */
+#define V5D_SCAN_THREADS    8   /* threads reading the headers */
+
+struct v5d_file {
+   char *Name;
+   int NumTimes;            /* timesteps in this file */
+   int FirstTime;           /* its first timestep in the data set */
+   off_t FirstGridPos;      /* position of first grid in the file */
+   int FileDesc;            /* Unix file descriptor or -1 if closed */
+   unsigned int LastUse;    /* value of the set's Clock when last read */
+
+   /* header info kept only while the set is being opened */
+   int *TimeStamp, *DateStamp;
+   float *MinVal, *MaxVal;
+   short *McFile, *McGrid;
+   int Status;              /* 1 = ok, 0 = unreadable, -1 = incompatible */
+};
+
+struct v5d_fileset {
+   int NumFiles;
+   struct v5d_file *File;   /* [NumFiles] in time order */
+   int *TimeFile;           /* [NumTimes] which file holds each timestep */
+   int NumOpen;             /* how many of the files are open */
+   unsigned int Clock;      /* counts grid reads, for closing the LRU file */
+};
+
+/* shared by the threads which read the headers of a new data set */
+struct v5d_scan {
+   const v5dstruct *First;  /* header of the first file */
+   struct v5d_file *File;
+   int NumFiles;
+   int Next;                /* next file to read */
+#ifdef HAVE_PTHREADS
+   pthread_mutex_t Lock;
+#endif
+};
+
+
+
+/*
+ * Compare two headers to see if their grids can be read as parts of one
+ * data set.
+ * Return:  1 = compatible, 0 = not
+ */
+static int same_grid_layout( const v5dstruct *a, const v5dstruct *b )
+{
+   int var;
+
+   if (a->FileFormat || b->FileFormat
+       || a->Nr!=b->Nr || a->Nc!=b->Nc || a->NumVars!=b->NumVars
+       || a->CompressMode!=b->CompressMode || a->Tolerance!=b->Tolerance
+       || a->Projection!=b->Projection
+       || a->VerticalSystem!=b->VerticalSystem
+       || memcmp( a->BrickSize, b->BrickSize, sizeof(a->BrickSize) )
+       || memcmp( a->ProjArgs, b->ProjArgs, sizeof(a->ProjArgs) )
+       || memcmp( a->VertArgs, b->VertArgs, sizeof(a->VertArgs) )) {
+      return 0;
+   }
+   for (var=0;var<a->NumVars;var++) {
+      if (a->Nl[var]!=b->Nl[var] || a->LowLev[var]!=b->LowLev[var]
+          || strcmp( a->VarName[var], b->VarName[var] )) {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+
+
+/*
+ * Read the header of one file of a data set into a scratch v5dstruct
+ * and keep the parts which differ from file to file.
+ * Input:  scan - the data set being opened
+ *         file - which file
+ *         v - scratch v5dstruct
+ */
+static void scan_file( struct v5d_scan *scan, struct v5d_file *file,
+                       v5dstruct *v )
+{
+   int fd, n;
+
+   v5dInitStruct( v );
+   file->Status = 0;
+   fd = open( file->Name, O_RDONLY );
+   if (fd==-1) {
+      return;
+   }
+   v->FileDesc = fd;
+   v->Mode = 'r';
+   if (read_v5d_header( v )) {
+      if (scan->First && !same_grid_layout( scan->First, v )) {
+         file->Status = -1;
+      }
+      else {
+         n = v->NumTimes;
+         file->NumTimes = n;
+         file->FirstGridPos = v->FirstGridPos;
+         file->TimeStamp = (int *) malloc( 2 * n * sizeof(int) );
+         file->MinVal = (float *) malloc( 2 * v->NumVars * sizeof(float) );
+         if (file->TimeStamp && file->MinVal) {
+            file->DateStamp = file->TimeStamp + n;
+            file->MaxVal = file->MinVal + v->NumVars;
+            memcpy( file->TimeStamp, v->TimeStamp, n * sizeof(int) );
+            memcpy( file->DateStamp, v->DateStamp, n * sizeof(int) );
+            memcpy( file->MinVal, v->MinVal, v->NumVars * sizeof(float) );
+            memcpy( file->MaxVal, v->MaxVal, v->NumVars * sizeof(float) );
+            file->McFile = v->McFile;
+            file->McGrid = v->McGrid;
+            v->McFile = v->McGrid = NULL;
+            file->Status = 1;
+         }
+      }
+   }
+   v5dFreeMcIDAS( v );
+   close( fd );
+}
+
+
+
+/*
+ * Read the headers of the files of a data set which haven't been read
+ * yet.  Several threads may run this at once.
+ * Input:  arg - pointer to the struct v5d_scan
+ */
+static void *scan_files( void *arg )
+{
+   struct v5d_scan *scan = (struct v5d_scan *) arg;
+   v5dstruct *v;
+   int i;
+
+   v = v5dNewStruct();
+   if (!v) {
+      return NULL;
+   }
+   for (;;) {
+#ifdef HAVE_PTHREADS
+      pthread_mutex_lock( &scan->Lock );
+#endif
+      i = scan->Next++;
+#ifdef HAVE_PTHREADS
+      pthread_mutex_unlock( &scan->Lock );
+#endif
+      if (i>=scan->NumFiles) {
+         break;
+      }
+      scan_file( scan, &scan->File[i], v );
+   }
+   v5dFreeStruct( v );
+   return NULL;
+}
+
+
+
+/*
+ * Time of the first and last timesteps of a file, in seconds.
+ */
+static double file_start( const struct v5d_file *file )
+{
+   return v5dYYDDDtoDays( file->DateStamp[0] ) * 86400.0
+          + v5dHHMMSStoSeconds( file->TimeStamp[0] );
+}
+
+static double file_end( const struct v5d_file *file )
+{
+   int t = file->NumTimes - 1;
+   return v5dYYDDDtoDays( file->DateStamp[t] ) * 86400.0
+          + v5dHHMMSStoSeconds( file->TimeStamp[t] );
+}
+
+static int compare_file_start( const void *a, const void *b )
+{
+   double ta = file_start( (const struct v5d_file *) a );
+   double tb = file_start( (const struct v5d_file *) b );
+   return ta<tb ? -1 : ta>tb ? 1 : 0;
+}
+
+
+
+/*
+ * Free a data set and close its files.
+ */
+static void free_fileset( struct v5d_fileset *set )
+{
+   int i;
+
+   for (i=0;i<set->NumFiles;i++) {
+      struct v5d_file *file = &set->File[i];
+      if (file->FileDesc>=0) {
+         close( file->FileDesc );
+      }
+      if (file->TimeStamp)  free( file->TimeStamp );
+      if (file->MinVal)  free( file->MinVal );
+      if (file->McFile)  free( file->McFile );
+      if (file->McGrid)  free( file->McGrid );
+      free( file->Name );
+   }
+   if (set->TimeFile)  free( set->TimeFile );
+   free( set->File );
+   free( set );
+}
+
+
+
+/*
+ * Open a list of v5d files as one data set.  The files must have the same
+ * grid dimensions, variables, compression, projection and vertical
+ * coordinate system; they may have any number of timesteps each.  They
+ * are ordered by the time of their first timestep, which must come after
+ * the last timestep of the previous file.  Only the file headers are read
+ * here, several at once if threads are available.
+ * Input:  numfiles - how many files
+ *         filenames - their names
+ *         v - pointer to a v5dstruct in which to put header info or NULL
+ *             if a struct should be dynamically allocated.
+ * Return:  NULL if error, else v or a pointer to a new v5dstruct if v was NULL
+ */
+v5dstruct *v5dOpenFiles( int numfiles, const char *filenames[], v5dstruct *v )
+{
+   struct v5d_fileset *set;
+   struct v5d_scan scan;
+   int i, t, var, numtimes, ok, allocated = 0;
+
+   if (numfiles<1) {
+      return NULL;
+   }
+   set = (struct v5d_fileset *) calloc( 1, sizeof(struct v5d_fileset) );
+   if (!set) {
+      return NULL;
+   }
+   set->File = (struct v5d_file *) calloc( numfiles, sizeof(struct v5d_file) );
+   if (!set->File) {
+      free( set );
+      return NULL;
+   }
+   set->NumFiles = numfiles;
+   for (i=0;i<numfiles;i++) {
+      set->File[i].FileDesc = -1;
+      set->File[i].Name = strdup( filenames[i] );
+      if (!set->File[i].Name) {
+         free_fileset( set );
+         return NULL;
+      }
+   }
+
+   if (v) {
+      v5dInitStruct( v );
+   }
+   else {
+      v = v5dNewStruct();
+      if (!v) {
+         free_fileset( set );
+         return NULL;
+      }
+      allocated = 1;
+   }
+
+   /* the first file's header is the reference for the others */
+   scan.First = NULL;
+   scan.File = set->File;
+   scan.NumFiles = numfiles;
+   scan_file( &scan, &set->File[0], v );
+   if (set->File[0].Status!=1) {
+      printf("Error: can't read v5d file %s\n", filenames[0] );
+      free_fileset( set );
+      if (allocated)  v5dFreeStruct( v );
+      return NULL;
+   }
+   if (v->FileFormat) {
+      printf("Error: %s is an old COMP* file, it can't be part of a ",
+             filenames[0] );
+      printf("multi-file data set\n");
+      free_fileset( set );
+      if (allocated)  v5dFreeStruct( v );
+      return NULL;
+   }
+   scan.First = v;
+   scan.Next = 1;
+#ifdef HAVE_PTHREADS
+   if (numfiles>2) {
+      pthread_t thread[V5D_SCAN_THREADS];
+      int n = numfiles-1 < V5D_SCAN_THREADS ? numfiles-1 : V5D_SCAN_THREADS;
+
+      pthread_mutex_init( &scan.Lock, NULL );
+      for (i=0;i<n;i++) {
+         if (pthread_create( &thread[i], NULL, scan_files, &scan )) {
+            break;
+         }
+      }
+      /* read the rest here if some threads couldn't be started */
+      scan_files( &scan );
+      while (i>0) {
+         pthread_join( thread[--i], NULL );
+      }
+      pthread_mutex_destroy( &scan.Lock );
+   }
+   else {
+      pthread_mutex_init( &scan.Lock, NULL );
+      scan_files( &scan );
+      pthread_mutex_destroy( &scan.Lock );
+   }
+#else
+   scan_files( &scan );
+#endif
+
+   ok = 1;
+   numtimes = 0;
+   for (i=0;i<numfiles;i++) {
+      if (set->File[i].Status==0) {
+         printf("Error: can't read v5d file %s\n", filenames[i] );
+         ok = 0;
+      }
+      else if (set->File[i].Status<0) {
+         printf("Error: grids of %s don't match those of %s\n",
+                filenames[i], filenames[0] );
+         ok = 0;
+      }
+      else {
+         numtimes += set->File[i].NumTimes;
+      }
+   }
+   if (ok && numtimes>MAXTIMES) {
+      printf("Error: Too many time steps (%d) limit is %d\n", numtimes,
+             MAXTIMES );
+      ok = 0;
+   }
+   if (ok) {
+      qsort( set->File, numfiles, sizeof(struct v5d_file), compare_file_start );
+      for (i=1;i<numfiles;i++) {
+         if (file_start( &set->File[i] ) <= file_end( &set->File[i-1] )) {
+            printf("Error: times of %s and %s overlap\n",
+                   set->File[i-1].Name, set->File[i].Name );
+            ok = 0;
+            break;
+         }
+      }
+   }
+   if (ok) {
+      set->TimeFile = (int *) malloc( numtimes * sizeof(int) );
+      if (!set->TimeFile) {
+         printf("Error in v5dOpenFiles: out of memory\n");
+         ok = 0;
+      }
+   }
+   if (!ok) {
+      free_fileset( set );
+      if (allocated)  v5dFreeStruct( v );
+      return NULL;
+   }
+
+   /* merge the headers:  the reference gives the grid layout, each */
+   /* file adds its timesteps and widens the data ranges */
+   v->NumTimes = numtimes;
+   v5dFreeMcIDAS( v );
+   t = 0;
+   for (i=0;i<numfiles;i++) {
+      struct v5d_file *file = &set->File[i];
+      int n = file->NumTimes;
+
+      file->FirstTime = t;
+      memcpy( v->TimeStamp + t, file->TimeStamp, n * sizeof(int) );
+      memcpy( v->DateStamp + t, file->DateStamp, n * sizeof(int) );
+      for (var=0;var<v->NumVars;var++) {
+         if (i==0 || file->MinVal[var] < v->MinVal[var]) {
+            v->MinVal[var] = file->MinVal[var];
+         }
+         if (i==0 || file->MaxVal[var] > v->MaxVal[var]) {
+            v->MaxVal[var] = file->MaxVal[var];
+         }
+      }
+      if (file->McFile && alloc_mcidas( v )) {
+         memcpy( v->McFile + t * v->NumVars, file->McFile,
+                 n * v->NumVars * sizeof(short) );
+         memcpy( v->McGrid + t * v->NumVars, file->McGrid,
+                 n * v->NumVars * sizeof(short) );
+      }
+      while (n-- > 0) {
+         set->TimeFile[t++] = i;
+      }
+      free( file->TimeStamp );
+      free( file->MinVal );
+      if (file->McFile)  free( file->McFile );
+      if (file->McGrid)  free( file->McGrid );
+      file->TimeStamp = file->DateStamp = NULL;
+      file->MinVal = file->MaxVal = NULL;
+      file->McFile = file->McGrid = NULL;
+   }
+
+   v->FileSet = set;
+   v->FileDesc = -1;
+   v->Mode = 'r';
+   return v;
+}
+
+
+
+/*
+ * Find the file and position of a grid, opening the file of a multi-file
+ * data set if needed.
+ * Input:  v - pointer to v5dstruct describing the file or data set
+ *         time, var - which timestep and variable
+ * Output:  pos - file offset of the grid
+ * Return:  file descriptor, or -1 if error
+ */
+static int grid_file( v5dstruct *v, int time, int var, off_t *pos )
+{
+   struct v5d_fileset *set = v->FileSet;
+   struct v5d_file *file;
+   int i;
+
+   if (!set) {
+      *pos = grid_position( v, time, var );
+      return v->FileDesc;
+   }
+
+   file = &set->File[set->TimeFile[time]];
+   *pos = file->FirstGridPos
+          + (off_t) (time - file->FirstTime) * v->SumGridSizes;
+   for (i=0;i<var;i++) {
+      *pos += v->GridSize[i];
+   }
+   file->LastUse = ++set->Clock;
+   if (file->FileDesc>=0) {
+      return file->FileDesc;
+   }
+
+   if (set->NumOpen>=V5D_MAX_OPEN_FILES) {
+      /* close the least recently used file */
+      struct v5d_file *lru = NULL;
+      for (i=0;i<set->NumFiles;i++) {
+         if (set->File[i].FileDesc>=0
+             && (!lru || set->File[i].LastUse < lru->LastUse)) {
+            lru = &set->File[i];
+         }
+      }
+      close( lru->FileDesc );
+      lru->FileDesc = -1;
+      set->NumOpen--;
+   }
+   file->FileDesc = open( file->Name, O_RDONLY );
+   if (file->FileDesc<0) {
+      printf("Error: can't open v5d file %s\n", file->Name );
+      return -1;
+   }
+   set->NumOpen++;
+   return file->FileDesc;
+}
+
+
+
+#ifdef HAVE_GLOB_H
+/*
+ * Open all the files matching a glob(3) pattern, or all the .v5d files
+ * in a directory, as one data set.
+ * Input:  pattern - the pattern or directory name
+ *         v - as for v5dOpenFiles
+ * Return:  as for v5dOpenFiles; NULL if nothing matches
+ */
+static v5dstruct *open_file_pattern( const char *pattern, v5dstruct *v )
+{
+   struct stat st;
+   glob_t g;
+   char *dirpat = NULL;
+   int status;
+
+   if (stat( pattern, &st )==0 && S_ISDIR(st.st_mode)) {
+      dirpat = (char *) malloc( strlen(pattern) + 8 );
+      if (!dirpat) {
+         return NULL;
+      }
+      sprintf( dirpat, "%s/*.v5d", pattern );
+      pattern = dirpat;
+   }
+   status = glob( pattern, 0, NULL, &g );
+   if (dirpat) {
+      free( dirpat );
+   }
+   if (status!=0) {
+      return NULL;
+   }
+   if (g.gl_pathc==1) {
+      v = v5dOpenFile( g.gl_pathv[0], v );
+   }
+   else {
+      v = v5dOpenFiles( (int) g.gl_pathc, (const char **) g.gl_pathv, v );
+   }
+   globfree( &g );
+   return v;
+}
+#endif
+
+
+
+
+/*
+ * Open a v5d file for reading.  If filename is a directory, all the .v5d
+ * files in it are opened as one data set (see v5dOpenFiles), as are all
+ * the files matching filename if it is a wildcard pattern.
+ * Input:  filename - name of v5d file to open
+ *         v - pointer to a v5dstruct in which to put header info or NULL
+ *             if a struct should be dynamically allocated.
+ * Return:  NULL if error, else v or a pointer to a new v5dstruct if v was NULL
  */
 v5dstruct *v5dOpenFile( const char *filename, v5dstruct *v )
 {
    int fd;
+#ifdef HAVE_GLOB_H
+   struct stat st;
+
+   if (stat( filename, &st )!=0 || S_ISDIR(st.st_mode)) {
+      return open_file_pattern( filename, v );
+   }
+#endif
 
    fd = open( filename, O_RDONLY );
    if (fd==-1) {
@@ -2112,7 +3271,8 @@ v5dstruct *v5dOpenFile( const char *filename, v5dstruct *v )
 int v5dReadCompressedGrid( v5dstruct *v, int time, int var,
                            float *ga, float *gb, void *compdata )
 {
-   int pos, n, k;
+   off_t pos;
+   int f, n, k;
 
    if (time<0 || time>=v->NumTimes) {
       printf("Error in v5dReadCompressedGrid: bad timestep argument (%d)\n",
@@ -2131,23 +3291,49 @@ int v5dReadCompressedGrid( v5dstruct *v, int time, int var,
    }
 
    /* move to position in file */
-   pos = grid_position( v, time, var );
-   lseek( v->FileDesc, pos, SEEK_SET );
+   f = grid_file( v, time, var, &pos );
+   if (f<0) {
+      return 0;
+   }
+   lseek( f, pos, SEEK_SET );
 
    /* read ga, gb arrays */
-   read_float4_array( v->FileDesc, ga, v->Nl[var] );
-   read_float4_array( v->FileDesc, gb, v->Nl[var] );
+   read_float4_array( f, ga, v->Nl[var] );
+   read_float4_array( f, gb, v->Nl[var] );
 
    /* read compressed grid data */
    n = v->Nr * v->Nc * v->Nl[var];
-   if (v->CompressMode==1) {
-     k = read_block( v->FileDesc, compdata, n, 1, INTTYPE )==n;
+   if (V5D_STREAM_MODE(v->CompressMode)) {
+      /* the stream's length, then the rest of it */
+      unsigned char *p = (unsigned char *) compdata;
+      k = read_block( f, p, 4, 1, INTTYPE )==4;
+      if (k) {
+         n = v5dCompressedSize( v->Nr, v->Nc, v->Nl[var], v->CompressMode, p );
+         k = n>8 && n<=v5dSizeofGrid( v, time, var )
+             && read_block( f, p+4, n-4, 1, INTTYPE )==n-4;
+      }
+   }
+   else if (v->BrickSize[0]>0) {
+      /* bricked grid, read it all then reorder to column-major */
+      void *bricks = malloc( (size_t) n * v->CompressMode );
+      if (!bricks) {
+         printf("Error in v5dReadCompressedGrid: out of memory\n");
+         return 0;
+      }
+      k = read_block( f, bricks, n, v->CompressMode, INTTYPE )==n;
+      if (k) {
+         copy_bricks( v, var, bricks, compdata, 0 );
+      }
+      free( bricks );
+   }
+   else if (v->CompressMode==1) {
+     k = read_block( f, compdata, n, 1, INTTYPE )==n;
    }
    else if (v->CompressMode==2) {
-      k = read_block( v->FileDesc, compdata, n, 2, INTTYPE )==n;
+      k = read_block( f, compdata, n, 2, INTTYPE )==n;
    }
    else if (v->CompressMode==4) {
-      k = read_block( v->FileDesc, compdata, n, 4, INTTYPE )==n;
+      k = read_block( f, compdata, n, 4, INTTYPE )==n;
    }
    if (!k) {
       /* error */
@@ -2167,6 +3353,150 @@ int v5dReadCompressedGrid( v5dstruct *v, int time, int var,
 
 
 
+/*
+ * Read a box-shaped part of a compressed grid.  With a bricked file only
+ * the bricks which intersect the box are read, otherwise one run of rows
+ * per column and level (or one run per level if all rows are wanted).
+ * Input:  v - pointer to v5dstruct describing the file
+ *         time, var - which timestep and variable
+ *         row0, col0, lev0 - first row, column and level of the box
+ *         nr, nc, nl - size of the box
+ *         ga, gb - arrays to store all Nl[var] (de)compression values
+ *         compdata - where to store the nr*nc*nl compressed values of
+ *                    the box, in column-major order like a whole grid.
+ * Return:  1 = ok, 0 = error.
+ */
+int v5dReadCompressedRegion( v5dstruct *v, int time, int var,
+                             int row0, int col0, int lev0,
+                             int nr, int nc, int nl,
+                             float *ga, float *gb, void *compdata )
+{
+   char *out = (char *) compdata;
+   int es = v->CompressMode;
+   int f;
+   off_t data;
+   int c, l, k;
+
+   if (time<0 || time>=v->NumTimes || var<0 || var>=v->NumVars) {
+      printf("Error in v5dReadCompressedRegion: bad time/var (%d,%d)\n",
+             time, var);
+      return 0;
+   }
+   if (V5D_STREAM_MODE(v->CompressMode)) {
+      printf("Error in v5dReadCompressedRegion: not available with ");
+      printf("CompressMode %d\n", v->CompressMode );
+      return 0;
+   }
+   if (row0<0 || col0<0 || lev0<0 || nr<1 || nc<1 || nl<1 ||
+       row0+nr>v->Nr || col0+nc>v->Nc || lev0+nl>v->Nl[var]) {
+      printf("Error in v5dReadCompressedRegion: bad region\n");
+      return 0;
+   }
+
+   if (v->FileFormat) {
+      /* old COMP* file, read the whole grid and extract the box */
+      char *grid = (char *) malloc( (size_t) v->Nr * v->Nc * v->Nl[var] * es );
+      if (!grid) {
+         printf("Error in v5dReadCompressedRegion: out of memory\n");
+         return 0;
+      }
+      k = read_comp_grid( v, time, var, ga, gb, grid );
+      for (l=0; k && l<nl; l++) {
+         for (c=0;c<nc;c++) {
+            memcpy( out + ((long) l * nc + c) * nr * es,
+                    grid + (((long) (lev0+l) * v->Nc + col0+c) * v->Nr + row0) * es,
+                    nr * es );
+         }
+      }
+      free( grid );
+      return k;
+   }
+
+   f = grid_file( v, time, var, &data );
+   if (f<0) {
+      return 0;
+   }
+   lseek( f, data, SEEK_SET );
+   read_float4_array( f, ga, v->Nl[var] );
+   read_float4_array( f, gb, v->Nl[var] );
+   data += 8 * v->Nl[var];
+
+   if (v->BrickSize[0]>0) {
+      int r0, c0, l0, rn, cn, ln, r, rlo, rhi, clo, chi, llo, lhi;
+      char *brick;
+
+      brick = (char *) malloc( (size_t) v->BrickSize[0] * v->BrickSize[1]
+                               * v->BrickSize[2] * es );
+      if (!brick) {
+         printf("Error in v5dReadCompressedRegion: out of memory\n");
+         return 0;
+      }
+      k = 1;
+      for (l0=lev0 - lev0 % v->BrickSize[2]; k && l0<lev0+nl;
+           l0+=v->BrickSize[2]) {
+         ln = v->Nl[var] - l0;
+         if (ln > v->BrickSize[2])  ln = v->BrickSize[2];
+         llo = l0>lev0 ? l0 : lev0;
+         lhi = l0+ln < lev0+nl ? l0+ln : lev0+nl;
+         for (c0=col0 - col0 % v->BrickSize[1]; k && c0<col0+nc;
+              c0+=v->BrickSize[1]) {
+            cn = v->Nc - c0;
+            if (cn > v->BrickSize[1])  cn = v->BrickSize[1];
+            clo = c0>col0 ? c0 : col0;
+            chi = c0+cn < col0+nc ? c0+cn : col0+nc;
+            for (r0=row0 - row0 % v->BrickSize[0]; k && r0<row0+nr;
+                 r0+=v->BrickSize[0]) {
+               rn = v->Nr - r0;
+               if (rn > v->BrickSize[0])  rn = v->BrickSize[0];
+               rlo = r0>row0 ? r0 : row0;
+               rhi = r0+rn < row0+nr ? r0+rn : row0+nr;
+
+               lseek( f, data + brick_offset( v, var, r0, c0, l0 ) * es,
+                      SEEK_SET );
+               if (read_block( f, brick, rn*cn*ln, es, INTTYPE )!=rn*cn*ln) {
+                  k = 0;
+                  break;
+               }
+               for (l=llo;l<lhi;l++) {
+                  for (c=clo;c<chi;c++) {
+                     r = ((l-l0) * cn + (c-c0)) * rn + (rlo-r0);
+                     memcpy( out + (((long) (l-lev0) * nc + (c-col0)) * nr
+                                    + (rlo-row0)) * es,
+                             brick + (long) r * es, (rhi-rlo) * es );
+                  }
+               }
+            }
+         }
+      }
+      free( brick );
+   }
+   else {
+      /* column-major, whole levels are contiguous if all rows wanted */
+      int run = (nr==v->Nr) ? nr*nc : nr;
+      int ncols = (nr==v->Nr) ? 1 : nc;
+
+      k = 1;
+      for (l=0; k && l<nl; l++) {
+         for (c=0;c<ncols;c++) {
+            lseek( f, data + (((long) (lev0+l) * v->Nc + col0+c) * v->Nr
+                              + row0) * es, SEEK_SET );
+            if (read_block( f, out + ((long) l * nc + c) * nr * es,
+                            run, es, INTTYPE )!=run) {
+               k = 0;
+               break;
+            }
+         }
+      }
+   }
+
+   if (!k) {
+      printf("Error in v5dReadCompressedRegion: read failed, bad file?\n");
+   }
+   return k;
+}
+
+
+
 
 /*
  * Read a grid from a v5d file, decompress it and return it.
@@ -2192,15 +3522,7 @@ int v5dReadGrid( v5dstruct *v, int time, int var, float data[] )
    }
 
    /* allocate compdata buffer */
-   if (v->CompressMode==1) {
-      bytes = v->Nr * v->Nc * v->Nl[var] * sizeof(unsigned char);
-   }
-   else if (v->CompressMode==2) {
-      bytes = v->Nr * v->Nc * v->Nl[var] * sizeof(unsigned short);
-   }
-   else if (v->CompressMode==4) {
-      bytes = v->Nr * v->Nc * v->Nl[var] * sizeof(float);
-   }
+   bytes = v5dSizeofGrid( v, time, var );
    compdata = (void *) malloc( bytes );
    if (!compdata) {
       printf("Error in v5dReadGrid: out of memory (needed %d bytes)\n", bytes);
@@ -2209,6 +3531,7 @@ int v5dReadGrid( v5dstruct *v, int time, int var, float data[] )
 
    /* read the compressed data */
    if (!v5dReadCompressedGrid( v, time, var, ga, gb, compdata )) {
+      free( compdata );
       return 0;
    }
 
@@ -2262,6 +3585,7 @@ static int write_v5d_header( v5dstruct *v )
    int var, time, filler, maxnl;
    int f;
    int newfile;
+   char version[10];
 
    if (v->FileFormat!=0) {
       printf("Error: v5d library can't write comp5d format files.\n");
@@ -2303,7 +3627,14 @@ static int write_v5d_header( v5dstruct *v )
    /* File Version */
    WRITE_TAG( v, TAG_VERSION, 10 );
    //   write_bytes( f, FILE_VERSION, 10 );
-   write_bytes( f, v->FileVersion, 10 ); // JCM correction
+   /* older readers can't decode these grids, make them warn */
+   memcpy( version, v->FileVersion, 10 );
+   if ((v->BrickSize[0]>0 || V5D_STREAM_MODE(v->CompressMode))
+       && strcmp(version, EXT_FILE_VERSION)<0) {
+      memset( version, 0, 10 );
+      strcpy( version, EXT_FILE_VERSION );
+   }
+   write_bytes( f, version, 10 ); // JCM correction
 
    /* Number of timesteps */
    WRITE_TAG( v, TAG_NUMTIMES, 4 );
@@ -2378,6 +3709,19 @@ static int write_v5d_header( v5dstruct *v )
    WRITE_TAG( v, TAG_COMPRESS, 4 );
    write_int4( f, v->CompressMode );
 
+   if (v->CompressMode==V5D_BOUNDED) {
+      WRITE_TAG( v, TAG_TOLERANCE, 4 );
+      write_float4( f, v->Tolerance );
+   }
+
+   /* Grid layout */
+   if (v->BrickSize[0]>0) {
+      WRITE_TAG( v, TAG_BRICK, 12 );
+      write_int4( f, v->BrickSize[0] );
+      write_int4( f, v->BrickSize[1] );
+      write_int4( f, v->BrickSize[2] );
+   }
+
    /* Vertical Coordinate System */
    WRITE_TAG( v, TAG_VERTICAL_SYSTEM, 4 );
    write_int4( f, v->VerticalSystem );
@@ -2531,7 +3875,24 @@ int v5dWriteCompressedGrid( const v5dstruct *v, int time, int var,
        write_float4_array( v->FileDesc, gb, v->Nl[var] ) == v->Nl[var]) {
       /* write compressed grid data (k=1=OK, k=0=Error) */
       n = v->Nr * v->Nc * v->Nl[var];
-      if (v->CompressMode==1) {
+      if (V5D_STREAM_MODE(v->CompressMode)) {
+         /* just the stream, the rest of the slot is left alone */
+         n = v5dCompressedSize( v->Nr, v->Nc, v->Nl[var], v->CompressMode,
+                                compdata );
+         k = n<=v5dSizeofGrid( v, time, var )
+             && write_block( v->FileDesc, compdata, n, 1, INTTYPE )==n;
+      }
+      else if (v->BrickSize[0]>0) {
+         /* reorder column-major points into bricks and write them */
+         void *bricks = malloc( (size_t) n * v->CompressMode );
+         if (bricks) {
+            copy_bricks( v, var, compdata, bricks, 1 );
+            k = write_block( v->FileDesc, bricks, n, v->CompressMode,
+                             INTTYPE )==n;
+            free( bricks );
+         }
+      }
+      else if (v->CompressMode==1) {
 	k = write_block( v->FileDesc, compdata, n, 1, INTTYPE )==n;
 	//k = write_block( v->FileDesc, compdata, n, 1)==n;
       }
@@ -2595,15 +3956,7 @@ int v5dWriteGrid( v5dstruct *v, int time, int var, const float data[] )
    }
 
    /* allocate compdata buffer */
-   if (v->CompressMode==1) {
-      bytes = v->Nr * v->Nc * v->Nl[var] * sizeof(unsigned char);
-   }
-   else if (v->CompressMode==2) {
-      bytes = v->Nr * v->Nc * v->Nl[var] * sizeof(unsigned short);
-   }
-   else if (v->CompressMode==4) {
-      bytes = v->Nr * v->Nc * v->Nl[var] * sizeof(float);
-   }
+   bytes = v5dSizeofGrid( v, time, var );
    compdata = (void *) malloc( bytes );
    if (!compdata) {
       printf("Error in v5dWriteGrid: out of memory (needed %d bytes)\n",
@@ -2612,8 +3965,8 @@ int v5dWriteGrid( v5dstruct *v, int time, int var, const float data[] )
    }
 
    /* compress the grid data */
-   v5dCompressGrid( v->Nr, v->Nc, v->Nl[var], v->CompressMode, data,
-                    compdata, ga, gb, &min, &max );
+   v5dCompressGridTol( v->Nr, v->Nc, v->Nl[var], v->CompressMode,
+                       v->Tolerance, data, compdata, ga, gb, &min, &max );
 
    /* update min and max value */
    if (min<v->MinVal[var])
@@ -2632,6 +3985,74 @@ int v5dWriteGrid( v5dstruct *v, int time, int var, const float data[] )
 
 
 
+/*
+ * Change the layout of the grids in a v5d file opened with
+ * v5dUpdateFile().  Every grid is read and rewritten in place (a grid
+ * takes the same space in either layout) and the header is updated.
+ * Input:  v - pointer to v5dstruct describing the file
+ *         rows, cols, levs - brick size, or all 0 for column-major grids
+ * Return:  1 = ok, 0 = error.
+ */
+int v5dSetBrickSize( v5dstruct *v, int rows, int cols, int levs )
+{
+   float ga[MAXLEVELS], gb[MAXLEVELS];
+   int old[3], time, var, maxnl, ok;
+   void *compdata;
+
+   if (v->Mode!='w' || v->FileFormat) {
+      printf("Error in v5dSetBrickSize: file not open for updating\n");
+      return 0;
+   }
+   if (rows<=0 || cols<=0 || levs<=0) {
+      rows = cols = levs = 0;
+   }
+   if (rows>0 && V5D_STREAM_MODE(v->CompressMode)) {
+      printf("Error in v5dSetBrickSize: CompressMode %d grids can't be bricked\n",
+             v->CompressMode );
+      return 0;
+   }
+   if (rows==v->BrickSize[0] && cols==v->BrickSize[1]
+       && levs==v->BrickSize[2]) {
+      return 1;
+   }
+
+   maxnl = 0;
+   for (var=0;var<v->NumVars;var++) {
+      if (v->Nl[var]>maxnl)  maxnl = v->Nl[var];
+   }
+   compdata = malloc( (size_t) v->Nr * v->Nc * maxnl * v->CompressMode );
+   if (!compdata) {
+      printf("Error in v5dSetBrickSize: out of memory\n");
+      return 0;
+   }
+
+   old[0] = v->BrickSize[0];
+   old[1] = v->BrickSize[1];
+   old[2] = v->BrickSize[2];
+   ok = 1;
+   for (time=0; ok && time<v->NumTimes; time++) {
+      for (var=0; ok && var<v->NumVars; var++) {
+         v->BrickSize[0] = old[0];
+         v->BrickSize[1] = old[1];
+         v->BrickSize[2] = old[2];
+         ok = v5dReadCompressedGrid( v, time, var, ga, gb, compdata );
+         v->BrickSize[0] = rows;
+         v->BrickSize[1] = cols;
+         v->BrickSize[2] = levs;
+         ok = ok && v5dWriteCompressedGrid( v, time, var, ga, gb, compdata );
+      }
+   }
+   free( compdata );
+
+   if (!ok) {
+      printf("Error in v5dSetBrickSize: file is only partly converted\n");
+      return 0;
+   }
+   return write_v5d_header( v );
+}
+
+
+
 /*
  * Close a v5d file which was opened with open_v5d_file() or
  * create_v5d_file().
@@ -2650,6 +4071,11 @@ int v5dCloseFile( v5dstruct *v )
       lseek( v->FileDesc, 0, SEEK_END );
       close( v->FileDesc );
    }
+   else if (v->Mode=='r' && v->FileSet) {
+      /* close the files of a multi-file data set */
+      free_fileset( v->FileSet );
+      v->FileSet = NULL;
+   }
    else if (v->Mode=='r') {
       /* just close the file */
       close(v->FileDesc);
@@ -2870,6 +4296,26 @@ int v5dSetUnits( int var, const char *units )
 
 
 
+/*
+ * Set the absolute error bound for grids written in the V5D_BOUNDED
+ * compress mode.
+ * Input:  tolerance - the bound, or 0 for 1/65534 of each level's range
+ * Return:  1 = ok, 0 = error
+ */
+int v5dSetTolerance( float tolerance )
+{
+  if (Simple) {
+     Simple->Tolerance = tolerance>0.0 ? tolerance : 0.0;
+     return 1;
+  }
+  else {
+     printf("Error: must call v5dCreate before v5dSetTolerance\n");
+     return 0;
+  }
+}
+
+
+
 /*
  * Write a grid to a v5d file.
  * Input:  time - timestep in [1,NumTimes]
@@ -3194,9 +4640,7 @@ int F77_FUNC(v5dmcfile,V5DMCFILE)
       return 0;
    }
 
-   Simple->McFile[*time-1][*var-1] = (short) *mcfile;
-   Simple->McGrid[*time-1][*var-1] = (short) *mcgrid;
-   return 1;
+   return v5dSetMcIDASgrid( Simple, *time-1, *var-1, *mcfile, *mcgrid );
 }
 
 
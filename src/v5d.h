@@ -172,13 +172,23 @@ typedef unsigned short V5Dushort;   /* Must be 2 byte, except for cray */
 
 
 
+/*
+ * CompressMode values besides 1, 2 or 4 bytes per grid point.  These
+ * store each grid as a variable length stream of LZ compressed level
+ * blocks (see v5d.c).
+ */
+#define V5D_LOSSLESS 5      /* byte-shuffled IEEE floats, exact */
+#define V5D_BOUNDED  6      /* quantized to within +/- Tolerance */
+#define V5D_STREAM_MODE( M )  ( (M)==V5D_LOSSLESS || (M)==V5D_BOUNDED )
+
+
 #define MISSING 1.0e35
 #define IS_MISSING(X)  ( (X) >= 1.0e30 )
 
 
 /* Limits on 5-D grid size:  (must match those in v5df.h!!!) */
 #define MAXVARS     200
-#define MAXTIMES    1000
+#define MAXTIMES    10000
 #define MAXROWS     1000
 #define MAXCOLUMNS  1600 
 #define MAXLEVELS   600
@@ -243,6 +253,8 @@ extern int v5dSetLowLev( int lowlev[] );
 
 extern int v5dSetUnits( int var, const char *units );
 
+extern int v5dSetTolerance( float tolerance );
+
 
 
 /************************************************************************/
@@ -256,6 +268,8 @@ extern int v5dSetUnits( int var, const char *units );
 #define MAXPROJARGS (MAXROWS+MAXCOLUMNS+1)
 #define MAXVERTARGS (MAXLEVELS+1)
 
+struct v5d_fileset;
+
 /*
  * This struct describes the structure of a .v5d file.
  */
@@ -274,9 +288,10 @@ typedef struct {
         float MinVal[MAXVARS];          /* Minimum variable data values */
         float MaxVal[MAXVARS];          /* Maximum variable data values */
 
-        /* This info is used for external function computation */
-        short McFile[MAXTIMES][MAXVARS];/* McIDAS file number in 1..9999 */
-        short McGrid[MAXTIMES][MAXVARS];/* McIDAS grid number in 1..? */
+        /* This info is used for external function computation; */
+        /* [time*NumVars+var], allocated by the first grid that has it */
+        short *McFile;                  /* McIDAS file number in 1..9999 */
+        short *McGrid;                  /* McIDAS grid number in 1..? */
 
         int VerticalSystem;             /* Which vertical coordinate system */
         float VertArgs[MAXVERTARGS];    /* Vert. Coord. Sys. arguments... */
@@ -366,8 +381,13 @@ typedef struct {
         ENDIF
         */
 
-        int CompressMode;        /* 1, 2 or 4 = # bytes per grid point */
+        int CompressMode;        /* 1, 2 or 4 = # bytes per grid point, */
+                                 /* or V5D_LOSSLESS or V5D_BOUNDED */
+        float Tolerance;         /* absolute error bound for V5D_BOUNDED */
+                                 /* or 0 = 1/65534 of each level's range */
         char FileVersion[10];    /* 9-character version number */
+        int BrickSize[3];        /* rows, cols, levels per brick of a */
+                                 /* bricked file, or 0 = column-major */
 
     /* PRIVATE (not to be touched by user code) */
         unsigned int FileFormat; /* COMP5D file version or 0 if .v5d */
@@ -377,6 +397,8 @@ typedef struct {
         int FirstGridPos;        /* position of first grid in file */
         int GridSize[MAXVARS];   /* size of each grid */
         int SumGridSizes;        /* sum of GridSize[0..NumVars-1] */
+        struct v5d_fileset *FileSet; /* files of a multi-file data set */
+                                 /* (see v5dOpenFiles) or NULL */
 } v5dstruct;
 
 
@@ -404,6 +426,8 @@ extern v5dstruct *v5dNewStruct( void );
 
 extern void v5dFreeStruct( v5dstruct* v );
 
+extern void v5dFreeMcIDAS( v5dstruct *v );
+
 extern void v5dInitStruct( v5dstruct *v );
 
 extern int v5dVerifyStruct( const v5dstruct *v );
@@ -415,18 +439,41 @@ extern void v5dCompressGrid( int nr, int nc, int nl, int compressmode,
                              float *minval, float *maxval );
 
 
+extern int v5dCompressGridTol( int nr, int nc, int nl, int compressmode,
+                               float tolerance, const float data[],
+                               void *compdata, float ga[], float gb[],
+                               float *minval, float *maxval );
+
+
 extern void v5dDecompressGrid( int nr, int nc, int nl, int compressmode,
                                void *compdata,
                                float ga[], float gb[],
                                float data[] );
 
 
+extern int v5dDecompressLevels( int nr, int nc, int nl, int compressmode,
+                                const void *compdata, const float ga[],
+                                const float gb[], int lev0, int nlev,
+                                float data[] );
+
+
+extern int v5dCompressedBound( int nr, int nc, int nl, int compressmode );
+
+
+extern int v5dCompressedSize( int nr, int nc, int nl, int compressmode,
+                              const void *compdata );
+
+
 extern int v5dSizeofGrid( const v5dstruct *v, int time, int var );
 
 
 extern v5dstruct *v5dOpenFile( const char *filename, v5dstruct *v );
 
 
+extern v5dstruct *v5dOpenFiles( int numfiles, const char *filenames[],
+                                v5dstruct *v );
+
+
 extern int v5dCreateFile( const char *filename, v5dstruct *v );
 
 
@@ -442,6 +489,12 @@ extern int v5dReadCompressedGrid( v5dstruct *v,
                                   void *compdata );
 
 
+extern int v5dReadCompressedRegion( v5dstruct *v, int time, int var,
+                                    int row0, int col0, int lev0,
+                                    int nr, int nc, int nl,
+                                    float *ga, float *gb, void *compdata );
+
+
 extern int v5dReadGrid( v5dstruct *v, int time, int var, float data[] );
 
 
@@ -453,6 +506,9 @@ extern int v5dWriteCompressedGrid( const v5dstruct *v,
 
 extern int v5dWriteGrid( v5dstruct *v, int time, int var, const float data[] );
 
+
+extern int v5dSetBrickSize( v5dstruct *v, int rows, int cols, int levs );
+
   /* JPE added 09-19-2000  */
 extern int v5dCreateStruct( v5dstruct *v, int numtimes, int numvars,
 										int nr, int nc, const int nl[],
@@ -21,7 +21,7 @@ C 5-D grid limits, must match those in v5d.h!!!
       integer MAXVARS, MAXTIMES, MAXROWS, MAXCOLUMNS, MAXLEVELS
 
       parameter (MAXVARS=200)
-      parameter (MAXTIMES=1000)
+      parameter (MAXTIMES=10000)
       parameter (MAXROWS=1000)
       parameter (MAXCOLUMNS=1600)
       parameter (MAXLEVELS=600)
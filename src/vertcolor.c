@@ -0,0 +1,293 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+#include "../config.h"
+
+/* Color table indexes for the vertices of colored isosurfaces */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "grid.h"
+#include "memory.h"
+#include "parallel.h"
+#include "proj.h"
+#include "render.h"
+#include "vertcolor.h"
+
+
+
+#define MIN2( X, Y )        ( (X) < (Y) ? (X) : (Y) )
+#define MAX2( X, Y )        ( (X) > (Y) ? (X) : (Y) )
+
+
+/*
+ * The vertices are colored in blocks which idle worker threads may help
+ * with through run_parallel_job().  Within a block the
+ * vertices go through short batches: their grid coordinates are found
+ * with one geo_to_grid() call, then the color variable is sampled from a
+ * decompressed copy of its grid in two passes over plain arrays, one for
+ * the cell offsets and weights and one for the blend, which the compiler
+ * can vectorize.
+ */
+#define VERTCOLOR_BATCH      256     /* vertices per batch */
+#define VERTCOLOR_BLOCK      16384   /* min vertices per block */
+#define MAX_VERTCOLOR_BLOCKS 32
+
+/* Only decompress the whole grid if there are at least this many
+   vertices per grid point, else interpolate_grid_value() is cheaper */
+#define VERTCOLOR_SPARSE     (1.0/64.0)
+
+
+/* What the blocks of one color_vertices() call share */
+struct vertcolor_job {
+   Context cvctx;
+   int colorvar, time, cvctxtime;
+   float min, max, valscale;
+   const int_vert2 *verts;
+   uint_1 *colors;
+   int n;
+   const float *grid;             /* the color variable, or NULL */
+   int nr, nc, nl;
+   float lowlev;
+   int blocksize;
+   int numblocks;
+};
+
+
+
+/*
+ * Trilinear interpolation of the decompressed color variable grid at a
+ * batch of grid coordinates, giving the same values as
+ * interpolate_grid_value().
+ * Input:  job - the job with its grid
+ *         n - number of points, at most VERTCOLOR_BATCH
+ *         row, col, lev - the grid coordinates
+ * Output:  val - the values, MISSING outside the grid or next to
+ *                missing data
+ */
+static void sample_grid( const struct vertcolor_job *job, int n,
+                         const float row[], const float col[],
+                         const float lev[], float val[] )
+{
+   const float *g = job->grid;
+   int nr = job->nr, nc = job->nc, nl = job->nl;
+   int nrnc = nr * nc;
+   int off[VERTCOLOR_BATCH], di[VERTCOLOR_BATCH];
+   int dj[VERTCOLOR_BATCH], dk[VERTCOLOR_BATCH];
+   char inside[VERTCOLOR_BATCH];
+   float ei[VERTCOLOR_BATCH], ej[VERTCOLOR_BATCH], ek[VERTCOLOR_BATCH];
+   int i;
+
+   /* cell offsets and weights; points outside the grid are moved to
+      its first point so both passes stay branch free */
+   for (i=0;i<n;i++) {
+      float r = row[i], c = col[i], l = lev[i] - job->lowlev;
+      int i0, j0, k0, in;
+
+      in = r>=0.0f && r<nr && c>=0.0f && c<nc && l>=0.0f && l<nl;
+      r = in ? r : 0.0f;
+      c = in ? c : 0.0f;
+      l = in ? l : 0.0f;
+      i0 = (int) r;
+      j0 = (int) c;
+      k0 = (int) l;
+      ei[i] = r - (float) i0;
+      ej[i] = c - (float) j0;
+      ek[i] = l - (float) k0;
+      /* stay on the row, column or level at the grid's edge or when
+         exactly on it */
+      di[i] = (i0<nr-1 && ei[i]!=0.0f) ? 1 : 0;
+      dj[i] = (j0<nc-1 && ej[i]!=0.0f) ? nr : 0;
+      dk[i] = (k0<nl-1 && ek[i]!=0.0f) ? nrnc : 0;
+      off[i] = (k0 * nc + j0) * nr + i0;
+      inside[i] = in;
+   }
+
+   /* blend the corners */
+   for (i=0;i<n;i++) {
+      const float *p = g + off[i];
+      float d0 = p[0],             d1 = p[di[i]];
+      float d2 = p[dj[i]],         d3 = p[dj[i]+di[i]];
+      float d4 = p[dk[i]],         d5 = p[dk[i]+di[i]];
+      float d6 = p[dk[i]+dj[i]],   d7 = p[dk[i]+dj[i]+di[i]];
+      float a = ei[i], b = ej[i], c = ek[i];
+      float d;
+
+      d = ( d0 * (1.0f-a) * (1.0f-b)
+          + d1 * a        * (1.0f-b)
+          + d2 * (1.0f-a) * b
+          + d3 * a        * b        ) * (1.0f-c)
+        + ( d4 * (1.0f-a) * (1.0f-b)
+          + d5 * a        * (1.0f-b)
+          + d6 * (1.0f-a) * b
+          + d7 * a        * b        ) * c;
+
+      if (!inside[i] ||
+          IS_MISSING(d0) || IS_MISSING(d1) || IS_MISSING(d2) ||
+          IS_MISSING(d3) || IS_MISSING(d4) || IS_MISSING(d5) ||
+          IS_MISSING(d6) || IS_MISSING(d7)) {
+         d = MISSING;
+      }
+      val[i] = d;
+   }
+}
+
+
+
+/*
+ * Compute the color indexes of one block of vertices of a job, see
+ * run_parallel_job().
+ */
+static void color_block( void *data, int block )
+{
+   struct vertcolor_job *job = (struct vertcolor_job *) data;
+   Context cvctx = job->cvctx;
+   float lat[VERTCOLOR_BATCH], lon[VERTCOLOR_BATCH], hgt[VERTCOLOR_BATCH];
+   float row[VERTCOLOR_BATCH], col[VERTCOLOR_BATCH], lev[VERTCOLOR_BATCH];
+   float val[VERTCOLOR_BATCH];
+   float vscale = 1.0 / VERTEX_SCALE;
+   int v0, v1, v, m, i;
+
+   v0 = block * job->blocksize;
+   v1 = MIN2( v0 + job->blocksize, job->n );
+
+   for (v=v0; v<v1; v+=m) {
+      const int_vert2 *vert = job->verts + 3*v;
+      uint_1 *color = job->colors + v;
+
+      m = MIN2( v1 - v, VERTCOLOR_BATCH );
+
+      for (i=0;i<m;i++) {
+         xyzPRIME_to_geo( cvctx->dpy_ctx, job->time, job->colorvar,
+                          vert[3*i+0] * vscale, vert[3*i+1] * vscale,
+                          vert[3*i+2] * vscale, &lat[i], &lon[i], &hgt[i] );
+      }
+      geo_to_grid( cvctx, job->time, job->colorvar, m, lat, lon, hgt,
+                   row, col, lev );
+      if (cvctx->Nl[job->colorvar]==1) {
+         for (i=0;i<m;i++) {
+            lev[i] = 0.0;
+         }
+      }
+
+      if (job->grid) {
+         sample_grid( job, m, row, col, lev, val );
+      }
+      else {
+         for (i=0;i<m;i++) {
+            val[i] = interpolate_grid_value( cvctx, job->cvctxtime,
+                                             job->colorvar,
+                                             row[i], col[i], lev[i] );
+         }
+      }
+
+      for (i=0;i<m;i++) {
+         if (IS_MISSING(val[i]) || val[i] < job->min || val[i] > job->max) {
+            color[i] = 255;
+         }
+         else {
+            int index = (val[i] - job->min) * job->valscale;
+            color[i] = (index < 0) ? 0 : (index > 254) ? 254 : index;
+         }
+      }
+   }
+}
+
+
+
+/*
+ * Compute the color table indexes of an array of vertices, such as those
+ * of an isosurface, from a coloring variable.
+ * Input:  cvctx - the context of the coloring variable
+ *         colorvar - the coloring variable
+ *         min, max - value range mapped to indexes 0..254
+ *         time - display timestep, for the coordinate conversions
+ *         cvctxtime - timestep of the coloring variable
+ *         verts - array [n][3] of vertices
+ *         n - number of vertices
+ * Output:  colors - array [n] of color indexes, 255 for missing values
+ */
+void color_vertices( Context cvctx, int colorvar, float min, float max,
+                     int time, int cvctxtime, const int_vert2 *verts,
+                     uint_1 *colors, int n )
+{
+   struct vertcolor_job job;
+   PTRINT gridbytes;
+   float *grid;
+   int cvar;
+
+   if (n<=0) {
+      return;
+   }
+   if (!check_for_valid_time( cvctx, time )) {
+      memset( colors, 255, n );
+      return;
+   }
+
+   /* keep a decompressed copy of the coloring variable for the whole
+      job, unless the surface is small compared to the grid */
+   cvar = cvctx->Variable[colorvar]->CloneTable;
+   gridbytes = (PTRINT) cvctx->Nr * cvctx->Nc * cvctx->Nl[cvar] * sizeof(float);
+   grid = NULL;
+   if (n >= VERTCOLOR_SPARSE * cvctx->Nr * cvctx->Nc * cvctx->Nl[cvar] ||
+       V5D_STREAM_MODE(cvctx->CompressMode)) {
+      grid = (float *) allocate_type( cvctx, gridbytes, GRID_TYPE );
+      if (grid && !load_grid( cvctx, cvctxtime, colorvar, grid )) {
+         deallocate( cvctx, grid, gridbytes );
+         grid = NULL;
+      }
+   }
+
+   job.cvctx = cvctx;
+   job.colorvar = colorvar;
+   job.time = time;
+   job.cvctxtime = cvctxtime;
+   job.min = min;
+   job.max = max;
+   job.valscale = 254.0 / (max-min);
+   job.verts = verts;
+   job.colors = colors;
+   job.n = n;
+   job.grid = grid;
+   job.nr = cvctx->Nr;
+   job.nc = cvctx->Nc;
+   job.nl = cvctx->Nl[cvar];
+   job.lowlev = cvctx->Variable[colorvar]->LowLev;
+   job.numblocks = MAX2( 1, MIN2( n / VERTCOLOR_BLOCK, MAX_VERTCOLOR_BLOCKS ) );
+   job.blocksize = (n + job.numblocks - 1) / job.numblocks;
+
+   run_parallel_job( cvctx, color_block, &job, job.numblocks );
+
+   if (grid) {
+      deallocate( cvctx, grid, gridbytes );
+   }
+}
@@ -78,6 +78,9 @@
 #define	DEFAULT_MAXTMESH	-1	/* no max	*/
 #define	DEFAULT_VSTRIDE		4	
 
+/* Default size of the stored animation frame cache in megabytes: */
+#define DEFAULT_FRAMECACHE 256
+
 
 /* Default scale and exponent values for logrithmic vertical coordinate system: */
 #define DEFAULT_LOG_SCALE  1012.5
@@ -0,0 +1,764 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "../config.h"
+
+/* Wind vectors and barbs for the horizontal and vertical wind slices */
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "globals.h"
+#include "memory.h"
+#include "parallel.h"
+#include "proj.h"
+#include "windvec.h"
+
+
+
+#define MIN2( X, Y )        ( (X) < (Y) ? (X) : (Y) )
+#define MAX2( X, Y )        ( (X) > (Y) ? (X) : (Y) )
+
+
+/*
+ * The arrows of a slice are turned into line vertices in blocks which
+ * idle worker threads may help with through run_parallel_job().  Within
+ * a block the arrows go through short batches: the arrow heads are built
+ * in a loop over plain arrays with selects rather than branches, which
+ * the compiler can vectorize, and the vertices of the batch go back to
+ * grid coordinates with one xyzPRIME_to_gridPRIME_n() call.  Barbs are
+ * then drawn from the grid coordinates in order.
+ */
+#define WINDVEC_BATCH       256     /* arrows per batch */
+#define WINDVEC_BLOCK       16384   /* min arrows per block */
+#define MAX_WINDVEC_BLOCKS  32
+
+/* room kept for the vertices of one more vector, as the slices always did */
+#define WINDVEC_MARGIN      40
+
+#define BARB_INC 6.0
+
+#define CROSS( c, a, b )  { c[0] =  a[1]*b[2]-a[2]*b[1]; \
+                            c[1] = -a[0]*b[2]+a[2]*b[0]; \
+                            c[2] =  a[0]*b[1]-a[1]*b[0]; \
+                          }
+
+#define MAGNITUDE( a )    sqrt( a[0]*a[0] + a[1]*a[1] + a[2]*a[2] )
+
+#define SCALE_VEC( v, d )  {  v[0] = v[0] / (d); \
+                              v[1] = v[1] / (d); \
+                              v[2] = v[2] / (d); \
+                           }
+
+
+/* What the blocks of one make_wind_vectors() call share */
+struct windvec_job {
+   Context ctx;
+   int time, var;
+   const struct wind_arrows *arrows;
+   float scale;
+   float upy, upz;                /* up vector of the slice, y or z axis */
+   int nv;                        /* vertices per arrow, 4 or 2 for barbs */
+   float *r, *c, *l;              /* [nv*n] arrow vertices in grid coords */
+   float *len;                    /* [n] scaled arrow lengths */
+   int blocksize;
+   int numblocks;
+};
+
+
+
+/*
+ * Allocate the arrays of a set of wind points.
+ * Input:  pts - the points
+ *         max - max number of points
+ * Return:  1 = ok, 0 = out of memory
+ */
+int alloc_wind_points( struct wind_points *pts, int max )
+{
+   float *p;
+
+   p = (float *) malloc( 7L * (PTRINT) MAX2( max, 1 ) * sizeof(float) );
+   pts->n = 0;
+   pts->br = p;
+   if (!p) {
+      return 0;
+   }
+   pts->bc = pts->br + max;
+   pts->bl = pts->bc + max;
+   pts->tr = pts->bl + max;
+   pts->tc = pts->tr + max;
+   pts->tl = pts->tc + max;
+   pts->speed = pts->tl + max;
+   return 1;
+}
+
+
+
+void free_wind_points( struct wind_points *pts )
+{
+   free( pts->br );
+   pts->br = NULL;
+   pts->n = 0;
+}
+
+
+
+static PTRINT wind_arrows_bytes( int n )
+{
+   return (PTRINT) sizeof(struct wind_arrows) + 7L * (PTRINT) n * sizeof(float);
+}
+
+
+
+/*
+ * Make the arrows at scale 1.0 for a set of wind points.  Their length in
+ * graphics coordinates is proportional to the wind speed.
+ * Input:  ctx - the context of the winds
+ *         time - the context's timestep
+ *         displaytime - the display timestep
+ *         var - the U variable
+ *         prime - 0 = the points are in display grid coordinates,
+ *                 1 = they are in ctx's grid coordinates and the arrows
+ *                 are carried over to the display through lat/lon/hgt
+ *         pts - the points
+ *         type - memory type to allocate the arrows as
+ * Return:  the arrows, or NULL if out of memory
+ */
+struct wind_arrows *make_wind_arrows( Context ctx, int time,
+                                      int displaytime, int var, int prime,
+                                      const struct wind_points *pts,
+                                      int type )
+{
+   Display_Context dtx = ctx->dpy_ctx;
+   struct wind_arrows *ar;
+   float boxy = dtx->Xmax - dtx->Xmin;
+   int n = pts->n;
+   int i;
+
+   ar = (struct wind_arrows *) allocate_type( ctx, wind_arrows_bytes( n ),
+                                              type );
+   if (!ar) {
+      return NULL;
+   }
+   ar->n = n;
+   ar->x = (float *) (ar + 1);
+   ar->y = ar->x + n;
+   ar->z = ar->y + n;
+   ar->dx = ar->z + n;
+   ar->dy = ar->dx + n;
+   ar->dz = ar->dy + n;
+   ar->speed = ar->dz + n;
+   if (n==0) {
+      return ar;
+   }
+
+   if (prime) {
+      grid_to_xyz( ctx, time, var, n, pts->br, pts->bc, pts->bl,
+                   ar->x, ar->y, ar->z );
+      grid_to_xyz( ctx, time, var, n, pts->tr, pts->tc, pts->tl,
+                   ar->dx, ar->dy, ar->dz );
+   }
+   else {
+      gridPRIME_to_xyzPRIME( dtx, time, var, n, pts->br, pts->bc, pts->bl,
+                             ar->x, ar->y, ar->z );
+      gridPRIME_to_xyzPRIME( dtx, time, var, n, pts->tr, pts->tc, pts->tl,
+                             ar->dx, ar->dy, ar->dz );
+   }
+
+   /* make the arrow lengths proportional to the wind speed in graphics
+      space */
+   for (i=0;i<n;i++) {
+      float dx = ar->dx[i] - ar->x[i];
+      float dy = ar->dy[i] - ar->y[i];
+      float dz = ar->dz[i] - ar->z[i];
+      float newlen = sqrt( dx*dx + dy*dy + dz*dz );
+      float factor;
+
+      factor = pts->speed[i] / ((newlen > 0.0000001f) ? newlen : 0.0000001f);
+      factor = (factor / 25.0f) * (boxy * 0.03f);
+      ar->dx[i] = dx * factor;
+      ar->dy[i] = dy * factor;
+      ar->dz[i] = dz * factor;
+      ar->speed[i] = pts->speed[i];
+   }
+
+   if (prime) {
+      /* carry the base and a small step along each arrow over to the
+         display, then stretch the step to the arrow's length again */
+      float *lat, *lon, *hgt, *jx, *jy, *jz;
+
+      lat = (float *) malloc( 6L * 2L * (PTRINT) n * sizeof(float) );
+      if (!lat) {
+         deallocate( ctx, ar, wind_arrows_bytes( n ) );
+         return NULL;
+      }
+      lon = lat + 2*n;
+      hgt = lon + 2*n;
+      jx = hgt + 2*n;
+      jy = jx + 2*n;
+      jz = jy + 2*n;
+
+      for (i=0;i<n;i++) {
+         float len = sqrt( ar->dx[i]*ar->dx[i] + ar->dy[i]*ar->dy[i] +
+                           ar->dz[i]*ar->dz[i] );
+         float s = (len > 0.0f) ? 1.0f / (len*100) : 0.0f;
+
+         xyz_to_geo( ctx, time, var, ar->x[i], ar->y[i], ar->z[i],
+                     &lat[i], &lon[i], &hgt[i] );
+         xyz_to_geo( ctx, time, var, ar->x[i] + ar->dx[i]*s,
+                     ar->y[i] + ar->dy[i]*s, ar->z[i] + ar->dz[i]*s,
+                     &lat[n+i], &lon[n+i], &hgt[n+i] );
+         /* keep the length for below */
+         ar->dx[i] = len;
+      }
+      geo_to_xyzPRIME( dtx, displaytime, var, 2*n, lat, lon, hgt,
+                       jx, jy, jz );
+      for (i=0;i<n;i++) {
+         float len = ar->dx[i];
+
+         ar->x[i] = jx[i];
+         ar->y[i] = jy[i];
+         ar->z[i] = jz[i];
+         ar->dx[i] = 100*len*(jx[n+i] - jx[i]);
+         ar->dy[i] = 100*len*(jy[n+i] - jy[i]);
+         ar->dz[i] = 100*len*(jz[n+i] - jz[i]);
+      }
+      free( lat );
+   }
+
+   return ar;
+}
+
+
+
+/*
+ * Free the arrows of a wind slice.
+ * Return:  number of bytes freed
+ */
+int free_wind_arrows( Context ctx, struct wind_arrows *arrows )
+{
+   PTRINT bytes;
+
+   if (!arrows) {
+      return 0;
+   }
+   bytes = wind_arrows_bytes( arrows->n );
+   deallocate( ctx, arrows, bytes );
+   return (int) bytes;
+}
+
+
+
+/*
+ * Compute the grid coordinates of the vertices of one block of arrows:
+ * base, tip and the two ends of the head, or just base and tip for barbs.
+ * See run_parallel_job().
+ */
+static void arrow_block( void *data, int block )
+{
+   struct windvec_job *job = (struct windvec_job *) data;
+   Display_Context dtx = job->ctx->dpy_ctx;
+   const struct wind_arrows *ar = job->arrows;
+   float x[4*WINDVEC_BATCH], y[4*WINDVEC_BATCH], z[4*WINDVEC_BATCH];
+   float scale = job->scale, upy = job->upy, upz = job->upz;
+   int nv = job->nv;
+   int a0, a1, a, m, i;
+
+   a0 = block * job->blocksize;
+   a1 = MIN2( a0 + job->blocksize, ar->n );
+
+   for (a=a0; a<a1; a+=m) {
+      const float *bx = ar->x + a, *by = ar->y + a, *bz = ar->z + a;
+      const float *dx = ar->dx + a, *dy = ar->dy + a, *dz = ar->dz + a;
+      float *len = job->len + a;
+
+      m = MIN2( a1 - a, WINDVEC_BATCH );
+
+      for (i=0;i<m;i++) {
+         float ux = dx[i] * scale, uy = dy[i] * scale, uz = dz[i] * scale;
+
+         len[i] = sqrt( ux*ux + uy*uy + uz*uz );
+         x[nv*i] = bx[i];
+         y[nv*i] = by[i];
+         z[nv*i] = bz[i];
+         x[nv*i+1] = bx[i] + ux;
+         y[nv*i+1] = by[i] + uy;
+         z[nv*i+1] = bz[i] + uz;
+      }
+
+      if (nv==4) {
+         /* create arrow head in graphics space too, this gets rid of
+            demented arrow head sizes when ratio of row, cols, levs is
+            wacky.  The head lies across the up vector, or across the
+            x axis if the arrow points mostly up or down. */
+         for (i=0;i<m;i++) {
+            float ux = dx[i] * scale, uy = dy[i] * scale, uz = dz[i] * scale;
+            float l = len[i];
+            float side = uy*upy + uz*upz;
+            int flip = side > 0.5f*l || side < -0.5f*l;
+            float vx = flip ? 1.0f : 0.0f;
+            float vy = flip ? 0.0f : upy;
+            float vz = flip ? 0.0f : upz;
+            float ax = uy*vz - uz*vy;
+            float ay = uz*vx - ux*vz;
+            float az = ux*vy - uy*vx;
+            float alen = sqrt( ax*ax + ay*ay + az*az );
+            float s = (alen * l * 0.1f != 0.0f) ? l * 0.1f / alen : 0.0f;
+            float px = x[4*i+1] - ux * 0.2f;
+            float py = y[4*i+1] - uy * 0.2f;
+            float pz = z[4*i+1] - uz * 0.2f;
+
+            x[4*i+2] = px + ax*s;
+            y[4*i+2] = py + ay*s;
+            z[4*i+2] = pz + az*s;
+            x[4*i+3] = px - ax*s;
+            y[4*i+3] = py - ay*s;
+            z[4*i+3] = pz - az*s;
+         }
+      }
+
+      xyzPRIME_to_gridPRIME_n( dtx, job->time, job->var, nv*m, x, y, z,
+                               job->r + nv*a, job->c + nv*a, job->l + nv*a );
+   }
+}
+
+
+
+/*
+ * Return the sign which puts the barb fletches on the side of the shaft
+ * used in the hemisphere of the middle of the display.
+ */
+static float barb_sign( Display_Context dtx )
+{
+   float lat, lon;
+
+   if (dtx->Projection == PROJ_GENERIC) {
+      return -1.0;
+   }
+   rowcolPRIME_to_latlon( dtx, -1, -1, (float) dtx->Nr / 2.0,
+                          (float) dtx->Nc / 2.0, &lat, &lon );
+   return (lat >= 0.0) ? -1.0 : 1.0;
+}
+
+
+
+/*
+ * Return how many vertices make_barb() makes for a wind speed.
+ */
+static int barb_verts( float kts )
+{
+   int ikts, ntri;
+
+   if (kts < 1.0) {
+      return 6;
+   }
+   ikts = (int) kts + 2;
+   ntri = ikts / 50;
+   ikts = ikts % 50;
+   return 2 + 6*ntri + (ntri>0 ? 2 : 0) + 2*(ikts/10) + 2*((ikts%10)/5);
+}
+
+
+
+/* MJK 12.04.98 begin */
+static int get_cross_vec (float *res, float *dir, float *up)
+{
+
+    float       fudge[3];
+
+
+    CROSS (res, dir, up);
+
+    if (MAGNITUDE (res) != 0.0) return 1;
+
+/*
+ *  We get to this point if the wind vector is perpendicular to the slice
+ *  plane.  Although not common, this _can_ happen -- especially if one of
+ *  the wind components (probably W) is missing.  This hunk of code is a
+ *  bit of a kludge.
+ */
+
+    if (dir[0] != 0.0)
+    {
+        fudge[0] = dir[0] * 0.99999;
+        fudge[1] = sqrt ((dir[0] * dir[0]) - (fudge[0] * fudge[0]));
+        fudge[2] = 0.0;
+    }
+    else if (dir[1] != 0.0)
+    {
+        fudge[1] = dir[1] * 0.99999;
+        fudge[0] = sqrt ((dir[1] * dir[1]) - (fudge[1] * fudge[1]));
+        fudge[2] = 0.0;
+    }
+    else
+    {
+        fudge[2] = dir[2] * 0.99999;
+        fudge[1] = sqrt ((dir[2] * dir[2]) - (fudge[2] * fudge[2]));
+        fudge[0] = 0.0;
+    }
+
+    CROSS (res, fudge, up);
+
+
+    return 0;
+}
+/* MJK 12.04.98 end */
+/*
+ * Draw a wind barb as disjoint line segments.
+ * Input:  sign - see barb_sign()
+ *         kts - wind speed in knots
+ *         dir - direction of the barb's shaft in grid coords
+ *         up - up vector in grid coords
+ *         row, col, level - base of the barb in grid coords
+ *         size - length of the shaft in grid boxes
+ *         vr, vc, vl - arrays to put the vertices in, at *vco
+ * Output:  vco - incremented by the number of vertices added
+ */
+static void make_barb( float sign, float kts, float *dir, float *up,
+                       float row, float col, float level, float size,
+                       float *vr, float *vc, float *vl, int *vco )
+{
+  float a[3];
+  float len, alen;
+  float tr, tc, tl;
+  int i, ikts, ntri, nlong, nshort;
+  int vcount;
+
+  vcount = *vco;
+
+  if (kts < 1.0) {
+    /* make a cross for calm */
+
+    vr[vcount] = row + size / BARB_INC;
+    vc[vcount] = col;
+    vl[vcount] = level;
+    vcount++;
+
+    vr[vcount] = row - size / BARB_INC;
+    vc[vcount] = col;
+    vl[vcount] = level;
+    vcount++;
+
+    vr[vcount] = row;
+    vc[vcount] = col + size / BARB_INC;
+    vl[vcount] = level;
+    vcount++;
+
+    vr[vcount] = row;
+    vc[vcount] = col - size / BARB_INC;
+    vl[vcount] = level;
+    vcount++;
+
+    vr[vcount] = row;
+    vc[vcount] = col;
+    vl[vcount] = level + size / BARB_INC;
+    vcount++;
+
+    vr[vcount] = row;
+    vc[vcount] = col;
+    vl[vcount] = level - size / BARB_INC;
+    vcount++;
+
+  }
+  else {
+    len = MAGNITUDE( dir );
+    SCALE_VEC( dir, len / size );
+
+    /* make the base line */
+    vr[vcount] = row;
+    vc[vcount] = col;
+    vl[vcount] = level;
+    vcount++;
+    vr[vcount] = tr = row - dir[0];
+    vc[vcount] = tc = col - dir[1];
+    vl[vcount] = tl = level - dir[2];
+    vcount++;
+
+    /* MJK 12.04.98 */
+    get_cross_vec (a, dir, up);
+
+
+
+    alen = sign * BARB_INC * MAGNITUDE( a ) / size;
+    a[0] = a[0] / alen;
+    a[1] = a[1] / alen;
+    a[2] = a[2] / alen;
+
+    SCALE_VEC( dir, BARB_INC );
+    tr -= dir[0];
+    tc -= dir[1];
+    tl -= dir[2];
+
+    /* compute numbers of triangles, long & short fletches */
+    ikts = (int) kts + 2;
+    ntri = ikts / 50;
+    ikts = ikts % 50;
+    nlong = ikts / 10;
+    ikts = ikts % 10;
+    nshort = ikts / 5;
+
+    for (i=0; i<ntri; i++) {
+      /* riser */
+      vr[vcount] = tr;
+      vc[vcount] = tc;
+      vl[vcount] = tl;
+      vcount++;
+
+      vr[vcount] = tr + a[0];
+      vc[vcount] = tc + a[1];
+      vl[vcount] = tl + a[2];
+      vcount++;
+
+      /* cross piece inside triangle */
+      vr[vcount] = tr;
+      vc[vcount] = tc;
+      vl[vcount] = tl;
+      vcount++;
+
+      vr[vcount] = tr + 0.5 * (dir[0] + a[0]);
+      vc[vcount] = tc + 0.5 * (dir[1] + a[1]);
+      vl[vcount] = tl + 0.5 * (dir[2] + a[2]);
+      vcount++;
+
+      /* hypotenuse */
+      vr[vcount] = tr + a[0];
+      vc[vcount] = tc + a[1];
+      vl[vcount] = tl + a[2];
+      vcount++;
+
+      tr += dir[0];
+      tc += dir[1];
+      tl += dir[2];
+
+      vr[vcount] = tr;
+      vc[vcount] = tc;
+      vl[vcount] = tl;
+      vcount++;
+
+      /* extend base line for first triangle */
+      if (i == 0) {
+        vr[vcount] = tr;
+        vc[vcount] = tc;
+        vl[vcount] = tl;
+        vcount++;
+
+        vr[vcount] = tr - dir[0];
+        vc[vcount] = tc - dir[1];
+        vl[vcount] = tl - dir[2];
+        vcount++;
+      }
+    }
+
+    for (i=0; i<nlong; i++) {
+      vr[vcount] = tr + a[0];
+      vc[vcount] = tc + a[1];
+      vl[vcount] = tl + a[2];
+      vcount++;
+
+      tr += dir[0];
+      tc += dir[1];
+      tl += dir[2];
+
+      vr[vcount] = tr;
+      vc[vcount] = tc;
+      vl[vcount] = tl;
+      vcount++;
+    }
+
+    for (i=0; i<nshort; i++) {
+      vr[vcount] = tr + 0.5 * (dir[0] + a[0]);
+      vc[vcount] = tc + 0.5 * (dir[1] + a[1]);
+      vl[vcount] = tl + 0.5 * (dir[2] + a[2]);
+      vcount++;
+
+      tr += dir[0];
+      tc += dir[1];
+      tl += dir[2];
+
+      vr[vcount] = tr;
+      vc[vcount] = tc;
+      vl[vcount] = tl;
+      vcount++;
+    }
+
+  }
+
+  *vco = vcount;
+}
+
+
+
+/*
+ * Make the line vertices of a wind slice from its arrows: four for each
+ * arrow's shaft and head, six on surface slices where the head's two
+ * segments are disjoint lines too, or the segments of the barbs.
+ * Input:  ctx - the context of the winds
+ *         time - the context's timestep
+ *         var - the U variable
+ *         arrows - the slice's arrows at scale 1.0
+ *         scale - user scaling factor  (1.0 is typical)
+ *         vertical - 0 = horizontal slice, 1 = vertical slice
+ *         barbs - 1 = make barbs rather than arrows
+ *         barbsize - length of a barb's shaft in grid boxes
+ *         sfc - 1 = the vertices will be fitted to the topography, so
+ *               leave room for MAX_WIND_VERTS of them
+ * Output:  vr, vc, vl - malloc'd arrays of vertices in grid coords
+ * Return:  number of vertices, or -1 if out of memory
+ */
+int make_wind_vectors( Context ctx, int time, int var,
+                       const struct wind_arrows *arrows, float scale,
+                       int vertical, int barbs, float barbsize, int sfc,
+                       float **vr, float **vc, float **vl )
+{
+   struct windvec_job job;
+   int n = arrows->n;
+   float *r, *c, *l, *len;
+   float *outr, *outc, *outl;
+   PTRINT max;
+   int i, k, vcount;
+
+   *vr = *vc = *vl = NULL;
+   if (n==0) {
+      return 0;
+   }
+
+   job.ctx = ctx;
+   job.time = time;
+   job.var = var;
+   job.arrows = arrows;
+   job.scale = scale;
+   job.upy = vertical ? 1.0 : 0.0;
+   job.upz = vertical ? 0.0 : 1.0;
+   job.nv = barbs ? 2 : 4;
+   job.r = r = (float *) malloc( (PTRINT) job.nv * n * sizeof(float) );
+   job.c = c = (float *) malloc( (PTRINT) job.nv * n * sizeof(float) );
+   job.l = l = (float *) malloc( (PTRINT) job.nv * n * sizeof(float) );
+   job.len = len = (float *) malloc( (PTRINT) n * sizeof(float) );
+   if (!r || !c || !l || !len) {
+      free( r );
+      free( c );
+      free( l );
+      free( len );
+      return -1;
+   }
+   job.numblocks = MAX2( 1, MIN2( n / WINDVEC_BLOCK, MAX_WINDVEC_BLOCKS ) );
+   job.blocksize = (n + job.numblocks - 1) / job.numblocks;
+
+   run_parallel_job( ctx, arrow_block, &job, job.numblocks );
+
+   if (!barbs && !sfc) {
+      /* drop the arrows too short to see, in place */
+      vcount = 0;
+      for (i=0; i<n && vcount+WINDVEC_MARGIN<MAX_WIND_VERTS; i++) {
+         if (len[i]>=0.001) {
+            for (k=0;k<4;k++) {
+               r[vcount+k] = r[4*i+k];
+               c[vcount+k] = c[4*i+k];
+               l[vcount+k] = l[4*i+k];
+            }
+            vcount += 4;
+         }
+      }
+      free( len );
+      *vr = r;
+      *vc = c;
+      *vl = l;
+      return vcount;
+   }
+
+   if (sfc) {
+      max = MAX_WIND_VERTS;
+   }
+   else {
+      max = 0;
+      for (i=0;i<n;i++) {
+         max += barb_verts( arrows->speed[i] * (3600.0 / 1853.248) );
+      }
+      max = MIN2( max, MAX_WIND_VERTS );
+   }
+   outr = (float *) malloc( max * sizeof(float) );
+   outc = (float *) malloc( max * sizeof(float) );
+   outl = (float *) malloc( max * sizeof(float) );
+   if (!outr || !outc || !outl) {
+      free( outr );
+      free( outc );
+      free( outl );
+      free( r );
+      free( c );
+      free( l );
+      free( len );
+      return -1;
+   }
+
+   vcount = 0;
+   if (barbs) {
+      float sign = barb_sign( ctx->dpy_ctx );
+      float up[3];
+
+      up[0] = 0.0;
+      up[1] = vertical ? 1.0 : 0.0;
+      up[2] = vertical ? 0.0 : 1.0;
+      for (i=0; i<n && vcount+WINDVEC_MARGIN<MAX_WIND_VERTS; i++) {
+         float kts = arrows->speed[i] * (3600.0 / 1853.248);
+         float dir[3];
+
+         if (vcount + barb_verts( kts ) > max) {
+            break;
+         }
+         dir[0] = r[2*i+1] - r[2*i];
+         dir[1] = c[2*i+1] - c[2*i];
+         dir[2] = l[2*i+1] - l[2*i];
+         make_barb( sign, kts, dir, up, r[2*i], c[2*i], l[2*i], barbsize,
+                    outr, outc, outl, &vcount );
+      }
+   }
+   else {
+      for (i=0; i<n && vcount+WINDVEC_MARGIN<MAX_WIND_VERTS; i++) {
+         if (len[i]>=0.001) {
+            static const int seg[6] = { 0, 1, 1, 2, 1, 3 };
+
+            for (k=0;k<6;k++) {
+               outr[vcount+k] = r[4*i+seg[k]];
+               outc[vcount+k] = c[4*i+seg[k]];
+               outl[vcount+k] = l[4*i+seg[k]];
+            }
+            vcount += 6;
+         }
+      }
+   }
+
+   free( r );
+   free( c );
+   free( l );
+   free( len );
+   *vr = outr;
+   *vc = outc;
+   *vl = outl;
+   return vcount;
+}
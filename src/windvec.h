@@ -0,0 +1,79 @@
+/*
+ * Vis5D system for visualizing five dimensional gridded data sets.
+ * Copyright (C) 1990 - 2000 Bill Hibbard, Johan Kellum, Brian Paul,
+ * Dave Santek, and Andre Battaiola.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * As a special exception to the terms of the GNU General Public
+ * License, you are permitted to link Vis5D with (and distribute the
+ * resulting source and executables) the LUI library (copyright by
+ * Stellar Computer Inc. and licensed for distribution with Vis5D),
+ * the McIDAS library, and/or the NetCDF library, where those
+ * libraries are governed by the terms of their own licenses.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+#ifndef WINDVEC_H
+#define WINDVEC_H
+
+
+#include "globals.h"
+
+
+/*
+ * The arrows of a wind slice before the user's scale is applied, in
+ * display graphics coordinates.  A slice keeps them so that a new scale,
+ * or switching between arrows and barbs, doesn't need the winds again.
+ */
+struct wind_arrows {
+   int n;                   /* number of arrows */
+   float *x, *y, *z;        /* bases */
+   float *dx, *dy, *dz;     /* arrows at scale 1.0 */
+   float *speed;            /* wind speed, for barbs */
+};
+
+
+/* Wind vectors taken from a slice, in grid coordinates */
+struct wind_points {
+   int n;                   /* number of vectors */
+   float *br, *bc, *bl;     /* bases */
+   float *tr, *tc, *tl;     /* tips, base + (v,u,w) in grid boxes */
+   float *speed;            /* wind speed */
+};
+
+
+extern int alloc_wind_points( struct wind_points *pts, int max );
+
+extern void free_wind_points( struct wind_points *pts );
+
+
+extern struct wind_arrows *make_wind_arrows( Context ctx, int time,
+                                             int displaytime, int var,
+                                             int prime,
+                                             const struct wind_points *pts,
+                                             int type );
+
+extern int free_wind_arrows( Context ctx, struct wind_arrows *arrows );
+
+
+extern int make_wind_vectors( Context ctx, int time, int var,
+                              const struct wind_arrows *arrows, float scale,
+                              int vertical, int barbs, float barbsize,
+                              int sfc, float **vr, float **vc, float **vl );
+
+
+#endif
@@ -53,8 +53,11 @@
 #include "graphics.h"
 #include "grid.h"
 #include "imemory.h"
+#include "isolod.h"
+#include "isomesh.h"
 #include "memory.h"
 #include "misc.h"
+#include "parallel.h"
 #include "proj.h"
 #include "queue.h"
 #include "record.h"
@@ -64,7 +67,10 @@
 #include "textplot.h"
 #include "topo.h"
 #include "traj.h"
+#include "trajset.h"
+#include "vertcolor.h"
 #include "vtmcP.h"
+#include "windvec.h"
 #include "work.h"
 
 /* MJK 12.04.98 */
@@ -79,59 +85,6 @@
 
 
 
-static	void compute_iso_colors(
-	Context	ctx,
-	Context	cvctx,
-	int colorvar,
-	float min,
-	float max,
-	int	time,
-	int	cvctxtime,
-	int_vert2	*verts,
-	uint_1	*color_indexes,
-	int	n) 
-{
-	int	i;
-	float valscale;
-	float	vscale = 1.0 / VERTEX_SCALE;
-
-	valscale = 254.0 / (max-min);
-
-	if (!check_for_valid_time(cvctx, time)){
-	  for (i=0;i<n;i++) {
-		 color_indexes[i] = 255;
-	  }
-	}
-	else{
-	  /* Compute color indexes */
-	  for (i=0;i<n;i++) {
-		 float x, y, z;
-		 float row, col, lev;
-		 float val;
-
-		 x = verts[i*3+0] * vscale;
-		 y = verts[i*3+1] * vscale;
-		 z = verts[i*3+2] * vscale;
-
-		 xyzPRIME_to_grid( cvctx, time, colorvar, x, y, z, &row, &col, &lev );
-               
-		 if (cvctx->Nl[colorvar]==1) {
-			lev = 0.0;
-		 }
-		 val = interpolate_grid_value( cvctx, cvctxtime, colorvar, row, col, lev );
-		 if (IS_MISSING(val) || val < min || val > max) {
-			color_indexes[i] = 255;
-		 }
-		 else {
-			int index = (val - min) * valscale;
-			color_indexes[i] = (index < 0) ? 0 : (index > 254) ? 254 : index;
-		 }
-	  }
-	}
-	
-}
-
-
 /*
  * Compute the color table indexes for a colored isosurface.
  * Input:  ctx - the context
@@ -162,67 +115,103 @@ static void color_isosurface( Context ctx,int_vert2 *verts ,int time, int isovar
       /* time = ctx time */
       cvctxtime = time;
    }
-   /* Free old color indexes if any */
-   wait_write_lock( &ctx->Variable[isovar]->SurfTable[time]->lock );
-   if (ctx->Variable[isovar]->SurfTable[time]->colors) {
-      deallocate( ctx, ctx->Variable[isovar]->SurfTable[time]->colors,
-                  ctx->Variable[isovar]->SurfTable[time]->numverts*sizeof(uint_1) );
-      ctx->Variable[isovar]->SurfTable[time]->colors = NULL;
-   }
-   if (ctx->Variable[isovar]->SurfTable[time]->deci_colors) {
-	  deallocate( ctx, ctx->Variable[isovar]->SurfTable[time]->deci_colors,
-					  ctx->Variable[isovar]->SurfTable[time]->numverts*sizeof(uint_1) );
-	  ctx->Variable[isovar]->SurfTable[time]->deci_colors = NULL;
-   }
-  
-   done_write_lock( &ctx->Variable[isovar]->SurfTable[time]->lock );
 
+   color_indexes = NULL;
+   deci_color_indexes = NULL;
    if (colorvar!=-1) {
       /* Allocate storage for new color indexes */
       n = ctx->Variable[isovar]->SurfTable[time]->numverts;
-      color_indexes = allocate( ctx, n*sizeof(uint_1) );
+      color_indexes = allocate_type( ctx, n*sizeof(uint_1), COLORINDEX_TYPE );
       if (!color_indexes) {
          return;
       }
 
-		compute_iso_colors(ctx, cvctx, colorvar, cvctx->Variable[colorvar]->MinVal, 
-								 cvctx->Variable[colorvar]->MaxVal, time, cvctxtime,
-								 ctx->Variable[isovar]->SurfTable[time]->verts,
-								 color_indexes, n);
+      color_vertices( cvctx, colorvar, cvctx->Variable[colorvar]->MinVal,
+                      cvctx->Variable[colorvar]->MaxVal, time, cvctxtime,
+                      ctx->Variable[isovar]->SurfTable[time]->verts,
+                      color_indexes, n );
 
       if (ctx->Variable[isovar]->SurfTable[time]->deci_verts) {
-		  /* Allocate storage for new color indexes */
-		  n = ctx->Variable[isovar]->SurfTable[time]->deci_numverts;
-		  deci_color_indexes = allocate( ctx, n*sizeof(uint_1) );
-		  if (!deci_color_indexes) {
-			 return;
-		  }
-
-        compute_iso_colors(ctx, cvctx,  colorvar, cvctx->Variable[colorvar]->MinVal, 
-									cvctx->Variable[colorvar]->MaxVal,time, cvctxtime,
-									ctx->Variable[isovar]->SurfTable[time]->deci_verts,
-									deci_color_indexes, n);
-
+         /* Allocate storage for new color indexes */
+         n = ctx->Variable[isovar]->SurfTable[time]->deci_numverts;
+         deci_color_indexes = allocate_type( ctx, n*sizeof(uint_1), COLORINDEX_TYPE );
+         if (deci_color_indexes) {
+            color_vertices( cvctx, colorvar, cvctx->Variable[colorvar]->MinVal,
+                            cvctx->Variable[colorvar]->MaxVal, time, cvctxtime,
+                            ctx->Variable[isovar]->SurfTable[time]->deci_verts,
+                            deci_color_indexes, n );
+         }
       }
-
-   }
-   else {
-	  color_indexes = NULL;
-	  deci_color_indexes = NULL;
    }
 
-   /* save results */
+   /* replace the old color indexes, which are drawn until now */
    wait_write_lock( &ctx->Variable[isovar]->SurfTable[time]->lock );
+   if (ctx->Variable[isovar]->SurfTable[time]->colors) {
+      deallocate( ctx, ctx->Variable[isovar]->SurfTable[time]->colors,
+                  ctx->Variable[isovar]->SurfTable[time]->numverts*sizeof(uint_1) );
+      ctx->Variable[isovar]->SurfTable[time]->colors = NULL;
+   }
+   if (ctx->Variable[isovar]->SurfTable[time]->deci_colors) {
+	  deallocate( ctx, ctx->Variable[isovar]->SurfTable[time]->deci_colors,
+					  ctx->Variable[isovar]->SurfTable[time]->deci_numverts*sizeof(uint_1) );
+	  ctx->Variable[isovar]->SurfTable[time]->deci_colors = NULL;
+   }
    ctx->Variable[isovar]->SurfTable[time]->colors = color_indexes;
    ctx->Variable[isovar]->SurfTable[time]->deci_colors = deci_color_indexes;
    ctx->Variable[isovar]->SurfTable[time]->colorvar = colorvar;
    ctx->Variable[isovar]->SurfTable[time]->cvowner = cvowner;
+   color_iso_lods( ctx, ctx->Variable[isovar]->SurfTable[time] );
    done_write_lock( &ctx->Variable[isovar]->SurfTable[time]->lock );
 
 }
 
 
 
+/*
+ * Make the simplified levels of detail of a new isosurface.  The full
+ * surface is read under a read lock so it can be drawn meanwhile; the
+ * levels are only stored if the surface wasn't replaced in the meantime,
+ * which its generation tells since a new one may reuse the old memory.
+ * Input:  ctx - the context
+ *         time, var - which isosurface
+ * Return:  1 if levels of detail were stored, 0 otherwise
+ */
+static int calc_isosurface_lods( Context ctx, int time, int var )
+{
+   struct isosurface *surf = ctx->Variable[var]->SurfTable[time];
+   struct iso_lod lod[MAX_ISO_LODS];
+   int generation, numlods;
+
+   wait_read_lock( &surf->lock );
+   generation = surf->generation;
+   numlods = 0;
+   if (surf->valid && surf->numlods==0) {
+      numlods = make_iso_lods( ctx, surf, lod );
+   }
+   done_read_lock( &surf->lock );
+   if (numlods==0) {
+      return 0;
+   }
+
+   wait_write_lock( &surf->lock );
+   if (surf->valid && surf->generation==generation && surf->numlods==0) {
+      memcpy( surf->lod, lod, numlods * sizeof(struct iso_lod) );
+      surf->numlods = numlods;
+      color_iso_lods( ctx, surf );
+      numlods = 0;
+   }
+   done_write_lock( &surf->lock );
+
+   /* free them if the surface changed meanwhile */
+   if (numlods) {
+      free_iso_lods( ctx, numlods, lod );
+      return 0;
+   }
+   return 1;
+}
+
+
+
 /*
  * Calculate an isosurface and store it.
  * Input:  time - the time step.
@@ -248,10 +237,13 @@ static void calc_isosurface( Context ctx, int time, int var,
    int_vert2 *cverts;
    int_1 *cnorms;
    Display_Context dtx;
-   uint_index *index;
-	int			deci_numverts;
-	int_vert2		*deci_cverts;
-	int_1			*deci_cnorms;
+   uint_2 *index;
+   struct iso_chunk *chunks;
+   int *vorder, nv, ni, numchunks;
+	int			deci_numverts = 0;
+	int_vert2		*deci_cverts = NULL;
+	int_1			*deci_cnorms = NULL;
+   int newsurf = 0;
 
    dtx = ctx->dpy_ctx;
    if (ctx->SameIsoColorVarOwner[var]){ 
@@ -332,7 +324,7 @@ static void calc_isosurface( Context ctx, int time, int var,
       /*************************** Compress data ***************************/
 
       if (numverts>0 && numindexes>0) {
-         PTRINT vbytes, nbytes, bytes;
+         PTRINT vbytes, nbytes;
 
 #ifdef HAVE_MIXKIT
 
@@ -436,21 +428,31 @@ static void calc_isosurface( Context ctx, int time, int var,
 	  project_normalsPRIME( dtx, numverts, vr2, vc2, vl2, nx,ny,nz, (void*) cnorms );
 	}
 	
-	/* allocate memory to store index array */
-	bytes = (PTRINT)numindexes * (PTRINT)sizeof(uint_index);
-	index = (uint_index *) allocate_type( ctx, bytes, PTS_TYPE );
-	memcpy( index, vpts, numindexes * sizeof(uint_index) );
-#ifndef BIG_GFX
-	/* convert 4-byte vpts[] elements to 2-byte index[] elements */
-	for (i=0;i<numindexes;i++)
-	  index[i] = (uint_index) vpts[i];
-#endif
+	/* cut the strip into chunks with 2-byte indexes */
+	if (!cverts || !cnorms ||
+	    !make_iso_chunks( ctx, numverts, numindexes, vpts, &vorder, &nv,
+	                      &index, &ni, &chunks, &numchunks ) ||
+	    !reorder_iso_verts( ctx, numverts, nv, vorder, &cverts, &cnorms, NULL )) {
+	  if (cverts) deallocate( ctx, cverts, vbytes );
+	  if (cnorms) deallocate( ctx, cnorms, nbytes );
+	  free_iso_chunks( ctx, ni, index, numchunks, chunks );
+	  cverts = NULL;
+	  cnorms = NULL;
+	  index = NULL;
+	  chunks = NULL;
+	  nv = ni = numchunks = 0;
+	}
+	free( vorder );
+	numverts = nv;
+	numindexes = ni;
 
       }
       else {
          cverts = NULL;
          cnorms = NULL;
          index = NULL;
+         chunks = NULL;
+         numchunks = 0;
          numverts = numindexes = 0;
 			deci_cverts = NULL;
 			deci_cnorms = NULL;
@@ -470,7 +472,10 @@ static void calc_isosurface( Context ctx, int time, int var,
       ctx->Variable[var]->SurfTable[time]->norms = cnorms;
       ctx->Variable[var]->SurfTable[time]->numindex = numindexes;
       ctx->Variable[var]->SurfTable[time]->index = index;
+      ctx->Variable[var]->SurfTable[time]->numchunks = numchunks;
+      ctx->Variable[var]->SurfTable[time]->chunks = chunks;
       ctx->Variable[var]->SurfTable[time]->valid = 1;
+      newsurf = numindexes>0;
 
 		ctx->Variable[var]->SurfTable[time]->deci_numverts = deci_numverts;
 		ctx->Variable[var]->SurfTable[time]->deci_verts = deci_cverts;
@@ -504,6 +509,13 @@ static void calc_isosurface( Context ctx, int time, int var,
       (!ctx->SameIsoColorVarOwner[var] && time==ctx->dpy_ctx->CurTime)){
       ctx->dpy_ctx->Redraw = 1;
    }
+
+   /* the full surface can be drawn now, simplify it for faster drawing */
+   if (newsurf && calc_isosurface_lods( ctx, time, var ) &&
+       ((ctx->SameIsoColorVarOwner[var] && time==ctx->CurTime) ||
+        (!ctx->SameIsoColorVarOwner[var] && time==ctx->dpy_ctx->CurTime))){
+      ctx->dpy_ctx->Redraw = 1;
+   }
 }
 
 /* MJK 12.04.98 begin */
@@ -583,9 +595,9 @@ static int fit_vecs_to_topo (Context ctx, int num, int max,
 
     if (n_out > 0)
     {
-        memcpy (vr, vr_out, n_bytes);
-        memcpy (vc, vc_out, n_bytes);
-        memcpy (vl, vl_out, n_bytes);
+        memcpy (vr, vr_out, (PTRINT)n_out * sizeof (float));
+        memcpy (vc, vc_out, (PTRINT)n_out * sizeof (float));
+        memcpy (vl, vl_out, (PTRINT)n_out * sizeof (float));
     }
 
     deallocate (ctx, vr_out, -1);
@@ -1995,6 +2007,275 @@ static void calc_textplot( Irregular_Context itx, int time, int threadnum )
 #endif /* HAVE_LIBNETCDF */
 
 
+/*** hslice cache *****************************************************
+   The planes extracted by extract_hslice() and the contour lines made
+   from them are cached per (time, var, level), see struct
+   hslice_cache_rec.  An entry is valid while ctx->GridGeneration is
+   unchanged.  Callers read the generation before reading the grid and
+   pass it in, so data read across a change is never stored as current.
+   Memory is only allocated and freed outside of
+   HSliceCacheLock; contour() and get_grid() are never called with it
+   held.
+**********************************************************************/
+
+/* Find the entry for a plane, or -1.  Call with HSliceCacheLock held. */
+static int find_hslice_cache( Context ctx, int time, int var, float level )
+{
+   int i;
+
+   for (i=0;i<HSLICE_CACHE_SIZE;i++) {
+      struct hslice_cache_rec *e = &ctx->HSliceCache[i];
+      if (e->Timestep==time && e->Var==var && e->Level==level
+          && e->Generation==ctx->GridGeneration) {
+         e->Age = ctx->HSliceCacheClock++;
+         return i;
+      }
+   }
+   return -1;
+}
+
+
+/*
+ * Return a copy of a cached plane in the layout extract_hslice() would
+ * give, or NULL if it is not cached.
+ * Output:  generation - the grid generation of the plane.
+ */
+static float *get_cached_hslice( Context ctx, int time, int var,
+                                 float level, int colmajor, int *generation )
+{
+   Display_Context dtx = ctx->dpy_ctx;
+   int nr = dtx->Nr, nc = dtx->Nc;
+   float *slice;
+   int e;
+
+   slice = (float *) allocate_type( ctx, (PTRINT)nr * (PTRINT)nc * (PTRINT)sizeof(float),
+                                    HSLICE_TYPE );
+   if (!slice) {
+      return NULL;
+   }
+
+   LOCK_ON( ctx->HSliceCacheLock );
+   e = find_hslice_cache( ctx, time, var, level );
+   if (e>=0) {
+      float *data = ctx->HSliceCache[e].Data;
+      *generation = ctx->HSliceCache[e].Generation;
+      if (colmajor) {
+         memcpy( slice, data, (PTRINT)nr * (PTRINT)nc * sizeof(float) );
+      }
+      else {
+         int i, j;
+         for (i=0; i<nr; i++) {
+            for (j=0; j<nc; j++) {
+               slice[i*nc+j] = data[j*nr+i];
+            }
+         }
+      }
+   }
+   LOCK_OFF( ctx->HSliceCacheLock );
+
+   if (e<0) {
+      deallocate( ctx, slice, -1 );
+      return NULL;
+   }
+   return slice;
+}
+
+
+/*
+ * Put a copy of a plane from extract_hslice() in the cache, replacing
+ * the least recently used entry.
+ * Input:  generation - ctx->GridGeneration from before the grid was read.
+ */
+static void cache_hslice( Context ctx, int time, int var, float level,
+                          float *slice, int colmajor, int generation )
+{
+   Display_Context dtx = ctx->dpy_ctx;
+   int nr = dtx->Nr, nc = dtx->Nc;
+   float *data, *olddata = NULL, *oldverts = NULL;
+   int i, e;
+
+   data = (float *) allocate_type( ctx, (PTRINT)nr * (PTRINT)nc * (PTRINT)sizeof(float),
+                                   HSLICE_TYPE );
+   if (!data) {
+      return;
+   }
+   if (colmajor) {
+      memcpy( data, slice, (PTRINT)nr * (PTRINT)nc * sizeof(float) );
+   }
+   else {
+      int j;
+      for (i=0; i<nr; i++) {
+         for (j=0; j<nc; j++) {
+            data[j*nr+i] = slice[i*nc+j];
+         }
+      }
+   }
+
+   LOCK_ON( ctx->HSliceCacheLock );
+   if (generation!=ctx->GridGeneration) {
+      /* the grid changed while the plane was being extracted */
+      olddata = data;
+   }
+   else if (find_hslice_cache( ctx, time, var, level ) >= 0) {
+      /* another thread beat us to it */
+      olddata = data;
+   }
+   else {
+      e = 0;
+      for (i=1;i<HSLICE_CACHE_SIZE;i++) {
+         if (ctx->HSliceCache[i].Timestep<0) {
+            if (ctx->HSliceCache[e].Timestep>=0) {
+               e = i;
+            }
+         }
+         else if (ctx->HSliceCache[e].Timestep>=0 &&
+                  ctx->HSliceCache[i].Age < ctx->HSliceCache[e].Age) {
+            e = i;
+         }
+      }
+      olddata = ctx->HSliceCache[e].Data;
+      oldverts = ctx->HSliceCache[e].Verts;
+      ctx->HSliceCache[e].Timestep = time;
+      ctx->HSliceCache[e].Var = var;
+      ctx->HSliceCache[e].Level = level;
+      ctx->HSliceCache[e].Generation = generation;
+      ctx->HSliceCache[e].Age = ctx->HSliceCacheClock++;
+      ctx->HSliceCache[e].Data = data;
+      ctx->HSliceCache[e].Verts = NULL;
+   }
+   LOCK_OFF( ctx->HSliceCacheLock );
+
+   if (olddata) {
+      deallocate( ctx, olddata, -1 );
+   }
+   if (oldverts) {
+      deallocate( ctx, oldverts, -1 );
+   }
+}
+
+
+#ifndef USE_SYSTEM_FONTS
+/*
+ * Look for the contour lines of a cached plane.  If found, copy the
+ * vertices to the arrays and return 1, else return 0.
+ */
+static int get_cached_contour( Context ctx, int time, int var, float level,
+                               float interval, float low, float high,
+                               float base,
+                               float vr1[], float vc1[], int maxv1, int *num1,
+                               float vr2[], float vc2[], int maxv2, int *num2,
+                               float vr3[], float vc3[], int maxv3, int *num3 )
+{
+   Display_Context dtx = ctx->dpy_ctx;
+   struct hslice_cache_rec *c;
+   int e, found = 0;
+
+   LOCK_ON( ctx->HSliceCacheLock );
+   e = find_hslice_cache( ctx, time, var, level );
+   if (e>=0) {
+      c = &ctx->HSliceCache[e];
+      if (c->Verts && c->Interval==interval && c->Low==low
+          && c->High==high && c->Base==base
+          && c->FontX==dtx->ContFontFactorX && c->FontY==dtx->ContFontFactorY
+          && c->Num1<=maxv1 && c->Num2<=maxv2 && c->Num3<=maxv3) {
+         float *v = c->Verts;
+         memcpy( vr1, v, c->Num1 * sizeof(float) );   v += c->Num1;
+         memcpy( vc1, v, c->Num1 * sizeof(float) );   v += c->Num1;
+         memcpy( vr2, v, c->Num2 * sizeof(float) );   v += c->Num2;
+         memcpy( vc2, v, c->Num2 * sizeof(float) );   v += c->Num2;
+         memcpy( vr3, v, c->Num3 * sizeof(float) );   v += c->Num3;
+         memcpy( vc3, v, c->Num3 * sizeof(float) );
+         *num1 = c->Num1;
+         *num2 = c->Num2;
+         *num3 = c->Num3;
+         found = 1;
+      }
+   }
+   LOCK_OFF( ctx->HSliceCacheLock );
+   return found;
+}
+
+
+/*
+ * Save the contour lines of a cached plane, replacing any made with
+ * other parameters.  Nothing is saved if the plane has been dropped or
+ * the lines were made from another generation of the grid.
+ */
+static void cache_contour( Context ctx, int time, int var, float level,
+                           int generation,
+                           float interval, float low, float high, float base,
+                           float vr1[], float vc1[], int num1,
+                           float vr2[], float vc2[], int num2,
+                           float vr3[], float vc3[], int num3 )
+{
+   Display_Context dtx = ctx->dpy_ctx;
+   float *verts, *v;
+   int e;
+
+   verts = (float *) allocate_type( ctx, 2L * (PTRINT)(num1+num2+num3+1)
+                                    * (PTRINT)sizeof(float), HSLICE_TYPE );
+   if (!verts) {
+      return;
+   }
+   v = verts;
+   memcpy( v, vr1, num1 * sizeof(float) );   v += num1;
+   memcpy( v, vc1, num1 * sizeof(float) );   v += num1;
+   memcpy( v, vr2, num2 * sizeof(float) );   v += num2;
+   memcpy( v, vc2, num2 * sizeof(float) );   v += num2;
+   memcpy( v, vr3, num3 * sizeof(float) );   v += num3;
+   memcpy( v, vc3, num3 * sizeof(float) );
+
+   LOCK_ON( ctx->HSliceCacheLock );
+   e = find_hslice_cache( ctx, time, var, level );
+   if (e>=0 && ctx->HSliceCache[e].Generation==generation) {
+      struct hslice_cache_rec *c = &ctx->HSliceCache[e];
+      v = c->Verts;
+      c->Verts = verts;
+      c->Interval = interval;
+      c->Low = low;
+      c->High = high;
+      c->Base = base;
+      c->FontX = dtx->ContFontFactorX;
+      c->FontY = dtx->ContFontFactorY;
+      c->Num1 = num1;
+      c->Num2 = num2;
+      c->Num3 = num3;
+   }
+   else {
+      v = verts;
+   }
+   LOCK_OFF( ctx->HSliceCacheLock );
+
+   if (v) {
+      deallocate( ctx, v, -1 );
+   }
+}
+#endif
+
+
+/*** free_hslice_cache ************************************************
+   Release all memory held by the horizontal slice cache.
+**********************************************************************/
+void free_hslice_cache( Context ctx )
+{
+   int i;
+
+   for (i=0;i<HSLICE_CACHE_SIZE;i++) {
+      struct hslice_cache_rec *c = &ctx->HSliceCache[i];
+      if (c->Data) {
+         deallocate( ctx, c->Data, -1 );
+         c->Data = NULL;
+      }
+      if (c->Verts) {
+         deallocate( ctx, c->Verts, -1 );
+         c->Verts = NULL;
+      }
+      c->Timestep = -1;
+   }
+}
+
+
+
 /*** calc_hslice ******************************************************
    Calculate a horizontal contour line slice and store it.
    Input:  time - the time step.
@@ -2019,7 +2300,7 @@ static void calc_hslice( Context ctx, int time, int var,
    float *boxverts;
    int numboxverts;
    Display_Context dtx;
-   int contour_ok;
+   int contour_ok, cached, generation;
    int max_cont_verts;
 	char *labels=NULL;
 
@@ -2077,35 +2358,9 @@ static void calc_hslice( Context ctx, int time, int var,
    }
 
 
-   /* get the 3-D grid */
-   grid = get_grid( ctx, time, var );
-   if (!grid)
-      return;
-
-   /* extract the 2-D slice from the 3-D grid */
-   /* MJK 12.04.98 */
-   if (ctx->DisplaySfcHSlice[var]){
-      slicedata = extract_sfc_slice (ctx, time, var, dtx->Nr, dtx->Nc, grid, 1);
-   }
-   else if (ctx->GridSameAsGridPRIME){
-      slicedata = extract_hslice( ctx, grid, var, dtx->Nr, dtx->Nc, dtx->Nl,
-                               dtx->LowLev, levelPRIME, 1 );
-   }
-   else{
-      slicedata = extract_hslicePRIME( ctx, grid, time, var, dtx->Nr, dtx->Nc, dtx->Nl,
-                               dtx->LowLev, levelPRIME, 1 );
-   }
-   
-   if (!slicedata) {
-      release_grid( ctx, time, var, grid );
-      return;
-   }
-
    if ( interval == 0.0 ) {
       printf(" Warning: Interval between contour lines is 0! Cannot draw.\n");
       printf("          (Perhaps hslice has no valid values or values are constant.)\n");
-      deallocate( ctx, slicedata, -1 );
-      release_grid( ctx, time, var, grid );
       return;
    }
 
@@ -2147,8 +2402,6 @@ static void calc_hslice( Context ctx, int time, int var,
       if (vr3){
          free(vr3);
       }
-      deallocate( ctx, slicedata, -1 );
-      release_grid( ctx, time, var, grid );
       return;
    }
  
@@ -2157,33 +2410,96 @@ static void calc_hslice( Context ctx, int time, int var,
    else
      base = low;
 
-   /* call contouring routine */
+   /* planes of the display grid can be cached, see free_hslice_cache() */
+   cached = ctx->GridSameAsGridPRIME && !ctx->DisplaySfcHSlice[var];
+
+   contour_ok = 0;
+#ifndef USE_SYSTEM_FONTS
+   if (cached) {
+      contour_ok = get_cached_contour( ctx, time, var, levelPRIME,
+                                       interval, low, high, base,
+                                       vr1, vc1, max_cont_verts, &num1,
+                                       vr2, vc2, max_cont_verts/2, &num2,
+                                       vr3, vc3, max_cont_verts/2, &num3 );
+   }
+#endif
+
+   if (!contour_ok) {
+      grid = NULL;
+      slicedata = cached ? get_cached_hslice( ctx, time, var, levelPRIME, 1,
+                                              &generation )
+                         : NULL;
+      if (!slicedata) {
+         /* get the 3-D grid */
+         generation = ctx->GridGeneration;
+         grid = get_grid( ctx, time, var );
+         if (!grid) {
+            free(vr1);free(vc1);free(vr2);free(vc2);free(vr3);free(vc3);free(vl);
+            return;
+         }
+
+         /* extract the 2-D slice from the 3-D grid */
+         /* MJK 12.04.98 */
+         if (ctx->DisplaySfcHSlice[var]){
+            slicedata = extract_sfc_slice (ctx, time, var, dtx->Nr, dtx->Nc, grid, 1);
+         }
+         else if (ctx->GridSameAsGridPRIME){
+            slicedata = extract_hslice( ctx, grid, var, dtx->Nr, dtx->Nc, dtx->Nl,
+                                     dtx->LowLev, levelPRIME, 1 );
+         }
+         else{
+            slicedata = extract_hslicePRIME( ctx, grid, time, var, dtx->Nr, dtx->Nc, dtx->Nl,
+                                     dtx->LowLev, levelPRIME, 1 );
+         }
+
+         if (!slicedata) {
+            release_grid( ctx, time, var, grid );
+            free(vr1);free(vc1);free(vr2);free(vc2);free(vr3);free(vc3);free(vl);
+            return;
+         }
+         if (cached) {
+            cache_hslice( ctx, time, var, levelPRIME, slicedata, 1,
+                          generation );
+         }
+      }
+
+      /* call contouring routine */
 #ifdef USE_SYSTEM_FONTS
 
-	labels = slice->labels;
+      labels = slice->labels;
 
-	if(labels)
-	  free(labels);
-    labels = (char *) malloc(10L*(PTRINT)sizeof(char)*(PTRINT)max_cont_verts/2L);
+      if(labels)
+        free(labels);
+      labels = (char *) malloc(10L*(PTRINT)sizeof(char)*(PTRINT)max_cont_verts/2L);
 #endif
 
-   contour_ok =
-     contour( ctx, slicedata, dtx->Nr, dtx->Nc, interval, low, high, base,
-	      vr1, vc1, max_cont_verts, &num1,
-	      vr2, vc2, max_cont_verts/2, &num2,
-	      vr3, vc3, max_cont_verts/2, &num3
+      contour_ok =
+        contour( ctx, slicedata, dtx->Nr, dtx->Nc, interval, low, high, base,
+                 vr1, vc1, max_cont_verts, &num1,
+                 vr2, vc2, max_cont_verts/2, &num2,
+                 vr3, vc3, max_cont_verts/2, &num3
 #ifdef USE_SYSTEM_FONTS
-				  , labels
+                 , labels
 #endif
-				  );
+                 );
 
-   /* done with grid and slice */
-   deallocate( ctx, slicedata, -1 );
-   release_grid( ctx, time, var, grid );
+      /* done with grid and slice */
+      deallocate( ctx, slicedata, -1 );
+      if (grid) {
+         release_grid( ctx, time, var, grid );
+      }
 
-   if (!contour_ok) {
-     free(vr1);free(vc1);free(vr2);free(vc2);free(vr3);free(vc3);free(vl);
-     return;
+      if (!contour_ok) {
+        free(vr1);free(vc1);free(vr2);free(vc2);free(vr3);free(vc3);free(vl);
+        return;
+      }
+#ifndef USE_SYSTEM_FONTS
+      if (cached) {
+         cache_contour( ctx, time, var, levelPRIME, generation,
+                        interval, low, high, base,
+                        vr1, vc1, num1, vr2, vc2, num2, vr3, vc3, num3 );
+      }
+#endif
    }
 
    /* generate level coordinates array */
@@ -2700,7 +3016,7 @@ static void calc_chslice( Context ctx, int time, int var,
    float *grid, *slicedata, scale;
    uint_1 *indexes;
    PTRINT vbytes, ibytes;
-   int slice_rows, slice_cols;
+   int slice_rows, slice_cols, generation;
    float density = 1.0;  /* Make this a parameter someday */
    Display_Context dtx;
 
@@ -2733,22 +3049,37 @@ static void calc_chslice( Context ctx, int time, int var,
    }
 
 
-   /* get the 3-D grid */
-   grid = get_grid( ctx, time, var );
-   if (!grid)
-      return;
-
-   /* extract the 2-D array from 3-D grid */
-   if (ctx->GridSameAsGridPRIME){
-      slicedata = extract_hslice( ctx, grid, var, dtx->Nr, dtx->Nc, dtx->Nl,
-                               dtx->LowLev, level, 0 );
+   /* the same plane as an hslice at this level may be cached */
+   grid = NULL;
+   slicedata = NULL;
+   if (ctx->GridSameAsGridPRIME) {
+      slicedata = get_cached_hslice( ctx, time, var, level, 0, &generation );
    }
-   else{
-      slicedata = extract_hslicePRIME( ctx, grid, time, var, dtx->Nr, dtx->Nc, dtx->Nl,
-                               dtx->LowLev, level, 0 );
+
+   if (!slicedata) {
+      /* get the 3-D grid */
+      generation = ctx->GridGeneration;
+      grid = get_grid( ctx, time, var );
+      if (!grid)
+         return;
+
+      /* extract the 2-D array from 3-D grid */
+      if (ctx->GridSameAsGridPRIME){
+         slicedata = extract_hslice( ctx, grid, var, dtx->Nr, dtx->Nc, dtx->Nl,
+                                  dtx->LowLev, level, 0 );
+         if (slicedata) {
+            cache_hslice( ctx, time, var, level, slicedata, 0, generation );
+         }
+      }
+      else{
+         slicedata = extract_hslicePRIME( ctx, grid, time, var, dtx->Nr, dtx->Nc, dtx->Nl,
+                                  dtx->LowLev, level, 0 );
+      }
+      if (!slicedata) {
+         release_grid( ctx, time, var, grid );
+         return;
+      }
    }
-   if (!slicedata)
-      return;
 
    /* compute size of colored slice */
    slice_rows = dtx->Nr * density;
@@ -2779,7 +3110,9 @@ static void calc_chslice( Context ctx, int time, int var,
       if (vl){
          free(vl);
       }
-      release_grid( ctx, time, var, grid );
+      if (grid) {
+         release_grid( ctx, time, var, grid );
+      }
       deallocate( ctx, slicedata, -1 );
       return;
    }
@@ -2859,7 +3192,9 @@ static void calc_chslice( Context ctx, int time, int var,
 
 
    /* done with the 3-D grid and 2-D slice */
-   release_grid( ctx, time, var, grid );
+   if (grid) {
+      release_grid( ctx, time, var, grid );
+   }
    deallocate( ctx, slicedata, -1 );
 
 
@@ -3072,257 +3407,94 @@ static void calc_cvslice( Context ctx, int time, int var,
 
 
 /*
- * Macros for calc_hwindslice and calc_vwindslice:
+ * Macro for the streamline slices:
  */
 
-#define CROSS( c, a, b )  { c[0] =  a[1]*b[2]-a[2]*b[1]; \
-                            c[1] = -a[0]*b[2]+a[2]*b[0]; \
-                            c[2] =  a[0]*b[1]-a[1]*b[0]; \
-                          }
-
 #define MAGNITUDE( a )    sqrt( a[0]*a[0] + a[1]*a[1] + a[2]*a[2] )
 
-#define NORMALIZE( v ) { float mag = 1.0/sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]); \
-                         v[0] *= mag; \
-                         v[1] *= mag; \
-                         v[2] *= mag; \
-                       }
-
-#define SCALE_VEC( v, d )  {  v[0] = v[0] / (d); \
-                              v[1] = v[1] / (d); \
-                              v[2] = v[2] / (d); \
-                           }
 
 
-#define BARB_INC 6.0
-
-/* MJK 12.04.98 begin */
-static int get_cross_vec (float *res, float *dir, float *up)
+/*
+ * Take the wind vectors of a horizontal wind slice at the grid points
+ * picked by the density.
+ * Input:  ctx - the context
+ *         ugrid, vgrid, wgrid - 2-D slices of U, V, W; wgrid may be NULL
+ *         level - grid level of the slice
+ *         drow, dcol - step between vectors in rows and columns
+ * Output:  pts - the vectors, allocated here
+ * Return:  1 = ok, 0 = out of memory
+ */
+static int hwind_points( Context ctx, const float *ugrid,
+                         const float *vgrid, const float *wgrid,
+                         float level, int drow, int dcol,
+                         struct wind_points *pts )
 {
+   int nr = ctx->Nr, nc = ctx->Nc;
+   int row, col, n;
 
-    float       fudge[3];
+   if (!alloc_wind_points( pts, ((nr+drow-1)/drow) * ((nc+dcol-1)/dcol) )) {
+      return 0;
+   }
+   n = 0;
+   for (row=0; row<nr; row+=drow) {
+      for (col=0; col<nc; col+=dcol) {
+         float u = ugrid[row*nc+col];
+         float v = vgrid[row*nc+col];
+         float w = wgrid ? wgrid[row*nc+col] : 0.0;
 
+         if (IS_MISSING(u) || IS_MISSING(v) || IS_MISSING(w)) {
+            /* if u, v, or w is missing, draw no vector */
+            continue;
+         }
+         /* make wind arrows parallel to trajectories */
+         pts->br[n] = (float) row;
+         pts->bc[n] = (float) col;
+         pts->bl[n] = level;
+         pts->tr[n] = (float) row + v * ctx->Vscale[row][col];
+         pts->tc[n] = (float) col + u * ctx->Uscale[row][col];
+         pts->tl[n] = level + w * ctx->Wscale[(int) level];
+         pts->speed[n] = sqrt( u*u + v*v + w*w );
+         n++;
+      }
+   }
+   pts->n = n;
+   return 1;
+}
 
-    CROSS (res, dir, up);
 
-    if (MAGNITUDE (res) != 0.0) return 1;
 
 /*
- *  We get to this point if the wind vector is perpendicular to the slice
- *  plane.  Although not common, this _can_ happen -- especially if one of
- *  the wind components (probably W) is missing.  This hunk of code is a
- *  bit of a kludge.
+ * Take back the arrows of a stored horizontal wind slice if it was made
+ * from the same winds at the same level and density.  Then only the
+ * scale or the choice of barbs has changed and the arrows can be used
+ * again.  The winds must not have been reread since (generation) and
+ * the box must not have been rebuilt since (dtx->GeometryGeneration).
+ * Return:  the arrows, now owned by the caller, or NULL
  */
-
-    if (dir[0] != 0.0)
-    {
-        fudge[0] = dir[0] * 0.99999;
-        fudge[1] = sqrt ((dir[0] * dir[0]) - (fudge[0] * fudge[0]));
-        fudge[2] = 0.0;
-    }
-    else if (dir[1] != 0.0)
-    {
-        fudge[1] = dir[1] * 0.99999;
-        fudge[0] = sqrt ((dir[1] * dir[1]) - (fudge[1] * fudge[1]));
-        fudge[2] = 0.0;
-    }
-    else
-    {
-        fudge[2] = dir[2] * 0.99999;
-        fudge[1] = sqrt ((dir[2] * dir[2]) - (fudge[2] * fudge[2]));
-        fudge[0] = 0.0;
-    }
-
-    CROSS (res, fudge, up);
-
-
-    return 0;
-}
-/* MJK 12.04.98 end */
-
-/* draw line disjoint segments for wind barb */
-static void make_barb(Display_Context dtx, float u, float v, float w, float *dir,
-                      float *up, float row, float col, float level,
-                      float *vr, float *vc, float *vl, int drow, int *vco)
-{
-  float a[3];
-  float kts, len, alen, size;
-  float tr, tc, tl;
-  float lat, lon, midrow, midcol, sign;
-  int i, ikts, ntri, nlong, nshort;
-  int vcount;
-
-  vcount = *vco;
-  size = drow;
-  kts = sqrt (u * u + v * v + w * w) * (3600.0 / 1853.248);
-
-  sign = -1.0;
-  if (dtx->Projection != PROJ_GENERIC) {
-    midrow = (float) dtx->Nr / 2.0;
-    midcol = (float) dtx->Nc / 2.0;
-    rowcolPRIME_to_latlon( dtx, -1, -1, midrow, midcol, &lat, &lon );
-    sign = (lat >= 0.0) ? -1.0 : 1.0;
-  }
-
-  if (kts < 1.0) {
-    /* make a cross for calm */
-
-    vr[vcount] = row + size / BARB_INC;
-    vc[vcount] = col;
-    vl[vcount] = level;
-    vcount++;
-
-    vr[vcount] = row - size / BARB_INC;
-    vc[vcount] = col;
-    vl[vcount] = level;
-    vcount++;
-
-    vr[vcount] = row;
-    vc[vcount] = col + size / BARB_INC;
-    vl[vcount] = level;
-    vcount++;
-
-    vr[vcount] = row;
-    vc[vcount] = col - size / BARB_INC;
-    vl[vcount] = level;
-    vcount++;
-
-    vr[vcount] = row;
-    vc[vcount] = col;
-    vl[vcount] = level + size / BARB_INC;
-    vcount++;
-
-    vr[vcount] = row;
-    vc[vcount] = col;
-    vl[vcount] = level - size / BARB_INC;
-    vcount++;
-
-  }
-  else {
-    len = MAGNITUDE( dir );
-    SCALE_VEC( dir, len / size );
-
-    /* make the base line */
-    vr[vcount] = row;
-    vc[vcount] = col;
-    vl[vcount] = level;
-    vcount++;
-    vr[vcount] = tr = row - dir[0];
-    vc[vcount] = tc = col - dir[1];
-    vl[vcount] = tl = level - dir[2];
-    vcount++;
-
-    /* MJK 12.04.98 */
-    get_cross_vec (a, dir, up);
-
-
-
-    alen = sign * BARB_INC * MAGNITUDE( a ) / size;
-    a[0] = a[0] / alen;
-    a[1] = a[1] / alen;
-    a[2] = a[2] / alen;
-
-    SCALE_VEC( dir, BARB_INC );
-    tr -= dir[0];
-    tc -= dir[1];
-    tl -= dir[2];
-
-    /* compute numbers of triangles, long & short fletches */
-    ikts = (int) kts + 2;
-    ntri = ikts / 50;
-    ikts = ikts % 50;
-    nlong = ikts / 10;
-    ikts = ikts % 10;
-    nshort = ikts / 5;
-
-    for (i=0; i<ntri; i++) {
-      /* riser */
-      vr[vcount] = tr;
-      vc[vcount] = tc;
-      vl[vcount] = tl;
-      vcount++;
-
-      vr[vcount] = tr + a[0];
-      vc[vcount] = tc + a[1];
-      vl[vcount] = tl + a[2];
-      vcount++;
-
-      /* cross piece inside triangle */
-      vr[vcount] = tr;
-      vc[vcount] = tc;
-      vl[vcount] = tl;
-      vcount++;
-
-      vr[vcount] = tr + 0.5 * (dir[0] + a[0]);
-      vc[vcount] = tc + 0.5 * (dir[1] + a[1]);
-      vl[vcount] = tl + 0.5 * (dir[2] + a[2]);
-      vcount++;
-
-      /* hypotenuse */
-      vr[vcount] = tr + a[0];
-      vc[vcount] = tc + a[1];
-      vl[vcount] = tl + a[2];
-      vcount++;
-
-      tr += dir[0];
-      tc += dir[1];
-      tl += dir[2];
-
-      vr[vcount] = tr;
-      vc[vcount] = tc;
-      vl[vcount] = tl;
-      vcount++;
-
-      /* extend base line for first triangle */
-      if (i == 0) {
-        vr[vcount] = tr;
-        vc[vcount] = tc;
-        vl[vcount] = tl;
-        vcount++;
-
-        vr[vcount] = tr - dir[0];
-        vc[vcount] = tc - dir[1];
-        vl[vcount] = tl - dir[2];
-        vcount++;
-      }
-    }
-
-    for (i=0; i<nlong; i++) {
-      vr[vcount] = tr + a[0];
-      vc[vcount] = tc + a[1];
-      vl[vcount] = tl + a[2];
-      vcount++;
-
-      tr += dir[0];
-      tc += dir[1];
-      tl += dir[2];
-
-      vr[vcount] = tr;
-      vc[vcount] = tc;
-      vl[vcount] = tl;
-      vcount++;
-    }
-
-    for (i=0; i<nshort; i++) {
-      vr[vcount] = tr + 0.5 * (dir[0] + a[0]);
-      vc[vcount] = tc + 0.5 * (dir[1] + a[1]);
-      vl[vcount] = tl + 0.5 * (dir[2] + a[2]);
-      vcount++;
-
-      tr += dir[0];
-      tc += dir[1];
-      tl += dir[2];
-
-      vr[vcount] = tr;
-      vc[vcount] = tc;
-      vl[vcount] = tl;
-      vcount++;
-    }
-
-  }
-
-  *vco = vcount;
-}
+static struct wind_arrows *take_hwind_arrows( Display_Context dtx, int time,
+                                              int ws, float level,
+                                              float density, int sfc,
+                                              int prime, int generation )
+{
+   struct hwind *hw = &dtx->HWindTable[ws][time];
+   struct wind_arrows *arrows = NULL;
+
+   wait_write_lock( &hw->lock );
+   if (hw->valid && hw->arrows &&
+       hw->uvar==dtx->Uvar[ws] && hw->vvar==dtx->Vvar[ws] &&
+       hw->wvar==dtx->Wvar[ws] &&
+       hw->uvarowner==dtx->Uvarowner[ws] &&
+       hw->vvarowner==dtx->Vvarowner[ws] &&
+       hw->wvarowner==dtx->Wvarowner[ws] &&
+       hw->level==level && hw->density==density && hw->sfc==sfc &&
+       hw->prime==prime && hw->generation==generation &&
+       hw->geometry==dtx->GeometryGeneration) {
+      arrows = hw->arrows;
+      hw->arrows = NULL;
+   }
+   done_write_lock( &hw->lock );
+   return arrows;
+}
 
 
 
@@ -3330,722 +3502,139 @@ static void make_barb(Display_Context dtx, float u, float v, float w, float *dir
  * Compute vectors in a horizontal wind slice.
  * Input:  displaytime - which display timestep
  *         ws - which wind slice [0,WINDSLICES-1]
- *         level - vis5d_ctx  level of slice in [0,Nl-1]
- *         scale - user scaling factor  (1.0 is typical)
- *         density - user density factor  1.0, 0.5, 0.25, etc.
- *         threadnum - which thread
- */
-static void calc_hwindslice( Display_Context dtx, int displaytime, int ws,
-                             float level, float scale, float density,
-                             int threadnum )
-{
-   Context ctx;
-   float *grid, *ugrid, *vgrid, *wgrid;
-   int row, col, drow, dcol, vcount;
-   float *vr, *vc, *vl;
-   int_vert2 *cverts;
-   int uvar, vvar, wvar;
-   float *boxverts;
-   int numboxverts;
-
-   float ctxlevel;
-   int time;
-   float arrowr[4], arrowc[4], arrowl[4];
-   float arrowx[4], arrowy[4], arrowz[4];
-   float boxy, px, py, pz;
-
-
-   uvar = dtx->Uvar[ws];
-   vvar = dtx->Vvar[ws];
-   wvar = dtx->Wvar[ws];
-
-   ctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, dtx->Uvarowner[ws])];
-   if (!ctx){
-      printf("error in getting rctx in calc_hwindslice\n");
-   }
-
-
-   /* MJK 12.04.98 */
-   if (ctx->dpy_ctx->DisplaySfcHWind[ws]) wvar = -1;
-
-
-   ctxlevel = gridlevelPRIME_to_gridlevel( ctx, level);
-   time = dtx->TimeStep[displaytime].ownerstimestep[return_ctx_index_pos(dtx, ctx->context_index)];
-   if (displaytime > 0){
-      int timebefore;
-      timebefore = dtx->TimeStep[displaytime-1].ownerstimestep[
-                   return_ctx_index_pos(dtx, ctx->context_index)];
-      if (time == timebefore){
-         return;
-      }
-   }
-   if (uvar<0 || vvar<0) {
-      /* no wind variables specified */
-      return;
-   }
-   /* Get U, V, W 2-D grids */
-   grid = get_grid( ctx, time, uvar );
-   if (!grid) return;
-
-
-   /* MJK 12.04.98 */
-   if (ctx->dpy_ctx->DisplaySfcHWind[ws]){
-      ugrid = extract_sfc_slice (ctx, time, uvar, ctx->Nr, ctx->Nc, grid, 0);
-   }
-   else{
-      ugrid = extract_hslice( ctx, grid, uvar, ctx->Nr, ctx->Nc, ctx->Nl[uvar],
-                              ctx->Variable[uvar]->LowLev, ctxlevel, 0 );
-   }
-
-
-   release_grid( ctx, time, uvar, grid );
-
-
-   grid = get_grid( ctx, time, vvar );
-   if (!grid) return;
-
-
-
-   /* MJK 12.04.98 */
-   if (ctx->dpy_ctx->DisplaySfcHWind[ws]){
-      vgrid = extract_sfc_slice (ctx, time, vvar, ctx->Nr, ctx->Nc, grid, 0);
-   }
-   else{
-      vgrid = extract_hslice( ctx, grid, vvar, ctx->Nr, ctx->Nc, ctx->Nl[vvar],
-                           ctx->Variable[vvar]->LowLev, ctxlevel, 0 );
-   }
-
-
-
-
-   release_grid( ctx, time, vvar, grid );
-
-
-   if (wvar>-1) {
-      grid = get_grid( ctx, time, wvar );
-      if (!grid) return;
-      wgrid = extract_hslice( ctx, grid, wvar, ctx->Nr, ctx->Nc, ctx->Nl[wvar],
-                              ctx->Variable[wvar]->LowLev, ctxlevel, 0 );
-      release_grid( ctx, time, wvar, grid );
-   }
-
-   vr = (float *) malloc(sizeof(float)*(PTRINT)MAX_WIND_VERTS);
-   vc = (float *) malloc(sizeof(float)*(PTRINT)MAX_WIND_VERTS);
-   vl = (float *) malloc(sizeof(float)*(PTRINT)MAX_WIND_VERTS);
-   if (!vr || !vc || !vl){
-      printf(" You do not have enough memory to create hwinds.\n");
-      if (vr){
-         free(vr);
-      }
-      if (vc){
-         free(vc);
-      }
-      if (vl){
-         free(vl);
-      }
-      deallocate( ctx, ugrid, -1 );
-      deallocate( ctx, vgrid, -1 );
-      if (wvar>-1){
-        deallocate( ctx, wgrid, -1 );
-      }
-      return;
-   }
-
-   /* Density: */
-   if (density>MAXWINDDENSITY || density<MINWINDDENSITY)
-     density = MAXWINDDENSITY;
-   drow = (int) (1.0 / density);
-   dcol = (int) (1.0 / density);
-
-
-   /* calculate vector vertices */
-   vcount = 0;
-
-
-   boxy = dtx->Xmax-dtx->Xmin;
-   for (row=0; row<ctx->Nr && vcount+40<MAX_WIND_VERTS; row+=drow) {
-      for (col=0; col<ctx->Nc && vcount+40<MAX_WIND_VERTS; col+=dcol) {
-         float u, v, w;
-         float a[3], dir[3], up[3], len, alen;
-
-
-
-         /* get <U,V,W> vector */
-         u = ugrid[row*ctx->Nc+col];
-         v = vgrid[row*ctx->Nc+col];
-         w = (wvar>-1) ? wgrid[row*ctx->Nc+col] : 0.0;
-         if (IS_MISSING(u) || IS_MISSING(v) || IS_MISSING(w)) {
-            /* if u, v, or w is missing, draw no vector */
-         }
-         else {
-            float newlen, oldlen, factor;
-
-            oldlen = sqrt (u * u + v * v + w * w);
-
-            /* make wind arrows parallel to trajectories */
-            dir[0] = v * ctx->Vscale[row][col];
-            dir[1] = u * ctx->Uscale[row][col];
-            dir[2] = w * ctx->Wscale[(int) ctxlevel];
-
-            len = MAGNITUDE( dir );
-            arrowr[0] = (float) row;
-            arrowc[0] = (float) col;
-            arrowl[0] = ctxlevel;
-
-            arrowr[1] = (float) row + dir[0];
-            arrowc[1] = (float) col + dir[1];
-            arrowl[1] = ctxlevel + dir[2];
-
-            /* get xyz arrow */
-            gridPRIME_to_xyzPRIME( dtx, time, uvar, 2, arrowr, arrowc,
-                                    arrowl, arrowx, arrowy, arrowz);
-
-            dir[0] = arrowx[1] - arrowx[0];
-            dir[1] = arrowy[1] - arrowy[0];
-            dir[2] = arrowz[1] - arrowz[0];
-
-            newlen = MAGNITUDE( dir );
-            factor = (newlen > 0.0000001) ? oldlen / newlen :
-                                            oldlen / 0.0000001;
-
-            /* multiply vector by factor in graphics space */
-            factor = (factor / 25.0) * (boxy * 0.03) * scale;
-
-            dir[0] *= factor;
-            dir[1] *= factor;
-            dir[2] *= factor;
-
-            len = MAGNITUDE( dir );
-
-            if ((dir[2]>len/2.0 || dir[2]<-len/2.0) && dtx->WindBarbs == 0) {
-              up[0] = 1.0;  up[1] = 0.0;  up[2] = 0.0;
-            }
-            else {
-              up[0] = 0.0;  up[1] = 0.0;  up[2] = 1.0;
-            }
-
-            arrowx[1] = arrowx[0] + dir[0];
-            arrowy[1] = arrowy[0] + dir[1];
-            arrowz[1] = arrowz[0] + dir[2];
-
-            /* create arrow head in graphics space too!.. */
-            /* this gets rid of demented arrow head sizes */
-            /* when ratio of row, cols, levs is wacky*/
-            CROSS( a, dir, up );
-            alen = MAGNITUDE( a );
-
-/* MJK 3.25.99 */
-            if (alen * len * 0.1 == 0.0){
-               a[0] = 0.0;
-               a[1] = 0.0;
-               a[2] = 0.0;
-            }
-            else{
-               a[0] = a[0] / alen * len * 0.1;
-               a[1] = a[1] / alen * len * 0.1;
-               a[2] = a[2] / alen * len * 0.1;
-            }
-
-            px = arrowx[1] - dir[0] * 0.2;
-            py = arrowy[1] - dir[1] * 0.2;
-            pz = arrowz[1] - dir[2] * 0.2;
-
-            arrowx[2] = px + a[0];
-            arrowy[2] = py + a[1];
-            arrowz[2] = pz + a[2];
-            arrowx[3] = px - a[0];
-            arrowy[3] = py - a[1];
-            arrowz[3] = pz - a[2];
-
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[0], arrowy[0],
-                                       arrowz[0], &arrowr[0], &arrowc[0], &arrowl[0]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[1], arrowy[1],
-                                       arrowz[1], &arrowr[1], &arrowc[1], &arrowl[1]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[2], arrowy[2],
-                                       arrowz[2], &arrowr[2], &arrowc[2], &arrowl[2]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[3], arrowy[3],
-                                       arrowz[3], &arrowr[3], &arrowc[3], &arrowl[3]);
-
-            if (dtx->WindBarbs == 0) {
-               if (len>=0.001) {
-                  if (ctx->dpy_ctx->DisplaySfcHWind[ws]){
-                     vr[vcount] = arrowr[0];
-                     vc[vcount] = arrowc[0];
-                     vl[vcount] = arrowl[0];
-
-                     vr[vcount+1] = arrowr[1];
-                     vc[vcount+1] = arrowc[1];
-                     vl[vcount+1] = arrowl[1];
-
-                     vr[vcount+2] = vr[vcount+1];
-                     vc[vcount+2] = vc[vcount+1];
-                     vl[vcount+2] = vl[vcount+1];
-
-                     vr[vcount+3] = arrowr[2];
-                     vc[vcount+3] = arrowc[2];
-                     vl[vcount+3] = arrowl[2];
-
-                     vr[vcount+4] = vr[vcount+1];
-                     vc[vcount+4] = vc[vcount+1];
-                     vl[vcount+4] = vl[vcount+1];
-                     
-                     vr[vcount+5] = arrowr[3];
-                     vc[vcount+5] = arrowc[3];
-                     vl[vcount+5] = arrowl[3];
-                     vcount +=6;
-                  }
-                  else{
-                     vr[vcount] = arrowr[0];
-                     vc[vcount] = arrowc[0];
-                     vl[vcount] = arrowl[0];
-
-                     vr[vcount+1] = arrowr[1];
-                     vc[vcount+1] = arrowc[1];
-                     vl[vcount+1] = arrowl[1];
-
-                     vr[vcount+2] = arrowr[2];
-                     vc[vcount+2] = arrowc[2];
-                     vl[vcount+2] = arrowl[2];
-
-                     vr[vcount+3] = arrowr[3];
-                     vc[vcount+3] = arrowc[3];
-                     vl[vcount+3] = arrowl[3];
-
-                     vcount+=4;
-                  }
-                  /* Used to debug R8000 -O2/O3 bug:
-                  if (vcount==12) {
-                     int ii;
-                     printf("\n");
-                     for (ii=0;ii<12;ii++) {
-                        printf("%g %g %g\n", vr[ii], vc[ii], vl[ii] );
-                     }
-                     printf("  %g %g %g  %g %g %g\n", pr, pc, pl, a[0], a[1], a[2] );
-                  }*/
-               }
-            }
-            else{
-               dir[0] = arrowr[1] - arrowr[0];
-               dir[1] = arrowc[1] - arrowc[0];
-               dir[2] = arrowl[1] - arrowl[0];
-
-               len = MAGNITUDE( dir );
-
-               up[0] = 0.0;  up[1] = 0.0;  up[2] = 1.0;
-
-               make_barb(dtx, u, v, w, dir, up, (float) row, (float) col, ctxlevel,
-                       vr, vc, vl, drow, &vcount);
-            }
-         } /* end if U, V & W not MISSING */
-      } /* end for (col=... */
-   } /* end for (row=... */
-
-   /* deallocate 2-D grids */
-   deallocate( ctx, ugrid, -1 );
-   deallocate( ctx, vgrid, -1 );
-   if (wvar>-1){
-     deallocate( ctx, wgrid, -1 );
-   }
-   /*
-    * Bounding rectangle
-    */
-   numboxverts = make_horizontal_rectangle( ctx, time, uvar, dtx->CurvedBox,
-                                            level, &boxverts );
-
-   /************************ Compress ********************************/
-
-
-   /* MJK 12.04.98 */
-   if (ctx->dpy_ctx->DisplaySfcHWind[ws]){
-      vcount = fit_vecs_to_topo (ctx, vcount, MAX_WIND_VERTS, vr, vc, vl);
-   }
-
- 
-   if (vcount>0) {
-      PTRINT bytes = 3L*(PTRINT)vcount*(PTRINT)sizeof(int_vert2);
-      cverts = (int_vert2 *) allocate_type( ctx, bytes, WINDXH_TYPE );
-      if (!cverts) {
-         deallocate( ctx, cverts, bytes);
-         cverts = NULL;
-         vcount = 0;
-      }
-      else{
-         gridPRIME_to_compXYZPRIME( dtx, time, uvar, vcount, vr, vc, vl, (void*)cverts );
-      }
-   }
-   else {
-      vcount = 0;
-      cverts = NULL;
-   }
-
-   /************************* Store wind slice ***********************/
-   recent( ctx, HWIND, ws );
-   wait_write_lock( &dtx->HWindTable[ws][time].lock );
-
-   /* deallocate existing slice, if any */
-   free_hwind( dtx, time, ws );
-
-   /* store new slice */
-   dtx->HWindTable[ws][time].uvar = dtx->Uvar[ws];
-   dtx->HWindTable[ws][time].vvar = dtx->Vvar[ws];
-   dtx->HWindTable[ws][time].wvar = dtx->Wvar[ws];
-   dtx->HWindTable[ws][time].uvarowner = dtx->Uvarowner[ws];
-   dtx->HWindTable[ws][time].vvarowner = dtx->Vvarowner[ws];
-   dtx->HWindTable[ws][time].wvarowner = dtx->Wvarowner[ws];
-   dtx->HWindTable[ws][time].level = level;
-   dtx->HWindTable[ws][time].density = density;
-   dtx->HWindTable[ws][time].scale = scale;
-   dtx->HWindTable[ws][time].nvectors = vcount;  /* 4 vertices / vector */
-   dtx->HWindTable[ws][time].verts = cverts;
-   dtx->HWindTable[ws][time].boxverts = boxverts;
-   dtx->HWindTable[ws][time].numboxverts = numboxverts;
-   dtx->HWindTable[ws][time].valid = 1;
-   dtx->HWindTable[ws][time].barbs = dtx->WindBarbs;
-   dtx->HWindTable[ws][time].uvarowner = ctx->context_index; 
-   done_write_lock( &dtx->HWindTable[ws][time].lock );
-
-   if (time==ctx->CurTime) {
-      dtx->Redraw = 1;
-   }
-   free(vr);
-   free(vc);
-   free(vl);
-}
-
-
-
-static void calc_hwindslicePRIME( Display_Context dtx, int displaytime, int ws,
-                             float level, float scale, float density,
-                             int threadnum )
-{
-   Context ctx;
-   float *grid, *ugrid, *vgrid, *wgrid;
-
-   int row, col, drow, dcol, vcount;
-   float *vr, *vc, *vl;   
-   int_vert2 *cverts;
-   int uvar, vvar, wvar;
-   float *boxverts;
-   int numboxverts;
-
-   float ctxlevel;
-   int time;
-   float jlat[2], jlon[2], jhgt[2];
-   float jx[2], jy[2], jz[2];
-   float arrowr[4], arrowc[4], arrowl[4];
-   float arrowx[4], arrowy[4], arrowz[4];
-   float boxy, px, py, pz;
-
-   uvar = dtx->Uvar[ws];
-   vvar = dtx->Vvar[ws];
-   wvar = dtx->Wvar[ws];
-
-   ctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, dtx->Uvarowner[ws])];
-   if (!ctx){
-      printf("error in getting rctx in calc_hwindslice\n");
-   }
-
-   /* MJK 12.04.98 */
-   if (ctx->dpy_ctx->DisplaySfcHWind[ws]) wvar = -1;
-
-
-   ctxlevel = gridlevelPRIME_to_gridlevel( ctx, level);
-   time = dtx->TimeStep[displaytime].ownerstimestep[return_ctx_index_pos(dtx, ctx->context_index)];
-   if (displaytime > 0){
-      int timebefore;
-      timebefore = dtx->TimeStep[displaytime-1].ownerstimestep[
-                   return_ctx_index_pos(dtx, ctx->context_index)];
-      if (time == timebefore){
-         return;
-      }
-   }
-   if (uvar<0 || vvar<0) {
-      /* no wind variables specified */
-      return;
-   }
-
-   /* Get U, V, W 2-D grids */
-   grid = get_grid( ctx, time, uvar );
-   if (!grid) return;
-
-
-   /* MJK 12.04.98 */
-   if (ctx->dpy_ctx->DisplaySfcHWind[ws]){
-      ugrid = extract_sfc_slice (ctx, time, uvar, ctx->Nr, ctx->Nc, grid, 0);
-   }
-   else{
-      ugrid = extract_hslice( ctx, grid, uvar, ctx->Nr, ctx->Nc, ctx->Nl[uvar],
-                              ctx->Variable[uvar]->LowLev, ctxlevel, 0 );
-   }
-
-   release_grid( ctx, time, uvar, grid );
-
-
-   grid = get_grid( ctx, time, vvar );
-   if (!grid) return;
-
-
-   /* MJK 12.04.98 */
-   if (ctx->dpy_ctx->DisplaySfcHWind[ws]){
-      vgrid = extract_sfc_slice (ctx, time, vvar, ctx->Nr, ctx->Nc, grid, 0);
-   }
-   else{
-      vgrid = extract_hslice( ctx, grid, vvar, ctx->Nr, ctx->Nc, ctx->Nl[vvar],
-                           ctx->Variable[vvar]->LowLev, ctxlevel, 0 );
-   }
-
-
-   release_grid( ctx, time, vvar, grid );
-   if (wvar>-1) {
-      grid = get_grid( ctx, time, wvar );
-      if (!grid) return;
-      wgrid = extract_hslice( ctx, grid, wvar, ctx->Nr, ctx->Nc, ctx->Nl[wvar],
-                              ctx->Variable[wvar]->LowLev, ctxlevel, 0 );
-      release_grid( ctx, time, wvar, grid );
-   }
-
-   vr = (float *) malloc(sizeof(float)*(PTRINT)MAX_WIND_VERTS);
-   vc = (float *) malloc(sizeof(float)*(PTRINT)MAX_WIND_VERTS);
-   vl = (float *) malloc(sizeof(float)*(PTRINT)MAX_WIND_VERTS);
-   if (!vr || !vc || !vl){
-      printf(" You do not have enough memory to create hwinds.\n");
-      if (vr){
-         free(vr);
-      }
-      if (vc){
-         free(vc);
-      }
-      if (vl){
-         free(vl);
-      }
-      deallocate( ctx, ugrid, -1 );
-      deallocate( ctx, vgrid, -1 );
-      if (wvar>-1){
-        deallocate( ctx, wgrid, -1 );
-      }
-      return;
-   }
-
-   /* Density: */
-   if (density>MAXWINDDENSITY || density<MINWINDDENSITY)
-     density = MAXWINDDENSITY;
-   drow = (int) (1.0 / density);
-   dcol = (int) (1.0 / density);
-
-
-   /* calculate vector vertices */
-   vcount = 0;
-
-   boxy = dtx->Xmax-dtx->Xmin;
-   for (row=0; row<ctx->Nr && vcount+40<MAX_WIND_VERTS; row+=drow) {
-      for (col=0; col<ctx->Nc && vcount+40<MAX_WIND_VERTS; col+=dcol) {
-         float u, v, w;
-         float a[3], dir[3], up[3], len, alen;
-
-
-
-
-
-         /* get <U,V,W> vector */
-         u = ugrid[row*ctx->Nc+col];
-         v = vgrid[row*ctx->Nc+col];
-         w = (wvar>-1) ? wgrid[row*ctx->Nc+col] : 0.0;
-         if (IS_MISSING(u) || IS_MISSING(v) || IS_MISSING(w)) {
-            /* if u, v, or w is missing, draw no vector */
-         }
-         else {
-            float newlen, oldlen, factor;
-
-            oldlen = sqrt (u * u + v * v + w * w);
-
-            /* make wind arrows parallel to trajectories */
-            dir[0] = v * ctx->Vscale[row][col];
-            dir[1] = u * ctx->Uscale[row][col];
-            dir[2] = w * ctx->Wscale[(int) ctxlevel];
-
-            len = MAGNITUDE( dir );
-            arrowr[0] = (float) row;
-            arrowc[0] = (float) col;
-            arrowl[0] = ctxlevel;
-
-            arrowr[1] = (float) row + dir[0];
-            arrowc[1] = (float) col + dir[1];
-            arrowl[1] = ctxlevel + dir[2];
-
-            /* get xyz arrow */
-            grid_to_xyz( ctx, time, uvar, 2, arrowr, arrowc,
-                                    arrowl, arrowx, arrowy, arrowz);
-
-            dir[0] = arrowx[1] - arrowx[0];
-            dir[1] = arrowy[1] - arrowy[0];
-            dir[2] = arrowz[1] - arrowz[0];
-
-            newlen = MAGNITUDE( dir );
-            factor = (newlen > 0.0000001) ? oldlen / newlen :
-                                            oldlen / 0.0000001;
-
-            /* multiply vector by factor in graphics space */
-            factor = (factor / 25.0) * (boxy * 0.03) * scale;
-
-            dir[0] *= factor;
-            dir[1] *= factor;
-            dir[2] *= factor;
-
-            len = MAGNITUDE( dir );
+ *         level - vis5d_ctx  level of slice in [0,Nl-1]
+ *         scale - user scaling factor  (1.0 is typical)
+ *         density - user density factor  1.0, 0.5, 0.25, etc.
+ *         prime - 0 = the context's grid is the display's grid,
+ *                 1 = carry the vectors over from the context's grid
+ *         threadnum - which thread
+ */
+static void calc_hwindslice( Display_Context dtx, int displaytime, int ws,
+                             float level, float scale, float density,
+                             int prime, int threadnum )
+{
+   Context ctx;
+   float *grid, *ugrid, *vgrid, *wgrid;
+   int drow, dcol, vcount, sfc;
+   float *vr, *vc, *vl;
+   int_vert2 *cverts;
+   int uvar, vvar, wvar;
+   float *boxverts;
+   int numboxverts;
+   struct wind_arrows *arrows;
+   struct wind_points pts;
+   int generation;
 
-            /* get small unit vector! */
-            arrowx[1] = arrowx[0] + (dir[0]/(len*100));
-            arrowy[1] = arrowy[0] + (dir[1]/(len*100));
-            arrowz[1] = arrowz[0] + (dir[2]/(len*100));
+   float ctxlevel;
+   int time;
 
-            xyz_to_geo( ctx, time, uvar, arrowx[0], arrowy[0],
-                           arrowz[0], &jlat[0], &jlon[0], &jhgt[0]);
-            xyz_to_geo( ctx, time, uvar, arrowx[1], arrowy[1],
-                           arrowz[1], &jlat[1], &jlon[1], &jhgt[1]);
 
-            geo_to_xyzPRIME(dtx, displaytime, uvar, 2, jlat, jlon,
-                                 jhgt, jx, jy, jz);
+   uvar = dtx->Uvar[ws];
+   vvar = dtx->Vvar[ws];
+   wvar = dtx->Wvar[ws];
 
-            /* now get vector in PRIME space */
-            arrowx[0] = jx[0];
-            arrowy[0] = jy[0];
-            arrowz[0] = jz[0];
+   ctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, dtx->Uvarowner[ws])];
+   if (!ctx){
+      printf("error in getting rctx in calc_hwindslice\n");
+   }
 
-            arrowx[1] = jx[0] + 100*len*(jx[1] - jx[0]);
-            arrowy[1] = jy[0] + 100*len*(jy[1] - jy[0]);
-            arrowz[1] = jz[0] + 100*len*(jz[1] - jz[0]);
 
-            dir[0] = arrowx[1] - arrowx[0];
-            dir[1] = arrowy[1] - arrowy[0];
-            dir[2] = arrowz[1] - arrowz[0];
+   /* MJK 12.04.98 */
+   sfc = ctx->dpy_ctx->DisplaySfcHWind[ws];
+   if (sfc) wvar = -1;
 
-            len = MAGNITUDE( dir );
 
-            if ((dir[2]>len/2.0 || dir[2]<-len/2.0) && dtx->WindBarbs == 0) {
-              up[0] = 1.0;  up[1] = 0.0;  up[2] = 0.0;
-            }
-            else {
-              up[0] = 0.0;  up[1] = 0.0;  up[2] = 1.0;
-            }
+   ctxlevel = gridlevelPRIME_to_gridlevel( ctx, level);
+   time = dtx->TimeStep[displaytime].ownerstimestep[return_ctx_index_pos(dtx, ctx->context_index)];
+   if (displaytime > 0){
+      int timebefore;
+      timebefore = dtx->TimeStep[displaytime-1].ownerstimestep[
+                   return_ctx_index_pos(dtx, ctx->context_index)];
+      if (time == timebefore){
+         return;
+      }
+   }
+   if (uvar<0 || vvar<0) {
+      /* no wind variables specified */
+      return;
+   }
 
-            /* create arrow head in graphics space too!.. */
-            /* this gets rid of demented arrow head sizes */
-            /* when ratio of row, cols, levs is wacky*/
-            CROSS( a, dir, up );
-            alen = MAGNITUDE( a );
-
-/* MJK 3.25.99 */            
-            if (alen * len * 0.1 == 0.0){            
-               a[0] = 0.0;            
-               a[1] = 0.0;            
-               a[2] = 0.0;            
-            }            
-            else{            
-               a[0] = a[0] / alen * len * 0.1;
-               a[1] = a[1] / alen * len * 0.1;
-               a[2] = a[2] / alen * len * 0.1;
-            }
+   /* Density: */
+   if (density>MAXWINDDENSITY || density<MINWINDDENSITY)
+     density = MAXWINDDENSITY;
+   drow = (int) (1.0 / density);
+   dcol = (int) (1.0 / density);
 
-            px = arrowx[1] - dir[0] * 0.2;
-            py = arrowy[1] - dir[1] * 0.2;
-            pz = arrowz[1] - dir[2] * 0.2;
-
-            arrowx[2] = px + a[0];
-            arrowy[2] = py + a[1];
-            arrowz[2] = pz + a[2];
-            arrowx[3] = px - a[0];
-            arrowy[3] = py - a[1];
-            arrowz[3] = pz - a[2];
-
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[0], arrowy[0],
-                                       arrowz[0], &arrowr[0], &arrowc[0], &arrowl[0]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[1], arrowy[1],
-                                       arrowz[1], &arrowr[1], &arrowc[1], &arrowl[1]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[2], arrowy[2],
-                                       arrowz[2], &arrowr[2], &arrowc[2], &arrowl[2]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[3], arrowy[3],
-                                       arrowz[3], &arrowr[3], &arrowc[3], &arrowl[3]);
-
-            if (dtx->WindBarbs == 0) {
-               if (len>=0.001) {
-                  if (ctx->dpy_ctx->DisplaySfcHWind[ws]){
-                     vr[vcount] = arrowr[0];
-                     vc[vcount] = arrowc[0];
-                     vl[vcount] = arrowl[0];
-
-                     vr[vcount+1] = arrowr[1];
-                     vc[vcount+1] = arrowc[1];
-                     vl[vcount+1] = arrowl[1];
-
-                     vr[vcount+2] = vr[vcount+1];
-                     vc[vcount+2] = vc[vcount+1];
-                     vl[vcount+2] = vl[vcount+1];
-                     
-                     vr[vcount+3] = arrowr[2];
-                     vc[vcount+3] = arrowc[2];
-                     vl[vcount+3] = arrowl[2];
-                     
-                     vr[vcount+4] = vr[vcount+1];
-                     vc[vcount+4] = vc[vcount+1];
-                     vl[vcount+4] = vl[vcount+1];
-                                          
-                     vr[vcount+5] = arrowr[3];
-                     vc[vcount+5] = arrowc[3];
-                     vl[vcount+5] = arrowl[3];
-                     vcount +=6;
-                  }
-                  else{
-                     vr[vcount] = arrowr[0];
-                     vc[vcount] = arrowc[0];
-                     vl[vcount] = arrowl[0];
+   /* a new scale only needs the arrows of the stored slice again */
+   generation = ctx->GridGeneration;
+   arrows = take_hwind_arrows( dtx, time, ws, level, density, sfc,
+                               prime, generation );
 
-                     vr[vcount+1] = arrowr[1];
-                     vc[vcount+1] = arrowc[1];
-                     vl[vcount+1] = arrowl[1];
+   if (!arrows) {
+      /* Get U, V, W 2-D grids */
+      grid = get_grid( ctx, time, uvar );
+      if (!grid) return;
 
-                     vr[vcount+2] = arrowr[2];
-                     vc[vcount+2] = arrowc[2];
-                     vl[vcount+2] = arrowl[2];
+      /* MJK 12.04.98 */
+      if (sfc){
+         ugrid = extract_sfc_slice (ctx, time, uvar, ctx->Nr, ctx->Nc, grid, 0);
+      }
+      else{
+         ugrid = extract_hslice( ctx, grid, uvar, ctx->Nr, ctx->Nc, ctx->Nl[uvar],
+                                 ctx->Variable[uvar]->LowLev, ctxlevel, 0 );
+      }
+      release_grid( ctx, time, uvar, grid );
 
-                     vr[vcount+3] = arrowr[3];
-                     vc[vcount+3] = arrowc[3];
-                     vl[vcount+3] = arrowl[3];
+      grid = get_grid( ctx, time, vvar );
+      if (!grid) return;
 
-                     vcount+=4;
-                  }
-                  /* Used to debug R8000 -O2/O3 bug:
-                  if (vcount==12) {
-                     int ii;
-                     printf("\n");
-                     for (ii=0;ii<12;ii++) {
-                        printf("%g %g %g\n", vr[ii], vc[ii], vl[ii] );
-                     }
-                     printf("  %g %g %g  %g %g %g\n", pr, pc, pl, a[0], a[1], a[2] );
-                  }*/
-               }
-            }
-            else{
-               dir[0] = arrowr[1] - arrowr[0];
-               dir[1] = arrowc[1] - arrowc[0];
-               dir[2] = arrowl[1] - arrowl[0];
+      /* MJK 12.04.98 */
+      if (sfc){
+         vgrid = extract_sfc_slice (ctx, time, vvar, ctx->Nr, ctx->Nc, grid, 0);
+      }
+      else{
+         vgrid = extract_hslice( ctx, grid, vvar, ctx->Nr, ctx->Nc, ctx->Nl[vvar],
+                              ctx->Variable[vvar]->LowLev, ctxlevel, 0 );
+      }
+      release_grid( ctx, time, vvar, grid );
 
-               len = MAGNITUDE( dir );
+      wgrid = NULL;
+      if (wvar>-1) {
+         grid = get_grid( ctx, time, wvar );
+         if (!grid) return;
+         wgrid = extract_hslice( ctx, grid, wvar, ctx->Nr, ctx->Nc, ctx->Nl[wvar],
+                                 ctx->Variable[wvar]->LowLev, ctxlevel, 0 );
+         release_grid( ctx, time, wvar, grid );
+      }
 
-               up[0] = 0.0;  up[1] = 0.0;  up[2] = 1.0;
+      /* calculate the arrows in graphics space */
+      if (hwind_points( ctx, ugrid, vgrid, wgrid, ctxlevel, drow, dcol, &pts )) {
+         arrows = make_wind_arrows( ctx, time, displaytime, uvar, prime,
+                                    &pts, WINDXH_TYPE );
+         free_wind_points( &pts );
+      }
 
-               make_barb(dtx, u, v, w, dir, up, (float) row, (float) col, ctxlevel,
-                       vr, vc, vl, drow, &vcount);
-            }
-         } /* end if U, V & W not MISSING */
-      } /* end for (col=... */
-   } /* end for (row=... */
+      /* deallocate 2-D grids */
+      deallocate( ctx, ugrid, -1 );
+      deallocate( ctx, vgrid, -1 );
+      if (wgrid){
+        deallocate( ctx, wgrid, -1 );
+      }
+      if (!arrows) {
+         printf(" You do not have enough memory to create hwinds.\n");
+         return;
+      }
+   }
 
-   /* deallocate 2-D grids */
-   deallocate( ctx, ugrid, -1 );
-   deallocate( ctx, vgrid, -1 );
-   if (wvar>-1){
-     deallocate( ctx, wgrid, -1 );
+   /* calculate vector vertices */
+   vcount = make_wind_vectors( ctx, time, uvar, arrows, scale, 0,
+                               dtx->WindBarbs, drow, sfc, &vr, &vc, &vl );
+   if (vcount<0) {
+      printf(" You do not have enough memory to create hwinds.\n");
+      free_wind_arrows( ctx, arrows );
+      return;
    }
+
    /*
     * Bounding rectangle
     */
@@ -4054,12 +3643,13 @@ static void calc_hwindslicePRIME( Display_Context dtx, int displaytime, int ws,
 
    /************************ Compress ********************************/
 
-   /* MJK 12.09.98 */
-   if (ctx->dpy_ctx->DisplaySfcHWind[ws]){
+
+   /* MJK 12.04.98 */
+   if (sfc){
       vcount = fit_vecs_to_topo (ctx, vcount, MAX_WIND_VERTS, vr, vc, vl);
    }
 
-
+ 
    if (vcount>0) {
       PTRINT bytes = 3L*(PTRINT)vcount*(PTRINT)sizeof(int_vert2);
       cverts = (int_vert2 *) allocate_type( ctx, bytes, WINDXH_TYPE );
@@ -4094,13 +3684,18 @@ static void calc_hwindslicePRIME( Display_Context dtx, int displaytime, int ws,
    dtx->HWindTable[ws][time].level = level;
    dtx->HWindTable[ws][time].density = density;
    dtx->HWindTable[ws][time].scale = scale;
+   dtx->HWindTable[ws][time].prime = prime;
+   dtx->HWindTable[ws][time].generation = generation;
+   dtx->HWindTable[ws][time].geometry = dtx->GeometryGeneration;
    dtx->HWindTable[ws][time].nvectors = vcount;  /* 4 vertices / vector */
    dtx->HWindTable[ws][time].verts = cverts;
    dtx->HWindTable[ws][time].boxverts = boxverts;
    dtx->HWindTable[ws][time].numboxverts = numboxverts;
+   dtx->HWindTable[ws][time].sfc = sfc;
+   dtx->HWindTable[ws][time].arrows = arrows;
    dtx->HWindTable[ws][time].valid = 1;
    dtx->HWindTable[ws][time].barbs = dtx->WindBarbs;
-   dtx->HWindTable[ws][time].uvarowner = ctx->context_index;
+   dtx->HWindTable[ws][time].uvarowner = ctx->context_index; 
    done_write_lock( &dtx->HWindTable[ws][time].lock );
 
    if (time==ctx->CurTime) {
@@ -4112,6 +3707,7 @@ static void calc_hwindslicePRIME( Display_Context dtx, int displaytime, int ws,
 }
 
 
+
 static void calc_vclip( Display_Context dtx, int num, float r1,
                         float c1, float r2, float c2)
 {
@@ -4284,366 +3880,171 @@ static void calc_hclip( Display_Context dtx, int num, float level)
 
 
 /*
- * Compute vectors in a vertical wind slice.
- * Input:  displaytime - which display timestep
- *         ws - which wind slice [0,WINDSLICES-1]
- *         r1, c1 - display row, column of left end of slice
- *         r2, c2 - display row, column of right end of slice
- *         scale - user scaling factor  (1.0 is typical)
- *         density - user density factor  1.0, 0.5, 0.25, etc.
- *         threadnum - which thread
+ * Take the wind vectors of a vertical wind slice, with their (v,u,w)
+ * components in place of the tips.
+ * Input:  ugrid, vgrid, wgrid - 2-D slices of U, V, W; wgrid may be NULL
+ *         rows, cols - size of the slices
+ *         drow - step between rows of vectors
+ *         r1, c1 - grid row, column of the left end of the slice
+ *         dr, dc - grid rows, columns between columns of the slice
+ *         lowlev - grid level of the slice's bottom row
+ * Output:  pts - the vectors, allocated here
+ * Return:  1 = ok, 0 = out of memory
  */
-static void calc_vwindslice( Display_Context dtx, int displaytime, int ws,
-                             float r1, float c1, float r2, float c2,
-                             float scale, float density,
-                             int threadnum )
+static int vwind_points( const float *ugrid, const float *vgrid,
+                         const float *wgrid, int rows, int cols, int drow,
+                         float r1, float c1, float dr, float dc,
+                         float lowlev, struct wind_points *pts )
 {
-   Context ctx;
-   float *grid,  *ugrid, *vgrid, *wgrid;
-   int row, col, rows, cols, drow;
-   float *vr, *vc, *vl;
-
-   int vcount;
-   int_vert2 *cverts;
-   int uvar, vvar, wvar;
-   float dr, dc;
-   int numboxverts;
-   float *boxverts;
-   float up[3];
-
-   int time;
-
-   float arrowr[4], arrowc[4], arrowl[4];
-   float arrowx[4], arrowy[4], arrowz[4];
-   float boxy, px, py, pz;
-
-
-   /* Determine which variables to use for U,V,W */
-   uvar = dtx->Uvar[ws];
-   vvar = dtx->Vvar[ws];
-   wvar = dtx->Wvar[ws];
-
-   ctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, dtx->Uvarowner[ws])];
-   if (!ctx){
-      printf("error in getting ctx in calc_vwindslice\n");
-   }
-
-   time = dtx->TimeStep[displaytime].ownerstimestep[return_ctx_index_pos(dtx, ctx->context_index)];   if (displaytime > 0){
-      int timebefore;
-      timebefore = dtx->TimeStep[displaytime-1].ownerstimestep[
-                   return_ctx_index_pos(dtx, ctx->context_index)];
-      if (time == timebefore){
-         return;
-      }
-   }
-
-   if (uvar<0 || vvar<0) {
-      /* no wind variables specified */
-      return;
-   }
-
-
-   /*  YO if (dtx->Variable[uvar]->LowLev != dtx->Variable[vvar]->LowLev ||
-       (wvar>-1 && ctx->Variable[uvar]->LowLev != ctx->Variable[wvar]->LowLev)) {
-      * wind low levels must match *
-      return;
-   }*/
-
-   /* Density: */
-   if (density>MAXWINDDENSITY || density<MINWINDDENSITY)
-     density = MAXWINDDENSITY;
-
-   /* size of 2-D slice */
-   rows = ctx->Nl[uvar];
-   cols = MAX(ctx->Nr,ctx->Nc) * density;
-
-   /* WLH 15 Oct 98 */
-   if (rows <= 1 || cols <= 1) return;
-
-   /* get u, v, w grid slices */
-   grid = get_grid( ctx, time, uvar );
-   if (!grid) return;
-   ugrid = extract_vslice( ctx, grid, r1,c1, r2,c2, rows, cols, 0 );
-   release_grid( ctx, time, uvar, grid );
+   int row, col, n;
 
-   grid = get_grid( ctx, time, vvar );
-   if (!grid) return;
-   vgrid = extract_vslice( ctx, grid, r1,c1, r2,c2, rows, cols, 0 );
-   release_grid( ctx, time, vvar, grid );
-
-   if (wvar>-1) {
-      grid = get_grid( ctx, time, wvar );
-      if (!grid) return;
-      wgrid = extract_vslice( ctx, grid, r1,c1, r2,c2, rows, cols, 0 );
-      release_grid( ctx, time, wvar, grid );
-   }
-
-   vr = (float *) malloc(sizeof(float)*MAX_WIND_VERTS);
-   vc = (float *) malloc(sizeof(float)*MAX_WIND_VERTS);
-   vl = (float *) malloc(sizeof(float)*MAX_WIND_VERTS);
-   if (!vr || !vc || !vl){
-      printf(" You do not have enough memory to create vwinds.\n");
-      if (vr){
-         free(vr);
-      }
-      if (vc){
-         free(vc);
-      }
-      if (vl){
-         free(vl);
-      }
-      deallocate( ctx, ugrid, -1 );
-      deallocate( ctx, vgrid, -1 );
-      if (wvar>-1){
-        deallocate( ctx, wgrid, -1 );
-      }
-      return;
+   if (!alloc_wind_points( pts, ((rows+drow-1)/drow) * cols )) {
+      return 0;
    }
-
-   drow = (int) (1.0 / density);     /* in slice coords */
-   dr = (r2-r1) / (float) (cols-1);  /* delta row and column in */
-   dc = (c2-c1) / (float) (cols-1);  /* 3-d grid coords */
-
-   /* "upward" vector */
-   up[0] = dc;  up[1] = dr;  up[2] = 0.0;
-   NORMALIZE( up );
-
-   /* Compute vectors */
-   vcount = 0;
-   boxy = dtx->Xmax-dtx->Xmin;
-   for (row=0; row<rows && vcount+40<MAX_WIND_VERTS; row+=drow) {
+   n = 0;
+   for (row=0; row<rows; row+=drow) {
       float gr = (float) r1;
       float gc = (float) c1;
-      float gl = (float) (row + ctx->Variable[uvar]->LowLev);
-      for (col=0; col<cols && vcount+40<MAX_WIND_VERTS; col++) {
-         float u, v, w;
-         float dir[3];  /* wind vector direction */
-         float a[3];  /* up & across vectors */
-         float    len, alen;
+      float gl = (float) row + lowlev;
+      for (col=0; col<cols; col++, gr+=dr, gc+=dc) {
+         float u = ugrid[row*cols+col];
+         float v = vgrid[row*cols+col];
+         float w = wgrid ? wgrid[row*cols+col] : 0.0;
 
-
-         u = ugrid[row*cols+col];
-         v = vgrid[row*cols+col];
-         w = (wvar>-1) ? wgrid[row*cols+col] : 0.0;
          if (IS_MISSING(u) || IS_MISSING(v) || IS_MISSING(w)) {
             /* if u, v, or w is missing, draw no vector */
+            continue;
          }
-         else {
-            float newlen, oldlen, factor;
-
-            oldlen = sqrt (u * u + v * v + w * w);
-
-            /* make wind arrows parallel to trajectories */
-            dir[0] = v * ctx->Vscale[(int) gr][(int) gc];
-            dir[1] = u * ctx->Uscale[(int) gr][(int) gc];
-            dir[2] = w * ctx->Wscale[(int) gl];
-
-            len = MAGNITUDE( dir );
-            arrowr[0] = gr;
-            arrowc[0] = gc;
-            arrowl[0] = gl;
-
-            arrowr[1] = gr + dir[0];
-            arrowc[1] = gc + dir[1];
-            arrowl[1] = gl + dir[2];
-
-            /* get xyz arrow */
-            gridPRIME_to_xyzPRIME( dtx, time, uvar, 2, arrowr, arrowc,
-                                    arrowl, arrowx, arrowy, arrowz);
-
-            dir[0] = arrowx[1] - arrowx[0];
-            dir[1] = arrowy[1] - arrowy[0];
-            dir[2] = arrowz[1] - arrowz[0];
-
-            newlen = MAGNITUDE( dir );
-            factor = (newlen > 0.0000001) ? oldlen / newlen :
-                                            oldlen / 0.0000001;
-
-            /* multiply vector by factor in graphics space */
-            factor = (factor / 25.0) * (boxy * 0.03) * scale;
-
-            dir[0] *= factor;
-            dir[1] *= factor;
-            dir[2] *= factor;
-
-            len = MAGNITUDE( dir );
-
-            if ((dir[1]>len/2.0 || dir[1]<-len/2.0) && dtx->WindBarbs == 0) {
-              up[0] = 1.0;  up[1] = 0.0;  up[2] = 0.0;
-            }
-            else{
-              up[0] = 0.0;  up[1] = 1.0;  up[2] = 0.0;
-            }
-
-            arrowx[1] = arrowx[0] + dir[0];
-            arrowy[1] = arrowy[0] + dir[1];
-            arrowz[1] = arrowz[0] + dir[2];
-
-            /* create arrow head in graphics space too!.. */
-            /* this gets rid of demented arrow head sizes */
-            /* when ratio of row, cols, levs is wacky*/
-            CROSS( a, dir, up );
-            alen = MAGNITUDE( a );
-
-/* MJK 3.25.99 */            
-            if (alen * len * 0.1 == 0.0){            
-               a[0] = 0.0;            
-               a[1] = 0.0;            
-               a[2] = 0.0;            
-            }            
-            else{            
-               a[0] = a[0] / alen * len * 0.1;
-               a[1] = a[1] / alen * len * 0.1;
-               a[2] = a[2] / alen * len * 0.1;
-            }
-
-            px = arrowx[1] - dir[0] * 0.2;
-            py = arrowy[1] - dir[1] * 0.2;
-            pz = arrowz[1] - dir[2] * 0.2;
-
-            arrowx[2] = px + a[0];
-            arrowy[2] = py + a[1];
-            arrowz[2] = pz + a[2];
-            arrowx[3] = px - a[0];
-            arrowy[3] = py - a[1];
-            arrowz[3] = pz - a[2];
-
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[0], arrowy[0],
-                                       arrowz[0], &arrowr[0], &arrowc[0], &arrowl[0]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[1], arrowy[1],
-                                       arrowz[1], &arrowr[1], &arrowc[1], &arrowl[1]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[2], arrowy[2],
-                                       arrowz[2], &arrowr[2], &arrowc[2], &arrowl[2]);
-            xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[3], arrowy[3],
-                                       arrowz[3], &arrowr[3], &arrowc[3], &arrowl[3]);
-
-            if (dtx->WindBarbs == 0) {
-               if (len>=0.001) {
-                  vr[vcount] = arrowr[0];
-                  vc[vcount] = arrowc[0];
-                  vl[vcount] = arrowl[0];
-
-                  vr[vcount+1] = arrowr[1];
-                  vc[vcount+1] = arrowc[1];
-                  vl[vcount+1] = arrowl[1];
-
-                  vr[vcount+2] = arrowr[2];
-                  vc[vcount+2] = arrowc[2];
-                  vl[vcount+2] = arrowl[2];
-
-                  vr[vcount+3] = arrowr[3];
-                  vc[vcount+3] = arrowc[3];
-                  vl[vcount+3] = arrowl[3];
-
-                  vcount+=4;
-                  /* Used to debug R8000 -O2/O3 bug:
-                  if (vcount==12) {
-                     int ii;
-                     printf("\n");
-                     for (ii=0;ii<12;ii++) {
-                        printf("%g %g %g\n", vr[ii], vc[ii], vl[ii] );
-                     }
-                     printf("  %g %g %g  %g %g %g\n", pr, pc, pl, a[0], a[1], a[2] );
-                  }*/
-               }
-            }
-            else{
-               dir[0] = arrowr[1] - arrowr[0];
-               dir[1] = arrowc[1] - arrowc[0];
-               dir[2] = arrowl[1] - arrowl[0];
-
-               len = MAGNITUDE( dir );
-
-
-               make_barb(dtx, u, v, w, dir, up, arrowr[0], arrowc[0], arrowl[0],
-                       vr, vc, vl, drow, &vcount);
-            }
-         } /* end if U, V & W not MISSING */
-         gr += dr;
-         gc += dc;
-      } /* end for (col=... */
-   } /* end for (row=... */
-
-   /* deallocate 2-D slices */
-   deallocate( ctx, ugrid, -1 );
-   deallocate( ctx, vgrid, -1 );
-   if (wvar>-1){
-     deallocate( ctx, wgrid, -1 );
+         pts->br[n] = gr;
+         pts->bc[n] = gc;
+         pts->bl[n] = gl;
+         pts->tr[n] = v;
+         pts->tc[n] = u;
+         pts->tl[n] = w;
+         pts->speed[n] = sqrt( u*u + v*v + w*w );
+         n++;
+      }
    }
+   pts->n = n;
+   return 1;
+}
 
-   /*
-    * Bounding rectangle
-    */
-   numboxverts = make_vertical_rectangle( ctx, time, uvar, dtx->CurvedBox,
-                                          r1, c1, r2, c2, cols, &boxverts );
 
-   /*************************** Compress *******************************/
 
-   if (vcount>0) {
-      PTRINT bytes = 3L*(PTRINT)vcount*(PTRINT)sizeof(int_vert2);
-      cverts = (int_vert2 *) allocate_type( ctx, bytes, WINDXV_TYPE );
-      if (!cverts) {
-         deallocate( ctx, cverts, bytes);
-         cverts = NULL;
-         vcount = 0;
-      }
-      else {
-         gridPRIME_to_compXYZPRIME( dtx, time, uvar, vcount, vr, vc, vl, (void*)cverts );
-      }
-   }
-   else {
-      vcount = 0;
-      cverts= NULL;
-   }
+/*
+ * Turn the (v,u,w) components which vwind_points() left in the tips into
+ * the tips, base + components in grid boxes.  With prime set the points
+ * are in display grid coordinates: the scale factors are then taken at
+ * their context grid coordinates, found with one gridPRIME_to_grid()
+ * call, and points outside the context's grid are dropped.
+ * Return:  1 = ok, 0 = out of memory
+ */
+static int vwind_tips( Context ctx, int displaytime, int var, int prime,
+                       struct wind_points *pts )
+{
+   float *cr, *cc, *cl;
+   int i, k, n = pts->n;
+
+   if (!prime) {
+      for (i=0;i<n;i++) {
+         int r = (int) pts->br[i], c = (int) pts->bc[i];
 
-   /************************ Store wind slice ***************************/
-   recent( ctx, VWIND, ws );
+         /* make wind arrows parallel to trajectories */
+         pts->tr[i] = pts->br[i] + pts->tr[i] * ctx->Vscale[r][c];
+         pts->tc[i] = pts->bc[i] + pts->tc[i] * ctx->Uscale[r][c];
+         pts->tl[i] = pts->bl[i] + pts->tl[i] * ctx->Wscale[(int) pts->bl[i]];
+      }
+      return 1;
+   }
 
-   wait_write_lock( &dtx->VWindTable[ws][time].lock );
+   cr = (float *) malloc( 3L * (PTRINT) MAX( n, 1 ) * sizeof(float) );
+   if (!cr) {
+      return 0;
+   }
+   cc = cr + n;
+   cl = cc + n;
+   gridPRIME_to_grid( ctx, displaytime, var, n, pts->br, pts->bc, pts->bl,
+                      cr, cc, cl );
+   k = 0;
+   for (i=0;i<n;i++) {
+      int r = (int) cr[i], c = (int) cc[i], l = (int) cl[i];
+      float v = pts->tr[i], u = pts->tc[i], w = pts->tl[i];
+
+      if (r < 0 || r > ctx->Nr || c < 0 || c > ctx->Nc ||
+          l < 0 || l > ctx->Nl[var]) {
+         /* don't draw it then ! */
+         continue;
+      }
+      pts->br[k] = pts->br[i];
+      pts->bc[k] = pts->bc[i];
+      pts->bl[k] = pts->bl[i];
+      pts->tr[k] = pts->br[i] + v * ctx->Vscale[r][c];
+      pts->tc[k] = pts->bc[i] + u * ctx->Uscale[r][c];
+      pts->tl[k] = pts->bl[i] + w * ctx->Wscale[l];
+      pts->speed[k] = pts->speed[i];
+      k++;
+   }
+   pts->n = k;
+   free( cr );
+   return 1;
+}
 
-   /* deallocate existing slice, if any */
-   free_vwind( dtx, time, ws );
 
-   /* store new slice */
-   dtx->VWindTable[ws][time].uvar = dtx->Uvar[ws];
-   dtx->VWindTable[ws][time].vvar = dtx->Vvar[ws];
-   dtx->VWindTable[ws][time].wvar = dtx->Wvar[ws];
-   dtx->VWindTable[ws][time].uvarowner = dtx->Uvarowner[ws];
-   dtx->VWindTable[ws][time].vvarowner = dtx->Vvarowner[ws];
-   dtx->VWindTable[ws][time].wvarowner = dtx->Wvarowner[ws];
-   dtx->VWindTable[ws][time].r1 = r1;
-   dtx->VWindTable[ws][time].c1 = c1;
-   dtx->VWindTable[ws][time].r2 = r2;
-   dtx->VWindTable[ws][time].c2 = c2;
-   dtx->VWindTable[ws][time].density = density;
-   dtx->VWindTable[ws][time].scale = scale;
-   dtx->VWindTable[ws][time].nvectors = vcount;   /* 4 vertices / vector */
-   dtx->VWindTable[ws][time].verts = cverts;
-   dtx->VWindTable[ws][time].numboxverts = numboxverts;
-   dtx->VWindTable[ws][time].boxverts = boxverts;
-   dtx->VWindTable[ws][time].valid = 1;
-   dtx->VWindTable[ws][time].barbs = dtx->WindBarbs;
-   dtx->VWindTable[ws][time].uvarowner = ctx->context_index;
-   done_write_lock( &dtx->VWindTable[ws][time].lock );
 
-   if (time==ctx->CurTime) {
-      dtx->Redraw = 1;
-   }
-   free(vr);
-   free(vc);
-   free(vl);
+/*
+ * Take back the arrows of a stored vertical wind slice if it was made
+ * from the same winds at the same position and density, see
+ * take_hwind_arrows().
+ */
+static struct wind_arrows *take_vwind_arrows( Display_Context dtx, int time,
+                                              int ws, float r1, float c1,
+                                              float r2, float c2,
+                                              float density, int prime,
+                                              int generation )
+{
+   struct vwind *vw = &dtx->VWindTable[ws][time];
+   struct wind_arrows *arrows = NULL;
+
+   wait_write_lock( &vw->lock );
+   if (vw->valid && vw->arrows &&
+       vw->uvar==dtx->Uvar[ws] && vw->vvar==dtx->Vvar[ws] &&
+       vw->wvar==dtx->Wvar[ws] &&
+       vw->uvarowner==dtx->Uvarowner[ws] &&
+       vw->vvarowner==dtx->Vvarowner[ws] &&
+       vw->wvarowner==dtx->Wvarowner[ws] &&
+       vw->r1==r1 && vw->c1==c1 && vw->r2==r2 && vw->c2==c2 &&
+       vw->density==density && vw->prime==prime &&
+       vw->generation==generation &&
+       vw->geometry==dtx->GeometryGeneration) {
+      arrows = vw->arrows;
+      vw->arrows = NULL;
+   }
+   done_write_lock( &vw->lock );
+   return arrows;
 }
 
 
 
-static void calc_vwindslicePRIME( Display_Context dtx, int displaytime, int ws,
+/*
+ * Compute vectors in a vertical wind slice.
+ * Input:  displaytime - which display timestep
+ *         ws - which wind slice [0,WINDSLICES-1]
+ *         r1, c1 - display row, column of left end of slice
+ *         r2, c2 - display row, column of right end of slice
+ *         scale - user scaling factor  (1.0 is typical)
+ *         density - user density factor  1.0, 0.5, 0.25, etc.
+ *         prime - 0 = the context's grid is the display's grid,
+ *                 1 = carry the vectors over from the context's grid
+ *         threadnum - which thread
+ */
+static void calc_vwindslice( Display_Context dtx, int displaytime, int ws,
                              float r1, float c1, float r2, float c2,
                              float scale, float density,
-                             int threadnum )
+                             int prime, int threadnum )
 {
    Context ctx;
    float *grid,  *ugrid, *vgrid, *wgrid;
-   int row, col, rows, cols, drow;
+   int rows, cols, drow;
    float *vr, *vc, *vl;
 
    int vcount;
@@ -4652,15 +4053,11 @@ static void calc_vwindslicePRIME( Display_Context dtx, int displaytime, int ws,
    float dr, dc;
    int numboxverts;
    float *boxverts;
-   float up[3];
+   struct wind_arrows *arrows;
+   struct wind_points pts;
+   int generation;
 
    int time;
-   float jlat[2], jlon[2], jhgt[2];
-   float jx[2], jy[2], jz[2];
-   float arrowr[4], arrowc[4], arrowl[4];
-   float arrowx[4], arrowy[4], arrowz[4];
-   float boxy, px, py, pz;
-
 
 
    /* Determine which variables to use for U,V,W */
@@ -4699,254 +4096,91 @@ static void calc_vwindslicePRIME( Display_Context dtx, int displaytime, int ws,
      density = MAXWINDDENSITY;
 
    /* size of 2-D slice */
-   rows = dtx->Nl;
-   cols = MAX(dtx->Nr,dtx->Nc) * density;
-
-   /* get u, v, w grid slices */
-   grid = get_grid( ctx, time, uvar );
-   if (!grid) return;
-   ugrid = extract_vslicePRIME( ctx, grid, time, uvar, r1,c1, r2,c2, rows, cols, 0 );
-   release_grid( ctx, time, uvar, grid );
-
-   grid = get_grid( ctx, time, vvar );
-   if (!grid) return;
-   vgrid = extract_vslicePRIME( ctx, grid, time, vvar, r1,c1, r2,c2, rows, cols, 0 );
-   release_grid( ctx, time, vvar, grid );
-
-   if (wvar>-1) {
-      grid = get_grid( ctx, time, wvar );
-      if (!grid) return;
-      wgrid = extract_vslicePRIME( ctx, grid, time, wvar, r1,c1, r2,c2, rows, cols, 0 );
-      release_grid( ctx, time, wvar, grid );
+   if (prime) {
+      rows = dtx->Nl;
+      cols = MAX(dtx->Nr,dtx->Nc) * density;
    }
+   else {
+      rows = ctx->Nl[uvar];
+      cols = MAX(ctx->Nr,ctx->Nc) * density;
 
-   vr = (float *) malloc(sizeof(float)*MAX_WIND_VERTS);
-   vc = (float *) malloc(sizeof(float)*MAX_WIND_VERTS);
-   vl = (float *) malloc(sizeof(float)*MAX_WIND_VERTS);
-   if (!vr || !vc || !vl){
-      printf(" You do not have enough memory to create vwinds.\n");
-      if (vr){
-         free(vr);
-      }
-      if (vc){
-         free(vc);
-      }
-      if (vl){
-         free(vl);
-      }
-      deallocate( ctx, ugrid, -1 );
-      deallocate( ctx, vgrid, -1 );
-      if (wvar>-1){
-        deallocate( ctx, wgrid, -1 );
-      }
-      return;
+      /* WLH 15 Oct 98 */
+      if (rows <= 1 || cols <= 1) return;
    }
 
    drow = (int) (1.0 / density);     /* in slice coords */
    dr = (r2-r1) / (float) (cols-1);  /* delta row and column in */
    dc = (c2-c1) / (float) (cols-1);  /* 3-d grid coords */
 
-   /* "upward" vector */
-   up[0] = dc;  up[1] = dr;  up[2] = 0.0;
-   NORMALIZE( up );
-
-   /* Compute vectors */
-   vcount = 0;
-   boxy = dtx->Xmax-dtx->Xmin;
-   for (row=0; row<rows && vcount+40<MAX_WIND_VERTS; row+=drow) {
-      float gr = (float) r1;
-      float gc = (float) c1;
-      float gl = (float) (row + dtx->LowLev);
-      for (col=0; col<cols && vcount+40<MAX_WIND_VERTS; col++) {
-         float u, v, w;
-         float dir[3];  /* wind vector direction */
-         float a[3];  /* up & across vectors */
-         float    len, alen;
-
+   /* a new scale only needs the arrows of the stored slice again */
+   generation = ctx->GridGeneration;
+   arrows = take_vwind_arrows( dtx, time, ws, r1, c1, r2, c2, density,
+                               prime, generation );
 
+   if (!arrows) {
+      /* get u, v, w grid slices */
+      grid = get_grid( ctx, time, uvar );
+      if (!grid) return;
+      if (prime) {
+         ugrid = extract_vslicePRIME( ctx, grid, time, uvar, r1,c1, r2,c2, rows, cols, 0 );
+      }
+      else {
+         ugrid = extract_vslice( ctx, grid, r1,c1, r2,c2, rows, cols, 0 );
+      }
+      release_grid( ctx, time, uvar, grid );
 
+      grid = get_grid( ctx, time, vvar );
+      if (!grid) return;
+      if (prime) {
+         vgrid = extract_vslicePRIME( ctx, grid, time, vvar, r1,c1, r2,c2, rows, cols, 0 );
+      }
+      else {
+         vgrid = extract_vslice( ctx, grid, r1,c1, r2,c2, rows, cols, 0 );
+      }
+      release_grid( ctx, time, vvar, grid );
 
-         u = ugrid[row*cols+col];
-         v = vgrid[row*cols+col];
-         w = (wvar>-1) ? wgrid[row*cols+col] : 0.0;
-         if (IS_MISSING(u) || IS_MISSING(v) || IS_MISSING(w)) {
-            /* if u, v, or w is missing, draw no vector */
+      wgrid = NULL;
+      if (wvar>-1) {
+         grid = get_grid( ctx, time, wvar );
+         if (!grid) return;
+         if (prime) {
+            wgrid = extract_vslicePRIME( ctx, grid, time, wvar, r1,c1, r2,c2, rows, cols, 0 );
          }
          else {
-           float newlen, oldlen, factor;
-           float grC, gcC, glC;
-
-           oldlen = sqrt (u * u + v * v + w * w);
-
-           /* make wind arrows parallel to trajectories */
-           gridPRIME_to_grid(ctx, displaytime, uvar, 1, &gr, &gc, &gl,
-                             &grC, &gcC, &glC);
-           if ((int) (grC) < 0.0 || (int) (grC) > ctx->Nr ||
-               (int) (gcC) < 0.0 || (int) (gcC) > ctx->Nc ||
-               (int) (glC) < 0.0 || (int) (glC) > ctx->Nl[uvar]){
-              /* don't draw it then ! */
-           }
-           else{
-             dir[0] = v * ctx->Vscale[(int) grC][(int) gcC];
-             dir[1] = u * ctx->Uscale[(int) grC][(int) gcC];
-             dir[2] = w * ctx->Wscale[(int) glC];
-
-             len = MAGNITUDE( dir );
-             arrowr[0] = gr;
-             arrowc[0] = gc;
-             arrowl[0] = gl;
-
-             arrowr[1] = gr + dir[0];
-             arrowc[1] = gc + dir[1];
-             arrowl[1] = gl + dir[2];
-
-             /* get xyz arrow */
-             grid_to_xyz( ctx, time, uvar, 2, arrowr, arrowc,
-                                    arrowl, arrowx, arrowy, arrowz);
-
-             dir[0] = arrowx[1] - arrowx[0];
-             dir[1] = arrowy[1] - arrowy[0];
-             dir[2] = arrowz[1] - arrowz[0];
-
-             newlen = MAGNITUDE( dir );
-             factor = (newlen > 0.0000001) ? oldlen / newlen :
-                                             oldlen / 0.0000001;
-
-             /* multiply vector by factor in graphics space */
-             factor = (factor / 25.0) * (boxy * 0.03) * scale;
-
-             dir[0] *= factor;
-             dir[1] *= factor;
-             dir[2] *= factor;
-
-             len = MAGNITUDE( dir );
-
-             /* get small unit vector! */
-             arrowx[1] = arrowx[0] + (dir[0]/(len*100));
-             arrowy[1] = arrowy[0] + (dir[1]/(len*100));
-             arrowz[1] = arrowz[0] + (dir[2]/(len*100));
-
-             xyz_to_geo( ctx, time, uvar, arrowx[0], arrowy[0],
-                            arrowz[0], &jlat[0], &jlon[0], &jhgt[0]);
-             xyz_to_geo( ctx, time, uvar, arrowx[1], arrowy[1],
-                            arrowz[1], &jlat[1], &jlon[1], &jhgt[1]);
-
-             geo_to_xyzPRIME(dtx, displaytime, uvar, 2, jlat, jlon,
-                                  jhgt, jx, jy, jz);
-
-             /* now get vector in PRIME space */
-             arrowx[0] = jx[0];
-             arrowy[0] = jy[0];
-             arrowz[0] = jz[0];
-
-             arrowx[1] = jx[0] + 100*len*(jx[1] - jx[0]);
-             arrowy[1] = jy[0] + 100*len*(jy[1] - jy[0]);
-             arrowz[1] = jz[0] + 100*len*(jz[1] - jz[0]);
-
-             dir[0] = arrowx[1] - arrowx[0];
-             dir[1] = arrowy[1] - arrowy[0];
-             dir[2] = arrowz[1] - arrowz[0];
-
-             len = MAGNITUDE( dir );
-
-             if ((dir[1]>len/2.0 || dir[1]<-len/2.0) && dtx->WindBarbs == 0) {
-               up[0] = 1.0;  up[1] = 0.0;  up[2] = 0.0;
-             }
-             else{
-               up[0] = 0.0;  up[1] = 1.0;  up[2] = 0.0;
-             }
-
-             /* create arrow head in graphics space too!.. */
-             /* this gets rid of demented arrow head sizes */
-             /* when ratio of row, cols, levs is wacky*/
-             CROSS( a, dir, up );
-             alen = MAGNITUDE( a );
-
-/* MJK 3.25.99 */            
-             if (alen * len * 0.1 == 0.0){            
-                a[0] = 0.0;            
-                a[1] = 0.0;            
-                a[2] = 0.0;            
-             }            
-             else{            
-                a[0] = a[0] / alen * len * 0.1;
-                a[1] = a[1] / alen * len * 0.1;
-                a[2] = a[2] / alen * len * 0.1;
-             }
-
-             px = arrowx[1] - dir[0] * 0.2;
-             py = arrowy[1] - dir[1] * 0.2;
-             pz = arrowz[1] - dir[2] * 0.2;
-
-             arrowx[2] = px + a[0];
-             arrowy[2] = py + a[1];
-             arrowz[2] = pz + a[2];
-             arrowx[3] = px - a[0];
-             arrowy[3] = py - a[1];
-             arrowz[3] = pz - a[2];
-
-             xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[0], arrowy[0],
-                                        arrowz[0], &arrowr[0], &arrowc[0], &arrowl[0]);
-             xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[1], arrowy[1],
-                                        arrowz[1], &arrowr[1], &arrowc[1], &arrowl[1]);
-             xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[2], arrowy[2],
-                                        arrowz[2], &arrowr[2], &arrowc[2], &arrowl[2]);
-             xyzPRIME_to_gridPRIME( dtx, time, uvar, arrowx[3], arrowy[3],
-                                        arrowz[3], &arrowr[3], &arrowc[3], &arrowl[3]);
-
-             if (dtx->WindBarbs == 0) {
-                if (len>=0.001) {
-                   vr[vcount] = arrowr[0];
-                   vc[vcount] = arrowc[0];
-                   vl[vcount] = arrowl[0];
-
-                   vr[vcount+1] = arrowr[1];
-                   vc[vcount+1] = arrowc[1];
-                   vl[vcount+1] = arrowl[1];
-
-                   vr[vcount+2] = arrowr[2];
-                   vc[vcount+2] = arrowc[2];
-                   vl[vcount+2] = arrowl[2];
-
-                   vr[vcount+3] = arrowr[3];
-                   vc[vcount+3] = arrowc[3];
-                   vl[vcount+3] = arrowl[3];
-
-                   vcount+=4;
-                   /* Used to debug R8000 -O2/O3 bug:
-                   if (vcount==12) {
-                      int ii;
-                      printf("\n");
-                      for (ii=0;ii<12;ii++) {
-                         printf("%g %g %g\n", vr[ii], vc[ii], vl[ii] );
-                      }
-                      printf("  %g %g %g  %g %g %g\n", pr, pc, pl, a[0], a[1], a[2] );
-                   }*/
-                }
-             }
-             else{
-                dir[0] = arrowr[1] - arrowr[0];
-                dir[1] = arrowc[1] - arrowc[0];
-                dir[2] = arrowl[1] - arrowl[0];
-
-                len = MAGNITUDE( dir );
+            wgrid = extract_vslice( ctx, grid, r1,c1, r2,c2, rows, cols, 0 );
+         }
+         release_grid( ctx, time, wvar, grid );
+      }
 
+      /* calculate the arrows in graphics space */
+      if (vwind_points( ugrid, vgrid, wgrid, rows, cols, drow, r1, c1, dr, dc,
+                        prime ? dtx->LowLev : ctx->Variable[uvar]->LowLev,
+                        &pts ) &&
+          vwind_tips( ctx, displaytime, uvar, prime, &pts )) {
+         arrows = make_wind_arrows( ctx, time, displaytime, uvar, prime,
+                                    &pts, WINDXV_TYPE );
+      }
+      free_wind_points( &pts );
 
-               make_barb(dtx, u, v, w, dir, up, arrowr[0], arrowc[0], arrowl[0],
-                        vr, vc, vl, drow, &vcount);
-             }
-           }
-         } /* end if U, V & W not MISSING */
-         gr += dr;
-         gc += dc;
-       }  /*for col*/
-   } /* for row */
+      /* deallocate 2-D slices */
+      deallocate( ctx, ugrid, -1 );
+      deallocate( ctx, vgrid, -1 );
+      if (wgrid){
+        deallocate( ctx, wgrid, -1 );
+      }
+      if (!arrows) {
+         printf(" You do not have enough memory to create vwinds.\n");
+         return;
+      }
+   }
 
-   /* deallocate 2-D slices */
-   deallocate( ctx, ugrid, -1 );
-   deallocate( ctx, vgrid, -1 );
-   if (wvar>-1){
-     deallocate( ctx, wgrid, -1 );
+   /* Compute vectors */
+   vcount = make_wind_vectors( ctx, time, uvar, arrows, scale, 1,
+                               dtx->WindBarbs, drow, 0, &vr, &vc, &vl );
+   if (vcount<0) {
+      printf(" You do not have enough memory to create vwinds.\n");
+      free_wind_arrows( ctx, arrows );
+      return;
    }
 
    /*
@@ -4995,10 +4229,14 @@ static void calc_vwindslicePRIME( Display_Context dtx, int displaytime, int ws,
    dtx->VWindTable[ws][time].c2 = c2;
    dtx->VWindTable[ws][time].density = density;
    dtx->VWindTable[ws][time].scale = scale;
+   dtx->VWindTable[ws][time].prime = prime;
+   dtx->VWindTable[ws][time].generation = generation;
+   dtx->VWindTable[ws][time].geometry = dtx->GeometryGeneration;
    dtx->VWindTable[ws][time].nvectors = vcount;   /* 4 vertices / vector */
    dtx->VWindTable[ws][time].verts = cverts;
    dtx->VWindTable[ws][time].numboxverts = numboxverts;
    dtx->VWindTable[ws][time].boxverts = boxverts;
+   dtx->VWindTable[ws][time].arrows = arrows;
    dtx->VWindTable[ws][time].valid = 1;
    dtx->VWindTable[ws][time].barbs = dtx->WindBarbs;
    dtx->VWindTable[ws][time].uvarowner = ctx->context_index;
@@ -5920,132 +5158,6 @@ printf("vgrid[ir(%d) * cols(%d) + ic(%d)] = %f\n", ir, cols, ic, vgrid[ir * cols
 
 
 
-/*
- * Compute the color table indexes for a colored trajectory.
- * Input:  ctx - the context where the traju var is located
- *         t - the trajectory struct
- *         cvowner - the coloring variable vis5d_ctx index
- *         colorvar - the coloring variable
- */
-static void color_traj( Context ctx, struct traj *t, int cvowner, int colorvar )
-{
-   Context cvctx;
-   Display_Context dtx;
-   uint_1 *color_indexes;
-   int i, n;
-   float vscale = 1.0 / VERTEX_SCALE;
-   float min, valscale;
-   int time;
-   int cvtime;
-
-   dtx = ctx->dpy_ctx;
-
-   if (ctx->context_index != dtx->TrajUowner){
-      return;
-   }
-
-   cvctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, cvowner)];
-   if (!cvctx){
-      printf("error in getting cvctx in color_traj\n");
-   }
-
-
-   /* Free old color indexes if any */
-   wait_write_lock( &t->lock );
-   if (t->colors) {
-      deallocate( ctx, t->colors, t->length*sizeof(uint_1) );
-   }
-   t->colors = NULL;
-   t->colorvar = -1;
-   done_write_lock( &t->lock );
-
-   if (colorvar!=-1) {
-      /* Allocate storage for new color indexes */
-      n = t->length;
-      color_indexes = allocate( ctx, n*sizeof(uint_1) );
-      if (!color_indexes) {
-         return;
-      }
-
-      min = cvctx->Variable[colorvar]->MinVal;
-      valscale = 1.0F / (cvctx->Variable[colorvar]->MaxVal - cvctx->Variable[colorvar]->MinVal);
-
-      /* Compute color indexes */
-      time = 0;
-      for (i=0;i<n;i++) {
-         float x, y, z;
-         float row, col, lev;
-         float val;
-
-
-         x = t->verts[i*3+0] * vscale;
-         y = t->verts[i*3+1] * vscale;
-         z = t->verts[i*3+2] * vscale;
-
-         cvtime = return_ctx_time(ctx->dpy_ctx, cvctx->context_index, time);
-         if (cvctx->GridSameAsGridPRIME){
-            xyzPRIME_to_gridPRIME( dtx, 0, dtx->TrajU, x, y, z, &row, &col, &lev );
-         }
-         else{
-            xyzPRIME_to_grid( cvctx, cvtime, dtx->TrajU, x, y, z, &row, &col, &lev );
-         }
-            
-         /* find the timestep which corresponds to this traj pos */
-         while (t->start[time]<i && time<dtx->NumTimes-1) {
-            time++;
-         }
-         cvtime = return_ctx_time(ctx->dpy_ctx, cvctx->context_index, time);
-         val = interpolate_grid_value( cvctx, cvtime, colorvar, row, col, lev );
-
-         if (IS_MISSING(val) ||
-             val < cvctx->Variable[colorvar]->MinVal ||
-             val > cvctx->Variable[colorvar]->MaxVal) {
-            color_indexes[i] = 255;
-         }
-         else {
-            int index = (val - min) * valscale * 254.0F;
-            color_indexes[i] = (uint_1) index;
-         }
-      }
-   }
-   else {
-      color_indexes = NULL;
-   }
-
-   /* save results */
-   wait_write_lock( &t->lock );
-   t->colors = color_indexes;
-   t->colorvar = colorvar;
-   t->colorvarowner = cvowner;
-   done_write_lock( &t->lock );
-}
-
-
-
-/*
- * Recolor a set of trajectores to the variable specified by
- * TrajColorVar[traj_set].
- */
-static void recolor_traj_set( Display_Context dtx, int traj_set )
-{
-   Context uvarctx;
-   int i;
-
-   for (i=0;i<dtx->NumTraj;i++) {
-      struct traj *t = dtx->TrajTable[i];
-      if (t->group==traj_set) {
-         if (t->colorvar != dtx->TrajColorVar[traj_set]) {
-            uvarctx = dtx->ctxpointerarray[
-                      return_ctx_index_pos(dtx, dtx->TrajUowner)];
-            color_traj( uvarctx, t, dtx->TrajColorVarOwner[traj_set],
-                                    dtx->TrajColorVar[traj_set] );
-         }
-      }
-   }
-}
-
-
-
 /*
  * Compute a wind trajectory.
  * Input:  row, col, lev - start position in grid coords.
@@ -6054,7 +5166,7 @@ static void recolor_traj_set( Display_Context dtx, int traj_set )
  *         ribbon - 1 = make ribbon traj, 0 = make line segment traj
  *         step_mult - integration step size multiplier (default 1.0)
  *         len_mult - trajectory length multiplier (default 1.0)
- *  Output:  list of coordinates and times are saved in TrajTable.
+ *  Output:  the trajectory is appended to its set, dtx->TrajSet[id].
  */
 static void calc_traj( Display_Context dtx, float row, float col, float lev,
                        int dtime, int id, int ribbon,
@@ -6066,10 +5178,8 @@ static void calc_traj( Display_Context dtx, float row, float col, float lev,
    float r,c,l;
    float *vr, *vc, *vl, *vx, *vy, *vz, *nx, *ny, *nz;
    int *tt;
-   PTRINT vbytes, nbytes;
-   int_vert2 *cverts;
-   int_1 *cnorms;
-   struct traj *t;
+   uint_vert2 *tstart, *tlen;
+   struct traj info;
    int time;
 
    ctx = dtx->ctxpointerarray[return_ctx_index_pos(dtx, dtx->TrajUowner)];
@@ -6224,73 +5334,14 @@ static void calc_traj( Display_Context dtx, float row, float col, float lev,
    }
 
 
-   /****************************** Compress ***************************/
-   vbytes = 3L * (PTRINT)len * (PTRINT)sizeof(int_vert2);
-   cverts = (int_vert2 *) allocate_type( ctx, vbytes, TRAJX_TYPE );
-   if (cverts) {
-      /* convert floats to int_vert2 */
-      for (i=0;i<len;i++) {
-         cverts[i*3+0] = (int_vert2) (vx[i] * VERTEX_SCALE);
-         cverts[i*3+1] = (int_vert2) (vy[i] * VERTEX_SCALE);
-         cverts[i*3+2] = (int_vert2) (vz[i] * VERTEX_SCALE);
-      }
-   }
-   else {
-      len = 0;
-   }
-   /* JPE changed from (ribbon & len>0) whose intention is unclear at best */
-   if (ribbon && (len > 0)) {
-      nbytes = 3L * (PTRINT)len * (PTRINT)sizeof(int_1);
-      cnorms = (int_1 *) allocate_type( ctx, nbytes, TRAJXR_TYPE );
-      if (!cnorms) {
-         deallocate( ctx, cverts, vbytes );
-         cverts = NULL;
-         len = 0;
-      }
-      else {
-         /* compress normals to 1-byte ints */
-         for (i=0;i<len;i++) {
-            cnorms[i*3+0] = (int_1) (int) (-nx[i] * NORMAL_SCALE);
-            cnorms[i*3+1] = (int_1) (int) ( ny[i] * NORMAL_SCALE);
-            cnorms[i*3+2] = (int_1) (int) ( nz[i] * NORMAL_SCALE);
-         }
-      }
-   }
-   else {
-      cnorms = NULL;
-   }
-
    /***************************** Store ******************************/
 
-   t = allocate( ctx, sizeof(struct traj) );
-   if (!t) {
-      free(vr);
-      free(vc);
-      free(vl);
-      free(vx);
-      free(vy);
-      free(vz);
-      free(nx);
-      free(ny);
-      free(nz);
-      free(tt);
-      return;
+   tstart = (uint_vert2 *) malloc( ctx->NumTimes * sizeof(uint_vert2) );
+   tlen = (uint_vert2 *) malloc( ctx->NumTimes * sizeof(uint_vert2) );
+   if (!tstart || !tlen) {
+      printf(" You do not have enough memory to create trajectories.\n");
+      len = 0;
    }
-   t->ctx_owner = ctx->context_index; 
-   t->lock = 0;
-   t->row = row;
-   t->col = col;
-   t->lev = lev;
-   t->timestep = time;
-   t->stepmult = step_mult;
-   t->lengthmult = len_mult;
-   t->length = len;
-   t->verts = cverts;
-   t->norms = cnorms;
-   t->start = (uint_vert2 *) allocate_type( ctx,
-                                 ctx->NumTimes * sizeof(uint_vert2), START_TYPE );
-   t->len = (uint_vert2 *) allocate_type( ctx,
-                                 ctx->NumTimes * sizeof(uint_vert2), LEN_TYPE );
 
 
    // JCM:
@@ -6303,7 +5354,6 @@ static void calc_traj( Display_Context dtx, float row, float col, float lev,
 
    /* calculate start and len array values */
    if (len>0) {
-      int tlen = (int) (len_mult * ctx->TrajLength);
       for (i=0;i<ctx->NumTimes;i++) {
          int t0, t1, j, startj;
 
@@ -6321,51 +5371,47 @@ static void calc_traj( Display_Context dtx, float row, float col, float lev,
 
        //       fprintf(stderr,"j=%d len=%d t0=%d\n",j,len,t0);
          if (j>=len) {
-            t->start[i] = 0;
-            t->len[i] = 0;
+            tstart[i] = 0;
+            tlen[i] = 0;
          }
          else {
-            t->start[i] = startj = j;
+            tstart[i] = startj = j;
 	 while (tt[j]<=t1 && j<len) j++;
-	 if (j-startj<=1) t->len[i] = 0;
+	 if (j-startj<=1) tlen[i] = 0;
 	 else{
-              t->len[i] = j - startj;
+              tlen[i] = j - startj;
          }
-	 //	 printf("len=%d j=%d startj=%d t1=%d t->len[%d]=%d\n",len,j,startj,t1,i,(int)(t->len[i]));
+	 //	 printf("len=%d j=%d startj=%d t1=%d tlen[%d]=%d\n",len,j,startj,t1,i,(int)(tlen[i]));
 
-	 if(t->len[i]){
-	   t->len[i]--; /* to avoid last point being plotted  ADDED*/
+	 if(tlen[i]){
+	   tlen[i]--; /* to avoid last point being plotted  ADDED*/
 	 }
 	    	    
-	 //	printf("calc_traj2(%d %d len=%d tt=%d t0=%d t1=%d start=%d len=%d)\n",i,j,len,tt[j],t0, t1,t->start[i],t->len[i] );
+	 //	printf("calc_traj2(%d %d len=%d tt=%d t0=%d t1=%d start=%d len=%d)\n",i,j,len,tt[j],t0, t1,tstart[i],tlen[i] );
 	    
 
       }
    }
-   }
-
-   //   fprintf(stderr,"final len=%d t->length=%d t->start[0]=%d t->len[0]=%d\n",len,t->length,t->start[0],t->len[0]);
 
-
-   t->group = id;
-   t->kind = ribbon;
-   t->colors = NULL;
-   if (colorvar>=0) {
-      color_traj( ctx, t, cvowner, colorvar );
-   }
-   else {
-      t->colorvar = -1;
+      /* copy it to the end of its set */
+      info.row = row;
+      info.col = col;
+      info.lev = lev;
+      info.timestep = time;
+      info.stepmult = step_mult;
+      info.lengthmult = len_mult;
+      info.group = id;
+      info.kind = ribbon;
+      if (append_traj( dtx, ctx, &info, len, vx, vy, vz,
+                       ribbon ? nx : NULL, ny, nz, tstart, tlen,
+                       cvowner, colorvar )) {
+         recent( ctx, TRAJ, id );
+         dtx->Redraw = 2;
+      }
    }
-   t->lock = 0;
 
-   LOCK_ON( TrajLock );
-   dtx->TrajTable[dtx->NumTraj] = t;
-   dtx->NumTraj++;
-   LOCK_OFF( TrajLock );
-
-   recent( ctx, TRAJ, id );
-
-   dtx->Redraw = 2;
+   free(tstart);
+   free(tlen);
    free(vr);
    free(vc);
    free(vl);
@@ -6628,12 +5674,12 @@ int do_one_task( int threadnum )
          if (ctx->GridSameAsGridPRIME && ctx->context_index == ctx->dpy_ctx->Uvarowner[var]){
             calc_hwindslice( ctx->dpy_ctx, time, var, ctx->dpy_ctx->HWindLevel[var],
                              ctx->dpy_ctx->HWindScale[var],
-                             ctx->dpy_ctx->HWindDensity[var], threadnum );
+                             ctx->dpy_ctx->HWindDensity[var], 0, threadnum );
          }
          else if(ctx->context_index == ctx->dpy_ctx->Uvarowner[var]){
-            calc_hwindslicePRIME( ctx->dpy_ctx, time, var, ctx->dpy_ctx->HWindLevel[var],
+            calc_hwindslice( ctx->dpy_ctx, time, var, ctx->dpy_ctx->HWindLevel[var],
                              ctx->dpy_ctx->HWindScale[var],
-                             ctx->dpy_ctx->HWindDensity[var], threadnum );
+                             ctx->dpy_ctx->HWindDensity[var], 1, threadnum );
          }
 
          break;
@@ -6644,14 +5690,14 @@ int do_one_task( int threadnum )
                              ctx->dpy_ctx->VWindC1[var],
                              ctx->dpy_ctx->VWindR2[var], ctx->dpy_ctx->VWindC2[var],
                              ctx->dpy_ctx->VWindScale[var],
-                             ctx->dpy_ctx->VWindDensity[var], threadnum );
+                             ctx->dpy_ctx->VWindDensity[var], 0, threadnum );
          }
          else if(ctx->context_index == ctx->dpy_ctx->Uvarowner[var]){
-            calc_vwindslicePRIME( ctx->dpy_ctx, time, var, ctx->dpy_ctx->VWindR1[var],
+            calc_vwindslice( ctx->dpy_ctx, time, var, ctx->dpy_ctx->VWindR1[var],
                              ctx->dpy_ctx->VWindC1[var],
                              ctx->dpy_ctx->VWindR2[var], ctx->dpy_ctx->VWindC2[var],
                              ctx->dpy_ctx->VWindScale[var],
-                             ctx->dpy_ctx->VWindDensity[var], threadnum );
+                             ctx->dpy_ctx->VWindDensity[var], 1, threadnum );
          }
 
          break;
@@ -6698,7 +5744,8 @@ int do_one_task( int threadnum )
                     ctx->dpy_ctx->TrajColorVarOwner[i2],ctx->dpy_ctx->TrajColorVar[i2] );
          break;
       case TASK_TRAJ_RECOLOR:
-         recolor_traj_set( ctx->dpy_ctx, i1 );
+         recolor_traj_set( ctx->dpy_ctx, i1, ctx->dpy_ctx->TrajColorVarOwner[i1],
+                           ctx->dpy_ctx->TrajColorVar[i1] );
          break;
       case TASK_TOPO_RECOLOR:
          recolor_topography( ctx, time );
@@ -6706,6 +5753,20 @@ int do_one_task( int threadnum )
       case TASK_EXT_FUNC:
          calc_ext_func( ctx, time, var, threadnum );
          break;
+      case TASK_PARALLEL:
+         /* help with the parts of a run_parallel_job() call */
+         parallel_job_task( i1, i3 );
+         break;
+      case TASK_PRELOAD:
+         /* read a timestep into the cache, then ask for the next one */
+         if (time<ctx->NumTimes && ctx->GridCache && !ctx->Closing) {
+            preload_timestep( ctx, time );
+            if (time+1<ctx->NumTimes) {
+               request_preload( ctx, time+1 );
+            }
+         }
+         done_preload( ctx );
+         break;
       case TASK_QUIT:
          if (Debug) {
             printf("TASK_QUIT\n");
@@ -6718,6 +5779,17 @@ int do_one_task( int threadnum )
          printf("Vis5d INTERNAL ERROR:  Undefined task code!!\n");
    } /*switch*/
 
+   /* new graphics make the stored animation frames out of date */
+   if (type!=TASK_NULL && type!=TASK_QUIT && type!=TASK_PARALLEL &&
+       type!=TASK_PRELOAD) {
+      if (ctx) {
+         ctx->dpy_ctx->FramesStale = 1;
+      }
+      else if (itx) {
+         itx->dpy_ctx->FramesStale = 1;
+      }
+   }
+
    return 1;
 }
 
@@ -41,6 +41,8 @@ extern int do_one_task( int threadnum );
 
 extern void set_hslice_pos(Context ctx, int var, hslice_request *request, float level);
 
+extern void free_hslice_cache( Context ctx );
+
 #ifdef HAVE_SGI_SPROC
 extern void work( void *threadnum );
 #else
@@ -0,0 +1,61 @@
+/* spd3d.c */
+
+/*
+ * VIS-5D analysis function plugin to compute 3-D wind velocity from
+ * U, V, and W components.  This is spd3d.f written as an in-process
+ * plugin; see src/userfunc.h for the calling conventions.
+ *
+ * Compile with something like:
+ *    cc -O2 -shared -fPIC -I../src spd3d.c -o spd3d.so -lm
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "userfunc.h"
+
+
+VIS5D_USERFUNC_ABI_VERSION;
+
+
+int vis5d_userfunc( struct vis5d_userfunc_args *args )
+{
+   const float *u, *v, *w;
+   int iu, iv, iw, var, i, n;
+
+   /* Find the U, V and W variables */
+   iu = iv = iw = -1;
+   for (var=0;var<args->numvars;var++) {
+      if (strcmp(args->names[var],"U")==0)  iu = var;
+      if (strcmp(args->names[var],"V")==0)  iv = var;
+      if (strcmp(args->names[var],"W")==0)  iw = var;
+   }
+
+   /* If U, V or W not found, return error 1 */
+   if (iu<0 || iv<0 || iw<0) {
+      printf("Couldn't find U, V, and/or W variables!\n");
+      return 1;
+   }
+   u = args->ingrid[iu];
+   v = args->ingrid[iv];
+   w = args->ingrid[iw];
+
+   /* Compute 3-D wind speed on the levels all three have */
+   args->outnl = args->nl[iu];
+   if (args->nl[iv]<args->outnl)  args->outnl = args->nl[iv];
+   if (args->nl[iw]<args->outnl)  args->outnl = args->nl[iw];
+   args->outlowlev = 0;
+
+   n = args->nr * args->nc * args->outnl;
+   for (i=0;i<n;i++) {
+      /* Check for missing data */
+      if (u[i]>=1.0e30 || v[i]>=1.0e30 || w[i]>=1.0e30) {
+         args->outgrid[i] = 1.0e35;
+      }
+      else {
+         args->outgrid[i] = sqrt( u[i]*u[i] + v[i]*v[i] + w[i]*w[i] );
+      }
+   }
+
+   return 0;
+}
@@ -114,7 +114,11 @@ static void append( int num_infiles, char **infile, char *outfile,
    /* Initialize missing grid */
    n = outv->Nr * outv->Nc * MAXLEVELS;
    missing_grid = (float *) malloc( n * sizeof(float) );
-   grid_buffer = (float *) malloc( n * sizeof(float) );
+   /* also big enough for a compressed grid, which may be a bit larger */
+   /* than 4 bytes per point in the V5D_LOSSLESS mode */
+   grid_buffer = (float *) malloc( n * sizeof(float) +
+                     v5dCompressedBound( outv->Nr, outv->Nc, MAXLEVELS,
+                                         outv->CompressMode ) );
 
    if (!missing_grid || !grid_buffer) {
       printf("Error: couldn't allocate temp arrays\n");
@@ -232,6 +236,8 @@ int main( int argc, char *argv[] )
       printf("   [-var] [...] is an optional list of variables to omit whe creating target.\n");
       printf("   file.v5d [...] is the list of input files.\n");
       printf("   target.v5d is the name of the file to append onto\n");
+      printf("Grids are written in the target's layout (column-major or bricked);\n");
+      printf("a new target gets the layout of the first input file.\n");
       return 0;
    }
 
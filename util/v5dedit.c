@@ -381,6 +381,54 @@ static void edit_vertsys( v5dstruct *v )
 
 
 
+/* grid layout to convert to when the changes are saved */
+static int NewBrick[3];
+
+
+static void edit_layout( v5dstruct *v )
+{
+   char input[1000];
+   int r, c, l;
+
+   while (1) {
+      printf("\n");
+      printf("Grid layout\n");
+      if (v->BrickSize[0]>0) {
+         printf("  Current:  %d x %d x %d bricks\n",
+                v->BrickSize[0], v->BrickSize[1], v->BrickSize[2] );
+      }
+      else {
+         printf("  Current:  column-major\n");
+      }
+      if (NewBrick[0]>0) {
+         printf("  On save:  %d x %d x %d bricks\n",
+                NewBrick[0], NewBrick[1], NewBrick[2] );
+      }
+      else {
+         printf("  On save:  column-major\n");
+      }
+      printf("Enter brick rows cols levels, 0 for column-major or <q> to quit: ");
+      fgets(input,1000,stdin);
+      if (input[0]=='q') {
+         return;
+      }
+      r = c = l = 0;
+      if (sscanf( input, "%d %d %d", &r, &c, &l )==3 && r>0 && c>0 && l>0) {
+         NewBrick[0] = r;
+         NewBrick[1] = c;
+         NewBrick[2] = l;
+      }
+      else if (r==0) {
+         NewBrick[0] = NewBrick[1] = NewBrick[2] = 0;
+      }
+      else {
+         printf("Three positive numbers or 0 accepted.\n");
+      }
+   }
+}
+
+
+
 static void edit( v5dstruct *v )
 {
    char input[1000];
@@ -394,6 +442,7 @@ static void edit( v5dstruct *v )
       printf("  4. Projection\n");
       printf("  5. Vertical coordinate system\n");
       printf("  6. Low levels\n");
+      printf("  7. Grid layout\n");
       printf("Enter number to change or <q> to quit: ");
       fgets(input,1000,stdin);
       switch (input[0]) {
@@ -415,6 +464,9 @@ static void edit( v5dstruct *v )
          case '6':
             edit_lowlevs(v);
             break;
+         case '7':
+            edit_layout(v);
+            break;
          case 'q':
             return;
          default:
@@ -443,11 +495,20 @@ char *argv[];
       exit(1);
    }
 
+   NewBrick[0] = v.BrickSize[0];
+   NewBrick[1] = v.BrickSize[1];
+   NewBrick[2] = v.BrickSize[2];
+
    edit( &v );
 
    printf("Save changes made (y/n)?" );
    fgets(input,1000,stdin);
    if (input[0]=='y') {
+      if (NewBrick[0]!=v.BrickSize[0] || NewBrick[1]!=v.BrickSize[1]
+          || NewBrick[2]!=v.BrickSize[2]) {
+         printf("Rewriting grids...\n");
+         v5dSetBrickSize( &v, NewBrick[0], NewBrick[1], NewBrick[2] );
+      }
       v5dCloseFile( &v );
    }
 